@@ -791,26 +791,34 @@ void cell_reset_task_counters(struct cell *c) {
 }
 
 /**
- * @brief Recursively construct all the multipoles in a cell hierarchy.
+ * @brief Construct the multipole of a cell from the ones of its progeny (or
+ * from its #gpart in a leaf).
+ *
+ * The multipoles of the progeny must be valid at the current time. This is
+ * only used in-between rebuilds so the values at the last rebuild, from
+ * which the tasks were constructed, are left untouched.
  *
  * @param c The #cell.
  * @param ti_current The current integer time.
  * @param grav_props The properties of the gravity scheme.
+ * @param num_P2M (return) Incremented by the number of P2M operations.
+ * @param num_M2M (return) Incremented by the number of M2M operations.
  */
-void cell_make_multipoles(struct cell *c, integertime_t ti_current,
-                          const struct gravity_props *const grav_props) {
+static void cell_make_multipole(struct cell *c, integertime_t ti_current,
+                                const struct gravity_props *const grav_props,
+                                long long *num_P2M, long long *num_M2M) {
+
+  /* Keep the values at the last rebuild (the tasks were built from them) */
+  const double CoM_rebuild[3] = {c->grav.multipole->CoM_rebuild[0],
+                                 c->grav.multipole->CoM_rebuild[1],
+                                 c->grav.multipole->CoM_rebuild[2]};
+  const double r_max_rebuild = c->grav.multipole->r_max_rebuild;
 
   /* Reset everything */
   gravity_reset(c->grav.multipole);
 
   if (c->split) {
 
-    /* Start by recursing */
-    for (int k = 0; k < 8; ++k) {
-      if (c->progeny[k] != NULL)
-        cell_make_multipoles(c->progeny[k], ti_current, grav_props);
-    }
-
     /* Compute CoM of all progenies */
     double CoM[3] = {0., 0., 0.};
     double vel[3] = {0., 0., 0.};
@@ -870,6 +878,7 @@ void cell_make_multipoles(struct cell *c, integertime_t ti_current,
         /* Contribution to multipole */
         gravity_M2M(&temp, m, c->grav.multipole->CoM, cp->grav.multipole->CoM);
         gravity_multipole_add(&c->grav.multipole->m_pole, &temp);
+        ++(*num_M2M);
 
         /* Upper limit of max CoM<->gpart distance */
         const double dx =
@@ -903,6 +912,7 @@ void cell_make_multipoles(struct cell *c, integertime_t ti_current,
     if (c->grav.count > 0) {
 
       gravity_P2M(c->grav.multipole, c->grav.parts, c->grav.count, grav_props);
+      ++(*num_P2M);
 
       /* Compute the multipole power */
       gravity_multipole_compute_power(&c->grav.multipole->m_pole);
@@ -920,15 +930,103 @@ void cell_make_multipoles(struct cell *c, integertime_t ti_current,
     }
   }
 
-  /* Also update the values at rebuild time */
-  c->grav.multipole->r_max_rebuild = c->grav.multipole->r_max;
-  c->grav.multipole->CoM_rebuild[0] = c->grav.multipole->CoM[0];
-  c->grav.multipole->CoM_rebuild[1] = c->grav.multipole->CoM[1];
-  c->grav.multipole->CoM_rebuild[2] = c->grav.multipole->CoM[2];
+  /* Restore the values at rebuild time */
+  c->grav.multipole->r_max_rebuild = r_max_rebuild;
+  c->grav.multipole->CoM_rebuild[0] = CoM_rebuild[0];
+  c->grav.multipole->CoM_rebuild[1] = CoM_rebuild[1];
+  c->grav.multipole->CoM_rebuild[2] = CoM_rebuild[2];
+  c->grav.multipole->ti_make = ti_current;
 
   c->grav.ti_old_multipole = ti_current;
 }
 
+/**
+ * @brief Recursively construct all the multipoles in a cell hierarchy.
+ *
+ * @param c The #cell.
+ * @param ti_current The current integer time.
+ * @param grav_props The properties of the gravity scheme.
+ * @param num_P2M (return) Incremented by the number of P2M operations.
+ * @param num_M2M (return) Incremented by the number of M2M operations.
+ */
+void cell_make_multipoles(struct cell *c, integertime_t ti_current,
+                          const struct gravity_props *const grav_props,
+                          long long *num_P2M, long long *num_M2M) {
+
+  /* Start by recursing */
+  if (c->split) {
+    for (int k = 0; k < 8; ++k) {
+      if (c->progeny[k] != NULL)
+        cell_make_multipoles(c->progeny[k], ti_current, grav_props, num_P2M,
+                             num_M2M);
+    }
+  }
+
+  /* And construct the multipole at this level */
+  cell_make_multipole(c, ti_current, grav_props, num_P2M, num_M2M);
+}
+
+/**
+ * @brief Can the drifted multipole of a cell still be used in place of a
+ * freshly constructed one?
+ *
+ * The multipole is drifted using the velocity bounds of its #gpart at
+ * construction time. These only hold as long as none of the #gpart was
+ * kicked since then, in which case the multipole has to be reconstructed.
+ * Otherwise, the drift error is bounded by #gravity_tensors::r_drift and we
+ * can keep the multipole as long as that bound stays within the tolerance.
+ *
+ * @param c The #cell (drifted to the current time).
+ * @param tolerance The maximal drift error relative to the size of the
+ * multipole.
+ */
+static int cell_multipole_is_valid(const struct cell *c,
+                                   const double tolerance) {
+
+  const struct gravity_tensors *m = c->grav.multipole;
+
+  /* Did any #gpart start a new step (i.e. get kicked) since construction? */
+  if (c->grav.ti_beg_max >= m->ti_make) return 0;
+
+  return m->r_drift <= tolerance * m->r_max_rebuild;
+}
+
+/**
+ * @brief Recursively reconstruct the multipoles of a cell hierarchy that can
+ * not be drifted any more without exceeding the tolerance of the MAC.
+ *
+ * All the multipoles are drifted to the current time. Only the ones that are
+ * not valid any more (see cell_multipole_is_valid()) are reconstructed,
+ * re-using the (valid or updated) multipoles of their progeny.
+ *
+ * @param c The #cell.
+ * @param e The #engine.
+ * @param tolerance The maximal drift error relative to the size of a
+ * multipole (see gravity_props_multipole_drift_tolerance()).
+ * @param num_P2M (return) Incremented by the number of P2M operations.
+ * @param num_M2M (return) Incremented by the number of M2M operations.
+ */
+void cell_update_multipoles(struct cell *c, const struct engine *e,
+                            const double tolerance, long long *num_P2M,
+                            long long *num_M2M) {
+
+  /* Bring the multipole (and its error bound) to the current time */
+  if (c->grav.ti_old_multipole < e->ti_current) cell_drift_multipole(c, e);
+
+  /* Start by updating the progeny */
+  if (c->split) {
+    for (int k = 0; k < 8; ++k) {
+      if (c->progeny[k] != NULL)
+        cell_update_multipoles(c->progeny[k], e, tolerance, num_P2M, num_M2M);
+    }
+  }
+
+  /* Reconstruct this level only if we have to */
+  if (!cell_multipole_is_valid(c, tolerance))
+    cell_make_multipole(c, e->ti_current, e->gravity_properties, num_P2M,
+                        num_M2M);
+}
+
 /**
  * @brief Recursively verify that the multipoles are the sum of their progenies.
  *
@@ -555,7 +555,11 @@ int cell_count_parts_for_tasks(const struct cell *c);
 int cell_count_gparts_for_tasks(const struct cell *c);
 void cell_clean_links(struct cell *c, void *data);
 void cell_make_multipoles(struct cell *c, integertime_t ti_current,
-                          const struct gravity_props *const grav_props);
+                          const struct gravity_props *const grav_props,
+                          long long *num_P2M, long long *num_M2M);
+void cell_update_multipoles(struct cell *c, const struct engine *e,
+                            const double tolerance, long long *num_P2M,
+                            long long *num_M2M);
 void cell_check_multipole(struct cell *c,
                           const struct gravity_props *const grav_props);
 void cell_check_foreign_multipole(const struct cell *c);
@@ -749,6 +753,41 @@ __attribute__((always_inline)) INLINE static double cell_min_dist2_same_size(
   }
 }
 
+/**
+ * @brief Compute the square of the minimal distance between any two points in
+ * two cells of possibly different sizes
+ *
+ * Cells that overlap are at a distance 0. Cells of the same size get
+ * exactly the same answer as from cell_min_dist2_same_size().
+ *
+ * @param ci The first #cell.
+ * @param cj The second #cell.
+ * @param periodic Are we using periodic BCs?
+ * @param dim The dimensions of the simulation volume
+ */
+__attribute__((always_inline)) INLINE static double cell_min_dist2(
+    const struct cell *restrict ci, const struct cell *restrict cj,
+    const int periodic, const double dim[3]) {
+
+  if (ci->width[0] == cj->width[0] && ci->width[1] == cj->width[1] &&
+      ci->width[2] == cj->width[2])
+    return cell_min_dist2_same_size(ci, cj, periodic, dim);
+
+  double r2 = 0.;
+  for (int k = 0; k < 3; ++k) {
+
+    /* Distance between the centres along that axis */
+    double dx = (ci->loc[k] + 0.5 * ci->width[k]) -
+                (cj->loc[k] + 0.5 * cj->width[k]);
+    if (periodic) dx = nearest(dx, dim[k]);
+
+    /* Minus the half-widths of the two cells */
+    const double gap = fabs(dx) - 0.5 * (ci->width[k] + cj->width[k]);
+    if (gap > 0.) r2 += gap * gap;
+  }
+  return r2;
+}
+
 /* Inlined functions (for speed). */
 
 /**
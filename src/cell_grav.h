@@ -28,6 +28,9 @@
 #include "lock.h"
 #include "timeline.h"
 
+/* Avoid cyclic inclusions */
+struct gravity_mirror;
+
 /**
  * @brief Gravity-related cell variables.
  */
@@ -43,6 +46,9 @@ struct cell_grav {
   /*! This cell's multipole. */
   struct gravity_tensors *multipole;
 
+  /*! SoA copy of the #gpart of this leaf cell (valid for #mirror_epoch). */
+  struct gravity_mirror *mirror;
+
   /*! Super cell, i.e. the highest-level parent cell that has a grav pair/self
    * tasks */
   struct cell *super;
@@ -80,6 +86,12 @@ struct cell_grav {
   /*! Task for weighting neutrino particles */
   struct task *neutrino_weight;
 
+  /*! Task assigning the particles to the long-range mesh */
+  struct task *mesh_assign;
+
+  /*! Task interpolating the long-range mesh forces onto the particles */
+  struct task *mesh_interp;
+
   /*! Minimum end of (integer) time step in this cell for gravity tasks. */
   integertime_t ti_end_min;
 
@@ -117,6 +129,9 @@ struct cell_grav {
   /*! Is the #multipole data of this cell being used in a sub-cell? */
   int mhold;
 
+  /*! Epoch of the #gravity_mirror_pool the #mirror was filled in. */
+  int mirror_epoch;
+
   /*! Number of M-M tasks that are associated with this cell. */
   short int nr_mm_tasks;
 };
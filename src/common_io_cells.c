@@ -388,9 +388,9 @@ void io_write_cell_offsets(hid_t h_grp, const int cdim[3], const double dim[3],
     if (cells_top[i].nodeID == nodeID) {
 
       /* Centre of each cell */
-      centres[i * 3 + 0] = cells_top[i].loc[0] + cell_width[0] * 0.5;
-      centres[i * 3 + 1] = cells_top[i].loc[1] + cell_width[1] * 0.5;
-      centres[i * 3 + 2] = cells_top[i].loc[2] + cell_width[2] * 0.5;
+      centres[i * 3 + 0] = cells_top[i].loc[0] + cells_top[i].width[0] * 0.5;
+      centres[i * 3 + 1] = cells_top[i].loc[1] + cells_top[i].width[1] * 0.5;
+      centres[i * 3 + 2] = cells_top[i].loc[2] + cells_top[i].width[2] * 0.5;
 
       /* Finish by box wrapping to match what is done to the particles */
       centres[i * 3 + 0] = box_wrap(centres[i * 3 + 0], 0.0, dim[0]);
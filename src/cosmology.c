@@ -24,12 +24,15 @@
 
 /* This object's header. */
 #include "cosmology.h"
-#include <stdio.h>
+
 /* Some standard headers */
 #include <math.h>
 #include <string.h>
 
-#define MAXC 50000  /* if you need a constant, #define one (or more) */
+/* MPI headers. */
+#ifdef WITH_MPI
+#include <mpi.h>
+#endif
 
 /* Local headers */
 #include "adiabatic_index.h"
@@ -37,8 +40,10 @@
 #include "common_io.h"
 #include "inline.h"
 #include "memuse.h"
+#include "mg_table.h"
 #include "minmax.h"
 #include "restart.h"
+#include "table_cache.h"
 
 #ifdef HAVE_LIBGSL
 #include <gsl/gsl_integration.h>
@@ -53,6 +58,13 @@ const int cosmology_table_length = 30000;
 const size_t GSL_workspace_size = 100000;
 #endif
 
+/*! Number of values in the key of the interpolation tables cache file */
+#define COSMOLOGY_CACHE_NR_KEYS 23
+
+/*! Number of arrays in the interpolation tables cache file (the tables and
+ * the comoving distance offsets) */
+#define COSMOLOGY_CACHE_NR_ARRAYS 9
+
 /**
  * @brief Returns the interpolated value from a table.
  *
@@ -159,48 +171,15 @@ __attribute__((const)) static INLINE double cosmology_dark_energy_EoS(
 /**
  * @brief Compute \f$ E(z) \f$.
  *
- * @param Omega_r The radiation density parameter \f$ \Omega_r \f$.
- * @param Omega_m The matter density parameter \f$ \Omega_m \f$.
- * @param Omega_k The curvature density parameter \f$ \Omega_k \f$.
- * @param Omega_l The cosmological constant density parameter \f$ \Omega_\Lambda
- * \f$.
- * @param w0 The equation of state parameter at z=0.
- * @param wa The equation of state evolution parameter.
+ * The modified-gravity models tabulate E(a) directly; we look it up in the
+ * resampled uniform log(a) table.
+ *
  * @param a The current scale-factor.
+ * @param c The current #cosmology.
  */
- 
-
 static INLINE double E(const double a, const struct cosmology *c) {
 
-    
-  /* number of elements in the array */
-  const int count = MAXC;
-
-  int i;
-  
-  if (a < c->xs[0]) {
-    /* x is less than the minimum element
-     * handle error here if you want */
-    return c->ys[0]; /* return minimum element */
-  }
-  
-  if (a > c->xs[count-1]) {
-    return c->ys[count-1]; /* return maximum */
-  }
-  
-  /* find i, such that xs[i] <= x < xs[i+1] */
-  for (i = 0; i < count-1; i++) {
-    if (c->xs[i+1] > a) {
-      break;
-    }
-  }
-  
-  /* interpolate */
-  const double dx = c->xs[i+1] - c->xs[i];
-  const double dy = c->ys[i+1] - c->ys[i];
-   
-  
-  return c->ys[i] + (a - c->xs[i]) * dy / dx;  /* Lambda */
+  return mg_table_interp(&c->hubble_table, a);
 }
 
 /**
@@ -640,9 +619,11 @@ void cosmology_init_neutrino_tables(struct cosmology *c) {
 }
 
 /**
- * @brief Initialise the interpolation tables for the integrals.
+ * @brief Compute the interpolation tables for the integrals.
+ *
+ * The tables must have been allocated.
  */
-void cosmology_init_tables(struct cosmology *c) {
+static void cosmology_compute_tables(struct cosmology *c) {
 
 #ifdef HAVE_LIBGSL
 
@@ -650,40 +631,6 @@ void cosmology_init_tables(struct cosmology *c) {
   const double a_begin = c->a_begin;
   const double a_end = c->a_end;
 
-  /* Allocate memory for the interpolation tables */
-  if (swift_memalign("cosmo.table", (void **)&c->drift_fac_interp_table,
-                     SWIFT_STRUCT_ALIGNMENT,
-                     cosmology_table_length * sizeof(double)) != 0)
-    error("Failed to allocate cosmology interpolation table");
-  if (swift_memalign("cosmo.table", (void **)&c->grav_kick_fac_interp_table,
-                     SWIFT_STRUCT_ALIGNMENT,
-                     cosmology_table_length * sizeof(double)) != 0)
-    error("Failed to allocate cosmology interpolation table");
-  if (swift_memalign("cosmo.table", (void **)&c->hydro_kick_fac_interp_table,
-                     SWIFT_STRUCT_ALIGNMENT,
-                     cosmology_table_length * sizeof(double)) != 0)
-    error("Failed to allocate cosmology interpolation table");
-  if (swift_memalign("cosmo.table", (void **)&c->hydro_kick_corr_interp_table,
-                     SWIFT_STRUCT_ALIGNMENT,
-                     cosmology_table_length * sizeof(double)) != 0)
-    error("Failed to allocate cosmology interpolation table");
-  if (swift_memalign("cosmo.table", (void **)&c->time_interp_table,
-                     SWIFT_STRUCT_ALIGNMENT,
-                     cosmology_table_length * sizeof(double)) != 0)
-    error("Failed to allocate cosmology interpolation table");
-  if (swift_memalign("cosmo.table", (void **)&c->scale_factor_interp_table,
-                     SWIFT_STRUCT_ALIGNMENT,
-                     cosmology_table_length * sizeof(double)) != 0)
-    error("Failed to allocate cosmology interpolation table");
-  if (swift_memalign("cosmo.table", (void **)&c->comoving_distance_interp_table,
-                     SWIFT_STRUCT_ALIGNMENT,
-                     cosmology_table_length * sizeof(double)) != 0)
-    error("Failed to allocate cosmology interpolation table");
-  if (swift_memalign(
-          "cosmo.table", (void **)&c->comoving_distance_inverse_interp_table,
-          SWIFT_STRUCT_ALIGNMENT, cosmology_table_length * sizeof(double)) != 0)
-    error("Failed to allocate cosmology interpolation table");
-
   /* Prepare a table of scale factors for the integral bounds */
   const double delta_a =
       (c->log_a_end - c->log_a_begin) / cosmology_table_length;
@@ -810,6 +757,220 @@ void cosmology_init_tables(struct cosmology *c) {
   gsl_integration_workspace_free(space);
   swift_free("cosmo.table", a_table);
 
+#else
+
+  error("Code not compiled with GSL. Can't compute cosmology integrals.");
+
+#endif
+}
+
+/**
+ * @brief Build the key identifying the cached interpolation tables of a
+ * #cosmology.
+ *
+ * The key contains everything entering the integrands, including the grid
+ * and a checksum of the modified-gravity E(a) table.
+ *
+ * @param c The #cosmology.
+ * @param key (return) The key.
+ */
+static void cosmology_tables_cache_key(
+    const struct cosmology *c, double key[COSMOLOGY_CACHE_NR_KEYS]) {
+
+  const struct mg_table *t = &c->hubble_table;
+  double checksum_y = 0., checksum_d2y = 0.;
+  for (int i = 0; i < t->size; i++) {
+    checksum_y += t->y[i] * (i + 1);
+    if (t->d2y != NULL) checksum_d2y += t->d2y[i] * (i + 1);
+  }
+
+  key[0] = TABLE_CACHE_VERSION;
+  key[1] = cosmology_table_length;
+  key[2] = hydro_gamma;
+  key[3] = c->a_begin;
+  key[4] = c->a_end;
+  key[5] = c->H0;
+  key[6] = c->const_speed_light_c;
+  key[7] = c->h;
+  key[8] = c->Omega_cdm;
+  key[9] = c->Omega_b;
+  key[10] = c->Omega_lambda;
+  key[11] = c->Omega_r;
+  key[12] = c->Omega_k;
+  key[13] = c->Omega_nu_0;
+  key[14] = c->w_0;
+  key[15] = c->w_a;
+  key[16] = t->size;
+  key[17] = t->nr_rows;
+  key[18] = t->log_a_min;
+  key[19] = t->log_a_max;
+  key[20] = t->interpolation;
+  key[21] = checksum_y;
+  key[22] = checksum_d2y;
+}
+
+/**
+ * @brief Collect the arrays stored in the interpolation tables cache file.
+ *
+ * @param c The #cosmology.
+ * @param scalars The array of scalars stored alongside the tables.
+ * @param arrays (return) The arrays.
+ * @param lengths (return) Their lengths.
+ */
+static void cosmology_tables_cache_arrays(struct cosmology *c, double *scalars,
+                                          double **arrays, size_t *lengths) {
+
+  arrays[0] = c->drift_fac_interp_table;
+  arrays[1] = c->grav_kick_fac_interp_table;
+  arrays[2] = c->hydro_kick_fac_interp_table;
+  arrays[3] = c->hydro_kick_corr_interp_table;
+  arrays[4] = c->time_interp_table;
+  arrays[5] = c->scale_factor_interp_table;
+  arrays[6] = c->comoving_distance_interp_table;
+  arrays[7] = c->comoving_distance_inverse_interp_table;
+  arrays[8] = scalars;
+  for (int i = 0; i < COSMOLOGY_CACHE_NR_ARRAYS - 1; i++)
+    lengths[i] = cosmology_table_length;
+  lengths[COSMOLOGY_CACHE_NR_ARRAYS - 1] = 2;
+}
+
+/**
+ * @brief Read or write the interpolation tables from/to the binary cache.
+ *
+ * @param c The #cosmology.
+ * @param write Are we writing (1) or reading (0) the cache?
+ * @return 1 on success, 0 otherwise.
+ */
+static int cosmology_tables_cache_io(struct cosmology *c, const int write) {
+
+  if (!c->tables_cache) return 0;
+
+  double key[COSMOLOGY_CACHE_NR_KEYS];
+  cosmology_tables_cache_key(c, key);
+
+  char filename[2 * PARSER_MAX_LINE_SIZE];
+  snprintf(filename, 2 * PARSER_MAX_LINE_SIZE, "%scosmology_tables_%016llx.bin",
+           c->tables_cache_dir,
+           table_cache_hash(key, COSMOLOGY_CACHE_NR_KEYS));
+
+  double scalars[2] = {c->comoving_distance_interp_table_offset,
+                       c->comoving_distance_start_to_end};
+  double *arrays[COSMOLOGY_CACHE_NR_ARRAYS];
+  size_t lengths[COSMOLOGY_CACHE_NR_ARRAYS];
+  cosmology_tables_cache_arrays(c, scalars, arrays, lengths);
+
+  if (write)
+    return table_cache_write(filename, key, COSMOLOGY_CACHE_NR_KEYS,
+                             COSMOLOGY_CACHE_NR_ARRAYS, lengths,
+                             (const double *const *)arrays);
+
+  struct table_cache_file f;
+  if (!table_cache_open(&f, filename, key, COSMOLOGY_CACHE_NR_KEYS,
+                        COSMOLOGY_CACHE_NR_ARRAYS))
+    return 0;
+
+  for (int i = 0; i < COSMOLOGY_CACHE_NR_ARRAYS; i++) {
+    size_t length;
+    const double *data = table_cache_get_array(&f, i, &length);
+    if (length != lengths[i]) {
+      table_cache_close(&f);
+      return 0;
+    }
+    memcpy(arrays[i], data, length * sizeof(double));
+  }
+  table_cache_close(&f);
+
+  c->comoving_distance_interp_table_offset = scalars[0];
+  c->comoving_distance_start_to_end = scalars[1];
+
+  message("Read cosmology interpolation tables from '%s'.", filename);
+  return 1;
+}
+
+/**
+ * @brief Broadcast the interpolation tables from rank 0 to all other ranks.
+ *
+ * Does nothing in non-MPI runs.
+ *
+ * @param c The #cosmology with tables allocated on all ranks.
+ */
+static void cosmology_tables_broadcast(struct cosmology *c) {
+
+#ifdef WITH_MPI
+
+  int initialised = 0;
+  MPI_Initialized(&initialised);
+  if (!initialised) return;
+
+  double scalars[2] = {c->comoving_distance_interp_table_offset,
+                       c->comoving_distance_start_to_end};
+  double *arrays[COSMOLOGY_CACHE_NR_ARRAYS];
+  size_t lengths[COSMOLOGY_CACHE_NR_ARRAYS];
+  cosmology_tables_cache_arrays(c, scalars, arrays, lengths);
+
+  for (int i = 0; i < COSMOLOGY_CACHE_NR_ARRAYS; i++)
+    MPI_Bcast(arrays[i], lengths[i], MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+  c->comoving_distance_interp_table_offset = scalars[0];
+  c->comoving_distance_start_to_end = scalars[1];
+#endif
+}
+
+/**
+ * @brief Initialise the interpolation tables for the integrals.
+ *
+ * Rank 0 reads the tables from the binary cache if a file built from the
+ * same model and parameters exists, or computes them (and writes the cache)
+ * otherwise. The tables are then broadcast to all the other ranks.
+ */
+void cosmology_init_tables(struct cosmology *c) {
+
+  /* Allocate memory for the interpolation tables */
+  if (swift_memalign("cosmo.table", (void **)&c->drift_fac_interp_table,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     cosmology_table_length * sizeof(double)) != 0)
+    error("Failed to allocate cosmology interpolation table");
+  if (swift_memalign("cosmo.table", (void **)&c->grav_kick_fac_interp_table,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     cosmology_table_length * sizeof(double)) != 0)
+    error("Failed to allocate cosmology interpolation table");
+  if (swift_memalign("cosmo.table", (void **)&c->hydro_kick_fac_interp_table,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     cosmology_table_length * sizeof(double)) != 0)
+    error("Failed to allocate cosmology interpolation table");
+  if (swift_memalign("cosmo.table", (void **)&c->hydro_kick_corr_interp_table,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     cosmology_table_length * sizeof(double)) != 0)
+    error("Failed to allocate cosmology interpolation table");
+  if (swift_memalign("cosmo.table", (void **)&c->time_interp_table,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     cosmology_table_length * sizeof(double)) != 0)
+    error("Failed to allocate cosmology interpolation table");
+  if (swift_memalign("cosmo.table", (void **)&c->scale_factor_interp_table,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     cosmology_table_length * sizeof(double)) != 0)
+    error("Failed to allocate cosmology interpolation table");
+  if (swift_memalign("cosmo.table", (void **)&c->comoving_distance_interp_table,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     cosmology_table_length * sizeof(double)) != 0)
+    error("Failed to allocate cosmology interpolation table");
+  if (swift_memalign(
+          "cosmo.table", (void **)&c->comoving_distance_inverse_interp_table,
+          SWIFT_STRUCT_ALIGNMENT, cosmology_table_length * sizeof(double)) != 0)
+    error("Failed to allocate cosmology interpolation table");
+
+  if (table_cache_is_root_rank()) {
+    if (!cosmology_tables_cache_io(c, /*write=*/0)) {
+      cosmology_compute_tables(c);
+      cosmology_tables_cache_io(c, /*write=*/1);
+    }
+  }
+  cosmology_tables_broadcast(c);
+
+  /* Update the times */
+  c->time_begin = cosmology_get_time_since_big_bang(c, c->a_begin);
+  c->time_end = cosmology_get_time_since_big_bang(c, c->a_end);
+
 #ifdef SWIFT_DEBUG_CHECKS
 
   const int n = 1000 * cosmology_table_length;
@@ -846,12 +1007,6 @@ void cosmology_init_tables(struct cosmology *c) {
       max_error_distance);
 
 #endif /* SWIFT_DEBUG_CHECKS */
-
-#else
-
-  error("Code not compiled with GSL. Can't compute cosmology integrals.");
-
-#endif
 }
 
 /**
@@ -928,66 +1083,37 @@ void cosmology_init(struct swift_params *params, const struct unit_system *us,
   if (c->a_begin >= c->a_end)
     error("a_begin must be strictly before (and not equal to) a_end");
 
-  size_t coefficients (FILE *fp, double *xs, double *ys)
-  {
-    char buf[MAXC];         /* buffer for reading each line */ 
-    size_t ncoeff = 0;      /* number of coefficient pairs read */
-    
-    while (ncoeff < MAXC && fgets (buf, MAXC, fp))  /* read each line */
-      /* if it contains 2 double values */
-      if (sscanf (buf, "%lf %lf", &xs[ncoeff], &ys[ncoeff]) == 2)
-	ncoeff++;       /* increment counter */
-    
-    return ncoeff;          /* return total count of pairs read */
-  }
-  
-  c->xs = (double *)malloc(sizeof(double)*(MAXC));
-  c->ys = (double *)malloc(sizeof(double)*(MAXC));    /* arrays of MAXC doubles */
-  size_t n = 0;                         /* count of doubles returned */
-  
-  /*Parse the cosmology kind*/
+  /* Parse the cosmology kind */
   char cosmology_type[32] = {0};
   char cosmology_tables_dir[256] = {0};
   char filepath[300] = {0};
 
   parser_get_param_string(params, "Cosmology:cosmology_type", cosmology_type);
-  parser_get_param_string(params, "Cosmology:cosmology_tables_dir", cosmology_tables_dir);
-  
-  /* Read Hubble table */
-  FILE *fp;
-
-  if (strcmp(cosmology_type, "fT")==0) {
-    strcpy(filepath,cosmology_tables_dir);
-    strcat(filepath,"hubble_table_ft.txt");
-  } else if (strcmp(cosmology_type, "fTT")==0) {
-    strcpy(filepath,cosmology_tables_dir);
-    strcat(filepath,"hubble_table_ftt.txt");
-  } else if (strcmp(cosmology_type, "fR")==0) {
-    strcpy(filepath,cosmology_tables_dir);
-    strcat(filepath,"hubble_table_fr.txt");
-  } else if (strcmp(cosmology_type, "fTnu")==0) {
-    strcpy(filepath,cosmology_tables_dir);
-    strcat(filepath,"hubble_table_ftnu.txt");
-  } else if (strcmp(cosmology_type, "fTTnu")==0) {
-    strcpy(filepath,cosmology_tables_dir);
-    strcat(filepath,"hubble_table_fttnu.txt");
-  } else if (strcmp(cosmology_type, "fRnu")==0) {
-    strcpy(filepath,cosmology_tables_dir);
-    strcat(filepath,"hubble_table_frnu.txt");
+  parser_get_param_string(params, "Cosmology:cosmology_tables_dir",
+                          cosmology_tables_dir);
+
+  /* Read the Hubble table */
+  if (strcmp(cosmology_type, "fT") == 0) {
+    sprintf(filepath, "%shubble_table_ft.txt", cosmology_tables_dir);
+  } else if (strcmp(cosmology_type, "fTT") == 0) {
+    sprintf(filepath, "%shubble_table_ftt.txt", cosmology_tables_dir);
+  } else if (strcmp(cosmology_type, "fR") == 0) {
+    sprintf(filepath, "%shubble_table_fr.txt", cosmology_tables_dir);
+  } else if (strcmp(cosmology_type, "fTnu") == 0) {
+    sprintf(filepath, "%shubble_table_ftnu.txt", cosmology_tables_dir);
+  } else if (strcmp(cosmology_type, "fTTnu") == 0) {
+    sprintf(filepath, "%shubble_table_fttnu.txt", cosmology_tables_dir);
+  } else if (strcmp(cosmology_type, "fRnu") == 0) {
+    sprintf(filepath, "%shubble_table_frnu.txt", cosmology_tables_dir);
   } else {
-    error ("No such cosmology type exists!");
+    error("No such cosmology type exists!");
   }
 
-  fp = fopen(filepath,"r");
+  mg_table_init_from_params(&c->hubble_table, params, filepath);
+
+  /* Where do we cache the interpolation tables? */
+  c->tables_cache = mg_table_get_cache_dir(params, c->tables_cache_dir);
 
-  if (!fp)   /* validate file open for reading */
-    error ("file open failed");
-  
-  if (!(n = coefficients (fp, c->xs, c->ys))) {   /* validate coeff pairs read */
-    error("no double values read from file.");
-  }
-  fclose (fp);
-  
   /* Construct derived quantities */
 
   /* Dark-energy equation of state */
@@ -1197,6 +1323,9 @@ void cosmology_init_no_cosmo(struct cosmology *c) {
   c->scale_factor_interp_table = NULL;
   c->comoving_distance_interp_table = NULL;
   c->comoving_distance_inverse_interp_table = NULL;
+  mg_table_init_empty(&c->hubble_table);
+  c->tables_cache = 0;
+  c->tables_cache_dir[0] = '\0';
 
   c->time_begin = 0.;
   c->time_end = 0.;
@@ -1591,6 +1720,7 @@ void cosmology_clean(struct cosmology *c) {
     swift_free("Mnu", c->M_nu_eV);
     swift_free("degnu", c->deg_nu);
   }
+  mg_table_clean(&c->hubble_table);
 }
 
 #ifdef HAVE_HDF5
@@ -1666,6 +1796,9 @@ void cosmology_struct_dump(const struct cosmology *cosmology, FILE *stream) {
                          cosmology->N_nu, stream, "cosmology->deg_nu",
                          "neutrino degeneracies");
   }
+
+  /* And the modified-gravity E(a) table */
+  mg_table_struct_dump(&cosmology->hubble_table, stream);
 }
 
 /**
@@ -1693,6 +1826,9 @@ void cosmology_struct_restore(int enabled, struct cosmology *cosmology,
                         cosmology->N_nu, stream, NULL, "neutrino degeneracies");
   }
 
+  /* Restore the modified-gravity E(a) table */
+  mg_table_struct_restore(&cosmology->hubble_table, stream);
+
   /* Re-initialise the tables if using a cosmology. */
   if (enabled) {
     cosmology_init_neutrino_tables(cosmology);
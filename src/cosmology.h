@@ -23,6 +23,7 @@
 #include <config.h>
 
 /* Local includes. */
+#include "mg_table.h"
 #include "parser.h"
 #include "physical_constants.h"
 #include "timeline.h"
@@ -261,10 +262,15 @@ struct cosmology {
 
   /*! Massive neutrino density interpolation table at late times */
   double *neutrino_density_late_table;
-  
-  /*! Hubble function interpolation table variables */
-  double *xs;
-  double *ys;
+
+  /*! Modified-gravity E(a) table resampled on a uniform log(a) grid */
+  struct mg_table hubble_table;
+
+  /*! Are we caching the interpolation tables in binary files? */
+  int tables_cache;
+
+  /*! Directory in which the binary table cache files are stored */
+  char tables_cache_dir[PARSER_MAX_LINE_SIZE];
 
   /*! Time between Big Bang and first entry in the table */
   double time_interp_table_offset;
@@ -50,7 +50,6 @@
 
 /* This object's header. */
 #include "engine.h"
-#define MAXC 50000 
 
 /* Local headers. */
 #include "active.h"
@@ -73,6 +72,8 @@
 #include "fof.h"
 #include "gravity.h"
 #include "gravity_cache.h"
+#include "gravity_long_range.h"
+#include "gravity_mac_tuner.h"
 #include "hydro.h"
 #include "lightcone/lightcone.h"
 #include "lightcone/lightcone_array.h"
@@ -101,6 +102,7 @@
 #include "star_formation_logger.h"
 #include "stars_io.h"
 #include "statistics.h"
+#include "task_cost_model.h"
 #include "timers.h"
 #include "tools.h"
 #include "units.h"
@@ -491,10 +493,280 @@ void engine_exchange_cells(struct engine *e) {
 #endif
 }
 
+#ifdef WITH_MPI
+
+/*! Number of doubles in the summary of a top-level multipole */
+#if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_GRAVITY_FORCE_CHECKS)
+#define engine_top_multipole_summary_size 16
+#else
+#define engine_top_multipole_summary_size 15
+#endif
+
+/**
+ * @brief Finds the top-level multipoles that need to be exchanged in full
+ * between this node and the others.
+ *
+ * A local top-level cell is sent to every node owning a top-level cell within
+ * the truncation radius of the mesh forces (r_cut_max) of it, unless that node
+ * is already getting the cell via the proxies. The same geometric test, done
+ * on the receiving side, gives the cells each node will receive. Both sides
+ * list the cells in increasing index order.
+ *
+ * @param e The #engine.
+ * @param proxy_out Bit mask of the proxies each top-level cell is sent to.
+ * @param proxy_in Is each top-level cell received via a proxy?
+ * @param send_counts (return) The number of cells to send to each node.
+ * @param recv_counts (return) The number of cells to receive from each node.
+ * @param send_cells (return, can be NULL) The cells to send, grouped by node
+ * with the offsets given in send_offsets.
+ * @param recv_cells (return, can be NULL) The cells to receive, grouped by
+ * node with the offsets given in recv_offsets.
+ * @param send_offsets Offsets of the nodes in send_cells (if not NULL).
+ * @param recv_offsets Offsets of the nodes in recv_cells (if not NULL).
+ */
+static void engine_top_multipoles_neighbours(
+    const struct engine *e, const unsigned long long *proxy_out,
+    const char *proxy_in, int *send_counts, int *recv_counts, int *send_cells,
+    int *recv_cells, const int *send_offsets, const int *recv_offsets) {
+
+  const struct space *s = e->s;
+  const struct cell *cells = s->cells_top;
+  const int *cdim = s->cdim;
+  const int nodeID = e->nodeID;
+  const double max_distance2 = e->mesh->r_cut_max * e->mesh->r_cut_max;
+
+  /* Number of cells on either side that can be within the truncation
+   * radius */
+  int delta[3];
+  for (int k = 0; k < 3; ++k)
+    delta[k] = min((int)(e->mesh->r_cut_max / s->width[k]) + 1, cdim[k] / 2);
+
+  /* Last cell sent to each node (to avoid duplicates) */
+  int *last_sent = (int *)malloc(e->nr_nodes * sizeof(int));
+  if (last_sent == NULL) error("Failed to allocate the send markers.");
+  for (int k = 0; k < e->nr_nodes; ++k) last_sent[k] = -1;
+
+  for (int k = 0; k < e->nr_nodes; ++k) send_counts[k] = recv_counts[k] = 0;
+
+  for (int cid = 0; cid < s->nr_cells; ++cid) {
+
+    const struct cell *c = &cells[cid];
+    const int is_local = (c->nodeID == nodeID);
+
+    /* Foreign cells coming via the proxies are not needed here */
+    if (!is_local && proxy_in[cid]) continue;
+
+    const int i = cid / (cdim[1] * cdim[2]);
+    const int j = (cid / cdim[2]) % cdim[1];
+    const int k = cid % cdim[2];
+    int needed = 0;
+
+    for (int ii = i - delta[0]; ii <= i + delta[0] && !needed; ii++) {
+      for (int jj = j - delta[1]; jj <= j + delta[1] && !needed; jj++) {
+        for (int kk = k - delta[2]; kk <= k + delta[2] && !needed; kk++) {
+
+          const int cjd =
+              cell_getid(cdim, (ii + cdim[0]) % cdim[0],
+                         (jj + cdim[1]) % cdim[1], (kk + cdim[2]) % cdim[2]);
+          const struct cell *cj = &cells[cjd];
+          const int node_j = cj->nodeID;
+
+          /* Only pairs of one local and one foreign cell */
+          if (node_j == c->nodeID) continue;
+          if (!is_local && node_j != nodeID) continue;
+
+          if (cell_min_dist2_same_size(c, cj, /*periodic=*/1, s->dim) >
+              max_distance2)
+            continue;
+
+          if (is_local) {
+
+            /* Already sent to this node or done via the proxy? */
+            if (last_sent[node_j] == cid) continue;
+            last_sent[node_j] = cid;
+            const int pid = e->proxy_ind[node_j];
+            if (pid >= 0 && (proxy_out[cid] & (1ULL << pid))) continue;
+
+            if (send_cells != NULL)
+              send_cells[send_offsets[node_j] + send_counts[node_j]] = cid;
+            send_counts[node_j]++;
+
+          } else {
+            needed = 1;
+          }
+        }
+      }
+    }
+
+    if (needed) {
+      if (recv_cells != NULL)
+        recv_cells[recv_offsets[c->nodeID] + recv_counts[c->nodeID]] = cid;
+      recv_counts[c->nodeID]++;
+    }
+  }
+
+  free(last_sent);
+}
+
+/**
+ * @brief Exchanges the top-level multipoles between the nodes, shipping the
+ * full multipoles only to the nodes whose long-range gravity tasks need them.
+ *
+ * The long-range tasks never interact with cells beyond the truncation
+ * radius (r_cut_max) of the mesh forces. The multipoles of these cells are
+ * hence only needed to know which cells are empty and to count their
+ * particles. Every node therefore gets a summary (mass, centre of mass, bulk
+ * velocity and its extremes, r_max, r_max_rebuild and, when checking, number
+ * of #gpart) of all the top-level cells via an all-reduce and the full multipoles of the cells
+ * within r_cut_max of its own via an all-to-all exchange. The multipoles of
+ * the proxy cells arrive later with the cells themselves (see
+ * engine_exchange_cells()).
+ *
+ * The foreign cells that only get a summary are turned into monopoles: their
+ * higher-order terms are cleared and their power recomputed, so that nothing
+ * from an earlier full exchange is left behind in them.
+ *
+ * @param e The #engine.
+ */
+static void engine_exchange_top_multipoles_neighbours(struct engine *e) {
+
+  struct space *s = e->s;
+  struct gravity_tensors *multipoles = s->multipoles_top;
+  const int nr_cells = s->nr_cells;
+  const int nr_nodes = e->nr_nodes;
+  const int nodeID = e->nodeID;
+
+  /* Summary of all the top-level cells: mass, CoM, velocities, r_max,
+   * r_max_rebuild (and number of gpart) */
+  const int size = engine_top_multipole_summary_size;
+  double *summary = (double *)calloc(size * nr_cells, sizeof(double));
+  if (summary == NULL) error("Failed to allocate the multipole summaries.");
+  for (int k = 0; k < nr_cells; ++k) {
+    if (s->cells_top[k].nodeID != nodeID) continue;
+    const struct gravity_tensors *m = &multipoles[k];
+    summary[size * k + 0] = m->m_pole.M_000;
+    for (int i = 0; i < 3; ++i) {
+      summary[size * k + 1 + i] = m->CoM[i];
+      summary[size * k + 4 + i] = m->m_pole.vel[i];
+      summary[size * k + 7 + i] = m->m_pole.max_delta_vel[i];
+      summary[size * k + 10 + i] = m->m_pole.min_delta_vel[i];
+    }
+    summary[size * k + 13] = m->r_max;
+    summary[size * k + 14] = m->r_max_rebuild;
+#if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_GRAVITY_FORCE_CHECKS)
+    summary[size * k + 15] = m->m_pole.num_gpart;
+#endif
+  }
+  int err = MPI_Allreduce(MPI_IN_PLACE, summary, size * nr_cells, MPI_DOUBLE,
+                          MPI_SUM, MPI_COMM_WORLD);
+  if (err != MPI_SUCCESS)
+    mpi_error(err, "Failed to all-reduce the top-level multipole summaries.");
+
+  /* Which cells are already exchanged via the proxies? */
+  unsigned long long *proxy_out = (unsigned long long *)calloc(
+      nr_cells, sizeof(unsigned long long));
+  char *proxy_in = (char *)calloc(nr_cells, sizeof(char));
+  if (proxy_out == NULL || proxy_in == NULL)
+    error("Failed to allocate the proxy markers.");
+  for (int pid = 0; pid < e->nr_proxies; ++pid) {
+    const struct proxy *p = &e->proxies[pid];
+    for (int k = 0; k < p->nr_cells_out; ++k)
+      proxy_out[p->cells_out[k] - s->cells_top] |= (1ULL << pid);
+    for (int k = 0; k < p->nr_cells_in; ++k)
+      proxy_in[p->cells_in[k] - s->cells_top] = 1;
+  }
+
+  /* Count the cells to ship... */
+  int *counts = (int *)malloc(4 * nr_nodes * sizeof(int));
+  if (counts == NULL) error("Failed to allocate the multipole counts.");
+  int *send_counts = counts;
+  int *recv_counts = counts + nr_nodes;
+  int *send_offsets = counts + 2 * nr_nodes;
+  int *recv_offsets = counts + 3 * nr_nodes;
+  engine_top_multipoles_neighbours(e, proxy_out, proxy_in, send_counts,
+                                   recv_counts, NULL, NULL, NULL, NULL);
+
+  int nr_send = 0, nr_recv = 0;
+  for (int k = 0; k < nr_nodes; ++k) {
+    send_offsets[k] = nr_send;
+    recv_offsets[k] = nr_recv;
+    nr_send += send_counts[k];
+    nr_recv += recv_counts[k];
+  }
+
+  /* ... and list them */
+  int *send_cells = (int *)malloc((nr_send + nr_recv) * sizeof(int));
+  if (send_cells == NULL) error("Failed to allocate the multipole lists.");
+  int *recv_cells = send_cells + nr_send;
+  engine_top_multipoles_neighbours(e, proxy_out, proxy_in, send_counts,
+                                   recv_counts, send_cells, recv_cells,
+                                   send_offsets, recv_offsets);
+
+  struct gravity_tensors *buffer = NULL;
+  if (swift_memalign("top_multipoles_buffer", (void **)&buffer,
+                     SWIFT_CACHE_ALIGNMENT,
+                     (nr_send + nr_recv) * sizeof(struct gravity_tensors)) !=
+      0)
+    error("Unable to allocate memory for the top-level multipoles.");
+  for (int k = 0; k < nr_send; ++k) buffer[k] = multipoles[send_cells[k]];
+
+  err = MPI_Alltoallv(buffer, send_counts, send_offsets, multipole_mpi_type,
+                      buffer + nr_send, recv_counts, recv_offsets,
+                      multipole_mpi_type, MPI_COMM_WORLD);
+  if (err != MPI_SUCCESS)
+    mpi_error(err, "Failed to exchange the top-level multipoles.");
+
+  /* Foreign cells start as the monopole of their summary... */
+  for (int k = 0; k < nr_cells; ++k) {
+    if (s->cells_top[k].nodeID == nodeID) continue;
+    struct gravity_tensors *m = &multipoles[k];
+    const integertime_t ti_make = m->ti_make;
+    gravity_reset(m);
+    m->m_pole.M_000 = summary[size * k + 0];
+    for (int i = 0; i < 3; ++i) {
+      m->CoM[i] = summary[size * k + 1 + i];
+      m->CoM_rebuild[i] = m->CoM[i];
+      m->m_pole.vel[i] = summary[size * k + 4 + i];
+      m->m_pole.max_delta_vel[i] = summary[size * k + 7 + i];
+      m->m_pole.min_delta_vel[i] = summary[size * k + 10 + i];
+    }
+    m->r_max = summary[size * k + 13];
+    m->r_max_rebuild = summary[size * k + 14];
+    m->ti_make = ti_make;
+#if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_GRAVITY_FORCE_CHECKS)
+    m->m_pole.num_gpart = summary[size * k + 15];
+#endif
+    gravity_multipole_compute_power(&m->m_pole);
+  }
+
+  /* ... and the ones within reach get their full multipole */
+  for (int k = 0; k < nr_recv; ++k)
+    multipoles[recv_cells[k]] = buffer[nr_send + k];
+
+  if (e->verbose)
+    message(
+        "Exchanged %d full multipoles (sent %d) and %d summaries of %zd "
+        "bytes.",
+        nr_recv, nr_send, nr_cells, size * sizeof(double));
+
+  swift_free("top_multipoles_buffer", buffer);
+  free(send_cells);
+  free(counts);
+  free(proxy_in);
+  free(proxy_out);
+  free(summary);
+}
+
+#endif /* WITH_MPI */
+
 /**
  * @brief Exchanges the top-level multipoles between all the nodes
  * such that every node has a multipole for each top-level cell.
  *
+ * With Gravity:top_multipoles_neighbours set (and periodic BCs), only the
+ * cells within the truncation radius of the mesh forces are exchanged in
+ * full (see engine_exchange_top_multipoles_neighbours()).
+ *
  * @param e The #engine.
  */
 void engine_exchange_top_multipoles(struct engine *e) {
@@ -534,11 +806,15 @@ void engine_exchange_top_multipoles(struct engine *e) {
    * each multipole is only present once, the bit-by-bit XOR will
    * create the desired result.
    */
-  int err = MPI_Allreduce(MPI_IN_PLACE, e->s->multipoles_top, e->s->nr_cells,
-                          multipole_mpi_type, multipole_mpi_reduce_op,
-                          MPI_COMM_WORLD);
-  if (err != MPI_SUCCESS)
-    mpi_error(err, "Failed to all-reduce the top-level multipoles.");
+  if (e->s->periodic && e->gravity_properties->top_multipoles_neighbours) {
+    engine_exchange_top_multipoles_neighbours(e);
+  } else {
+    int err = MPI_Allreduce(MPI_IN_PLACE, e->s->multipoles_top,
+                            e->s->nr_cells, multipole_mpi_type,
+                            multipole_mpi_reduce_op, MPI_COMM_WORLD);
+    if (err != MPI_SUCCESS)
+      mpi_error(err, "Failed to all-reduce the top-level multipoles.");
+  }
 
 #ifdef SWIFT_DEBUG_CHECKS
   long long counter = 0;
@@ -546,6 +822,10 @@ void engine_exchange_top_multipoles(struct engine *e) {
   /* Let's check that what we received makes sense */
   for (int i = 0; i < e->s->nr_cells; ++i) {
     const struct gravity_tensors *m = &e->s->multipoles_top[i];
+
+    /* Void cells hold a copy of the zoom region's content */
+    if (zoom_region_is_void(&e->s->zoom, e->s->cdim, i)) continue;
+
     counter += m->m_pole.num_gpart;
     if (m->m_pole.num_gpart < 0) {
       error("m->m_pole.num_gpart is negative: %lld", m->m_pole.num_gpart);
@@ -1084,6 +1364,8 @@ int engine_estimate_nr_tasks(const struct engine *e) {
 #ifdef WITH_MPI
     n2 += 2;
 #endif
+    /* Mesh assignment and interpolation */
+    if (e->s->periodic && e->mesh->use_tasks) n1 += 2;
   }
   if (e->policy & engine_policy_external_gravity) {
     n1 += 2;
@@ -1178,6 +1460,13 @@ int engine_estimate_nr_tasks(const struct engine *e) {
 #endif
 
   float ntasks = n1 * ntop + n2 * (ncells - ntop);
+
+  /* Tasks that are not attached to any cell: the transforms of the blocks of
+   * the mesh, their reductions and the ghosts between them */
+  if ((e->policy & engine_policy_self_gravity) && e->s->periodic &&
+      e->mesh->use_tasks)
+    ntasks += 3 * e->mesh->nr_task_blocks + 7;
+
   if (ncells > 0) tasks_per_cell = ceilf(ntasks / ncells);
 
   if (tasks_per_cell < 1.0f) tasks_per_cell = 1.0f;
@@ -1209,6 +1498,9 @@ void engine_rebuild(struct engine *e, const int repartitioned,
   if (e->verbose && !repartitioned)
     scheduler_report_task_times(&e->sched, e->nr_threads);
 
+  /* Adjust the opening criterion using the timings of the old tasks */
+  if (e->mac_tuner != NULL) gravity_mac_tuner_update(e->mac_tuner, e);
+
   /* Give some breathing space */
   scheduler_free_tasks(&e->sched);
 
@@ -1330,6 +1622,7 @@ void engine_rebuild(struct engine *e, const int repartitioned,
     long long counter = 0;
 
     for (int i = 0; i < e->s->nr_cells; ++i) {
+      if (zoom_region_is_void(&e->s->zoom, e->s->cdim, i)) continue;
       const struct gravity_tensors *m = &e->s->multipoles_top[i];
       counter += m->m_pole.num_gpart;
     }
@@ -1350,6 +1643,10 @@ void engine_rebuild(struct engine *e, const int repartitioned,
   /* Make the list of top-level cells that have tasks */
   space_list_useful_top_level_cells(e->s);
 
+  /* Make the interaction lists of the long-range gravity tasks */
+  if (e->policy & engine_policy_self_gravity)
+    gravity_long_range_lists_build(e->s, e);
+
 #ifdef SWIFT_DEBUG_CHECKS
   /* Check that all cells have been drifted to the current time.
    * That can include cells that have not
@@ -1627,6 +1924,13 @@ void engine_skip_force_and_kick(struct engine *e) {
         t->type == task_type_rt_ghost2 || t->type == task_type_rt_tchem ||
         t->type == task_type_rt_advance_cell_time ||
         t->type == task_type_neutrino_weight || t->type == task_type_csds ||
+        t->type == task_type_grav_mesh_assign ||
+        t->type == task_type_grav_mesh_ghost ||
+        t->type == task_type_grav_mesh_reduce ||
+        t->type == task_type_grav_mesh_r2c ||
+        t->type == task_type_grav_mesh_green ||
+        t->type == task_type_grav_mesh_c2r ||
+        t->type == task_type_grav_mesh_interp ||
         t->subtype == task_subtype_force ||
         t->subtype == task_subtype_limiter ||
         t->subtype == task_subtype_gradient ||
@@ -1704,6 +2008,10 @@ void engine_launch(struct engine *e, const char *call) {
     runner_reset_active_time(&e->runners[i]);
   }
 
+  /* The #gpart SoA copies of the previous launch are now stale */
+  if (e->gravity_mirror_pool != NULL)
+    gravity_mirror_pool_reset(e->gravity_mirror_pool);
+
   /* Prepare the scheduler. */
   atomic_inc(&e->sched.waiting);
 
@@ -1738,6 +2046,56 @@ void engine_launch(struct engine *e, const char *call) {
             clocks_getunit());
 }
 
+/**
+ * @brief Reports how the mesh tasks of a step overlapped with the others.
+ *
+ * Compares the time the runners spent in the mesh tasks with the time
+ * between the first and last of them, and with the whole launch. The mesh
+ * tasks overlap well when their span is only a small part of the launch, or
+ * when the rest of the tasks ran during it.
+ *
+ * @param e The #engine.
+ * @param launch_tic The start of the launch of the tasks.
+ * @param launch_toc The end of the launch of the tasks.
+ */
+static void engine_report_mesh_tasks(const struct engine *e,
+                                     const ticks launch_tic,
+                                     const ticks launch_toc) {
+
+  const struct scheduler *sched = &e->sched;
+
+  ticks first = launch_toc, last = launch_tic;
+  ticks busy = 0, busy_fft = 0;
+  for (int k = 0; k < sched->nr_tasks; k++) {
+    const struct task *t = &sched->tasks[k];
+    if (t->implicit || t->tic < launch_tic) continue;
+
+    if (t->type == task_type_grav_mesh_assign ||
+        t->type == task_type_grav_mesh_reduce ||
+        t->type == task_type_grav_mesh_r2c ||
+        t->type == task_type_grav_mesh_green ||
+        t->type == task_type_grav_mesh_c2r ||
+        t->type == task_type_grav_mesh_interp) {
+
+      first = min(first, t->tic);
+      last = max(last, t->toc);
+      busy += t->toc - t->tic;
+      if (t->type == task_type_grav_mesh_r2c ||
+          t->type == task_type_grav_mesh_green ||
+          t->type == task_type_grav_mesh_c2r)
+        busy_fft += t->toc - t->tic;
+    }
+  }
+  if (last <= first) return;
+
+  message(
+      "Mesh tasks: %.3f %s of work (%.3f %s of transforms) spread over "
+      "%.3f %s of the %.3f %s launch.",
+      clocks_from_ticks(busy), clocks_getunit(), clocks_from_ticks(busy_fft),
+      clocks_getunit(), clocks_from_ticks(last - first), clocks_getunit(),
+      clocks_from_ticks(launch_toc - launch_tic), clocks_getunit());
+}
+
 /**
  * @brief Calls the 'first init' function on the particles of all types.
  *
@@ -1903,6 +2261,7 @@ void engine_init_particles(struct engine *e, int flag_entropy_ICs,
   /* reset the deadtime information in the scheduler */
   e->sched.deadtime.active_ticks = 0;
   e->sched.deadtime.waiting_ticks = 0;
+  scheduler_reset_steals(&e->sched);
 
   /* Update the softening lengths */
   if (e->policy & engine_policy_self_gravity)
@@ -2012,8 +2371,10 @@ void engine_init_particles(struct engine *e, int flag_entropy_ICs,
   /* Check that we have the correct total mass in the top-level multipoles */
   long long num_gpart_mpole = 0;
   if (e->policy & engine_policy_self_gravity) {
-    for (int i = 0; i < e->s->nr_cells; ++i)
+    for (int i = 0; i < e->s->nr_cells; ++i) {
+      if (zoom_region_is_void(&e->s->zoom, e->s->cdim, i)) continue;
       num_gpart_mpole += e->s->cells_top[i].grav.multipole->m_pole.num_gpart;
+    }
     if (num_gpart_mpole != e->total_nr_gparts)
       error(
           "Top-level multipoles don't contain the total number of gpart "
@@ -2238,37 +2599,16 @@ void engine_init_particles(struct engine *e, int flag_entropy_ICs,
   if (e->verbose) message("took %.3f %s.", e->wallclock_time, clocks_getunit());
 }
 
-double geff_func(const double a, struct engine *e) {
-
-  
-/* number of elements in the array */
-const int count = MAXC;
-
-int i;
-
-if (a < e->xs[0]) {
-  /* x is less than the minimum element
-   * handle error here if you want */
-  return e->ys[0]; /* return minimum element */
-}
-
-if (a > e->xs[count-1]) {
-  return e->ys[count-1]; /* return maximum */
-}
-
-/* find i, such that xs[i] <= x < xs[i+1] */
-for (i = 0; i < count-1; i++) {
-  if (e->xs[i+1] > a) {
-    break;
-  }
-}
-
-/* interpolate */
-const double dx = e->xs[i+1] - e->xs[i];
-const double dy = e->ys[i+1] - e->ys[i];
- 
+/**
+ * @brief Returns the ratio of the effective gravitational constant to its
+ * Newtonian value at a given scale-factor.
+ *
+ * @param a The scale-factor of interest.
+ * @param e The #engine.
+ */
+double geff_func(const double a, const struct engine *e) {
 
-return e->ys[i] + (a - e->xs[i]) * dy / dx;  /* Lambda */
+  return mg_table_interp(&e->geff_table, a);
 }
 
 /**
@@ -2287,6 +2627,7 @@ int engine_step(struct engine *e) {
   /* reset the deadtime information in the scheduler */
   e->sched.deadtime.active_ticks = 0;
   e->sched.deadtime.waiting_ticks = 0;
+  scheduler_reset_steals(&e->sched);
 
 #if defined(SWIFT_MPIUSE_REPORTS) && defined(WITH_MPI)
   /* We may want to compare times across ranks, so make sure all steps start
@@ -2514,7 +2855,8 @@ int engine_step(struct engine *e) {
   /* Are we reconstructing the multipoles or drifting them ?*/
   if ((e->policy & engine_policy_self_gravity) && !e->forcerebuild) {
 
-    if (e->policy & engine_policy_reconstruct_mpoles)
+    if ((e->policy & engine_policy_reconstruct_mpoles) ||
+        e->gravity_properties->lazy_multipole_reconstruction)
       engine_reconstruct_multipoles(e);
     else
       engine_drift_top_multipoles(e);
@@ -2538,8 +2880,10 @@ int engine_step(struct engine *e) {
   /* Check that we have the correct total mass in the top-level multipoles */
   long long num_gpart_mpole = 0;
   if (e->policy & engine_policy_self_gravity) {
-    for (int i = 0; i < e->s->nr_cells; ++i)
+    for (int i = 0; i < e->s->nr_cells; ++i) {
+      if (zoom_region_is_void(&e->s->zoom, e->s->cdim, i)) continue;
       num_gpart_mpole += e->s->cells_top[i].grav.multipole->m_pole.num_gpart;
+    }
     if (num_gpart_mpole != e->total_nr_gparts)
       error(
           "Multipoles don't contain the total number of gpart mpoles=%lld "
@@ -2583,15 +2927,27 @@ int engine_step(struct engine *e) {
   }
 #endif
 
+  /* Bring the groups of top-level cells up to date with their multipoles */
+  if (e->policy & engine_policy_self_gravity)
+    gravity_long_range_groups_update(e->s, /*rebuild=*/0);
+
   /* Re-compute the mesh forces? */
+  int mesh_tasks = 0;
   if ((e->policy & engine_policy_self_gravity) && e->s->periodic &&
       e->mesh->ti_end_mesh_next == e->ti_current) {
 
-    /* We might need to drift things */
-    if (!drifted_all) engine_drift_all(e, /*drift_mpole=*/0);
+    /* Are the mesh tasks going to do the work alongside the tree walk? */
+    mesh_tasks =
+        e->grav_mesh_potential != NULL && !e->grav_mesh_potential->skip;
+
+    /* We might need to drift things (the mesh tasks drift their own cells) */
+    if (!drifted_all && !mesh_tasks) engine_drift_all(e, /*drift_mpole=*/0);
 
     /* ... and recompute */
-    pm_mesh_compute_potential(e->mesh, e->s, &e->threadpool, e->verbose);
+    if (mesh_tasks)
+      pm_mesh_tasks_prepare(e->mesh, e->s, &e->threadpool, e->verbose);
+    else
+      pm_mesh_compute_potential(e->mesh, e->s, &e->threadpool, e->verbose);
 
     /* Check whether we need to update the mesh time-step length */
     engine_recompute_displacement_constraint(e);
@@ -2625,9 +2981,21 @@ int engine_step(struct engine *e) {
 
   /* Start all the tasks. */
   TIMER_TIC;
+  const ticks launch_tic = getticks();
   engine_launch(e, "tasks");
   TIMER_TOC(timer_runners);
 
+  /* The mesh tasks are done with their work arrays */
+  if (mesh_tasks) {
+    if (e->verbose) engine_report_mesh_tasks(e, launch_tic, getticks());
+    pm_mesh_tasks_clean(e->mesh);
+  }
+
+  /* Learn the task costs from the times we just measured */
+  if (e->task_cost_model != NULL)
+    task_cost_model_update(e->task_cost_model, &e->sched, launch_tic,
+                           e->verbose);
+
   /* Now record the CPU times used by the tasks. */
 #ifdef WITH_MPI
   double end_usertime = 0.0;
@@ -2692,6 +3060,15 @@ int engine_step(struct engine *e) {
                           e->sched.deadtime.active_ticks;
   e->local_deadtime = clocks_from_ticks(deadticks);
 
+  if (e->verbose)
+    message(
+        "Tasks stolen sharing a cache: %lld, on the NUMA node: %lld, on the "
+        "socket: %lld, elsewhere: %lld.",
+        e->sched.steals.count[scheduler_steal_cache],
+        e->sched.steals.count[scheduler_steal_numa],
+        e->sched.steals.count[scheduler_steal_socket],
+        e->sched.steals.count[scheduler_steal_remote]);
+
   /* Collect information about the next time-step */
   engine_collect_end_of_step(e, 1);
   e->forcerebuild = e->collect_group1.forcerebuild;
@@ -2701,6 +3078,15 @@ int engine_step(struct engine *e) {
   e->sink_updates_since_rebuild += e->collect_group1.sink_updated;
   e->b_updates_since_rebuild += e->collect_group1.b_updated;
 
+  /* Measure the accuracy of the tree ahead of the coming rebuild */
+  if (e->mac_tuner != NULL &&
+      (e->forcerebuild ||
+       (double)e->g_updates_since_rebuild >
+           ((double)e->total_nr_gparts) *
+               e->gravity_properties->rebuild_frequency ||
+       (e->s->periodic && e->mesh->ti_end_mesh_next == e->ti_end_min)))
+    gravity_mac_tuner_sample(e->mac_tuner, e);
+
   /* Check if we updated all of the particles on this step */
   if ((e->collect_group1.updated == e->total_nr_parts) &&
       (e->collect_group1.g_updated == e->total_nr_gparts) &&
@@ -2774,25 +3160,63 @@ int engine_is_done(struct engine *e) {
   return !(e->ti_current < max_nr_timesteps);
 }
 
+/**
+ * @brief Data passed to the multipole reconstruction mapper.
+ */
+struct engine_reconstruct_multipoles_data {
+
+  /*! The #engine */
+  const struct engine *e;
+
+  /*! Are we only reconstructing the multipoles that are not valid any more?
+   */
+  int lazy;
+
+  /*! Maximal drift error relative to the size of a multipole */
+  double tolerance;
+
+  /*! Number of P2M operations carried out */
+  long long num_P2M;
+
+  /*! Number of M2M operations carried out */
+  long long num_M2M;
+};
+
 void engine_do_reconstruct_multipoles_mapper(void *map_data, int num_elements,
                                              void *extra_data) {
 
-  struct engine *e = (struct engine *)extra_data;
+  struct engine_reconstruct_multipoles_data *data =
+      (struct engine_reconstruct_multipoles_data *)extra_data;
+  const struct engine *e = data->e;
   struct cell *cells = (struct cell *)map_data;
 
+  long long num_P2M = 0, num_M2M = 0;
+
   for (int ind = 0; ind < num_elements; ind++) {
     struct cell *c = &cells[ind];
     if (c != NULL && c->nodeID == e->nodeID) {
 
       /* Construct the multipoles in this cell hierarchy */
-      cell_make_multipoles(c, e->ti_current, e->gravity_properties);
+      if (data->lazy)
+        cell_update_multipoles(c, e, data->tolerance, &num_P2M, &num_M2M);
+      else
+        cell_make_multipoles(c, e->ti_current, e->gravity_properties,
+                             &num_P2M, &num_M2M);
     }
   }
+
+  atomic_add(&data->num_P2M, num_P2M);
+  atomic_add(&data->num_M2M, num_M2M);
 }
 
 /**
  * @brief Reconstruct all the multipoles at all the levels in the tree.
  *
+ * With Gravity:lazy_multipole_reconstruction, only the multipoles whose
+ * drift error bound exceeds the tolerance of the MAC (or which contain
+ * #gpart kicked since their construction) are reconstructed. All the
+ * others are simply drifted.
+ *
  * @param e The #engine.
  */
 void engine_reconstruct_multipoles(struct engine *e) {
@@ -2810,13 +3234,28 @@ void engine_reconstruct_multipoles(struct engine *e) {
   }
 #endif
 
+  struct engine_reconstruct_multipoles_data data;
+  data.e = e;
+  data.lazy = e->gravity_properties->lazy_multipole_reconstruction;
+  data.tolerance =
+      gravity_props_multipole_drift_tolerance(e->gravity_properties);
+  data.num_P2M = 0;
+  data.num_M2M = 0;
+
   threadpool_map(&e->threadpool, engine_do_reconstruct_multipoles_mapper,
                  e->s->cells_top, e->s->nr_cells, sizeof(struct cell),
-                 threadpool_auto_chunk_size, e);
+                 threadpool_auto_chunk_size, &data);
 
-  if (e->verbose)
+  /* The void cells covering the zoom region get the content of the fine
+   * cells */
+  zoom_region_make_void_multipoles(e->s, /*rebuild=*/0);
+
+  if (e->verbose) {
+    message("Multipoles reconstructed with %lld P2M and %lld M2M operations.",
+            data.num_P2M, data.num_M2M);
     message("took %.3f %s.", clocks_from_ticks(getticks() - tic),
             clocks_getunit());
+  }
 }
 
 /**
@@ -3117,59 +3556,52 @@ void engine_init(
   /* Clean-up everything */
   bzero(e, sizeof(struct engine));
 
-  /* Initialise Geff(a) table and read it */
-
-  size_t coefficients (FILE *fp, double *xs, double *ys)
-  {
-    char buf[MAXC];         /* buffer for reading each line */ 
-    size_t ncoeff = 0;      /* number of coefficient pairs read */
-    
-    while (ncoeff < MAXC && fgets (buf, MAXC, fp))  /* read each line */
-      /* if it contains 2 double values */
-      if (sscanf (buf, "%lf %lf", &xs[ncoeff], &ys[ncoeff]) == 2)
-	ncoeff++;       /* increment counter */
-    
-    return ncoeff;          /* return total count of pairs read */
-  }
-  
-  e->xs = (double *)malloc(sizeof(double)*(MAXC));
-  e->ys = (double *)malloc(sizeof(double)*(MAXC));    /* arrays of MAXC doubles */
-  size_t n = 0;                         /* count of doubles returned */
-  
-  /*Parse the cosmology kind*/
+  /* Parse the cosmology kind */
   char cosmology_type[32] = {0};
   char cosmology_tables_dir[256] = {0};
   char filepath[300] = {0};
 
   parser_get_param_string(params, "Cosmology:cosmology_type", cosmology_type);
-  parser_get_param_string(params, "Cosmology:cosmology_tables_dir", cosmology_tables_dir);
-  
-  /* Read Hubble table */
-  FILE *fp;
-
-  if ((strcmp(cosmology_type, "fT")==0) || (strcmp(cosmology_type, "fTnu")==0)) {
-    strcpy(filepath,cosmology_tables_dir);
-    strcat(filepath,"geff_table_ft.txt");
-   } else if ((strcmp(cosmology_type, "fTT")==0) || (strcmp(cosmology_type, "fTTnu")==0)) {
-    strcpy(filepath,cosmology_tables_dir);
-    strcat(filepath,"geff_table_ftt.txt");
-  } else if ((strcmp(cosmology_type, "fR")==0) || (strcmp(cosmology_type, "fRnu")==0)) {
-    strcpy(filepath,cosmology_tables_dir);
-    strcat(filepath,"geff_table_fr.txt");
+  parser_get_param_string(params, "Cosmology:cosmology_tables_dir",
+                          cosmology_tables_dir);
+
+  /* Read the Geff(a) table */
+  if ((strcmp(cosmology_type, "fT") == 0) ||
+      (strcmp(cosmology_type, "fTnu") == 0)) {
+    sprintf(filepath, "%sgeff_table_ft.txt", cosmology_tables_dir);
+  } else if ((strcmp(cosmology_type, "fTT") == 0) ||
+             (strcmp(cosmology_type, "fTTnu") == 0)) {
+    sprintf(filepath, "%sgeff_table_ftt.txt", cosmology_tables_dir);
+  } else if ((strcmp(cosmology_type, "fR") == 0) ||
+             (strcmp(cosmology_type, "fRnu") == 0)) {
+    sprintf(filepath, "%sgeff_table_fr.txt", cosmology_tables_dir);
   } else {
-    error ("No such cosmology type exists!");
+    error("No such cosmology type exists!");
   }
 
-  fp = fopen(filepath,"r");
-  
-  if (!fp)   /* validate file open for reading */
-    error ("file open failed");
-  
-  if (!(n = coefficients (fp, e->xs, e->ys))) {   /* validate coeff pairs read */
-    error("no double values read from file.");
+  mg_table_init_from_params(&e->geff_table, params, filepath);
+
+  /* Read the optional scale-dependent Geff(k,a) table (k in h/Mpc) */
+  char geff_k_filename[PARSER_MAX_LINE_SIZE] = {0};
+  parser_get_opt_param_string(params, "Cosmology:MG_geff_k_table",
+                              geff_k_filename, "none");
+  mg_table_2d_init_empty(&e->geff_k_table);
+  if (strcmp(geff_k_filename, "none") != 0) {
+    if (engine_rank == 0) {
+      const double k_fac =
+          cosmo->h / (1.e6 * physical_constants->const_parsec);
+      mg_table_2d_init_from_file(&e->geff_k_table, geff_k_filename, k_fac);
+      message("Read a %d x %d Geff(k,a) table from '%s'.",
+              e->geff_k_table.size_k, e->geff_k_table.size_a,
+              geff_k_filename);
+    }
+    mg_table_2d_struct_broadcast(&e->geff_k_table, /*root=*/0);
   }
-  fclose (fp);
-  
+
+  if (e->geff_k_table.size_a > 0 && mesh->multigrid.active)
+    error(
+        "Cannot use both a Geff(k,a) table and the f(R) field solver for the "
+        "mesh forces.");
 
   /* Store the all values in the fields of the engine. */
   e->s = s;
@@ -3324,6 +3756,13 @@ void engine_init(
       parser_get_opt_param_int(params, "ForceChecks:only_when_all_active", 0);
   e->force_checks_only_at_snapshots =
       parser_get_opt_param_int(params, "ForceChecks:only_at_snapshots", 0);
+  e->force_checks_tree_reference =
+      parser_get_opt_param_int(params, "ForceChecks:tree_reference", 0);
+  e->force_checks_tree_opening_angle = parser_get_opt_param_double(
+      params, "ForceChecks:tree_opening_angle", 0.1);
+  if (e->force_checks_tree_opening_angle <= 0. ||
+      e->force_checks_tree_opening_angle >= 1.)
+    error("The opening angle of the reference tree must be in ]0, 1[.");
 #endif
 
   /* Make the space link back to the engine. */
@@ -3682,6 +4121,15 @@ void engine_clean(struct engine *e, const int fof, const int restart) {
     gravity_cache_clean(&e->runners[k].cj_gravity_cache);
   }
   swift_free("runners", e->runners);
+  if (e->gravity_mirror_pool != NULL) {
+    gravity_mirror_pool_clean(e->gravity_mirror_pool);
+    free(e->gravity_mirror_pool);
+  }
+  if (e->mac_tuner != NULL) {
+    gravity_mac_tuner_clean(e->mac_tuner);
+    free(e->mac_tuner);
+  }
+  free(e->task_cost_model);
   free(e->snapshot_units);
 
   output_list_clean(&e->output_list_snapshots);
@@ -3694,6 +4142,9 @@ void engine_clean(struct engine *e, const int fof, const int restart) {
 
   ic_info_clean(e->ics_metadata);
 
+  mg_table_clean(&e->geff_table);
+  mg_table_2d_clean(&e->geff_k_table);
+
   swift_free("links", e->links);
 #if defined(WITH_CSDS)
   if (e->policy & engine_policy_csds) {
@@ -3829,6 +4280,11 @@ void engine_struct_dump(struct engine *e, FILE *stream) {
   ic_info_struct_dump(e->ics_metadata, stream);
   parser_struct_dump(e->parameter_file, stream);
   output_options_struct_dump(e->output_options, stream);
+  mg_table_struct_dump(&e->geff_table, stream);
+  mg_table_2d_struct_dump(&e->geff_k_table, stream);
+  if (e->mac_tuner != NULL) gravity_mac_tuner_struct_dump(e->mac_tuner, stream);
+  if (e->task_cost_model != NULL)
+    task_cost_model_struct_dump(e->task_cost_model, stream);
 
 #ifdef WITH_CSDS
   if (e->policy & engine_policy_csds) {
@@ -4017,6 +4473,23 @@ void engine_struct_restore(struct engine *e, FILE *stream) {
   output_options_struct_restore(output_options, stream);
   e->output_options = output_options;
 
+  mg_table_struct_restore(&e->geff_table, stream);
+  mg_table_2d_struct_restore(&e->geff_k_table, stream);
+
+  if (e->mac_tuner != NULL) {
+    struct gravity_mac_tuner *mac_tuner =
+        (struct gravity_mac_tuner *)malloc(sizeof(struct gravity_mac_tuner));
+    gravity_mac_tuner_struct_restore(mac_tuner, stream);
+    e->mac_tuner = mac_tuner;
+  }
+
+  if (e->task_cost_model != NULL) {
+    struct task_cost_model *task_cost_model =
+        (struct task_cost_model *)malloc(sizeof(struct task_cost_model));
+    task_cost_model_struct_restore(task_cost_model, stream);
+    e->task_cost_model = task_cost_model;
+  }
+
 #ifdef WITH_CSDS
   if (e->policy & engine_policy_csds) {
     struct csds_writer *log =
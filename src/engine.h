@@ -40,6 +40,7 @@
 #include "lightcone/lightcone.h"
 #include "lightcone/lightcone_array.h"
 #include "mesh_gravity.h"
+#include "mg_table.h"
 #include "output_options.h"
 #include "parser.h"
 #include "partition.h"
@@ -54,6 +55,9 @@
 struct black_holes_properties;
 struct extra_io_properties;
 struct external_potential;
+struct gravity_mac_tuner;
+struct task_cost_model;
+struct gravity_mirror_pool;
 
 /**
  * @brief The different policies the #engine can follow.
@@ -530,6 +534,20 @@ struct engine {
   /* The mesh used for long-range gravity forces */
   struct pm_mesh *mesh;
 
+  /* The tasks marking the complete mesh density and potential (NULL unless
+   * the mesh forces are computed by tasks) */
+  struct task *grav_mesh_density;
+  struct task *grav_mesh_potential;
+
+  /* The pool holding the SoA copies of the leaf-cell #gpart */
+  struct gravity_mirror_pool *gravity_mirror_pool;
+
+  /* The run-time tuner of the multipole acceptance criterion */
+  struct gravity_mac_tuner *mac_tuner;
+
+  /* The task costs learned from the measured task times (NULL if unused) */
+  struct task_cost_model *task_cost_model;
+
   /* Properties and pointers for the power spectrum */
   struct power_spectrum_data *power_data;
 
@@ -656,11 +674,12 @@ struct engine {
   /* Lightcone information */
   int flush_lightcone_maps;
 
+  /* Modified-gravity Geff(a) table resampled on a uniform log(a) grid */
+  struct mg_table geff_table;
+
+  /* Optional scale-dependent Geff(k,a) table applied by the PM mesh */
+  struct mg_table_2d geff_k_table;
 
-  /* Variables for Geff(a) interpolation table */
-  double *xs;
-  double *ys;
-  
 #ifdef SWIFT_GRAVITY_FORCE_CHECKS
   /* Run brute force checks only on steps when all gparts active? */
   int force_checks_only_all_active;
@@ -668,6 +687,12 @@ struct engine {
   /* Run brute force checks only during snapshot timesteps? */
   int force_checks_only_at_snapshots;
 
+  /* Compute the reference forces with a very accurate tree? */
+  int force_checks_tree_reference;
+
+  /* Opening angle of the tree used for the reference forces */
+  double force_checks_tree_opening_angle;
+
   /* Are all gparts active this timestep? */
   int all_gparts_active;
 
@@ -736,6 +761,7 @@ void engine_run_rt_sub_cycles(struct engine *e);
 void engine_init_particles(struct engine *e, int flag_entropy_ICs,
                            int clean_h_values);
 int engine_step(struct engine *e);
+double geff_func(const double a, const struct engine *e);
 void engine_split(struct engine *e, struct partition *initial_partition);
 void engine_exchange_strays(struct engine *e, const size_t offset_parts,
                             const int *ind_part, size_t *Npart,
@@ -763,6 +789,9 @@ void engine_activate_gpart_comms(struct engine *e);
 
 /* Function prototypes, engine_maketasks.c. */
 void engine_maketasks(struct engine *e);
+void engine_self_gravity_tasks_range(const struct engine *e, int *delta_m,
+                                     int *delta_p);
+int engine_zoom_gravity_tasks_range(const struct engine *e);
 
 /* Function prototypes, engine_maketasks.c. */
 void engine_make_fof_tasks(struct engine *e);
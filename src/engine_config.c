@@ -37,6 +37,7 @@
 
 /* Local headers. */
 #include "fof.h"
+#include "gravity_mac_tuner.h"
 #include "mpiuse.h"
 #include "part.h"
 #include "pressure_floor.h"
@@ -46,6 +47,7 @@
 #include "star_formation_logger.h"
 #include "stars_io.h"
 #include "statistics.h"
+#include "task_cost_model.h"
 #include "version.h"
 
 extern int engine_max_parts_per_ghost;
@@ -223,6 +225,15 @@ void engine_config(int restart, int fof, struct engine *e,
   /* Welcome message */
   if (e->nodeID == 0) message("Running simulation '%s'.", e->run_name);
 
+  /* The nested grid of zoom runs only knows about gravity tasks */
+  if (e->s->zoom.enabled) {
+    if (fof || (e->policy & engine_policy_fof))
+      error("Zoom simulations cannot be run with the FOF tasks.");
+    if (e->policy & (engine_policy_stars | engine_policy_black_holes |
+                     engine_policy_sinks | engine_policy_rt))
+      error("Zoom simulations can only be run with gravity.");
+  }
+
   /* Check-pointing properties */
 
   e->restart_stop_steps =
@@ -900,6 +911,46 @@ void engine_config(int restart, int fof, struct engine *e,
         engine_max_parts_per_cooling);
   }
 
+  /* Allocate the pool of SoA copies of the #gpart used by the P-P tasks. */
+  e->gravity_mirror_pool = NULL;
+  if (e->policy & engine_policy_self_gravity) {
+    e->gravity_mirror_pool =
+        (struct gravity_mirror_pool *)malloc(sizeof(struct gravity_mirror_pool));
+    if (e->gravity_mirror_pool == NULL)
+      error("Failed to allocate the gravity mirror pool.");
+    gravity_mirror_pool_init(e->gravity_mirror_pool);
+  }
+
+  /* The mesh tasks are created with the other tasks */
+  e->grav_mesh_density = NULL;
+  e->grav_mesh_potential = NULL;
+
+  /* Set up the tuning of the opening criterion (restored when restarting) */
+  if (!restart) {
+    e->mac_tuner = NULL;
+    if ((e->policy & engine_policy_self_gravity) &&
+        parser_get_opt_param_int(params, "Gravity:MAC_tuning", 0)) {
+      e->mac_tuner =
+          (struct gravity_mac_tuner *)malloc(sizeof(struct gravity_mac_tuner));
+      if (e->mac_tuner == NULL) error("Failed to allocate the MAC tuner.");
+      gravity_mac_tuner_init(e->mac_tuner, params, e->gravity_properties);
+    }
+  }
+  if (e->mac_tuner != NULL && e->nodeID == 0)
+    gravity_mac_tuner_open_log(e->mac_tuner, restart);
+
+  /* Set up the learning of the task costs (restored when restarting) */
+  if (!restart) {
+    e->task_cost_model = NULL;
+    if (parser_get_opt_param_int(params, "Scheduler:task_cost_model", 0)) {
+      e->task_cost_model =
+          (struct task_cost_model *)malloc(sizeof(struct task_cost_model));
+      if (e->task_cost_model == NULL)
+        error("Failed to allocate the task cost model.");
+      task_cost_model_init(e->task_cost_model, params);
+    }
+  }
+
   /* Allocate and init the threads. */
   if (swift_memalign("runners", (void **)&e->runners, SWIFT_CACHE_ALIGNMENT,
                      e->nr_threads * sizeof(struct runner)) != 0)
@@ -948,6 +999,9 @@ void engine_config(int restart, int fof, struct engine *e,
     e->runners[k].cj_gravity_cache.count = 0;
     gravity_cache_init(&e->runners[k].ci_gravity_cache, space_splitsize);
     gravity_cache_init(&e->runners[k].cj_gravity_cache, space_splitsize);
+#ifdef SWIFT_BATCHED_M2L
+    e->runners[k].grav_M2L_batch.count = 0;
+#endif
 #ifdef WITH_VECTORIZATION
     e->runners[k].ci_cache.count = 0;
     e->runners[k].cj_cache.count = 0;
@@ -977,6 +1031,20 @@ void engine_config(int restart, int fof, struct engine *e,
   if (e->policy & engine_policy_structure_finding) velociraptor_init(e);
 #endif
 
+  /* Steal tasks from the queues closest to us first */
+#if defined(HAVE_SETAFFINITY)
+  if (with_aff &&
+      (e->policy & engine_policy_setaffinity) == engine_policy_setaffinity) {
+    int *queue_cpus = (int *)malloc(nr_queues * sizeof(int));
+    if (queue_cpus == NULL) error("Failed to allocate the queue CPUs.");
+    for (int q = 0; q < nr_queues; q++) queue_cpus[q] = -1;
+    for (int k = e->nr_threads - 1; k >= 0; k--)
+      queue_cpus[e->runners[k].qid] = e->runners[k].cpuid;
+    scheduler_set_queue_topology(&e->sched, queue_cpus, verbose);
+    free(queue_cpus);
+  }
+#endif
+
     /* Free the affinity stuff */
 #if defined(HAVE_SETAFFINITY)
   if (with_aff) {
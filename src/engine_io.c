@@ -34,6 +34,7 @@
 #include "active.h"
 #include "csds_io.h"
 #include "distributed_io.h"
+#include "fft_plans.h"
 #include "kick.h"
 #include "lightcone/lightcone.h"
 #include "lightcone/lightcone_array.h"
@@ -234,6 +235,10 @@ int engine_dump_restarts(struct engine *e, const int drifted_all,
 
       restart_write(e, e->restart_file);
 
+      /* Keep what FFTW learnt while planning for the next run */
+      if (e->mesh->periodic || (e->policy & engine_policy_power_spectra))
+        fft_plans_export_wisdom(/*gather_mpi=*/e->mesh->distributed_mesh);
+
 #ifdef WITH_MPI
       /* Make sure all ranks finished writing to avoid having incomplete
        * sets of restart files should the code crash before all the ranks
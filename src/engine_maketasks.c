@@ -1802,26 +1802,23 @@ void engine_make_hierarchical_tasks_mapper(void *map_data, int num_elements,
 }
 
 /**
- * @brief Constructs the top-level tasks for the short-range gravity
- * and long-range gravity interactions.
+ * @brief Computes the range of top-level cells around any top-level cell
+ * within which the gravity pair tasks are constructed.
  *
- * - All top-cells get a self task.
- * - All pairs within range according to the multipole acceptance
- *   criterion get a pair task.
+ * Pairs of top-level cells further apart than this along any axis never
+ * get a pair task and are always dealt with by the long-range task.
+ *
+ * @param e The #engine.
+ * @param delta_m (return) The number of cells to search below a cell's index.
+ * @param delta_p (return) The number of cells to search above a cell's index.
  */
-void engine_make_self_gravity_tasks_mapper(void *map_data, int num_elements,
-                                           void *extra_data) {
+void engine_self_gravity_tasks_range(const struct engine *e, int *delta_m,
+                                     int *delta_p) {
 
-  struct engine *e = (struct engine *)extra_data;
-  struct space *s = e->s;
-  struct scheduler *sched = &e->sched;
-  const int nodeID = e->nodeID;
+  const struct space *s = e->s;
   const int periodic = s->periodic;
-  const double dim[3] = {s->dim[0], s->dim[1], s->dim[2]};
   const int cdim[3] = {s->cdim[0], s->cdim[1], s->cdim[2]};
-  struct cell *cells = s->cells_top;
-  const double max_distance = e->mesh->r_cut_max;
-  const double max_distance2 = max_distance * max_distance;
+  const struct cell *cells = s->cells_top;
 
   /* Compute maximal distance where we can expect a direct interaction */
   const float distance = gravity_M2L_min_accept_distance(
@@ -1831,26 +1828,176 @@ void engine_make_self_gravity_tasks_mapper(void *map_data, int num_elements,
   /* Convert the maximal search distance to a number of cells
    * Define a lower and upper delta in case things are not symmetric */
   const int delta = max((int)(sqrt(3) * distance / cells[0].width[0]) + 1, 2);
-  int delta_m = delta;
-  int delta_p = delta;
+  *delta_m = delta;
+  *delta_p = delta;
 
   /* Special case where every cell is in range of every other one */
   if (periodic) {
     if (delta >= cdim[0] / 2) {
       if (cdim[0] % 2 == 0) {
-        delta_m = cdim[0] / 2;
-        delta_p = cdim[0] / 2 - 1;
+        *delta_m = cdim[0] / 2;
+        *delta_p = cdim[0] / 2 - 1;
       } else {
-        delta_m = cdim[0] / 2;
-        delta_p = cdim[0] / 2;
+        *delta_m = cdim[0] / 2;
+        *delta_p = cdim[0] / 2;
       }
     }
   } else {
     if (delta > cdim[0]) {
-      delta_m = cdim[0];
-      delta_p = cdim[0];
+      *delta_m = cdim[0];
+      *delta_p = cdim[0];
+    }
+  }
+}
+
+/**
+ * @brief Computes the range of fine cells around any fine cell of the zoom
+ * region within which the gravity pair tasks between fine cells are
+ * constructed.
+ *
+ * This is the equivalent of engine_self_gravity_tasks_range() for the fine
+ * grid, which never wraps around the box.
+ *
+ * @param e The #engine.
+ */
+int engine_zoom_gravity_tasks_range(const struct engine *e) {
+
+  const struct space *s = e->s;
+  const struct zoom_region *zoom = &s->zoom;
+
+  /* Compute maximal distance where we can expect a direct interaction */
+  const float distance = gravity_M2L_min_accept_distance(
+      e->gravity_properties, sqrtf(3) * zoom->width[0], s->max_softening,
+      s->min_a_grav, s->max_mpole_power, s->periodic);
+
+  /* Convert the maximal search distance to a number of fine cells */
+  const int delta = max((int)(sqrt(3) * distance / zoom->width[0]) + 1, 2);
+  const int cdim_max = max3(zoom->cdim[0], zoom->cdim[1], zoom->cdim[2]);
+  return min(delta, cdim_max);
+}
+
+/**
+ * @brief Constructs the gravity pair tasks between a coarse top-level cell
+ * and the fine cells of a void cell of the zoom region.
+ *
+ * @param e The #engine.
+ * @param ci The coarse top-level #cell.
+ * @param vid The index of the void cell.
+ */
+static void engine_make_void_gravity_tasks(struct engine *e, struct cell *ci,
+                                           const int vid) {
+
+  struct space *s = e->s;
+  struct scheduler *sched = &e->sched;
+  const struct zoom_region *zoom = &s->zoom;
+  const int periodic = s->periodic;
+  const double dim[3] = {s->dim[0], s->dim[1], s->dim[2]};
+  const double max_distance2 = e->mesh->r_cut_max * e->mesh->r_cut_max;
+  const int r = zoom->refinement;
+
+  int first[3];
+  zoom_region_void_first(zoom, s->cdim, vid, first);
+
+  for (int i = first[0]; i < first[0] + r; i++) {
+    for (int j = first[1]; j < first[1] + r; j++) {
+      for (int k = first[2]; k < first[2] + r; k++) {
+
+        struct cell *cj = &s->cells_top[zoom_region_cell_id(zoom, i, j, k)];
+        if (cj->grav.count == 0) continue;
+
+        /* Are we beyond the distance where the truncated forces are 0 ?*/
+        if (periodic && cell_min_dist2(ci, cj, periodic, dim) > max_distance2)
+          continue;
+
+        /* Are the cells too close for a MM interaction ? */
+        if (!cell_can_use_pair_mm(ci, cj, e, s, /*use_rebuild_data=*/1,
+                                  /*is_tree_walk=*/0))
+          scheduler_addtask(sched, task_type_pair, task_subtype_grav, 0, 0, ci,
+                            cj);
+      }
     }
   }
+}
+
+/**
+ * @brief Constructs the gravity pair tasks between a fine cell of the zoom
+ * region and its fine neighbours.
+ *
+ * @param e The #engine.
+ * @param ci The fine top-level #cell.
+ * @param cid The index of ci.
+ * @param delta The range of fine cells to search for pairs.
+ */
+static void engine_make_zoom_gravity_tasks(struct engine *e, struct cell *ci,
+                                           const int cid, const int delta) {
+
+  struct space *s = e->s;
+  struct scheduler *sched = &e->sched;
+  const struct zoom_region *zoom = &s->zoom;
+  const int periodic = s->periodic;
+  const double dim[3] = {s->dim[0], s->dim[1], s->dim[2]};
+  const double max_distance2 = e->mesh->r_cut_max * e->mesh->r_cut_max;
+  const int *cdim = zoom->cdim;
+
+  /* Integer indices of the cell in the fine grid */
+  const int id = cid - zoom->nr_coarse_cells;
+  const int i = id / (cdim[1] * cdim[2]);
+  const int j = (id / cdim[2]) % cdim[1];
+  const int k = id % cdim[2];
+
+  for (int ii = max(i - delta, 0); ii <= min(i + delta, cdim[0] - 1); ii++) {
+    for (int jj = max(j - delta, 0); jj <= min(j + delta, cdim[1] - 1); jj++) {
+      for (int kk = max(k - delta, 0); kk <= min(k + delta, cdim[2] - 1);
+           kk++) {
+
+        const int cjd = zoom_region_cell_id(zoom, ii, jj, kk);
+        struct cell *cj = &s->cells_top[cjd];
+
+        /* Avoid duplicates and empty cells */
+        if (cid >= cjd || cj->grav.count == 0) continue;
+
+        /* Are we beyond the distance where the truncated forces are 0 ?*/
+        if (periodic && cell_min_dist2(ci, cj, periodic, dim) > max_distance2)
+          continue;
+
+        /* Are the cells too close for a MM interaction ? */
+        if (!cell_can_use_pair_mm(ci, cj, e, s, /*use_rebuild_data=*/1,
+                                  /*is_tree_walk=*/0))
+          scheduler_addtask(sched, task_type_pair, task_subtype_grav, 0, 0, ci,
+                            cj);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Constructs the top-level tasks for the short-range gravity
+ * and long-range gravity interactions.
+ *
+ * - All top-cells get a self task.
+ * - All pairs within range according to the multipole acceptance
+ *   criterion get a pair task.
+ */
+void engine_make_self_gravity_tasks_mapper(void *map_data, int num_elements,
+                                           void *extra_data) {
+
+  struct engine *e = (struct engine *)extra_data;
+  struct space *s = e->s;
+  struct scheduler *sched = &e->sched;
+  const int nodeID = e->nodeID;
+  const int periodic = s->periodic;
+  const double dim[3] = {s->dim[0], s->dim[1], s->dim[2]};
+  const int cdim[3] = {s->cdim[0], s->cdim[1], s->cdim[2]};
+  struct cell *cells = s->cells_top;
+  const double max_distance = e->mesh->r_cut_max;
+  const double max_distance2 = max_distance * max_distance;
+
+  const struct zoom_region *zoom = &s->zoom;
+
+  /* Range of cells to search for pairs */
+  int delta_m, delta_p;
+  engine_self_gravity_tasks_range(e, &delta_m, &delta_p);
+  const int zoom_delta = zoom->enabled ? engine_zoom_gravity_tasks_range(e) : 0;
 
   /* Loop through the elements, which are just byte offsets from NULL. */
   for (int ind = 0; ind < num_elements; ind++) {
@@ -1858,11 +2005,6 @@ void engine_make_self_gravity_tasks_mapper(void *map_data, int num_elements,
     /* Get the cell index. */
     const int cid = (size_t)(map_data) + ind;
 
-    /* Integer indices of the cell in the top-level grid */
-    const int i = cid / (cdim[1] * cdim[2]);
-    const int j = (cid / cdim[2]) % cdim[1];
-    const int k = cid % cdim[2];
-
     /* Get the first cell */
     struct cell *ci = &cells[cid];
 
@@ -1875,6 +2017,18 @@ void engine_make_self_gravity_tasks_mapper(void *map_data, int num_elements,
                         NULL);
     }
 
+    /* Fine cells of the zoom region only look for fine neighbours, the pairs
+     * with coarse cells are made from the coarse side */
+    if (zoom_region_is_zoom_cell(zoom, cid)) {
+      engine_make_zoom_gravity_tasks(e, ci, cid, zoom_delta);
+      continue;
+    }
+
+    /* Integer indices of the cell in the top-level grid */
+    const int i = cid / (cdim[1] * cdim[2]);
+    const int j = (cid / cdim[2]) % cdim[1];
+    const int k = cid % cdim[2];
+
     /* Loop over every other cell within (Manhattan) range delta */
     for (int ii = i - delta_m; ii <= i + delta_p; ii++) {
 
@@ -1900,6 +2054,12 @@ void engine_make_self_gravity_tasks_mapper(void *map_data, int num_elements,
           const int cjd = cell_getid(cdim, iii, jjj, kkk);
           struct cell *cj = &cells[cjd];
 
+          /* Void cells stand for the fine cells of the zoom region */
+          if (zoom_region_is_void(zoom, cdim, cjd)) {
+            engine_make_void_gravity_tasks(e, ci, cjd);
+            continue;
+          }
+
           /* Avoid duplicates, empty cells and completely foreign pairs */
           if (cid >= cjd || cj->grav.count == 0 ||
               (ci->nodeID != nodeID && cj->nodeID != nodeID))
@@ -2122,6 +2282,117 @@ void engine_count_and_link_tasks_mapper(void *map_data, int num_elements,
   }
 }
 
+/**
+ * @brief Recursively adds the mesh assignment and interpolation tasks to the
+ * gravity super-cells of a cell hierarchy.
+ *
+ * @param e The #engine.
+ * @param c The #cell.
+ */
+static void engine_make_mesh_tasks_rec(struct engine *e, struct cell *c) {
+
+  struct scheduler *s = &e->sched;
+
+  if (c->grav.super == c) {
+
+    /* Local super-cells only... */
+    if (c->nodeID != e->nodeID) return;
+
+    c->grav.mesh_assign = scheduler_addtask(s, task_type_grav_mesh_assign,
+                                            task_subtype_none, 0, 0, c, NULL);
+    c->grav.mesh_interp = scheduler_addtask(s, task_type_grav_mesh_interp,
+                                            task_subtype_none, 0, 0, c, NULL);
+
+    /* drift --> mesh_assign --> density ... potential --> mesh_interp -->
+     * end_force */
+    scheduler_addunlock(s, c->grav.drift, c->grav.mesh_assign);
+    scheduler_addunlock(s, c->grav.mesh_assign, e->grav_mesh_density);
+    scheduler_addunlock(s, e->grav_mesh_potential, c->grav.mesh_interp);
+    scheduler_addunlock(s, c->grav.mesh_interp, c->grav.end_force);
+
+  } else if (c->grav.super == NULL && c->split) {
+
+    /* Recurse until we find the super-cells */
+    for (int k = 0; k < 8; k++)
+      if (c->progeny[k] != NULL) engine_make_mesh_tasks_rec(e, c->progeny[k]);
+  }
+}
+
+/**
+ * @brief Creates the tasks computing the periodic mesh forces.
+ *
+ * The particles of each gravity super-cell are assigned to the mesh by a
+ * task of their own. Once the density is complete (and summed over the ranks
+ * by the reduction tasks), it is turned into the potential by three rounds of
+ * tasks working on blocks of planes of the mesh: the r2c tasks transform the
+ * x planes, the green tasks transform the ky planes along x and apply the
+ * Green function, and the c2r tasks transform the kx planes back. The
+ * implicit ghost tasks separate the rounds. The potential then unlocks the
+ * interpolation tasks of the super-cells, which unlock their end-force tasks.
+ * The mesh work can thus overlap with the short-range tree walk instead of
+ * being done before the step.
+ *
+ * @param e The #engine.
+ */
+static void engine_make_mesh_tasks(struct engine *e) {
+
+  struct space *s = e->s;
+  struct scheduler *sched = &e->sched;
+  const int nr_blocks = e->mesh->nr_task_blocks;
+
+  /* The hubs between the rounds of tasks */
+  e->grav_mesh_density =
+      scheduler_addtask(sched, task_type_grav_mesh_ghost, task_subtype_none,
+                        0, /*implicit=*/1, NULL, NULL);
+  struct task *forward =
+      scheduler_addtask(sched, task_type_grav_mesh_ghost, task_subtype_none,
+                        1, /*implicit=*/1, NULL, NULL);
+  struct task *green =
+      scheduler_addtask(sched, task_type_grav_mesh_ghost, task_subtype_none,
+                        2, /*implicit=*/1, NULL, NULL);
+  e->grav_mesh_potential =
+      scheduler_addtask(sched, task_type_grav_mesh_ghost, task_subtype_none,
+                        3, /*implicit=*/1, NULL, NULL);
+
+  /* Sum the density meshes over the ranks */
+  struct task *reduced = e->grav_mesh_density;
+#ifdef WITH_MPI
+  if (e->nr_nodes > 1) {
+    const int nr_meshes = e->mesh->interlacing ? 2 : 1;
+    reduced = scheduler_addtask(sched, task_type_grav_mesh_ghost,
+                                task_subtype_none, 4, /*implicit=*/1, NULL,
+                                NULL);
+    for (int n = 0; n < nr_meshes; ++n) {
+      struct task *reduce =
+          scheduler_addtask(sched, task_type_grav_mesh_reduce,
+                            task_subtype_none, n, 0, NULL, NULL);
+      scheduler_addunlock(sched, e->grav_mesh_density, reduce);
+      scheduler_addunlock(sched, reduce, reduced);
+    }
+  }
+#endif
+
+  /* The transforms of the blocks of planes */
+  for (int b = 0; b < nr_blocks; ++b) {
+    struct task *r2c = scheduler_addtask(sched, task_type_grav_mesh_r2c,
+                                         task_subtype_none, b, 0, NULL, NULL);
+    struct task *g = scheduler_addtask(sched, task_type_grav_mesh_green,
+                                       task_subtype_none, b, 0, NULL, NULL);
+    struct task *c2r = scheduler_addtask(sched, task_type_grav_mesh_c2r,
+                                         task_subtype_none, b, 0, NULL, NULL);
+
+    scheduler_addunlock(sched, reduced, r2c);
+    scheduler_addunlock(sched, r2c, forward);
+    scheduler_addunlock(sched, forward, g);
+    scheduler_addunlock(sched, g, green);
+    scheduler_addunlock(sched, green, c2r);
+    scheduler_addunlock(sched, c2r, e->grav_mesh_potential);
+  }
+
+  for (int i = 0; i < s->nr_cells; ++i)
+    engine_make_mesh_tasks_rec(e, &s->cells_top[i]);
+}
+
 /**
  * @brief Creates all the task dependencies for the gravity
  *
@@ -4609,6 +4880,13 @@ void engine_maketasks(struct engine *e) {
     message("Linking gravity tasks took %.3f %s.",
             clocks_from_ticks(getticks() - tic2), clocks_getunit());
 
+  /* Add the tasks computing the periodic mesh forces */
+  e->grav_mesh_density = NULL;
+  e->grav_mesh_potential = NULL;
+  if ((e->policy & engine_policy_self_gravity) && e->s->periodic &&
+      e->mesh->use_tasks)
+    engine_make_mesh_tasks(e);
+
   tic2 = getticks();
 
 #ifdef WITH_MPI
@@ -1467,6 +1467,24 @@ void engine_marktasks_mapper(void *map_data, int num_elements,
       if (cell_is_active_gravity(t->ci, e)) scheduler_activate(s, t);
     }
 
+    /* Mesh assignment? All the particles of the cell must be drifted */
+    else if (t_type == task_type_grav_mesh_assign) {
+      if (e->mesh->ti_end_mesh_next == e->ti_current) {
+        scheduler_activate(s, t);
+        cell_activate_drift_gpart(t->ci, s);
+      }
+    }
+
+    /* Other mesh tasks? All the particles get the mesh forces at once */
+    else if (t_type == task_type_grav_mesh_ghost ||
+             t_type == task_type_grav_mesh_reduce ||
+             t_type == task_type_grav_mesh_r2c ||
+             t_type == task_type_grav_mesh_green ||
+             t_type == task_type_grav_mesh_c2r ||
+             t_type == task_type_grav_mesh_interp) {
+      if (e->mesh->ti_end_mesh_next == e->ti_current) scheduler_activate(s, t);
+    }
+
     /* Activate the weighting task for neutrinos */
     else if (t_type == task_type_neutrino_weight) {
       if (cell_is_active_gravity(t->ci, e)) {
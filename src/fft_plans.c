@@ -0,0 +1,183 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/**
+ *  @file fft_plans.c
+ *  @brief Planner settings of the FFTW plans and caching of their wisdom.
+ *
+ * FFTW accumulates what it learnt while planning ("wisdom") in a global
+ * store. We write it next to the restart files such that a restarted run
+ * re-creates its (possibly expensive to measure) plans almost for free.
+ */
+
+/* Config parameters. */
+#include <config.h>
+
+/* Some standard headers. */
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef HAVE_FFTW
+#include <fftw3.h>
+#if defined(WITH_MPI) && defined(HAVE_MPI_FFTW)
+#include <fftw3-mpi.h>
+#endif
+#endif
+
+/* MPI headers. */
+#ifdef WITH_MPI
+#include <mpi.h>
+#endif
+
+/* This object's header. */
+#include "fft_plans.h"
+
+/* Local headers. */
+#include "error.h"
+#include "table_cache.h"
+
+/*! Name of the wisdom file (empty if not set) */
+static char fft_plans_wisdom_file[PATH_MAX] = "";
+
+/*! Did we already import the wisdom? */
+static int fft_plans_wisdom_imported = 0;
+
+/**
+ * @brief Convert the name of a planner effort read from the parameter file.
+ *
+ * @param name One of "estimate", "measure" or "patient".
+ */
+enum fft_plans_effort fft_plans_effort_from_name(const char *name) {
+
+  if (strcmp(name, "estimate") == 0) return fft_plans_estimate;
+  if (strcmp(name, "measure") == 0) return fft_plans_measure;
+  if (strcmp(name, "patient") == 0) return fft_plans_patient;
+
+  error(
+      "Invalid FFTW planner effort '%s'. Must be 'estimate', 'measure' or "
+      "'patient'.",
+      name);
+  return fft_plans_estimate;
+}
+
+/**
+ * @brief Name of a planner effort.
+ */
+const char *fft_plans_effort_name(const enum fft_plans_effort effort) {
+
+  switch (effort) {
+    case fft_plans_measure:
+      return "measure";
+    case fft_plans_patient:
+      return "patient";
+    default:
+      return "estimate";
+  }
+}
+
+/**
+ * @brief FFTW planner flag corresponding to a planner effort.
+ */
+unsigned int fft_plans_flags(const enum fft_plans_effort effort) {
+
+#ifdef HAVE_FFTW
+  switch (effort) {
+    case fft_plans_measure:
+      return FFTW_MEASURE;
+    case fft_plans_patient:
+      return FFTW_PATIENT;
+    default:
+      return FFTW_ESTIMATE;
+  }
+#else
+  error("No FFTW library found.");
+  return 0;
+#endif
+}
+
+/**
+ * @brief Set the file in which the FFTW wisdom is stored.
+ *
+ * @param restart_dir The directory containing the restart files.
+ */
+void fft_plans_set_wisdom_file(const char *restart_dir) {
+
+  snprintf(fft_plans_wisdom_file, PATH_MAX, "%s/fftw_wisdom.dat",
+           restart_dir);
+  fft_plans_wisdom_imported = 0;
+}
+
+/**
+ * @brief Load the wisdom stored by a previous run, if any.
+ *
+ * Must be called after the FFTW threads initialisation and before creating
+ * the plans. Only the first call does anything.
+ */
+void fft_plans_import_wisdom(void) {
+
+#ifdef HAVE_FFTW
+  if (fft_plans_wisdom_file[0] == '\0' || fft_plans_wisdom_imported) return;
+  fft_plans_wisdom_imported = 1;
+
+  /* All ranks read the same file. A missing file just means there is
+   * nothing to learn from yet. */
+  if (access(fft_plans_wisdom_file, R_OK) != 0) return;
+
+  if (fftw_import_wisdom_from_filename(fft_plans_wisdom_file)) {
+    if (table_cache_is_root_rank())
+      message("Imported FFTW wisdom from '%s'", fft_plans_wisdom_file);
+  } else {
+    message("WARNING: Could not read FFTW wisdom file '%s'",
+            fft_plans_wisdom_file);
+  }
+#endif
+}
+
+/**
+ * @brief Write the current FFTW wisdom next to the restart files.
+ *
+ * @param gather_mpi Collect the wisdom of all the ranks first (requires the
+ * FFTW MPI library to be initialised on all ranks).
+ */
+void fft_plans_export_wisdom(const int gather_mpi) {
+
+#ifdef HAVE_FFTW
+  if (fft_plans_wisdom_file[0] == '\0') return;
+
+#if defined(WITH_MPI) && defined(HAVE_MPI_FFTW)
+  if (gather_mpi) fftw_mpi_gather_wisdom(MPI_COMM_WORLD);
+#endif
+
+  if (!table_cache_is_root_rank()) return;
+
+  /* Write under a temporary name such that readers never see a partial
+   * file */
+  char tmp_filename[PATH_MAX + 8];
+  snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp",
+           fft_plans_wisdom_file);
+
+  if (!fftw_export_wisdom_to_filename(tmp_filename) ||
+      rename(tmp_filename, fft_plans_wisdom_file) != 0) {
+    message("WARNING: Could not write FFTW wisdom file '%s'",
+            fft_plans_wisdom_file);
+    unlink(tmp_filename);
+  }
+#endif
+}
@@ -0,0 +1,41 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_FFT_PLANS_H
+#define SWIFT_FFT_PLANS_H
+
+/* Config parameters. */
+#include <config.h>
+
+/**
+ * @brief How hard FFTW tries to find a fast plan.
+ */
+enum fft_plans_effort {
+  fft_plans_estimate = 0, /*!< Heuristic plans, no timing (FFTW_ESTIMATE) */
+  fft_plans_measure,      /*!< Time a few algorithms (FFTW_MEASURE) */
+  fft_plans_patient       /*!< Time many more algorithms (FFTW_PATIENT) */
+};
+
+enum fft_plans_effort fft_plans_effort_from_name(const char *name);
+const char *fft_plans_effort_name(const enum fft_plans_effort effort);
+unsigned int fft_plans_flags(const enum fft_plans_effort effort);
+
+void fft_plans_set_wisdom_file(const char *restart_dir);
+void fft_plans_import_wisdom(void);
+void fft_plans_export_wisdom(const int gather_mpi);
+
+#endif /* SWIFT_FFT_PLANS_H */
@@ -24,30 +24,113 @@
 #include <float.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #ifdef HAVE_HDF5
 #include <hdf5.h>
 #endif
 
+/* MPI headers. */
+#ifdef WITH_MPI
+#include <mpi.h>
+#endif
+
 /* This object's header. */
 #include "gravity.h"
 
 /* Local headers. */
 #include "active.h"
+#include "cell.h"
 #include "error.h"
+#include "gravity_iact.h"
 #include "kernel_gravity.h"
 #include "kernel_long_gravity.h"
+#include "multipole.h"
 #include "threadpool.h"
 #include "version.h"
 
+struct exact_force_tree;
+
 struct exact_force_data {
   const struct engine *e;
   const struct space *s;
+  const struct exact_force_tree *tree;
   int counter_global;
   double const_G;
 };
 
+/**
+ * @brief The exact acceleration and potential of one #gpart being computed.
+ */
+struct exact_force_accumulator {
+
+  /*! Total acceleration (including the Ewald correction) */
+  double a_grav[3];
+
+  /*! Short-range part of the acceleration */
+  double a_grav_short[3];
+
+  /*! Long-range part of the acceleration (including the Ewald correction) */
+  double a_grav_long[3];
+
+  /*! Total potential */
+  double pot;
+};
+
+/**
+ * @brief A node of the tree used to compute the reference accelerations.
+ *
+ * This is a copy of the cell hierarchy whose multipoles are constructed from
+ * the current positions of the #gpart, independently of the ones used by the
+ * tasks.
+ */
+struct exact_force_tree_node {
+
+  /*! The multipole of the particles in this node */
+  struct gravity_tensors multipole;
+
+  /*! Second moments of the mass distribution around the CoM (xx, yy, zz, xy,
+   * xz, yz) used for the Ewald correction. */
+  double second_moments[6];
+
+  /*! The #gpart in this node */
+  const struct gpart *gparts;
+
+  /*! Number of #gpart in this node */
+  int gcount;
+
+  /*! Indices of the progeny nodes (-1 if none) */
+  int progeny[8];
+
+  /*! Is this node split? */
+  int split;
+
+  /*! Is the multipole usable? (i.e. no removed or extra particles inside) */
+  int valid;
+};
+
+/**
+ * @brief The tree used to compute the reference accelerations.
+ */
+struct exact_force_tree {
+
+  /*! All the nodes */
+  struct exact_force_tree_node *nodes;
+
+  /*! Number of nodes */
+  int nr_nodes;
+
+  /*! Indices of the top-level nodes */
+  int *top;
+
+  /*! Number of top-level nodes */
+  int nr_top;
+
+  /*! Square of the opening angle */
+  double theta2;
+};
+
 #ifdef SWIFT_GRAVITY_FORCE_CHECKS
 
 /* Size of the Ewald table */
@@ -63,240 +146,324 @@ static float potewald[Newald + 1][Newald + 1][Newald + 1];
 float ewald_fac;
 #endif
 
+#ifdef SWIFT_GRAVITY_FORCE_CHECKS
 /**
- * @brief Allocates the memory and computes one octant of the
+ * @brief Mapper function computing planes of constant x of the octant of the
  * Ewald correction table.
  *
  * We follow Hernquist, Bouchet & Suto, 1991, ApJS, Volume 75, p.231-240,
  * equations (2.14a) and (2.14b) with alpha = 2. We consider all terms with
  * |x - nL| < 4L and |h|^2 < 16.
  *
- * @param boxSize The side-length (L) of the volume.
+ * @param map_data The indices of the planes to compute.
+ * @param num_elements The number of planes.
+ * @param extra_data Unused.
  */
-void gravity_exact_force_ewald_init(const double boxSize) {
+static void gravity_exact_force_ewald_mapper(void *map_data, int num_elements,
+                                             void *extra_data) {
 
-#ifdef SWIFT_GRAVITY_FORCE_CHECKS
+  const int *planes = (const int *)map_data;
 
-  const float boxSize_inv = 1.f / boxSize;
-  const float boxSize_inv2 = 1.f / (boxSize * boxSize);
+  /* Level of correction  (Hernquist et al. 1991)*/
+  const float alpha = 2.f;
 
-  int use_file = 0;
+  /* some useful constants */
+  const float alpha2 = alpha * alpha;
+  const float factor_exp1 = 2.f * alpha / sqrt(M_PI);
+  const float factor_exp2 = -M_PI * M_PI / alpha2;
+  const float factor_sin = 2.f * M_PI;
+  const float factor_cos = 2.f * M_PI;
+  const float factor_pot = M_PI / alpha2;
 
-#ifdef HAVE_HDF5
-  if (access("Ewald.hdf5", R_OK) != -1) use_file = 1;
-#endif
+  for (int ind = 0; ind < num_elements; ++ind) {
 
-  /* Can we use the stored HDF5 file? */
-  if (use_file) {
+    const int i = planes[ind];
 
-    const ticks tic = getticks();
-    message("Reading Ewald correction table from file...");
-
-#ifdef HAVE_HDF5
-    const hid_t h_file = H5Fopen("Ewald.hdf5", H5F_ACC_RDONLY, H5P_DEFAULT);
-    if (h_file < 0) error("Error opening the old 'Ewald.hdf5' file.");
-
-    /* Check the table size */
-    const hid_t h_grp = H5Gopen1(h_file, "Info");
-    const hid_t h_attr = H5Aopen(h_grp, "Ewald_size", H5P_DEFAULT);
-    int size;
-    H5Aread(h_attr, H5T_NATIVE_INT, &size);
-    if (size != Newald)
-      error("File 'Ewald.hdf5' contains arrays of the wrong size");
-    H5Aclose(h_attr);
-    H5Gclose(h_grp);
-
-    /* Now read the tables themselves */
-    hid_t h_data;
-    h_data = H5Dopen(h_file, "Ewald_x", H5P_DEFAULT);
-    H5Dread(h_data, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-            &(fewald_x[0][0][0]));
-    H5Dclose(h_data);
-    h_data = H5Dopen(h_file, "Ewald_y", H5P_DEFAULT);
-    H5Dread(h_data, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-            &(fewald_y[0][0][0]));
-    H5Dclose(h_data);
-    h_data = H5Dopen(h_file, "Ewald_z", H5P_DEFAULT);
-    H5Dread(h_data, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-            &(fewald_z[0][0][0]));
-    H5Dclose(h_data);
-    h_data = H5Dopen(h_file, "Ewald_pot", H5P_DEFAULT);
-    H5Dread(h_data, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-            &(potewald[0][0][0]));
-    H5Dclose(h_data);
-
-    /* Done */
-    H5Fclose(h_file);
-#endif
-
-    /* Report time this took */
-    message("Ewald correction table read in (took %.3f %s). ",
-            clocks_from_ticks(getticks() - tic), clocks_getunit());
-  } else {
+    for (int j = 0; j <= Newald; ++j) {
+      for (int k = 0; k <= Newald; ++k) {
 
-    /* Ok.. let's recompute everything */
-    const ticks tic = getticks();
-    message("Computing Ewald correction table...");
-
-    /* Level of correction  (Hernquist et al. 1991)*/
-    const float alpha = 2.f;
-
-    /* some useful constants */
-    const float alpha2 = alpha * alpha;
-    const float factor_exp1 = 2.f * alpha / sqrt(M_PI);
-    const float factor_exp2 = -M_PI * M_PI / alpha2;
-    const float factor_sin = 2.f * M_PI;
-    const float factor_cos = 2.f * M_PI;
-    const float factor_pot = M_PI / alpha2;
-
-    /* Zero everything */
-    bzero(fewald_x, (Newald + 1) * (Newald + 1) * (Newald + 1) * sizeof(float));
-    bzero(fewald_y, (Newald + 1) * (Newald + 1) * (Newald + 1) * sizeof(float));
-    bzero(fewald_z, (Newald + 1) * (Newald + 1) * (Newald + 1) * sizeof(float));
-    bzero(potewald, (Newald + 1) * (Newald + 1) * (Newald + 1) * sizeof(float));
-
-    /* Hernquist, Bouchet & Suto, 1991, Eq. 2.10 and just below Eq. 2.15 */
-    potewald[0][0][0] = 2.8372975f;
-
-    /* Compute the values in one of the octants */
-    for (int i = 0; i <= Newald; ++i) {
-      for (int j = 0; j <= Newald; ++j) {
-        for (int k = 0; k <= Newald; ++k) {
-
-          if (i == 0 && j == 0 && k == 0) continue;
-
-          /* Distance vector */
-          const float r_x = 0.5f * ((float)i) / Newald;
-          const float r_y = 0.5f * ((float)j) / Newald;
-          const float r_z = 0.5f * ((float)k) / Newald;
-
-          /* Norm of distance vector */
-          const float r2 = r_x * r_x + r_y * r_y + r_z * r_z;
-          const float r_inv = 1.f / sqrtf(r2);
-          const float r_inv3 = r_inv * r_inv * r_inv;
-
-          /* Normal gravity potential term */
-          float f_x = r_x * r_inv3;
-          float f_y = r_y * r_inv3;
-          float f_z = r_z * r_inv3;
-          float pot = r_inv + factor_pot;
-
-          for (int n_i = -4; n_i <= 4; ++n_i) {
-            for (int n_j = -4; n_j <= 4; ++n_j) {
-              for (int n_k = -4; n_k <= 4; ++n_k) {
-
-                const float d_x = r_x - n_i;
-                const float d_y = r_y - n_j;
-                const float d_z = r_z - n_k;
-
-                /* Discretised distance */
-                const float r_tilde2 = d_x * d_x + d_y * d_y + d_z * d_z;
-                const float r_tilde_inv = 1.f / sqrtf(r_tilde2);
-                const float r_tilde = r_tilde_inv * r_tilde2;
-                const float r_tilde_inv3 =
-                    r_tilde_inv * r_tilde_inv * r_tilde_inv;
-
-                const float val_pot = erfcf(alpha * r_tilde);
-
-                const float val_f =
-                    val_pot + factor_exp1 * r_tilde * expf(-alpha2 * r_tilde2);
-
-                /* First correction term */
-                const float f = val_f * r_tilde_inv3;
-                f_x -= f * d_x;
-                f_y -= f * d_y;
-                f_z -= f * d_z;
-                pot -= val_pot * r_tilde_inv;
-              }
+        if (i == 0 && j == 0 && k == 0) continue;
+
+        /* Distance vector */
+        const float r_x = 0.5f * ((float)i) / Newald;
+        const float r_y = 0.5f * ((float)j) / Newald;
+        const float r_z = 0.5f * ((float)k) / Newald;
+
+        /* Norm of distance vector */
+        const float r2 = r_x * r_x + r_y * r_y + r_z * r_z;
+        const float r_inv = 1.f / sqrtf(r2);
+        const float r_inv3 = r_inv * r_inv * r_inv;
+
+        /* Normal gravity potential term */
+        float f_x = r_x * r_inv3;
+        float f_y = r_y * r_inv3;
+        float f_z = r_z * r_inv3;
+        float pot = r_inv + factor_pot;
+
+        for (int n_i = -4; n_i <= 4; ++n_i) {
+          for (int n_j = -4; n_j <= 4; ++n_j) {
+            for (int n_k = -4; n_k <= 4; ++n_k) {
+
+              const float d_x = r_x - n_i;
+              const float d_y = r_y - n_j;
+              const float d_z = r_z - n_k;
+
+              /* Discretised distance */
+              const float r_tilde2 = d_x * d_x + d_y * d_y + d_z * d_z;
+              const float r_tilde_inv = 1.f / sqrtf(r_tilde2);
+              const float r_tilde = r_tilde_inv * r_tilde2;
+              const float r_tilde_inv3 =
+                  r_tilde_inv * r_tilde_inv * r_tilde_inv;
+
+              const float val_pot = erfcf(alpha * r_tilde);
+
+              const float val_f =
+                  val_pot + factor_exp1 * r_tilde * expf(-alpha2 * r_tilde2);
+
+              /* First correction term */
+              const float f = val_f * r_tilde_inv3;
+              f_x -= f * d_x;
+              f_y -= f * d_y;
+              f_z -= f * d_z;
+              pot -= val_pot * r_tilde_inv;
             }
           }
+        }
 
-          for (int h_i = -4; h_i <= 4; ++h_i) {
-            for (int h_j = -4; h_j <= 4; ++h_j) {
-              for (int h_k = -4; h_k <= 4; ++h_k) {
+        for (int h_i = -4; h_i <= 4; ++h_i) {
+          for (int h_j = -4; h_j <= 4; ++h_j) {
+            for (int h_k = -4; h_k <= 4; ++h_k) {
 
-                const float h2 = h_i * h_i + h_j * h_j + h_k * h_k;
+              const float h2 = h_i * h_i + h_j * h_j + h_k * h_k;
 
-                if (h2 == 0.f) continue;
+              if (h2 == 0.f) continue;
 
-                const float h2_inv = 1.f / (h2 + FLT_MIN);
-                const float h_dot_x = h_i * r_x + h_j * r_y + h_k * r_z;
+              const float h2_inv = 1.f / (h2 + FLT_MIN);
+              const float h_dot_x = h_i * r_x + h_j * r_y + h_k * r_z;
 
-                const float common = h2_inv * expf(h2 * factor_exp2);
+              const float common = h2_inv * expf(h2 * factor_exp2);
 
-                const float val_pot =
-                    (float)M_1_PI * common * cosf(factor_cos * h_dot_x);
+              const float val_pot =
+                  (float)M_1_PI * common * cosf(factor_cos * h_dot_x);
 
-                const float val_f = 2.f * common * sinf(factor_sin * h_dot_x);
+              const float val_f = 2.f * common * sinf(factor_sin * h_dot_x);
 
-                /* Second correction term */
-                f_x -= val_f * h_i;
-                f_y -= val_f * h_j;
-                f_z -= val_f * h_k;
-                pot -= val_pot;
-              }
+              /* Second correction term */
+              f_x -= val_f * h_i;
+              f_y -= val_f * h_j;
+              f_z -= val_f * h_k;
+              pot -= val_pot;
             }
           }
-
-          /* Save back to memory */
-          fewald_x[i][j][k] = f_x;
-          fewald_y[i][j][k] = f_y;
-          fewald_z[i][j][k] = f_z;
-          potewald[i][j][k] = pot;
         }
+
+        /* Save back to memory */
+        fewald_x[i][j][k] = f_x;
+        fewald_y[i][j][k] = f_y;
+        fewald_z[i][j][k] = f_z;
+        potewald[i][j][k] = pot;
       }
     }
+  }
+}
+
+/**
+ * @brief Reads the (box-size independent) Ewald correction table from a file.
+ *
+ * @param file_name The name of the file.
+ * @return 1 if the table was read, 0 if the file does not contain a table
+ * of the right size.
+ */
+static int gravity_exact_force_ewald_read(const char *file_name) {
 
-/* Dump the Ewald table to a file */
 #ifdef HAVE_HDF5
-    hid_t h_file =
-        H5Fcreate("Ewald.hdf5", H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
-    if (h_file < 0) error("Error while opening file for Ewald dump.");
-
-    /* Write the Ewald table size */
-    const int size = Newald;
-    const hid_t h_grp = H5Gcreate1(h_file, "Info", 0);
-    const hid_t h_aspace = H5Screate(H5S_SCALAR);
-    hid_t h_att =
-        H5Acreate1(h_grp, "Ewald_size", H5T_NATIVE_INT, h_aspace, H5P_DEFAULT);
-    H5Awrite(h_att, H5T_NATIVE_INT, &size);
-    H5Aclose(h_att);
-    H5Gclose(h_grp);
-    H5Sclose(h_aspace);
-
-    /* Create dataspace and write arrays */
-    hsize_t dim[3] = {Newald + 1, Newald + 1, Newald + 1};
-    hid_t h_space = H5Screate_simple(3, dim, NULL);
-    hid_t h_data;
-    h_data = H5Dcreate(h_file, "Ewald_x", H5T_NATIVE_FLOAT, h_space,
-                       H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-    H5Dwrite(h_data, H5T_NATIVE_FLOAT, h_space, H5S_ALL, H5P_DEFAULT,
-             &(fewald_x[0][0][0]));
-    H5Dclose(h_data);
-    h_data = H5Dcreate(h_file, "Ewald_y", H5T_NATIVE_FLOAT, h_space,
-                       H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-    H5Dwrite(h_data, H5T_NATIVE_FLOAT, h_space, H5S_ALL, H5P_DEFAULT,
-             &(fewald_y[0][0][0]));
-    H5Dclose(h_data);
-    h_data = H5Dcreate(h_file, "Ewald_z", H5T_NATIVE_FLOAT, h_space,
-                       H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-    H5Dwrite(h_data, H5T_NATIVE_FLOAT, h_space, H5S_ALL, H5P_DEFAULT,
-             &(fewald_z[0][0][0]));
-    H5Dclose(h_data);
-    h_data = H5Dcreate(h_file, "Ewald_pot", H5T_NATIVE_FLOAT, h_space,
-                       H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-    H5Dwrite(h_data, H5T_NATIVE_FLOAT, h_space, H5S_ALL, H5P_DEFAULT,
-             &(potewald[0][0][0]));
-    H5Dclose(h_data);
-    H5Sclose(h_space);
+  const hid_t h_file = H5Fopen(file_name, H5F_ACC_RDONLY, H5P_DEFAULT);
+  if (h_file < 0) error("Error opening the old '%s' file.", file_name);
+
+  /* Check the table size */
+  const hid_t h_grp = H5Gopen1(h_file, "Info");
+  const hid_t h_attr = H5Aopen(h_grp, "Ewald_size", H5P_DEFAULT);
+  int size;
+  H5Aread(h_attr, H5T_NATIVE_INT, &size);
+  H5Aclose(h_attr);
+  H5Gclose(h_grp);
+  if (size != Newald) {
     H5Fclose(h_file);
+    return 0;
+  }
+
+  /* Now read the tables themselves */
+  hid_t h_data;
+  h_data = H5Dopen(h_file, "Ewald_x", H5P_DEFAULT);
+  H5Dread(h_data, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+          &(fewald_x[0][0][0]));
+  H5Dclose(h_data);
+  h_data = H5Dopen(h_file, "Ewald_y", H5P_DEFAULT);
+  H5Dread(h_data, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+          &(fewald_y[0][0][0]));
+  H5Dclose(h_data);
+  h_data = H5Dopen(h_file, "Ewald_z", H5P_DEFAULT);
+  H5Dread(h_data, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+          &(fewald_z[0][0][0]));
+  H5Dclose(h_data);
+  h_data = H5Dopen(h_file, "Ewald_pot", H5P_DEFAULT);
+  H5Dread(h_data, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+          &(potewald[0][0][0]));
+  H5Dclose(h_data);
+
+  /* Done */
+  H5Fclose(h_file);
+  return 1;
+#else
+  return 0;
 #endif
+}
+
+/**
+ * @brief Writes the (box-size independent) Ewald correction table to a file.
+ *
+ * @param file_name The name of the file.
+ */
+static void gravity_exact_force_ewald_write(const char *file_name) {
 
-    /* Report time this took */
-    message("Ewald correction table computed (took %.3f %s). ",
-            clocks_from_ticks(getticks() - tic), clocks_getunit());
+#ifdef HAVE_HDF5
+  hid_t h_file = H5Fcreate(file_name, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  if (h_file < 0)
+    error("Error while opening file '%s' for Ewald dump.", file_name);
+
+  /* Write the Ewald table size */
+  const int size = Newald;
+  const hid_t h_grp = H5Gcreate1(h_file, "Info", 0);
+  const hid_t h_aspace = H5Screate(H5S_SCALAR);
+  hid_t h_att =
+      H5Acreate1(h_grp, "Ewald_size", H5T_NATIVE_INT, h_aspace, H5P_DEFAULT);
+  H5Awrite(h_att, H5T_NATIVE_INT, &size);
+  H5Aclose(h_att);
+  H5Gclose(h_grp);
+  H5Sclose(h_aspace);
+
+  /* Create dataspace and write arrays */
+  hsize_t dim[3] = {Newald + 1, Newald + 1, Newald + 1};
+  hid_t h_space = H5Screate_simple(3, dim, NULL);
+  hid_t h_data;
+  h_data = H5Dcreate(h_file, "Ewald_x", H5T_NATIVE_FLOAT, h_space, H5P_DEFAULT,
+                     H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(h_data, H5T_NATIVE_FLOAT, h_space, H5S_ALL, H5P_DEFAULT,
+           &(fewald_x[0][0][0]));
+  H5Dclose(h_data);
+  h_data = H5Dcreate(h_file, "Ewald_y", H5T_NATIVE_FLOAT, h_space, H5P_DEFAULT,
+                     H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(h_data, H5T_NATIVE_FLOAT, h_space, H5S_ALL, H5P_DEFAULT,
+           &(fewald_y[0][0][0]));
+  H5Dclose(h_data);
+  h_data = H5Dcreate(h_file, "Ewald_z", H5T_NATIVE_FLOAT, h_space, H5P_DEFAULT,
+                     H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(h_data, H5T_NATIVE_FLOAT, h_space, H5S_ALL, H5P_DEFAULT,
+           &(fewald_z[0][0][0]));
+  H5Dclose(h_data);
+  h_data = H5Dcreate(h_file, "Ewald_pot", H5T_NATIVE_FLOAT, h_space,
+                     H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(h_data, H5T_NATIVE_FLOAT, h_space, H5S_ALL, H5P_DEFAULT,
+           &(potewald[0][0][0]));
+  H5Dclose(h_data);
+  H5Sclose(h_space);
+  H5Fclose(h_file);
+#endif
+}
+#endif /* SWIFT_GRAVITY_FORCE_CHECKS */
+
+/**
+ * @brief Allocates the memory and computes one octant of the
+ * Ewald correction table.
+ *
+ * The table does not depend on the box size and is cached in an HDF5 file.
+ * It is only computed (in parallel using the threadpool) if that file does
+ * not exist or contains a table of a different size. Over MPI, only rank 0
+ * reads or computes the table and it then broadcasts it to the other ranks.
+ *
+ * @param boxSize The side-length (L) of the volume.
+ * @param file_name The name of the file caching the table.
+ * @param tp The #threadpool to use for the calculation (can be NULL).
+ */
+void gravity_exact_force_ewald_init(const double boxSize,
+                                    const char *file_name,
+                                    struct threadpool *tp) {
+
+#ifdef SWIFT_GRAVITY_FORCE_CHECKS
+
+  const float boxSize_inv = 1.f / boxSize;
+  const float boxSize_inv2 = 1.f / (boxSize * boxSize);
+
+  if (engine_rank == 0) {
+
+    int have_table = 0;
+
+    /* Can we use the stored HDF5 file? */
+#ifdef HAVE_HDF5
+    if (access(file_name, R_OK) != -1) {
+
+      const ticks tic = getticks();
+      message("Reading Ewald correction table from file '%s'...", file_name);
+
+      have_table = gravity_exact_force_ewald_read(file_name);
+
+      if (have_table)
+        message("Ewald correction table read in (took %.3f %s). ",
+                clocks_from_ticks(getticks() - tic), clocks_getunit());
+      else
+        message(
+            "WARNING: File '%s' contains arrays of the wrong size. "
+            "Recomputing the table.",
+            file_name);
+    }
+#endif
+
+    if (!have_table) {
+
+      /* Ok.. let's recompute everything */
+      const ticks tic = getticks();
+      message("Computing Ewald correction table...");
+
+      /* Zero everything */
+      bzero(fewald_x,
+            (Newald + 1) * (Newald + 1) * (Newald + 1) * sizeof(float));
+      bzero(fewald_y,
+            (Newald + 1) * (Newald + 1) * (Newald + 1) * sizeof(float));
+      bzero(fewald_z,
+            (Newald + 1) * (Newald + 1) * (Newald + 1) * sizeof(float));
+      bzero(potewald,
+            (Newald + 1) * (Newald + 1) * (Newald + 1) * sizeof(float));
+
+      /* Hernquist, Bouchet & Suto, 1991, Eq. 2.10 and just below Eq. 2.15 */
+      potewald[0][0][0] = 2.8372975f;
+
+      /* Compute the values in one of the octants */
+      int planes[Newald + 1];
+      for (int i = 0; i <= Newald; ++i) planes[i] = i;
+      if (tp != NULL)
+        threadpool_map(tp, gravity_exact_force_ewald_mapper, planes,
+                       Newald + 1, sizeof(int), /*chunk=*/1, NULL);
+      else
+        gravity_exact_force_ewald_mapper(planes, Newald + 1, NULL);
+
+      /* Dump the Ewald table to a file */
+      gravity_exact_force_ewald_write(file_name);
+
+      /* Report time this took */
+      message("Ewald correction table computed (took %.3f %s). ",
+              clocks_from_ticks(getticks() - tic), clocks_getunit());
+    }
   }
 
+#ifdef WITH_MPI
+  /* Share the table with everyone */
+  const int count = (Newald + 1) * (Newald + 1) * (Newald + 1);
+  MPI_Bcast(&(fewald_x[0][0][0]), count, MPI_FLOAT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&(fewald_y[0][0][0]), count, MPI_FLOAT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&(fewald_z[0][0][0]), count, MPI_FLOAT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&(potewald[0][0][0]), count, MPI_FLOAT, 0, MPI_COMM_WORLD);
+#endif
+
   /* Ewald factor to access the table */
   ewald_fac = (double)(2 * Newald) / boxSize;
 
@@ -443,12 +610,21 @@ int gravity_exact_force_file_exits(const struct engine *e) {
     sscanf(line, "%s %s %d", dummy1, dummy2, &N);
     if (fgets(line, 100, file) != line) error("Problem reading BC");
     sscanf(line, "%s %s %d", dummy1, dummy2, &periodic);
+
+    /* Files without this line were computed by direct summation */
+    int tree = 0;
+    double theta = 0.;
+    if (fgets(line, 100, file) == line && strncmp(line, "# tree=", 7) == 0)
+      sscanf(line, "%s %s %d %le", dummy1, dummy2, &tree, &theta);
     fclose(file);
 
     /* Check whether it matches the current parameters */
     if (N == SWIFT_GRAVITY_FORCE_CHECKS && periodic == e->s->periodic &&
         (fabs(newton_G - e->physical_constants->const_newton_G) / newton_G <
-         1e-5)) {
+         1e-5) &&
+        tree == e->force_checks_tree_reference &&
+        (!tree || fabs(theta - e->force_checks_tree_opening_angle) <
+                      1e-5 * theta)) {
       return 1;
     }
   }
@@ -459,6 +635,554 @@ int gravity_exact_force_file_exits(const struct engine *e) {
 #endif
 }
 
+#ifdef SWIFT_GRAVITY_FORCE_CHECKS
+/**
+ * @brief Adds the contribution of one particle to the exact acceleration of
+ * another one.
+ *
+ * @param e The #engine.
+ * @param periodic Are we using periodic boundary conditions?
+ * @param dx x-component of the (periodically wrapped) separation x_j - x_i.
+ * @param dy y-component of the (periodically wrapped) separation x_j - x_i.
+ * @param dz z-component of the (periodically wrapped) separation x_j - x_i.
+ * @param mj Mass of the particle exerting the force.
+ * @param hi Softening length of the particle receiving the force.
+ * @param acc The #exact_force_accumulator to add to.
+ */
+static void gravity_exact_force_pp(const struct engine *e, const int periodic,
+                                   const double dx, const double dy,
+                                   const double dz, const double mj,
+                                   const double hi,
+                                   struct exact_force_accumulator *acc) {
+
+  const double hi_inv = 1. / hi;
+  const double hi_inv3 = hi_inv * hi_inv * hi_inv;
+  const double r2 = dx * dx + dy * dy + dz * dz;
+  const double r_inv = 1. / sqrt(r2);
+  const double r = r2 * r_inv;
+  double f, phi;
+
+  if (r >= hi) {
+
+    /* Get Newtonian gravity */
+    f = mj * r_inv * r_inv * r_inv;
+    phi = -mj * r_inv;
+
+  } else {
+
+    const double ui = r * hi_inv;
+    double Wf, Wp;
+
+    kernel_grav_eval_force_double(ui, &Wf);
+    kernel_grav_eval_pot_double(ui, &Wp);
+
+    /* Get softened gravity */
+    f = mj * hi_inv3 * Wf;
+    phi = mj * hi_inv * Wp;
+  }
+
+  acc->a_grav[0] += f * dx;
+  acc->a_grav[1] += f * dy;
+  acc->a_grav[2] += f * dz;
+  acc->pot += phi;
+
+  /* Apply Ewald correction for periodic BC
+   *
+   * We also want to check what the tree and mesh do so we want to mimic
+   * that:
+   * - a_grav_short is the total acceleration multiplied by the
+   * short-range correction.
+   * - a_grav_long is the total acceleration (including Ewald correction)
+   * minus the short-range acceleration.
+   */
+  if (periodic && r > 1e-5 * hi) {
+
+    /* Compute trunctation for long and short range forces */
+    const double r_s_inv = e->mesh->r_s_inv;
+    const double u_lr = r * r_s_inv;
+    double corr_f_lr;
+    kernel_long_grav_force_eval_double(u_lr, &corr_f_lr);
+
+    acc->a_grav_short[0] += f * dx * corr_f_lr;
+    acc->a_grav_short[1] += f * dy * corr_f_lr;
+    acc->a_grav_short[2] += f * dz * corr_f_lr;
+
+    acc->a_grav_long[0] += f * dx * (1. - corr_f_lr);
+    acc->a_grav_long[1] += f * dy * (1. - corr_f_lr);
+    acc->a_grav_long[2] += f * dz * (1. - corr_f_lr);
+
+    /* Ewald correction. */
+    double corr_f[3], corr_pot;
+    gravity_exact_force_ewald_evaluate(dx, dy, dz, corr_f, &corr_pot);
+
+    acc->a_grav[0] += mj * corr_f[0];
+    acc->a_grav[1] += mj * corr_f[1];
+    acc->a_grav[2] += mj * corr_f[2];
+    acc->pot += mj * corr_pot;
+
+    acc->a_grav_long[0] += mj * corr_f[0];
+    acc->a_grav_long[1] += mj * corr_f[1];
+    acc->a_grav_long[2] += mj * corr_f[2];
+  }
+}
+
+/**
+ * @brief Stores the exact acceleration of a #gpart.
+ *
+ * @param gp The #gpart.
+ * @param acc The #exact_force_accumulator.
+ * @param const_G Newton's constant.
+ */
+static void gravity_exact_force_store(struct gpart *gp,
+                                      const struct exact_force_accumulator *acc,
+                                      const double const_G) {
+  for (int k = 0; k < 3; k++) {
+    gp->a_grav_exact[k] = acc->a_grav[k] * const_G;
+    gp->a_grav_exact_short[k] = acc->a_grav_short[k] * const_G;
+    gp->a_grav_exact_long[k] = acc->a_grav_long[k] * const_G;
+  }
+  gp->potential_exact = acc->pot * const_G;
+}
+
+/**
+ * @brief Returns the ID of the particle a #gpart belongs to.
+ *
+ * @param gp The #gpart.
+ * @param s The #space.
+ */
+static long long gravity_exact_force_get_id(const struct gpart *gp,
+                                            const struct space *s) {
+  if (gp->type == swift_type_gas)
+    return s->parts[-gp->id_or_neg_offset].id;
+  else if (gp->type == swift_type_stars)
+    return s->sparts[-gp->id_or_neg_offset].id;
+  else if (gp->type == swift_type_black_hole)
+    return s->bparts[-gp->id_or_neg_offset].id;
+  else
+    return gp->id_or_neg_offset;
+}
+
+/**
+ * @brief Computes the Ewald correction due to an extended mass distribution.
+ *
+ * The correction is expanded to second order around the centre of mass of
+ * the distribution. The second derivatives of the correction are obtained by
+ * finite differences of the table over one table cell.
+ *
+ * @param rx x-coordinate of the distance vector to the centre of mass.
+ * @param ry y-coordinate of the distance vector to the centre of mass.
+ * @param rz z-coordinate of the distance vector to the centre of mass.
+ * @param mass The total mass of the distribution.
+ * @param Q The second moments of the distribution (xx, yy, zz, xy, xz, yz).
+ * @param corr_f (return) The Ewald correction for the force.
+ * @param corr_p (return) The Ewald correction for the potential.
+ */
+static void gravity_exact_force_ewald_node(const double rx, const double ry,
+                                           const double rz, const double mass,
+                                           const double Q[6], double corr_f[3],
+                                           double *corr_p) {
+
+  const double h = 1. / ewald_fac;
+  const double h2_inv = 1. / (h * h);
+  const double r[3] = {rx, ry, rz};
+
+  /* Values at the centre of mass: [0..2] is the force, [3] the potential */
+  double f0[4];
+  gravity_exact_force_ewald_evaluate(rx, ry, rz, f0, &f0[3]);
+
+  /* Second derivatives of the four quantities */
+  double H[6][4];
+
+  /* Diagonal terms */
+  for (int a = 0; a < 3; ++a) {
+    double p[3] = {r[0], r[1], r[2]}, m[3] = {r[0], r[1], r[2]};
+    p[a] += h;
+    m[a] -= h;
+    double fp[4], fm[4];
+    gravity_exact_force_ewald_evaluate(p[0], p[1], p[2], fp, &fp[3]);
+    gravity_exact_force_ewald_evaluate(m[0], m[1], m[2], fm, &fm[3]);
+    for (int n = 0; n < 4; ++n)
+      H[a][n] = (fp[n] - 2. * f0[n] + fm[n]) * h2_inv;
+  }
+
+  /* Off-diagonal terms */
+  const int pairs[3][2] = {{0, 1}, {0, 2}, {1, 2}};
+  for (int ind = 0; ind < 3; ++ind) {
+    const int a = pairs[ind][0], b = pairs[ind][1];
+    double f[4][4];
+    for (int corner = 0; corner < 4; ++corner) {
+      double x[3] = {r[0], r[1], r[2]};
+      x[a] += (corner & 1) ? -h : h;
+      x[b] += (corner & 2) ? -h : h;
+      gravity_exact_force_ewald_evaluate(x[0], x[1], x[2], f[corner],
+                                         &f[corner][3]);
+    }
+    for (int n = 0; n < 4; ++n)
+      H[3 + ind][n] = 0.25 * (f[0][n] - f[1][n] - f[2][n] + f[3][n]) * h2_inv;
+  }
+
+  /* Monopole and second-moment terms (the dipole vanishes around the CoM) */
+  double out[4];
+  for (int n = 0; n < 4; ++n) {
+    out[n] = mass * f0[n];
+    out[n] += 0.5 * (Q[0] * H[0][n] + Q[1] * H[1][n] + Q[2] * H[2][n]);
+    out[n] += Q[3] * H[3][n] + Q[4] * H[4][n] + Q[5] * H[5][n];
+  }
+
+  corr_f[0] = out[0];
+  corr_f[1] = out[1];
+  corr_f[2] = out[2];
+  *corr_p = out[3];
+}
+
+/**
+ * @brief Counts the non-empty cells in a hierarchy.
+ *
+ * @param c The #cell.
+ */
+static int gravity_exact_force_tree_count(const struct cell *c) {
+  if (c->grav.count == 0) return 0;
+  int count = 1;
+  if (c->split)
+    for (int k = 0; k < 8; ++k)
+      if (c->progeny[k] != NULL)
+        count += gravity_exact_force_tree_count(c->progeny[k]);
+  return count;
+}
+
+/**
+ * @brief Recursively constructs the reference tree below a (non-empty) cell.
+ *
+ * @param tree The #exact_force_tree.
+ * @param c The #cell.
+ * @param props The #gravity_props.
+ * @return The index of the node corresponding to the #cell.
+ */
+static int gravity_exact_force_tree_build(struct exact_force_tree *tree,
+                                          const struct cell *c,
+                                          const struct gravity_props *props) {
+
+  const int index = tree->nr_nodes++;
+  struct exact_force_tree_node *node = &tree->nodes[index];
+  node->gparts = c->grav.parts;
+  node->gcount = c->grav.count;
+  node->split = c->split;
+  node->valid = 1;
+  for (int k = 0; k < 8; ++k) node->progeny[k] = -1;
+
+  if (c->split) {
+
+    /* Construct the progeny first */
+    for (int k = 0; k < 8; ++k) {
+      if (c->progeny[k] != NULL && c->progeny[k]->grav.count > 0) {
+        node->progeny[k] =
+            gravity_exact_force_tree_build(tree, c->progeny[k], props);
+        node->valid &= tree->nodes[node->progeny[k]].valid;
+      }
+    }
+    if (!node->valid) return index;
+
+    /* Centre of mass of the progeny */
+    struct gravity_tensors *m = &node->multipole;
+    double mass = 0., com[3] = {0., 0., 0.};
+    for (int k = 0; k < 8; ++k) {
+      if (node->progeny[k] < 0) continue;
+      const struct gravity_tensors *mp =
+          &tree->nodes[node->progeny[k]].multipole;
+      mass += mp->m_pole.M_000;
+      for (int i = 0; i < 3; ++i) com[i] += mp->CoM[i] * mp->m_pole.M_000;
+    }
+    if (mass <= 0.) {
+      node->valid = 0;
+      return index;
+    }
+    for (int i = 0; i < 3; ++i) m->CoM[i] = com[i] / mass;
+
+    /* Shift the progeny multipoles and add them up */
+    gravity_multipole_init(&m->m_pole);
+    m->r_max = 0.;
+    for (int k = 0; k < 8; ++k) {
+      if (node->progeny[k] < 0) continue;
+      const struct gravity_tensors *mp =
+          &tree->nodes[node->progeny[k]].multipole;
+
+      struct multipole temp;
+      gravity_M2M(&temp, &mp->m_pole, m->CoM, mp->CoM);
+      gravity_multipole_add(&m->m_pole, &temp);
+
+      const double dx = m->CoM[0] - mp->CoM[0];
+      const double dy = m->CoM[1] - mp->CoM[1];
+      const double dz = m->CoM[2] - mp->CoM[2];
+      m->r_max = max(m->r_max, mp->r_max + sqrt(dx * dx + dy * dy + dz * dz));
+    }
+
+    /* Shift the second moments of the progeny */
+    for (int i = 0; i < 6; ++i) node->second_moments[i] = 0.;
+    for (int k = 0; k < 8; ++k) {
+      if (node->progeny[k] < 0) continue;
+      const struct exact_force_tree_node *np = &tree->nodes[node->progeny[k]];
+      const double mp = np->multipole.m_pole.M_000;
+      const double d[3] = {np->multipole.CoM[0] - m->CoM[0],
+                           np->multipole.CoM[1] - m->CoM[1],
+                           np->multipole.CoM[2] - m->CoM[2]};
+      node->second_moments[0] += np->second_moments[0] + mp * d[0] * d[0];
+      node->second_moments[1] += np->second_moments[1] + mp * d[1] * d[1];
+      node->second_moments[2] += np->second_moments[2] + mp * d[2] * d[2];
+      node->second_moments[3] += np->second_moments[3] + mp * d[0] * d[1];
+      node->second_moments[4] += np->second_moments[4] + mp * d[0] * d[2];
+      node->second_moments[5] += np->second_moments[5] + mp * d[1] * d[2];
+    }
+
+  } else {
+
+    /* Removed or extra particles cannot be part of a multipole */
+    double mass = 0.;
+    for (int k = 0; k < c->grav.count; ++k) {
+      const struct gpart *gp = &c->grav.parts[k];
+      if (gp->time_bin == time_bin_inhibited ||
+          gp->time_bin == time_bin_not_created)
+        node->valid = 0;
+      mass += gp->mass;
+    }
+    if (mass <= 0.) node->valid = 0;
+
+    if (!node->valid) return index;
+
+    gravity_P2M(&node->multipole, c->grav.parts, c->grav.count, props);
+
+    /* Second moments around the CoM */
+    const double *CoM = node->multipole.CoM;
+    for (int i = 0; i < 6; ++i) node->second_moments[i] = 0.;
+    for (int k = 0; k < c->grav.count; ++k) {
+      const struct gpart *gp = &c->grav.parts[k];
+      const double d[3] = {gp->x[0] - CoM[0], gp->x[1] - CoM[1],
+                           gp->x[2] - CoM[2]};
+      node->second_moments[0] += gp->mass * d[0] * d[0];
+      node->second_moments[1] += gp->mass * d[1] * d[1];
+      node->second_moments[2] += gp->mass * d[2] * d[2];
+      node->second_moments[3] += gp->mass * d[0] * d[1];
+      node->second_moments[4] += gp->mass * d[0] * d[2];
+      node->second_moments[5] += gp->mass * d[1] * d[2];
+    }
+  }
+
+  return index;
+}
+
+/**
+ * @brief Constructs the reference tree from the local cells.
+ *
+ * @param tree The #exact_force_tree to construct.
+ * @param s The #space.
+ * @param props The #gravity_props.
+ * @param theta The opening angle of the reference tree.
+ */
+static void gravity_exact_force_tree_init(struct exact_force_tree *tree,
+                                          const struct space *s,
+                                          const struct gravity_props *props,
+                                          const double theta) {
+
+  /* How much space do we need? */
+  int nr_nodes = 0;
+  for (int k = 0; k < s->nr_local_cells; ++k)
+    nr_nodes +=
+        gravity_exact_force_tree_count(&s->cells_top[s->local_cells_top[k]]);
+
+  tree->nodes = (struct exact_force_tree_node *)malloc(
+      max(nr_nodes, 1) * sizeof(struct exact_force_tree_node));
+  tree->top = (int *)malloc(max(s->nr_local_cells, 1) * sizeof(int));
+  if (tree->nodes == NULL || tree->top == NULL)
+    error("Failed to allocate the reference tree.");
+  tree->nr_nodes = 0;
+  tree->nr_top = 0;
+  tree->theta2 = theta * theta;
+
+  for (int k = 0; k < s->nr_local_cells; ++k) {
+    const struct cell *c = &s->cells_top[s->local_cells_top[k]];
+    if (c->grav.count > 0)
+      tree->top[tree->nr_top++] =
+          gravity_exact_force_tree_build(tree, c, props);
+  }
+
+  if (tree->nr_nodes != nr_nodes) error("Inconsistent reference tree size!");
+}
+
+/**
+ * @brief Frees the memory used by the reference tree.
+ *
+ * @param tree The #exact_force_tree.
+ */
+static void gravity_exact_force_tree_clean(struct exact_force_tree *tree) {
+  free(tree->nodes);
+  free(tree->top);
+}
+
+/**
+ * @brief Recursively adds the contribution of a node of the reference tree to
+ * the acceleration of a #gpart.
+ *
+ * A node is used as a multipole if it is seen under an angle smaller than the
+ * opening angle of the tree and if none of its particles is within the
+ * softening length of the #gpart. With periodic boundary conditions, all its
+ * particles must additionally be in the same periodic copy as its centre of
+ * mass; the Ewald correction is then expanded around the centre of mass.
+ *
+ * @param e The #engine.
+ * @param tree The #exact_force_tree.
+ * @param index The index of the node.
+ * @param gpi The #gpart receiving the force.
+ * @param hi The softening length of gpi.
+ * @param acc The #exact_force_accumulator to add to.
+ */
+static void gravity_exact_force_tree_walk(const struct engine *e,
+                                          const struct exact_force_tree *tree,
+                                          const int index,
+                                          const struct gpart *gpi,
+                                          const double hi,
+                                          struct exact_force_accumulator *acc) {
+
+  const struct exact_force_tree_node *node = &tree->nodes[index];
+  const struct space *s = e->s;
+  const int periodic = s->periodic;
+
+  if (node->valid && node->gcount > 1) {
+
+    const struct gravity_tensors *m = &node->multipole;
+    double dx = m->CoM[0] - gpi->x[0];
+    double dy = m->CoM[1] - gpi->x[1];
+    double dz = m->CoM[2] - gpi->x[2];
+    if (periodic) {
+      dx = nearest(dx, s->dim[0]);
+      dy = nearest(dy, s->dim[1]);
+      dz = nearest(dz, s->dim[2]);
+    }
+    const double r2 = dx * dx + dy * dy + dz * dz;
+    const double r_max = m->r_max;
+
+    int accept = r_max * r_max < tree->theta2 * r2 && sqrt(r2) - r_max > hi;
+    if (periodic)
+      accept = accept && fabs(dx) + r_max < 0.5 * s->dim[0] &&
+               fabs(dy) + r_max < 0.5 * s->dim[1] &&
+               fabs(dz) + r_max < 0.5 * s->dim[2];
+
+    if (accept) {
+
+      const float h = hi;
+      const float h_inv = 1.f / h;
+      float f_x, f_y, f_z, pot;
+      runner_iact_grav_pm_full(dx, dy, dz, r2, h, h_inv, &m->m_pole, &f_x,
+                               &f_y, &f_z, &pot);
+
+      acc->a_grav[0] += f_x;
+      acc->a_grav[1] += f_y;
+      acc->a_grav[2] += f_z;
+      acc->pot += pot;
+
+      if (periodic) {
+
+        /* Short-range part as computed by the tree */
+        float f_x_s, f_y_s, f_z_s, pot_s;
+        runner_iact_grav_pm_truncated(dx, dy, dz, r2, h, h_inv,
+                                      e->mesh->r_s_inv, &m->m_pole, &f_x_s,
+                                      &f_y_s, &f_z_s, &pot_s);
+
+        acc->a_grav_short[0] += f_x_s;
+        acc->a_grav_short[1] += f_y_s;
+        acc->a_grav_short[2] += f_z_s;
+
+        acc->a_grav_long[0] += f_x - f_x_s;
+        acc->a_grav_long[1] += f_y - f_y_s;
+        acc->a_grav_long[2] += f_z - f_z_s;
+
+        /* Ewald correction of the node */
+        double corr_f[3], corr_pot;
+        gravity_exact_force_ewald_node(dx, dy, dz, m->m_pole.M_000,
+                                       node->second_moments, corr_f,
+                                       &corr_pot);
+
+        acc->a_grav[0] += corr_f[0];
+        acc->a_grav[1] += corr_f[1];
+        acc->a_grav[2] += corr_f[2];
+        acc->pot += corr_pot;
+
+        acc->a_grav_long[0] += corr_f[0];
+        acc->a_grav_long[1] += corr_f[1];
+        acc->a_grav_long[2] += corr_f[2];
+      }
+      return;
+    }
+  }
+
+  if (node->split) {
+    for (int k = 0; k < 8; ++k)
+      if (node->progeny[k] >= 0)
+        gravity_exact_force_tree_walk(e, tree, node->progeny[k], gpi, hi, acc);
+    return;
+  }
+
+  /* Direct summation over the particles of the leaf */
+  for (int j = 0; j < node->gcount; ++j) {
+
+    const struct gpart *gpj = &node->gparts[j];
+
+    /* No self interaction and no removed or extra particles */
+    if (gpi == gpj || gpj->time_bin == time_bin_inhibited ||
+        gpj->time_bin == time_bin_not_created)
+      continue;
+
+    double dx = gpj->x[0] - gpi->x[0];
+    double dy = gpj->x[1] - gpi->x[1];
+    double dz = gpj->x[2] - gpi->x[2];
+    if (periodic) {
+      dx = nearest(dx, s->dim[0]);
+      dy = nearest(dy, s->dim[1]);
+      dz = nearest(dz, s->dim[2]);
+    }
+
+    gravity_exact_force_pp(e, periodic, dx, dy, dz, gpj->mass, hi, acc);
+  }
+}
+
+/**
+ * @brief Mapper function for the reference gravity calculation using the
+ * high-accuracy tree.
+ */
+static void gravity_exact_force_tree_mapper(void *map_data, int nr_gparts,
+                                            void *extra_data) {
+
+  /* Unpack the data */
+  struct gpart *restrict gparts = (struct gpart *)map_data;
+  struct exact_force_data *data = (struct exact_force_data *)extra_data;
+  const struct engine *e = data->e;
+  const struct exact_force_tree *tree = data->tree;
+  int counter = 0;
+
+  for (int i = 0; i < nr_gparts; ++i) {
+
+    struct gpart *gpi = &gparts[i];
+    const long long id = gravity_exact_force_get_id(gpi, data->s);
+
+    /* Is the particle active and part of the subset to be tested ? */
+    if (id % SWIFT_GRAVITY_FORCE_CHECKS == 0 && gpart_is_active(gpi, e)) {
+
+      const double hi = gravity_get_softening(gpi, e->gravity_properties);
+
+      struct exact_force_accumulator acc;
+      bzero(&acc, sizeof(struct exact_force_accumulator));
+
+      for (int k = 0; k < tree->nr_top; ++k)
+        gravity_exact_force_tree_walk(e, tree, tree->top[k], gpi, hi, &acc);
+
+      /* Store the reference answer */
+      gravity_exact_force_store(gpi, &acc, data->const_G);
+
+      counter++;
+    }
+  }
+  atomic_add(&data->counter_global, counter);
+}
+#endif /* SWIFT_GRAVITY_FORCE_CHECKS */
+
 /**
  * @brief Mapper function for the exact gravity calculation.
  */
@@ -470,13 +1194,9 @@ void gravity_exact_force_compute_mapper(void *map_data, int nr_gparts,
   struct gpart *restrict gparts = (struct gpart *)map_data;
   struct exact_force_data *data = (struct exact_force_data *)extra_data;
   const struct space *s = data->s;
-  const struct part *parts = s->parts;
-  const struct spart *sparts = s->sparts;
-  const struct bpart *bparts = s->bparts;
   const struct engine *e = data->e;
   const int periodic = s->periodic;
   const double dim[3] = {s->dim[0], s->dim[1], s->dim[2]};
-  const double const_G = data->const_G;
   int counter = 0;
 
   for (int i = 0; i < nr_gparts; ++i) {
@@ -484,15 +1204,7 @@ void gravity_exact_force_compute_mapper(void *map_data, int nr_gparts,
     struct gpart *gpi = &gparts[i];
 
     /* Get the particle ID */
-    long long id = 0;
-    if (gpi->type == swift_type_gas)
-      id = parts[-gpi->id_or_neg_offset].id;
-    else if (gpi->type == swift_type_stars)
-      id = sparts[-gpi->id_or_neg_offset].id;
-    else if (gpi->type == swift_type_black_hole)
-      id = bparts[-gpi->id_or_neg_offset].id;
-    else
-      id = gpi->id_or_neg_offset;
+    const long long id = gravity_exact_force_get_id(gpi, s);
 
     /* Is the particle active and part of the subset to be tested ? */
     if (id % SWIFT_GRAVITY_FORCE_CHECKS == 0 && gpart_is_active(gpi, e)) {
@@ -500,14 +1212,10 @@ void gravity_exact_force_compute_mapper(void *map_data, int nr_gparts,
       /* Get some information about the particle */
       const double pix[3] = {gpi->x[0], gpi->x[1], gpi->x[2]};
       const double hi = gravity_get_softening(gpi, e->gravity_properties);
-      const double hi_inv = 1. / hi;
-      const double hi_inv3 = hi_inv * hi_inv * hi_inv;
 
       /* Be ready for the calculation */
-      double a_grav[3] = {0., 0., 0.};
-      double a_grav_short[3] = {0., 0., 0.};
-      double a_grav_long[3] = {0., 0., 0.};
-      double pot = 0.;
+      struct exact_force_accumulator acc;
+      bzero(&acc, sizeof(struct exact_force_accumulator));
 
       /* Interact it with all other particles in the space.*/
       for (int j = 0; j < (int)s->nr_gparts; ++j) {
@@ -535,83 +1243,11 @@ void gravity_exact_force_compute_mapper(void *map_data, int nr_gparts,
           dz = nearest(dz, dim[2]);
         }
 
-        const double r2 = dx * dx + dy * dy + dz * dz;
-        const double r_inv = 1. / sqrt(r2);
-        const double r = r2 * r_inv;
-        const double mj = gpj->mass;
-        double f, phi;
-
-        if (r >= hi) {
-
-          /* Get Newtonian gravity */
-          f = mj * r_inv * r_inv * r_inv;
-          phi = -mj * r_inv;
-
-        } else {
-
-          const double ui = r * hi_inv;
-          double Wf, Wp;
-
-          kernel_grav_eval_force_double(ui, &Wf);
-          kernel_grav_eval_pot_double(ui, &Wp);
-
-          /* Get softened gravity */
-          f = mj * hi_inv3 * Wf;
-          phi = mj * hi_inv * Wp;
-        }
-
-        a_grav[0] += f * dx;
-        a_grav[1] += f * dy;
-        a_grav[2] += f * dz;
-        pot += phi;
-
-        /* Apply Ewald correction for periodic BC
-         *
-         * We also want to check what the tree and mesh do so we want to mimic
-         * that:
-         * - a_grav_short is the total acceleration multiplied by the
-         * short-range correction.
-         * - a_grav_long is the total acceleration (including Ewald correction)
-         * minus the short-range acceleration.
-         */
-        if (periodic && r > 1e-5 * hi) {
-
-          /* Compute trunctation for long and short range forces */
-          const double r_s_inv = e->mesh->r_s_inv;
-          const double u_lr = r * r_s_inv;
-          double corr_f_lr;
-          kernel_long_grav_force_eval_double(u_lr, &corr_f_lr);
-
-          a_grav_short[0] += f * dx * corr_f_lr;
-          a_grav_short[1] += f * dy * corr_f_lr;
-          a_grav_short[2] += f * dz * corr_f_lr;
-
-          a_grav_long[0] += f * dx * (1. - corr_f_lr);
-          a_grav_long[1] += f * dy * (1. - corr_f_lr);
-          a_grav_long[2] += f * dz * (1. - corr_f_lr);
-
-          /* Ewald correction. */
-          double corr_f[3], corr_pot;
-          gravity_exact_force_ewald_evaluate(dx, dy, dz, corr_f, &corr_pot);
-
-          a_grav[0] += mj * corr_f[0];
-          a_grav[1] += mj * corr_f[1];
-          a_grav[2] += mj * corr_f[2];
-          pot += mj * corr_pot;
-
-          a_grav_long[0] += mj * corr_f[0];
-          a_grav_long[1] += mj * corr_f[1];
-          a_grav_long[2] += mj * corr_f[2];
-        }
+        gravity_exact_force_pp(e, periodic, dx, dy, dz, gpj->mass, hi, &acc);
       }
 
       /* Store the exact answer */
-      for (int k = 0; k < 3; k++) {
-        gpi->a_grav_exact[k] = a_grav[k] * const_G;
-        gpi->a_grav_exact_short[k] = a_grav_short[k] * const_G;
-        gpi->a_grav_exact_long[k] = a_grav_long[k] * const_G;
-      }
-      gpi->potential_exact = pot * const_G;
+      gravity_exact_force_store(gpi, &acc, data->const_G);
 
       counter++;
     }
@@ -649,16 +1285,38 @@ void gravity_exact_force_compute(struct space *s, const struct engine *e) {
   struct exact_force_data data;
   data.e = e;
   data.s = s;
+  data.tree = NULL;
   data.counter_global = 0;
   data.const_G = e->physical_constants->const_newton_G;
 
-  threadpool_map(&s->e->threadpool, gravity_exact_force_compute_mapper,
-                 s->gparts, s->nr_gparts, sizeof(struct gpart),
-                 threadpool_auto_chunk_size, &data);
+  if (e->force_checks_tree_reference) {
 
-  message("Computed exact gravity for %d gparts (took %.3f %s). ",
-          data.counter_global, clocks_from_ticks(getticks() - tic),
-          clocks_getunit());
+    /* Use a very accurate tree built from the current positions */
+    struct exact_force_tree tree;
+    gravity_exact_force_tree_init(&tree, s, e->gravity_properties,
+                                  e->force_checks_tree_opening_angle);
+    data.tree = &tree;
+
+    threadpool_map(&s->e->threadpool, gravity_exact_force_tree_mapper,
+                   s->gparts, s->nr_gparts, sizeof(struct gpart),
+                   threadpool_auto_chunk_size, &data);
+
+    gravity_exact_force_tree_clean(&tree);
+
+    message("Computed reference gravity (tree) for %d gparts (took %.3f %s). ",
+            data.counter_global, clocks_from_ticks(getticks() - tic),
+            clocks_getunit());
+
+  } else {
+
+    threadpool_map(&s->e->threadpool, gravity_exact_force_compute_mapper,
+                   s->gparts, s->nr_gparts, sizeof(struct gpart),
+                   threadpool_auto_chunk_size, &data);
+
+    message("Computed exact gravity for %d gparts (took %.3f %s). ",
+            data.counter_global, clocks_from_ticks(getticks() - tic),
+            clocks_getunit());
+  }
 
 #else
   error("Gravity checking function called without the corresponding flag.");
@@ -769,6 +1427,9 @@ void gravity_exact_force_check(struct space *s, const struct engine *e,
     fprintf(file_exact, "# G= %16.8e\n", e->physical_constants->const_newton_G);
     fprintf(file_exact, "# N= %d\n", SWIFT_GRAVITY_FORCE_CHECKS);
     fprintf(file_exact, "# periodic= %d\n", s->periodic);
+    if (e->force_checks_tree_reference)
+      fprintf(file_exact, "# tree= %d %16.8e\n", 1,
+              e->force_checks_tree_opening_angle);
     fprintf(file_exact, "# Git Branch: %s\n", git_branch());
     fprintf(file_exact, "# Git Revision: %s\n", git_revision());
     fprintf(file_exact,
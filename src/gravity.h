@@ -40,8 +40,10 @@
 
 struct engine;
 struct space;
+struct threadpool;
 
-void gravity_exact_force_ewald_init(double boxSize);
+void gravity_exact_force_ewald_init(double boxSize, const char *file_name,
+                                    struct threadpool *tp);
 void gravity_exact_force_ewald_free(void);
 void gravity_exact_force_ewald_evaluate(double rx, double ry, double rz,
                                         double corr_f[3], double *corr_p);
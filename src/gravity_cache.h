@@ -25,8 +25,11 @@
 /* Local headers */
 #include "accumulate.h"
 #include "align.h"
+#include "atomic.h"
 #include "error.h"
 #include "gravity.h"
+#include "lock.h"
+#include "memuse.h"
 #include "multipole_accept.h"
 #include "vector.h"
 
@@ -510,4 +513,514 @@ INLINE static void gravity_cache_write_back(const struct gravity_cache *c,
   }
 }
 
+/**
+ * @brief A persistent SoA copy of the #gpart of a leaf cell.
+ *
+ * The mirror is filled once per engine launch from the drifted #gpart and is
+ * then shared by all the P-P and M-P tasks acting on the cell. The forces
+ * computed by these tasks are accumulated in the mirror and only written back
+ * to the #gpart once, in the end-force stage.
+ */
+struct gravity_mirror {
+
+  /*! #gpart x position. */
+  float *restrict x;
+
+  /*! #gpart y position. */
+  float *restrict y;
+
+  /*! #gpart z position. */
+  float *restrict z;
+
+  /*! #gpart softening length. */
+  float *restrict epsilon;
+
+  /*! #gpart mass. */
+  float *restrict m;
+
+  /*! Accumulated #gpart x acceleration. */
+  float *restrict a_x;
+
+  /*! Accumulated #gpart y acceleration. */
+  float *restrict a_y;
+
+  /*! Accumulated #gpart z acceleration. */
+  float *restrict a_z;
+
+  /*! Accumulated #gpart potential. */
+  float *restrict pot;
+
+  /*! Is this #gpart active ? */
+  int *restrict active;
+
+  /*! Next mirror allocated outside of the pool's slab (if any). */
+  struct gravity_mirror *next_overflow;
+
+  /*! Number of #gpart in the mirror */
+  int count;
+
+  /*! Number of #gpart in the mirror padded to the vector length */
+  int count_padded;
+};
+
+/**
+ * @brief A pool from which the #gravity_mirror of the cells are allocated.
+ *
+ * All the mirrors live in a single slab that is recycled at every engine
+ * launch. Mirrors that do not fit in the slab are allocated individually and
+ * the slab is grown to accommodate them at the next reset.
+ */
+struct gravity_mirror_pool {
+
+  /*! The slab of memory the mirrors are carved from. */
+  char *data;
+
+  /*! Size of the slab in bytes. */
+  size_t size;
+
+  /*! Number of bytes of the slab handed out since the last reset. */
+  size_t used;
+
+  /*! Mirrors that did not fit in the slab. */
+  struct gravity_mirror *overflow;
+
+  /*! Total size in bytes of the mirrors that did not fit in the slab. */
+  size_t overflow_size;
+
+  /*! Lock protecting the list of overflow mirrors. */
+  swift_lock_type lock;
+
+  /*! Counter incremented at every reset. Mirrors of older epochs are stale. */
+  int epoch;
+};
+
+/**
+ * @brief Round a number of bytes up to the cache alignment.
+ *
+ * @param size The number of bytes.
+ */
+__attribute__((const)) INLINE static size_t gravity_mirror_align(
+    const size_t size) {
+  return (size + SWIFT_CACHE_ALIGNMENT - 1) / SWIFT_CACHE_ALIGNMENT *
+         SWIFT_CACHE_ALIGNMENT;
+}
+
+/**
+ * @brief Number of bytes required by a #gravity_mirror holding a given
+ * number of #gpart.
+ *
+ * @param count The number of #gpart.
+ */
+__attribute__((const)) INLINE static size_t gravity_mirror_size(
+    const int count) {
+
+  const int padded_count = count - (count % VEC_SIZE) + VEC_SIZE;
+  return gravity_mirror_align(sizeof(struct gravity_mirror)) +
+         9 * gravity_mirror_align(padded_count * sizeof(float)) +
+         gravity_mirror_align(padded_count * sizeof(int));
+}
+
+/**
+ * @brief Initialises an empty #gravity_mirror_pool.
+ *
+ * @param pool The #gravity_mirror_pool.
+ */
+static INLINE void gravity_mirror_pool_init(struct gravity_mirror_pool *pool) {
+
+  pool->data = NULL;
+  pool->size = 0;
+  pool->used = 0;
+  pool->overflow = NULL;
+  pool->overflow_size = 0;
+  pool->epoch = 0;
+  if (lock_init(&pool->lock) != 0)
+    error("Failed to initialise the gravity mirror pool lock.");
+}
+
+/**
+ * @brief Frees the overflow mirrors of a #gravity_mirror_pool.
+ *
+ * @param pool The #gravity_mirror_pool.
+ */
+static INLINE void gravity_mirror_pool_free_overflow(
+    struct gravity_mirror_pool *pool) {
+
+  while (pool->overflow != NULL) {
+    struct gravity_mirror *next = pool->overflow->next_overflow;
+    swift_free("gravity_mirror", pool->overflow);
+    pool->overflow = next;
+  }
+  pool->overflow_size = 0;
+}
+
+/**
+ * @brief Frees all the memory held by a #gravity_mirror_pool.
+ *
+ * @param pool The #gravity_mirror_pool.
+ */
+static INLINE void gravity_mirror_pool_clean(struct gravity_mirror_pool *pool) {
+
+  gravity_mirror_pool_free_overflow(pool);
+  if (pool->data != NULL) swift_free("gravity_mirror_pool", pool->data);
+  pool->data = NULL;
+  pool->size = 0;
+  pool->used = 0;
+  if (lock_destroy(&pool->lock) != 0)
+    error("Failed to destroy the gravity mirror pool lock.");
+}
+
+/**
+ * @brief Recycles all the mirrors of a #gravity_mirror_pool.
+ *
+ * All the mirrors handed out so far become stale. If the slab was too small
+ * to accommodate all the mirrors since the last reset, it is grown.
+ *
+ * This must not be called while tasks are running.
+ *
+ * @param pool The #gravity_mirror_pool.
+ */
+static INLINE void gravity_mirror_pool_reset(struct gravity_mirror_pool *pool) {
+
+  if (pool->overflow != NULL) {
+
+    /* Grow the slab with some margin */
+    const size_t new_size = 1.2 * (pool->size + pool->overflow_size);
+    gravity_mirror_pool_free_overflow(pool);
+    if (pool->data != NULL) swift_free("gravity_mirror_pool", pool->data);
+    if (swift_memalign("gravity_mirror_pool", (void **)&pool->data,
+                       SWIFT_CACHE_ALIGNMENT, new_size) != 0)
+      error("Failed to allocate the gravity mirror pool (%zd bytes).",
+            new_size);
+    pool->size = new_size;
+  }
+
+  pool->used = 0;
+  pool->epoch++;
+}
+
+/**
+ * @brief Gets a #gravity_mirror for a given number of #gpart from the pool.
+ *
+ * This function is thread-safe.
+ *
+ * @param pool The #gravity_mirror_pool.
+ * @param count The number of #gpart in the mirror.
+ */
+static INLINE struct gravity_mirror *gravity_mirror_pool_get(
+    struct gravity_mirror_pool *pool, const int count) {
+
+  const size_t size = gravity_mirror_size(count);
+  const int padded_count = count - (count % VEC_SIZE) + VEC_SIZE;
+
+  /* Try to get a chunk of the slab */
+  char *data;
+  const size_t offset = atomic_add(&pool->used, size);
+  if (offset + size <= pool->size) {
+    data = pool->data + offset;
+  } else {
+
+    /* Too bad. Allocate the mirror by itself and remember it */
+    if (swift_memalign("gravity_mirror", (void **)&data, SWIFT_CACHE_ALIGNMENT,
+                       size) != 0)
+      error("Failed to allocate a gravity mirror (%zd bytes).", size);
+
+    lock_lock(&pool->lock);
+    ((struct gravity_mirror *)data)->next_overflow = pool->overflow;
+    pool->overflow = (struct gravity_mirror *)data;
+    pool->overflow_size += size;
+    if (lock_unlock(&pool->lock) != 0) error("Failed to unlock the pool.");
+  }
+
+  /* Carve the arrays out of the chunk */
+  struct gravity_mirror *m = (struct gravity_mirror *)data;
+  const size_t sizeBytesF = gravity_mirror_align(padded_count * sizeof(float));
+  char *ptr = data + gravity_mirror_align(sizeof(struct gravity_mirror));
+  m->x = (float *)ptr;
+  m->y = (float *)(ptr += sizeBytesF);
+  m->z = (float *)(ptr += sizeBytesF);
+  m->epsilon = (float *)(ptr += sizeBytesF);
+  m->m = (float *)(ptr += sizeBytesF);
+  m->a_x = (float *)(ptr += sizeBytesF);
+  m->a_y = (float *)(ptr += sizeBytesF);
+  m->a_z = (float *)(ptr += sizeBytesF);
+  m->pot = (float *)(ptr += sizeBytesF);
+  m->active = (int *)(ptr += sizeBytesF);
+  m->count = count;
+  m->count_padded = padded_count;
+
+  return m;
+}
+
+/**
+ * @brief Fills a #gravity_mirror with the (drifted) #gpart of a cell and
+ * zeroes its accumulators.
+ *
+ * The values are identical to the ones #gravity_cache_populate() would
+ * produce without a shift.
+ *
+ * @param max_active_bin The largest active bin in the current time-step.
+ * @param m The #gravity_mirror to fill.
+ * @param gparts The #gpart array to read from.
+ * @param cell_width The width of the cell (to get reasonable padding
+ * positions).
+ * @param grav_props The global gravity properties.
+ */
+INLINE static void gravity_mirror_populate(
+    const timebin_t max_active_bin, struct gravity_mirror *m,
+    const struct gpart *restrict gparts, const double cell_width[3],
+    const struct gravity_props *grav_props) {
+
+  const int gcount = m->count;
+  const int gcount_padded = m->count_padded;
+
+  /* Make the compiler understand we are in happy vectorization land */
+  swift_declare_aligned_ptr(float, x, m->x, SWIFT_CACHE_ALIGNMENT);
+  swift_declare_aligned_ptr(float, y, m->y, SWIFT_CACHE_ALIGNMENT);
+  swift_declare_aligned_ptr(float, z, m->z, SWIFT_CACHE_ALIGNMENT);
+  swift_declare_aligned_ptr(float, epsilon, m->epsilon, SWIFT_CACHE_ALIGNMENT);
+  swift_declare_aligned_ptr(float, mass, m->m, SWIFT_CACHE_ALIGNMENT);
+  swift_declare_aligned_ptr(int, active, m->active, SWIFT_CACHE_ALIGNMENT);
+  swift_assume_size(gcount_padded, VEC_SIZE);
+
+  for (int i = 0; i < gcount; ++i) {
+
+    x[i] = (float)(gparts[i].x[0]);
+    y[i] = (float)(gparts[i].x[1]);
+    z[i] = (float)(gparts[i].x[2]);
+    epsilon[i] = gravity_get_softening(&gparts[i], grav_props);
+
+#ifdef SWIFT_DEBUG_CHECKS
+    if (gparts[i].time_bin == time_bin_not_created) {
+      error("Found an extra gpart in the gravity mirror");
+    }
+#endif
+
+    /* Make a dummy particle out of the inhibted ones */
+    if (gparts[i].time_bin == time_bin_inhibited) {
+      mass[i] = 0.f;
+      active[i] = 0;
+    } else {
+      mass[i] = gparts[i].mass;
+      active[i] = (int)(gparts[i].time_bin <= max_active_bin);
+    }
+  }
+
+  /* Particles used for padding should get impossible positions
+   * that have a reasonable magnitude. We use the cell width for this */
+  const float pos_padded[3] = {-2.f * (float)cell_width[0],
+                               -2.f * (float)cell_width[1],
+                               -2.f * (float)cell_width[2]};
+  const float eps_padded = epsilon[0];
+
+  /* Pad the mirror */
+  for (int i = gcount; i < gcount_padded; ++i) {
+    x[i] = pos_padded[0];
+    y[i] = pos_padded[1];
+    z[i] = pos_padded[2];
+    epsilon[i] = eps_padded;
+    mass[i] = 0.f;
+    active[i] = 0;
+  }
+
+  /* Zero the accumulators */
+  bzero(m->a_x, gcount_padded * sizeof(float));
+  bzero(m->a_y, gcount_padded * sizeof(float));
+  bzero(m->a_z, gcount_padded * sizeof(float));
+  bzero(m->pot, gcount_padded * sizeof(float));
+}
+
+/**
+ * @brief Points the input fields of a #gravity_cache to a #gravity_mirror.
+ *
+ * The output fields and the M2P flags remain the ones of the scratch cache
+ * and are zeroed.
+ *
+ * @param c The #gravity_cache to set up.
+ * @param scratch The #gravity_cache owning the output arrays.
+ * @param m The #gravity_mirror to read from.
+ */
+INLINE static void gravity_cache_attach_mirror(
+    struct gravity_cache *c, const struct gravity_cache *scratch,
+    const struct gravity_mirror *m) {
+
+#ifdef SWIFT_DEBUG_CHECKS
+  if (scratch->count < m->count_padded)
+    error("Size of the gravity cache is not large enough.");
+#endif
+
+  c->x = m->x;
+  c->y = m->y;
+  c->z = m->z;
+  c->epsilon = m->epsilon;
+  c->m = m->m;
+  c->active = m->active;
+  c->a_x = scratch->a_x;
+  c->a_y = scratch->a_y;
+  c->a_z = scratch->a_z;
+  c->pot = scratch->pot;
+  c->use_mpole = scratch->use_mpole;
+  c->count = scratch->count;
+
+  /* Zero the output */
+  gravity_cache_zero_output(c, m->count_padded);
+}
+
+/**
+ * @brief Decides which particles of a #gravity_cache attached to a
+ * #gravity_mirror can use a M2P interaction instead of the more expensive P2P.
+ *
+ * @param allow_mpole Are we allowing the use of multipoles?
+ * @param periodic Are we using periodic BCs ?
+ * @param dim The size of the simulation volume along each dimension.
+ * @param c The #gravity_cache to update.
+ * @param gparts The #gpart array the cache was filled from.
+ * @param gcount The number of particles in the cache.
+ * @param gcount_padded The number of particle in the cache padded to the next
+ * multiple of the vector length.
+ * @param CoM The position of the multipole.
+ * @param multipole The mulipole to check for.
+ * @param grav_props The global gravity properties.
+ */
+INLINE static void gravity_cache_populate_mpole(
+    const int allow_mpole, const int periodic, const float dim[3],
+    struct gravity_cache *c, const struct gpart *restrict gparts,
+    const int gcount, const int gcount_padded, const float CoM[3],
+    const struct gravity_tensors *multipole,
+    const struct gravity_props *grav_props) {
+
+  swift_declare_aligned_ptr(float, x, c->x, SWIFT_CACHE_ALIGNMENT);
+  swift_declare_aligned_ptr(float, y, c->y, SWIFT_CACHE_ALIGNMENT);
+  swift_declare_aligned_ptr(float, z, c->z, SWIFT_CACHE_ALIGNMENT);
+  swift_declare_aligned_ptr(int, use_mpole, c->use_mpole,
+                            SWIFT_CACHE_ALIGNMENT);
+  swift_assume_size(gcount_padded, VEC_SIZE);
+
+  if (!allow_mpole) {
+    bzero(use_mpole, gcount_padded * sizeof(int));
+    return;
+  }
+
+  for (int i = 0; i < gcount; ++i) {
+
+    /* Distance to the CoM of the other cell. */
+    float dx = x[i] - CoM[0];
+    float dy = y[i] - CoM[1];
+    float dz = z[i] - CoM[2];
+
+    /* Apply periodic BC */
+    if (periodic) {
+      dx = nearestf(dx, dim[0]);
+      dy = nearestf(dy, dim[1]);
+      dz = nearestf(dz, dim[2]);
+    }
+    const float r2 = dx * dx + dy * dy + dz * dz;
+
+    /* Check whether we can use the multipole instead of P-P */
+    use_mpole[i] =
+        gravity_M2P_accept(grav_props, &gparts[i], multipole, r2, periodic);
+  }
+
+  for (int i = gcount; i < gcount_padded; ++i) use_mpole[i] = 0;
+}
+
+/**
+ * @brief Flags all the particles of a #gravity_cache attached to a
+ * #gravity_mirror as using the multi-pole.
+ *
+ * @param periodic Are we using periodic BCs ?
+ * @param dim The size of the simulation volume along each dimension.
+ * @param c The #gravity_cache to update.
+ * @param gparts The #gpart array the cache was filled from.
+ * @param gcount The number of particles in the cache.
+ * @param gcount_padded The number of particle in the cache padded to the next
+ * multiple of the vector length.
+ * @param CoM The position of the multipole.
+ * @param multipole The mulipole to check for.
+ * @param grav_props The global gravity properties.
+ */
+INLINE static void gravity_cache_populate_all_mpole_flags(
+    const int periodic, const float dim[3], struct gravity_cache *c,
+    const struct gpart *restrict gparts, const int gcount,
+    const int gcount_padded, const float CoM[3],
+    const struct gravity_tensors *multipole,
+    const struct gravity_props *grav_props) {
+
+  for (int i = 0; i < gcount; ++i) {
+    c->use_mpole[i] = 1;
+
+#ifdef SWIFT_DEBUG_CHECKS
+    /* Distance to the CoM of the other cell. */
+    float dx = c->x[i] - CoM[0];
+    float dy = c->y[i] - CoM[1];
+    float dz = c->z[i] - CoM[2];
+
+    /* Apply periodic BC */
+    if (periodic) {
+      dx = nearestf(dx, dim[0]);
+      dy = nearestf(dy, dim[1]);
+      dz = nearestf(dz, dim[2]);
+    }
+    const float r2 = dx * dx + dy * dy + dz * dz;
+
+    if (!gravity_M2P_accept(grav_props, &gparts[i], multipole, r2, periodic))
+      error("Using m-pole where the test fails");
+#endif
+  }
+
+  for (int i = gcount; i < gcount_padded; ++i) c->use_mpole[i] = 0;
+}
+
+/**
+ * @brief Accumulate the output cache values of a task into a
+ * #gravity_mirror.
+ *
+ * @param c The #gravity_cache to read from.
+ * @param m The #gravity_mirror to accumulate into.
+ */
+INLINE static void gravity_mirror_accumulate(const struct gravity_cache *c,
+                                             struct gravity_mirror *m) {
+
+  const int gcount_padded = m->count_padded;
+
+  /* Make the compiler understand we are in happy vectorization land */
+  swift_declare_aligned_ptr(float, a_x, m->a_x, SWIFT_CACHE_ALIGNMENT);
+  swift_declare_aligned_ptr(float, a_y, m->a_y, SWIFT_CACHE_ALIGNMENT);
+  swift_declare_aligned_ptr(float, a_z, m->a_z, SWIFT_CACHE_ALIGNMENT);
+  swift_declare_aligned_ptr(float, pot, m->pot, SWIFT_CACHE_ALIGNMENT);
+  swift_declare_aligned_ptr(float, c_a_x, c->a_x, SWIFT_CACHE_ALIGNMENT);
+  swift_declare_aligned_ptr(float, c_a_y, c->a_y, SWIFT_CACHE_ALIGNMENT);
+  swift_declare_aligned_ptr(float, c_a_z, c->a_z, SWIFT_CACHE_ALIGNMENT);
+  swift_declare_aligned_ptr(float, c_pot, c->pot, SWIFT_CACHE_ALIGNMENT);
+  swift_assume_size(gcount_padded, VEC_SIZE);
+
+  for (int i = 0; i < gcount_padded; ++i) {
+    a_x[i] += c_a_x[i];
+    a_y[i] += c_a_y[i];
+    a_z[i] += c_a_z[i];
+    pot[i] += c_pot[i];
+  }
+}
+
+/**
+ * @brief Write the accumulated values of a #gravity_mirror back to the active
+ * #gpart.
+ *
+ * @param m The #gravity_mirror to read from.
+ * @param gparts The #gpart array to write to.
+ */
+INLINE static void gravity_mirror_write_back(const struct gravity_mirror *m,
+                                             struct gpart *restrict gparts) {
+
+  const int gcount = m->count;
+
+  for (int i = 0; i < gcount; ++i) {
+    if (m->active[i]) {
+      gparts[i].a_grav[0] += m->a_x[i];
+      gparts[i].a_grav[1] += m->a_y[i];
+      gparts[i].a_grav[2] += m->a_z[i];
+      gravity_add_comoving_potential(&gparts[i], m->pot[i]);
+    }
+  }
+}
+
 #endif /* SWIFT_GRAVITY_CACHE_H */
@@ -200,42 +200,23 @@ potential_derivatives_flip_signs(struct potential_derivatives_M2L *pot) {
 }
 
 /**
- * @brief Compute all the relevent derivatives of the softened and truncated
- * gravitational potential for the M2L kernel.
+ * @brief Compute the radial part of the derivatives of the softened and
+ * truncated gravitational potential for the M2L kernel.
+ *
+ * Dt[n] is the (n+1)-th term of the series used in
+ * potential_derivatives_compute_M2L() to build the derivatives.
  *
- * @param r_x x-component of distance vector
- * @param r_y y-component of distance vector
- * @param r_z z-component of distance vector
  * @param r2 Square norm of distance vector
  * @param r_inv Inverse norm of distance vector
  * @param eps Softening length.
  * @param periodic Is the calculation periodic ?
  * @param r_s_inv Inverse of the long-range gravity mesh smoothing length.
- * @param pot (return) The structure containing all the derivatives.
+ * @param Dt (return) The radial terms.
  */
 __attribute__((always_inline, nonnull)) INLINE static void
-potential_derivatives_compute_M2L(const float r_x, const float r_y,
-                                  const float r_z, const float r2,
-                                  const float r_inv, const float eps,
-                                  const int periodic, const float r_s_inv,
-                                  struct potential_derivatives_M2L *pot) {
-
-  float Dt_1;
-#if SELF_GRAVITY_MULTIPOLE_ORDER > 0
-  float Dt_2;
-#endif
-#if SELF_GRAVITY_MULTIPOLE_ORDER > 1
-  float Dt_3;
-#endif
-#if SELF_GRAVITY_MULTIPOLE_ORDER > 2
-  float Dt_4;
-#endif
-#if SELF_GRAVITY_MULTIPOLE_ORDER > 3
-  float Dt_5;
-#endif
-#if SELF_GRAVITY_MULTIPOLE_ORDER > 4
-  float Dt_6;
-#endif
+potential_derivatives_compute_M2L_radial(
+    const float r2, const float r_inv, const float eps, const int periodic,
+    const float r_s_inv, float Dt[SELF_GRAVITY_MULTIPOLE_ORDER + 1]) {
 
   /* Softened case */
   if (r2 < eps * eps) {
@@ -244,26 +225,26 @@ potential_derivatives_compute_M2L(const float r_x, const float r_y,
     const float r = r2 * r_inv;
     const float u = r * eps_inv;
 
-    Dt_1 = eps_inv * D_soft_1(u);
+    Dt[0] = eps_inv * D_soft_1(u);
 #if SELF_GRAVITY_MULTIPOLE_ORDER > 0
     const float eps_inv2 = eps_inv * eps_inv;
-    Dt_2 = eps_inv2 * D_soft_2(u);
+    Dt[1] = eps_inv2 * D_soft_2(u);
 #endif
 #if SELF_GRAVITY_MULTIPOLE_ORDER > 1
     const float eps_inv3 = eps_inv2 * eps_inv;
-    Dt_3 = eps_inv3 * D_soft_3(u);
+    Dt[2] = eps_inv3 * D_soft_3(u);
 #endif
 #if SELF_GRAVITY_MULTIPOLE_ORDER > 2
     const float eps_inv4 = eps_inv3 * eps_inv;
-    Dt_4 = eps_inv4 * D_soft_4(u);
+    Dt[3] = eps_inv4 * D_soft_4(u);
 #endif
 #if SELF_GRAVITY_MULTIPOLE_ORDER > 3
     const float eps_inv5 = eps_inv4 * eps_inv;
-    Dt_5 = eps_inv5 * D_soft_5(u);
+    Dt[4] = eps_inv5 * D_soft_5(u);
 #endif
 #if SELF_GRAVITY_MULTIPOLE_ORDER > 4
     const float eps_inv6 = eps_inv5 * eps_inv;
-    Dt_6 = eps_inv6 * D_soft_6(u);
+    Dt[5] = eps_inv6 * D_soft_6(u);
 #endif
 #if SELF_GRAVITY_MULTIPOLE_ORDER > 5
 #error "Missing implementation for order >5"
@@ -272,21 +253,21 @@ potential_derivatives_compute_M2L(const float r_x, const float r_y,
     /* Un-truncated un-softened case (Newtonian potential) */
   } else if (!periodic) {
 
-    Dt_1 = r_inv; /* 1 / r */
-#if SELF_GRAVITY_MULTIPOLE_ORDER > 1
-    Dt_2 = -1.f * Dt_1 * r_inv; /* -1 / r^2 */
+    Dt[0] = r_inv; /* 1 / r */
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 0
+    Dt[1] = -1.f * Dt[0] * r_inv; /* -1 / r^2 */
 #endif
 #if SELF_GRAVITY_MULTIPOLE_ORDER > 1
-    Dt_3 = -3.f * Dt_2 * r_inv; /* 3 / r^3 */
+    Dt[2] = -3.f * Dt[1] * r_inv; /* 3 / r^3 */
 #endif
 #if SELF_GRAVITY_MULTIPOLE_ORDER > 2
-    Dt_4 = -5.f * Dt_3 * r_inv; /* -15 / r^4 */
+    Dt[3] = -5.f * Dt[2] * r_inv; /* -15 / r^4 */
 #endif
 #if SELF_GRAVITY_MULTIPOLE_ORDER > 3
-    Dt_5 = -7.f * Dt_4 * r_inv; /* 105 / r^5 */
+    Dt[4] = -7.f * Dt[3] * r_inv; /* 105 / r^5 */
 #endif
 #if SELF_GRAVITY_MULTIPOLE_ORDER > 4
-    Dt_6 = -9.f * Dt_5 * r_inv; /* -945 / r^6 */
+    Dt[5] = -9.f * Dt[4] * r_inv; /* -945 / r^6 */
 #endif
 #if SELF_GRAVITY_MULTIPOLE_ORDER > 5
 #error "Missing implementation for order >5"
@@ -300,63 +281,107 @@ potential_derivatives_compute_M2L(const float r_x, const float r_y,
     struct chi_derivatives derivs;
     kernel_long_grav_derivatives(r, r_s_inv, &derivs);
 
-    Dt_1 = derivs.chi_0 * r_inv;
+    Dt[0] = derivs.chi_0 * r_inv;
 
 #if SELF_GRAVITY_MULTIPOLE_ORDER > 0
 
     /* -chi^0 r_i^2 + chi^1 r_i^1 */
-    Dt_2 = derivs.chi_1 - derivs.chi_0 * r_inv;
-    Dt_2 = Dt_2 * r_inv;
+    Dt[1] = derivs.chi_1 - derivs.chi_0 * r_inv;
+    Dt[1] = Dt[1] * r_inv;
 
 #endif
 #if SELF_GRAVITY_MULTIPOLE_ORDER > 1
 
     /* 3chi^0 r_i^3 - 3 chi^1 r_i^2 + chi^2 r_i^1 */
-    Dt_3 = derivs.chi_0 * r_inv - derivs.chi_1;
-    Dt_3 = Dt_3 * 3.f;
-    Dt_3 = Dt_3 * r_inv + derivs.chi_2;
-    Dt_3 = Dt_3 * r_inv;
+    Dt[2] = derivs.chi_0 * r_inv - derivs.chi_1;
+    Dt[2] = Dt[2] * 3.f;
+    Dt[2] = Dt[2] * r_inv + derivs.chi_2;
+    Dt[2] = Dt[2] * r_inv;
 
 #endif
 #if SELF_GRAVITY_MULTIPOLE_ORDER > 2
 
     /* -15chi^0 r_i^4 + 15 chi^1 r_i^3 - 6 chi^2 r_i^2  + chi^3 r_i^1 */
-    Dt_4 = -derivs.chi_0 * r_inv + derivs.chi_1;
-    Dt_4 = Dt_4 * 15.f;
-    Dt_4 = Dt_4 * r_inv - 6.f * derivs.chi_2;
-    Dt_4 = Dt_4 * r_inv + derivs.chi_3;
-    Dt_4 = Dt_4 * r_inv;
+    Dt[3] = -derivs.chi_0 * r_inv + derivs.chi_1;
+    Dt[3] = Dt[3] * 15.f;
+    Dt[3] = Dt[3] * r_inv - 6.f * derivs.chi_2;
+    Dt[3] = Dt[3] * r_inv + derivs.chi_3;
+    Dt[3] = Dt[3] * r_inv;
 
 #endif
 #if SELF_GRAVITY_MULTIPOLE_ORDER > 3
 
     /* 105chi^0 r_i^5 - 105 chi^1 r_i^4 + 45 chi^2 r_i^3 - 10 chi^3 r_i^2 +
      * chi^4 r_i^1 */
-    Dt_5 = derivs.chi_0 * r_inv - derivs.chi_1;
-    Dt_5 = Dt_5 * 105.f;
-    Dt_5 = Dt_5 * r_inv + 45.f * derivs.chi_2;
-    Dt_5 = Dt_5 * r_inv - 10.f * derivs.chi_3;
-    Dt_5 = Dt_5 * r_inv + derivs.chi_4;
-    Dt_5 = Dt_5 * r_inv;
+    Dt[4] = derivs.chi_0 * r_inv - derivs.chi_1;
+    Dt[4] = Dt[4] * 105.f;
+    Dt[4] = Dt[4] * r_inv + 45.f * derivs.chi_2;
+    Dt[4] = Dt[4] * r_inv - 10.f * derivs.chi_3;
+    Dt[4] = Dt[4] * r_inv + derivs.chi_4;
+    Dt[4] = Dt[4] * r_inv;
 
 #endif
 #if SELF_GRAVITY_MULTIPOLE_ORDER > 4
 
     /* -945chi^0 r_i^6 + 945 chi^1 r_i^5 - 420 chi^2 r_i^4 + 105 chi^3 r_i^3 -
      * 15 chi^4 r_i^2 + chi^5 r_i^1 */
-    Dt_6 = -derivs.chi_0 * r_inv + derivs.chi_1;
-    Dt_6 = Dt_6 * 945.f;
-    Dt_6 = Dt_6 * r_inv - 420.f * derivs.chi_2;
-    Dt_6 = Dt_6 * r_inv + 105.f * derivs.chi_3;
-    Dt_6 = Dt_6 * r_inv - 15.f * derivs.chi_4;
-    Dt_6 = Dt_6 * r_inv + derivs.chi_5;
-    Dt_6 = Dt_6 * r_inv;
+    Dt[5] = -derivs.chi_0 * r_inv + derivs.chi_1;
+    Dt[5] = Dt[5] * 945.f;
+    Dt[5] = Dt[5] * r_inv - 420.f * derivs.chi_2;
+    Dt[5] = Dt[5] * r_inv + 105.f * derivs.chi_3;
+    Dt[5] = Dt[5] * r_inv - 15.f * derivs.chi_4;
+    Dt[5] = Dt[5] * r_inv + derivs.chi_5;
+    Dt[5] = Dt[5] * r_inv;
 
 #endif
 #if SELF_GRAVITY_MULTIPOLE_ORDER > 5
 #error "Missing implementation for order >5"
 #endif
   }
+}
+
+/**
+ * @brief Compute all the relevent derivatives of the softened and truncated
+ * gravitational potential for the M2L kernel.
+ *
+ * @param r_x x-component of distance vector
+ * @param r_y y-component of distance vector
+ * @param r_z z-component of distance vector
+ * @param r2 Square norm of distance vector
+ * @param r_inv Inverse norm of distance vector
+ * @param eps Softening length.
+ * @param periodic Is the calculation periodic ?
+ * @param r_s_inv Inverse of the long-range gravity mesh smoothing length.
+ * @param pot (return) The structure containing all the derivatives.
+ */
+__attribute__((always_inline, nonnull)) INLINE static void
+potential_derivatives_compute_M2L(const float r_x, const float r_y,
+                                  const float r_z, const float r2,
+                                  const float r_inv, const float eps,
+                                  const int periodic, const float r_s_inv,
+                                  struct potential_derivatives_M2L *pot) {
+
+  /* Radial part of the derivatives */
+  float Dt[SELF_GRAVITY_MULTIPOLE_ORDER + 1];
+  potential_derivatives_compute_M2L_radial(r2, r_inv, eps, periodic, r_s_inv,
+                                           Dt);
+
+  float Dt_1 = Dt[0];
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 0
+  float Dt_2 = Dt[1];
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 1
+  float Dt_3 = Dt[2];
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 2
+  float Dt_4 = Dt[3];
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 3
+  float Dt_5 = Dt[4];
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 4
+  float Dt_6 = Dt[5];
+#endif
 
   /* Alright, let's get the full terms */
 
@@ -390,7 +415,7 @@ potential_derivatives_compute_M2L(const float r_x, const float r_y,
   /* Get the 0th order term */
   pot->D_000 = Dt_1;
 
-#if SELF_GRAVITY_MULTIPOLE_ORDER > 1
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 0
   /* 1st order derivatives */
   pot->D_100 = rx_r * Dt_2;
   pot->D_010 = ry_r * Dt_2;
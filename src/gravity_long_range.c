@@ -0,0 +1,909 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/* Config parameters. */
+#include <config.h>
+
+/* System includes. */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* This object's header. */
+#include "gravity_long_range.h"
+
+/* Local includes. */
+#include "cell.h"
+#include "engine.h"
+#include "error.h"
+#include "memuse.h"
+#include "space.h"
+#include "threadpool.h"
+
+/**
+ * @brief Data shared by the mappers updating the groups of one level.
+ */
+struct gravity_long_range_update_data {
+
+  /*! The #space */
+  const struct space *s;
+
+  /*! The lists and groups */
+  struct gravity_long_range_lists *lists;
+
+  /*! The level being updated */
+  int level;
+
+  /*! Are we also setting the values at rebuild time? */
+  int rebuild;
+};
+
+/**
+ * @brief Data shared by the mappers constructing the lists.
+ */
+struct gravity_long_range_build_data {
+
+  /*! The #engine */
+  const struct engine *e;
+
+  /*! The lists */
+  struct gravity_long_range_lists *lists;
+
+  /*! Number of non-empty top-level cells in each group */
+  int *group_nr_cells;
+
+  /*! The list of each top-level cell, until they are gathered */
+  int **cell_lists;
+};
+
+/**
+ * @brief A growing buffer of list entries.
+ */
+struct gravity_long_range_buffer {
+
+  /*! The entries */
+  int *entries;
+
+  /*! Number of entries */
+  int count;
+
+  /*! Allocated size */
+  int size;
+};
+
+/**
+ * @brief Adds an entry to a #gravity_long_range_buffer.
+ *
+ * @param buff The #gravity_long_range_buffer.
+ * @param entry The entry to add.
+ */
+static void gravity_long_range_buffer_add(
+    struct gravity_long_range_buffer *buff, const int entry) {
+
+  if (buff->count == buff->size) {
+    buff->size = max(2 * buff->size, 64);
+    buff->entries =
+        (int *)realloc(buff->entries, buff->size * sizeof(int));
+    if (buff->entries == NULL)
+      error("Failed to grow the long-range list buffer");
+  }
+  buff->entries[buff->count++] = entry;
+}
+
+/**
+ * @brief Returns the multipole of a group or of a top-level cell.
+ *
+ * @param lists The #gravity_long_range_lists.
+ * @param s The #space.
+ * @param level The level of the group (0 for the top-level cells).
+ * @param g The integer coordinates of the group.
+ */
+static const struct gravity_tensors *gravity_long_range_get_multipole(
+    const struct gravity_long_range_lists *lists, const struct space *s,
+    const int level, const int g[3]) {
+
+  if (level == 0)
+    return s->cells_top[cell_getid(s->cdim, g[0], g[1], g[2])].grav.multipole;
+  else
+    return &lists->groups[gravity_long_range_group_id(lists, level, g)];
+}
+
+/**
+ * @brief Mapper function computing the multipoles of the groups of one level
+ * from the ones of the level below.
+ *
+ * @param map_data The groups of that level.
+ * @param num_elements Chunk size.
+ * @param extra_data Pointer to a #gravity_long_range_update_data.
+ */
+static void gravity_long_range_groups_update_mapper(void *map_data,
+                                                    int num_elements,
+                                                    void *extra_data) {
+
+  const struct gravity_long_range_update_data *data =
+      (const struct gravity_long_range_update_data *)extra_data;
+  const struct space *s = data->s;
+  const struct gravity_long_range_lists *lists = data->lists;
+  const int level = data->level;
+  const int *cdim = lists->cdim[level];
+  const int *cdim_below = lists->cdim[level - 1];
+  struct gravity_tensors *groups = (struct gravity_tensors *)map_data;
+
+  /* Index of the first group of the chunk at this level */
+  const int first_id =
+      (groups - lists->groups) - lists->level_offset[level];
+
+  for (int ind = 0; ind < num_elements; ++ind) {
+
+    struct gravity_tensors *multi = &groups[ind];
+    const int id = first_id + ind;
+    const int g[3] = {id / (cdim[1] * cdim[2]), (id / cdim[2]) % cdim[1],
+                      id % cdim[2]};
+
+    /* Range of the children */
+    int c_min[3], c_max[3];
+    for (int k = 0; k < 3; ++k) {
+      c_min[k] = 2 * g[k];
+      c_max[k] = min(2 * g[k] + 2, cdim_below[k]);
+    }
+
+    /* Keep the values at the last rebuild */
+    const double CoM_rebuild[3] = {multi->CoM_rebuild[0], multi->CoM_rebuild[1],
+                                   multi->CoM_rebuild[2]};
+    const double r_max_rebuild = multi->r_max_rebuild;
+
+    /* Reset everything */
+    gravity_reset(multi);
+
+    /* Compute CoM and bulk velocity of all the non-empty children */
+    double CoM[3] = {0., 0., 0.};
+    double vel[3] = {0., 0., 0.};
+    double mass = 0.;
+
+    int c[3];
+    for (c[0] = c_min[0]; c[0] < c_max[0]; ++c[0]) {
+      for (c[1] = c_min[1]; c[1] < c_max[1]; ++c[1]) {
+        for (c[2] = c_min[2]; c[2] < c_max[2]; ++c[2]) {
+          const struct gravity_tensors *m =
+              gravity_long_range_get_multipole(lists, s, level - 1, c);
+          if (m->m_pole.M_000 == 0.f) continue;
+
+          mass += m->m_pole.M_000;
+          for (int k = 0; k < 3; ++k) {
+            CoM[k] += m->CoM[k] * m->m_pole.M_000;
+            vel[k] += m->m_pole.vel[k] * m->m_pole.M_000;
+          }
+        }
+      }
+    }
+
+    /* Range of top-level cells covered by this group */
+    double loc[3], width[3];
+    for (int k = 0; k < 3; ++k) {
+      int first, last;
+      gravity_long_range_group_range(lists, level, g[k], k, &first, &last);
+      loc[k] = first * s->width[k];
+      width[k] = (last - first) * s->width[k];
+    }
+
+    if (mass == 0.) {
+
+      /* No gparts in that group, set the values to something sensible */
+      gravity_multipole_init(&multi->m_pole);
+      for (int k = 0; k < 3; ++k) multi->CoM[k] = loc[k] + 0.5 * width[k];
+      multi->r_max = 0.;
+
+    } else {
+
+      /* Final operation on the CoM and bulk velocity */
+      const double mass_inv = 1. / mass;
+      for (int k = 0; k < 3; ++k) {
+        multi->CoM[k] = CoM[k] * mass_inv;
+        multi->m_pole.vel[k] = vel[k] * mass_inv;
+      }
+
+      /* Now shift the children's multipoles and add them up */
+      struct multipole temp;
+      double r_max = 0.;
+      for (c[0] = c_min[0]; c[0] < c_max[0]; ++c[0]) {
+        for (c[1] = c_min[1]; c[1] < c_max[1]; ++c[1]) {
+          for (c[2] = c_min[2]; c[2] < c_max[2]; ++c[2]) {
+            const struct gravity_tensors *m =
+                gravity_long_range_get_multipole(lists, s, level - 1, c);
+            if (m->m_pole.M_000 == 0.f) continue;
+
+            /* Contribution to multipole */
+            gravity_M2M(&temp, &m->m_pole, multi->CoM, m->CoM);
+            gravity_multipole_add(&multi->m_pole, &temp);
+
+            /* Upper limit of max CoM<->gpart distance */
+            const double dx = multi->CoM[0] - m->CoM[0];
+            const double dy = multi->CoM[1] - m->CoM[1];
+            const double dz = multi->CoM[2] - m->CoM[2];
+            const double r2 = dx * dx + dy * dy + dz * dz;
+            r_max = max(r_max, m->r_max + sqrt(r2));
+          }
+        }
+      }
+
+      /* At a rebuild, all the particles are within the group's cells which
+       * gives an alternative upper limit of max CoM<->gpart distance */
+      if (data->rebuild) {
+        double d[3];
+        for (int k = 0; k < 3; ++k)
+          d[k] = multi->CoM[k] > loc[k] + width[k] * 0.5
+                     ? multi->CoM[k] - loc[k]
+                     : loc[k] + width[k] - multi->CoM[k];
+        r_max = min(r_max, sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]));
+      }
+      multi->r_max = r_max;
+
+      /* Compute the multipole power */
+      gravity_multipole_compute_power(&multi->m_pole);
+    }
+
+    /* Update or restore the values at rebuild time */
+    if (data->rebuild) {
+      multi->r_max_rebuild = multi->r_max;
+      multi->CoM_rebuild[0] = multi->CoM[0];
+      multi->CoM_rebuild[1] = multi->CoM[1];
+      multi->CoM_rebuild[2] = multi->CoM[2];
+    } else {
+      multi->r_max_rebuild = r_max_rebuild;
+      multi->CoM_rebuild[0] = CoM_rebuild[0];
+      multi->CoM_rebuild[1] = CoM_rebuild[1];
+      multi->CoM_rebuild[2] = CoM_rebuild[2];
+    }
+  }
+}
+
+/**
+ * @brief Re-compute the multipoles of all the groups of top-level cells from
+ * the (drifted) multipoles of the top-level cells.
+ *
+ * This has to be called every step before the long-range tasks run.
+ *
+ * @param s The #space.
+ * @param rebuild Are we also setting the values at rebuild time?
+ */
+void gravity_long_range_groups_update(struct space *s, const int rebuild) {
+
+  struct gravity_long_range_lists *lists = s->grav_long_range;
+  if (lists == NULL || lists->nr_levels == 1) return;
+
+  const ticks tic = getticks();
+
+  struct gravity_long_range_update_data data;
+  data.s = s;
+  data.lists = lists;
+  data.rebuild = rebuild;
+
+  /* Go up the hierarchy one level at a time */
+  for (int level = 1; level < lists->nr_levels; ++level) {
+    const int *cdim = lists->cdim[level];
+    data.level = level;
+    threadpool_map(&s->e->threadpool, gravity_long_range_groups_update_mapper,
+                   &lists->groups[lists->level_offset[level]],
+                   cdim[0] * cdim[1] * cdim[2], sizeof(struct gravity_tensors),
+                   threadpool_auto_chunk_size, &data);
+  }
+
+  if (s->e->verbose)
+    message("took %.3f %s.", clocks_from_ticks(getticks() - tic),
+            clocks_getunit());
+}
+
+/**
+ * @brief Can a top-level cell interact with a group of top-level cells via a
+ * single M2L kernel call?
+ *
+ * This is the case if no cell of the group is beyond the truncation radius,
+ * if the group's multipole is accepted and if none of the group's cells has a
+ * pair task with the top-level cell. Within the range of the pair tasks, the
+ * latter means that all the group's cells must be accepted individually
+ * (as when constructing the lists).
+ *
+ * @param lists The #gravity_long_range_lists.
+ * @param e The #engine.
+ * @param top The top-level #cell.
+ * @param c The integer coordinates of the top-level cell.
+ * @param level The level of the group.
+ * @param g The integer coordinates of the group.
+ */
+int gravity_long_range_group_usable(const struct gravity_long_range_lists *lists,
+                                    const struct engine *e,
+                                    const struct cell *top, const int c[3],
+                                    const int level, const int g[3]) {
+
+  const struct space *s = e->s;
+  const int periodic = s->periodic;
+  const double max_distance2 = e->mesh->r_cut_max * e->mesh->r_cut_max;
+  const int is_zoom_cell =
+      zoom_region_is_zoom_cell(&s->zoom, top - s->cells_top);
+
+  /* Groups only partially within the truncation radius are opened */
+  if (periodic) {
+    double dist2_min, dist2_max;
+    gravity_long_range_group_dist2(lists, c, level, g, s->width, periodic,
+                                   &dist2_min, &dist2_max);
+    if (dist2_max > max_distance2) return 0;
+  }
+
+  /* Is the group far enough? */
+  if (!gravity_long_range_group_accept(lists, e->gravity_properties,
+                                       top->grav.multipole, c, level, g,
+                                       periodic, s->dim))
+    return 0;
+
+  /* No cell of the group can have a pair task with the top-level one */
+  if (gravity_long_range_group_outside_tasks_range(lists, c, level, g,
+                                                   periodic, is_zoom_cell))
+    return 1;
+
+  /* Otherwise, all of the group's cells must be accepted individually */
+  int first[3], last[3];
+  for (int k = 0; k < 3; ++k)
+    gravity_long_range_group_range(lists, level, g[k], k, &first[k], &last[k]);
+
+  int t[3];
+  for (t[0] = first[0]; t[0] < last[0]; ++t[0]) {
+    for (t[1] = first[1]; t[1] < last[1]; ++t[1]) {
+      for (t[2] = first[2]; t[2] < last[2]; ++t[2]) {
+
+        const int cjd = cell_getid(s->cdim, t[0], t[1], t[2]);
+        const struct cell *cj = &s->cells_top[cjd];
+        if (cj->grav.multipole->m_pole.M_000 == 0.f) continue;
+
+        /* Void cells need all their fine cells to be accepted */
+        if (zoom_region_is_void(&s->zoom, s->cdim, cjd)) {
+          if (!gravity_long_range_void_usable(e, top, cj)) return 0;
+          continue;
+        }
+
+        if (!cell_can_use_pair_mm(top, cj, e, s, /*use_rebuild_data=*/1,
+                                  /*is_tree_walk=*/0))
+          return 0;
+      }
+    }
+  }
+
+  return 1;
+}
+
+/**
+ * @brief Are all the fine cells of a void cell of the zoom region accepted
+ * individually by a top-level cell?
+ *
+ * If so, none of them has a pair task with the top-level cell and the void
+ * cell can stand for them in the long-range interactions as soon as its own
+ * multipole is accepted. A void cell is never used as a whole by the fine
+ * cells it contains.
+ *
+ * @param e The #engine.
+ * @param top The top-level #cell.
+ * @param v The void #cell.
+ */
+int gravity_long_range_void_usable(const struct engine *e,
+                                   const struct cell *top,
+                                   const struct cell *v) {
+
+  const struct space *s = e->s;
+  const struct zoom_region *zoom = &s->zoom;
+  const int r = zoom->refinement;
+  const int vid = v - s->cells_top;
+  const int top_id = top - s->cells_top;
+
+  /* Is the top-level cell one of the void's fine cells? */
+  if (zoom_region_is_zoom_cell(zoom, top_id)) {
+    int c_top[3], c_void[3];
+    zoom_region_coarse_coords(zoom, s->cdim, top_id, c_top);
+    zoom_region_coarse_coords(zoom, s->cdim, vid, c_void);
+    if (c_top[0] == c_void[0] && c_top[1] == c_void[1] &&
+        c_top[2] == c_void[2])
+      return 0;
+  }
+
+  int first[3];
+  zoom_region_void_first(zoom, s->cdim, vid, first);
+
+  int f[3];
+  for (f[0] = first[0]; f[0] < first[0] + r; ++f[0]) {
+    for (f[1] = first[1]; f[1] < first[1] + r; ++f[1]) {
+      for (f[2] = first[2]; f[2] < first[2] + r; ++f[2]) {
+
+        const struct cell *cj =
+            &s->cells_top[zoom_region_cell_id(zoom, f[0], f[1], f[2])];
+        if (cj->grav.multipole->m_pole.M_000 == 0.f) continue;
+
+        if (!cell_can_use_pair_mm(top, cj, e, s, /*use_rebuild_data=*/1,
+                                  /*is_tree_walk=*/0))
+          return 0;
+      }
+    }
+  }
+
+  return 1;
+}
+
+/**
+ * @brief Construct the list of a top-level cell for one other top-level
+ * cell.
+ *
+ * The cell is added to the list if it is non-empty, within the truncation
+ * radius and does not have a pair task with the top-level cell.
+ *
+ * @param data The #gravity_long_range_build_data.
+ * @param top The top-level #cell we construct the list of.
+ * @param cjd The index of the other top-level cell.
+ * @param buff The #gravity_long_range_buffer to add the entries to.
+ * @param nr_far (return) The number of cells beyond the truncation radius.
+ * @param num_gpart_far (return) The number of #gpart in these cells.
+ *
+ * @return Whether the cell is accounted for by the entries of the list.
+ */
+static int gravity_long_range_walk_cell(
+    const struct gravity_long_range_build_data *data, const struct cell *top,
+    const int cjd, struct gravity_long_range_buffer *buff, int *nr_far,
+    long long *num_gpart_far) {
+
+  const struct engine *e = data->e;
+  const struct space *s = e->s;
+  const int periodic = s->periodic;
+  const double max_distance2 = e->mesh->r_cut_max * e->mesh->r_cut_max;
+
+  const struct cell *cj = &s->cells_top[cjd];
+  const struct gravity_tensors *multi_j = cj->grav.multipole;
+
+  /* Avoid self contributions and empty cells */
+  if (cj == top) return 0;
+  if (multi_j->m_pole.M_000 == 0.f) return 1;
+
+  /* Are we beyond the distance where the truncated forces are 0? */
+  if (periodic && cell_min_dist2(top, cj, periodic, s->dim) > max_distance2) {
+    *nr_far += 1;
+#if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_GRAVITY_FORCE_CHECKS)
+    *num_gpart_far += multi_j->m_pole.num_gpart;
+#endif
+    return 0;
+  }
+
+  /* Cells that are too close have a pair task instead */
+  if (!cell_can_use_pair_mm(top, cj, e, s, /*use_rebuild_data=*/1,
+                            /*is_tree_walk=*/0))
+    return 0;
+
+  gravity_long_range_buffer_add(buff, cjd);
+  return 1;
+}
+
+/**
+ * @brief Construct the list of a top-level cell for a void cell of the zoom
+ * region.
+ *
+ * The void cell is added as a whole if it is usable, otherwise its fine
+ * cells are considered one by one.
+ *
+ * @param data The #gravity_long_range_build_data.
+ * @param top The top-level #cell we construct the list of.
+ * @param vid The index of the void cell.
+ * @param buff The #gravity_long_range_buffer to add the entries to.
+ * @param nr_far (return) The number of cells beyond the truncation radius.
+ * @param num_gpart_far (return) The number of #gpart in these cells.
+ *
+ * @return Whether all the non-empty fine cells are accounted for by the
+ * entries added to the list.
+ */
+static int gravity_long_range_walk_void(
+    const struct gravity_long_range_build_data *data, const struct cell *top,
+    const int vid, struct gravity_long_range_buffer *buff, int *nr_far,
+    long long *num_gpart_far) {
+
+  const struct engine *e = data->e;
+  const struct space *s = e->s;
+  const struct zoom_region *zoom = &s->zoom;
+  const int periodic = s->periodic;
+  const double max_distance2 = e->mesh->r_cut_max * e->mesh->r_cut_max;
+  const int r = zoom->refinement;
+
+  const struct cell *v = &s->cells_top[vid];
+  const struct gravity_tensors *multi_v = v->grav.multipole;
+
+  /* Skip empty voids */
+  if (multi_v->m_pole.M_000 == 0.f) return 1;
+
+  /* Is the whole void beyond the distance where the truncated forces are
+   * 0? */
+  if (periodic && cell_min_dist2(top, v, periodic, s->dim) > max_distance2) {
+    *nr_far += 1;
+#if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_GRAVITY_FORCE_CHECKS)
+    *num_gpart_far += multi_v->m_pole.num_gpart;
+#endif
+    return 0;
+  }
+
+  /* Can we use the void's multipole? */
+  if (gravity_long_range_void_usable(e, top, v) &&
+      cell_can_use_pair_mm(top, v, e, s, /*use_rebuild_data=*/1,
+                           /*is_tree_walk=*/0)) {
+    gravity_long_range_buffer_add(buff, vid);
+    return 1;
+  }
+
+  /* Otherwise, go through the fine cells */
+  int first[3];
+  zoom_region_void_first(zoom, s->cdim, vid, first);
+
+  int complete = 1;
+  int f[3];
+  for (f[0] = first[0]; f[0] < first[0] + r; ++f[0])
+    for (f[1] = first[1]; f[1] < first[1] + r; ++f[1])
+      for (f[2] = first[2]; f[2] < first[2] + r; ++f[2])
+        complete &= gravity_long_range_walk_cell(
+            data, top, zoom_region_cell_id(zoom, f[0], f[1], f[2]), buff,
+            nr_far, num_gpart_far);
+
+  return complete;
+}
+
+/**
+ * @brief Recursively construct the list of a top-level cell below a group.
+ *
+ * Groups beyond the truncation radius are skipped (and recorded as such).
+ * Groups outside the range of the pair tasks of the top-level cell are added
+ * to the list if their multipole is accepted and opened otherwise. Groups
+ * within that range are opened first and replace their content in the list
+ * if their multipole is accepted and all their cells made it to the list.
+ * At the level of the top-level cells, all the non-empty ones that are within
+ * the truncation radius and do not have a pair task with the cell are added.
+ *
+ * @param data The #gravity_long_range_build_data.
+ * @param top The top-level #cell we construct the list of.
+ * @param top_coords The integer coordinates of the top-level cell.
+ * @param level The level of the group.
+ * @param g The integer coordinates of the group.
+ * @param buff The #gravity_long_range_buffer to add the entries to.
+ * @param nr_far (return) The number of cells beyond the truncation radius.
+ * @param num_gpart_far (return) The number of #gpart in these cells.
+ *
+ * @return Whether all the non-empty cells of the group are accounted for by
+ * the entries added to the list.
+ */
+static int gravity_long_range_walk(
+    const struct gravity_long_range_build_data *data, const struct cell *top,
+    const int top_coords[3], const int level, const int g[3],
+    struct gravity_long_range_buffer *buff, int *nr_far,
+    long long *num_gpart_far) {
+
+  const struct engine *e = data->e;
+  const struct space *s = e->s;
+  const struct gravity_long_range_lists *lists = data->lists;
+  const int periodic = s->periodic;
+  const double max_distance2 = e->mesh->r_cut_max * e->mesh->r_cut_max;
+
+  if (level == 0) {
+
+    const int cjd = cell_getid(s->cdim, g[0], g[1], g[2]);
+
+    /* Void cells of the zoom region may need to be opened */
+    if (zoom_region_is_void(&s->zoom, s->cdim, cjd))
+      return gravity_long_range_walk_void(data, top, cjd, buff, nr_far,
+                                          num_gpart_far);
+
+    return gravity_long_range_walk_cell(data, top, cjd, buff, nr_far,
+                                        num_gpart_far);
+  }
+
+  const int gid = gravity_long_range_group_id(lists, level, g);
+  const struct gravity_tensors *multi_g = &lists->groups[gid];
+
+  /* Skip empty groups */
+  if (multi_g->m_pole.M_000 == 0.f) return 1;
+
+  /* Is the whole group beyond the distance where the truncated forces are
+   * 0? */
+  double dist2_min = 0., dist2_max = 0.;
+  if (periodic) {
+    gravity_long_range_group_dist2(lists, top_coords, level, g, s->width,
+                                   periodic, &dist2_min, &dist2_max);
+    if (dist2_min > max_distance2) {
+      *nr_far += data->group_nr_cells[gid];
+#if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_GRAVITY_FORCE_CHECKS)
+      *num_gpart_far += multi_g->m_pole.num_gpart;
+#endif
+      return 0;
+    }
+  }
+
+  /* Is the group's multipole accepted? */
+  const int accept = gravity_long_range_group_accept(
+      lists, e->gravity_properties, top->grav.multipole, top_coords, level, g,
+      periodic, s->dim);
+
+  /* Outside the range of the pair tasks, the multipole is all we need */
+  const int outside = gravity_long_range_group_outside_tasks_range(
+      lists, top_coords, level, g, periodic,
+      zoom_region_is_zoom_cell(&s->zoom, top - s->cells_top));
+  if (outside && accept && dist2_max <= max_distance2) {
+    gravity_long_range_buffer_add(buff, lists->nr_cells + gid);
+    return 1;
+  }
+
+  /* Open the group */
+  const int start = buff->count;
+  const int *cdim_below = lists->cdim[level - 1];
+  int complete = 1;
+  int c[3];
+  for (c[0] = 2 * g[0]; c[0] < min(2 * g[0] + 2, cdim_below[0]); ++c[0])
+    for (c[1] = 2 * g[1]; c[1] < min(2 * g[1] + 2, cdim_below[1]); ++c[1])
+      for (c[2] = 2 * g[2]; c[2] < min(2 * g[2] + 2, cdim_below[2]); ++c[2])
+        complete &= gravity_long_range_walk(data, top, top_coords, level - 1,
+                                            c, buff, nr_far, num_gpart_far);
+
+  /* Can we replace the content by the group itself? */
+  if (!outside && complete && accept) {
+    buff->count = start;
+    gravity_long_range_buffer_add(buff, lists->nr_cells + gid);
+  }
+
+  return complete;
+}
+
+/**
+ * @brief Mapper function constructing the lists of a set of local top-level
+ * cells.
+ *
+ * The number of entries of the list of cell i is written to offsets[i + 1].
+ *
+ * @param map_data The indices of the local top-level cells.
+ * @param num_elements Chunk size.
+ * @param extra_data Pointer to a #gravity_long_range_build_data.
+ */
+static void gravity_long_range_lists_build_mapper(void *map_data,
+                                                  int num_elements,
+                                                  void *extra_data) {
+
+  const struct gravity_long_range_build_data *data =
+      (const struct gravity_long_range_build_data *)extra_data;
+  const struct space *s = data->e->s;
+  struct gravity_long_range_lists *lists = data->lists;
+  const int *local_cells = (const int *)map_data;
+  const int top_level = lists->nr_levels - 1;
+  const int *cdim_top = lists->cdim[top_level];
+
+  struct gravity_long_range_buffer buff = {NULL, 0, 0};
+
+  for (int ind = 0; ind < num_elements; ++ind) {
+
+    const int cid = local_cells[ind];
+    const struct cell *top = &s->cells_top[cid];
+
+    buff.count = 0;
+    int nr_far = 0;
+    long long num_gpart_far = 0;
+
+    /* Void cells never have any task */
+    if (zoom_region_is_void(&s->zoom, s->cdim, cid)) {
+      lists->offsets[cid + 1] = 0;
+      lists->nr_far[cid] = 0;
+      continue;
+    }
+
+    /* Coordinates of the cell (of its void cell for the fine ones) */
+    int top_coords[3];
+    zoom_region_coarse_coords(&s->zoom, s->cdim, cid, top_coords);
+
+    /* Walk down from all the groups of the coarsest level */
+    int g[3];
+    for (g[0] = 0; g[0] < cdim_top[0]; ++g[0])
+      for (g[1] = 0; g[1] < cdim_top[1]; ++g[1])
+        for (g[2] = 0; g[2] < cdim_top[2]; ++g[2])
+          gravity_long_range_walk(data, top, top_coords, top_level, g, &buff,
+                                  &nr_far, &num_gpart_far);
+
+    /* Keep a copy of the list until they are all gathered */
+    if (buff.count > 0) {
+      data->cell_lists[cid] = (int *)malloc(buff.count * sizeof(int));
+      if (data->cell_lists[cid] == NULL)
+        error("Failed to allocate a long-range list");
+      memcpy(data->cell_lists[cid], buff.entries, buff.count * sizeof(int));
+    }
+
+    lists->offsets[cid + 1] = buff.count;
+    lists->nr_far[cid] = nr_far;
+#if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_GRAVITY_FORCE_CHECKS)
+    lists->num_gpart_far[cid] = num_gpart_far;
+#endif
+  }
+
+  free(buff.entries);
+}
+
+/**
+ * @brief Construct the hierarchy of groups of top-level cells and the
+ * interaction lists of the long-range gravity tasks of all the local
+ * top-level cells.
+ *
+ * This has to be called at every rebuild, once the top-level multipoles have
+ * been constructed and the tasks made.
+ *
+ * @param s The #space.
+ * @param e The #engine.
+ */
+void gravity_long_range_lists_build(struct space *s, struct engine *e) {
+
+  const ticks tic = getticks();
+
+  /* Start from a clean slate */
+  gravity_long_range_lists_free(s);
+  struct gravity_long_range_lists *lists =
+      (struct gravity_long_range_lists *)malloc(
+          sizeof(struct gravity_long_range_lists));
+  if (lists == NULL) error("Failed to allocate the long-range lists");
+  bzero(lists, sizeof(struct gravity_long_range_lists));
+  s->grav_long_range = lists;
+
+  const int nr_cells = s->nr_cells;
+  lists->nr_cells = nr_cells;
+
+  /* Construct the hierarchy of groups: halve the number of groups along each
+   * axis until there are at most 2 of them */
+  lists->nr_levels = 1;
+  for (int k = 0; k < 3; ++k) lists->cdim[0][k] = s->cdim[k];
+  if (e->gravity_properties->use_long_range_groups) {
+    while (lists->nr_levels < gravity_long_range_max_levels) {
+      const int *cdim = lists->cdim[lists->nr_levels - 1];
+      if (max3(cdim[0], cdim[1], cdim[2]) <= 2) break;
+
+      int *cdim_up = lists->cdim[lists->nr_levels];
+      for (int k = 0; k < 3; ++k) cdim_up[k] = (cdim[k] + 1) / 2;
+      lists->level_offset[lists->nr_levels] = lists->nr_groups;
+      lists->nr_groups += cdim_up[0] * cdim_up[1] * cdim_up[2];
+      lists->nr_levels++;
+    }
+  }
+
+  /* Range of the pair tasks */
+  engine_self_gravity_tasks_range(e, &lists->delta_m, &lists->delta_p);
+
+  /* Around the fine cells, the range also has to cover the pairs between
+   * fine cells (expressed in coarse cells) */
+  lists->zoom_delta_m = lists->delta_m;
+  lists->zoom_delta_p = lists->delta_p;
+  if (s->zoom.enabled) {
+    const int r = s->zoom.refinement;
+    const int zoom_delta = (engine_zoom_gravity_tasks_range(e) + r - 1) / r;
+    lists->zoom_delta_m = max(lists->delta_m, zoom_delta);
+    lists->zoom_delta_p = max(lists->delta_p, zoom_delta);
+  }
+
+  /* Allocate everything */
+  if (lists->nr_groups > 0) {
+    if (swift_memalign("grav_long_range_groups", (void **)&lists->groups,
+                       SWIFT_STRUCT_ALIGNMENT,
+                       lists->nr_groups * sizeof(struct gravity_tensors)) != 0)
+      error("Failed to allocate the groups of top-level cells");
+    bzero(lists->groups, lists->nr_groups * sizeof(struct gravity_tensors));
+  }
+  lists->offsets = (int *)swift_calloc("grav_long_range_offsets",
+                                       nr_cells + 1, sizeof(int));
+  lists->nr_far =
+      (int *)swift_calloc("grav_long_range_nr_far", nr_cells, sizeof(int));
+#if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_GRAVITY_FORCE_CHECKS)
+  lists->num_gpart_far = (long long *)swift_calloc(
+      "grav_long_range_num_gpart_far", nr_cells, sizeof(long long));
+  if (lists->num_gpart_far == NULL)
+    error("Failed to allocate the long-range lists");
+#endif
+  if (lists->offsets == NULL || lists->nr_far == NULL)
+    error("Failed to allocate the long-range lists");
+
+  /* Multipoles of the groups, also at rebuild time */
+  gravity_long_range_groups_update(s, /*rebuild=*/1);
+
+  /* Number of non-empty cells in each group */
+  int *group_nr_cells = NULL;
+  if (lists->nr_groups > 0) {
+    group_nr_cells = (int *)swift_calloc("grav_long_range_group_nr_cells",
+                                         lists->nr_groups, sizeof(int));
+    if (group_nr_cells == NULL)
+      error("Failed to allocate the long-range group counts");
+  }
+  const int nr_coarse_cells = s->cdim[0] * s->cdim[1] * s->cdim[2];
+  for (int cid = 0; cid < nr_coarse_cells; ++cid) {
+    const struct gravity_tensors *m = s->cells_top[cid].grav.multipole;
+    if (m->m_pole.M_000 == 0.f) continue;
+
+    const int coords[3] = {cid / (s->cdim[1] * s->cdim[2]),
+                           (cid / s->cdim[2]) % s->cdim[1],
+                           cid % s->cdim[2]};
+    for (int level = 1; level < lists->nr_levels; ++level) {
+      const int g[3] = {coords[0] >> level, coords[1] >> level,
+                        coords[2] >> level};
+      group_nr_cells[gravity_long_range_group_id(lists, level, g)]++;
+    }
+  }
+
+  struct gravity_long_range_build_data data;
+  data.e = e;
+  data.lists = lists;
+  data.group_nr_cells = group_nr_cells;
+  data.cell_lists = (int **)calloc(nr_cells, sizeof(int *));
+  if (data.cell_lists == NULL) error("Failed to allocate the long-range lists");
+
+  /* Construct the list of each local cell... */
+  threadpool_map(&e->threadpool, gravity_long_range_lists_build_mapper,
+                 s->local_cells_top, s->nr_local_cells, sizeof(int),
+                 threadpool_auto_chunk_size, &data);
+
+  /* ... convert their sizes to offsets... */
+  for (int cid = 0; cid < nr_cells; ++cid)
+    lists->offsets[cid + 1] += lists->offsets[cid];
+  const int nr_entries = lists->offsets[nr_cells];
+
+  /* ... and gather them */
+  if (nr_entries > 0) {
+    lists->entries = (int *)swift_malloc("grav_long_range_entries",
+                                         nr_entries * sizeof(int));
+    if (lists->entries == NULL)
+      error("Failed to allocate the long-range lists");
+  }
+  for (int cid = 0; cid < nr_cells; ++cid) {
+    if (data.cell_lists[cid] == NULL) continue;
+    memcpy(&lists->entries[lists->offsets[cid]], data.cell_lists[cid],
+           (lists->offsets[cid + 1] - lists->offsets[cid]) * sizeof(int));
+    free(data.cell_lists[cid]);
+  }
+  free(data.cell_lists);
+
+  if (group_nr_cells != NULL)
+    swift_free("grav_long_range_group_nr_cells", group_nr_cells);
+
+  if (e->verbose) {
+    message(
+        "Long-range lists: %d entries for %d local cells (%.1f per cell), "
+        "%d groups over %d levels.",
+        nr_entries, s->nr_local_cells,
+        s->nr_local_cells > 0 ? (double)nr_entries / s->nr_local_cells : 0.,
+        lists->nr_groups, lists->nr_levels);
+    message("took %.3f %s.", clocks_from_ticks(getticks() - tic),
+            clocks_getunit());
+  }
+}
+
+/**
+ * @brief Frees the interaction lists of the long-range gravity tasks.
+ *
+ * @param s The #space.
+ */
+void gravity_long_range_lists_free(struct space *s) {
+
+  struct gravity_long_range_lists *lists = s->grav_long_range;
+  if (lists == NULL) return;
+
+  if (lists->groups != NULL)
+    swift_free("grav_long_range_groups", lists->groups);
+  swift_free("grav_long_range_offsets", lists->offsets);
+  swift_free("grav_long_range_nr_far", lists->nr_far);
+#if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_GRAVITY_FORCE_CHECKS)
+  swift_free("grav_long_range_num_gpart_far", lists->num_gpart_far);
+#endif
+  if (lists->entries != NULL)
+    swift_free("grav_long_range_entries", lists->entries);
+  free(lists);
+  s->grav_long_range = NULL;
+}
@@ -0,0 +1,297 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_GRAVITY_LONG_RANGE_H
+#define SWIFT_GRAVITY_LONG_RANGE_H
+
+/* Config parameters. */
+#include <config.h>
+
+/* Local headers. */
+#include "inline.h"
+#include "minmax.h"
+#include "multipole.h"
+#include "multipole_accept.h"
+#include "periodic.h"
+
+/* Forward declarations */
+struct cell;
+struct engine;
+struct space;
+
+/*! Maximal number of levels of the hierarchy of top-level cell groups */
+#define gravity_long_range_max_levels 32
+
+/**
+ * @brief The interaction lists of the long-range gravity tasks.
+ *
+ * The top-level cells are gathered in a hierarchy of groups of 2^L cells
+ * along each axis (level L, level 0 being the cells themselves). Each group
+ * carries the multipole of all its cells. At every rebuild, each local
+ * top-level cell gets a list of the cells and groups it interacts with via
+ * M2L, groups being used whenever they are well-separated and do not contain
+ * any cell with which it shares a pair task.
+ *
+ * In zoom runs, the hierarchy is built over the coarse grid, the void cells
+ * standing for the fine cells of the zoom region they contain. Void cells
+ * are opened into their fine cells whenever their multipole cannot be used.
+ */
+struct gravity_long_range_lists {
+
+  /*! Number of levels in the hierarchy (1: no groups, just the cells) */
+  int nr_levels;
+
+  /*! Number of groups along each axis at each level */
+  int cdim[gravity_long_range_max_levels][3];
+
+  /*! Index of the first group of each level (>= 1) in the groups array */
+  int level_offset[gravity_long_range_max_levels];
+
+  /*! Total number of groups (all levels >= 1) */
+  int nr_groups;
+
+  /*! The multipoles of the groups */
+  struct gravity_tensors *groups;
+
+  /*! Range of the pair tasks around each cell (see
+   * engine_self_gravity_tasks_range()) */
+  int delta_m, delta_p;
+
+  /*! Same in coarse cells around the fine cells of a zoom region */
+  int zoom_delta_m, zoom_delta_p;
+
+  /*! Number of top-level cells the lists were built for */
+  int nr_cells;
+
+  /*! Start of each top-level cell's list in the entries (size nr_cells + 1) */
+  int *offsets;
+
+  /*! The lists. Entries < nr_cells are top-level cells, the others are
+   * groups with index (entry - nr_cells) */
+  int *entries;
+
+  /*! Number of non-empty cells beyond the truncation radius of each cell */
+  int *nr_far;
+
+#if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_GRAVITY_FORCE_CHECKS)
+  /*! Number of #gpart in the cells beyond the truncation radius of each
+   * cell */
+  long long *num_gpart_far;
+#endif
+};
+
+void gravity_long_range_lists_build(struct space *s, struct engine *e);
+void gravity_long_range_groups_update(struct space *s, const int rebuild);
+void gravity_long_range_lists_free(struct space *s);
+int gravity_long_range_group_usable(const struct gravity_long_range_lists *lists,
+                                    const struct engine *e,
+                                    const struct cell *top, const int c[3],
+                                    const int level, const int g[3]);
+int gravity_long_range_void_usable(const struct engine *e,
+                                   const struct cell *top,
+                                   const struct cell *v);
+
+/**
+ * @brief Returns the index of a group in the array of groups.
+ *
+ * @param lists The #gravity_long_range_lists.
+ * @param level The level of the group (>= 1).
+ * @param g The integer coordinates of the group at that level.
+ */
+__attribute__((always_inline)) INLINE static int gravity_long_range_group_id(
+    const struct gravity_long_range_lists *lists, const int level,
+    const int g[3]) {
+
+  const int *cdim = lists->cdim[level];
+  return lists->level_offset[level] + (g[0] * cdim[1] + g[1]) * cdim[2] + g[2];
+}
+
+/**
+ * @brief Range of top-level cell coordinates along one axis covered by a
+ * group.
+ *
+ * @param lists The #gravity_long_range_lists.
+ * @param level The level of the group.
+ * @param g The coordinate of the group along that axis.
+ * @param axis The axis.
+ * @param first (return) The first top-level cell coordinate.
+ * @param last (return) One past the last top-level cell coordinate.
+ */
+__attribute__((always_inline)) INLINE static void
+gravity_long_range_group_range(const struct gravity_long_range_lists *lists,
+                               const int level, const int g, const int axis,
+                               int *first, int *last) {
+
+  *first = g << level;
+  *last = min((g + 1) << level, lists->cdim[0][axis]);
+}
+
+/**
+ * @brief Squares of the minimal and maximal distances between a top-level
+ * cell and the closest and furthest top-level cells of a group.
+ *
+ * The distances between two cells are the minimal distances between any of
+ * their points (as in cell_min_dist2_same_size()).
+ *
+ * @param lists The #gravity_long_range_lists.
+ * @param c The integer coordinates of the top-level cell.
+ * @param level The level of the group.
+ * @param g The integer coordinates of the group.
+ * @param width The width of the top-level cells.
+ * @param periodic Are we using periodic BCs?
+ * @param dist2_min (return) The square of the distance to the closest cell.
+ * @param dist2_max (return) The square of the distance to the furthest cell.
+ */
+__attribute__((always_inline)) INLINE static void gravity_long_range_group_dist2(
+    const struct gravity_long_range_lists *lists, const int c[3],
+    const int level, const int g[3], const double width[3], const int periodic,
+    double *dist2_min, double *dist2_max) {
+
+  *dist2_min = 0.;
+  *dist2_max = 0.;
+  for (int k = 0; k < 3; ++k) {
+
+    const int cdim = lists->cdim[0][k];
+    int first, last;
+    gravity_long_range_group_range(lists, level, g[k], k, &first, &last);
+
+    /* Number of whole cells between the cell and the closest and furthest
+     * cells of the group along that axis */
+    int gap_min = 0, gap_max = 0;
+    if (periodic) {
+      for (int t = first; t < last; ++t) {
+        const int d = ((t - c[k]) % cdim + cdim) % cdim;
+        const int gap = d == 0 ? 0 : min(d, cdim - d) - 1;
+        gap_min = (t == first) ? gap : min(gap_min, gap);
+        gap_max = max(gap_max, gap);
+      }
+    } else {
+      if (c[k] < first) {
+        gap_min = first - c[k] - 1;
+        gap_max = last - c[k] - 2;
+      } else if (c[k] >= last) {
+        gap_min = c[k] - last;
+        gap_max = c[k] - first - 1;
+      } else {
+        gap_max = max(c[k] - first - 1, last - c[k] - 2);
+        gap_max = max(gap_max, 0);
+      }
+    }
+
+    const double dx_min = gap_min * width[k];
+    const double dx_max = gap_max * width[k];
+    *dist2_min += dx_min * dx_min;
+    *dist2_max += dx_max * dx_max;
+  }
+}
+
+/**
+ * @brief Is a group of top-level cells outside the range of the pair tasks
+ * of a top-level cell?
+ *
+ * The group is outside as soon as it does not overlap with the range along
+ * one of the axes.
+ *
+ * @param lists The #gravity_long_range_lists.
+ * @param c The integer coordinates of the top-level cell.
+ * @param level The level of the group.
+ * @param g The integer coordinates of the group.
+ * @param periodic Are we using periodic BCs?
+ * @param is_zoom_cell Is the top-level cell a fine cell of the zoom region
+ * (c then being the coordinates of its void cell)?
+ */
+__attribute__((always_inline)) INLINE static int
+gravity_long_range_group_outside_tasks_range(
+    const struct gravity_long_range_lists *lists, const int c[3],
+    const int level, const int g[3], const int periodic,
+    const int is_zoom_cell) {
+
+  const int delta_m = is_zoom_cell ? lists->zoom_delta_m : lists->delta_m;
+  const int delta_p = is_zoom_cell ? lists->zoom_delta_p : lists->delta_p;
+
+  for (int k = 0; k < 3; ++k) {
+
+    const int cdim = lists->cdim[0][k];
+    int first, last;
+    gravity_long_range_group_range(lists, level, g[k], k, &first, &last);
+
+    if (periodic) {
+
+      /* Does the range wrap around the whole box? */
+      const int width = delta_m + delta_p + 1;
+      if (width >= cdim) continue;
+
+      /* Circular overlap test of the two ranges */
+      const int start = c[k] - delta_m;
+      const int d1 = ((first - start) % cdim + cdim) % cdim;
+      const int d2 = ((start - first) % cdim + cdim) % cdim;
+      if (d1 >= width && d2 >= last - first) return 1;
+
+    } else {
+      if (last - 1 < c[k] - delta_m || first > c[k] + delta_p) return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Does the multipole of a group of top-level cells pass the
+ * multipole acceptance criterion with respect to a top-level cell?
+ *
+ * This uses the same criterion as for pairs of top-level cells (i.e. the
+ * sizes at the last rebuild). A group containing the cell itself is never
+ * accepted.
+ *
+ * @param lists The #gravity_long_range_lists.
+ * @param props The #gravity_props.
+ * @param multi_top The multipole of the top-level cell.
+ * @param c The integer coordinates of the top-level cell.
+ * @param level The level of the group.
+ * @param g The integer coordinates of the group.
+ * @param periodic Are we using periodic BCs?
+ * @param dim The size of the simulation volume.
+ */
+__attribute__((always_inline)) INLINE static int gravity_long_range_group_accept(
+    const struct gravity_long_range_lists *lists,
+    const struct gravity_props *props,
+    const struct gravity_tensors *multi_top, const int c[3], const int level,
+    const int g[3], const int periodic, const double dim[3]) {
+
+  if ((c[0] >> level) == g[0] && (c[1] >> level) == g[1] &&
+      (c[2] >> level) == g[2])
+    return 0;
+
+  const struct gravity_tensors *multi_g =
+      &lists->groups[gravity_long_range_group_id(lists, level, g)];
+
+  double dx = multi_top->CoM_rebuild[0] - multi_g->CoM_rebuild[0];
+  double dy = multi_top->CoM_rebuild[1] - multi_g->CoM_rebuild[1];
+  double dz = multi_top->CoM_rebuild[2] - multi_g->CoM_rebuild[2];
+
+  /* Apply BC */
+  if (periodic) {
+    dx = nearest(dx, dim[0]);
+    dy = nearest(dy, dim[1]);
+    dz = nearest(dz, dim[2]);
+  }
+  const double r2 = dx * dx + dy * dy + dz * dz;
+
+  return gravity_M2L_accept_symmetric(props, multi_top, multi_g, r2,
+                                      /*use_rebuild_sizes=*/1, periodic);
+}
+
+#endif /* SWIFT_GRAVITY_LONG_RANGE_H */
@@ -0,0 +1,615 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/* Config parameters. */
+#include <config.h>
+
+/* System includes. */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* MPI headers. */
+#ifdef WITH_MPI
+#include <mpi.h>
+#endif
+
+/* This object's header. */
+#include "gravity_mac_tuner.h"
+
+/* Local includes. */
+#include "active.h"
+#include "cell.h"
+#include "clocks.h"
+#include "cosmology.h"
+#include "engine.h"
+#include "error.h"
+#include "gravity.h"
+#include "gravity_iact.h"
+#include "gravity_properties.h"
+#include "lock.h"
+#include "parser.h"
+#include "periodic.h"
+#include "restart.h"
+#include "space.h"
+#include "threadpool.h"
+
+/*! Name of the file the tuner logs its decisions to */
+#define gravity_mac_tuner_file_name "mac_tuning.txt"
+
+/*! Factor by which epsilon_fmm is multiplied when tightening the MAC */
+#define gravity_mac_tuner_eps_tighten 0.5
+
+/*! Factor by which epsilon_fmm is multiplied when loosening the MAC */
+#define gravity_mac_tuner_eps_loosen 1.5
+
+/*! Factor by which theta_cr is multiplied when tightening the MAC */
+#define gravity_mac_tuner_theta_tighten 0.9
+
+/*! Factor by which theta_cr is multiplied when loosening the MAC */
+#define gravity_mac_tuner_theta_loosen 1.05
+
+/*! Fraction of the target below which the error must be to loosen the MAC */
+#define gravity_mac_tuner_loosen_margin 0.7
+
+/*! Relative cost reduction below which loosening is not worth it */
+#define gravity_mac_tuner_min_gain 0.02
+
+/**
+ * @brief A #gpart whose tree acceleration is checked by the tuner.
+ */
+struct gravity_mac_sample {
+
+  /*! Position */
+  double x[3];
+
+  /*! Acceleration obtained from the tree (physical units) */
+  float a_tree[3];
+
+  /*! Norm of the total (tree + mesh) acceleration */
+  float a_norm;
+
+  /*! Softening length */
+  float epsilon;
+};
+
+/**
+ * @brief Data shared by the mappers computing the exact accelerations.
+ */
+struct gravity_mac_tuner_exact_data {
+
+  /*! The #engine */
+  const struct engine *e;
+
+  /*! The sampled #gpart */
+  const struct gravity_mac_sample *samples;
+
+  /*! Number of sampled #gpart */
+  int num_samples;
+
+  /*! The exact accelerations (without G), 3 per sample */
+  double *a_exact;
+
+  /*! Lock protecting the exact accelerations */
+  swift_lock_type lock;
+};
+
+/**
+ * @brief Initialises the MAC tuner from the parameter file.
+ *
+ * @param t The #gravity_mac_tuner.
+ * @param params The parsed parameter file.
+ * @param props The gravity properties (giving the MAC in use).
+ */
+void gravity_mac_tuner_init(struct gravity_mac_tuner *t,
+                            struct swift_params *params,
+                            const struct gravity_props *props) {
+
+  t->num_samples =
+      parser_get_opt_param_int(params, "Gravity:MAC_tuning_num_samples", 1000);
+  t->target_error = parser_get_opt_param_float(
+      params, "Gravity:MAC_tuning_target_error", 0.01f);
+  t->percentile = parser_get_opt_param_float(
+      params, "Gravity:MAC_tuning_percentile", 99.f);
+
+  if (t->num_samples < 1)
+    error("The MAC tuning needs at least one sample per rebuild.");
+  if (t->target_error <= 0.f)
+    error("The target error of the MAC tuning must be positive.");
+  if (t->percentile <= 0.f || t->percentile > 100.f)
+    error("The percentile of the MAC tuning must be in ]0, 100].");
+
+  /* Which parameter are we tuning? */
+  t->tune_theta = !props->use_adaptive_tolerance;
+  const double value =
+      t->tune_theta ? props->theta_crit : props->adaptive_tolerance;
+  if (t->tune_theta) {
+    t->min_value = 0.2;
+    t->max_value = 0.95;
+#ifdef WITH_MPI
+    /* The proxies were constructed for the initial opening angle */
+    t->min_value = value;
+#endif
+  } else {
+    t->min_value = 1e-6;
+    t->max_value = 0.1;
+  }
+  t->min_value = fmin(t->min_value, value);
+  t->max_value = fmax(t->max_value, value);
+
+  t->previous_value = value;
+  t->previous_cost = 0.;
+  t->last_error = -1.f;
+  t->last_median = -1.f;
+  t->last_num_samples = 0;
+  t->last_action = gravity_mac_tuner_keep;
+  t->converged = 0;
+  t->log = NULL;
+}
+
+/**
+ * @brief Opens the log file of the tuner (on rank 0).
+ *
+ * @param t The #gravity_mac_tuner.
+ * @param restart Are we restarting (and appending to the file)?
+ */
+void gravity_mac_tuner_open_log(struct gravity_mac_tuner *t,
+                                const int restart) {
+
+  t->log = fopen(gravity_mac_tuner_file_name, restart ? "a" : "w");
+  if (t->log == NULL)
+    error("Could not open the file '%s'.", gravity_mac_tuner_file_name);
+
+  if (!restart) {
+    fprintf(t->log, "# Target error: %e at the %.1f-th percentile\n",
+            t->target_error, t->percentile);
+    fprintf(t->log, "# Tuned parameter: %s in [%e, %e]\n",
+            t->tune_theta ? "theta_cr" : "epsilon_fmm", t->min_value,
+            t->max_value);
+    fprintf(t->log, "# %6s %14s %14s %12s %12s %8s %16s [%s] %8s\n", "Step",
+            "Time", "Value", "Error", "Median", "Samples",
+            "Cost per update", clocks_getunit(), "Action");
+    fflush(t->log);
+  }
+}
+
+/**
+ * @brief Recursively adds the contribution of the #gpart of a cell to the
+ * exact accelerations of the samples.
+ *
+ * The #gpart of cells that have not been drifted to the current time are
+ * drifted on the fly (ignoring the relativistic correction of neutrinos).
+ *
+ * @param c The #cell.
+ * @param data The #gravity_mac_tuner_exact_data.
+ * @param a The accelerations to accumulate into.
+ */
+static void gravity_mac_tuner_exact_rec(
+    const struct cell *c, const struct gravity_mac_tuner_exact_data *data,
+    double *a) {
+
+  if (c->grav.count == 0) return;
+
+  if (c->split) {
+    for (int k = 0; k < 8; ++k)
+      if (c->progeny[k] != NULL)
+        gravity_mac_tuner_exact_rec(c->progeny[k], data, a);
+    return;
+  }
+
+  const struct engine *e = data->e;
+  const struct gravity_props *props = e->gravity_properties;
+  const int periodic = e->s->periodic;
+  const double dim[3] = {e->s->dim[0], e->s->dim[1], e->s->dim[2]};
+  const float r_s_inv = e->mesh->r_s_inv;
+  const struct gravity_mac_sample *samples = data->samples;
+  const int num_samples = data->num_samples;
+
+  /* How far behind are the particles of this cell? */
+  const integertime_t ti_old = c->grav.ti_old_part;
+  double dt_drift = 0.;
+  if (ti_old < e->ti_current) {
+    if (e->policy & engine_policy_cosmology)
+      dt_drift =
+          cosmology_get_drift_factor(e->cosmology, ti_old, e->ti_current);
+    else
+      dt_drift = (e->ti_current - ti_old) * e->time_base;
+  }
+
+  for (int j = 0; j < c->grav.count; ++j) {
+
+    const struct gpart *gpj = &c->grav.parts[j];
+    if (gpj->time_bin == time_bin_not_created || gpart_is_inhibited(gpj, e))
+      continue;
+
+    const double xj[3] = {gpj->x[0] + gpj->v_full[0] * dt_drift,
+                          gpj->x[1] + gpj->v_full[1] * dt_drift,
+                          gpj->x[2] + gpj->v_full[2] * dt_drift};
+    const float eps_j = gravity_get_softening(gpj, props);
+    const float mass_j = gpj->mass;
+
+    for (int i = 0; i < num_samples; ++i) {
+
+      double dx = xj[0] - samples[i].x[0];
+      double dy = xj[1] - samples[i].x[1];
+      double dz = xj[2] - samples[i].x[2];
+      if (periodic) {
+        dx = nearest(dx, dim[0]);
+        dy = nearest(dy, dim[1]);
+        dz = nearest(dz, dim[2]);
+      }
+      const float r2 = dx * dx + dy * dy + dz * dz;
+
+      /* No self-interaction */
+      if (r2 == 0.f) continue;
+
+      /* Use the same softening as the P-P interactions */
+      const float h = max(samples[i].epsilon, eps_j);
+      const float h_inv = 1.f / h;
+      const float h_inv3 = h_inv * h_inv * h_inv;
+
+      float f_ij, pot_ij;
+      if (periodic)
+        runner_iact_grav_pp_truncated(r2, h * h, h_inv, h_inv3, mass_j,
+                                      r_s_inv, &f_ij, &pot_ij);
+      else
+        runner_iact_grav_pp_full(r2, h * h, h_inv, h_inv3, mass_j, &f_ij,
+                                 &pot_ij);
+
+      a[3 * i + 0] += f_ij * dx;
+      a[3 * i + 1] += f_ij * dy;
+      a[3 * i + 2] += f_ij * dz;
+    }
+  }
+}
+
+/**
+ * @brief Mapper function computing the exact accelerations of the samples
+ * sourced by some local top-level cells.
+ *
+ * @param map_data The indices of the local top-level cells.
+ * @param num_elements The number of cells.
+ * @param extra_data The #gravity_mac_tuner_exact_data.
+ */
+static void gravity_mac_tuner_exact_mapper(void *map_data, int num_elements,
+                                           void *extra_data) {
+
+  struct gravity_mac_tuner_exact_data *data =
+      (struct gravity_mac_tuner_exact_data *)extra_data;
+  const int *cell_ids = (const int *)map_data;
+  const struct cell *cells_top = data->e->s->cells_top;
+
+  double *a = (double *)calloc(3 * data->num_samples, sizeof(double));
+  if (a == NULL) error("Failed to allocate the MAC tuning accelerations.");
+
+  for (int k = 0; k < num_elements; ++k)
+    gravity_mac_tuner_exact_rec(&cells_top[cell_ids[k]], data, a);
+
+  lock_lock(&data->lock);
+  for (int i = 0; i < 3 * data->num_samples; ++i) data->a_exact[i] += a[i];
+  if (lock_unlock(&data->lock) != 0) error("Failed to unlock.");
+
+  free(a);
+}
+
+/**
+ * @brief Comparison function for sorting floats in increasing order.
+ */
+static int gravity_mac_tuner_cmp(const void *a, const void *b) {
+  const float fa = *(const float *)a;
+  const float fb = *(const float *)b;
+  return (fa > fb) - (fa < fb);
+}
+
+/**
+ * @brief Measures the accuracy of the tree accelerations of the current step.
+ *
+ * Must be called after the tasks of a step have run and before the next
+ * drift. A regular subset of the active #gpart of each rank is compared to a
+ * direct summation over all the #gpart. With periodic boundary conditions,
+ * only the short-range (tree) part of the acceleration is checked, but the
+ * error is normalised by the total acceleration.
+ *
+ * @param t The #gravity_mac_tuner.
+ * @param e The #engine.
+ */
+void gravity_mac_tuner_sample(struct gravity_mac_tuner *t,
+                              const struct engine *e) {
+
+  const ticks tic = getticks();
+  const struct space *s = e->s;
+
+  /* Count the local active particles */
+  size_t num_active = 0;
+  for (size_t k = 0; k < s->nr_gparts; ++k) {
+    const struct gpart *gp = &s->gparts[k];
+    if (gpart_is_active(gp, e) && !gpart_is_inhibited(gp, e)) num_active++;
+  }
+
+  /* Pick a regular subset of them */
+  const int num_local_target = max(t->num_samples / e->nr_nodes, 1);
+  const size_t stride = max(num_active / num_local_target, (size_t)1);
+  const int num_local = min(num_active / stride, (size_t)num_local_target);
+
+  struct gravity_mac_sample *local_samples = NULL;
+  if (num_local > 0) {
+    local_samples = (struct gravity_mac_sample *)malloc(
+        num_local * sizeof(struct gravity_mac_sample));
+    if (local_samples == NULL)
+      error("Failed to allocate the MAC tuning samples.");
+  }
+
+  size_t count = 0;
+  int n = 0;
+  for (size_t k = 0; k < s->nr_gparts && n < num_local; ++k) {
+    const struct gpart *gp = &s->gparts[k];
+    if (!gpart_is_active(gp, e) || gpart_is_inhibited(gp, e)) continue;
+    if (count++ % stride != 0) continue;
+
+    struct gravity_mac_sample *sp = &local_samples[n++];
+    float a_tot[3];
+    for (int i = 0; i < 3; ++i) {
+      sp->x[i] = gp->x[i];
+      sp->a_tree[i] = gp->a_grav[i];
+      a_tot[i] = gp->a_grav[i] + gp->a_grav_mesh[i];
+    }
+    sp->a_norm = sqrtf(a_tot[0] * a_tot[0] + a_tot[1] * a_tot[1] +
+                       a_tot[2] * a_tot[2]);
+    sp->epsilon = gravity_get_softening(gp, e->gravity_properties);
+  }
+
+  /* Share the samples with everyone */
+  int num_samples = num_local;
+  struct gravity_mac_sample *samples = local_samples;
+#ifdef WITH_MPI
+  int *counts = (int *)malloc(e->nr_nodes * sizeof(int));
+  int *offsets = (int *)malloc(e->nr_nodes * sizeof(int));
+  if (counts == NULL || offsets == NULL)
+    error("Failed to allocate the MAC tuning counts.");
+  const int num_bytes = num_local * sizeof(struct gravity_mac_sample);
+  MPI_Allgather(&num_bytes, 1, MPI_INT, counts, 1, MPI_INT, MPI_COMM_WORLD);
+  int total_bytes = 0;
+  for (int k = 0; k < e->nr_nodes; ++k) {
+    offsets[k] = total_bytes;
+    total_bytes += counts[k];
+  }
+  num_samples = total_bytes / sizeof(struct gravity_mac_sample);
+  samples = NULL;
+  if (num_samples > 0) {
+    samples = (struct gravity_mac_sample *)malloc(total_bytes);
+    if (samples == NULL) error("Failed to allocate the MAC tuning samples.");
+  }
+  MPI_Allgatherv(local_samples, num_bytes, MPI_BYTE, samples, counts, offsets,
+                 MPI_BYTE, MPI_COMM_WORLD);
+  free(counts);
+  free(offsets);
+  free(local_samples);
+#endif
+
+  if (num_samples == 0) {
+    t->last_error = -1.f;
+    return;
+  }
+
+  /* Compute the exact (tree-part) accelerations */
+  struct gravity_mac_tuner_exact_data data;
+  data.e = e;
+  data.samples = samples;
+  data.num_samples = num_samples;
+  data.a_exact = (double *)calloc(3 * num_samples, sizeof(double));
+  if (data.a_exact == NULL)
+    error("Failed to allocate the MAC tuning accelerations.");
+  if (lock_init(&data.lock) != 0) error("Failed to initialise the lock.");
+
+  threadpool_map((struct threadpool *)&e->threadpool,
+                 gravity_mac_tuner_exact_mapper, s->local_cells_top,
+                 s->nr_local_cells, sizeof(int), threadpool_auto_chunk_size,
+                 &data);
+
+  if (lock_destroy(&data.lock) != 0) error("Failed to destroy the lock.");
+
+#ifdef WITH_MPI
+  MPI_Allreduce(MPI_IN_PLACE, data.a_exact, 3 * num_samples, MPI_DOUBLE,
+                MPI_SUM, MPI_COMM_WORLD);
+#endif
+
+  /* Relative errors */
+  const double G = e->physical_constants->const_newton_G;
+  float *errors = (float *)malloc(num_samples * sizeof(float));
+  if (errors == NULL) error("Failed to allocate the MAC tuning errors.");
+  int num_errors = 0;
+  for (int i = 0; i < num_samples; ++i) {
+    if (samples[i].a_norm == 0.f) continue;
+    double diff2 = 0.;
+    for (int k = 0; k < 3; ++k) {
+      const double diff = samples[i].a_tree[k] - G * data.a_exact[3 * i + k];
+      diff2 += diff * diff;
+    }
+    errors[num_errors++] = sqrt(diff2) / samples[i].a_norm;
+  }
+
+  if (num_errors > 0) {
+    qsort(errors, num_errors, sizeof(float), gravity_mac_tuner_cmp);
+    const int p = (int)(0.01f * t->percentile * (num_errors - 1) + 0.5f);
+    t->last_error = errors[p];
+    t->last_median = errors[(num_errors - 1) / 2];
+  } else {
+    t->last_error = -1.f;
+  }
+  t->last_num_samples = num_errors;
+
+  free(errors);
+  free(data.a_exact);
+  free(samples);
+
+  if (e->verbose)
+    message("Sampled the tree accuracy of %d gparts (took %.3f %s).",
+            num_errors, clocks_from_ticks(getticks() - tic),
+            clocks_getunit());
+}
+
+/**
+ * @brief Is this task one of the tree-gravity tasks?
+ *
+ * @param t The #task.
+ */
+static int gravity_mac_tuner_is_tree_task(const struct task *t) {
+
+  switch (t->type) {
+    case task_type_self:
+    case task_type_pair:
+    case task_type_sub_self:
+    case task_type_sub_pair:
+      return t->subtype == task_subtype_grav;
+    case task_type_grav_long_range:
+    case task_type_grav_mm:
+    case task_type_grav_down:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief Updates the MAC parameter ahead of a rebuild.
+ *
+ * Uses the error measured by the last call to gravity_mac_tuner_sample() and
+ * the time spent in the gravity tasks since the last rebuild. Must be called
+ * before the tasks are freed.
+ *
+ * @param t The #gravity_mac_tuner.
+ * @param e The #engine.
+ */
+void gravity_mac_tuner_update(struct gravity_mac_tuner *t, struct engine *e) {
+
+  /* Nothing to go by? */
+  if (e->g_updates_since_rebuild == 0) return;
+
+  /* Time spent in the tree tasks since the last rebuild */
+  const struct scheduler *sched = &e->sched;
+  ticks tree_ticks = 0;
+  for (int k = 0; k < sched->nr_tasks; ++k)
+    if (gravity_mac_tuner_is_tree_task(&sched->tasks[k]))
+      tree_ticks += sched->tasks[k].total_ticks;
+
+  double cost = clocks_from_ticks(tree_ticks);
+#ifdef WITH_MPI
+  MPI_Allreduce(MPI_IN_PLACE, &cost, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+#endif
+  cost /= (double)e->g_updates_since_rebuild;
+
+  /* No accuracy measurement since the last rebuild? */
+  if (t->last_error < 0.f) return;
+
+  struct gravity_props *props = e->gravity_properties;
+  const double value =
+      t->tune_theta ? props->theta_crit : props->adaptive_tolerance;
+  double new_value = value;
+  enum gravity_mac_tuner_action action = gravity_mac_tuner_keep;
+
+  if (t->last_error > t->target_error) {
+
+    /* Too inaccurate: tighten the criterion */
+    new_value *= t->tune_theta ? gravity_mac_tuner_theta_tighten
+                               : gravity_mac_tuner_eps_tighten;
+    action = gravity_mac_tuner_tighten;
+    t->converged = 0;
+
+  } else if (t->last_error <
+                 gravity_mac_tuner_loosen_margin * t->target_error &&
+             !t->converged) {
+
+    if (t->last_action == gravity_mac_tuner_loosen &&
+        cost > (1. - gravity_mac_tuner_min_gain) * t->previous_cost) {
+
+      /* The last loosening did not pay off: go back and stop there */
+      new_value = t->previous_value;
+      action = gravity_mac_tuner_revert;
+      t->converged = 1;
+
+    } else {
+
+      /* Accurate enough: try a cheaper criterion */
+      t->previous_value = value;
+      t->previous_cost = cost;
+      new_value *= t->tune_theta ? gravity_mac_tuner_theta_loosen
+                                 : gravity_mac_tuner_eps_loosen;
+      action = gravity_mac_tuner_loosen;
+    }
+  }
+
+  new_value = fmin(fmax(new_value, t->min_value), t->max_value);
+  if (t->tune_theta)
+    props->theta_crit = new_value;
+  else
+    props->adaptive_tolerance = new_value;
+
+  if (t->log != NULL) {
+    static const char *action_names[] = {"keep", "tighten", "loosen",
+                                         "revert"};
+    fprintf(t->log, "  %6d %14e %14e %12e %12e %8d %16e %8s\n", e->step,
+            e->time, new_value, t->last_error, t->last_median,
+            t->last_num_samples, cost, action_names[action]);
+    fflush(t->log);
+  }
+
+  if (e->verbose)
+    message("MAC tuning: %s=%e (error %e, cost %e %s per update).",
+            t->tune_theta ? "theta_cr" : "epsilon_fmm", new_value,
+            t->last_error, cost, clocks_getunit());
+
+  t->last_action = action;
+  t->last_error = -1.f;
+}
+
+/**
+ * @brief Closes the log file of the tuner.
+ *
+ * @param t The #gravity_mac_tuner.
+ */
+void gravity_mac_tuner_clean(struct gravity_mac_tuner *t) {
+  if (t->log != NULL) fclose(t->log);
+  t->log = NULL;
+}
+
+/**
+ * @brief Write a #gravity_mac_tuner struct to the given FILE as a stream of
+ * bytes.
+ *
+ * @param t The #gravity_mac_tuner.
+ * @param stream The file stream.
+ */
+void gravity_mac_tuner_struct_dump(const struct gravity_mac_tuner *t,
+                                   FILE *stream) {
+  restart_write_blocks((void *)t, sizeof(struct gravity_mac_tuner), 1, stream,
+                       "mac_tuner", "gravity MAC tuner");
+}
+
+/**
+ * @brief Restore a #gravity_mac_tuner struct from the given FILE as a stream
+ * of bytes.
+ *
+ * @param t The #gravity_mac_tuner.
+ * @param stream The file stream.
+ */
+void gravity_mac_tuner_struct_restore(struct gravity_mac_tuner *t,
+                                      FILE *stream) {
+  restart_read_blocks((void *)t, sizeof(struct gravity_mac_tuner), 1, stream,
+                      NULL, "gravity MAC tuner");
+  t->log = NULL;
+}
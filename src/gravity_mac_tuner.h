@@ -0,0 +1,108 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_GRAVITY_MAC_TUNER_H
+#define SWIFT_GRAVITY_MAC_TUNER_H
+
+/* Config parameters. */
+#include <config.h>
+
+/* System includes. */
+#include <stdio.h>
+
+/* Forward declarations */
+struct engine;
+struct gravity_props;
+struct swift_params;
+
+/**
+ * @brief The actions the #gravity_mac_tuner can take at a rebuild.
+ */
+enum gravity_mac_tuner_action {
+  gravity_mac_tuner_keep = 0,
+  gravity_mac_tuner_tighten,
+  gravity_mac_tuner_loosen,
+  gravity_mac_tuner_revert,
+};
+
+/**
+ * @brief Run-time tuning of the multipole acceptance criterion.
+ *
+ * Ahead of every tree rebuild, the accelerations the tree gave to a sample
+ * of the active #gpart are compared to a direct summation. At the rebuild,
+ * the MAC parameter (epsilon_fmm for the adaptive criteria, theta_cr for the
+ * geometric one) is tightened if the chosen percentile of the relative error
+ * exceeds the target. It is loosened when the error is comfortably below the
+ * target, for as long as the gravity tasks keep getting cheaper per particle
+ * update.
+ */
+struct gravity_mac_tuner {
+
+  /*! Total number of #gpart to sample across all ranks */
+  int num_samples;
+
+  /*! Target relative error of the tree accelerations */
+  float target_error;
+
+  /*! Percentile (0-100) of the error distribution to hold to the target */
+  float percentile;
+
+  /*! Are we tuning the geometric opening angle (instead of epsilon_fmm)? */
+  int tune_theta;
+
+  /*! Range allowed for the tuned parameter */
+  double min_value, max_value;
+
+  /*! Value of the parameter before the last loosening */
+  double previous_value;
+
+  /*! Cost per #gpart update measured with #previous_value */
+  double previous_cost;
+
+  /*! Error percentile of the last sample (< 0 if none since the rebuild) */
+  float last_error;
+
+  /*! Median error of the last sample */
+  float last_median;
+
+  /*! Number of #gpart in the last sample */
+  int last_num_samples;
+
+  /*! Last action taken */
+  enum gravity_mac_tuner_action last_action;
+
+  /*! Has loosening the MAC stopped paying off? */
+  int converged;
+
+  /*! The log file (rank 0 only) */
+  FILE *log;
+};
+
+void gravity_mac_tuner_init(struct gravity_mac_tuner *t,
+                            struct swift_params *params,
+                            const struct gravity_props *props);
+void gravity_mac_tuner_open_log(struct gravity_mac_tuner *t, int restart);
+void gravity_mac_tuner_sample(struct gravity_mac_tuner *t,
+                              const struct engine *e);
+void gravity_mac_tuner_update(struct gravity_mac_tuner *t, struct engine *e);
+void gravity_mac_tuner_clean(struct gravity_mac_tuner *t);
+void gravity_mac_tuner_struct_dump(const struct gravity_mac_tuner *t,
+                                   FILE *stream);
+void gravity_mac_tuner_struct_restore(struct gravity_mac_tuner *t,
+                                      FILE *stream);
+
+#endif /* SWIFT_GRAVITY_MAC_TUNER_H */
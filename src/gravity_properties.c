@@ -30,9 +30,11 @@
 #include "common_io.h"
 #include "dimension.h"
 #include "error.h"
+#include "fft_plans.h"
 #include "gravity.h"
 #include "kernel_gravity.h"
 #include "kernel_long_gravity.h"
+#include "mesh_window.h"
 #include "restart.h"
 
 #define gravity_props_default_a_smooth 1.25f
@@ -40,7 +42,22 @@
 #define gravity_props_default_r_cut_min 0.0f
 #define gravity_props_default_rebuild_frequency 0.01f
 #define gravity_props_default_rebuild_active_fraction 1.01f  // > 1 means never
+#define gravity_props_default_lazy_multipole_reconstruction 0
 #define gravity_props_default_distributed_mesh 0
+#define gravity_props_default_mesh_reduce_scatter 0
+#define gravity_props_default_top_multipoles_neighbours 0
+#define gravity_props_default_mesh_single_precision 0
+#define gravity_props_default_mesh_fftw_planner "estimate"
+#define gravity_props_default_mesh_green_function_cache 0
+#define gravity_props_default_mesh_window_order 2
+#define gravity_props_default_mesh_interlacing 0
+#define gravity_props_default_mesh_tasks 0
+#define gravity_props_default_fR_solver 0
+#define gravity_props_default_fR0 1e-5
+#define gravity_props_default_multigrid_tolerance 1e-4
+#define gravity_props_default_multigrid_max_vcycles 20
+#define gravity_props_default_multigrid_smoothing_steps 2
+#define gravity_props_default_multigrid_max_levels 16
 
 void gravity_props_init(struct gravity_props *p, struct swift_params *params,
                         const struct phys_const *phys_const,
@@ -60,17 +77,61 @@ void gravity_props_init(struct gravity_props *p, struct swift_params *params,
       parser_get_opt_param_float(params, "Gravity:rebuild_active_fraction",
                                  gravity_props_default_rebuild_active_fraction);
 
+  /* Lazy reconstruction of the multipoles between rebuilds? */
+  p->lazy_multipole_reconstruction = parser_get_opt_param_int(
+      params, "Gravity:lazy_multipole_reconstruction",
+      gravity_props_default_lazy_multipole_reconstruction);
+
   if (p->rebuild_frequency < 0.f || p->rebuild_frequency > 1.f)
     error("Invalid tree rebuild frequency. Must be in [0., 1.]");
 
+#ifdef SWIFT_MULTIPOLE_SPHERICAL
+  if (periodic)
+    error(
+        "The solid-harmonic multipoles cannot be used with periodic "
+        "gravity. Re-configure with --with-multipole-backend=cartesian.");
+#endif
+
   /* Tree-PM parameters */
   if (periodic) {
     p->mesh_size = parser_get_param_int(params, "Gravity:mesh_side_length");
     p->distributed_mesh =
         parser_get_opt_param_int(params, "Gravity:distributed_mesh",
                                  gravity_props_default_distributed_mesh);
+    p->mesh_reduce_scatter =
+        parser_get_opt_param_int(params, "Gravity:mesh_reduce_scatter",
+                                 gravity_props_default_mesh_reduce_scatter);
+    p->top_multipoles_neighbours = parser_get_opt_param_int(
+        params, "Gravity:top_multipoles_neighbours",
+        gravity_props_default_top_multipoles_neighbours);
     p->mesh_uses_local_patches =
         parser_get_opt_param_int(params, "Gravity:mesh_uses_local_patches", 1);
+
+    /* The assignment engine defaults to what the older flag asks for */
+    char assignment[32];
+    parser_get_opt_param_string(
+        params, "Gravity:mesh_assignment", assignment,
+        p->mesh_uses_local_patches ? "patches" : "atomic");
+    if (strcmp(assignment, "atomic") == 0)
+      p->mesh_assignment = mesh_assignment_atomic;
+    else if (strcmp(assignment, "patches") == 0)
+      p->mesh_assignment = mesh_assignment_patches;
+    else if (strcmp(assignment, "tiles") == 0)
+      p->mesh_assignment = mesh_assignment_tiles;
+    else
+      error(
+          "Invalid mesh assignment '%s'. Must be 'atomic', 'patches' or "
+          "'tiles'.",
+          assignment);
+    p->mesh_window_order =
+        parser_get_opt_param_int(params, "Gravity:mesh_window_order",
+                                 gravity_props_default_mesh_window_order);
+    p->mesh_interlacing =
+        parser_get_opt_param_int(params, "Gravity:mesh_interlacing",
+                                 gravity_props_default_mesh_interlacing);
+    p->mesh_single_precision =
+        parser_get_opt_param_int(params, "Gravity:mesh_single_precision",
+                                 gravity_props_default_mesh_single_precision);
     p->a_smooth = parser_get_opt_param_float(params, "Gravity:a_smooth",
                                              gravity_props_default_a_smooth);
     p->r_cut_max_ratio = parser_get_opt_param_float(
@@ -81,6 +142,35 @@ void gravity_props_init(struct gravity_props *p, struct swift_params *params,
     p->r_s = p->a_smooth * dim[0] / p->mesh_size;
     p->r_s_inv = 1. / p->r_s;
 
+    char planner[32];
+    parser_get_opt_param_string(params, "Gravity:mesh_fftw_planner", planner,
+                                gravity_props_default_mesh_fftw_planner);
+    p->mesh_fftw_planner = fft_plans_effort_from_name(planner);
+
+    p->mesh_green_function_cache = parser_get_opt_param_int(
+        params, "Gravity:mesh_green_function_cache",
+        gravity_props_default_mesh_green_function_cache);
+    p->mesh_tasks = parser_get_opt_param_int(params, "Gravity:mesh_tasks",
+                                             gravity_props_default_mesh_tasks);
+
+    /* Chameleon f(R) field solver */
+    p->mesh_fR_solver = parser_get_opt_param_int(
+        params, "Gravity:fR_solver", gravity_props_default_fR_solver);
+    p->mesh_fR0 = parser_get_opt_param_double(params, "Gravity:fR_fR0",
+                                              gravity_props_default_fR0);
+    p->mesh_multigrid_tolerance = parser_get_opt_param_double(
+        params, "Gravity:multigrid_tolerance",
+        gravity_props_default_multigrid_tolerance);
+    p->mesh_multigrid_max_vcycles = parser_get_opt_param_int(
+        params, "Gravity:multigrid_max_vcycles",
+        gravity_props_default_multigrid_max_vcycles);
+    p->mesh_multigrid_smoothing_steps = parser_get_opt_param_int(
+        params, "Gravity:multigrid_smoothing_steps",
+        gravity_props_default_multigrid_smoothing_steps);
+    p->mesh_multigrid_max_levels = parser_get_opt_param_int(
+        params, "Gravity:multigrid_max_levels",
+        gravity_props_default_multigrid_max_levels);
+
     /* Some basic checks of what we read */
     if (p->mesh_size % 2 != 0)
       error("The mesh side-length must be an even number.");
@@ -88,6 +178,76 @@ void gravity_props_init(struct gravity_props *p, struct swift_params *params,
     if (p->a_smooth <= 0.)
       error("The mesh smoothing scale 'a_smooth' must be > 0.");
 
+    if (p->mesh_window_order < 2 || p->mesh_window_order > 4)
+      error(
+          "The mesh window order must be 2 (CIC), 3 (TSC) or 4 (PCS), not "
+          "%d.",
+          p->mesh_window_order);
+
+    if (p->mesh_fR_solver && p->mesh_interlacing)
+      error("The f(R) field solver cannot be combined with mesh interlacing.");
+
+    if (p->distributed_mesh &&
+        (p->mesh_window_order != 2 || p->mesh_interlacing))
+      error(
+          "The distributed mesh only supports CIC assignment without "
+          "interlacing.");
+
+    if (p->distributed_mesh && p->mesh_reduce_scatter)
+      error(
+          "The distributed mesh and the reduce-scatter mesh cannot be used "
+          "together.");
+
+    if (p->mesh_reduce_scatter &&
+        (p->mesh_window_order != 2 || p->mesh_interlacing))
+      error(
+          "The reduce-scatter mesh only supports CIC assignment without "
+          "interlacing.");
+
+    if (p->mesh_single_precision &&
+        (p->distributed_mesh || p->mesh_reduce_scatter))
+      error(
+          "The single-precision mesh is only available for the global "
+          "(non-distributed) mesh.");
+
+    if (p->mesh_single_precision && p->mesh_interlacing)
+      error("The single-precision mesh cannot be combined with interlacing.");
+
+    if (p->mesh_single_precision && p->mesh_fR_solver)
+      error(
+          "The single-precision mesh cannot be combined with the f(R) field "
+          "solver.");
+
+#ifndef HAVE_FFTWF
+    if (p->mesh_single_precision)
+      error(
+          "Need the single-precision FFTW library (libfftw3f) to run with a "
+          "single-precision mesh.");
+#endif
+
+    if (p->mesh_tasks && p->mesh_single_precision)
+      error(
+          "The mesh tasks cannot be combined with the single-precision "
+          "mesh.");
+
+    if (p->mesh_tasks && p->mesh_assignment == mesh_assignment_tiles)
+      error(
+          "The mesh tasks assign the cells one at a time and cannot use the "
+          "'tiles' mesh assignment.");
+
+    if (p->mesh_tasks && p->mesh_fR_solver)
+      error("The mesh tasks cannot be combined with the f(R) field solver.");
+
+    if (p->mesh_fR_solver && !with_cosmology)
+      error("The f(R) field solver can only be used in cosmological runs.");
+
+    if (p->mesh_fR_solver && p->mesh_fR0 <= 0.)
+      error("The background value 'fR_fR0' must be > 0.");
+
+    if (p->mesh_fR_solver && (p->mesh_multigrid_smoothing_steps < 1 ||
+                              p->mesh_multigrid_max_levels < 1))
+      error("Invalid multigrid smoothing steps or number of levels.");
+
 #if !defined(WITH_MPI) || !defined(HAVE_MPI_FFTW)
     if (p->distributed_mesh)
       error(
@@ -95,6 +255,16 @@ void gravity_props_init(struct gravity_props *p, struct swift_params *params,
           "--enable-mpi-mesh-gravity) to run with distributed mesh.");
 #endif
 
+#ifndef WITH_MPI
+    /* Nothing to scatter without MPI */
+    p->mesh_reduce_scatter = 0;
+#endif
+
+    if (p->mesh_tasks && (p->distributed_mesh || p->mesh_reduce_scatter))
+      error(
+          "The mesh tasks are only available for the global "
+          "(non-distributed) mesh.");
+
     if (2. * p->a_smooth * p->r_cut_max_ratio > p->mesh_size)
       error("Mesh too small given r_cut_max. Should be at least %d cells wide.",
             (int)(2. * p->a_smooth * p->r_cut_max_ratio) + 1);
@@ -108,6 +278,15 @@ void gravity_props_init(struct gravity_props *p, struct swift_params *params,
   } else {
     p->mesh_size = 0;
     p->distributed_mesh = 0;
+    p->mesh_reduce_scatter = 0;
+    p->top_multipoles_neighbours = 0;
+    p->mesh_single_precision = 0;
+    p->mesh_fftw_planner = fft_plans_estimate;
+    p->mesh_green_function_cache = 0;
+    p->mesh_window_order = 0;
+    p->mesh_interlacing = 0;
+    p->mesh_tasks = 0;
+    p->mesh_fR_solver = 0;
     p->a_smooth = 0.f;
     p->r_s = FLT_MAX;
     p->r_s_inv = 0.f;
@@ -158,12 +337,22 @@ void gravity_props_init(struct gravity_props *p, struct swift_params *params,
   p->use_tree_below_softening =
       parser_get_opt_param_int(params, "Gravity:use_tree_below_softening", 0);
 
+  /* Are we grouping top-level cells in the long-range interactions? */
+  p->use_long_range_groups =
+      parser_get_opt_param_int(params, "Gravity:use_long_range_groups", 1);
+
 #ifdef GADGET2_SOFTENING_CORRECTION
   if (p->use_tree_below_softening)
     error(
         "Cannot solve gravity via the tree below softening with the "
         "Gadget2-type softening kernel");
 #endif
+#ifdef SWIFT_MULTIPOLE_SPHERICAL
+  if (p->use_tree_below_softening)
+    error(
+        "Cannot solve gravity via the tree below softening with the "
+        "solid-harmonic multipoles");
+#endif
 
   /* Softening parameters */
   if (with_cosmology) {
@@ -256,6 +445,27 @@ void gravity_props_update_MAC_choice(struct gravity_props *p) {
   if (p->use_adaptive_tolerance) p->use_advanced_MAC = 1;
 }
 
+/**
+ * @brief Returns the largest drift error of a multipole, relative to its
+ * size, for which drifting it rather than reconstructing it stays within
+ * the accuracy of the MAC.
+ *
+ * Displacing the mass of a multipole of size r_max by d changes its field at
+ * a distance r by a relative amount of order d / r. Since the MAC only
+ * accepts r >= r_max / theta (with theta = theta_crit for the geometric MAC
+ * and 1 for the adaptive one), this remains below the error the MAC itself
+ * tolerates (theta_crit^(p+1) or epsilon_fmm) as long as
+ * d / r_max <= error / theta.
+ *
+ * @param p The #gravity_props.
+ */
+double gravity_props_multipole_drift_tolerance(const struct gravity_props *p) {
+
+  if (p->use_advanced_MAC) return p->adaptive_tolerance;
+
+  return pow(p->theta_crit, SELF_GRAVITY_MULTIPOLE_ORDER);
+}
+
 void gravity_props_update(struct gravity_props *p,
                           const struct cosmology *cosmo) {
 
@@ -293,8 +503,14 @@ void gravity_props_print(const struct gravity_props *p) {
 
   message("Self-gravity scheme: %s", GRAVITY_IMPLEMENTATION);
 
+#ifdef SWIFT_MULTIPOLE_SPHERICAL
+  message(
+      "Self-gravity scheme: FMM-MM with solid-harmonic m-poles of order %d",
+      SELF_GRAVITY_MULTIPOLE_ORDER);
+#else
   message("Self-gravity scheme: FMM-MM with m-poles of order %d",
           SELF_GRAVITY_MULTIPOLE_ORDER);
+#endif
 
   message("Self-gravity time integration: eta=%.4f", p->eta);
 
@@ -358,6 +574,32 @@ void gravity_props_print(const struct gravity_props *p) {
   message("Self-gravity mesh side-length: N=%d", p->mesh_size);
   message("Self-gravity mesh smoothing-scale: a_smooth=%f", p->a_smooth);
   message("Self-gravity distributed mesh enabled: %d", p->distributed_mesh);
+  if (p->mesh_reduce_scatter)
+    message("Self-gravity mesh density reduce-scattered to slabs");
+  if (p->top_multipoles_neighbours)
+    message(
+        "Self-gravity top-level multipoles only exchanged within the mesh "
+        "truncation radius");
+  if (!p->distributed_mesh)
+    message("Self-gravity mesh assignment: %s",
+            p->mesh_assignment == mesh_assignment_tiles
+                ? "tiles"
+                : (p->mesh_assignment == mesh_assignment_patches ? "patches"
+                                                                 : "atomic"));
+  message("Self-gravity mesh assignment window: %s%s",
+          mesh_window_name(p->mesh_window_order),
+          p->mesh_interlacing ? " with interlacing" : "");
+  if (p->mesh_single_precision)
+    message("Self-gravity mesh stored and transformed in single precision");
+  message("Self-gravity mesh FFTW planner: %s",
+          fft_plans_effort_name(p->mesh_fftw_planner));
+  if (p->mesh_green_function_cache)
+    message("Self-gravity mesh Green function cached in single precision");
+  if (p->mesh_tasks)
+    message("Self-gravity mesh forces computed by tasks");
+  if (p->mesh_fR_solver)
+    message("Self-gravity f(R) field solver enabled: |f_R0|=%e",
+            p->mesh_fR0);
 
   message("Self-gravity tree cut-off ratio: r_cut_max=%f", p->r_cut_max_ratio);
   message("Self-gravity truncation cut-off ratio: r_cut_min=%f",
@@ -367,6 +609,9 @@ void gravity_props_print(const struct gravity_props *p) {
           kernel_long_gravity_truncation_name);
 
   message("Self-gravity tree update frequency: f=%f", p->rebuild_frequency);
+
+  if (p->lazy_multipole_reconstruction)
+    message("Self-gravity multipoles reconstructed lazily between rebuilds");
 }
 
 #if defined(HAVE_HDF5)
@@ -31,6 +31,15 @@ struct cosmology;
 struct phys_const;
 struct swift_params;
 
+/**
+ * @brief How the particles are assigned to the long-range gravity mesh.
+ */
+enum mesh_assignment_mode {
+  mesh_assignment_atomic = 0, /*!< Direct atomic writes to the global mesh */
+  mesh_assignment_patches,    /*!< Per-cell patches added back atomically */
+  mesh_assignment_tiles /*!< Per-cell patches reduced without atomics */
+};
+
 /**
  * @brief Contains all the constants and parameters of the self-gravity scheme
  */
@@ -79,6 +88,9 @@ struct gravity_props {
   /*! Are we allowing tree gravity below softening? */
   int use_tree_below_softening;
 
+  /*! Do the long-range tasks interact with groups of top-level cells? */
+  int use_long_range_groups;
+
   /*! Are we applying long-range truncation to the forces in the MAC? */
   int consider_truncation_in_MAC;
 
@@ -117,6 +129,10 @@ struct gravity_props {
   /*! Fraction of active #gparts needed to trigger a tree-rebuild */
   float rebuild_active_fraction;
 
+  /*! Are we reconstructing (only) the multipoles whose drift error exceeds
+   * the tolerance of the MAC at every step? */
+  int lazy_multipole_reconstruction;
+
   /*! Time integration dimensionless multiplier */
   float eta;
 
@@ -128,10 +144,31 @@ struct gravity_props {
   /*! Whether mesh is distributed between MPI ranks when we use MPI  */
   int distributed_mesh;
 
+  /*! Whether the density of a non-distributed mesh is reduce-scattered to
+   * slabs (rather than all-reduced) when we use MPI */
+  int mesh_reduce_scatter;
+
+  /*! Are the top-level multipoles only exchanged in full between the ranks
+   * with cells within the truncation radius of each other? */
+  int top_multipoles_neighbours;
+
   /*! Whether or not to use local patches rather than
    * direct atomic writes to the mesh when running without MPI */
   int mesh_uses_local_patches;
 
+  /*! How particles are assigned to the mesh when running without MPI */
+  enum mesh_assignment_mode mesh_assignment;
+
+  /*! Order of the mass assignment window of the mesh (2: CIC, 3: TSC,
+   * 4: PCS) */
+  int mesh_window_order;
+
+  /*! Do we store the mesh and do its FFTs in single precision? */
+  int mesh_single_precision;
+
+  /*! Do we assign the mass to a second mesh shifted by half a cell? */
+  int mesh_interlacing;
+
   /*! Mesh smoothing scale in units of top-level cell size */
   float a_smooth;
 
@@ -149,6 +186,33 @@ struct gravity_props {
   /*! Inverse of the long-range gravity mesh scale. */
   float r_s_inv;
 
+  /*! Effort FFTW spends planning the mesh transforms */
+  int mesh_fftw_planner;
+
+  /*! Cache the full Green function of the mesh in single precision? */
+  int mesh_green_function_cache;
+
+  /*! Compute the mesh forces with tasks overlapping the tree walk? */
+  int mesh_tasks;
+
+  /*! Solve the chameleon f(R) scalar field on the mesh? */
+  int mesh_fR_solver;
+
+  /*! Present-day background value of |f_R| (Hu-Sawicki n=1 model) */
+  double mesh_fR0;
+
+  /*! Relative rms residual at which the multigrid iterations stop */
+  double mesh_multigrid_tolerance;
+
+  /*! Maximal number of multigrid V-cycles per mesh step */
+  int mesh_multigrid_max_vcycles;
+
+  /*! Number of red-black sweeps before and after each coarse correction */
+  int mesh_multigrid_smoothing_steps;
+
+  /*! Maximal number of levels of the multigrid hierarchy */
+  int mesh_multigrid_max_levels;
+
   /* ------------- Physical constants ---------------------------------- */
 
   /*! Gravitational constant (in internal units, copied from the physical
@@ -168,6 +232,7 @@ void gravity_props_init(struct gravity_props *p, struct swift_params *params,
 void gravity_props_update(struct gravity_props *p,
                           const struct cosmology *cosmo);
 void gravity_props_update_MAC_choice(struct gravity_props *p);
+double gravity_props_multipole_drift_tolerance(const struct gravity_props *p);
 #if defined(HAVE_HDF5)
 void gravity_props_print_snapshot(hid_t h_grpsph,
                                   const struct gravity_props *p);
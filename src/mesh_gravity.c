@@ -35,10 +35,13 @@
 #include "debug.h"
 #include "engine.h"
 #include "error.h"
+#include "fft_plans.h"
 #include "gravity_properties.h"
+#include "integer_power.h"
 #include "kernel_long_gravity.h"
 #include "mesh_gravity_mpi.h"
 #include "mesh_gravity_patch.h"
+#include "mesh_window.h"
 #include "neutrino.h"
 #include "part.h"
 #include "restart.h"
@@ -50,8 +53,6 @@
 /* Standard includes */
 #include <math.h>
 
-#ifdef HAVE_FFTW
-
 /**
  * @brief Interpolate values from a the mesh using CIC.
  *
@@ -182,19 +183,200 @@ INLINE static void gpart_to_mesh_CIC(const struct gpart* gp, double* rho,
 }
 
 /**
- * @brief Assigns all the #gpart of a #cell to a density mesh using the CIC
- * method.
+ * @brief Assigns a given #gpart to a density mesh using a window of any
+ * order, possibly on a mesh shifted with respect to the box.
+ *
+ * @param gp The #gpart.
+ * @param rho The density mesh.
+ * @param N the size of the mesh along one axis.
+ * @param fac The inverse of the width of a mesh cell.
+ * @param dim The dimensions of the simulation box.
+ * @param order The order of the window (see mesh_window_weights()).
+ * @param shift The shift of the particle positions in units of mesh cells.
+ * @param nu_model Struct with neutrino constants
+ */
+INLINE static void gpart_to_mesh_window(const struct gpart* gp, double* rho,
+                                        const int N, const double fac,
+                                        const double dim[3], const int order,
+                                        const double shift,
+                                        const struct neutrino_model* nu_model) {
+
+#ifdef SWIFT_DEBUG_CHECKS
+  if (gp->time_bin == time_bin_not_created)
+    error("Found an extra particle in mesh assignment.");
+#endif
+
+  /* Weights of the window along each axis */
+  double wx[MESH_WINDOW_MAX_ORDER], wy[MESH_WINDOW_MAX_ORDER],
+      wz[MESH_WINDOW_MAX_ORDER];
+  const int i = mesh_window_weights(
+      order, fac * box_wrap(gp->x[0], 0., dim[0]) + shift, wx);
+  const int j = mesh_window_weights(
+      order, fac * box_wrap(gp->x[1], 0., dim[1]) + shift, wy);
+  const int k = mesh_window_weights(
+      order, fac * box_wrap(gp->x[2], 0., dim[2]) + shift, wz);
+
+  /* Compute weight (for neutrino delta-f weighting) */
+  double weight = 1.0;
+  if (gp->type == swift_type_neutrino)
+    gpart_neutrino_weight_mesh_only(gp, nu_model, &weight);
+
+  const double value = gp->mass * weight;
+
+  for (int a = 0; a < order; ++a) {
+    for (int b = 0; b < order; ++b) {
+      const double wxy = value * wx[a] * wy[b];
+      for (int c = 0; c < order; ++c)
+        atomic_add_d(&rho[row_major_id_periodic(i + a, j + b, k + c, N)],
+                     wxy * wz[c]);
+    }
+  }
+}
+
+/**
+ * @brief Assigns a given #gpart to a density mesh using the window requested,
+ * picking the specialised CIC version whenever possible.
+ *
+ * @param gp The #gpart.
+ * @param rho The density mesh.
+ * @param N the size of the mesh along one axis.
+ * @param fac The inverse of the width of a mesh cell.
+ * @param dim The dimensions of the simulation box.
+ * @param order The order of the window.
+ * @param shift The shift of the particle positions in units of mesh cells.
+ * @param nu_model Struct with neutrino constants
+ */
+INLINE static void gpart_to_mesh(const struct gpart* gp, double* rho,
+                                 const int N, const double fac,
+                                 const double dim[3], const int order,
+                                 const double shift,
+                                 const struct neutrino_model* nu_model) {
+  if (order == 2 && shift == 0.)
+    gpart_to_mesh_CIC(gp, rho, N, fac, dim, nu_model);
+  else
+    gpart_to_mesh_window(gp, rho, N, fac, dim, order, shift, nu_model);
+}
+
+/**
+ * @brief Assigns a given #gpart to a single-precision density mesh using a
+ * window of any order (CIC included).
+ *
+ * @param gp The #gpart.
+ * @param rho The density mesh.
+ * @param N the size of the mesh along one axis.
+ * @param fac The inverse of the width of a mesh cell.
+ * @param dim The dimensions of the simulation box.
+ * @param order The order of the window (see mesh_window_weights()).
+ * @param nu_model Struct with neutrino constants
+ */
+INLINE static void gpart_to_mesh_single(const struct gpart* gp, float* rho,
+                                        const int N, const double fac,
+                                        const double dim[3], const int order,
+                                        const struct neutrino_model* nu_model) {
+
+#ifdef SWIFT_DEBUG_CHECKS
+  if (gp->time_bin == time_bin_not_created)
+    error("Found an extra particle in mesh assignment.");
+#endif
+
+  /* Weights of the window along each axis */
+  double wx[MESH_WINDOW_MAX_ORDER], wy[MESH_WINDOW_MAX_ORDER],
+      wz[MESH_WINDOW_MAX_ORDER];
+  const int i =
+      mesh_window_weights(order, fac * box_wrap(gp->x[0], 0., dim[0]), wx);
+  const int j =
+      mesh_window_weights(order, fac * box_wrap(gp->x[1], 0., dim[1]), wy);
+  const int k =
+      mesh_window_weights(order, fac * box_wrap(gp->x[2], 0., dim[2]), wz);
+
+  /* Compute weight (for neutrino delta-f weighting) */
+  double weight = 1.0;
+  if (gp->type == swift_type_neutrino)
+    gpart_neutrino_weight_mesh_only(gp, nu_model, &weight);
+
+  const double value = gp->mass * weight;
+
+  for (int a = 0; a < order; ++a) {
+    for (int b = 0; b < order; ++b) {
+      const double wxy = value * wx[a] * wy[b];
+      for (int c = 0; c < order; ++c)
+        atomic_add_f(&rho[row_major_id_periodic(i + a, j + b, k + c, N)],
+                     (float)(wxy * wz[c]));
+    }
+  }
+}
+
+/**
+ * @brief Accumulate the mass of the particles of a cell to a new mesh patch
+ * covering the cell using a window of any order.
+ *
+ * @param N The size of the mesh
+ * @param fac Inverse of the cell size
+ * @param dim The dimensions of the simulation box.
+ * @param cell The #cell containing the particles.
+ * @param patch The local mesh patch (allocated here).
+ * @param order The order of the window.
+ * @param shift The shift of the particle positions in units of mesh cells.
+ * @param nu_model Struct with neutrino constants
+ */
+static void accumulate_cell_to_local_patch_window(
+    const int N, const double fac, const double* dim, const struct cell* cell,
+    struct pm_mesh_patch* patch, const int order, const double shift,
+    const struct neutrino_model* nu_model) {
+
+  if (cell->grav.count == 0) return;
+
+  /* Two extra layers are enough for PCS with a shift of half a cell */
+  pm_mesh_patch_init(patch, cell, N, fac, dim, /*boundary_size=*/2);
+  pm_mesh_patch_zero(patch);
+
+  for (int ipart = 0; ipart < cell->grav.count; ipart++) {
+
+    const struct gpart* gp = &cell->grav.parts[ipart];
+    if (gp->time_bin == time_bin_inhibited) continue;
+
+    /* Box wrap the particle's position to the copy nearest the cell centre */
+    const double pos_x =
+        box_wrap(gp->x[0], patch->wrap_min[0], patch->wrap_max[0]);
+    const double pos_y =
+        box_wrap(gp->x[1], patch->wrap_min[1], patch->wrap_max[1]);
+    const double pos_z =
+        box_wrap(gp->x[2], patch->wrap_min[2], patch->wrap_max[2]);
+
+    double wx[MESH_WINDOW_MAX_ORDER], wy[MESH_WINDOW_MAX_ORDER],
+        wz[MESH_WINDOW_MAX_ORDER];
+    const int i = mesh_window_weights(order, fac * pos_x + shift, wx);
+    const int j = mesh_window_weights(order, fac * pos_y + shift, wy);
+    const int k = mesh_window_weights(order, fac * pos_z + shift, wz);
+
+    /* Compute weight (for neutrino delta-f weighting) */
+    double weight = 1.0;
+    if (gp->type == swift_type_neutrino)
+      gpart_neutrino_weight_mesh_only(gp, nu_model, &weight);
+
+    pm_mesh_patch_window_set(patch, order, i - patch->mesh_min[0],
+                             j - patch->mesh_min[1], k - patch->mesh_min[2],
+                             wx, wy, wz, gp->mass * weight);
+  }
+}
+
+/**
+ * @brief Assigns all the #gpart of a #cell to a density mesh using a given
+ * window.
  *
  * @param c The #cell.
  * @param rho The density mesh.
  * @param N the size of the mesh along one axis.
  * @param fac The width of a mesh cell.
  * @param dim The dimensions of the simulation box.
+ * @param order The order of the window.
+ * @param shift The shift of the particle positions in units of mesh cells.
  * @param nu_model Struct with neutrino constants
  */
-void cell_gpart_to_mesh_CIC(const struct cell* c, double* rho, const int N,
-                            const double fac, const double dim[3],
-                            const struct neutrino_model* nu_model) {
+void cell_gpart_to_mesh(const struct cell* c, double* rho, const int N,
+                        const double fac, const double dim[3], const int order,
+                        const double shift,
+                        const struct neutrino_model* nu_model) {
 
   const int gcount = c->grav.count;
   const struct gpart* gparts = c->grav.parts;
@@ -202,7 +384,7 @@ void cell_gpart_to_mesh_CIC(const struct cell* c, double* rho, const int N,
   /* Assign all the gpart of that cell to the mesh */
   for (int i = 0; i < gcount; ++i) {
     if (gparts[i].time_bin == time_bin_inhibited) continue;
-    gpart_to_mesh_CIC(&gparts[i], rho, N, fac, dim, nu_model);
+    gpart_to_mesh(&gparts[i], rho, N, fac, dim, order, shift, nu_model);
   }
 }
 
@@ -214,40 +396,54 @@ struct cic_mapper_data {
   const struct cell* cells;
   double* rho;
   double* potential;
+  double* potential2;
+  float* rho_single;
+  const float* potential_single;
   int N;
-  int use_local_patches;
+  int window_order;
+  double shift;
+  int assignment;
+  const int* local_cells;
+  struct pm_mesh_patch* patches;
   double fac;
   double dim[3];
   float const_G;
   struct neutrino_model* nu_model;
 };
 
-void gpart_to_mesh_CIC_mapper(void* map_data, int num, void* extra) {
+void gpart_to_mesh_mapper(void* map_data, int num, void* extra) {
 
   const struct cic_mapper_data* data = (struct cic_mapper_data*)extra;
   double* rho = data->rho;
   const int N = data->N;
   const double fac = data->fac;
   const double dim[3] = {data->dim[0], data->dim[1], data->dim[2]};
+  const int order = data->window_order;
+  const double shift = data->shift;
   const struct neutrino_model* nu_model = data->nu_model;
+  float* rho_single = data->rho_single;
 
   /* Pointer to the chunk to be processed */
   const struct gpart* gparts = (const struct gpart*)map_data;
 
   for (int i = 0; i < num; ++i) {
     if (gparts[i].time_bin == time_bin_inhibited) continue;
-    gpart_to_mesh_CIC(&gparts[i], rho, N, fac, dim, nu_model);
+    if (rho_single != NULL)
+      gpart_to_mesh_single(&gparts[i], rho_single, N, fac, dim, order,
+                           nu_model);
+    else
+      gpart_to_mesh(&gparts[i], rho, N, fac, dim, order, shift, nu_model);
   }
 }
 
 /**
- * @brief Threadpool mapper function for the mesh CIC assignment of a cell.
+ * @brief Threadpool mapper function for the mesh assignment of a cell.
  *
  * @param map_data A chunk of the list of local cells.
  * @param num The number of cells in the chunk.
  * @param extra The information about the mesh and cells.
  */
-void cell_gpart_to_mesh_CIC_mapper(void* map_data, int num, void* extra) {
+void cell_gpart_to_mesh_mapper(void* map_data, int num, void* extra) {
 
   /* Unpack the shared information */
   const struct cic_mapper_data* data = (struct cic_mapper_data*)extra;
@@ -256,6 +452,9 @@ void cell_gpart_to_mesh_CIC_mapper(void* map_data, int num, void* extra) {
   const int N = data->N;
   const double fac = data->fac;
   const double dim[3] = {data->dim[0], data->dim[1], data->dim[2]};
+  const int order = data->window_order;
+  const double shift = data->shift;
+  const int use_CIC = (order == 2 && shift == 0.);
   const struct neutrino_model* nu_model = data->nu_model;
 
   /* Pointer to the chunk to be processed */
@@ -273,11 +472,40 @@ void cell_gpart_to_mesh_CIC_mapper(void* map_data, int num, void* extra) {
     /* Skip empty cells */
     if (c->grav.count == 0) continue;
 
-    if (data->use_local_patches) {
+    if (data->rho_single != NULL) {
+
+      /* Accumulate the cell in double precision on a local patch and only
+       * round when adding it to the single-precision mesh */
+      if (use_CIC)
+        accumulate_cell_to_local_patch(N, fac, dim, c, &patch, nu_model);
+      else
+        accumulate_cell_to_local_patch_window(N, fac, dim, c, &patch, order,
+                                              shift, nu_model);
+      pm_add_patch_to_global_mesh_single(data->rho_single, &patch);
+      pm_mesh_patch_clean(&patch);
 
-      /* Do a CIC interpolation of all the particles in this cell onto
-         the local patch (allocates memory in the patch) */
-      accumulate_cell_to_local_patch(N, fac, dim, c, &patch, nu_model);
+    } else if (data->assignment == mesh_assignment_tiles) {
+
+      /* Assign all the particles in this cell onto its own patch.
+         The patches get reduced once they are all done. */
+      const size_t offset = local_cells - data->local_cells;
+      if (use_CIC)
+        accumulate_cell_to_local_patch(N, fac, dim, c,
+                                       &data->patches[offset + i], nu_model);
+      else
+        accumulate_cell_to_local_patch_window(N, fac, dim, c,
+                                              &data->patches[offset + i],
+                                              order, shift, nu_model);
+
+    } else if (data->assignment == mesh_assignment_patches) {
+
+      /* Assign all the particles in this cell onto the local patch
+         (allocates memory in the patch) */
+      if (use_CIC)
+        accumulate_cell_to_local_patch(N, fac, dim, c, &patch, nu_model);
+      else
+        accumulate_cell_to_local_patch_window(N, fac, dim, c, &patch, order,
+                                              shift, nu_model);
 
       /* Copy the local patch values back onto the global mesh */
       pm_add_patch_to_global_mesh(rho, &patch);
@@ -288,11 +516,84 @@ void cell_gpart_to_mesh_CIC_mapper(void* map_data, int num, void* extra) {
     } else {
 
       /* Assign this cell's content directly atomically to the mesh */
-      cell_gpart_to_mesh_CIC(c, rho, N, fac, dim, nu_model);
+      cell_gpart_to_mesh(c, rho, N, fac, dim, order, shift, nu_model);
     }
   }
 }
 
+/**
+ * @brief Assigns the #gpart of a list of top-level cells to a density mesh.
+ *
+ * The mesh is not zeroed first. Three assignment engines are available:
+ * direct atomic writes of every particle to the mesh, per-cell patches that
+ * are added back to the mesh atomically, or per-cell patches (tiles) that
+ * are all kept until a parallel reduction over the planes of the mesh which
+ * does not need any atomic operation.
+ *
+ * @param tp The #threadpool.
+ * @param rho The N^3 density mesh.
+ * @param N The size of the mesh along one axis.
+ * @param fac The inverse of the width of a mesh cell.
+ * @param dim The dimensions of the simulation box.
+ * @param cells The top-level cells.
+ * @param local_cells The indices of the cells to assign.
+ * @param nr_local_cells The number of cells to assign.
+ * @param assignment The #mesh_assignment_mode to use.
+ * @param window_order The order of the window (2: CIC, 3: TSC, 4: PCS).
+ * @param shift The shift of the particle positions in units of mesh cells
+ * (0.5 for the second mesh of interlacing).
+ * @param nu_model Struct with neutrino constants.
+ */
+void cells_gpart_to_mesh(struct threadpool* tp, double* rho, const int N,
+                         const double fac, const double dim[3],
+                         const struct cell* cells, const int* local_cells,
+                         const int nr_local_cells,
+                         const enum mesh_assignment_mode assignment,
+                         const int window_order, const double shift,
+                         struct neutrino_model* nu_model) {
+
+  struct cic_mapper_data data;
+  data.cells = cells;
+  data.rho = rho;
+  data.potential = NULL;
+  data.potential2 = NULL;
+  data.rho_single = NULL;
+  data.potential_single = NULL;
+  data.N = N;
+  data.window_order = window_order;
+  data.shift = shift;
+  data.assignment = assignment;
+  data.local_cells = local_cells;
+  data.patches = NULL;
+  data.fac = fac;
+  data.dim[0] = dim[0];
+  data.dim[1] = dim[1];
+  data.dim[2] = dim[2];
+  data.const_G = 0.f;
+  data.nu_model = nu_model;
+
+  /* Room for one tile per cell (empty cells keep a NULL mesh) */
+  if (assignment == mesh_assignment_tiles) {
+    data.patches = (struct pm_mesh_patch*)calloc(nr_local_cells,
+                                                 sizeof(struct pm_mesh_patch));
+    if (data.patches == NULL && nr_local_cells > 0)
+      error("Could not allocate the array of mesh tiles");
+  }
+
+  threadpool_map(tp, cell_gpart_to_mesh_mapper, (void*)local_cells,
+                 nr_local_cells, sizeof(int), threadpool_auto_chunk_size,
+                 (void*)&data);
+
+  if (assignment == mesh_assignment_tiles) {
+    pm_add_patches_to_global_mesh(rho, data.patches, nr_local_cells, N, tp);
+    for (int i = 0; i < nr_local_cells; ++i)
+      if (data.patches[i].mesh != NULL) pm_mesh_patch_clean(&data.patches[i]);
+    free(data.patches);
+  }
+}
+
+#ifdef HAVE_FFTW
+
 /**
  * @brief Computes the potential on a gpart from a given mesh using the CIC
  * method.
@@ -393,9 +694,227 @@ void mesh_to_gpart_CIC(struct gpart* gp, const double* pot, const int N,
   gravity_add_comoving_mesh_potential(gp, p);
 }
 
-void cell_mesh_to_gpart_CIC(const struct cell* c, const double* potential,
-                            const int N, const double fac, const float const_G,
-                            const double dim[3]) {
+/*! Side-length of the local copy of the mesh needed by the interpolation */
+#define MESH_STENCIL_SIZE (MESH_WINDOW_MAX_ORDER + 4)
+
+/**
+ * @brief Interpolates the potential and its 5-point finite-difference
+ * gradient from a local copy of the mesh using a window of any order.
+ *
+ * @param phi The copy of the mesh, starting two points before the first point
+ * covered by the window along each axis.
+ * @param wx Weights of the window along x.
+ * @param wy Weights of the window along y.
+ * @param wz Weights of the window along z.
+ * @param order The order of the window.
+ * @param p (return) The potential.
+ * @param a (return) Minus the gradient of the potential in mesh units.
+ */
+INLINE static void mesh_window_stencil(
+    const double phi[MESH_STENCIL_SIZE][MESH_STENCIL_SIZE][MESH_STENCIL_SIZE],
+    const double* wx, const double* wy, const double* wz, const int order,
+    double* p, double a[3]) {
+
+  *p = 0.;
+  a[0] = 0.;
+  a[1] = 0.;
+  a[2] = 0.;
+  for (int ii = 2; ii < order + 2; ++ii) {
+    for (int jj = 2; jj < order + 2; ++jj) {
+      for (int kk = 2; kk < order + 2; ++kk) {
+
+        const double w = wx[ii - 2] * wy[jj - 2] * wz[kk - 2];
+
+        *p += w * phi[ii][jj][kk];
+
+        a[0] += w * ((1. / 12.) * phi[ii + 2][jj][kk] -
+                     (2. / 3.) * phi[ii + 1][jj][kk] +
+                     (2. / 3.) * phi[ii - 1][jj][kk] -
+                     (1. / 12.) * phi[ii - 2][jj][kk]);
+        a[1] += w * ((1. / 12.) * phi[ii][jj + 2][kk] -
+                     (2. / 3.) * phi[ii][jj + 1][kk] +
+                     (2. / 3.) * phi[ii][jj - 1][kk] -
+                     (1. / 12.) * phi[ii][jj - 2][kk]);
+        a[2] += w * ((1. / 12.) * phi[ii][jj][kk + 2] -
+                     (2. / 3.) * phi[ii][jj][kk + 1] +
+                     (2. / 3.) * phi[ii][jj][kk - 1] -
+                     (1. / 12.) * phi[ii][jj][kk - 2]);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Interpolates the potential and its 5-point finite-difference
+ * gradient from a mesh at a given position using a window of any order.
+ *
+ * @param pot The potential mesh.
+ * @param N the size of the mesh along one axis.
+ * @param pos The position in units of the mesh cell size.
+ * @param order The order of the window.
+ * @param p (return) The potential.
+ * @param a (return) Minus the gradient of the potential in mesh units.
+ */
+INLINE static void mesh_window_interpolate(const double* pot, const int N,
+                                           const double pos[3],
+                                           const int order, double* p,
+                                           double a[3]) {
+
+  double wx[MESH_WINDOW_MAX_ORDER], wy[MESH_WINDOW_MAX_ORDER],
+      wz[MESH_WINDOW_MAX_ORDER];
+  const int i = mesh_window_weights(order, pos[0], wx);
+  const int j = mesh_window_weights(order, pos[1], wy);
+  const int k = mesh_window_weights(order, pos[2], wz);
+
+  /* Copy the part of the mesh covered by the window and the stencil */
+  double phi[MESH_STENCIL_SIZE][MESH_STENCIL_SIZE][MESH_STENCIL_SIZE];
+  for (int iii = 0; iii < order + 4; ++iii)
+    for (int jjj = 0; jjj < order + 4; ++jjj)
+      for (int kkk = 0; kkk < order + 4; ++kkk)
+        phi[iii][jjj][kkk] = pot[row_major_id_periodic(
+            i + iii - 2, j + jjj - 2, k + kkk - 2, N)];
+
+  mesh_window_stencil(phi, wx, wy, wz, order, p, a);
+}
+
+/**
+ * @brief Computes the potential on a gpart from a single-precision mesh
+ * using a window of any order (CIC included).
+ *
+ * The local copy of the mesh and the interpolation are in double precision.
+ *
+ * @param gp The #gpart.
+ * @param pot The potential mesh.
+ * @param N the size of the mesh along one axis.
+ * @param fac width of a mesh cell.
+ * @param dim The dimensions of the simulation box.
+ * @param order The order of the window.
+ */
+void mesh_to_gpart_single(struct gpart* gp, const float* pot, const int N,
+                          const double fac, const double dim[3],
+                          const int order) {
+
+#ifdef SWIFT_DEBUG_CHECKS
+  if (gp->time_bin == time_bin_not_created)
+    error("Found an extra particle when computing gravity from mesh.");
+#endif
+
+  double wx[MESH_WINDOW_MAX_ORDER], wy[MESH_WINDOW_MAX_ORDER],
+      wz[MESH_WINDOW_MAX_ORDER];
+  const int i =
+      mesh_window_weights(order, fac * box_wrap(gp->x[0], 0., dim[0]), wx);
+  const int j =
+      mesh_window_weights(order, fac * box_wrap(gp->x[1], 0., dim[1]), wy);
+  const int k =
+      mesh_window_weights(order, fac * box_wrap(gp->x[2], 0., dim[2]), wz);
+
+  /* Copy the part of the mesh covered by the window and the stencil */
+  double phi[MESH_STENCIL_SIZE][MESH_STENCIL_SIZE][MESH_STENCIL_SIZE];
+  for (int iii = 0; iii < order + 4; ++iii)
+    for (int jjj = 0; jjj < order + 4; ++jjj)
+      for (int kkk = 0; kkk < order + 4; ++kkk)
+        phi[iii][jjj][kkk] = pot[row_major_id_periodic(
+            i + iii - 2, j + jjj - 2, k + kkk - 2, N)];
+
+  double p, a[3];
+  mesh_window_stencil(phi, wx, wy, wz, order, &p, a);
+
+  /* Store things back */
+  gp->a_grav_mesh[0] = fac * a[0];
+  gp->a_grav_mesh[1] = fac * a[1];
+  gp->a_grav_mesh[2] = fac * a[2];
+  gravity_add_comoving_mesh_potential(gp, p);
+}
+
+/**
+ * @brief Computes the potential on a gpart from a given mesh using a window
+ * of any order, averaging with an interlaced mesh if one is provided.
+ *
+ * @param gp The #gpart.
+ * @param pot The potential mesh.
+ * @param pot2 The potential on the mesh shifted by half a cell (or NULL).
+ * @param N the size of the mesh along one axis.
+ * @param fac width of a mesh cell.
+ * @param dim The dimensions of the simulation box.
+ * @param order The order of the window.
+ */
+void mesh_to_gpart_window(struct gpart* gp, const double* pot,
+                          const double* pot2, const int N, const double fac,
+                          const double dim[3], const int order) {
+
+#ifdef SWIFT_DEBUG_CHECKS
+  if (gp->time_bin == time_bin_not_created)
+    error("Found an extra particle when computing gravity from mesh.");
+#endif
+
+#ifdef SWIFT_GRAVITY_FORCE_CHECKS
+  if (gp->a_grav_mesh[0] != 0.) error("Particle with non-initalised stuff");
+#ifndef SWIFT_GRAVITY_NO_POTENTIAL
+  if (gp->potential_mesh != 0.) error("Particle with non-initalised stuff");
+#endif
+#endif
+
+  /* Box wrap the gpart's position */
+  double pos[3] = {fac * box_wrap(gp->x[0], 0., dim[0]),
+                   fac * box_wrap(gp->x[1], 0., dim[1]),
+                   fac * box_wrap(gp->x[2], 0., dim[2])};
+
+  double p, a[3];
+  mesh_window_interpolate(pot, N, pos, order, &p, a);
+
+  /* Average with the interlaced mesh */
+  if (pot2 != NULL) {
+    pos[0] += 0.5;
+    pos[1] += 0.5;
+    pos[2] += 0.5;
+
+    double p2, a2[3];
+    mesh_window_interpolate(pot2, N, pos, order, &p2, a2);
+
+    p = 0.5 * (p + p2);
+    a[0] = 0.5 * (a[0] + a2[0]);
+    a[1] = 0.5 * (a[1] + a2[1]);
+    a[2] = 0.5 * (a[2] + a2[2]);
+  }
+
+  /* Store things back */
+  gp->a_grav_mesh[0] = fac * a[0];
+  gp->a_grav_mesh[1] = fac * a[1];
+  gp->a_grav_mesh[2] = fac * a[2];
+  gravity_add_comoving_mesh_potential(gp, p);
+}
+
+/**
+ * @brief Computes the potential on a gpart from the mesh(es), picking the
+ * specialised CIC version whenever possible.
+ *
+ * @param gp The #gpart.
+ * @param pot The potential mesh.
+ * @param pot2 The potential on the mesh shifted by half a cell (or NULL).
+ * @param pot_single The single-precision potential mesh, used instead of the
+ * others if not NULL.
+ * @param N the size of the mesh along one axis.
+ * @param fac width of a mesh cell.
+ * @param dim The dimensions of the simulation box.
+ * @param order The order of the window.
+ */
+INLINE static void mesh_to_gpart(struct gpart* gp, const double* pot,
+                                 const double* pot2, const float* pot_single,
+                                 const int N, const double fac,
+                                 const double dim[3], const int order) {
+  if (pot_single != NULL)
+    mesh_to_gpart_single(gp, pot_single, N, fac, dim, order);
+  else if (order == 2 && pot2 == NULL)
+    mesh_to_gpart_CIC(gp, pot, N, fac, dim);
+  else
+    mesh_to_gpart_window(gp, pot, pot2, N, fac, dim, order);
+}
+
+void cell_mesh_to_gpart(const struct cell* c, const double* potential,
+                        const double* potential2,
+                        const float* potential_single, const int N,
+                        const double fac, const float const_G,
+                        const double dim[3], const int order) {
 
   const int gcount = c->grav.count;
   struct gpart* gparts = c->grav.parts;
@@ -414,7 +933,8 @@ void cell_mesh_to_gpart_CIC(const struct cell* c, const double* potential,
     gp->potential_mesh = 0.f;
 #endif
 
-    mesh_to_gpart_CIC(gp, potential, N, fac, dim);
+    mesh_to_gpart(gp, potential, potential2, potential_single, N, fac, dim,
+                  order);
 
     gp->a_grav_mesh[0] *= const_G;
     gp->a_grav_mesh[1] *= const_G;
@@ -425,12 +945,15 @@ void cell_mesh_to_gpart_CIC(const struct cell* c, const double* potential,
   }
 }
 
-void mesh_to_gpart_CIC_mapper(void* map_data, int num, void* extra) {
+void mesh_to_gpart_mapper(void* map_data, int num, void* extra) {
 
   /* Unpack the shared information */
   const struct cic_mapper_data* data = (struct cic_mapper_data*)extra;
   const double* const potential = data->potential;
+  const double* const potential2 = data->potential2;
+  const float* const potential_single = data->potential_single;
   const int N = data->N;
+  const int order = data->window_order;
   const double fac = data->fac;
   const double dim[3] = {data->dim[0], data->dim[1], data->dim[2]};
   const float const_G = data->const_G;
@@ -451,7 +974,8 @@ void mesh_to_gpart_CIC_mapper(void* map_data, int num, void* extra) {
     gp->potential_mesh = 0.f;
 #endif
 
-    mesh_to_gpart_CIC(gp, potential, N, fac, dim);
+    mesh_to_gpart(gp, potential, potential2, potential_single, N, fac, dim,
+                  order);
 
     gp->a_grav_mesh[0] *= const_G;
     gp->a_grav_mesh[1] *= const_G;
@@ -463,19 +987,22 @@ void mesh_to_gpart_CIC_mapper(void* map_data, int num, void* extra) {
 }
 
 /**
- * @brief Threadpool mapper function for the mesh CIC assignment of a cell.
+ * @brief Threadpool mapper function for the mesh interpolation to a cell.
  *
  * @param map_data A chunk of the list of local cells.
  * @param num The number of cells in the chunk.
  * @param extra The information about the mesh and cells.
  */
-void cell_mesh_to_gpart_CIC_mapper(void* map_data, int num, void* extra) {
+void cell_mesh_to_gpart_mapper(void* map_data, int num, void* extra) {
 
   /* Unpack the shared information */
   const struct cic_mapper_data* data = (struct cic_mapper_data*)extra;
   const struct cell* cells = data->cells;
   const double* const potential = data->potential;
+  const double* const potential2 = data->potential2;
+  const float* const potential_single = data->potential_single;
   const int N = data->N;
+  const int order = data->window_order;
   const double fac = data->fac;
   const double dim[3] = {data->dim[0], data->dim[1], data->dim[2]};
   const float const_G = data->const_G;
@@ -490,153 +1017,574 @@ void cell_mesh_to_gpart_CIC_mapper(void* map_data, int num, void* extra) {
     const struct cell* c = &cells[local_cells[i]];
 
     /* Assign this cell's content to the mesh */
-    cell_mesh_to_gpart_CIC(c, potential, N, fac, const_G, dim);
+    cell_mesh_to_gpart(c, potential, potential2, potential_single, N, fac,
+                       const_G, dim, order);
   }
 }
 
 /**
- * @brief Shared information about the Green function to be used by all the
- * threads in the pool.
+ * @brief Multiply a table indexed by the integer |k|^2 of the mesh modes by
+ * the scale-dependent modified-gravity enhancement at the current
+ * scale-factor.
+ *
+ * The G_eff(k,a)/G table is interpolated bilinearly in log(k) and log(a) at
+ * every possible integer value of |k|^2 = kx^2 + ky^2 + kz^2 (in units of the
+ * fundamental mode). Since the gravitational constant used by the mesh is
+ * already rescaled by G_eff(a) every step, the values are divided by it.
+ *
+ * @param e The #engine.
+ * @param N The side-length of the mesh.
+ * @param box_size The (comoving) side-length of the simulation box.
+ * @param k2_fac (in/out) The table of 3*(N/2)^2+1 factors to multiply.
  */
-struct Green_function_data {
+static void mesh_geff_k_multiply(const struct engine* e, const int N,
+                                 const double box_size, double* k2_fac) {
+
+  const struct mg_table_2d* t = &e->geff_k_table;
+
+  const double a = e->cosmology->a;
+  const int N_half = N / 2;
+  const int nr_k2 = 3 * N_half * N_half + 1;
+
+  double* slice = (double*)malloc(t->size_k * sizeof(double));
+  if (slice == NULL) error("Failed to allocate the G_eff(k,a) look-up table");
+
+  /* Interpolate in a once for all the tabulated wavenumbers */
+  mg_table_2d_get_slice(t, a, slice);
+
+  const double norm = 1. / geff_func(a, e);
+  const double log_k_fund = log(2. * M_PI / box_size);
+  const int last = t->size_k - 1;
+
+  /* |k| increases with k2 so we only walk the table once. The mean density
+   * (k = 0) is removed anyway. */
+  int j = 0;
+  for (int k2 = 1; k2 < nr_k2; ++k2) {
+    const double log_k = log_k_fund + 0.5 * log((double)k2);
+
+    double val;
+    if (log_k <= t->log_k[0]) {
+      val = slice[0];
+    } else if (log_k >= t->log_k[last]) {
+      val = slice[last];
+    } else {
+      while (t->log_k[j + 1] < log_k) j++;
+      const double w =
+          (log_k - t->log_k[j]) / (t->log_k[j + 1] - t->log_k[j]);
+      val = (1. - w) * slice[j] + w * slice[j + 1];
+    }
+    k2_fac[k2] *= val * norm;
+  }
+
+  free(slice);
+}
+
+/**
+ * @brief Tabulate the isotropic factors to apply to the mesh modes this
+ * step as a function of their integer |k|^2.
+ *
+ * Combines the (cached) long-range Green function with the time-dependent
+ * corrections that only depend on |k|: the G_eff(k,a) enhancement and the
+ * linear neutrino response. Everything is then applied to the mesh in a
+ * single pass.
+ *
+ * @param mesh The #pm_mesh (with its Green function tables built).
+ * @param s The #space.
+ * @param include_green Do we include the Green function in the factors?
+ * @return The newly allocated table of 3*(N/2)^2+1 factors (to be freed by
+ * the caller) or NULL if there is nothing to apply.
+ */
+static double* mesh_k2_factors_init(const struct pm_mesh* mesh,
+                                    const struct space* s,
+                                    const int include_green) {
+
+  const struct engine* e = s->e;
+  const int use_geff_k = e->geff_k_table.size_a > 0;
+  const int use_nu_response = e->neutrino_properties->use_linear_response;
+  if (!include_green && !use_geff_k && !use_nu_response) return NULL;
+
+  const int N = mesh->N;
+  const int N_half = N / 2;
+  const int nr_k2 = 3 * N_half * N_half + 1;
+
+  double* k2_fac = (double*)malloc(nr_k2 * sizeof(double));
+  if (k2_fac == NULL) error("Failed to allocate the mesh |k|^2 factors");
+
+  if (include_green)
+    memcpy(k2_fac, mesh->green_k2, nr_k2 * sizeof(double));
+  else
+    for (int k2 = 0; k2 < nr_k2; ++k2) k2_fac[k2] = 1.;
+
+  /* Scale-dependent modified-gravity enhancement */
+  if (use_geff_k) mesh_geff_k_multiply(e, N, mesh->dim[0], k2_fac);
+
+  /* Linear response of the neutrinos */
+  if (use_nu_response)
+    neutrino_response_multiply_k2_table(s, mesh, nr_k2, k2_fac);
+
+  return k2_fac;
+}
+
+/**
+ * @brief Shared information about the Green function cache to be used by
+ * all the threads in the pool.
+ */
+struct Green_function_cache_data {
 
   int N;
-  fftw_complex* frho;
-  double green_fac;
-  double a_smooth2;
-  double k_fac;
+  float* cache;
+  const double* window_deconv;
+  const double* green_k2;
   int slice_offset;
-  int slice_width;
 };
 
 /**
- * @brief Mapper function for the application of the Green function.
+ * @brief Mapper function filling the single-precision cache of the Green
+ * function.
  *
- * @param map_data The array of the density field Fourier transform.
+ * @param map_data The cache of the local slice.
  * @param num The number of elements to iterate on (along the x-axis).
- * @param extra The properties of the Green function.
+ * @param extra The tables of the Green function.
  */
-void mesh_apply_Green_function_mapper(void* map_data, const int num,
+void mesh_Green_function_cache_mapper(void* map_data, const int num,
                                       void* extra) {
 
-  struct Green_function_data* data = (struct Green_function_data*)extra;
+  const struct Green_function_cache_data* data =
+      (const struct Green_function_cache_data*)extra;
 
-  /* Unpack the array */
-  fftw_complex* const frho = data->frho;
   const int N = data->N;
   const int N_half = N / 2;
-
-  /* Unpack the Green function properties */
-  const double green_fac = data->green_fac;
-  const double a_smooth2 = data->a_smooth2;
-  const double k_fac = data->k_fac;
+  const double* const window_deconv = data->window_deconv;
+  const double* const green_k2 = data->green_k2;
 
   /* Find what slice of the full mesh is stored on this MPI rank */
   const int slice_offset = data->slice_offset;
 
   /* Range of x coordinates in the full mesh handled by this call */
-  const int i_start = ((fftw_complex*)map_data - frho) + slice_offset;
+  const int plane_size = N * (N_half + 1);
+  const int i_start = ((float*)map_data - data->cache) / plane_size;
   const int i_end = i_start + num;
 
-  /* Loop over the x range corresponding to this thread */
   for (int i = i_start; i < i_end; ++i) {
-
-    /* kx component of vector in Fourier space and 1/sinc(kx) */
-    const int kx = (i > N_half ? i - N : i);
-    const double kx_d = (double)kx;
-    const double fx = k_fac * kx_d;
-    const double sinc_kx_inv = (kx != 0) ? fx / sin(fx) : 1.;
+    const int kx = (i + slice_offset > N_half ? i + slice_offset - N
+                                              : i + slice_offset);
 
     for (int j = 0; j < N; ++j) {
-
-      /* ky component of vector in Fourier space and 1/sinc(ky) */
       const int ky = (j > N_half ? j - N : j);
-      const double ky_d = (double)ky;
-      const double fy = k_fac * ky_d;
-      const double sinc_ky_inv = (ky != 0) ? fy / sin(fy) : 1.;
-
-      for (int k = 0; k < N_half + 1; ++k) {
-
-        /* kz component of vector in Fourier space and 1/sinc(kz) */
-        const int kz = (k > N_half ? k - N : k);
-        const double kz_d = (double)kz;
-        const double fz = k_fac * kz_d;
-        const double sinc_kz_inv = (kz != 0) ? fz / (sin(fz) + FLT_MIN) : 1.;
-
-        /* Norm of vector in Fourier space */
-        const double k2 = (kx_d * kx_d + ky_d * ky_d + kz_d * kz_d);
-
-        /* Avoid FPEs... */
-        if (k2 == 0.) continue;
-
-        /* Green function */
-        double W = 1.;
-        fourier_kernel_long_grav_eval(k2 * a_smooth2, &W);
-        const double green_cor = green_fac * W / (k2 + FLT_MIN);
-
-        /* Deconvolution of CIC */
-        const double CIC_cor = sinc_kx_inv * sinc_ky_inv * sinc_kz_inv;
-        const double CIC_cor2 = CIC_cor * CIC_cor;
-        const double CIC_cor4 = CIC_cor2 * CIC_cor2;
-
-        /* Combined correction */
-        const double total_cor = green_cor * CIC_cor4;
-
-        /* Apply to the mesh */
-        const int index =
-            N * (N_half + 1) * (i - slice_offset) + (N_half + 1) * j + k;
-        frho[index][0] *= total_cor;
-        frho[index][1] *= total_cor;
-      }
+      const int kxy2 = kx * kx + ky * ky;
+      const double window_xy =
+          window_deconv[i + slice_offset] * window_deconv[j];
+
+      float* row = data->cache + (size_t)plane_size * i + (N_half + 1) * j;
+      for (int k = 0; k < N_half + 1; ++k)
+        row[k] =
+            (float)(window_xy * window_deconv[k] * green_k2[kxy2 + k * k]);
     }
   }
 }
 
 /**
- * @brief Apply the Green function in Fourier space to the density
- * array to get the potential.
+ * @brief Build the time-independent parts of the Green function.
  *
- * Also deconvolves the CIC kernel.
+ * The long-range kernel only depends on the integer |k|^2 of the modes and
+ * the window deconvolution is separable, so both are tabulated in 1D arrays.
+ * These only depend on N and r_s and are built the first time they are
+ * needed. If requested, the full k-space multiplier of the local slice is
+ * additionally stored in single precision.
  *
+ * @param mesh The #pm_mesh.
  * @param tp The threadpool.
- * @param frho The NxNx(N/2) complex array of the Fourier transform of the
- * density field.
  * @param slice_offset The x coordinate of the start of the slice on this MPI
  * rank
  * @param slice_width The width of the local slice on this MPI rank
- * @param N The dimension of the array.
- * @param r_s The Green function smoothing scale.
- * @param box_size The physical size of the simulation box.
+ * @param verbose Are we talkative?
  */
-void mesh_apply_Green_function(struct threadpool* tp, fftw_complex* frho,
-                               const int slice_offset, const int slice_width,
-                               const int N, const double r_s,
-                               const double box_size) {
+static void mesh_Green_function_init(struct pm_mesh* mesh,
+                                     struct threadpool* tp,
+                                     const int slice_offset,
+                                     const int slice_width,
+                                     const int verbose) {
 
-  /* Some common factors */
-  struct Green_function_data data;
-  data.frho = frho;
-  data.N = N;
-  data.green_fac = -1. / (M_PI * box_size);
-  data.a_smooth2 = 4. * M_PI * M_PI * r_s * r_s / (box_size * box_size);
-  data.k_fac = M_PI / (double)N;
-  data.slice_offset = slice_offset;
-  data.slice_width = slice_width;
+  const int N = mesh->N;
+  const int N_half = N / 2;
+  const int nr_k2 = 3 * N_half * N_half + 1;
+
+  if (mesh->green_k2 == NULL) {
+
+    const double box_size = mesh->dim[0];
+    const double green_fac = -1. / (M_PI * box_size);
+    const double a_smooth2 =
+        4. * M_PI * M_PI * mesh->r_s * mesh->r_s / (box_size * box_size);
+    const double k_fac = M_PI / (double)N;
+
+    mesh->window_deconv = (double*)malloc(N * sizeof(double));
+    mesh->green_k2 = (double*)malloc(nr_k2 * sizeof(double));
+    if (mesh->window_deconv == NULL || mesh->green_k2 == NULL)
+      error("Failed to allocate the Green function tables");
+
+    /* Deconvolution of the assignment and interpolation windows:
+     * 1/sinc(k)^(2p) along each axis for a window of order p */
+    for (int i = 0; i < N; ++i) {
+      const int kx = (i > N_half ? i - N : i);
+      const double fx = k_fac * (double)kx;
+      const double sinc_inv = (kx != 0) ? fx / sin(fx) : 1.;
+      mesh->window_deconv[i] = integer_pow(sinc_inv, 2 * mesh->window_order);
+    }
 
-  /* Parallelize the Green function application using the threadpool
+    /* Green function (the mean density is removed) */
+    mesh->green_k2[0] = 0.;
+    for (int k2 = 1; k2 < nr_k2; ++k2) {
+      double W = 1.;
+      fourier_kernel_long_grav_eval(k2 * a_smooth2, &W);
+      mesh->green_k2[k2] = green_fac * W / (double)k2;
+    }
+  }
+
+  if (!mesh->use_green_cache) return;
+  if (mesh->green_cache != NULL && mesh->green_cache_offset == slice_offset &&
+      mesh->green_cache_width == slice_width)
+    return;
+
+  const ticks tic = getticks();
+
+  if (mesh->green_cache != NULL) swift_free("green_cache", mesh->green_cache);
+
+  const size_t size = (size_t)slice_width * N * (N_half + 1);
+  mesh->green_cache = (float*)swift_malloc("green_cache", size * sizeof(float));
+  if (mesh->green_cache == NULL && size > 0)
+    error("Failed to allocate the Green function cache");
+  mesh->green_cache_offset = slice_offset;
+  mesh->green_cache_width = slice_width;
+
+  struct Green_function_cache_data data;
+  data.N = N;
+  data.cache = mesh->green_cache;
+  data.window_deconv = mesh->window_deconv;
+  data.green_k2 = mesh->green_k2;
+  data.slice_offset = slice_offset;
+
+  if (size > 0)
+    threadpool_map(tp, mesh_Green_function_cache_mapper, mesh->green_cache,
+                   slice_width, N * (N_half + 1) * sizeof(float),
+                   threadpool_auto_chunk_size, &data);
+
+  if (verbose)
+    message("Building the Green function cache (%.1f MB) took %.3f %s.",
+            size * sizeof(float) / (1024. * 1024.),
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
+}
+
+/**
+ * @brief Shared information about the Green function to be used by all the
+ * threads in the pool.
+ */
+struct Green_function_data {
+
+  int N;
+  fftw_complex* frho;
+#ifdef HAVE_FFTWF
+  fftwf_complex* frho_single;
+#endif
+  const double* window_deconv;
+  const double* k2_fac;
+  const float* cache;
+  int slice_offset;
+  int slice_width;
+};
+
+/**
+ * @brief Mapper function for the application of the Green function.
+ *
+ * The multipliers of a row of modes along kz are computed first and then
+ * applied to the transform, which is either in double (frho) or in single
+ * precision (frho_single).
+ *
+ * @param map_data The array of the density field Fourier transform.
+ * @param num The number of elements to iterate on (along the x-axis).
+ * @param extra The properties of the Green function.
+ */
+void mesh_apply_Green_function_mapper(void* map_data, const int num,
+                                      void* extra) {
+
+  struct Green_function_data* data = (struct Green_function_data*)extra;
+
+  /* Unpack the array */
+  fftw_complex* const frho = data->frho;
+  const int N = data->N;
+  const int N_half = N / 2;
+
+  /* Unpack the Green function properties */
+  const double* const window_deconv = data->window_deconv;
+  const double* const k2_fac = data->k2_fac;
+  const float* const cache = data->cache;
+
+  /* Find what slice of the full mesh is stored on this MPI rank */
+  const int slice_offset = data->slice_offset;
+
+  /* Range of x coordinates in the full mesh handled by this call */
+#ifdef HAVE_FFTWF
+  fftwf_complex* const frho_single = data->frho_single;
+  const int i_start =
+      (frho != NULL ? (fftw_complex*)map_data - frho
+                    : (fftwf_complex*)map_data - frho_single) +
+      slice_offset;
+#else
+  const int i_start = ((fftw_complex*)map_data - frho) + slice_offset;
+#endif
+  const int i_end = i_start + num;
+
+  /* Multipliers of a row of modes */
+  double* const cor = (double*)malloc((N_half + 1) * sizeof(double));
+  if (cor == NULL) error("Failed to allocate a row of the Green function");
+
+  /* Loop over the x range corresponding to this thread */
+  for (int i = i_start; i < i_end; ++i) {
+
+    /* kx component of vector in Fourier space */
+    const int kx = (i > N_half ? i - N : i);
+
+    for (int j = 0; j < N; ++j) {
+
+      /* ky component of vector in Fourier space */
+      const int ky = (j > N_half ? j - N : j);
+      const int kxy2 = kx * kx + ky * ky;
+
+      /* Row of modes along kz */
+      const size_t offset =
+          (size_t)N * (N_half + 1) * (i - slice_offset) + (N_half + 1) * j;
+
+      if (cache != NULL && k2_fac == NULL) {
+
+        /* Cached Green function and window deconvolution */
+        const float* const cache_row = cache + offset;
+        for (int k = 0; k < N_half + 1; ++k) cor[k] = cache_row[k];
+
+      } else if (cache != NULL) {
+
+        /* Cached Green function times the isotropic corrections */
+        const float* const cache_row = cache + offset;
+        for (int k = 0; k < N_half + 1; ++k)
+          cor[k] = cache_row[k] * k2_fac[kxy2 + k * k];
+
+      } else {
+
+        /* Deconvolution of the window times the Green function and isotropic
+         * corrections */
+        const double window_xy = window_deconv[i] * window_deconv[j];
+        for (int k = 0; k < N_half + 1; ++k)
+          cor[k] = window_xy * window_deconv[k] * k2_fac[kxy2 + k * k];
+      }
+
+#ifdef HAVE_FFTWF
+      if (frho == NULL) {
+        fftwf_complex* const row = frho_single + offset;
+        for (int k = 0; k < N_half + 1; ++k) {
+          row[k][0] *= cor[k];
+          row[k][1] *= cor[k];
+        }
+        continue;
+      }
+#endif
+
+      fftw_complex* const row = frho + offset;
+      for (int k = 0; k < N_half + 1; ++k) {
+        row[k][0] *= cor[k];
+        row[k][1] *= cor[k];
+      }
+    }
+  }
+
+  free(cor);
+}
+
+/**
+ * @brief Apply the Green function in Fourier space to the density
+ * array (in double or single precision) to get the potential.
+ *
+ * @param mesh The #pm_mesh.
+ * @param s The #space.
+ * @param tp The threadpool.
+ * @param frho The transform of the density in double precision (or NULL).
+ * @param frho_single The transform of the density in single precision (or
+ * NULL).
+ * @param slice_offset The x coordinate of the start of the slice on this MPI
+ * rank
+ * @param slice_width The width of the local slice on this MPI rank
+ * @param verbose Are we talkative?
+ */
+static void mesh_apply_Green_function_any(struct pm_mesh* mesh,
+                                          const struct space* s,
+                                          struct threadpool* tp,
+                                          fftw_complex* frho,
+                                          void* frho_single,
+                                          const int slice_offset,
+                                          const int slice_width,
+                                          const int verbose) {
+
+  /* Build the time-independent tables if needed */
+  mesh_Green_function_init(mesh, tp, slice_offset, slice_width, verbose);
+
+  /* Isotropic factors of this step (NULL if the cache covers everything) */
+  const int use_cache = mesh->green_cache != NULL;
+  double* k2_fac = mesh_k2_factors_init(mesh, s, /*include_green=*/!use_cache);
+
+  struct Green_function_data data;
+  data.frho = frho;
+#ifdef HAVE_FFTWF
+  data.frho_single = (fftwf_complex*)frho_single;
+#else
+  if (frho_single != NULL) error("No single-precision FFTW library found.");
+#endif
+  data.N = mesh->N;
+  data.window_deconv = mesh->window_deconv;
+  data.k2_fac = k2_fac;
+  data.cache = use_cache ? mesh->green_cache : NULL;
+  data.slice_offset = slice_offset;
+  data.slice_width = slice_width;
+
+  /* Parallelize the Green function application using the threadpool
      to split the x-axis loop over the threads.
      The array is N x N x (N/2). We use the thread to each deal with
      a range [i_min, i_max[ x N x (N/2) */
-  threadpool_map(tp, mesh_apply_Green_function_mapper, frho, slice_width,
-                 sizeof(fftw_complex), threadpool_auto_chunk_size, &data);
+  if (frho != NULL) {
+    threadpool_map(tp, mesh_apply_Green_function_mapper, frho, slice_width,
+                   sizeof(fftw_complex), threadpool_auto_chunk_size, &data);
+  } else {
+    threadpool_map(tp, mesh_apply_Green_function_mapper, frho_single,
+                   slice_width, 2 * sizeof(float), threadpool_auto_chunk_size,
+                   &data);
+  }
+
+  free(k2_fac);
 
   /* Correct singularity at (0,0,0) */
   if (slice_offset == 0 && slice_width > 0) {
-    frho[0][0] = 0.;
-    frho[0][1] = 0.;
+    if (frho != NULL) {
+      frho[0][0] = 0.;
+      frho[0][1] = 0.;
+    } else {
+      ((float*)frho_single)[0] = 0.f;
+      ((float*)frho_single)[1] = 0.f;
+    }
+  }
+}
+
+/**
+ * @brief Apply the Green function in Fourier space to the density
+ * array to get the potential.
+ *
+ * Also deconvolves the mass assignment window and applies the corrections
+ * depending only on |k| (the G_eff(k,a) enhancement and the linear neutrino
+ * response).
+ *
+ * @param mesh The #pm_mesh.
+ * @param s The #space.
+ * @param tp The threadpool.
+ * @param frho The NxNx(N/2) complex array of the Fourier transform of the
+ * density field.
+ * @param slice_offset The x coordinate of the start of the slice on this MPI
+ * rank
+ * @param slice_width The width of the local slice on this MPI rank
+ * @param verbose Are we talkative?
+ */
+void mesh_apply_Green_function(struct pm_mesh* mesh, const struct space* s,
+                               struct threadpool* tp, fftw_complex* frho,
+                               const int slice_offset, const int slice_width,
+                               const int verbose) {
+
+  mesh_apply_Green_function_any(mesh, s, tp, frho, /*frho_single=*/NULL,
+                                slice_offset, slice_width, verbose);
+}
+
+/**
+ * @brief Shared information about the interlaced meshes to be used by all
+ * the threads in the pool.
+ */
+struct interlacing_data {
+
+  int N;
+  fftw_complex* frho;
+  fftw_complex* frho2;
+
+  /*! Combine the two density meshes (1) or produce the potential of the
+   * shifted mesh (0)? */
+  int combine;
+};
+
+/**
+ * @brief Mapper function going between the frames of the two interlaced
+ * meshes in Fourier space.
+ *
+ * When combining, frho becomes the average of frho and of frho2 brought back
+ * to the frame of the first mesh. Otherwise, frho2 becomes frho moved to the
+ * frame of the shifted mesh.
+ *
+ * @param map_data The array of the Fourier transform of the first mesh.
+ * @param num The number of elements to iterate on (along the x-axis).
+ * @param extra The #interlacing_data.
+ */
+void mesh_interlacing_mapper(void* map_data, const int num, void* extra) {
+
+  const struct interlacing_data* data = (const struct interlacing_data*)extra;
+  fftw_complex* const frho = data->frho;
+  fftw_complex* const frho2 = data->frho2;
+  const int N = data->N;
+  const int N_half = N / 2;
+
+  const int i_start = (fftw_complex*)map_data - frho;
+  const int i_end = i_start + num;
+
+  for (int i = i_start; i < i_end; ++i) {
+    const int kx = (i > N_half ? i - N : i);
+
+    for (int j = 0; j < N; ++j) {
+      const int ky = (j > N_half ? j - N : j);
+
+      const size_t offset = (size_t)N * (N_half + 1) * i + (N_half + 1) * j;
+      for (int k = 0; k < N_half + 1; ++k) {
+
+        const double phase = mesh_window_interlacing_phase(kx, ky, k, N);
+        const double c = cos(phase);
+        const double s = sin(phase);
+        double* const a = frho[offset + k];
+        double* const b = frho2[offset + k];
+
+        if (data->combine) {
+          a[0] = 0.5 * (a[0] + c * b[0] - s * b[1]);
+          a[1] = 0.5 * (a[1] + s * b[0] + c * b[1]);
+        } else {
+          b[0] = c * a[0] + s * a[1];
+          b[1] = c * a[1] - s * a[0];
+        }
+      }
+    }
   }
 }
 
+/**
+ * @brief Go between the frames of the two interlaced meshes in Fourier space.
+ *
+ * @param tp The threadpool.
+ * @param N The side-length of the meshes.
+ * @param frho The Fourier transform of the first mesh.
+ * @param frho2 The Fourier transform of the mesh shifted by half a cell.
+ * @param combine Average the two density meshes into frho (1) or write the
+ * potential of the shifted mesh into frho2 (0).
+ */
+static void mesh_interlacing(struct threadpool* tp, const int N,
+                             fftw_complex* frho, fftw_complex* frho2,
+                             const int combine) {
+
+  struct interlacing_data data;
+  data.N = N;
+  data.frho = frho;
+  data.frho2 = frho2;
+  data.combine = combine;
+
+  threadpool_map(tp, mesh_interlacing_mapper, frho, N, sizeof(fftw_complex),
+                 threadpool_auto_chunk_size, &data);
+}
+
 #endif
 
 /**
@@ -707,7 +1655,7 @@ void compute_potential_distributed(struct pm_mesh* mesh, const struct space* s,
     message("local patch size = %d, local mesh cells = %lld", nr_local_cells,
             (long long)(local_n0 * N * N));
   if (verbose)
-    message("Planning the FFT took %.3f %s.",
+    message("Finding the local slice took %.3f %s.",
             clocks_from_ticks(getticks() - tic), clocks_getunit());
 
   /* Allocate storage for mesh slices.
@@ -728,6 +1676,17 @@ void compute_potential_distributed(struct pm_mesh* mesh, const struct space* s,
     message("Assembling mesh slices took %.3f %s.",
             clocks_from_ticks(getticks() - tic), clocks_getunit());
 
+  /* Solve for the f(R) field on the slices before the FFT destroys them */
+  const int stride_z = 2 * (N / 2 + 1);
+  if (mesh->multigrid.active) {
+    if (mesh->multigrid.nr_levels == 0)
+      pm_multigrid_allocate(&mesh->multigrid, N, (int)local_0_start,
+                            (int)local_n0, box_size, /*use_mpi=*/1);
+    pm_multigrid_solve_fR(&mesh->multigrid, rho_slice, stride_z,
+                          s->e->cosmology, s->e->physical_constants, tp,
+                          verbose);
+  }
+
   tic = getticks();
 
   /* Allocate storage for the slices of the FFT of the density mesh */
@@ -746,49 +1705,36 @@ void compute_potential_distributed(struct pm_mesh* mesh, const struct space* s,
    * the output. Each MPI rank has slice of thickness local_n0
    * starting at local_0_start in the first dimension.
    */
-  fftw_plan mpi_plan = fftw_mpi_plan_dft_r2c_3d(
-      N, N, N, rho_slice, frho_slice, MPI_COMM_WORLD,
-      FFTW_ESTIMATE | FFTW_MPI_TRANSPOSED_OUT | FFTW_DESTROY_INPUT);
-  fftw_execute(mpi_plan);
-  fftw_destroy_plan(mpi_plan);
+  fftw_mpi_execute_dft_r2c(mesh->forward_plan, rho_slice, frho_slice);
   if (verbose)
     message("MPI Forward Fourier transform took %.3f %s.",
             clocks_from_ticks(getticks() - tic), clocks_getunit());
 
   tic = getticks();
 
-  /* Apply Green function to local slice of the MPI mesh */
-  mesh_apply_Green_function(tp, frho_slice, local_0_start, local_n0, N, r_s,
-                            box_size);
+  /* Apply Green function (and the neutrino response) to local slice of the
+   * MPI mesh */
+  mesh_apply_Green_function(mesh, s, tp, frho_slice, local_0_start, local_n0,
+                            verbose);
   if (verbose)
     message("Applying Green function took %.3f %s.",
             clocks_from_ticks(getticks() - tic), clocks_getunit());
 
   tic = getticks();
 
-  /* If using linear response neutrinos, apply to local slice of the MPI mesh */
-  if (s->e->neutrino_properties->use_linear_response) {
-    neutrino_response_compute(s, mesh, tp, frho_slice, local_0_start, local_n0,
-                              verbose);
-
-    if (verbose)
-      message("Applying neutrino response took %.3f %s.",
-              clocks_from_ticks(getticks() - tic), clocks_getunit());
-
-    tic = getticks();
-  }
-
   /* Carry out the reverse MPI Fourier transform */
-  fftw_plan mpi_inverse_plan = fftw_mpi_plan_dft_c2r_3d(
-      N, N, N, frho_slice, rho_slice, MPI_COMM_WORLD,
-      FFTW_ESTIMATE | FFTW_MPI_TRANSPOSED_IN | FFTW_DESTROY_INPUT);
-  fftw_execute(mpi_inverse_plan);
-  fftw_destroy_plan(mpi_inverse_plan);
+  fftw_mpi_execute_dft_c2r(mesh->inverse_plan, frho_slice, rho_slice);
 
   if (verbose)
     message("MPI Reverse Fourier transform took %.3f %s.",
             clocks_from_ticks(getticks() - tic), clocks_getunit());
 
+  /* Add the f(R) fifth force to the potential */
+  if (mesh->multigrid.active)
+    pm_multigrid_add_fifth_force_potential(&mesh->multigrid, rho_slice,
+                                           stride_z, s->e->cosmology,
+                                           s->e->physical_constants);
+
   /* We can now free the Fourier-space data */
   fftw_free(frho_slice);
 
@@ -824,27 +1770,728 @@ void compute_potential_distributed(struct pm_mesh* mesh, const struct space* s,
 #endif
 }
 
+#ifdef HAVE_FFTW
+
+/**
+ * @brief Turns the full N*N*N density mesh(es) into the potential.
+ *
+ * Solves for the f(R) field if needed, Fourier transforms the density,
+ * applies the Green function and transforms back, before adding the f(R)
+ * fifth force. The density meshes are overwritten by the potential.
+ *
+ * @param mesh The #pm_mesh.
+ * @param s The #space containing the particles.
+ * @param tp The #threadpool object used for parallelisation.
+ * @param rho (in/out) The density mesh, then the potential.
+ * @param rho2 (in/out) The shifted density mesh, then the shifted potential
+ * (NULL if not interlacing).
+ * @param frho Work array for the transform of rho.
+ * @param frho2 Work array for the transform of rho2 (NULL if not
+ * interlacing).
+ * @param verbose Are we talkative?
+ */
+static void mesh_global_density_to_potential(
+    struct pm_mesh* mesh, const struct space* s, struct threadpool* tp,
+    double* restrict rho, double* restrict rho2, fftw_complex* restrict frho,
+    fftw_complex* restrict frho2, const int verbose) {
+
+  const int N = mesh->N;
+  const double box_size = s->dim[0];
+
+  /* Solve for the f(R) field before the FFT destroys the density */
+  if (mesh->multigrid.active) {
+    if (mesh->multigrid.nr_levels == 0)
+      pm_multigrid_allocate(&mesh->multigrid, N, /*slab_start=*/0,
+                            /*slab_width=*/N, box_size, /*use_mpi=*/0);
+    pm_multigrid_solve_fR(&mesh->multigrid, rho, /*stride_z=*/N,
+                          s->e->cosmology, s->e->physical_constants, tp,
+                          verbose);
+  }
+
+  ticks tic = getticks();
+
+  /* Fourier transform to go to magic-land */
+  fftw_execute_dft_r2c(mesh->forward_plan, rho, frho);
+  if (mesh->interlacing) {
+    fftw_execute_dft_r2c(mesh->forward_plan, rho2, frho2);
+    mesh_interlacing(tp, N, frho, frho2, /*combine=*/1);
+  }
+
+  if (verbose)
+    message("Forward Fourier transform took %.3f %s.",
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
+
+  /* frho now contains the Fourier transform of the density field */
+  /* frho contains NxNx(N/2+1) complex numbers */
+
+  tic = getticks();
+
+  /* Now de-convolve the assignment window and apply the Green function (and
+   * the neutrino response) */
+  mesh_apply_Green_function(mesh, s, tp, frho, /*slice_offset=*/0,
+                            /*slice_width=*/N, verbose);
+
+  if (verbose)
+    message("Applying Green function took %.3f %s.",
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
+
+  tic = getticks();
+
+  /* Fourier transform to come back from magic-land (the c2r transform
+   * destroys its input so the shifted potential is extracted first) */
+  if (mesh->interlacing) {
+    mesh_interlacing(tp, N, frho, frho2, /*combine=*/0);
+    fftw_execute_dft_c2r(mesh->inverse_plan, frho2, rho2);
+  }
+  fftw_execute_dft_c2r(mesh->inverse_plan, frho, rho);
+
+  if (verbose)
+    message("Reverse Fourier transform took %.3f %s.",
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
+
+  /* rho now contains the potential */
+  /* This array is now again NxNxN real numbers */
+
+  /* Add the f(R) fifth force to the potential */
+  if (mesh->multigrid.active)
+    pm_multigrid_add_fifth_force_potential(&mesh->multigrid, rho,
+                                           /*stride_z=*/N, s->e->cosmology,
+                                           s->e->physical_constants);
+}
+
+#endif
+
+/**
+ * @brief Compute the mesh forces and potential, including periodic correction.
+ *
+ * Interpolates the top-level multipoles on-to a mesh, move to Fourier space,
+ * compute the potential including short-range correction and move back
+ * to real space. We use a CIC, TSC or PCS window for the assignment and
+ * interpolation, optionally with a second interlaced mesh.
+ *
+ * This version stores the full N*N*N mesh on each MPI rank and uses the
+ * non-MPI version of FFTW.
+ *
+ * The particles mesh accelerations and potentials are also updated.
+ *
+ * @param mesh The #pm_mesh used to store the potential.
+ * @param s The #space containing the particles.
+ * @param tp The #threadpool object used for parallelisation.
+ * @param verbose Are we talkative?
+ */
+void compute_potential_global(struct pm_mesh* mesh, const struct space* s,
+                              struct threadpool* tp, const int verbose) {
+
+#ifdef HAVE_FFTW
+
+  const double r_s = mesh->r_s;
+  const double box_size = s->dim[0];
+  const double dim[3] = {s->dim[0], s->dim[1], s->dim[2]};
+  const int* local_cells = s->local_cells_top;
+  const int nr_local_cells = s->nr_local_cells;
+
+  if (r_s <= 0.) error("Invalid value of a_smooth");
+  if (mesh->dim[0] != dim[0] || mesh->dim[1] != dim[1] ||
+      mesh->dim[2] != dim[2])
+    error("Domain size does not match the value stored in the space.");
+
+  /* Some useful constants */
+  const int N = mesh->N;
+  const int N_half = N / 2;
+  const double cell_fac = N / box_size;
+
+  /* Use the memory allocated for the potential to temporarily store rho */
+  double* restrict rho = mesh->potential_global;
+  if (rho == NULL) error("Error allocating memory for density mesh");
+
+  /* Allocates some memory for the mesh in Fourier space */
+  fftw_complex* restrict frho =
+      (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * N * N * (N_half + 1));
+  if (frho == NULL)
+    error("Error allocating memory for transform of density mesh");
+  memuse_log_allocation("fftw_frho", frho, 1,
+                        sizeof(fftw_complex) * N * N * (N_half + 1));
+
+  /* Second mesh shifted by half a cell when interlacing */
+  double* restrict rho2 = NULL;
+  fftw_complex* restrict frho2 = NULL;
+  if (mesh->interlacing) {
+    rho2 = (double*)fftw_malloc(sizeof(double) * N * N * N);
+    frho2 = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * N * N *
+                                       (N_half + 1));
+    if (rho2 == NULL || frho2 == NULL)
+      error("Error allocating memory for the interlaced mesh");
+    memuse_log_allocation("fftw_rho2", rho2, 1, sizeof(double) * N * N * N);
+    memuse_log_allocation("fftw_frho2", frho2, 1,
+                          sizeof(fftw_complex) * N * N * (N_half + 1));
+  }
+
+  ticks tic = getticks();
+
+  /* Zero everything */
+  bzero(rho, N * N * N * sizeof(double));
+  if (mesh->interlacing) bzero(rho2, N * N * N * sizeof(double));
+
+  /* Gather some neutrino constants if using delta-f weighting on the mesh */
+  struct neutrino_model nu_model;
+  bzero(&nu_model, sizeof(struct neutrino_model));
+  if (s->e->neutrino_properties->use_delta_f_mesh_only)
+    gather_neutrino_consts(s, &nu_model);
+
+  /* Gather the mesh shared information to be used by the threads */
+  struct cic_mapper_data data;
+  data.cells = s->cells_top;
+  data.rho = rho;
+  data.potential = NULL;
+  data.potential2 = NULL;
+  data.rho_single = NULL;
+  data.potential_single = NULL;
+  data.N = N;
+  data.window_order = mesh->window_order;
+  data.shift = 0.;
+  data.assignment = mesh->assignment;
+  data.local_cells = local_cells;
+  data.patches = NULL;
+  data.fac = cell_fac;
+  data.dim[0] = dim[0];
+  data.dim[1] = dim[1];
+  data.dim[2] = dim[2];
+  data.const_G = 0.f;
+  data.nu_model = &nu_model;
+
+  if (nr_local_cells == 0) {
+
+    /* We don't have a cell infrastructure in place so we need to
+     * directly loop over the particles */
+    threadpool_map(tp, gpart_to_mesh_mapper, s->gparts, s->nr_gparts,
+                   sizeof(struct gpart), threadpool_auto_chunk_size,
+                   (void*)&data);
+    if (mesh->interlacing) {
+      data.rho = rho2;
+      data.shift = 0.5;
+      threadpool_map(tp, gpart_to_mesh_mapper, s->gparts, s->nr_gparts,
+                     sizeof(struct gpart), threadpool_auto_chunk_size,
+                     (void*)&data);
+    }
+
+  } else { /* Normal case */
+
+    /* Do a parallel mesh assignment of the gparts but only using
+     * the local top-level cells */
+    cells_gpart_to_mesh(tp, rho, N, cell_fac, dim, s->cells_top, local_cells,
+                        nr_local_cells,
+                        (enum mesh_assignment_mode)mesh->assignment,
+                        mesh->window_order, /*shift=*/0., &nu_model);
+    if (mesh->interlacing)
+      cells_gpart_to_mesh(tp, rho2, N, cell_fac, dim, s->cells_top,
+                          local_cells, nr_local_cells,
+                          (enum mesh_assignment_mode)mesh->assignment,
+                          mesh->window_order, /*shift=*/0.5, &nu_model);
+  }
+
+  if (verbose)
+    message("Gpart assignment took %.3f %s.",
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
+
+#ifdef WITH_MPI
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  tic = getticks();
+
+  /* Merge everybody's share of the density mesh */
+  MPI_Allreduce(MPI_IN_PLACE, rho, N * N * N, MPI_DOUBLE, MPI_SUM,
+                MPI_COMM_WORLD);
+  if (mesh->interlacing)
+    MPI_Allreduce(MPI_IN_PLACE, rho2, N * N * N, MPI_DOUBLE, MPI_SUM,
+                  MPI_COMM_WORLD);
+
+  if (verbose)
+    message("Mesh MPI-reduction took %.3f %s.",
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
+#endif
+
+  // message("\n\n\n DENSITY");
+  // print_array(rho, N);
+
+  /* Go to Fourier space and back to get the potential */
+  mesh_global_density_to_potential(mesh, s, tp, rho, rho2, frho, frho2,
+                                   verbose);
+
+  /* Let's store it in the structure */
+  mesh->potential_global = rho;
+
+  /* message("\n\n\n POTENTIAL"); */
+  /* print_array(mesh->potential_global, N); */
+
+  tic = getticks();
+
+  /* Gather the mesh shared information to be used by the threads */
+  data.cells = s->cells_top;
+  data.rho = NULL;
+  data.potential = mesh->potential_global;
+  data.potential2 = rho2;
+  data.N = N;
+  data.fac = cell_fac;
+  data.dim[0] = dim[0];
+  data.dim[1] = dim[1];
+  data.dim[2] = dim[2];
+  data.const_G = s->e->physical_constants->const_newton_G;
+
+  if (nr_local_cells == 0) {
+
+    /* We don't have a cell infrastructure in place so we need to
+     * directly loop over the particles */
+    threadpool_map(tp, mesh_to_gpart_mapper, s->gparts, s->nr_gparts,
+                   sizeof(struct gpart), threadpool_auto_chunk_size,
+                   (void*)&data);
+
+  } else { /* Normal case */
+
+    /* Do a parallel mesh interpolation onto the gparts but only using
+       the local top-level cells */
+    threadpool_map(tp, cell_mesh_to_gpart_mapper, (void*)local_cells,
+                   nr_local_cells, sizeof(int), threadpool_auto_chunk_size,
+                   (void*)&data);
+  }
+
+  if (verbose)
+    message("Computing mesh accelerations took %.3f %s.",
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
+
+  /* Clean-up the mess */
+  memuse_log_allocation("fftw_frho", frho, 0, 0);
+  fftw_free(frho);
+  if (mesh->interlacing) {
+    memuse_log_allocation("fftw_rho2", rho2, 0, 0);
+    memuse_log_allocation("fftw_frho2", frho2, 0, 0);
+    fftw_free(rho2);
+    fftw_free(frho2);
+  }
+
+#else
+  error("No FFTW library found. Cannot compute periodic long-range forces.");
+#endif
+}
+
+#ifdef HAVE_FFTW
+
+/**
+ * @brief Range of planes of the mesh handled by a block of the mesh tasks.
+ *
+ * @param mesh The #pm_mesh.
+ * @param block The index of the block.
+ * @param start (return) The first plane of the block.
+ * @param end (return) The plane after the last one of the block.
+ */
+static void pm_mesh_tasks_block_range(const struct pm_mesh* mesh,
+                                      const int block, int* start, int* end) {
+
+  const int N = mesh->N;
+  const int nr_blocks = mesh->nr_task_blocks;
+
+  if (block < 0 || block >= nr_blocks) error("Invalid mesh block %d", block);
+
+  *start = (int)(((long long)block * N) / nr_blocks);
+  *end = (int)(((long long)(block + 1) * N) / nr_blocks);
+}
+
+#endif /* HAVE_FFTW */
+
+/**
+ * @brief Gets the global mesh ready to receive the mass of the particles from
+ * the mesh tasks.
+ *
+ * Called before launching the tasks of a step where the mesh forces are
+ * recomputed. The density mesh(es) are zeroed here and filled by the
+ * assignment task of each cell. Once they are complete (and summed over the
+ * ranks by the reduction tasks), the r2c tasks transform the (y, z) planes of
+ * blocks of x planes, the green tasks transform blocks of ky planes along x,
+ * apply the Green function and transform them back, and the c2r tasks bring
+ * blocks of kx planes back to real space. Each of these tasks runs on a
+ * single runner with plans made for one thread. The interpolation task of
+ * each cell finally reads the potential.
+ *
+ * The tables of the Green function that are not specific to a block are
+ * built here using the engine's threadpool.
+ *
+ * @param mesh The #pm_mesh.
+ * @param s The #space containing the particles.
+ * @param tp The #threadpool object used for parallelisation.
+ * @param verbose Are we talkative?
+ */
+void pm_mesh_tasks_prepare(struct pm_mesh* mesh, const struct space* s,
+                           struct threadpool* tp, const int verbose) {
+
+#ifdef HAVE_FFTW
+
+  const int N = mesh->N;
+  const size_t nr_complex = (size_t)N * N * (N / 2 + 1);
+
+  if (mesh->r_s <= 0.) error("Invalid value of a_smooth");
+  if (mesh->dim[0] != s->dim[0] || mesh->dim[1] != s->dim[1] ||
+      mesh->dim[2] != s->dim[2])
+    error("Domain size does not match the value stored in the space.");
+  if (mesh->potential_global == NULL)
+    error("Error allocating memory for density mesh");
+
+  const ticks tic = getticks();
+
+  bzero(mesh->potential_global, N * N * N * sizeof(double));
+
+  /* Transform of the density in the layout of the tasks */
+  mesh->frho_tasks =
+      (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * nr_complex);
+  if (mesh->frho_tasks == NULL)
+    error("Error allocating memory for transform of density mesh");
+  memuse_log_allocation("fftw_frho", mesh->frho_tasks, 1,
+                        sizeof(fftw_complex) * nr_complex);
+
+  /* Second mesh shifted by half a cell when interlacing */
+  if (mesh->interlacing) {
+    mesh->potential2_tasks = (double*)fftw_malloc(sizeof(double) * N * N * N);
+    mesh->frho2_tasks =
+        (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * nr_complex);
+    if (mesh->potential2_tasks == NULL || mesh->frho2_tasks == NULL)
+      error("Error allocating memory for the interlaced mesh");
+    memuse_log_allocation("fftw_rho2", mesh->potential2_tasks, 1,
+                          sizeof(double) * N * N * N);
+    memuse_log_allocation("fftw_frho2", mesh->frho2_tasks, 1,
+                          sizeof(fftw_complex) * nr_complex);
+    bzero(mesh->potential2_tasks, N * N * N * sizeof(double));
+  }
+
+  /* Green function of the whole mesh and its factors for this step */
+  mesh_Green_function_init(mesh, tp, /*slice_offset=*/0, /*slice_width=*/N,
+                           verbose);
+  mesh->k2_fac_tasks = mesh_k2_factors_init(
+      mesh, s, /*include_green=*/mesh->green_cache == NULL);
+
+  if (verbose)
+    message("Preparing the mesh tasks took %.3f %s.",
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
+
+#else
+  error("No FFTW library found. Cannot compute periodic long-range forces.");
+#endif
+}
+
+/**
+ * @brief Assigns the #gpart of a cell to the density mesh(es).
+ *
+ * This is the work of the mesh assignment task of a cell. Each cell is added
+ * to the global mesh atomically, either directly or via a local patch.
+ *
+ * @param mesh The #pm_mesh.
+ * @param s The #space containing the particles.
+ * @param c The #cell.
+ */
+void pm_mesh_tasks_cell_assign(const struct pm_mesh* mesh,
+                               const struct space* s, const struct cell* c) {
+
+#ifdef HAVE_FFTW
+
+  if (c->grav.count == 0) return;
+
+  const int N = mesh->N;
+  const double fac = mesh->cell_fac;
+  const int order = mesh->window_order;
+
+  /* Gather some neutrino constants if using delta-f weighting on the mesh */
+  struct neutrino_model nu_model;
+  bzero(&nu_model, sizeof(struct neutrino_model));
+  if (s->e->neutrino_properties->use_delta_f_mesh_only)
+    gather_neutrino_consts(s, &nu_model);
+
+  const int nr_meshes = mesh->interlacing ? 2 : 1;
+  for (int n = 0; n < nr_meshes; ++n) {
+
+    double* rho = (n == 0) ? mesh->potential_global : mesh->potential2_tasks;
+    const double shift = (n == 0) ? 0. : 0.5;
+
+    if (mesh->assignment == mesh_assignment_atomic) {
+
+      /* Assign this cell's content directly atomically to the mesh */
+      cell_gpart_to_mesh(c, rho, N, fac, mesh->dim, order, shift, &nu_model);
+
+    } else {
+
+      /* Assign all the particles in this cell onto a local patch and copy
+       * it back onto the global mesh */
+      struct pm_mesh_patch patch;
+      if (order == 2 && shift == 0.)
+        accumulate_cell_to_local_patch(N, fac, mesh->dim, c, &patch,
+                                       &nu_model);
+      else
+        accumulate_cell_to_local_patch_window(N, fac, mesh->dim, c, &patch,
+                                              order, shift, &nu_model);
+      pm_add_patch_to_global_mesh(rho, &patch);
+      pm_mesh_patch_clean(&patch);
+    }
+  }
+
+#else
+  error("No FFTW library found. Cannot compute periodic long-range forces.");
+#endif
+}
+
+#ifdef WITH_MPI
+/**
+ * @brief Starts summing one of the density meshes over all the ranks.
+ *
+ * Called when the reduction task of the mesh is enqueued, i.e. once all the
+ * local cells have been assigned. The task is then only run once the
+ * request has completed (see task_lock()), so the runners carry on with
+ * other tasks while the mesh is communicated.
+ *
+ * @param mesh The #pm_mesh.
+ * @param n The mesh to reduce (0: the mesh, 1: the interlaced one).
+ * @param req (return) The request of the non-blocking reduction.
+ */
+void pm_mesh_tasks_reduce_start(const struct pm_mesh* mesh, const int n,
+                                MPI_Request* req) {
+
+#ifdef HAVE_FFTW
+  const int N = mesh->N;
+  double* rho = (n == 0) ? mesh->potential_global : mesh->potential2_tasks;
+
+  const int err = MPI_Iallreduce(MPI_IN_PLACE, rho, N * N * N, MPI_DOUBLE,
+                                 MPI_SUM, mesh->reduce_comms[n], req);
+  if (err != MPI_SUCCESS) mpi_error(err, "Failed to start the mesh reduction.");
+#else
+  error("No FFTW library found. Cannot compute periodic long-range forces.");
+#endif
+}
+#endif
+
+/**
+ * @brief Transforms the (y, z) planes of a block of x planes of the density
+ * mesh(es).
+ *
+ * This is the work of an r2c task. The transforms are written in the
+ * transposed (ky, x, kz) layout so that the following green tasks each work
+ * on a contiguous block of ky planes.
+ *
+ * @param mesh The #pm_mesh.
+ * @param block The index of the block of x planes.
+ */
+void pm_mesh_tasks_r2c(const struct pm_mesh* mesh, const int block) {
+
+#ifdef HAVE_FFTW
+
+  const int N = mesh->N;
+  const int Nz = N / 2 + 1;
+
+  int start, end;
+  pm_mesh_tasks_block_range(mesh, block, &start, &end);
+
+  for (int i = start; i < end; ++i) {
+    fftw_execute_dft_r2c(mesh->forward_plan_tasks,
+                         mesh->potential_global + (size_t)i * N * N,
+                         mesh->frho_tasks + (size_t)i * Nz);
+    if (mesh->interlacing)
+      fftw_execute_dft_r2c(mesh->forward_plan_tasks,
+                           mesh->potential2_tasks + (size_t)i * N * N,
+                           mesh->frho2_tasks + (size_t)i * Nz);
+  }
+
+#else
+  error("No FFTW library found. Cannot compute periodic long-range forces.");
+#endif
+}
+
+/**
+ * @brief Turns a block of ky planes of the transformed density into the
+ * potential.
+ *
+ * This is the work of a green task. The planes are transformed along x,
+ * the interlaced meshes are combined, the Green function (and the neutrino
+ * response) is applied and the planes are transformed back along x. Both
+ * the Green function and the interlacing phases are symmetric in kx and ky,
+ * so the mappers written for x slabs are used on the ky planes.
+ *
+ * @param mesh The #pm_mesh.
+ * @param block The index of the block of ky planes.
+ */
+void pm_mesh_tasks_green(const struct pm_mesh* mesh, const int block) {
+
+#ifdef HAVE_FFTW
+
+  const int N = mesh->N;
+  const size_t plane_size = (size_t)N * (N / 2 + 1);
+  fftw_complex* const frho = mesh->frho_tasks;
+  fftw_complex* const frho2 = mesh->frho2_tasks;
+
+  int start, end;
+  pm_mesh_tasks_block_range(mesh, block, &start, &end);
+
+  /* Transform the planes along x */
+  for (int j = start; j < end; ++j) {
+    fftw_execute_dft(mesh->forward_plan_tasks_x, frho + j * plane_size,
+                     frho + j * plane_size);
+    if (mesh->interlacing)
+      fftw_execute_dft(mesh->forward_plan_tasks_x, frho2 + j * plane_size,
+                       frho2 + j * plane_size);
+  }
+
+  struct interlacing_data interlacing;
+  interlacing.N = N;
+  interlacing.frho = frho;
+  interlacing.frho2 = frho2;
+
+  /* Average the two meshes */
+  if (mesh->interlacing) {
+    interlacing.combine = 1;
+    mesh_interlacing_mapper(frho + start, end - start, &interlacing);
+  }
+
+  /* Apply the Green function */
+  struct Green_function_data data;
+  data.frho = frho;
+#ifdef HAVE_FFTWF
+  data.frho_single = NULL;
+#endif
+  data.N = N;
+  data.window_deconv = mesh->window_deconv;
+  data.k2_fac = mesh->k2_fac_tasks;
+  data.cache = mesh->green_cache;
+  data.slice_offset = 0;
+  data.slice_width = N;
+  mesh_apply_Green_function_mapper(frho + start, end - start, &data);
+
+  /* Correct singularity at (0,0,0) */
+  if (start == 0) {
+    frho[0][0] = 0.;
+    frho[0][1] = 0.;
+  }
+
+  /* Potential of the shifted mesh */
+  if (mesh->interlacing) {
+    interlacing.combine = 0;
+    mesh_interlacing_mapper(frho + start, end - start, &interlacing);
+  }
+
+  /* And back along x */
+  for (int j = start; j < end; ++j) {
+    fftw_execute_dft(mesh->inverse_plan_tasks_x, frho + j * plane_size,
+                     frho + j * plane_size);
+    if (mesh->interlacing)
+      fftw_execute_dft(mesh->inverse_plan_tasks_x, frho2 + j * plane_size,
+                       frho2 + j * plane_size);
+  }
+
+#else
+  error("No FFTW library found. Cannot compute periodic long-range forces.");
+#endif
+}
+
+/**
+ * @brief Transforms a block of x planes of the potential back to real space.
+ *
+ * This is the work of a c2r task. The potential overwrites the density
+ * mesh(es).
+ *
+ * @param mesh The #pm_mesh.
+ * @param block The index of the block of x planes.
+ */
+void pm_mesh_tasks_c2r(const struct pm_mesh* mesh, const int block) {
+
+#ifdef HAVE_FFTW
+
+  const int N = mesh->N;
+  const int Nz = N / 2 + 1;
+
+  int start, end;
+  pm_mesh_tasks_block_range(mesh, block, &start, &end);
+
+  for (int i = start; i < end; ++i) {
+    fftw_execute_dft_c2r(mesh->inverse_plan_tasks,
+                         mesh->frho_tasks + (size_t)i * Nz,
+                         mesh->potential_global + (size_t)i * N * N);
+    if (mesh->interlacing)
+      fftw_execute_dft_c2r(mesh->inverse_plan_tasks,
+                           mesh->frho2_tasks + (size_t)i * Nz,
+                           mesh->potential2_tasks + (size_t)i * N * N);
+  }
+
+#else
+  error("No FFTW library found. Cannot compute periodic long-range forces.");
+#endif
+}
+
+/**
+ * @brief Interpolates the mesh accelerations and potential onto the #gpart of
+ * a cell.
+ *
+ * This is the work of the mesh interpolation task of a cell.
+ *
+ * @param mesh The #pm_mesh.
+ * @param s The #space containing the particles.
+ * @param c The #cell.
+ */
+void pm_mesh_tasks_cell_interpolate(const struct pm_mesh* mesh,
+                                    const struct space* s,
+                                    const struct cell* c) {
+
+#ifdef HAVE_FFTW
+  cell_mesh_to_gpart(c, mesh->potential_global, mesh->potential2_tasks,
+                     /*potential_single=*/NULL, mesh->N, mesh->cell_fac,
+                     s->e->physical_constants->const_newton_G, mesh->dim,
+                     mesh->window_order);
+#else
+  error("No FFTW library found. Cannot compute periodic long-range forces.");
+#endif
+}
+
 /**
- * @brief Compute the mesh forces and potential, including periodic correction.
- *
- * Interpolates the top-level multipoles on-to a mesh, move to Fourier space,
- * compute the potential including short-range correction and move back
- * to real space. We use CIC for the interpolation.
+ * @brief Releases the work arrays of the mesh tasks once the step is over.
  *
- * This version stores the full N*N*N mesh on each MPI rank and uses the
- * non-MPI version of FFTW.
+ * @param mesh The #pm_mesh.
+ */
+void pm_mesh_tasks_clean(struct pm_mesh* mesh) {
+
+#ifdef HAVE_FFTW
+  if (mesh->frho_tasks != NULL) {
+    memuse_log_allocation("fftw_frho", mesh->frho_tasks, 0, 0);
+    fftw_free(mesh->frho_tasks);
+    mesh->frho_tasks = NULL;
+  }
+  if (mesh->potential2_tasks != NULL) {
+    memuse_log_allocation("fftw_rho2", mesh->potential2_tasks, 0, 0);
+    fftw_free(mesh->potential2_tasks);
+    mesh->potential2_tasks = NULL;
+  }
+  if (mesh->frho2_tasks != NULL) {
+    memuse_log_allocation("fftw_frho2", mesh->frho2_tasks, 0, 0);
+    fftw_free(mesh->frho2_tasks);
+    mesh->frho2_tasks = NULL;
+  }
+#endif
+  free(mesh->k2_fac_tasks);
+  mesh->k2_fac_tasks = NULL;
+}
+
+/**
+ * @brief Compute the potential, including periodic correction on the mesh,
+ * storing and transforming the global mesh in single precision.
  *
- * The particles mesh accelerations and potentials are also updated.
+ * Same as compute_potential_global() but the density and potential meshes,
+ * their transform and the MPI reduction are all in single precision, which
+ * halves the memory footprint and the communication volume of the mesh. The
+ * mass assignment of each cell and the interpolation back to the particles
+ * are still computed in double precision. Interlacing and the f(R) solver
+ * are not available in this mode.
  *
  * @param mesh The #pm_mesh used to store the potential.
  * @param s The #space containing the particles.
  * @param tp The #threadpool object used for parallelisation.
  * @param verbose Are we talkative?
  */
-void compute_potential_global(struct pm_mesh* mesh, const struct space* s,
-                              struct threadpool* tp, const int verbose) {
+void compute_potential_global_single(struct pm_mesh* mesh,
+                                     const struct space* s,
+                                     struct threadpool* tp,
+                                     const int verbose) {
 
-#ifdef HAVE_FFTW
+#if defined(HAVE_FFTW) && defined(HAVE_FFTWF)
 
   const double r_s = mesh->r_s;
   const double box_size = s->dim[0];
@@ -863,27 +2510,21 @@ void compute_potential_global(struct pm_mesh* mesh, const struct space* s,
   const double cell_fac = N / box_size;
 
   /* Use the memory allocated for the potential to temporarily store rho */
-  double* restrict rho = mesh->potential_global;
+  float* restrict rho = mesh->potential_global_single;
   if (rho == NULL) error("Error allocating memory for density mesh");
 
   /* Allocates some memory for the mesh in Fourier space */
-  fftw_complex* restrict frho =
-      (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * N * N * (N_half + 1));
+  fftwf_complex* restrict frho = (fftwf_complex*)fftwf_malloc(
+      sizeof(fftwf_complex) * N * N * (N_half + 1));
   if (frho == NULL)
     error("Error allocating memory for transform of density mesh");
-  memuse_log_allocation("fftw_frho", frho, 1,
-                        sizeof(fftw_complex) * N * N * (N_half + 1));
-
-  /* Prepare the FFT library */
-  fftw_plan forward_plan = fftw_plan_dft_r2c_3d(
-      N, N, N, rho, frho, FFTW_ESTIMATE | FFTW_DESTROY_INPUT);
-  fftw_plan inverse_plan = fftw_plan_dft_c2r_3d(
-      N, N, N, frho, rho, FFTW_ESTIMATE | FFTW_DESTROY_INPUT);
+  memuse_log_allocation("fftwf_frho", frho, 1,
+                        sizeof(fftwf_complex) * N * N * (N_half + 1));
 
   ticks tic = getticks();
 
   /* Zero everything */
-  bzero(rho, N * N * N * sizeof(double));
+  bzero(rho, (size_t)N * N * N * sizeof(float));
 
   /* Gather some neutrino constants if using delta-f weighting on the mesh */
   struct neutrino_model nu_model;
@@ -894,10 +2535,17 @@ void compute_potential_global(struct pm_mesh* mesh, const struct space* s,
   /* Gather the mesh shared information to be used by the threads */
   struct cic_mapper_data data;
   data.cells = s->cells_top;
-  data.rho = rho;
+  data.rho = NULL;
   data.potential = NULL;
+  data.potential2 = NULL;
+  data.rho_single = rho;
+  data.potential_single = NULL;
   data.N = N;
-  data.use_local_patches = mesh->use_local_patches;
+  data.window_order = mesh->window_order;
+  data.shift = 0.;
+  data.assignment = mesh_assignment_patches;
+  data.local_cells = local_cells;
+  data.patches = NULL;
   data.fac = cell_fac;
   data.dim[0] = dim[0];
   data.dim[1] = dim[1];
@@ -909,15 +2557,15 @@ void compute_potential_global(struct pm_mesh* mesh, const struct space* s,
 
     /* We don't have a cell infrastructure in place so we need to
      * directly loop over the particles */
-    threadpool_map(tp, gpart_to_mesh_CIC_mapper, s->gparts, s->nr_gparts,
+    threadpool_map(tp, gpart_to_mesh_mapper, s->gparts, s->nr_gparts,
                    sizeof(struct gpart), threadpool_auto_chunk_size,
                    (void*)&data);
 
   } else { /* Normal case */
 
-    /* Do a parallel CIC mesh assignment of the gparts but only using
+    /* Do a parallel mesh assignment of the gparts but only using
      * the local top-level cells */
-    threadpool_map(tp, cell_gpart_to_mesh_CIC_mapper, (void*)local_cells,
+    threadpool_map(tp, cell_gpart_to_mesh_mapper, (void*)local_cells,
                    nr_local_cells, sizeof(int), threadpool_auto_chunk_size,
                    (void*)&data);
   }
@@ -932,7 +2580,7 @@ void compute_potential_global(struct pm_mesh* mesh, const struct space* s,
   tic = getticks();
 
   /* Merge everybody's share of the density mesh */
-  MPI_Allreduce(MPI_IN_PLACE, rho, N * N * N, MPI_DOUBLE, MPI_SUM,
+  MPI_Allreduce(MPI_IN_PLACE, rho, N * N * N, MPI_FLOAT, MPI_SUM,
                 MPI_COMM_WORLD);
 
   if (verbose)
@@ -940,26 +2588,22 @@ void compute_potential_global(struct pm_mesh* mesh, const struct space* s,
             clocks_from_ticks(getticks() - tic), clocks_getunit());
 #endif
 
-  // message("\n\n\n DENSITY");
-  // print_array(rho, N);
-
   tic = getticks();
 
   /* Fourier transform to go to magic-land */
-  fftw_execute(forward_plan);
+  fftwf_execute_dft_r2c(mesh->forward_plan_single, rho, frho);
 
   if (verbose)
     message("Forward Fourier transform took %.3f %s.",
             clocks_from_ticks(getticks() - tic), clocks_getunit());
 
-  /* frho now contains the Fourier transform of the density field */
-  /* frho contains NxNx(N/2+1) complex numbers */
-
   tic = getticks();
 
-  /* Now de-convolve the CIC kernel and apply the Green function */
-  mesh_apply_Green_function(tp, frho, /*slice_offset=*/0, /*slice_width=*/N,
-                            /* mesh_size=*/N, r_s, box_size);
+  /* Now de-convolve the assignment window and apply the Green function (and
+   * the neutrino response) */
+  mesh_apply_Green_function_any(mesh, s, tp, /*frho=*/NULL, frho,
+                                /*slice_offset=*/0, /*slice_width=*/N,
+                                verbose);
 
   if (verbose)
     message("Applying Green function took %.3f %s.",
@@ -967,20 +2611,8 @@ void compute_potential_global(struct pm_mesh* mesh, const struct space* s,
 
   tic = getticks();
 
-  /* If using linear response neutrinos, apply the response to the mesh */
-  if (s->e->neutrino_properties->use_linear_response) {
-    neutrino_response_compute(s, mesh, tp, frho, /*slice_offset=*/0,
-                              /*slice_width=*/N, verbose);
-
-    if (verbose)
-      message("Applying neutrino response took %.3f %s.",
-              clocks_from_ticks(getticks() - tic), clocks_getunit());
-
-    tic = getticks();
-  }
-
   /* Fourier transform to come back from magic-land */
-  fftw_execute(inverse_plan);
+  fftwf_execute_dft_c2r(mesh->inverse_plan_single, frho, rho);
 
   if (verbose)
     message("Reverse Fourier transform took %.3f %s.",
@@ -989,38 +2621,26 @@ void compute_potential_global(struct pm_mesh* mesh, const struct space* s,
   /* rho now contains the potential */
   /* This array is now again NxNxN real numbers */
 
-  /* Let's store it in the structure */
-  mesh->potential_global = rho;
-
-  /* message("\n\n\n POTENTIAL"); */
-  /* print_array(mesh->potential_global, N); */
-
   tic = getticks();
 
   /* Gather the mesh shared information to be used by the threads */
-  data.cells = s->cells_top;
-  data.rho = NULL;
-  data.potential = mesh->potential_global;
-  data.N = N;
-  data.fac = cell_fac;
-  data.dim[0] = dim[0];
-  data.dim[1] = dim[1];
-  data.dim[2] = dim[2];
+  data.rho_single = NULL;
+  data.potential_single = rho;
   data.const_G = s->e->physical_constants->const_newton_G;
 
   if (nr_local_cells == 0) {
 
     /* We don't have a cell infrastructure in place so we need to
      * directly loop over the particles */
-    threadpool_map(tp, mesh_to_gpart_CIC_mapper, s->gparts, s->nr_gparts,
+    threadpool_map(tp, mesh_to_gpart_mapper, s->gparts, s->nr_gparts,
                    sizeof(struct gpart), threadpool_auto_chunk_size,
                    (void*)&data);
 
   } else { /* Normal case */
 
-    /* Do a parallel CIC mesh interpolation onto the gparts but only using
+    /* Do a parallel mesh interpolation onto the gparts but only using
        the local top-level cells */
-    threadpool_map(tp, cell_mesh_to_gpart_CIC_mapper, (void*)local_cells,
+    threadpool_map(tp, cell_mesh_to_gpart_mapper, (void*)local_cells,
                    nr_local_cells, sizeof(int), threadpool_auto_chunk_size,
                    (void*)&data);
   }
@@ -1030,16 +2650,37 @@ void compute_potential_global(struct pm_mesh* mesh, const struct space* s,
             clocks_from_ticks(getticks() - tic), clocks_getunit());
 
   /* Clean-up the mess */
-  fftw_destroy_plan(forward_plan);
-  fftw_destroy_plan(inverse_plan);
-  memuse_log_allocation("fftw_frho", frho, 0, 0);
-  fftw_free(frho);
+  memuse_log_allocation("fftwf_frho", frho, 0, 0);
+  fftwf_free(frho);
 
 #else
-  error("No FFTW library found. Cannot compute periodic long-range forces.");
+  error(
+      "No single-precision FFTW library found. Cannot compute the mesh in "
+      "single precision.");
 #endif
 }
 
+/**
+ * @brief Splits the x axis of the mesh into slabs, one per MPI rank.
+ *
+ * @param N The side-length of the mesh.
+ * @param nr_nodes The number of MPI ranks.
+ * @param slab_offset (return) The first x coordinate of each slab.
+ * @param slab_width (return) The width of each slab.
+ */
+#if defined(WITH_MPI) && defined(HAVE_FFTW)
+static void mesh_slab_decomposition(const int N, const int nr_nodes,
+                                    int* slab_offset, int* slab_width) {
+
+  int offset = 0;
+  for (int i = 0; i < nr_nodes; ++i) {
+    slab_width[i] = N / nr_nodes + (i < N % nr_nodes ? 1 : 0);
+    slab_offset[i] = offset;
+    offset += slab_width[i];
+  }
+}
+#endif
+
 /**
  * @brief Compute the mesh forces and potential, including periodic correction.
  *
@@ -1047,6 +2688,215 @@ void compute_potential_global(struct pm_mesh* mesh, const struct space* s,
  * compute the potential including short-range correction and move back
  * to real space. We use CIC for the interpolation.
  *
+ * Each rank assigns its particles to a full N*N*N mesh as in the global case
+ * but the meshes are then reduce-scattered into x slabs rather than
+ * all-reduced. The FFT is done by slab: 2D transforms of the local (y, z)
+ * planes, a transpose between the ranks and 1D transforms along x. The
+ * potential ends up in x slabs again and each rank fetches only the mesh
+ * cells its top-level cells need, as done for the distributed mesh. No rank
+ * keeps a full copy of the potential.
+ *
+ * @param mesh The #pm_mesh used to store the potential.
+ * @param s The #space containing the particles.
+ * @param tp The #threadpool object used for parallelisation.
+ * @param verbose Are we talkative?
+ */
+void compute_potential_reduce_scatter(struct pm_mesh* mesh,
+                                      const struct space* s,
+                                      struct threadpool* tp,
+                                      const int verbose) {
+
+#if defined(WITH_MPI) && defined(HAVE_FFTW)
+
+  const double r_s = mesh->r_s;
+  const double box_size = s->dim[0];
+  const double dim[3] = {s->dim[0], s->dim[1], s->dim[2]};
+  const int* local_cells = s->local_cells_top;
+  const int nr_local_cells = s->nr_local_cells;
+
+  if (r_s <= 0.) error("Invalid value of a_smooth");
+  if (mesh->dim[0] != dim[0] || mesh->dim[1] != dim[1] ||
+      mesh->dim[2] != dim[2])
+    error("Domain size does not match the value stored in the space.");
+
+  /* Some useful constants */
+  const int N = mesh->N;
+  const int Nz = N / 2 + 1;
+  const int stride_z = 2 * Nz;
+  const double cell_fac = N / box_size;
+
+  int nr_nodes;
+  MPI_Comm_size(MPI_COMM_WORLD, &nr_nodes);
+  int* slab_offset = (int*)malloc(nr_nodes * sizeof(int));
+  int* slab_width = (int*)malloc(nr_nodes * sizeof(int));
+  int* recv_counts = (int*)malloc(nr_nodes * sizeof(int));
+  if (slab_offset == NULL || slab_width == NULL || recv_counts == NULL)
+    error("Error allocating the mesh slab decomposition.");
+  mesh_slab_decomposition(N, nr_nodes, slab_offset, slab_width);
+  for (int i = 0; i < nr_nodes; ++i) recv_counts[i] = slab_width[i] * N * N;
+
+  const int local_0_start = mesh->slab_offset;
+  const int local_n0 = mesh->slab_width;
+  const size_t slab_size = (size_t)local_n0 * N * stride_z;
+
+  /* Full density mesh, only needed until it is scattered */
+  double* rho = (double*)fftw_malloc(sizeof(double) * N * N * N);
+  if (rho == NULL) error("Error allocating memory for density mesh");
+  memuse_log_allocation("fftw_rho", rho, 1, sizeof(double) * N * N * N);
+  bzero(rho, N * N * N * sizeof(double));
+
+  ticks tic = getticks();
+
+  /* Gather some neutrino constants if using delta-f weighting on the mesh */
+  struct neutrino_model nu_model;
+  bzero(&nu_model, sizeof(struct neutrino_model));
+  if (s->e->neutrino_properties->use_delta_f_mesh_only)
+    gather_neutrino_consts(s, &nu_model);
+
+  /* Do a parallel CIC mesh assignment of the gparts of the local top-level
+   * cells */
+  cells_gpart_to_mesh(tp, rho, N, cell_fac, dim, s->cells_top, local_cells,
+                      nr_local_cells,
+                      (enum mesh_assignment_mode)mesh->assignment,
+                      /*window_order=*/2, /*shift=*/0., &nu_model);
+
+  if (verbose)
+    message("Gpart assignment took %.3f %s.",
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  tic = getticks();
+
+  /* Sum everybody's share of the density mesh, keeping only our slab (at the
+   * start of the array) */
+  MPI_Reduce_scatter(MPI_IN_PLACE, rho, recv_counts, MPI_DOUBLE, MPI_SUM,
+                     MPI_COMM_WORLD);
+
+  if (verbose)
+    message("Mesh MPI reduce-scatter took %.3f %s.",
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
+
+  /* Copy the slab to an array padded along z for the in-place transforms */
+  double* rho_slice = (double*)fftw_malloc(sizeof(double) * slab_size);
+  double* frho_slice = (double*)fftw_malloc(sizeof(double) * slab_size);
+  if (rho_slice == NULL || frho_slice == NULL)
+    error("Error allocating memory for the mesh slabs");
+  memuse_log_allocation("fftw_rho_slice", rho_slice, 1,
+                        sizeof(double) * slab_size);
+  memuse_log_allocation("fftw_frho_slice", frho_slice, 1,
+                        sizeof(double) * slab_size);
+  for (size_t row = 0; row < (size_t)local_n0 * N; ++row)
+    memcpy(rho_slice + row * stride_z, rho + row * N, N * sizeof(double));
+
+  memuse_log_allocation("fftw_rho", rho, 0, 0);
+  fftw_free(rho);
+
+  /* Solve for the f(R) field on the slabs before the FFT destroys them */
+  if (mesh->multigrid.active) {
+    if (mesh->multigrid.nr_levels == 0)
+      pm_multigrid_allocate(&mesh->multigrid, N, local_0_start, local_n0,
+                            box_size, /*use_mpi=*/1);
+    pm_multigrid_solve_fR(&mesh->multigrid, rho_slice, stride_z,
+                          s->e->cosmology, s->e->physical_constants, tp,
+                          verbose);
+  }
+
+  tic = getticks();
+
+  /* Transform the (y, z) planes, swap x and y between the ranks and
+   * transform along x. The modes end up as (ky, kx, kz) with ky in our slab
+   * range, which is how the FFTW MPI library lays out transposed output. */
+  fftw_execute_dft_r2c(mesh->forward_plan, rho_slice,
+                       (fftw_complex*)rho_slice);
+  mpi_mesh_transpose_slabs(N, Nz, slab_offset, slab_width, rho_slice,
+                           frho_slice);
+  fftw_execute_dft(mesh->forward_plan_x, (fftw_complex*)frho_slice,
+                   (fftw_complex*)frho_slice);
+
+  if (verbose)
+    message("Slab forward Fourier transform took %.3f %s.",
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
+
+  tic = getticks();
+
+  /* Apply the Green function (and the neutrino response). It is symmetric in
+   * kx and ky so the transposed layout can be treated as a slab in x. */
+  mesh_apply_Green_function(mesh, s, tp, (fftw_complex*)frho_slice,
+                            local_0_start, local_n0, verbose);
+
+  if (verbose)
+    message("Applying Green function took %.3f %s.",
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
+
+  tic = getticks();
+
+  /* And back to real space in x slabs */
+  fftw_execute_dft(mesh->inverse_plan_x, (fftw_complex*)frho_slice,
+                   (fftw_complex*)frho_slice);
+  mpi_mesh_transpose_slabs(N, Nz, slab_offset, slab_width, frho_slice,
+                           rho_slice);
+  fftw_execute_dft_c2r(mesh->inverse_plan, (fftw_complex*)rho_slice,
+                       rho_slice);
+
+  if (verbose)
+    message("Slab reverse Fourier transform took %.3f %s.",
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
+
+  /* Add the f(R) fifth force to the potential */
+  if (mesh->multigrid.active)
+    pm_multigrid_add_fifth_force_potential(&mesh->multigrid, rho_slice,
+                                           stride_z, s->e->cosmology,
+                                           s->e->physical_constants);
+
+  memuse_log_allocation("fftw_frho_slice", frho_slice, 0, 0);
+  fftw_free(frho_slice);
+
+  tic = getticks();
+
+  /* Fetch the potential of the mesh cells we need from the other ranks */
+  struct pm_mesh_patch* local_patches = (struct pm_mesh_patch*)calloc(
+      nr_local_cells, sizeof(struct pm_mesh_patch));
+  if (local_patches == NULL)
+    error("Could not allocate array of local mesh patches!");
+  mpi_mesh_fetch_potential(N, cell_fac, s, local_0_start, local_n0, rho_slice,
+                           local_patches, tp, verbose);
+
+  if (verbose)
+    message("Fetching local potential took %.3f %s.",
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
+
+  memuse_log_allocation("fftw_rho_slice", rho_slice, 0, 0);
+  fftw_free(rho_slice);
+
+  tic = getticks();
+
+  /* Compute accelerations and potentials for the gparts */
+  mpi_mesh_update_gparts(local_patches, s, tp, N, cell_fac);
+
+  for (int i = 0; i < nr_local_cells; ++i)
+    pm_mesh_patch_clean(&local_patches[i]);
+  free(local_patches);
+
+  if (verbose)
+    message("Computing mesh accelerations took %.3f %s.",
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
+
+  free(recv_counts);
+  free(slab_width);
+  free(slab_offset);
+
+#else
+  error("The reduce-scatter mesh requires MPI and FFTW.");
+#endif
+}
+
+/**
+ * @brief Compute the mesh forces and potential, including periodic correction.
+ *
+ * Interpolates the top-level multipoles on-to a mesh, move to Fourier space,
+ * compute the potential including short-range correction and move back
+ * to real space.
+ *
  * This function calls the appropriate implementation depending on whether
  * we're using the MPI version of FFTW.
  *
@@ -1059,6 +2909,10 @@ void pm_mesh_compute_potential(struct pm_mesh* mesh, const struct space* s,
                                struct threadpool* tp, const int verbose) {
   if (mesh->distributed_mesh) {
     compute_potential_distributed(mesh, s, tp, verbose);
+  } else if (mesh->reduce_scatter) {
+    compute_potential_reduce_scatter(mesh, s, tp, verbose);
+  } else if (mesh->single_precision) {
+    compute_potential_global_single(mesh, s, tp, verbose);
   } else {
     compute_potential_global(mesh, s, tp, verbose);
   }
@@ -1073,8 +2927,23 @@ void pm_mesh_allocate(struct pm_mesh* mesh) {
 
 #ifdef HAVE_FFTW
 
-  if (mesh->distributed_mesh) {
+  if (mesh->distributed_mesh || mesh->reduce_scatter) {
+
+  } else if (mesh->single_precision) {
+#ifdef HAVE_FFTWF
+    const int N = mesh->N;
 
+    /* Allocate the memory for the combined density and potential array */
+    mesh->potential_global_single =
+        (float*)fftwf_malloc(sizeof(float) * N * N * N);
+    if (mesh->potential_global_single == NULL)
+      error("Error allocating memory for the long-range gravity mesh.");
+    memuse_log_allocation("fftwf_mesh.potential",
+                          mesh->potential_global_single, 1,
+                          sizeof(float) * N * N * N);
+#else
+    error("No single-precision FFTW library found.");
+#endif
   } else {
     const int N = mesh->N;
 
@@ -1105,6 +2974,15 @@ void pm_mesh_free(struct pm_mesh* mesh) {
     mesh->potential_global = NULL;
   }
 
+#ifdef HAVE_FFTWF
+  if (mesh->potential_global_single) {
+    memuse_log_allocation("fftwf_mesh.potential",
+                          mesh->potential_global_single, 0, 0);
+    fftwf_free(mesh->potential_global_single);
+    mesh->potential_global_single = NULL;
+  }
+#endif
+
 #else
   error("No FFTW library found. Cannot compute periodic long-range forces.");
 #endif
@@ -1129,8 +3007,233 @@ void initialise_fftw(int N, int nr_threads) {
   /* Set  number of threads to use */
   if (N >= 64) fftw_plan_with_nthreads(nr_threads);
 #endif
+#ifdef HAVE_THREADED_FFTWF
+  /* Same for the single-precision library */
+  if (N >= 64) {
+    fftwf_init_threads();
+    fftwf_plan_with_nthreads(nr_threads);
+  }
+#endif
+
+  /* Re-use what a previous run learnt while planning */
+  fft_plans_import_wisdom();
+}
+
+#ifdef HAVE_FFTW
+
+/**
+ * @brief Creates the FFTW plans of the mesh tasks.
+ *
+ * Each task transforms a few planes of the mesh on a single runner, so these
+ * plans use a single thread and are executed on parts of the arrays they
+ * were planned on (hence FFTW_UNALIGNED). The transforms of the (y, z)
+ * planes write their output transposed, as (ky, x, kz), such that the
+ * transforms along x and the Green function then work on contiguous ky
+ * planes.
+ *
+ * @param mesh The #pm_mesh.
+ * @param rho A temporary N*N*N real array.
+ * @param frho A temporary N*N*(N/2+1) complex array.
+ * @param flags The planner flags.
+ */
+static void pm_mesh_make_task_plans(struct pm_mesh* mesh, double* rho,
+                                    fftw_complex* frho, unsigned int flags) {
+
+  const int N = mesh->N;
+  const int Nz = N / 2 + 1;
+  flags |= FFTW_UNALIGNED;
+
+#ifdef HAVE_THREADED_FFTW
+  if (N >= 64) fftw_plan_with_nthreads(1);
+#endif
+
+  /* (y, z) planes of one x plane, from (x, y, z) to (ky, x, kz) */
+  fftw_iodim dims[2];
+  dims[0].n = N;
+  dims[0].is = N;
+  dims[0].os = N * Nz;
+  dims[1].n = N;
+  dims[1].is = 1;
+  dims[1].os = 1;
+  mesh->forward_plan_tasks =
+      fftw_plan_guru_dft_r2c(2, dims, 0, NULL, rho, frho, flags);
+
+  /* And back */
+  dims[0].is = N * Nz;
+  dims[0].os = N;
+  mesh->inverse_plan_tasks =
+      fftw_plan_guru_dft_c2r(2, dims, 0, NULL, frho, rho, flags);
+
+  /* In-place transforms along x of one ky plane */
+  fftw_iodim dim_x;
+  dim_x.n = N;
+  dim_x.is = Nz;
+  dim_x.os = Nz;
+  fftw_iodim loop_z;
+  loop_z.n = Nz;
+  loop_z.is = 1;
+  loop_z.os = 1;
+  mesh->forward_plan_tasks_x = fftw_plan_guru_dft(1, &dim_x, 1, &loop_z, frho,
+                                                  frho, FFTW_FORWARD, flags);
+  mesh->inverse_plan_tasks_x = fftw_plan_guru_dft(1, &dim_x, 1, &loop_z, frho,
+                                                  frho, FFTW_BACKWARD, flags);
+
+#ifdef HAVE_THREADED_FFTW
+  if (N >= 64) fftw_plan_with_nthreads(mesh->nr_threads);
+#endif
+
+  if (mesh->forward_plan_tasks == NULL || mesh->inverse_plan_tasks == NULL ||
+      mesh->forward_plan_tasks_x == NULL || mesh->inverse_plan_tasks_x == NULL)
+    error("Failed to create the FFTW plans of the mesh tasks.");
+}
+
+/**
+ * @brief Creates the FFTW plans of the mesh once for the whole run.
+ *
+ * The plans are created on temporary arrays (planning with
+ * FFTW_MEASURE/PATIENT overwrites them) and later executed on the actual
+ * arrays using the new-array execute functions. Arrays obtained from
+ * fftw_malloc() all have the alignment FFTW requires for that.
+ *
+ * @param mesh The #pm_mesh.
+ */
+static void pm_mesh_make_plans(struct pm_mesh* mesh) {
+
+  const int N = mesh->N;
+  const unsigned int flags =
+      fft_plans_flags((enum fft_plans_effort)mesh->fftw_planner) |
+      FFTW_DESTROY_INPUT;
+
+  const ticks tic = getticks();
+
+  if (mesh->distributed_mesh) {
+
+#if defined(WITH_MPI) && defined(HAVE_MPI_FFTW)
+    ptrdiff_t local_n0, local_0_start;
+    const ptrdiff_t nalloc = fftw_mpi_local_size_3d(
+        (ptrdiff_t)N, (ptrdiff_t)N, (ptrdiff_t)(N / 2 + 1), MPI_COMM_WORLD,
+        &local_n0, &local_0_start);
+
+    double* rho_slice = (double*)fftw_malloc(2 * nalloc * sizeof(double));
+    fftw_complex* frho_slice =
+        (fftw_complex*)fftw_malloc(nalloc * sizeof(fftw_complex));
+    if (rho_slice == NULL || frho_slice == NULL)
+      error("Error allocating memory to plan the mesh FFTs.");
+
+    /* See compute_potential_distributed() for the layout */
+    mesh->forward_plan = fftw_mpi_plan_dft_r2c_3d(
+        N, N, N, rho_slice, frho_slice, MPI_COMM_WORLD,
+        flags | FFTW_MPI_TRANSPOSED_OUT);
+    mesh->inverse_plan = fftw_mpi_plan_dft_c2r_3d(
+        N, N, N, frho_slice, rho_slice, MPI_COMM_WORLD,
+        flags | FFTW_MPI_TRANSPOSED_IN);
+
+    fftw_free(frho_slice);
+    fftw_free(rho_slice);
+#else
+    error("No FFTW MPI library available. Cannot compute distributed mesh.");
+#endif
+
+  } else if (mesh->reduce_scatter) {
+
+    /* See compute_potential_reduce_scatter() for the layout */
+    const int Nz = N / 2 + 1;
+    const int width = mesh->slab_width;
+    const size_t slab_size = (size_t)width * N * 2 * Nz;
+    double* rho_slice = (double*)fftw_malloc(sizeof(double) * slab_size);
+    if (rho_slice == NULL)
+      error("Error allocating memory to plan the mesh FFTs.");
+    fftw_complex* frho_slice = (fftw_complex*)rho_slice;
+
+    /* In-place 2D transforms of the (y, z) planes of the x slab */
+    const int n[2] = {N, N};
+    const int real_embed[2] = {N, 2 * Nz};
+    const int complex_embed[2] = {N, Nz};
+    mesh->forward_plan = fftw_plan_many_dft_r2c(
+        2, n, width, rho_slice, real_embed, 1, N * 2 * Nz, frho_slice,
+        complex_embed, 1, N * Nz, flags);
+    mesh->inverse_plan = fftw_plan_many_dft_c2r(
+        2, n, width, frho_slice, complex_embed, 1, N * Nz, rho_slice,
+        real_embed, 1, N * 2 * Nz, flags);
+
+    /* In-place 1D transforms along x of the transposed (y, x, z) slab */
+    fftw_iodim dim_x;
+    dim_x.n = N;
+    dim_x.is = Nz;
+    dim_x.os = Nz;
+    fftw_iodim loops[2];
+    loops[0].n = width;
+    loops[0].is = N * Nz;
+    loops[0].os = N * Nz;
+    loops[1].n = Nz;
+    loops[1].is = 1;
+    loops[1].os = 1;
+    mesh->forward_plan_x = fftw_plan_guru_dft(
+        1, &dim_x, 2, loops, frho_slice, frho_slice, FFTW_FORWARD, flags);
+    mesh->inverse_plan_x = fftw_plan_guru_dft(
+        1, &dim_x, 2, loops, frho_slice, frho_slice, FFTW_BACKWARD, flags);
+
+    if (mesh->forward_plan_x == NULL || mesh->inverse_plan_x == NULL)
+      error("Failed to create the FFTW plans of the mesh slabs.");
+
+    fftw_free(rho_slice);
+
+  } else if (mesh->single_precision) {
+
+#ifdef HAVE_FFTWF
+    const size_t nr_complex = (size_t)N * N * (N / 2 + 1);
+    float* rho = (float*)fftwf_malloc(sizeof(float) * N * N * N);
+    fftwf_complex* frho =
+        (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * nr_complex);
+    if (rho == NULL || frho == NULL)
+      error("Error allocating memory to plan the mesh FFTs.");
+
+    /* The single-precision plans are not part of the stored wisdom */
+    mesh->forward_plan_single =
+        fftwf_plan_dft_r2c_3d(N, N, N, rho, frho, flags);
+    mesh->inverse_plan_single =
+        fftwf_plan_dft_c2r_3d(N, N, N, frho, rho, flags);
+
+    if (mesh->forward_plan_single == NULL ||
+        mesh->inverse_plan_single == NULL)
+      error("Failed to create the FFTW plans of the mesh.");
+
+    fftwf_free(frho);
+    fftwf_free(rho);
+#else
+    error("No single-precision FFTW library found.");
+#endif
+
+  } else {
+
+    const size_t nr_complex = (size_t)N * N * (N / 2 + 1);
+    double* rho = (double*)fftw_malloc(sizeof(double) * N * N * N);
+    fftw_complex* frho =
+        (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * nr_complex);
+    if (rho == NULL || frho == NULL)
+      error("Error allocating memory to plan the mesh FFTs.");
+
+    mesh->forward_plan = fftw_plan_dft_r2c_3d(N, N, N, rho, frho, flags);
+    mesh->inverse_plan = fftw_plan_dft_c2r_3d(N, N, N, frho, rho, flags);
+
+    if (mesh->use_tasks) pm_mesh_make_task_plans(mesh, rho, frho, flags);
+
+    fftw_free(frho);
+    fftw_free(rho);
+  }
+
+  if (!mesh->single_precision &&
+      (mesh->forward_plan == NULL || mesh->inverse_plan == NULL))
+    error("Failed to create the FFTW plans of the mesh.");
+
+  if (engine_rank == 0)
+    message("Planning the mesh FFTs (%s) took %.3f %s.",
+            fft_plans_effort_name((enum fft_plans_effort)mesh->fftw_planner),
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
 }
 
+#endif /* HAVE_FFTW */
+
 /**
  * @brief Initialises the mesh used for the long-range periodic forces
  *
@@ -1154,7 +3257,19 @@ void pm_mesh_init(struct pm_mesh* mesh, const struct gravity_props* props,
   mesh->periodic = 1;
   mesh->N = N;
   mesh->distributed_mesh = props->distributed_mesh;
-  mesh->use_local_patches = props->mesh_uses_local_patches;
+  mesh->reduce_scatter = props->mesh_reduce_scatter;
+  mesh->slab_offset = 0;
+  mesh->slab_width = N;
+  mesh->assignment = props->mesh_assignment;
+  mesh->window_order = props->mesh_window_order;
+  mesh->interlacing = props->mesh_interlacing;
+  mesh->single_precision = props->mesh_single_precision;
+  mesh->use_tasks = props->mesh_tasks;
+  mesh->nr_task_blocks = min(N, 4 * nr_threads);
+  mesh->potential2_tasks = NULL;
+  mesh->k2_fac_tasks = NULL;
+  mesh->frho_tasks = NULL;
+  mesh->frho2_tasks = NULL;
   mesh->dim[0] = dim[0];
   mesh->dim[1] = dim[1];
   mesh->dim[2] = dim[2];
@@ -1164,6 +3279,14 @@ void pm_mesh_init(struct pm_mesh* mesh, const struct gravity_props* props,
   mesh->r_cut_max = mesh->r_s * props->r_cut_max_ratio;
   mesh->r_cut_min = mesh->r_s * props->r_cut_min_ratio;
   mesh->potential_global = NULL;
+  mesh->potential_global_single = NULL;
+  mesh->window_deconv = NULL;
+  mesh->green_k2 = NULL;
+  mesh->fftw_planner = props->mesh_fftw_planner;
+  mesh->use_green_cache = props->mesh_green_function_cache;
+  mesh->green_cache = NULL;
+  mesh->green_cache_offset = -1;
+  mesh->green_cache_width = -1;
   mesh->ti_beg_mesh_last = -1;
   mesh->ti_end_mesh_last = -1;
   mesh->ti_beg_mesh_next = -1;
@@ -1174,12 +3297,41 @@ void pm_mesh_init(struct pm_mesh* mesh, const struct gravity_props* props,
         "Mesh too big. The number of cells is larger than 2^31. "
         "Use a mesh side-length <= 1290 or a distributed mesh.");
 
+#ifdef WITH_MPI
+  /* Find the slab of the mesh this rank works on */
+  if (mesh->reduce_scatter) {
+    int nr_nodes, nodeID;
+    MPI_Comm_size(MPI_COMM_WORLD, &nr_nodes);
+    MPI_Comm_rank(MPI_COMM_WORLD, &nodeID);
+    if (N < nr_nodes)
+      error("The reduce-scatter mesh needs at least one plane per rank.");
+
+    int* slab_offset = (int*)malloc(nr_nodes * sizeof(int));
+    int* slab_width = (int*)malloc(nr_nodes * sizeof(int));
+    mesh_slab_decomposition(N, nr_nodes, slab_offset, slab_width);
+    mesh->slab_offset = slab_offset[nodeID];
+    mesh->slab_width = slab_width[nodeID];
+    free(slab_width);
+    free(slab_offset);
+  }
+#endif
+
   if (2. * mesh->r_cut_max > box_size)
     error("Mesh too small or r_cut_max too big for this box size");
 
+#ifdef WITH_MPI
+  /* Communicators of the reductions done by the mesh tasks */
+  if (mesh->use_tasks)
+    for (int n = 0; n < 2; ++n)
+      MPI_Comm_dup(MPI_COMM_WORLD, &mesh->reduce_comms[n]);
+#endif
+
   initialise_fftw(N, mesh->nr_threads);
 
   pm_mesh_allocate(mesh);
+  pm_mesh_make_plans(mesh);
+
+  pm_multigrid_init(&mesh->multigrid, props);
 
 #else
   error("No FFTW library found. Cannot compute periodic long-range forces.");
@@ -1219,14 +3371,50 @@ void pm_mesh_init_no_mesh(struct pm_mesh* mesh, double dim[3]) {
  */
 void pm_mesh_clean(struct pm_mesh* mesh) {
 
+#ifdef HAVE_FFTW
+  if (mesh->periodic && mesh->single_precision) {
+#ifdef HAVE_FFTWF
+    fftwf_destroy_plan(mesh->forward_plan_single);
+    fftwf_destroy_plan(mesh->inverse_plan_single);
+#endif
+  } else if (mesh->periodic) {
+    fftw_destroy_plan(mesh->forward_plan);
+    fftw_destroy_plan(mesh->inverse_plan);
+    if (mesh->reduce_scatter) {
+      fftw_destroy_plan(mesh->forward_plan_x);
+      fftw_destroy_plan(mesh->inverse_plan_x);
+    }
+    if (mesh->use_tasks) {
+      fftw_destroy_plan(mesh->forward_plan_tasks);
+      fftw_destroy_plan(mesh->inverse_plan_tasks);
+      fftw_destroy_plan(mesh->forward_plan_tasks_x);
+      fftw_destroy_plan(mesh->inverse_plan_tasks_x);
+    }
+  }
+#endif
+#ifdef WITH_MPI
+  if (mesh->periodic && mesh->use_tasks)
+    for (int n = 0; n < 2; ++n) MPI_Comm_free(&mesh->reduce_comms[n]);
+#endif
 #ifdef HAVE_THREADED_FFTW
   fftw_cleanup_threads();
 #endif
+#ifdef HAVE_THREADED_FFTWF
+  fftwf_cleanup_threads();
+#endif
 #if defined(WITH_MPI) && defined(HAVE_MPI_FFTW)
   fftw_mpi_cleanup();
 #endif
 
   pm_mesh_free(mesh);
+  pm_multigrid_clean(&mesh->multigrid);
+
+  free(mesh->window_deconv);
+  free(mesh->green_k2);
+  if (mesh->green_cache != NULL) swift_free("green_cache", mesh->green_cache);
+  mesh->window_deconv = NULL;
+  mesh->green_k2 = NULL;
+  mesh->green_cache = NULL;
 }
 
 /**
@@ -1251,6 +3439,22 @@ void pm_mesh_struct_restore(struct pm_mesh* mesh, FILE* stream) {
 
   restart_read_blocks((void*)mesh, sizeof(struct pm_mesh), 1, stream, NULL,
                       "gravity props");
+  pm_multigrid_struct_restore(&mesh->multigrid);
+
+  /* The mesh tasks allocate their work arrays when needed */
+  mesh->potential2_tasks = NULL;
+  mesh->k2_fac_tasks = NULL;
+#ifdef HAVE_FFTW
+  mesh->frho_tasks = NULL;
+  mesh->frho2_tasks = NULL;
+#endif
+
+  /* The Green function tables are rebuilt when first needed */
+  mesh->window_deconv = NULL;
+  mesh->green_k2 = NULL;
+  mesh->green_cache = NULL;
+  mesh->green_cache_offset = -1;
+  mesh->green_cache_width = -1;
 
   if (mesh->periodic) {
 
@@ -1259,6 +3463,13 @@ void pm_mesh_struct_restore(struct pm_mesh* mesh, FILE* stream) {
 
     initialise_fftw(N, mesh->nr_threads);
     pm_mesh_allocate(mesh);
+    pm_mesh_make_plans(mesh);
+
+#ifdef WITH_MPI
+    if (mesh->use_tasks)
+      for (int n = 0; n < 2; ++n)
+        MPI_Comm_dup(MPI_COMM_WORLD, &mesh->reduce_comms[n]);
+#endif
 
 #else
     error("No FFTW library found. Cannot compute periodic long-range forces.");
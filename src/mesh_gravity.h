@@ -22,8 +22,18 @@
 /* Config parameters. */
 #include <config.h>
 
+#ifdef HAVE_FFTW
+#include <fftw3.h>
+#endif
+
+/* MPI headers. */
+#ifdef WITH_MPI
+#include <mpi.h>
+#endif
+
 /* Local headers */
 #include "gravity_properties.h"
+#include "mesh_gravity_multigrid.h"
 #include "timeline.h"
 
 /* Forward declarations */
@@ -32,6 +42,7 @@ struct space;
 struct gpart;
 struct threadpool;
 struct cell;
+struct neutrino_model;
 
 /**
  * @brief Data structure for the long-range periodic forces using a mesh
@@ -50,9 +61,50 @@ struct pm_mesh {
   /*! Whether mesh is distributed between MPI ranks */
   int distributed_mesh;
 
-  /*! Whether or not to use local patches rather than
-   * direct atomic writes to the mesh when running without MPI */
-  int use_local_patches;
+  /*! Whether the density is reduce-scattered to slabs and transformed with a
+   * slab-decomposed FFT when running over MPI without a distributed mesh */
+  int reduce_scatter;
+
+  /*! First x coordinate of the slab held by this rank (reduce-scatter) */
+  int slab_offset;
+
+  /*! Width of the slab held by this rank (reduce-scatter) */
+  int slab_width;
+
+  /*! How particles are assigned to the mesh when running without MPI
+   * (#mesh_assignment_mode) */
+  int assignment;
+
+  /*! Order of the mass assignment and interpolation window (2: CIC, 3: TSC,
+   * 4: PCS) */
+  int window_order;
+
+  /*! Do we also use a second mesh shifted by half a cell (interlacing)? */
+  int interlacing;
+
+  /*! Is the global mesh stored and transformed in single precision? */
+  int single_precision;
+
+  /*! Are the mesh forces computed by tasks overlapping the tree walk? */
+  int use_tasks;
+
+  /*! Number of blocks of planes the transforms of the mesh tasks are split
+   * into */
+  int nr_task_blocks;
+
+  /*! Density (then potential) mesh shifted by half a cell used by the tasks
+   * when interlacing (NULL outside of the steps computing the mesh forces) */
+  double *potential2_tasks;
+
+  /*! Isotropic factors of the Green function used by the tasks in this step
+   * (NULL outside of the steps computing the mesh forces) */
+  double *k2_fac_tasks;
+
+#ifdef WITH_MPI
+  /*! Communicators of the reductions of the mesh tasks, one per mesh so that
+   * the ranks can start them in any order */
+  MPI_Comm reduce_comms[2];
+#endif
 
   /*! Integer time-step end of the mesh force for the last step */
   integertime_t ti_end_mesh_last;
@@ -86,6 +138,79 @@ struct pm_mesh {
 
   /*! Full N*N*N potential field */
   double *potential_global;
+
+  /*! Full N*N*N potential field in single precision (replaces
+   * potential_global when running in single precision) */
+  float *potential_global_single;
+
+  /*! Inverse of the square of the assignment window along one axis, indexed
+   * by mesh coordinate (NULL until first used) */
+  double *window_deconv;
+
+  /*! Long-range Green function as a function of the integer |k|^2 of the
+   * modes (NULL until first used) */
+  double *green_k2;
+
+  /*! Do we cache the full k-space multiplier of the local mesh slice? */
+  int use_green_cache;
+
+  /*! Single-precision Green function times window deconvolution of every mode
+   * of the local mesh slice (NULL if not in use) */
+  float *green_cache;
+
+  /*! First x coordinate of the mesh slice the cache was built for */
+  int green_cache_offset;
+
+  /*! Width of the mesh slice the cache was built for */
+  int green_cache_width;
+
+  /*! Effort FFTW spends planning the transforms (#fft_plans_effort) */
+  int fftw_planner;
+
+#ifdef HAVE_FFTW
+  /*! Forward (real to complex) transform, planned once and re-used */
+  fftw_plan forward_plan;
+
+  /*! Inverse (complex to real) transform, planned once and re-used */
+  fftw_plan inverse_plan;
+
+  /*! Forward transforms along x of the transposed slab (reduce-scatter) */
+  fftw_plan forward_plan_x;
+
+  /*! Inverse transforms along x of the transposed slab (reduce-scatter) */
+  fftw_plan inverse_plan_x;
+
+  /*! Transform of the (y, z) planes of one x plane into the transposed
+   * layout used by the mesh tasks */
+  fftw_plan forward_plan_tasks;
+
+  /*! Inverse transform of the (ky, kz) planes of one kx plane (mesh tasks) */
+  fftw_plan inverse_plan_tasks;
+
+  /*! Forward transforms along x of one ky plane (mesh tasks) */
+  fftw_plan forward_plan_tasks_x;
+
+  /*! Inverse transforms along x of one ky plane (mesh tasks) */
+  fftw_plan inverse_plan_tasks_x;
+
+  /*! Transform of the density mesh in the transposed (ky, kx, kz) layout used
+   * by the mesh tasks (NULL outside of the steps computing the mesh forces) */
+  fftw_complex *frho_tasks;
+
+  /*! Same for the mesh shifted by half a cell when interlacing */
+  fftw_complex *frho2_tasks;
+
+#ifdef HAVE_FFTWF
+  /*! Forward transform of the single-precision mesh */
+  fftwf_plan forward_plan_single;
+
+  /*! Inverse transform of the single-precision mesh */
+  fftwf_plan inverse_plan_single;
+#endif
+#endif
+
+  /*! Solver for the f(R) scalar field on the mesh */
+  struct pm_multigrid multigrid;
 };
 
 void pm_mesh_init(struct pm_mesh *mesh, const struct gravity_props *props,
@@ -95,6 +220,30 @@ void pm_mesh_compute_potential(struct pm_mesh *mesh, const struct space *s,
                                struct threadpool *tp, int verbose);
 void pm_mesh_clean(struct pm_mesh *mesh);
 
+void pm_mesh_tasks_prepare(struct pm_mesh *mesh, const struct space *s,
+                           struct threadpool *tp, int verbose);
+void pm_mesh_tasks_cell_assign(const struct pm_mesh *mesh,
+                               const struct space *s, const struct cell *c);
+#ifdef WITH_MPI
+void pm_mesh_tasks_reduce_start(const struct pm_mesh *mesh, int n,
+                                MPI_Request *req);
+#endif
+void pm_mesh_tasks_r2c(const struct pm_mesh *mesh, int block);
+void pm_mesh_tasks_green(const struct pm_mesh *mesh, int block);
+void pm_mesh_tasks_c2r(const struct pm_mesh *mesh, int block);
+void pm_mesh_tasks_cell_interpolate(const struct pm_mesh *mesh,
+                                    const struct space *s,
+                                    const struct cell *c);
+void pm_mesh_tasks_clean(struct pm_mesh *mesh);
+
+void cells_gpart_to_mesh(struct threadpool *tp, double *rho, const int N,
+                         const double fac, const double dim[3],
+                         const struct cell *cells, const int *local_cells,
+                         const int nr_local_cells,
+                         const enum mesh_assignment_mode assignment,
+                         const int window_order, const double shift,
+                         struct neutrino_model *nu_model);
+
 void pm_mesh_allocate(struct pm_mesh *mesh);
 void pm_mesh_free(struct pm_mesh *mesh);
 
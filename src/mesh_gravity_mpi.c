@@ -20,6 +20,9 @@
 /* Config parameters. */
 #include <config.h>
 
+/* Standard headers. */
+#include <string.h>
+
 /* MPI headers. */
 #ifdef WITH_MPI
 #include <mpi.h>
@@ -744,7 +747,7 @@ void fill_local_patches_from_mesh_cells(
  * @param local_0_start Offset to the first mesh x coordinate on this rank
  * @param local_n0 Width of the mesh slab on this rank
  * @param potential_slice Array with the potential on the local slice of the
- * mesh
+ * mesh (padded along z as for an in-place FFTW transform)
  * @param tp The #threadpool object.
  * @param verbose Are we talkative?
  */
@@ -754,7 +757,7 @@ void mpi_mesh_fetch_potential(const int N, const double fac,
                               struct pm_mesh_patch *local_patches,
                               struct threadpool *tp, const int verbose) {
 
-#if defined(WITH_MPI) && defined(HAVE_MPI_FFTW)
+#ifdef WITH_MPI
 
   /* Determine rank, number of MPI ranks */
   int nr_nodes, nodeID;
@@ -982,7 +985,7 @@ void mpi_mesh_fetch_potential(const int N, const double fac,
   swift_free("send_cells_sorted", send_cells_sorted);
 
 #else
-  error("FFTW MPI not found - unable to use distributed mesh");
+  error("MPI not found - unable to use a slab-decomposed mesh");
 #endif
 }
 
@@ -993,7 +996,7 @@ void mpi_mesh_fetch_potential(const int N, const double fac,
  * @param gp The #gpart.
  * @param patch The local mesh patch
  */
-#if defined(WITH_MPI) && defined(HAVE_MPI_FFTW)
+#ifdef WITH_MPI
 void mesh_patch_to_gparts_CIC(struct gpart *gp,
                               const struct pm_mesh_patch *patch) {
 
@@ -1095,7 +1098,7 @@ void cell_distributed_mesh_to_gpart_CIC(const struct cell *c,
                                         const float const_G,
                                         const double dim[3]) {
 
-#if defined(WITH_MPI) && defined(HAVE_MPI_FFTW)
+#ifdef WITH_MPI
 
   const int gcount = c->grav.count;
   struct gpart *gparts = c->grav.parts;
@@ -1127,7 +1130,7 @@ void cell_distributed_mesh_to_gpart_CIC(const struct cell *c,
   }
 
 #else
-  error("FFTW MPI not found - unable to use distributed mesh");
+  error("MPI not found - unable to use a slab-decomposed mesh");
 #endif
 }
 
@@ -1155,7 +1158,7 @@ struct distributed_cic_mapper_data {
 void cell_distributed_mesh_to_gpart_CIC_mapper(void *map_data, int num,
                                                void *extra) {
 
-#if defined(WITH_MPI) && defined(HAVE_MPI_FFTW)
+#ifdef WITH_MPI
 
   /* Unpack the shared information */
   const struct distributed_cic_mapper_data *data =
@@ -1185,7 +1188,7 @@ void cell_distributed_mesh_to_gpart_CIC_mapper(void *map_data, int num,
   }
 
 #else
-  error("FFTW MPI not found - unable to use distributed mesh");
+  error("MPI not found - unable to use a slab-decomposed mesh");
 #endif
 }
 
@@ -1193,7 +1196,7 @@ void mpi_mesh_update_gparts(struct pm_mesh_patch *local_patches,
                             const struct space *s, struct threadpool *tp,
                             const int N, const double cell_fac) {
 
-#if defined(WITH_MPI) && defined(HAVE_MPI_FFTW)
+#ifdef WITH_MPI
 
   const int *local_cells = s->local_cells_top;
   const int nr_local_cells = s->nr_local_cells;
@@ -1219,6 +1222,79 @@ void mpi_mesh_update_gparts(struct pm_mesh_patch *local_patches,
                    threadpool_auto_chunk_size, (void *)&data);
   }
 #else
-  error("FFTW MPI not found - unable to use distributed mesh");
+  error("MPI not found - unable to use a slab-decomposed mesh");
+#endif
+}
+
+/**
+ * @brief Transpose the first two axes of a slab-decomposed complex mesh.
+ *
+ * On input, this rank holds the planes [slab_offset[rank], slab_offset[rank]
+ * + slab_width[rank]) along the first axis and the full second axis. On
+ * output, it holds the same range of planes along the second axis and the
+ * full first axis, with the two axes swapped in memory. Both axes use the
+ * same decomposition, so applying the function twice restores the input.
+ *
+ * The data are (N_slab x N x Nz) complex numbers stored as pairs of doubles.
+ *
+ * @param N The size of the mesh along the first two axes.
+ * @param Nz The number of complex values along the third axis.
+ * @param slab_offset The first plane stored on each rank.
+ * @param slab_width The number of planes stored on each rank.
+ * @param in The input slab (destroyed).
+ * @param out The transposed slab.
+ */
+void mpi_mesh_transpose_slabs(const int N, const int Nz,
+                              const int *slab_offset, const int *slab_width,
+                              double *in, double *out) {
+
+#ifdef WITH_MPI
+
+  int nr_nodes, nodeID;
+  MPI_Comm_size(MPI_COMM_WORLD, &nr_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD, &nodeID);
+
+  const int width = slab_width[nodeID];
+  const size_t row = 2 * (size_t)Nz;
+
+  int *counts = (int *)malloc(nr_nodes * sizeof(int));
+  int *displs = (int *)malloc(nr_nodes * sizeof(int));
+  if (counts == NULL || displs == NULL)
+    error("Failed to allocate the slab transpose counts.");
+
+  /* Pack the blocks going to each rank contiguously in the output array. The
+   * block going to rank q is (width x slab_width[q] x Nz). */
+  size_t offset = 0;
+  for (int q = 0; q < nr_nodes; ++q) {
+    counts[q] = (int)(width * slab_width[q] * row);
+    displs[q] = (int)offset;
+    for (int a = 0; a < width; ++a) {
+      const double *src = in + ((size_t)a * N + slab_offset[q]) * row;
+      memcpy(out + offset, src, slab_width[q] * row * sizeof(double));
+      offset += slab_width[q] * row;
+    }
+  }
+
+  /* The blocks we receive are symmetric to the ones we send, so the same
+   * counts apply. The input is re-used as receive buffer. */
+  MPI_Alltoallv(out, counts, displs, MPI_DOUBLE, in, counts, displs,
+                MPI_DOUBLE, MPI_COMM_WORLD);
+
+  /* Unpack: the block from rank p is (slab_width[p] x width x Nz) */
+  for (int p = 0; p < nr_nodes; ++p) {
+    const double *block = in + displs[p];
+    for (int a = 0; a < slab_width[p]; ++a) {
+      for (int b = 0; b < width; ++b) {
+        memcpy(out + ((size_t)b * N + slab_offset[p] + a) * row,
+               block + ((size_t)a * width + b) * row, row * sizeof(double));
+      }
+    }
+  }
+
+  free(displs);
+  free(counts);
+
+#else
+  error("MPI not found - unable to use a slab-decomposed mesh");
 #endif
 }
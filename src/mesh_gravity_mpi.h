@@ -53,4 +53,9 @@ void mpi_mesh_fetch_potential(const int N, const double fac,
 void mpi_mesh_update_gparts(struct pm_mesh_patch *local_patches,
                             const struct space *s, struct threadpool *tp,
                             const int N, const double cell_fac);
+
+void mpi_mesh_transpose_slabs(const int N, const int Nz,
+                              const int *slab_offset, const int *slab_width,
+                              double *in, double *out);
+
 #endif
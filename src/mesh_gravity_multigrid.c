@@ -0,0 +1,985 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/**
+ *  @file mesh_gravity_multigrid.c
+ *  @brief Multigrid solver for the chameleon f(R) scalar field on the mesh.
+ *
+ * We solve the quasi-static equation of the Hu-Sawicki (n=1) model in
+ * comoving coordinates,
+ *
+ *   nabla^2 f_R = a^2 / 3 * [dR(f_R) - 8 pi G drho / c^2],
+ *
+ * with R(f_R) = Rbar(a) * sqrt(fbar_R(a) / f_R). Writing f_R = -u^2 (Bose et
+ * al. 2017) and discretising the Laplacian of u^2 with the 7-point stencil,
+ * the equation at each cell becomes a cubic in u with a single physical
+ * (positive) root, which we use for a nonlinear red-black Gauss-Seidel
+ * smoother. The coarse grids are dealt with using the full approximation
+ * scheme (FAS).
+ */
+
+/* Config parameters. */
+#include <config.h>
+
+/* Some standard headers. */
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+/* MPI headers. */
+#ifdef WITH_MPI
+#include <mpi.h>
+#endif
+
+/* This object's header. */
+#include "mesh_gravity_multigrid.h"
+
+/* Local headers. */
+#include "align.h"
+#include "atomic.h"
+#include "clocks.h"
+#include "cosmology.h"
+#include "error.h"
+#include "gravity_properties.h"
+#include "memuse.h"
+#include "minmax.h"
+#include "physical_constants.h"
+#include "threadpool.h"
+
+/*! Number of red-black sweeps used to solve the coarsest level */
+#define PM_MULTIGRID_COARSE_SWEEPS 20
+
+/*! Smallest side-length of a multigrid level */
+#define PM_MULTIGRID_MIN_SIZE 4
+
+/**
+ * @brief Coefficients of the discretised f(R) field equation at a given
+ * scale-factor.
+ *
+ * The equation reads N(u) = (6 u^2 - sum_nb u_nb^2) / h^2 - alpha / u = s,
+ * with s = s_bg + s_delta * delta on the finest level.
+ */
+struct pm_multigrid_fR_coeffs {
+
+  /*! Background value of u = sqrt(-f_R) */
+  double u_bg;
+
+  /*! Coefficient of the 1/u term: a^2 / 3 * Rbar * u_bg */
+  double alpha;
+
+  /*! Source term of the background: -a^2 / 3 * Rbar */
+  double s_bg;
+
+  /*! Source term per unit density contrast: -H0^2 Omega_m / (a c^2) */
+  double s_delta;
+};
+
+/**
+ * @brief Compute the coefficients of the field equation.
+ *
+ * @param coeffs (return) The coefficients.
+ * @param fR0 The present-day background value of |f_R|.
+ * @param cosmo The current cosmological model.
+ * @param phys_const The physical constants in internal units.
+ */
+static void pm_multigrid_fR_coeffs_init(
+    struct pm_multigrid_fR_coeffs *coeffs, const double fR0,
+    const struct cosmology *cosmo, const struct phys_const *phys_const) {
+
+  const double a = cosmo->a;
+  const double c = phys_const->const_speed_light_c;
+  const double H0_c = cosmo->H0 / c;
+  const double Omega_m = cosmo->Omega_cdm + cosmo->Omega_b;
+  const double Omega_lambda = cosmo->Omega_lambda;
+
+  /* Background curvature today and at a (LCDM expansion) */
+  const double R0 = 3. * H0_c * H0_c * (Omega_m + 4. * Omega_lambda);
+  const double R =
+      3. * H0_c * H0_c * (Omega_m / (a * a * a) + 4. * Omega_lambda);
+
+  /* fbar_R(a) = -fR0 * (R0 / R)^2 */
+  coeffs->u_bg = sqrt(fR0) * R0 / R;
+  coeffs->alpha = a * a / 3. * R * coeffs->u_bg;
+  coeffs->s_bg = -a * a / 3. * R;
+  coeffs->s_delta = -H0_c * H0_c * Omega_m / a;
+}
+
+/**
+ * @brief Index of a cell of a level in the arrays with ghost planes.
+ *
+ * @param N The side-length of the level.
+ * @param i The local plane (-1 and slab_width are the ghost planes).
+ * @param j The index along y.
+ * @param k The index along z.
+ */
+__attribute__((always_inline, const)) INLINE static size_t pm_multigrid_index(
+    const int N, const int i, const int j, const int k) {
+  return ((size_t)(i + 1) * N + j) * N + k;
+}
+
+/**
+ * @brief Sum of the squares of the field over the 6 neighbours of a cell.
+ *
+ * @param u The field (with ghost planes).
+ * @param N The side-length of the level.
+ * @param i The local plane.
+ * @param j The index along y.
+ * @param k The index along z.
+ */
+__attribute__((always_inline)) INLINE static double pm_multigrid_nb_sum(
+    const double *u, const int N, const int i, const int j, const int k) {
+
+  const int jm = (j == 0) ? N - 1 : j - 1;
+  const int jp = (j == N - 1) ? 0 : j + 1;
+  const int km = (k == 0) ? N - 1 : k - 1;
+  const int kp = (k == N - 1) ? 0 : k + 1;
+
+  const double u_xm = u[pm_multigrid_index(N, i - 1, j, k)];
+  const double u_xp = u[pm_multigrid_index(N, i + 1, j, k)];
+  const double u_ym = u[pm_multigrid_index(N, i, jm, k)];
+  const double u_yp = u[pm_multigrid_index(N, i, jp, k)];
+  const double u_zm = u[pm_multigrid_index(N, i, j, km)];
+  const double u_zp = u[pm_multigrid_index(N, i, j, kp)];
+
+  return u_xm * u_xm + u_xp * u_xp + u_ym * u_ym + u_yp * u_yp +
+         u_zm * u_zm + u_zp * u_zp;
+}
+
+/**
+ * @brief Apply the discretised nonlinear operator at a cell.
+ *
+ * @param u The field (with ghost planes).
+ * @param N The side-length of the level.
+ * @param i The local plane.
+ * @param j The index along y.
+ * @param k The index along z.
+ * @param h2_inv The inverse of the square of the cell size.
+ * @param alpha The coefficient of the 1/u term.
+ */
+__attribute__((always_inline)) INLINE static double pm_multigrid_operator(
+    const double *u, const int N, const int i, const int j, const int k,
+    const double h2_inv, const double alpha) {
+
+  const double u_c = u[pm_multigrid_index(N, i, j, k)];
+  return (6. * u_c * u_c - pm_multigrid_nb_sum(u, N, i, j, k)) * h2_inv -
+         alpha / u_c;
+}
+
+/**
+ * @brief Returns the largest real root of u^3 + P u + Q = 0 for Q < 0.
+ *
+ * This root is always positive. The expressions are chosen to avoid any
+ * cancellation in the strongly screened regime (P >> |Q|^(2/3)).
+ *
+ * @param P The linear coefficient.
+ * @param Q The constant coefficient (negative).
+ */
+__attribute__((always_inline, const)) INLINE static double
+pm_multigrid_cubic_root(const double P, const double Q) {
+
+  const double D = 0.25 * Q * Q + P * P * P * (1. / 27.);
+
+  if (D > 0.) {
+
+    /* One real root: u = A + B with A = cbrt(-Q/2 + sqrt(D)), AB = -P/3 */
+    const double A = cbrt(-0.5 * Q + sqrt(D));
+    if (P >= 0.)
+      return -Q / (A * A + P * (1. / 3.) + P * P / (9. * A * A));
+    else
+      return A - P / (3. * A);
+
+  } else {
+
+    /* Three real roots (P < 0): take the largest one */
+    const double m = sqrt(-P * (1. / 3.));
+    double arg = 1.5 * Q / (P * m);
+    arg = (arg > 1.) ? 1. : ((arg < -1.) ? -1. : arg);
+    return 2. * m * cos(acos(arg) * (1. / 3.));
+  }
+}
+
+/**
+ * @brief Shared information for the threadpool mappers of the solver.
+ */
+struct pm_multigrid_mapper_data {
+
+  /*! The level we operate on (the fine level for inter-level operations) */
+  const struct pm_multigrid_level *level;
+
+  /*! The coarse level for inter-level operations */
+  const struct pm_multigrid_level *coarse;
+
+  /*! Start of the first owned plane of the array the threadpool maps over */
+  const double *base;
+
+  /*! Coefficient of the 1/u term */
+  double alpha;
+
+  /*! Smallest allowed value of u */
+  double u_min;
+
+  /*! Colour of the cells to update in a red-black sweep */
+  int colour;
+
+  /*! Accumulator for reductions */
+  double sum;
+};
+
+/**
+ * @brief Mapper updating one colour of a level with nonlinear Gauss-Seidel.
+ *
+ * @param map_data The first plane to update.
+ * @param num The number of planes to update.
+ * @param extra The #pm_multigrid_mapper_data.
+ */
+static void pm_multigrid_smooth_mapper(void *map_data, int num, void *extra) {
+
+  const struct pm_multigrid_mapper_data *data =
+      (const struct pm_multigrid_mapper_data *)extra;
+  const struct pm_multigrid_level *L = data->level;
+  const int N = L->N;
+  const double h2 = L->h2;
+  const double Q = -data->alpha * h2 * (1. / 6.);
+  double *restrict u = L->u;
+  const double *restrict s = L->s;
+
+  const int i_start = ((const double *)map_data - data->base) / (N * N);
+  const int i_end = i_start + num;
+
+  for (int i = i_start; i < i_end; ++i) {
+    const int i_global = L->slab_start + i;
+    for (int j = 0; j < N; ++j) {
+      const int k_start = (data->colour + i_global + j) & 1;
+      for (int k = k_start; k < N; k += 2) {
+        const double nb_sum = pm_multigrid_nb_sum(u, N, i, j, k);
+        const double s_c = s[((size_t)i * N + j) * N + k];
+        const double P = -(nb_sum + s_c * h2) * (1. / 6.);
+        u[pm_multigrid_index(N, i, j, k)] = pm_multigrid_cubic_root(P, Q);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Mapper accumulating the sum of the squared residuals of a level.
+ *
+ * @param map_data The first plane to consider.
+ * @param num The number of planes to consider.
+ * @param extra The #pm_multigrid_mapper_data.
+ */
+static void pm_multigrid_residual_mapper(void *map_data, int num,
+                                         void *extra) {
+
+  struct pm_multigrid_mapper_data *data =
+      (struct pm_multigrid_mapper_data *)extra;
+  const struct pm_multigrid_level *L = data->level;
+  const int N = L->N;
+  const double h2_inv = 1. / L->h2;
+
+  const int i_start = ((const double *)map_data - data->base) / (N * N);
+  const int i_end = i_start + num;
+
+  double sum = 0.;
+  for (int i = i_start; i < i_end; ++i) {
+    for (int j = 0; j < N; ++j) {
+      for (int k = 0; k < N; ++k) {
+        const double r =
+            L->s[((size_t)i * N + j) * N + k] -
+            pm_multigrid_operator(L->u, N, i, j, k, h2_inv, data->alpha);
+        sum += r * r;
+      }
+    }
+  }
+
+  atomic_add_d(&data->sum, sum);
+}
+
+/**
+ * @brief Mapper restricting the field and the residual of a level onto the
+ * next coarser one by averaging the 8 children of each coarse cell.
+ *
+ * The coarse source term is set to the restricted residual; the coarse
+ * operator is added once the ghost planes of the coarse field are known.
+ *
+ * @param map_data The first coarse plane to fill.
+ * @param num The number of coarse planes to fill.
+ * @param extra The #pm_multigrid_mapper_data.
+ */
+static void pm_multigrid_restrict_mapper(void *map_data, int num,
+                                         void *extra) {
+
+  const struct pm_multigrid_mapper_data *data =
+      (const struct pm_multigrid_mapper_data *)extra;
+  const struct pm_multigrid_level *F = data->level;
+  const struct pm_multigrid_level *C = data->coarse;
+  const int N_f = F->N;
+  const int N_c = C->N;
+  const double h2_inv = 1. / F->h2;
+
+  const int I_start = ((const double *)map_data - data->base) / (N_c * N_c);
+  const int I_end = I_start + num;
+
+  for (int I = I_start; I < I_end; ++I) {
+    for (int J = 0; J < N_c; ++J) {
+      for (int K = 0; K < N_c; ++K) {
+
+        double u_sum = 0., r_sum = 0.;
+        for (int di = 0; di < 2; ++di) {
+          for (int dj = 0; dj < 2; ++dj) {
+            for (int dk = 0; dk < 2; ++dk) {
+              const int i = 2 * I + di, j = 2 * J + dj, k = 2 * K + dk;
+              u_sum += F->u[pm_multigrid_index(N_f, i, j, k)];
+              r_sum += F->s[((size_t)i * N_f + j) * N_f + k] -
+                       pm_multigrid_operator(F->u, N_f, i, j, k, h2_inv,
+                                             data->alpha);
+            }
+          }
+        }
+
+        C->u[pm_multigrid_index(N_c, I, J, K)] = 0.125 * u_sum;
+        C->s[((size_t)I * N_c + J) * N_c + K] = 0.125 * r_sum;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Mapper completing the coarse source term (FAS) and saving a copy
+ * of the restricted field.
+ *
+ * @param map_data The first coarse plane to consider.
+ * @param num The number of coarse planes to consider.
+ * @param extra The #pm_multigrid_mapper_data.
+ */
+static void pm_multigrid_coarse_source_mapper(void *map_data, int num,
+                                              void *extra) {
+
+  const struct pm_multigrid_mapper_data *data =
+      (const struct pm_multigrid_mapper_data *)extra;
+  const struct pm_multigrid_level *C = data->level;
+  const int N = C->N;
+  const double h2_inv = 1. / C->h2;
+
+  const int i_start = ((const double *)map_data - data->base) / (N * N);
+  const int i_end = i_start + num;
+
+  for (int i = i_start; i < i_end; ++i) {
+    for (int j = 0; j < N; ++j) {
+      for (int k = 0; k < N; ++k) {
+        const size_t index = pm_multigrid_index(N, i, j, k);
+        C->s[((size_t)i * N + j) * N + k] +=
+            pm_multigrid_operator(C->u, N, i, j, k, h2_inv, data->alpha);
+        C->u0[index] = C->u[index];
+      }
+    }
+  }
+}
+
+/**
+ * @brief Mapper turning the saved restricted field of a coarse level into
+ * the coarse-grid correction.
+ *
+ * @param map_data The first coarse plane to consider.
+ * @param num The number of coarse planes to consider.
+ * @param extra The #pm_multigrid_mapper_data.
+ */
+static void pm_multigrid_correction_mapper(void *map_data, int num,
+                                           void *extra) {
+
+  const struct pm_multigrid_mapper_data *data =
+      (const struct pm_multigrid_mapper_data *)extra;
+  const struct pm_multigrid_level *C = data->level;
+  const int N = C->N;
+
+  const int i_start = ((const double *)map_data - data->base) / (N * N);
+  const size_t first = pm_multigrid_index(N, i_start, 0, 0);
+  const size_t last = pm_multigrid_index(N, i_start + num, 0, 0);
+
+  for (size_t index = first; index < last; ++index)
+    C->u0[index] = C->u[index] - C->u0[index];
+}
+
+/**
+ * @brief Mapper adding the trilinearly interpolated coarse-grid correction
+ * to a level.
+ *
+ * @param map_data The first fine plane to update.
+ * @param num The number of fine planes to update.
+ * @param extra The #pm_multigrid_mapper_data.
+ */
+static void pm_multigrid_prolong_mapper(void *map_data, int num, void *extra) {
+
+  const struct pm_multigrid_mapper_data *data =
+      (const struct pm_multigrid_mapper_data *)extra;
+  const struct pm_multigrid_level *F = data->level;
+  const struct pm_multigrid_level *C = data->coarse;
+  const int N_f = F->N;
+  const int N_c = C->N;
+  const double *restrict e = C->u0;
+
+  const int i_start = ((const double *)map_data - data->base) / (N_f * N_f);
+  const int i_end = i_start + num;
+
+  for (int i = i_start; i < i_end; ++i) {
+
+    /* Parent plane and nearest other coarse plane (possibly a ghost) */
+    const int I = i >> 1;
+    const int I_nb = (i & 1) ? I + 1 : I - 1;
+
+    for (int j = 0; j < N_f; ++j) {
+      const int J = j >> 1;
+      const int J_nb = (j & 1) ? (J + 1) % N_c : (J + N_c - 1) % N_c;
+
+      for (int k = 0; k < N_f; ++k) {
+        const int K = k >> 1;
+        const int K_nb = (k & 1) ? (K + 1) % N_c : (K + N_c - 1) % N_c;
+
+        /* Cell-centred trilinear weights are 3/4 and 1/4 along each axis */
+        const double e_x0 = 0.75 * e[pm_multigrid_index(N_c, I, J, K)] +
+                            0.25 * e[pm_multigrid_index(N_c, I, J, K_nb)];
+        const double e_x1 = 0.75 * e[pm_multigrid_index(N_c, I, J_nb, K)] +
+                            0.25 * e[pm_multigrid_index(N_c, I, J_nb, K_nb)];
+        const double e_x2 = 0.75 * e[pm_multigrid_index(N_c, I_nb, J, K)] +
+                            0.25 * e[pm_multigrid_index(N_c, I_nb, J, K_nb)];
+        const double e_x3 =
+            0.75 * e[pm_multigrid_index(N_c, I_nb, J_nb, K)] +
+            0.25 * e[pm_multigrid_index(N_c, I_nb, J_nb, K_nb)];
+        const double corr = 0.75 * (0.75 * e_x0 + 0.25 * e_x1) +
+                            0.25 * (0.75 * e_x2 + 0.25 * e_x3);
+
+        double *u = &F->u[pm_multigrid_index(N_f, i, j, k)];
+        *u += corr;
+        if (*u < data->u_min) *u = data->u_min;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Fill the ghost planes of a field of a level.
+ *
+ * @param mg The #pm_multigrid.
+ * @param L The level.
+ * @param field The field (with ghost planes).
+ */
+static void pm_multigrid_exchange(const struct pm_multigrid *mg,
+                                  const struct pm_multigrid_level *L,
+                                  double *field) {
+
+  const int width = L->slab_width;
+  if (width == 0) return;
+
+  const size_t plane = (size_t)L->N * L->N;
+  double *ghost_left = field;
+  double *first = field + plane;
+  double *last = field + width * plane;
+  double *ghost_right = field + (width + 1) * plane;
+
+#ifdef WITH_MPI
+  int rank = 0;
+  if (mg->use_mpi) MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  if (mg->use_mpi && mg->rank_left != rank) {
+    MPI_Sendrecv(last, (int)plane, MPI_DOUBLE, mg->rank_right, 0, ghost_left,
+                 (int)plane, MPI_DOUBLE, mg->rank_left, 0, MPI_COMM_WORLD,
+                 MPI_STATUS_IGNORE);
+    MPI_Sendrecv(first, (int)plane, MPI_DOUBLE, mg->rank_left, 1,
+                 ghost_right, (int)plane, MPI_DOUBLE, mg->rank_right, 1,
+                 MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    return;
+  }
+#endif
+
+  /* Periodic wrap of our own slab */
+  memcpy(ghost_left, last, plane * sizeof(double));
+  memcpy(ghost_right, first, plane * sizeof(double));
+}
+
+/**
+ * @brief Sum a value over all the ranks sharing the grid.
+ *
+ * @param mg The #pm_multigrid.
+ * @param value The local value.
+ */
+static double pm_multigrid_sum(const struct pm_multigrid *mg,
+                               const double value) {
+
+  double sum = value;
+#ifdef WITH_MPI
+  if (mg->use_mpi)
+    MPI_Allreduce(&value, &sum, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+#endif
+  return sum;
+}
+
+/**
+ * @brief Perform red-black Gauss-Seidel sweeps on a level.
+ *
+ * @param mg The #pm_multigrid.
+ * @param L The level.
+ * @param alpha The coefficient of the 1/u term.
+ * @param nr_sweeps The number of sweeps.
+ * @param tp The #threadpool.
+ */
+static void pm_multigrid_smooth(const struct pm_multigrid *mg,
+                                const struct pm_multigrid_level *L,
+                                const double alpha, const int nr_sweeps,
+                                struct threadpool *tp) {
+
+  const size_t plane = (size_t)L->N * L->N;
+
+  struct pm_multigrid_mapper_data data;
+  bzero(&data, sizeof(struct pm_multigrid_mapper_data));
+  data.level = L;
+  data.alpha = alpha;
+  data.base = L->u + plane;
+
+  for (int n = 0; n < nr_sweeps; ++n) {
+    for (int colour = 0; colour < 2; ++colour) {
+      pm_multigrid_exchange(mg, L, L->u);
+      data.colour = colour;
+      if (L->slab_width > 0)
+        threadpool_map(tp, pm_multigrid_smooth_mapper, L->u + plane,
+                       L->slab_width, plane * sizeof(double),
+                       threadpool_auto_chunk_size, &data);
+    }
+  }
+}
+
+/**
+ * @brief Compute the rms residual of the finest level.
+ *
+ * @param mg The #pm_multigrid.
+ * @param alpha The coefficient of the 1/u term.
+ * @param tp The #threadpool.
+ */
+static double pm_multigrid_residual(const struct pm_multigrid *mg,
+                                    const double alpha,
+                                    struct threadpool *tp) {
+
+  const struct pm_multigrid_level *L = &mg->levels[0];
+  const size_t plane = (size_t)L->N * L->N;
+
+  pm_multigrid_exchange(mg, L, L->u);
+
+  struct pm_multigrid_mapper_data data;
+  bzero(&data, sizeof(struct pm_multigrid_mapper_data));
+  data.level = L;
+  data.alpha = alpha;
+  data.base = L->u + plane;
+  data.sum = 0.;
+
+  if (L->slab_width > 0)
+    threadpool_map(tp, pm_multigrid_residual_mapper, L->u + plane,
+                   L->slab_width, plane * sizeof(double),
+                   threadpool_auto_chunk_size, &data);
+
+  const double sum = pm_multigrid_sum(mg, data.sum);
+  return sqrt(sum / ((double)L->N * L->N * L->N));
+}
+
+/**
+ * @brief Perform one FAS V-cycle starting at a given level.
+ *
+ * @param mg The #pm_multigrid.
+ * @param l The level to start at.
+ * @param alpha The coefficient of the 1/u term.
+ * @param u_min The smallest allowed value of u.
+ * @param tp The #threadpool.
+ */
+static void pm_multigrid_vcycle(struct pm_multigrid *mg, const int l,
+                                const double alpha, const double u_min,
+                                struct threadpool *tp) {
+
+  struct pm_multigrid_level *F = &mg->levels[l];
+
+  /* Coarsest level: just smooth a lot */
+  if (l == mg->nr_levels - 1) {
+    pm_multigrid_smooth(mg, F, alpha, PM_MULTIGRID_COARSE_SWEEPS, tp);
+    return;
+  }
+
+  struct pm_multigrid_level *C = &mg->levels[l + 1];
+  const size_t plane_f = (size_t)F->N * F->N;
+  const size_t plane_c = (size_t)C->N * C->N;
+
+  struct pm_multigrid_mapper_data data;
+  bzero(&data, sizeof(struct pm_multigrid_mapper_data));
+  data.alpha = alpha;
+  data.u_min = u_min;
+
+  /* Pre-smoothing */
+  pm_multigrid_smooth(mg, F, alpha, mg->nr_smoothing, tp);
+
+  /* Restrict the field and the residual */
+  pm_multigrid_exchange(mg, F, F->u);
+  data.level = F;
+  data.coarse = C;
+  data.base = C->u + plane_c;
+  if (C->slab_width > 0)
+    threadpool_map(tp, pm_multigrid_restrict_mapper, C->u + plane_c,
+                   C->slab_width, plane_c * sizeof(double),
+                   threadpool_auto_chunk_size, &data);
+
+  /* Coarse source term s_c = N_c(R u) + R r */
+  pm_multigrid_exchange(mg, C, C->u);
+  data.level = C;
+  data.coarse = NULL;
+  if (C->slab_width > 0)
+    threadpool_map(tp, pm_multigrid_coarse_source_mapper, C->u + plane_c,
+                   C->slab_width, plane_c * sizeof(double),
+                   threadpool_auto_chunk_size, &data);
+
+  /* Solve on the coarse level */
+  pm_multigrid_vcycle(mg, l + 1, alpha, u_min, tp);
+
+  /* Coarse-grid correction */
+  if (C->slab_width > 0)
+    threadpool_map(tp, pm_multigrid_correction_mapper, C->u + plane_c,
+                   C->slab_width, plane_c * sizeof(double),
+                   threadpool_auto_chunk_size, &data);
+  pm_multigrid_exchange(mg, C, C->u0);
+
+  data.level = F;
+  data.coarse = C;
+  data.base = F->u + plane_f;
+  if (F->slab_width > 0)
+    threadpool_map(tp, pm_multigrid_prolong_mapper, F->u + plane_f,
+                   F->slab_width, plane_f * sizeof(double),
+                   threadpool_auto_chunk_size, &data);
+
+  /* Post-smoothing */
+  pm_multigrid_smooth(mg, F, alpha, mg->nr_smoothing, tp);
+}
+
+/**
+ * @brief Initialise the parameters of a #pm_multigrid.
+ *
+ * The grids themselves are only allocated on first use, once the slab
+ * decomposition of the mesh is known.
+ *
+ * @param mg The #pm_multigrid.
+ * @param props The properties of the gravity scheme.
+ */
+void pm_multigrid_init(struct pm_multigrid *mg,
+                       const struct gravity_props *props) {
+
+  bzero(mg, sizeof(struct pm_multigrid));
+
+  mg->active = props->mesh_fR_solver;
+  mg->fR0 = props->mesh_fR0;
+  mg->tolerance = props->mesh_multigrid_tolerance;
+  mg->max_vcycles = props->mesh_multigrid_max_vcycles;
+  mg->nr_smoothing = props->mesh_multigrid_smoothing_steps;
+  mg->max_levels = min(props->mesh_multigrid_max_levels,
+                       PM_MULTIGRID_MAX_LEVELS);
+}
+
+/**
+ * @brief Allocate the multigrid hierarchy for a given slab of the mesh.
+ *
+ * Levels are added for as long as the grid can be halved and all the slab
+ * boundaries remain aligned with the coarse cells. With use_mpi, this is a
+ * collective operation over MPI_COMM_WORLD.
+ *
+ * @param mg The #pm_multigrid.
+ * @param N The side-length of the finest grid.
+ * @param slab_start The first plane stored on this rank.
+ * @param slab_width The number of planes stored on this rank.
+ * @param box_size The (comoving) side-length of the box.
+ * @param use_mpi Is the grid distributed over the MPI ranks?
+ */
+void pm_multigrid_allocate(struct pm_multigrid *mg, const int N,
+                           const int slab_start, const int slab_width,
+                           const double box_size, const int use_mpi) {
+
+  pm_multigrid_clean(mg);
+
+  mg->use_mpi = use_mpi;
+  mg->rank_left = 0;
+  mg->rank_right = 0;
+
+  /* Gather the slab decomposition of all the ranks */
+  int nr_ranks = 1, rank = 0;
+  int *starts = NULL, *widths = NULL;
+#ifdef WITH_MPI
+  if (use_mpi) {
+    MPI_Comm_size(MPI_COMM_WORLD, &nr_ranks);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  }
+#endif
+  starts = (int *)malloc(nr_ranks * sizeof(int));
+  widths = (int *)malloc(nr_ranks * sizeof(int));
+  if (starts == NULL || widths == NULL)
+    error("Failed to allocate slab decomposition arrays");
+  starts[0] = slab_start;
+  widths[0] = slab_width;
+#ifdef WITH_MPI
+  if (use_mpi) {
+    MPI_Allgather(&slab_start, 1, MPI_INT, starts, 1, MPI_INT,
+                  MPI_COMM_WORLD);
+    MPI_Allgather(&slab_width, 1, MPI_INT, widths, 1, MPI_INT,
+                  MPI_COMM_WORLD);
+  }
+#endif
+
+  /* Find the ranks holding the planes just before and after ours */
+  mg->rank_left = rank;
+  mg->rank_right = rank;
+  for (int r = 0; r < nr_ranks; ++r) {
+    if (widths[r] == 0) continue;
+    if ((starts[r] + widths[r]) % N == slab_start) mg->rank_left = r;
+    if (starts[r] == (slab_start + slab_width) % N) mg->rank_right = r;
+  }
+
+  /* How many levels can we build? */
+  int nr_levels = 1;
+  while (nr_levels < mg->max_levels) {
+    const int factor = 1 << nr_levels;
+    if (N % factor != 0 || N / factor < PM_MULTIGRID_MIN_SIZE) break;
+    int aligned = 1;
+    for (int r = 0; r < nr_ranks; ++r)
+      if (starts[r] % factor != 0 || widths[r] % factor != 0) aligned = 0;
+    if (!aligned) break;
+    nr_levels++;
+  }
+  free(starts);
+  free(widths);
+
+  mg->nr_levels = nr_levels;
+  for (int l = 0; l < nr_levels; ++l) {
+    struct pm_multigrid_level *L = &mg->levels[l];
+    L->N = N >> l;
+    L->slab_start = slab_start >> l;
+    L->slab_width = slab_width >> l;
+    const double h = box_size / L->N;
+    L->h2 = h * h;
+    L->u = NULL;
+    L->s = NULL;
+    L->u0 = NULL;
+
+    if (L->slab_width == 0) continue;
+
+    const size_t plane = (size_t)L->N * L->N;
+    const size_t size = L->slab_width * plane;
+    const size_t size_ghosts = (L->slab_width + 2) * plane;
+
+    if (swift_memalign("mesh.multigrid", (void **)&L->u,
+                       SWIFT_STRUCT_ALIGNMENT,
+                       size_ghosts * sizeof(double)) != 0 ||
+        swift_memalign("mesh.multigrid", (void **)&L->s,
+                       SWIFT_STRUCT_ALIGNMENT, size * sizeof(double)) != 0)
+      error("Failed to allocate the multigrid level %d", l);
+
+    if (l > 0 && swift_memalign("mesh.multigrid", (void **)&L->u0,
+                                SWIFT_STRUCT_ALIGNMENT,
+                                size_ghosts * sizeof(double)) != 0)
+      error("Failed to allocate the multigrid level %d", l);
+  }
+
+  mg->u_bg_last = 0.;
+}
+
+/**
+ * @brief Solve the f(R) field equation for the density of the mesh.
+ *
+ * The solution of the previous call, rescaled to the new background, is
+ * used as the initial guess such that only a few V-cycles are needed when
+ * the density field evolves slowly.
+ *
+ * @param mg The (allocated) #pm_multigrid.
+ * @param rho The mass in each cell of the local slab of the mesh, stored
+ * row-major with stride_z elements between consecutive rows along z.
+ * @param stride_z The distance between consecutive rows along z (N for an
+ * unpadded mesh).
+ * @param cosmo The current cosmological model.
+ * @param phys_const The physical constants in internal units.
+ * @param tp The #threadpool.
+ * @param verbose Are we talkative?
+ */
+void pm_multigrid_solve_fR(struct pm_multigrid *mg, const double *rho,
+                           const int stride_z, const struct cosmology *cosmo,
+                           const struct phys_const *phys_const,
+                           struct threadpool *tp, const int verbose) {
+
+  const ticks tic = getticks();
+
+  if (mg->nr_levels == 0) error("Multigrid solver used before allocation");
+
+  struct pm_multigrid_level *L = &mg->levels[0];
+  const int N = L->N;
+  const int width = L->slab_width;
+  const double nr_cells = (double)N * N * N;
+
+  struct pm_multigrid_fR_coeffs coeffs;
+  pm_multigrid_fR_coeffs_init(&coeffs, mg->fR0, cosmo, phys_const);
+
+  /* Mean mass per cell */
+  double mass = 0.;
+  for (int i = 0; i < width; ++i)
+    for (int j = 0; j < N; ++j)
+      for (int k = 0; k < N; ++k)
+        mass += rho[((size_t)i * N + j) * stride_z + k];
+  const double mean_mass = pm_multigrid_sum(mg, mass) / nr_cells;
+  if (mean_mass <= 0.) error("Empty mesh given to the f(R) solver");
+
+  /* Source term and its rms fluctuation */
+  double delta2 = 0.;
+  for (int i = 0; i < width; ++i) {
+    for (int j = 0; j < N; ++j) {
+      for (int k = 0; k < N; ++k) {
+        const double delta =
+            rho[((size_t)i * N + j) * stride_z + k] / mean_mass - 1.;
+        L->s[((size_t)i * N + j) * N + k] =
+            coeffs.s_bg + coeffs.s_delta * delta;
+        delta2 += delta * delta;
+      }
+    }
+  }
+  const double delta_rms = sqrt(pm_multigrid_sum(mg, delta2) / nr_cells);
+
+  /* Initial guess: warm-start from the last solution if we have one */
+  const size_t plane = (size_t)N * N;
+  double *u = L->u + plane;
+  if (mg->u_bg_last > 0.) {
+    const double rescale = coeffs.u_bg / mg->u_bg_last;
+    for (size_t n = 0; n < width * plane; ++n) u[n] *= rescale;
+  } else {
+    for (size_t n = 0; n < width * plane; ++n) u[n] = coeffs.u_bg;
+  }
+
+  /* Residual we aim for */
+  const double res_ref = max(fabs(coeffs.s_delta) * delta_rms,
+                             1e-12 * fabs(coeffs.s_bg));
+  const double u_min = 1e-10 * coeffs.u_bg;
+
+  /* Iterate */
+  int nr_vcycles = 0;
+  double res = pm_multigrid_residual(mg, coeffs.alpha, tp);
+  while (res > mg->tolerance * res_ref && nr_vcycles < mg->max_vcycles) {
+    pm_multigrid_vcycle(mg, 0, coeffs.alpha, u_min, tp);
+    res = pm_multigrid_residual(mg, coeffs.alpha, tp);
+    nr_vcycles++;
+  }
+
+  mg->u_bg_last = coeffs.u_bg;
+  mg->nr_vcycles_last = nr_vcycles;
+  mg->residual_last = res / res_ref;
+
+  if (mg->residual_last > mg->tolerance)
+    message(
+        "WARNING: f(R) solver did not converge after %d V-cycles (relative "
+        "residual %e).",
+        nr_vcycles, mg->residual_last);
+
+  if (verbose)
+    message(
+        "Solving the f(R) field took %.3f %s (%d V-cycles, %d levels, "
+        "relative residual %e).",
+        clocks_from_ticks(getticks() - tic), clocks_getunit(), nr_vcycles,
+        mg->nr_levels, mg->residual_last);
+}
+
+/**
+ * @brief Add the potential of the f(R) fifth force to the mesh potential.
+ *
+ * The dynamical potential is Phi = Phi_N - c^2 / 2 * delta f_R. In the
+ * comoving units of the mesh, where the potential is later multiplied by G,
+ * this is a * c^2 / (2 G) * (u^2 - u_bg^2).
+ *
+ * @param mg The #pm_multigrid, after a call to pm_multigrid_solve_fR().
+ * @param pot The potential of the local slab of the mesh (same layout as
+ * the density given to pm_multigrid_solve_fR()).
+ * @param stride_z The distance between consecutive rows along z.
+ * @param cosmo The current cosmological model.
+ * @param phys_const The physical constants in internal units.
+ */
+void pm_multigrid_add_fifth_force_potential(
+    const struct pm_multigrid *mg, double *pot, const int stride_z,
+    const struct cosmology *cosmo, const struct phys_const *phys_const) {
+
+  const struct pm_multigrid_level *L = &mg->levels[0];
+  const int N = L->N;
+  const double c = phys_const->const_speed_light_c;
+  const double fac = 0.5 * cosmo->a * c * c / phys_const->const_newton_G;
+  const double u_bg2 = mg->u_bg_last * mg->u_bg_last;
+
+  for (int i = 0; i < L->slab_width; ++i) {
+    for (int j = 0; j < N; ++j) {
+      for (int k = 0; k < N; ++k) {
+        const double u = L->u[pm_multigrid_index(N, i, j, k)];
+        pot[((size_t)i * N + j) * stride_z + k] += fac * (u * u - u_bg2);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Returns the value of f_R in a cell of the local slab.
+ *
+ * @param mg The #pm_multigrid, after a call to pm_multigrid_solve_fR().
+ * @param i The local plane.
+ * @param j The index along y.
+ * @param k The index along z.
+ */
+double pm_multigrid_get_fR(const struct pm_multigrid *mg, const int i,
+                           const int j, const int k) {
+
+  const struct pm_multigrid_level *L = &mg->levels[0];
+  const double u = L->u[pm_multigrid_index(L->N, i, j, k)];
+  return -u * u;
+}
+
+/**
+ * @brief Free the memory allocated by a #pm_multigrid.
+ *
+ * @param mg The #pm_multigrid.
+ */
+void pm_multigrid_clean(struct pm_multigrid *mg) {
+
+  for (int l = 0; l < mg->nr_levels; ++l) {
+    struct pm_multigrid_level *L = &mg->levels[l];
+    if (L->u != NULL) swift_free("mesh.multigrid", L->u);
+    if (L->s != NULL) swift_free("mesh.multigrid", L->s);
+    if (L->u0 != NULL) swift_free("mesh.multigrid", L->u0);
+    L->u = NULL;
+    L->s = NULL;
+    L->u0 = NULL;
+  }
+  mg->nr_levels = 0;
+  mg->u_bg_last = 0.;
+}
+
+/**
+ * @brief Reset a #pm_multigrid restored as part of its parent #pm_mesh.
+ *
+ * The grids are not part of the restart files; they are re-allocated on
+ * first use and the first solve starts from the background.
+ *
+ * @param mg The #pm_multigrid.
+ */
+void pm_multigrid_struct_restore(struct pm_multigrid *mg) {
+
+  for (int l = 0; l < PM_MULTIGRID_MAX_LEVELS; ++l) {
+    mg->levels[l].u = NULL;
+    mg->levels[l].s = NULL;
+    mg->levels[l].u0 = NULL;
+  }
+  mg->nr_levels = 0;
+  mg->u_bg_last = 0.;
+}
@@ -0,0 +1,139 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_MESH_GRAVITY_MULTIGRID_H
+#define SWIFT_MESH_GRAVITY_MULTIGRID_H
+
+/* Config parameters. */
+#include <config.h>
+
+/* Some standard headers. */
+#include <stdio.h>
+
+/* Forward declarations */
+struct cosmology;
+struct gravity_props;
+struct phys_const;
+struct threadpool;
+
+/*! Maximal number of levels of the multigrid hierarchy */
+#define PM_MULTIGRID_MAX_LEVELS 16
+
+/**
+ * @brief One level of the multigrid hierarchy.
+ *
+ * Each rank stores the planes [slab_start, slab_start + slab_width[ along
+ * the x-axis of a periodic N^3 cell-centred grid. The field u has one ghost
+ * plane on either side.
+ */
+struct pm_multigrid_level {
+
+  /*! Side-length of the grid */
+  int N;
+
+  /*! First plane stored on this rank */
+  int slab_start;
+
+  /*! Number of planes stored on this rank */
+  int slab_width;
+
+  /*! Square of the cell size */
+  double h2;
+
+  /*! The field (with ghost planes) */
+  double *u;
+
+  /*! The right-hand side of the equation */
+  double *s;
+
+  /*! Restricted field before the coarse-grid solve, then the coarse-grid
+   * correction (with ghost planes, coarse levels only) */
+  double *u0;
+};
+
+/**
+ * @brief Nonlinear multigrid solver for the scalar field of chameleon f(R)
+ * gravity on the PM mesh.
+ *
+ * Solves the quasi-static field equation of the Hu-Sawicki (n=1) model for
+ * u = sqrt(-f_R) using FAS V-cycles with red-black Gauss-Seidel smoothing
+ * (the local equation being an exactly solvable cubic). The finest level
+ * matches the PM mesh and may be decomposed in slabs between the MPI ranks.
+ */
+struct pm_multigrid {
+
+  /*! Is the solver in use? */
+  int active;
+
+  /*! Present-day value of |f_R| of the background */
+  double fR0;
+
+  /*! Rms residual at which to stop relative to the rms source term */
+  double tolerance;
+
+  /*! Maximal number of V-cycles per solve */
+  int max_vcycles;
+
+  /*! Number of red-black sweeps before and after each coarse correction */
+  int nr_smoothing;
+
+  /*! Maximal number of levels to use */
+  int max_levels;
+
+  /*! Do we exchange ghost planes and reduce norms over MPI? */
+  int use_mpi;
+
+  /*! Neighbouring ranks holding the planes before and after ours */
+  int rank_left, rank_right;
+
+  /*! Number of levels allocated (0 if not allocated yet) */
+  int nr_levels;
+
+  /*! The levels, finest first */
+  struct pm_multigrid_level levels[PM_MULTIGRID_MAX_LEVELS];
+
+  /*! Background value of u the current solution was computed for (0 if
+   * there is no solution to warm-start from) */
+  double u_bg_last;
+
+  /*! Number of V-cycles used by the last solve */
+  int nr_vcycles_last;
+
+  /*! Relative rms residual reached by the last solve */
+  double residual_last;
+};
+
+void pm_multigrid_init(struct pm_multigrid *mg,
+                       const struct gravity_props *props);
+void pm_multigrid_allocate(struct pm_multigrid *mg, const int N,
+                           const int slab_start, const int slab_width,
+                           const double box_size, const int use_mpi);
+void pm_multigrid_solve_fR(struct pm_multigrid *mg, const double *rho,
+                           const int stride_z, const struct cosmology *cosmo,
+                           const struct phys_const *phys_const,
+                           struct threadpool *tp, const int verbose);
+void pm_multigrid_add_fifth_force_potential(
+    const struct pm_multigrid *mg, double *pot, const int stride_z,
+    const struct cosmology *cosmo, const struct phys_const *phys_const);
+double pm_multigrid_get_fR(const struct pm_multigrid *mg, const int i,
+                           const int j, const int k);
+void pm_multigrid_clean(struct pm_multigrid *mg);
+
+/* Dump/restore. */
+void pm_multigrid_struct_restore(struct pm_multigrid *mg);
+
+#endif /* SWIFT_MESH_GRAVITY_MULTIGRID_H */
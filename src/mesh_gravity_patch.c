@@ -22,6 +22,8 @@
 
 /* System includes. */
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
 /* This object's header. */
 #include "mesh_gravity_patch.h"
@@ -31,6 +33,7 @@
 #include "cell.h"
 #include "error.h"
 #include "row_major_id.h"
+#include "threadpool.h"
 
 /**
  * @brief Initialize a mesh patch to cover a cell
@@ -140,6 +143,183 @@ void pm_add_patch_to_global_mesh(double *const global_mesh,
   }
 }
 
+/**
+ * @brief Write the content of a mesh patch back to a single-precision
+ * global mesh using atomic operations.
+ *
+ * The patch itself is accumulated in double precision; only the final
+ * additions are rounded.
+ *
+ * @param global_mesh The global mesh to write to.
+ * @param patch The #pm_mesh_patch object to write from.
+ */
+void pm_add_patch_to_global_mesh_single(float *const global_mesh,
+                                        const struct pm_mesh_patch *patch) {
+
+  const int N = patch->N;
+  const int size_i = patch->mesh_size[0];
+  const int size_j = patch->mesh_size[1];
+  const int size_k = patch->mesh_size[2];
+  const int mesh_min_i = patch->mesh_min[0];
+  const int mesh_min_j = patch->mesh_min[1];
+  const int mesh_min_k = patch->mesh_min[2];
+
+  /* Remind the compiler that the arrays are nicely aligned */
+  swift_declare_aligned_ptr(const double, mesh, patch->mesh,
+                            SWIFT_CACHE_ALIGNMENT);
+
+  for (int i = 0; i < size_i; ++i) {
+    for (int j = 0; j < size_j; ++j) {
+      for (int k = 0; k < size_k; ++k) {
+
+        const int ii = i + mesh_min_i;
+        const int jj = j + mesh_min_j;
+        const int kk = k + mesh_min_k;
+
+        const int patch_index = pm_mesh_patch_index(patch, i, j, k);
+        const int mesh_index = row_major_id_periodic(ii, jj, kk, N);
+
+        atomic_add_f(&global_mesh[mesh_index], (float)mesh[patch_index]);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Shared information about the parallel reduction of patches.
+ */
+struct patches_reduction_data {
+
+  /*! The global mesh to write to */
+  double *global_mesh;
+
+  /*! The patches to add */
+  const struct pm_mesh_patch *patches;
+
+  /*! Start of the list of entries of each plane of the global mesh */
+  const int *plane_offsets;
+
+  /*! Patch index and local x coordinate of each (patch, plane) overlap */
+  const int *entries;
+};
+
+/**
+ * @brief Threadpool mapper adding the patches to a range of planes of the
+ * global mesh.
+ *
+ * Every plane is handled by exactly one thread so no atomics are needed.
+ *
+ * @param map_data A chunk of the plane offsets array.
+ * @param num The number of planes in the chunk.
+ * @param extra The #patches_reduction_data.
+ */
+static void pm_add_patches_to_global_mesh_mapper(void *map_data, int num,
+                                                 void *extra) {
+
+  const struct patches_reduction_data *data =
+      (const struct patches_reduction_data *)extra;
+  double *const global_mesh = data->global_mesh;
+  const int plane_start = (int *)map_data - data->plane_offsets;
+
+  for (int ii = plane_start; ii < plane_start + num; ++ii) {
+    for (int e = data->plane_offsets[ii]; e < data->plane_offsets[ii + 1];
+         ++e) {
+
+      const struct pm_mesh_patch *patch = &data->patches[data->entries[2 * e]];
+      const int i = data->entries[2 * e + 1];
+      const int N = patch->N;
+      const int size_j = patch->mesh_size[1];
+      const int size_k = patch->mesh_size[2];
+
+      /* Remind the compiler that the arrays are nicely aligned */
+      swift_declare_aligned_ptr(const double, mesh, patch->mesh,
+                                SWIFT_CACHE_ALIGNMENT);
+
+      for (int j = 0; j < size_j; ++j) {
+
+        const int jj = (patch->mesh_min[1] + j + N) % N;
+        double *const row = global_mesh + ((size_t)ii * N + jj) * N;
+        const double *const patch_row =
+            mesh + pm_mesh_patch_index(patch, i, j, 0);
+
+        /* Walk along z, wrapping around the box */
+        int kk = (patch->mesh_min[2] + N) % N;
+        for (int k = 0; k < size_k; ++k) {
+          row[kk] += patch_row[k];
+          if (++kk == N) kk = 0;
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Write the content of a set of mesh patches back to the global mesh
+ * in parallel without atomic operations.
+ *
+ * The patches overlapping each plane (constant x) of the global mesh are
+ * listed first. The planes are then distributed over the threads, each of
+ * which sums all the contributions to its planes.
+ *
+ * @param global_mesh The global N^3 mesh to write to.
+ * @param patches The #pm_mesh_patch objects to write from (empty patches
+ * have a NULL mesh and are skipped).
+ * @param nr_patches The number of patches.
+ * @param N The side-length of the global mesh.
+ * @param tp The #threadpool.
+ */
+void pm_add_patches_to_global_mesh(double *const global_mesh,
+                                   const struct pm_mesh_patch *patches,
+                                   const int nr_patches, const int N,
+                                   struct threadpool *tp) {
+
+  /* Count the number of patches overlapping each plane */
+  int *plane_offsets = (int *)calloc(N + 1, sizeof(int));
+  if (plane_offsets == NULL)
+    error("Failed to allocate the plane offsets of the patch reduction");
+
+  size_t nr_entries = 0;
+  for (int p = 0; p < nr_patches; ++p) {
+    if (patches[p].mesh == NULL) continue;
+    for (int i = 0; i < patches[p].mesh_size[0]; ++i) {
+      const int ii = (patches[p].mesh_min[0] + i + N) % N;
+      plane_offsets[ii + 1]++;
+      nr_entries++;
+    }
+  }
+  for (int ii = 0; ii < N; ++ii) plane_offsets[ii + 1] += plane_offsets[ii];
+
+  /* List the (patch, local x coordinate) pairs of each plane */
+  int *entries = (int *)malloc((2 * nr_entries + 1) * sizeof(int));
+  int *fill = (int *)malloc(N * sizeof(int));
+  if (entries == NULL || fill == NULL)
+    error("Failed to allocate the entries of the patch reduction");
+  memcpy(fill, plane_offsets, N * sizeof(int));
+
+  for (int p = 0; p < nr_patches; ++p) {
+    if (patches[p].mesh == NULL) continue;
+    for (int i = 0; i < patches[p].mesh_size[0]; ++i) {
+      const int ii = (patches[p].mesh_min[0] + i + N) % N;
+      const int e = fill[ii]++;
+      entries[2 * e] = p;
+      entries[2 * e + 1] = i;
+    }
+  }
+  free(fill);
+
+  struct patches_reduction_data data;
+  data.global_mesh = global_mesh;
+  data.patches = patches;
+  data.plane_offsets = plane_offsets;
+  data.entries = entries;
+
+  threadpool_map(tp, pm_add_patches_to_global_mesh_mapper, plane_offsets, N,
+                 sizeof(int), threadpool_auto_chunk_size, &data);
+
+  free(entries);
+  free(plane_offsets);
+}
+
 /**
  * @brief Set all values in a mesh patch to zero
  *
@@ -30,6 +30,7 @@
 
 /* Forward declarations */
 struct cell;
+struct threadpool;
 
 /**
  * @brief Data structure for a patch of mesh covering a cell
@@ -167,7 +168,46 @@ __attribute__((always_inline)) INLINE static void pm_mesh_patch_CIC_set(
   mesh[pm_mesh_patch_index(patch, i + 1, j + 1, k + 1)] += value * dx * dy * dz;
 }
 
+/**
+ * @brief Assignment of a value to the mesh patch with a separable window of
+ * arbitrary order.
+ *
+ * @param patch Pointer to the patch
+ * @param order The number of mesh points touched along each axis
+ * @param i Integer x coordinate in the mesh patch of the first point
+ * @param j Integer y coordinate in the mesh patch of the first point
+ * @param k Integer z coordinate in the mesh patch of the first point
+ * @param wx Weights of the window along x
+ * @param wy Weights of the window along y
+ * @param wz Weights of the window along z
+ * @param value The value to set
+ */
+__attribute__((always_inline)) INLINE static void pm_mesh_patch_window_set(
+    const struct pm_mesh_patch *patch, const int order, const int i,
+    const int j, const int k, const double *wx, const double *wy,
+    const double *wz, const double value) {
+
+  /* Remind the compiler that the arrays are nicely aligned */
+  swift_declare_aligned_ptr(double, mesh, patch->mesh, SWIFT_CACHE_ALIGNMENT);
+
+  for (int a = 0; a < order; ++a) {
+    for (int b = 0; b < order; ++b) {
+      const double wxy = value * wx[a] * wy[b];
+      double *const row = mesh + pm_mesh_patch_index(patch, i + a, j + b, k);
+      for (int c = 0; c < order; ++c) row[c] += wxy * wz[c];
+    }
+  }
+}
+
 void pm_add_patch_to_global_mesh(double *const global_mesh,
                                  const struct pm_mesh_patch *patch);
 
+void pm_add_patch_to_global_mesh_single(float *const global_mesh,
+                                        const struct pm_mesh_patch *patch);
+
+void pm_add_patches_to_global_mesh(double *const global_mesh,
+                                   const struct pm_mesh_patch *patches,
+                                   const int nr_patches, const int N,
+                                   struct threadpool *tp);
+
 #endif
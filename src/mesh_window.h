@@ -0,0 +1,121 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_MESH_WINDOW_H
+#define SWIFT_MESH_WINDOW_H
+
+/* Config parameters. */
+#include <config.h>
+
+/* Standard headers. */
+#include <math.h>
+
+/* Includes. */
+#include "error.h"
+#include "inline.h"
+
+/*! Highest order of mass assignment window available (PCS) */
+#define MESH_WINDOW_MAX_ORDER 4
+
+/**
+ * @brief Returns the name of a mass assignment window.
+ *
+ * @param order The order of the window (1: NGP, 2: CIC, 3: TSC, 4: PCS).
+ */
+INLINE static const char *mesh_window_name(const int order) {
+
+  static const char *names[MESH_WINDOW_MAX_ORDER + 1] = {"none", "NGP", "CIC",
+                                                         "TSC", "PCS"};
+  if (order < 1 || order > MESH_WINDOW_MAX_ORDER) return names[0];
+  return names[order];
+}
+
+/**
+ * @brief Computes the weights of a mass assignment window along one axis.
+ *
+ * The window of order p is the p-fold convolution of the top-hat of one mesh
+ * cell with itself: nearest-grid-point (1), cloud-in-cell (2), triangular-
+ * shaped-cloud (3) or piecewise-cubic-spline (4). It spans p mesh points and
+ * its Fourier transform is sinc(k h / 2)^p.
+ *
+ * @param order The order of the window.
+ * @param x The position in units of the mesh cell size (mesh point i sits at
+ * x = i).
+ * @param w (return) The weights of the order mesh points touched.
+ * @return The index of the first mesh point touched (not wrapped).
+ */
+__attribute__((always_inline)) INLINE static int mesh_window_weights(
+    const int order, const double x, double w[MESH_WINDOW_MAX_ORDER]) {
+
+  switch (order) {
+    case 1: {
+      w[0] = 1.;
+      return (int)floor(x + 0.5);
+    }
+    case 2: {
+      const int i = (int)floor(x);
+      const double d = x - i;
+      w[0] = 1. - d;
+      w[1] = d;
+      return i;
+    }
+    case 3: {
+      const int i = (int)floor(x + 0.5);
+      const double d = x - i;
+      w[0] = 0.5 * (0.5 - d) * (0.5 - d);
+      w[1] = 0.75 - d * d;
+      w[2] = 0.5 * (0.5 + d) * (0.5 + d);
+      return i - 1;
+    }
+    case 4: {
+      const int i = (int)floor(x);
+      const double d = x - i;
+      const double t = 1. - d;
+      w[0] = (1. / 6.) * t * t * t;
+      w[1] = (1. / 6.) * (4. - 6. * d * d + 3. * d * d * d);
+      w[2] = (1. / 6.) * (4. - 6. * t * t + 3. * t * t * t);
+      w[3] = (1. / 6.) * d * d * d;
+      return i - 1;
+    }
+    default:
+#ifdef SWIFT_DEBUG_CHECKS
+      error("Invalid mass assignment order %d", order);
+#endif
+      return 0;
+  }
+}
+
+/**
+ * @brief Phase of the interlacing correction of a mode.
+ *
+ * The second (interlaced) mesh samples the field at positions shifted by
+ * minus half a mesh cell along each axis. Multiplying its Fourier transform
+ * by exp(i * phase) brings it back onto the frame of the first mesh, where
+ * averaging the two cancels the odd aliasing images.
+ *
+ * @param kx The integer wavenumber along x (in [-N/2, N/2]).
+ * @param ky The integer wavenumber along y (in [-N/2, N/2]).
+ * @param kz The integer wavenumber along z (in [0, N/2]).
+ * @param N The side-length of the mesh.
+ */
+__attribute__((always_inline, const)) INLINE static double
+mesh_window_interlacing_phase(const int kx, const int ky, const int kz,
+                              const int N) {
+  return M_PI * (double)(kx + ky + kz) / (double)N;
+}
+
+#endif /* SWIFT_MESH_WINDOW_H */
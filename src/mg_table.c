@@ -0,0 +1,783 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/**
+ *  @file mg_table.c
+ *  @brief Interpolation tables for the modified-gravity models.
+ */
+
+/* Config parameters. */
+#include <config.h>
+
+/* Some standard headers. */
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/* MPI headers. */
+#ifdef WITH_MPI
+#include <mpi.h>
+#endif
+
+/* This object's header. */
+#include "mg_table.h"
+
+/* Local headers. */
+#include "align.h"
+#include "error.h"
+#include "memuse.h"
+#include "parser.h"
+#include "restart.h"
+#include "table_cache.h"
+
+/*! Number of values in the key of a #mg_table cache file */
+#define MG_TABLE_CACHE_NR_KEYS 6
+
+/*! Number of scalars stored in front of the arrays of a cache file */
+#define MG_TABLE_CACHE_NR_SCALARS 4
+
+/**
+ * @brief Compute the second derivatives of a cubic spline through uniformly
+ * spaced points.
+ *
+ * The second derivative is assumed to vary linearly over the first and last
+ * two intervals, which avoids the O(h^2) errors a natural spline makes close
+ * to the edges of the table. The derivatives are returned multiplied by the
+ * square of the grid spacing.
+ *
+ * @param y The values at the grid points.
+ * @param size The number of grid points.
+ * @param d2y (return) The scaled second derivatives.
+ */
+static void mg_table_spline_init(const double *y, const int size,
+                                 double *d2y) {
+
+  if (size < 3) {
+    for (int i = 0; i < size; i++) d2y[i] = 0.;
+    return;
+  }
+
+  double *c = (double *)malloc(size * sizeof(double));
+  if (c == NULL) error("Failed to allocate spline work array");
+
+  /* Forward sweep of the tridiagonal system
+   * d2y[i-1] + 4 d2y[i] + d2y[i+1] = 6 (y[i+1] - 2 y[i] + y[i-1]),
+   * where the first and last rows reduce to 6 d2y[i] = rhs once the
+   * end-point values are eliminated. */
+  c[0] = 0.;
+  d2y[0] = 0.;
+  for (int i = 1; i < size - 1; i++) {
+    const double rhs = 6. * (y[i + 1] - 2. * y[i] + y[i - 1]);
+    const int edge = (i == 1 || i == size - 2);
+    const double off_diag = edge ? 0. : 1.;
+    const double p = (edge ? 6. : 4.) - off_diag * c[i - 1];
+    c[i] = off_diag / p;
+    d2y[i] = (rhs - off_diag * d2y[i - 1]) / p;
+  }
+
+  /* Back substitution */
+  for (int i = size - 3; i > 0; i--) d2y[i] -= c[i] * d2y[i + 1];
+
+  /* Extrapolate to the end-points */
+  if (size == 3) {
+    d2y[0] = d2y[1];
+    d2y[2] = d2y[1];
+  } else {
+    d2y[0] = 2. * d2y[1] - d2y[2];
+    d2y[size - 1] = 2. * d2y[size - 2] - d2y[size - 3];
+  }
+
+  free(c);
+}
+
+/**
+ * @brief Initialise a #mg_table from a raw tabulated function of a.
+ *
+ * The raw data is linearly interpolated onto a grid uniform in log(a)
+ * spanning the same range.
+ *
+ * @param t The #mg_table to initialise.
+ * @param a The (strictly increasing) scale-factors of the raw table.
+ * @param y The function values of the raw table.
+ * @param nr_rows The number of entries in the raw table.
+ * @param size The number of grid points to use. If <= 0, use nr_rows.
+ * @param interpolation The interpolation scheme to use for look-ups.
+ */
+void mg_table_init(struct mg_table *t, const double *a, const double *y,
+                   const int nr_rows, const int size,
+                   const enum mg_table_interpolation interpolation) {
+
+  if (nr_rows < 2) error("Need at least two rows to build a table");
+  if (a[0] <= 0.) error("Tabulated scale-factors must be positive");
+  for (int i = 1; i < nr_rows; i++)
+    if (a[i] <= a[i - 1])
+      error("Tabulated scale-factors must be strictly increasing (row %d)", i);
+
+  t->nr_rows = nr_rows;
+  t->size = size > 1 ? size : nr_rows;
+  t->interpolation = interpolation;
+  t->log_a_min = log(a[0]);
+  t->log_a_max = log(a[nr_rows - 1]);
+  const double delta_log_a = (t->log_a_max - t->log_a_min) / (t->size - 1);
+  t->delta_log_a_inv = 1. / delta_log_a;
+
+  if (swift_memalign("mg.table", (void **)&t->y, SWIFT_STRUCT_ALIGNMENT,
+                     t->size * sizeof(double)) != 0)
+    error("Failed to allocate modified-gravity table");
+
+  /* Resample the raw table. Both grids are sorted so we only walk it once. */
+  int j = 0;
+  for (int i = 0; i < t->size; i++) {
+    const double a_i = exp(t->log_a_min + i * delta_log_a);
+    while (j < nr_rows - 2 && a[j + 1] < a_i) j++;
+
+    const double w = (a_i - a[j]) / (a[j + 1] - a[j]);
+    t->y[i] = y[j] + w * (y[j + 1] - y[j]);
+  }
+
+  /* Avoid any round-off at the end-points */
+  t->y[0] = y[0];
+  t->y[t->size - 1] = y[nr_rows - 1];
+
+  if (interpolation == mg_table_interpolation_cubic) {
+    if (swift_memalign("mg.table", (void **)&t->d2y, SWIFT_STRUCT_ALIGNMENT,
+                       t->size * sizeof(double)) != 0)
+      error("Failed to allocate modified-gravity table");
+    mg_table_spline_init(t->y, t->size, t->d2y);
+  } else {
+    t->d2y = NULL;
+  }
+}
+
+/**
+ * @brief Initialise a #mg_table from a text file.
+ *
+ * The file must contain two columns: the scale-factor and the value of the
+ * function. Lines that do not contain two numbers are ignored.
+ *
+ * @param t The #mg_table to initialise.
+ * @param filename The name of the file to read.
+ * @param size The number of grid points to use. If <= 0, use the number of
+ * rows in the file.
+ * @param interpolation The interpolation scheme to use for look-ups.
+ */
+void mg_table_init_from_file(struct mg_table *t, const char *filename,
+                             const int size,
+                             const enum mg_table_interpolation interpolation) {
+
+  FILE *file = fopen(filename, "r");
+  if (file == NULL) error("Error opening file '%s'", filename);
+
+  size_t count = 0;
+  size_t allocated = 1024;
+  double *a = (double *)malloc(allocated * sizeof(double));
+  double *y = (double *)malloc(allocated * sizeof(double));
+  if (a == NULL || y == NULL) error("Failed to allocate table read buffers");
+
+  char *line = NULL;
+  size_t len = 0;
+  while (getline(&line, &len, file) != -1) {
+
+    if (count == allocated) {
+      allocated *= 2;
+      a = (double *)realloc(a, allocated * sizeof(double));
+      y = (double *)realloc(y, allocated * sizeof(double));
+      if (a == NULL || y == NULL) error("Failed to grow table read buffers");
+    }
+
+    if (sscanf(line, "%lf %lf", &a[count], &y[count]) == 2) count++;
+  }
+  free(line);
+  fclose(file);
+
+  if (count == 0) error("No values read from file '%s'", filename);
+
+  mg_table_init(t, a, y, (int)count, size, interpolation);
+
+  free(a);
+  free(y);
+}
+
+/**
+ * @brief Read the table cache options from the parameter file.
+ *
+ * @param params The parsed parameter file.
+ * @param cache_dir (return) The directory to store the cache files in
+ * (including the trailing '/'). Must be at least PARSER_MAX_LINE_SIZE long.
+ * @return 1 if the table cache is enabled, 0 otherwise.
+ */
+int mg_table_get_cache_dir(struct swift_params *params, char *cache_dir) {
+
+  const int use_cache =
+      parser_get_opt_param_int(params, "Cosmology:MG_tables_cache", 1);
+
+  char tables_dir[PARSER_MAX_LINE_SIZE];
+  parser_get_param_string(params, "Cosmology:cosmology_tables_dir",
+                          tables_dir);
+  parser_get_opt_param_string(params, "Cosmology:MG_tables_cache_dir",
+                              cache_dir, tables_dir);
+
+  return use_cache;
+}
+
+/**
+ * @brief Build the key identifying the cache file of a #mg_table.
+ *
+ * @param filename The name of the text file the table is read from.
+ * @param size The requested number of grid points.
+ * @param interpolation The interpolation scheme.
+ * @param key (return) The key.
+ * @return 1 on success, 0 if the text file cannot be accessed.
+ */
+static int mg_table_cache_key(const char *filename, const int size,
+                              const enum mg_table_interpolation interpolation,
+                              double key[MG_TABLE_CACHE_NR_KEYS]) {
+
+  struct stat st;
+  if (stat(filename, &st) != 0) return 0;
+
+  key[0] = TABLE_CACHE_VERSION;
+  key[1] = (double)st.st_size;
+  key[2] = (double)st.st_mtime;
+  key[3] = (double)st.st_ino;
+  key[4] = size;
+  key[5] = interpolation;
+  return 1;
+}
+
+/**
+ * @brief Try to initialise a #mg_table from its binary cache file.
+ *
+ * @param t The #mg_table to initialise.
+ * @param cache_name The name of the cache file.
+ * @param key The expected key of the file.
+ * @param interpolation The interpolation scheme.
+ * @return 1 on success, 0 otherwise.
+ */
+static int mg_table_cache_read(struct mg_table *t, const char *cache_name,
+                               const double key[MG_TABLE_CACHE_NR_KEYS],
+                               const enum mg_table_interpolation interpolation) {
+
+  const int nr_arrays =
+      interpolation == mg_table_interpolation_cubic ? 3 : 2;
+
+  struct table_cache_file f;
+  if (!table_cache_open(&f, cache_name, key, MG_TABLE_CACHE_NR_KEYS,
+                        nr_arrays))
+    return 0;
+
+  size_t length;
+  const double *scalars = table_cache_get_array(&f, 0, &length);
+  if (length != MG_TABLE_CACHE_NR_SCALARS) {
+    table_cache_close(&f);
+    return 0;
+  }
+
+  t->nr_rows = (int)scalars[0];
+  t->size = (int)scalars[1];
+  t->log_a_min = scalars[2];
+  t->log_a_max = scalars[3];
+  t->delta_log_a_inv = (t->size - 1) / (t->log_a_max - t->log_a_min);
+  t->interpolation = interpolation;
+  t->d2y = NULL;
+
+  for (int i = 1; i < nr_arrays; i++) {
+    const double *data = table_cache_get_array(&f, i, &length);
+    if (length != (size_t)t->size) error("Corrupted cache '%s'", cache_name);
+
+    double **target = (i == 1) ? &t->y : &t->d2y;
+    if (swift_memalign("mg.table", (void **)target, SWIFT_STRUCT_ALIGNMENT,
+                       t->size * sizeof(double)) != 0)
+      error("Failed to allocate modified-gravity table");
+    memcpy(*target, data, t->size * sizeof(double));
+  }
+
+  table_cache_close(&f);
+  return 1;
+}
+
+/**
+ * @brief Write the binary cache file of a #mg_table.
+ *
+ * @param t The #mg_table.
+ * @param cache_name The name of the cache file.
+ * @param key The key of the file.
+ */
+static void mg_table_cache_write(const struct mg_table *t,
+                                 const char *cache_name,
+                                 const double key[MG_TABLE_CACHE_NR_KEYS]) {
+
+  const double scalars[MG_TABLE_CACHE_NR_SCALARS] = {
+      t->nr_rows, t->size, t->log_a_min, t->log_a_max};
+
+  const double *arrays[3] = {scalars, t->y, t->d2y};
+  const size_t lengths[3] = {MG_TABLE_CACHE_NR_SCALARS, (size_t)t->size,
+                             (size_t)t->size};
+  const int nr_arrays =
+      t->interpolation == mg_table_interpolation_cubic ? 3 : 2;
+
+  table_cache_write(cache_name, key, MG_TABLE_CACHE_NR_KEYS, nr_arrays,
+                    lengths, arrays);
+}
+
+/**
+ * @brief Initialise a #mg_table from a text file using the resampling
+ * options given in the Cosmology section of the parameter file.
+ *
+ * Only the root rank reads the table; it first looks for a binary cache of
+ * the resampled table built by an earlier run and writes one otherwise. The
+ * result is then broadcast to all the other ranks.
+ *
+ * @param t The #mg_table to initialise.
+ * @param params The parsed parameter file.
+ * @param filename The name of the file to read.
+ */
+void mg_table_init_from_params(struct mg_table *t, struct swift_params *params,
+                               const char *filename) {
+
+  const int size =
+      parser_get_opt_param_int(params, "Cosmology:MG_table_length", 0);
+
+  char interpolation[32] = {0};
+  parser_get_opt_param_string(params, "Cosmology:MG_table_interpolation",
+                              interpolation, "linear");
+
+  enum mg_table_interpolation scheme = mg_table_interpolation_linear;
+  if (strcmp(interpolation, "linear") == 0)
+    scheme = mg_table_interpolation_linear;
+  else if (strcmp(interpolation, "cubic") == 0)
+    scheme = mg_table_interpolation_cubic;
+  else
+    error("Invalid Cosmology:MG_table_interpolation '%s' (linear or cubic)",
+          interpolation);
+
+  char cache_dir[PARSER_MAX_LINE_SIZE];
+  const int use_cache = mg_table_get_cache_dir(params, cache_dir);
+
+  if (table_cache_is_root_rank()) {
+
+    /* Name of the cache file: the name of the text file with a .bin suffix */
+    const char *base = strrchr(filename, '/');
+    base = (base == NULL) ? filename : base + 1;
+    char cache_name[2 * PARSER_MAX_LINE_SIZE];
+    snprintf(cache_name, 2 * PARSER_MAX_LINE_SIZE, "%s%s.bin", cache_dir,
+             base);
+
+    double key[MG_TABLE_CACHE_NR_KEYS];
+    const int have_key = mg_table_cache_key(filename, size, scheme, key);
+
+    if (!(use_cache && have_key &&
+          mg_table_cache_read(t, cache_name, key, scheme))) {
+
+      mg_table_init_from_file(t, filename, size, scheme);
+      if (use_cache && have_key) mg_table_cache_write(t, cache_name, key);
+    }
+  }
+
+  mg_table_struct_broadcast(t, /*root=*/0);
+}
+
+/**
+ * @brief Set a #mg_table to a valid empty state.
+ *
+ * @param t The #mg_table.
+ */
+void mg_table_init_empty(struct mg_table *t) {
+  bzero(t, sizeof(struct mg_table));
+  t->y = NULL;
+  t->d2y = NULL;
+}
+
+/**
+ * @brief Free the memory allocated by a #mg_table.
+ *
+ * @param t The #mg_table.
+ */
+void mg_table_clean(struct mg_table *t) {
+  if (t->y != NULL) swift_free("mg.table", t->y);
+  if (t->d2y != NULL) swift_free("mg.table", t->d2y);
+  t->y = NULL;
+  t->d2y = NULL;
+}
+
+/**
+ * @brief Broadcast a #mg_table to all MPI ranks.
+ *
+ * Does nothing in non-MPI runs.
+ *
+ * @param t The #mg_table, initialised on the root rank.
+ * @param root The root rank for the broadcast operation.
+ */
+void mg_table_struct_broadcast(struct mg_table *t, const int root) {
+
+#ifdef WITH_MPI
+
+  int initialised = 0;
+  MPI_Initialized(&initialised);
+  if (!initialised) return;
+
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  MPI_Bcast(t, sizeof(struct mg_table), MPI_BYTE, root, MPI_COMM_WORLD);
+
+  if (rank != root) {
+    if (swift_memalign("mg.table", (void **)&t->y, SWIFT_STRUCT_ALIGNMENT,
+                       t->size * sizeof(double)) != 0)
+      error("Failed to allocate modified-gravity table");
+    if (t->interpolation == mg_table_interpolation_cubic) {
+      if (swift_memalign("mg.table", (void **)&t->d2y, SWIFT_STRUCT_ALIGNMENT,
+                         t->size * sizeof(double)) != 0)
+        error("Failed to allocate modified-gravity table");
+    } else {
+      t->d2y = NULL;
+    }
+  }
+
+  MPI_Bcast(t->y, t->size, MPI_DOUBLE, root, MPI_COMM_WORLD);
+  if (t->interpolation == mg_table_interpolation_cubic)
+    MPI_Bcast(t->d2y, t->size, MPI_DOUBLE, root, MPI_COMM_WORLD);
+#endif
+}
+
+/**
+ * @brief Write the arrays of a #mg_table to the given FILE as a stream of
+ * bytes.
+ *
+ * The struct itself is assumed to be dumped as part of its parent.
+ *
+ * @param t The #mg_table.
+ * @param stream The file stream.
+ */
+void mg_table_struct_dump(const struct mg_table *t, FILE *stream) {
+
+  if (t->size == 0) return;
+
+  restart_write_blocks(t->y, sizeof(double), t->size, stream, "mg_table->y",
+                       "modified-gravity table");
+  if (t->interpolation == mg_table_interpolation_cubic)
+    restart_write_blocks(t->d2y, sizeof(double), t->size, stream,
+                         "mg_table->d2y", "modified-gravity table");
+}
+
+/**
+ * @brief Restore the arrays of a #mg_table from the given FILE as a stream
+ * of bytes.
+ *
+ * @param t The #mg_table, already restored as part of its parent.
+ * @param stream The file stream.
+ */
+void mg_table_struct_restore(struct mg_table *t, FILE *stream) {
+
+  t->y = NULL;
+  t->d2y = NULL;
+  if (t->size == 0) return;
+
+  if (swift_memalign("mg.table", (void **)&t->y, SWIFT_STRUCT_ALIGNMENT,
+                     t->size * sizeof(double)) != 0)
+    error("Failed to allocate modified-gravity table");
+  restart_read_blocks(t->y, sizeof(double), t->size, stream, NULL,
+                      "modified-gravity table");
+
+  if (t->interpolation == mg_table_interpolation_cubic) {
+    if (swift_memalign("mg.table", (void **)&t->d2y, SWIFT_STRUCT_ALIGNMENT,
+                       t->size * sizeof(double)) != 0)
+      error("Failed to allocate modified-gravity table");
+    restart_read_blocks(t->d2y, sizeof(double), t->size, stream, NULL,
+                        "modified-gravity table");
+  }
+}
+
+/**
+ * @brief Find the interval of a sorted array bracketing a value.
+ *
+ * Values outside the range of the array are clamped to its first or last
+ * entry.
+ *
+ * @param x The strictly increasing array.
+ * @param n The number of elements in the array.
+ * @param val The value to look for.
+ * @param w (return) The weight of the upper end of the interval.
+ * @return The index of the lower end of the interval.
+ */
+static int mg_table_2d_bracket(const double *x, const int n, const double val,
+                               double *w) {
+
+  if (n < 2 || val <= x[0]) {
+    *w = 0.;
+    return 0;
+  }
+  if (val >= x[n - 1]) {
+    *w = 1.;
+    return n - 2;
+  }
+
+  /* Bisection */
+  int lo = 0, hi = n - 1;
+  while (hi - lo > 1) {
+    const int mid = (lo + hi) / 2;
+    if (x[mid] <= val)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  *w = (val - x[lo]) / (x[lo + 1] - x[lo]);
+  return lo;
+}
+
+/**
+ * @brief Allocate the arrays of a #mg_table_2d whose sizes are set.
+ *
+ * @param t The #mg_table_2d.
+ */
+static void mg_table_2d_allocate(struct mg_table_2d *t) {
+
+  if (swift_memalign("mg.table", (void **)&t->y, SWIFT_STRUCT_ALIGNMENT,
+                     t->size_a * t->size_k * sizeof(double)) != 0 ||
+      swift_memalign("mg.table", (void **)&t->log_k, SWIFT_STRUCT_ALIGNMENT,
+                     t->size_k * sizeof(double)) != 0 ||
+      swift_memalign("mg.table", (void **)&t->log_a, SWIFT_STRUCT_ALIGNMENT,
+                     t->size_a * sizeof(double)) != 0)
+    error("Failed to allocate modified-gravity table");
+}
+
+/**
+ * @brief Initialise a #mg_table_2d from a text file.
+ *
+ * The file must contain three columns: the scale-factor, the wavenumber and
+ * the value of the function. The rows are grouped in blocks of constant
+ * scale-factor (increasing from block to block), each listing the same
+ * strictly increasing wavenumbers. Lines that do not contain three numbers
+ * are ignored.
+ *
+ * @param t The #mg_table_2d to initialise.
+ * @param filename The name of the file to read.
+ * @param k_fac Conversion factor from the wavenumber units of the file to
+ * comoving internal units.
+ */
+void mg_table_2d_init_from_file(struct mg_table_2d *t, const char *filename,
+                                const double k_fac) {
+
+  FILE *file = fopen(filename, "r");
+  if (file == NULL) error("Error opening file '%s'", filename);
+
+  size_t count = 0;
+  size_t allocated = 1024;
+  double *a = (double *)malloc(allocated * sizeof(double));
+  double *k = (double *)malloc(allocated * sizeof(double));
+  double *y = (double *)malloc(allocated * sizeof(double));
+  if (a == NULL || k == NULL || y == NULL)
+    error("Failed to allocate table read buffers");
+
+  char *line = NULL;
+  size_t len = 0;
+  while (getline(&line, &len, file) != -1) {
+
+    if (count == allocated) {
+      allocated *= 2;
+      a = (double *)realloc(a, allocated * sizeof(double));
+      k = (double *)realloc(k, allocated * sizeof(double));
+      y = (double *)realloc(y, allocated * sizeof(double));
+      if (a == NULL || k == NULL || y == NULL)
+        error("Failed to grow table read buffers");
+    }
+
+    if (sscanf(line, "%lf %lf %lf", &a[count], &k[count], &y[count]) == 3)
+      count++;
+  }
+  free(line);
+  fclose(file);
+
+  if (count == 0) error("No values read from file '%s'", filename);
+
+  /* The first block of constant a gives the k grid */
+  size_t size_k = 1;
+  while (size_k < count && a[size_k] == a[0]) size_k++;
+  if (count % size_k != 0)
+    error("Table '%s' is not a regular (a, k) grid", filename);
+
+  t->size_k = (int)size_k;
+  t->size_a = (int)(count / size_k);
+  mg_table_2d_allocate(t);
+
+  for (int j = 0; j < t->size_k; j++) {
+    if (k[j] <= 0. || (j > 0 && k[j] <= k[j - 1]))
+      error("Wavenumbers in '%s' must be positive and strictly increasing",
+            filename);
+    t->log_k[j] = log(k[j] * k_fac);
+  }
+
+  for (int i = 0; i < t->size_a; i++) {
+    const size_t row = i * size_k;
+    if (a[row] <= 0. || (i > 0 && a[row] <= a[row - 1]))
+      error("Scale-factors in '%s' must be positive and strictly increasing",
+            filename);
+    for (size_t j = 0; j < size_k; j++)
+      if (a[row + j] != a[row] || k[row + j] != k[j])
+        error("Table '%s' is not a regular (a, k) grid (row %zd)", filename,
+              row + j);
+    t->log_a[i] = log(a[row]);
+  }
+
+  memcpy(t->y, y, count * sizeof(double));
+
+  free(a);
+  free(k);
+  free(y);
+}
+
+/**
+ * @brief Set a #mg_table_2d to a valid empty state.
+ *
+ * @param t The #mg_table_2d.
+ */
+void mg_table_2d_init_empty(struct mg_table_2d *t) {
+  bzero(t, sizeof(struct mg_table_2d));
+  t->y = NULL;
+  t->log_k = NULL;
+  t->log_a = NULL;
+}
+
+/**
+ * @brief Free the memory allocated by a #mg_table_2d.
+ *
+ * @param t The #mg_table_2d.
+ */
+void mg_table_2d_clean(struct mg_table_2d *t) {
+  if (t->y != NULL) swift_free("mg.table", t->y);
+  if (t->log_k != NULL) swift_free("mg.table", t->log_k);
+  if (t->log_a != NULL) swift_free("mg.table", t->log_a);
+  t->y = NULL;
+  t->log_k = NULL;
+  t->log_a = NULL;
+}
+
+/**
+ * @brief Interpolate a #mg_table_2d in a at all the tabulated wavenumbers.
+ *
+ * @param t The #mg_table_2d.
+ * @param a The scale-factor of interest.
+ * @param slice (return) The size_k values at the wavenumbers of the table.
+ */
+void mg_table_2d_get_slice(const struct mg_table_2d *t, const double a,
+                           double *slice) {
+
+  double w;
+  const int i = mg_table_2d_bracket(t->log_a, t->size_a, log(a), &w);
+  const double *y0 = t->y + i * t->size_k;
+  const double *y1 = (t->size_a > 1) ? y0 + t->size_k : y0;
+
+  for (int j = 0; j < t->size_k; j++)
+    slice[j] = (1. - w) * y0[j] + w * y1[j];
+}
+
+/**
+ * @brief Returns the bilinearly interpolated value of a #mg_table_2d.
+ *
+ * @param t The #mg_table_2d.
+ * @param k The wavenumber of interest (comoving internal units).
+ * @param a The scale-factor of interest.
+ */
+double mg_table_2d_interp(const struct mg_table_2d *t, const double k,
+                          const double a) {
+
+  double w_a, w_k;
+  const int i = mg_table_2d_bracket(t->log_a, t->size_a, log(a), &w_a);
+  const int j = mg_table_2d_bracket(t->log_k, t->size_k, log(k), &w_k);
+  const int di = (t->size_a > 1) ? t->size_k : 0;
+  const int dj = (t->size_k > 1) ? 1 : 0;
+
+  const double *y = t->y + i * t->size_k + j;
+  return (1. - w_a) * ((1. - w_k) * y[0] + w_k * y[dj]) +
+         w_a * ((1. - w_k) * y[di] + w_k * y[di + dj]);
+}
+
+/**
+ * @brief Broadcast a #mg_table_2d to all MPI ranks.
+ *
+ * Does nothing in non-MPI runs.
+ *
+ * @param t The #mg_table_2d, initialised on the root rank.
+ * @param root The root rank for the broadcast operation.
+ */
+void mg_table_2d_struct_broadcast(struct mg_table_2d *t, const int root) {
+
+#ifdef WITH_MPI
+
+  int initialised = 0;
+  MPI_Initialized(&initialised);
+  if (!initialised) return;
+
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  MPI_Bcast(t, sizeof(struct mg_table_2d), MPI_BYTE, root, MPI_COMM_WORLD);
+  if (t->size_a == 0) return;
+
+  if (rank != root) mg_table_2d_allocate(t);
+
+  MPI_Bcast(t->y, t->size_a * t->size_k, MPI_DOUBLE, root, MPI_COMM_WORLD);
+  MPI_Bcast(t->log_k, t->size_k, MPI_DOUBLE, root, MPI_COMM_WORLD);
+  MPI_Bcast(t->log_a, t->size_a, MPI_DOUBLE, root, MPI_COMM_WORLD);
+#endif
+}
+
+/**
+ * @brief Write the arrays of a #mg_table_2d to the given FILE as a stream of
+ * bytes.
+ *
+ * The struct itself is assumed to be dumped as part of its parent.
+ *
+ * @param t The #mg_table_2d.
+ * @param stream The file stream.
+ */
+void mg_table_2d_struct_dump(const struct mg_table_2d *t, FILE *stream) {
+
+  if (t->size_a == 0) return;
+
+  restart_write_blocks(t->y, sizeof(double), t->size_a * t->size_k, stream,
+                       "mg_table_2d->y", "modified-gravity table");
+  restart_write_blocks(t->log_k, sizeof(double), t->size_k, stream,
+                       "mg_table_2d->log_k", "modified-gravity table");
+  restart_write_blocks(t->log_a, sizeof(double), t->size_a, stream,
+                       "mg_table_2d->log_a", "modified-gravity table");
+}
+
+/**
+ * @brief Restore the arrays of a #mg_table_2d from the given FILE as a stream
+ * of bytes.
+ *
+ * @param t The #mg_table_2d, already restored as part of its parent.
+ * @param stream The file stream.
+ */
+void mg_table_2d_struct_restore(struct mg_table_2d *t, FILE *stream) {
+
+  t->y = NULL;
+  t->log_k = NULL;
+  t->log_a = NULL;
+  if (t->size_a == 0) return;
+
+  mg_table_2d_allocate(t);
+  restart_read_blocks(t->y, sizeof(double), t->size_a * t->size_k, stream,
+                      NULL, "modified-gravity table");
+  restart_read_blocks(t->log_k, sizeof(double), t->size_k, stream, NULL,
+                      "modified-gravity table");
+  restart_read_blocks(t->log_a, sizeof(double), t->size_a, stream, NULL,
+                      "modified-gravity table");
+}
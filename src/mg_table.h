@@ -0,0 +1,173 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_MG_TABLE_H
+#define SWIFT_MG_TABLE_H
+
+/* Config parameters. */
+#include <config.h>
+
+/* Some standard headers. */
+#include <math.h>
+#include <stdio.h>
+
+/* Local headers. */
+#include "inline.h"
+
+/* Pre-declarations */
+struct swift_params;
+
+/**
+ * @brief The interpolation schemes available to look-up a #mg_table.
+ */
+enum mg_table_interpolation {
+  mg_table_interpolation_linear,
+  mg_table_interpolation_cubic,
+};
+
+/**
+ * @brief A function of the scale-factor tabulated on a uniform grid in log(a).
+ *
+ * The raw modified-gravity tables (E(a), G_eff(a), ...) are read once and
+ * resampled at initialisation time such that any subsequent look-up is O(1).
+ */
+struct mg_table {
+
+  /*! Values of the function at the grid points */
+  double *y;
+
+  /*! Second derivatives of the function at the grid points multiplied by
+   * the square of the grid spacing (cubic interpolation only) */
+  double *d2y;
+
+  /*! Log of the scale-factor of the first grid point */
+  double log_a_min;
+
+  /*! Log of the scale-factor of the last grid point */
+  double log_a_max;
+
+  /*! Inverse of the grid spacing in log(a) */
+  double delta_log_a_inv;
+
+  /*! Number of grid points */
+  int size;
+
+  /*! Number of rows read from the raw table */
+  int nr_rows;
+
+  /*! Interpolation scheme used for the look-ups */
+  enum mg_table_interpolation interpolation;
+};
+
+/**
+ * @brief Returns the interpolated value of a #mg_table at a given log(a).
+ *
+ * Values outside the tabulated range are clamped to the first or last entry.
+ *
+ * @param t The #mg_table.
+ * @param log_a The log of the scale-factor of interest.
+ */
+__attribute__((always_inline)) INLINE static double mg_table_interp_log_a(
+    const struct mg_table *t, const double log_a) {
+
+  if (log_a <= t->log_a_min) return t->y[0];
+  if (log_a >= t->log_a_max) return t->y[t->size - 1];
+
+  const double x = (log_a - t->log_a_min) * t->delta_log_a_inv;
+  const int i = (int)x < t->size - 2 ? (int)x : t->size - 2;
+
+  /* Weights of the two bracketing grid points */
+  const double B = x - i;
+  const double A = 1. - B;
+
+  double val = A * t->y[i] + B * t->y[i + 1];
+
+  if (t->interpolation == mg_table_interpolation_cubic)
+    val += ((A * A * A - A) * t->d2y[i] + (B * B * B - B) * t->d2y[i + 1]) *
+           (1. / 6.);
+
+  return val;
+}
+
+/**
+ * @brief Returns the interpolated value of a #mg_table at a given
+ * scale-factor.
+ *
+ * @param t The #mg_table.
+ * @param a The scale-factor of interest.
+ */
+__attribute__((always_inline)) INLINE static double mg_table_interp(
+    const struct mg_table *t, const double a) {
+
+  return mg_table_interp_log_a(t, log(a));
+}
+
+/**
+ * @brief A function of wavenumber and scale-factor tabulated on a
+ * rectilinear (k, a) grid.
+ *
+ * Used for scale-dependent quantities such as G_eff(k,a)/G. Look-ups are
+ * bilinear in log(k) and log(a) and clamped to the edges of the table.
+ */
+struct mg_table_2d {
+
+  /*! Values of the function, stored as y[i_a * size_k + i_k] */
+  double *y;
+
+  /*! Log of the wavenumbers of the grid (comoving internal units) */
+  double *log_k;
+
+  /*! Log of the scale-factors of the grid */
+  double *log_a;
+
+  /*! Number of wavenumbers */
+  int size_k;
+
+  /*! Number of scale-factors */
+  int size_a;
+};
+
+void mg_table_init(struct mg_table *t, const double *a, const double *y,
+                   const int nr_rows, const int size,
+                   const enum mg_table_interpolation interpolation);
+void mg_table_init_from_file(struct mg_table *t, const char *filename,
+                             const int size,
+                             const enum mg_table_interpolation interpolation);
+void mg_table_init_from_params(struct mg_table *t, struct swift_params *params,
+                               const char *filename);
+void mg_table_init_empty(struct mg_table *t);
+void mg_table_clean(struct mg_table *t);
+int mg_table_get_cache_dir(struct swift_params *params, char *cache_dir);
+void mg_table_struct_broadcast(struct mg_table *t, const int root);
+
+/* Dump/restore. */
+void mg_table_struct_dump(const struct mg_table *t, FILE *stream);
+void mg_table_struct_restore(struct mg_table *t, FILE *stream);
+
+void mg_table_2d_init_from_file(struct mg_table_2d *t, const char *filename,
+                                const double k_fac);
+void mg_table_2d_init_empty(struct mg_table_2d *t);
+void mg_table_2d_clean(struct mg_table_2d *t);
+void mg_table_2d_get_slice(const struct mg_table_2d *t, const double a,
+                           double *slice);
+double mg_table_2d_interp(const struct mg_table_2d *t, const double k,
+                          const double a);
+void mg_table_2d_struct_broadcast(struct mg_table_2d *t, const int root);
+void mg_table_2d_struct_dump(const struct mg_table_2d *t, FILE *stream);
+void mg_table_2d_struct_restore(struct mg_table_2d *t, FILE *stream);
+
+#endif /* SWIFT_MG_TABLE_H */
@@ -33,7 +33,9 @@
 #include "const.h"
 #include "error.h"
 #include "gravity.h"
+#ifndef SWIFT_MULTIPOLE_SPHERICAL
 #include "gravity_derivatives.h"
+#endif
 #include "gravity_properties.h"
 #include "gravity_softened_derivatives.h"
 #include "inline.h"
@@ -107,6 +109,9 @@ __attribute__((nonnull)) INLINE static void gravity_drift(
 
   /* Conservative change in maximal radius containing all gpart */
   m->r_max += x_diff;
+
+  /* Accumulate the error made by drifting rather than reconstructing */
+  m->r_drift += x_diff;
 }
 
 /**
@@ -125,6 +130,22 @@ __attribute__((nonnull)) INLINE static void gravity_field_tensors_init(
 #endif
 }
 
+/**
+ * @brief Zeroes all the fields of a multipole.
+ *
+ * @param m The multipole
+ */
+__attribute__((nonnull)) INLINE static void gravity_multipole_init(
+    struct multipole *m) {
+
+  bzero(m, sizeof(struct multipole));
+  m->min_old_a_grav_norm = FLT_MAX;
+}
+
+#ifdef SWIFT_MULTIPOLE_SPHERICAL
+#include "multipole_spherical.h"
+#else
+
 /**
  * @brief Adds a field tensor to another one (i.e. does la += lb).
  *
@@ -277,18 +298,6 @@ __attribute__((nonnull)) INLINE static void gravity_field_tensors_print(
 #endif
 }
 
-/**
- * @brief Zeroes all the fields of a multipole.
- *
- * @param m The multipole
- */
-__attribute__((nonnull)) INLINE static void gravity_multipole_init(
-    struct multipole *m) {
-
-  bzero(m, sizeof(struct multipole));
-  m->min_old_a_grav_norm = FLT_MAX;
-}
-
 /**
  * @brief Prints the content of a #multipole to stdout.
  *
@@ -3017,4 +3026,6 @@ __attribute__((nonnull)) INLINE static void gravity_L2P(
 #endif
 }
 
+#endif /* SWIFT_MULTIPOLE_SPHERICAL */
+
 #endif /* SWIFT_MULTIPOLE_H */
@@ -0,0 +1,1103 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_MULTIPOLE_BATCH_H
+#define SWIFT_MULTIPOLE_BATCH_H
+
+/* Config parameters. */
+#include <config.h>
+
+#ifdef SWIFT_BATCHED_M2L
+
+/* Local includes. */
+#include "accumulate.h"
+#include "align.h"
+#include "error.h"
+#include "gravity_derivatives.h"
+#include "inline.h"
+#include "lock.h"
+#include "minmax.h"
+#include "multipole_struct.h"
+#include "periodic.h"
+#include "vector.h"
+
+/* Forward declarations */
+struct gravity_props;
+
+#ifndef WITH_VECTORIZATION
+#error "The batched M2L kernels need the hand-written vectorization."
+#endif
+
+/*! Number of M2L kernels collected before a batch is evaluated */
+#define gravity_M2L_batch_size (8 * VEC_SIZE)
+
+/**
+ * @brief A batch of M2L kernels waiting to be evaluated.
+ *
+ * The M2L interactions of the gravity tasks are collected in the batch of
+ * their #runner and evaluated VEC_SIZE at a time when the batch is full or
+ * when the task is done.
+ */
+struct gravity_M2L_batch {
+
+  /*! Distance vectors between the field tensors and the multipoles */
+  float dx[gravity_M2L_batch_size] SWIFT_CACHE_ALIGN;
+  float dy[gravity_M2L_batch_size] SWIFT_CACHE_ALIGN;
+  float dz[gravity_M2L_batch_size] SWIFT_CACHE_ALIGN;
+
+  /*! Softening lengths of the interactions */
+  float eps[gravity_M2L_batch_size] SWIFT_CACHE_ALIGN;
+
+  /*! The multipoles creating the fields */
+  const struct multipole *m[gravity_M2L_batch_size];
+
+  /*! The field tensors to update (NULL for padding) */
+  struct grav_tensor *l[gravity_M2L_batch_size];
+
+  /*! The locks protecting the field tensors */
+  swift_lock_type *lock[gravity_M2L_batch_size];
+
+  /*! Number of kernels in the batch */
+  int count;
+};
+
+/**
+ * @brief Evaluates VEC_SIZE kernels of a batch at once.
+ *
+ * The radial part of the derivatives depends on whether each pair is
+ * softened, truncated or Newtonian and is computed one pair at a time. The
+ * tensor part of the derivatives and the tensor multiplication, where most
+ * of the work is, are then done for all the pairs at once.
+ *
+ * The code below is generated by
+ * theory/Multipoles/generate_multipoles/m2l_batch.py.
+ *
+ * @param b The #gravity_M2L_batch.
+ * @param first The index of the first kernel to evaluate.
+ * @param periodic Is the calculation periodic ?
+ * @param rs_inv The inverse of the gravity mesh-smoothing scale.
+ */
+INLINE static void gravity_M2L_batch_kernel(struct gravity_M2L_batch *b,
+                                            const int first,
+                                            const int periodic,
+                                            const float rs_inv) {
+
+  vector dx, dy, dz, r2, r_inv;
+
+  /* 0th order terms */
+  vector Dt_1;
+  vector D_000;
+  vector M_000;
+  vector F_000;
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 0
+  /* 1st order terms */
+  vector rx_r, ry_r, rz_r;
+  vector Dt_2;
+  vector D_001, D_010, D_100;
+  vector F_001, F_010, F_100;
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 1
+  /* 2nd order terms */
+  vector rx_r2, ry_r2, rz_r2;
+  vector Dt_3;
+  vector D_002, D_011, D_020, D_101, D_110, D_200;
+  vector M_002, M_011, M_020, M_101, M_110, M_200;
+  vector F_002, F_011, F_020, F_101, F_110, F_200;
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 2
+  /* 3rd order terms */
+  vector rx_r3, ry_r3, rz_r3;
+  vector Dt_4;
+  vector D_003, D_012, D_021, D_030, D_102, D_111, D_120, D_201, D_210, D_300;
+  vector M_003, M_012, M_021, M_030, M_102, M_111, M_120, M_201, M_210, M_300;
+  vector F_003, F_012, F_021, F_030, F_102, F_111, F_120, F_201, F_210, F_300;
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 3
+  /* 4th order terms */
+  vector rx_r4, ry_r4, rz_r4;
+  vector Dt_5;
+  vector D_004, D_013, D_022, D_031, D_040, D_103, D_112, D_121, D_130, D_202,
+         D_211, D_220, D_301, D_310, D_400;
+  vector M_004, M_013, M_022, M_031, M_040, M_103, M_112, M_121, M_130, M_202,
+         M_211, M_220, M_301, M_310, M_400;
+  vector F_004, F_013, F_022, F_031, F_040, F_103, F_112, F_121, F_130, F_202,
+         F_211, F_220, F_301, F_310, F_400;
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 4
+  /* 5th order terms */
+  vector rx_r5, ry_r5, rz_r5;
+  vector Dt_6;
+  vector D_005, D_014, D_023, D_032, D_041, D_050, D_104, D_113, D_122, D_131,
+         D_140, D_203, D_212, D_221, D_230, D_302, D_311, D_320, D_401, D_410,
+         D_500;
+  vector M_005, M_014, M_023, M_032, M_041, M_050, M_104, M_113, M_122, M_131,
+         M_140, M_203, M_212, M_221, M_230, M_302, M_311, M_320, M_401, M_410,
+         M_500;
+  vector F_005, F_014, F_023, F_032, F_041, F_050, F_104, F_113, F_122, F_131,
+         F_140, F_203, F_212, F_221, F_230, F_302, F_311, F_320, F_401, F_410,
+         F_500;
+#endif
+
+  /* Compute the distances */
+  dx.v = vec_load(&b->dx[first]);
+  dy.v = vec_load(&b->dy[first]);
+  dz.v = vec_load(&b->dz[first]);
+  r2.v = vec_fma(dx.v, dx.v, vec_fma(dy.v, dy.v, vec_mul(dz.v, dz.v)));
+  r_inv.v = vec_div(vec_set1(1.f), vec_sqrt(r2.v));
+
+  /* Radial part of the derivatives, one pair at a time */
+  float Dt[SELF_GRAVITY_MULTIPOLE_ORDER + 1][VEC_SIZE] SWIFT_CACHE_ALIGN;
+  for (int k = 0; k < VEC_SIZE; k++) {
+
+    float Dt_k[SELF_GRAVITY_MULTIPOLE_ORDER + 1];
+    potential_derivatives_compute_M2L_radial(
+        r2.f[k], r_inv.f[k], b->eps[first + k], periodic, rs_inv, Dt_k);
+
+    for (int n = 0; n < SELF_GRAVITY_MULTIPOLE_ORDER + 1; n++)
+      Dt[n][k] = Dt_k[n];
+  }
+
+  Dt_1.v = vec_load(Dt[0]);
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 0
+  Dt_2.v = vec_load(Dt[1]);
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 1
+  Dt_3.v = vec_load(Dt[2]);
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 2
+  Dt_4.v = vec_load(Dt[3]);
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 3
+  Dt_5.v = vec_load(Dt[4]);
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 4
+  Dt_6.v = vec_load(Dt[5]);
+#endif
+
+  /* Compute some powers of (r_x / r), (r_y / r) and (r_z / r) */
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 0
+  rx_r.v = vec_mul(dx.v, r_inv.v);
+  ry_r.v = vec_mul(dy.v, r_inv.v);
+  rz_r.v = vec_mul(dz.v, r_inv.v);
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 1
+  rx_r2.v = vec_mul(rx_r.v, rx_r.v);
+  ry_r2.v = vec_mul(ry_r.v, ry_r.v);
+  rz_r2.v = vec_mul(rz_r.v, rz_r.v);
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 2
+  rx_r3.v = vec_mul(rx_r2.v, rx_r.v);
+  ry_r3.v = vec_mul(ry_r2.v, ry_r.v);
+  rz_r3.v = vec_mul(rz_r2.v, rz_r.v);
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 3
+  rx_r4.v = vec_mul(rx_r3.v, rx_r.v);
+  ry_r4.v = vec_mul(ry_r3.v, ry_r.v);
+  rz_r4.v = vec_mul(rz_r3.v, rz_r.v);
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 4
+  rx_r5.v = vec_mul(rx_r4.v, rx_r.v);
+  ry_r5.v = vec_mul(ry_r4.v, ry_r.v);
+  rz_r5.v = vec_mul(rz_r4.v, rz_r.v);
+#endif
+
+  /* Get the tensor part of the derivatives */
+  /* 0th order derivatives */
+  D_000.v = Dt_1.v;
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 0
+  /* 1st order derivatives */
+  D_001.v = vec_mul(rz_r.v, Dt_2.v);
+  D_010.v = vec_mul(ry_r.v, Dt_2.v);
+  D_100.v = vec_mul(rx_r.v, Dt_2.v);
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 1
+  /* 2nd order derivatives */
+  Dt_2.v = vec_mul(Dt_2.v, r_inv.v);
+  D_002.v = vec_add(vec_mul(rz_r2.v, Dt_3.v), Dt_2.v);
+  D_011.v = vec_mul(vec_mul(ry_r.v, rz_r.v), Dt_3.v);
+  D_020.v = vec_add(vec_mul(ry_r2.v, Dt_3.v), Dt_2.v);
+  D_101.v = vec_mul(vec_mul(rx_r.v, rz_r.v), Dt_3.v);
+  D_110.v = vec_mul(vec_mul(rx_r.v, ry_r.v), Dt_3.v);
+  D_200.v = vec_add(vec_mul(rx_r2.v, Dt_3.v), Dt_2.v);
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 2
+  /* 3rd order derivatives */
+  Dt_3.v = vec_mul(Dt_3.v, r_inv.v);
+  D_003.v = vec_fma(vec_mul(vec_set1(3.f), rz_r.v), Dt_3.v,
+                    vec_mul(rz_r3.v, Dt_4.v));
+  D_012.v = vec_fma(ry_r.v, Dt_3.v, vec_mul(vec_mul(ry_r.v, rz_r2.v), Dt_4.v));
+  D_021.v = vec_fma(rz_r.v, Dt_3.v, vec_mul(vec_mul(ry_r2.v, rz_r.v), Dt_4.v));
+  D_030.v = vec_fma(vec_mul(vec_set1(3.f), ry_r.v), Dt_3.v,
+                    vec_mul(ry_r3.v, Dt_4.v));
+  D_102.v = vec_fma(rx_r.v, Dt_3.v, vec_mul(vec_mul(rx_r.v, rz_r2.v), Dt_4.v));
+  D_111.v = vec_mul(vec_mul(vec_mul(rx_r.v, ry_r.v), rz_r.v), Dt_4.v);
+  D_120.v = vec_fma(rx_r.v, Dt_3.v, vec_mul(vec_mul(rx_r.v, ry_r2.v), Dt_4.v));
+  D_201.v = vec_fma(rz_r.v, Dt_3.v, vec_mul(vec_mul(rx_r2.v, rz_r.v), Dt_4.v));
+  D_210.v = vec_fma(ry_r.v, Dt_3.v, vec_mul(vec_mul(rx_r2.v, ry_r.v), Dt_4.v));
+  D_300.v = vec_fma(vec_mul(vec_set1(3.f), rx_r.v), Dt_3.v,
+                    vec_mul(rx_r3.v, Dt_4.v));
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 3
+  /* 4th order derivatives */
+  Dt_3.v = vec_mul(Dt_3.v, r_inv.v);
+  Dt_4.v = vec_mul(Dt_4.v, r_inv.v);
+  D_004.v = vec_fma(vec_set1(3.f), Dt_3.v,
+                    vec_fma(vec_mul(vec_set1(6.f), rz_r2.v), Dt_4.v,
+                            vec_mul(rz_r4.v, Dt_5.v)));
+  D_013.v = vec_fma(vec_mul(vec_mul(vec_set1(3.f), ry_r.v), rz_r.v), Dt_4.v,
+                    vec_mul(vec_mul(ry_r.v, rz_r3.v), Dt_5.v));
+  D_022.v = vec_add(vec_fma(rz_r2.v, Dt_4.v,
+                            vec_fma(ry_r2.v, Dt_4.v,
+                                    vec_mul(vec_mul(ry_r2.v, rz_r2.v),
+                                            Dt_5.v))),
+                    Dt_3.v);
+  D_031.v = vec_fma(vec_mul(vec_mul(vec_set1(3.f), ry_r.v), rz_r.v), Dt_4.v,
+                    vec_mul(vec_mul(ry_r3.v, rz_r.v), Dt_5.v));
+  D_040.v = vec_fma(vec_set1(3.f), Dt_3.v,
+                    vec_fma(vec_mul(vec_set1(6.f), ry_r2.v), Dt_4.v,
+                            vec_mul(ry_r4.v, Dt_5.v)));
+  D_103.v = vec_fma(vec_mul(vec_mul(vec_set1(3.f), rx_r.v), rz_r.v), Dt_4.v,
+                    vec_mul(vec_mul(rx_r.v, rz_r3.v), Dt_5.v));
+  D_112.v = vec_fma(vec_mul(rx_r.v, ry_r.v), Dt_4.v,
+                    vec_mul(vec_mul(vec_mul(rx_r.v, ry_r.v), rz_r2.v), Dt_5.v));
+  D_121.v = vec_fma(vec_mul(rx_r.v, rz_r.v), Dt_4.v,
+                    vec_mul(vec_mul(vec_mul(rx_r.v, ry_r2.v), rz_r.v), Dt_5.v));
+  D_130.v = vec_fma(vec_mul(vec_mul(vec_set1(3.f), rx_r.v), ry_r.v), Dt_4.v,
+                    vec_mul(vec_mul(rx_r.v, ry_r3.v), Dt_5.v));
+  D_202.v = vec_add(vec_fma(rz_r2.v, Dt_4.v,
+                            vec_fma(rx_r2.v, Dt_4.v,
+                                    vec_mul(vec_mul(rx_r2.v, rz_r2.v),
+                                            Dt_5.v))),
+                    Dt_3.v);
+  D_211.v = vec_fma(vec_mul(ry_r.v, rz_r.v), Dt_4.v,
+                    vec_mul(vec_mul(vec_mul(rx_r2.v, ry_r.v), rz_r.v), Dt_5.v));
+  D_220.v = vec_add(vec_fma(ry_r2.v, Dt_4.v,
+                            vec_fma(rx_r2.v, Dt_4.v,
+                                    vec_mul(vec_mul(rx_r2.v, ry_r2.v),
+                                            Dt_5.v))),
+                    Dt_3.v);
+  D_301.v = vec_fma(vec_mul(vec_mul(vec_set1(3.f), rx_r.v), rz_r.v), Dt_4.v,
+                    vec_mul(vec_mul(rx_r3.v, rz_r.v), Dt_5.v));
+  D_310.v = vec_fma(vec_mul(vec_mul(vec_set1(3.f), rx_r.v), ry_r.v), Dt_4.v,
+                    vec_mul(vec_mul(rx_r3.v, ry_r.v), Dt_5.v));
+  D_400.v = vec_fma(vec_set1(3.f), Dt_3.v,
+                    vec_fma(vec_mul(vec_set1(6.f), rx_r2.v), Dt_4.v,
+                            vec_mul(rx_r4.v, Dt_5.v)));
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 4
+  /* 5th order derivatives */
+  Dt_4.v = vec_mul(Dt_4.v, r_inv.v);
+  Dt_5.v = vec_mul(Dt_5.v, r_inv.v);
+  D_005.v = vec_fma(vec_mul(vec_set1(15.f), rz_r.v), Dt_4.v,
+                    vec_fma(vec_mul(vec_set1(10.f), rz_r3.v), Dt_5.v,
+                            vec_mul(rz_r5.v, Dt_6.v)));
+  D_014.v = vec_fma(vec_mul(vec_set1(3.f), ry_r.v), Dt_4.v,
+                    vec_fma(vec_mul(vec_mul(vec_set1(6.f), ry_r.v), rz_r2.v),
+                            Dt_5.v, vec_mul(vec_mul(ry_r.v, rz_r4.v), Dt_6.v)));
+  D_023.v = vec_fma(vec_mul(vec_set1(3.f), rz_r.v), Dt_4.v,
+                    vec_fma(rz_r3.v, Dt_5.v,
+                            vec_fma(vec_mul(vec_mul(vec_set1(3.f), ry_r2.v),
+                                            rz_r.v),
+                                    Dt_5.v,
+                                    vec_mul(vec_mul(ry_r2.v, rz_r3.v),
+                                            Dt_6.v))));
+  D_032.v = vec_fma(vec_mul(vec_set1(3.f), ry_r.v), Dt_4.v,
+                    vec_fma(vec_mul(vec_mul(vec_set1(3.f), ry_r.v), rz_r2.v),
+                            Dt_5.v,
+                            vec_fma(ry_r3.v, Dt_5.v,
+                                    vec_mul(vec_mul(ry_r3.v, rz_r2.v),
+                                            Dt_6.v))));
+  D_041.v = vec_fma(vec_mul(vec_set1(3.f), rz_r.v), Dt_4.v,
+                    vec_fma(vec_mul(vec_mul(vec_set1(6.f), ry_r2.v), rz_r.v),
+                            Dt_5.v, vec_mul(vec_mul(ry_r4.v, rz_r.v), Dt_6.v)));
+  D_050.v = vec_fma(vec_mul(vec_set1(15.f), ry_r.v), Dt_4.v,
+                    vec_fma(vec_mul(vec_set1(10.f), ry_r3.v), Dt_5.v,
+                            vec_mul(ry_r5.v, Dt_6.v)));
+  D_104.v = vec_fma(vec_mul(vec_set1(3.f), rx_r.v), Dt_4.v,
+                    vec_fma(vec_mul(vec_mul(vec_set1(6.f), rx_r.v), rz_r2.v),
+                            Dt_5.v, vec_mul(vec_mul(rx_r.v, rz_r4.v), Dt_6.v)));
+  D_113.v = vec_fma(vec_mul(vec_mul(vec_mul(vec_set1(3.f), rx_r.v), ry_r.v),
+                            rz_r.v),
+                    Dt_5.v,
+                    vec_mul(vec_mul(vec_mul(rx_r.v, ry_r.v), rz_r3.v), Dt_6.v));
+  D_122.v = vec_fma(rx_r.v, Dt_4.v,
+                    vec_fma(vec_mul(rx_r.v, rz_r2.v), Dt_5.v,
+                            vec_fma(vec_mul(rx_r.v, ry_r2.v), Dt_5.v,
+                                    vec_mul(vec_mul(vec_mul(rx_r.v, ry_r2.v),
+                                                    rz_r2.v),
+                                            Dt_6.v))));
+  D_131.v = vec_fma(vec_mul(vec_mul(vec_mul(vec_set1(3.f), rx_r.v), ry_r.v),
+                            rz_r.v),
+                    Dt_5.v,
+                    vec_mul(vec_mul(vec_mul(rx_r.v, ry_r3.v), rz_r.v), Dt_6.v));
+  D_140.v = vec_fma(vec_mul(vec_set1(3.f), rx_r.v), Dt_4.v,
+                    vec_fma(vec_mul(vec_mul(vec_set1(6.f), rx_r.v), ry_r2.v),
+                            Dt_5.v, vec_mul(vec_mul(rx_r.v, ry_r4.v), Dt_6.v)));
+  D_203.v = vec_fma(vec_mul(vec_set1(3.f), rz_r.v), Dt_4.v,
+                    vec_fma(rz_r3.v, Dt_5.v,
+                            vec_fma(vec_mul(vec_mul(vec_set1(3.f), rx_r2.v),
+                                            rz_r.v),
+                                    Dt_5.v,
+                                    vec_mul(vec_mul(rx_r2.v, rz_r3.v),
+                                            Dt_6.v))));
+  D_212.v = vec_fma(ry_r.v, Dt_4.v,
+                    vec_fma(vec_mul(ry_r.v, rz_r2.v), Dt_5.v,
+                            vec_fma(vec_mul(rx_r2.v, ry_r.v), Dt_5.v,
+                                    vec_mul(vec_mul(vec_mul(rx_r2.v, ry_r.v),
+                                                    rz_r2.v),
+                                            Dt_6.v))));
+  D_221.v = vec_fma(rz_r.v, Dt_4.v,
+                    vec_fma(vec_mul(ry_r2.v, rz_r.v), Dt_5.v,
+                            vec_fma(vec_mul(rx_r2.v, rz_r.v), Dt_5.v,
+                                    vec_mul(vec_mul(vec_mul(rx_r2.v, ry_r2.v),
+                                                    rz_r.v),
+                                            Dt_6.v))));
+  D_230.v = vec_fma(vec_mul(vec_set1(3.f), ry_r.v), Dt_4.v,
+                    vec_fma(ry_r3.v, Dt_5.v,
+                            vec_fma(vec_mul(vec_mul(vec_set1(3.f), rx_r2.v),
+                                            ry_r.v),
+                                    Dt_5.v,
+                                    vec_mul(vec_mul(rx_r2.v, ry_r3.v),
+                                            Dt_6.v))));
+  D_302.v = vec_fma(vec_mul(vec_set1(3.f), rx_r.v), Dt_4.v,
+                    vec_fma(vec_mul(vec_mul(vec_set1(3.f), rx_r.v), rz_r2.v),
+                            Dt_5.v,
+                            vec_fma(rx_r3.v, Dt_5.v,
+                                    vec_mul(vec_mul(rx_r3.v, rz_r2.v),
+                                            Dt_6.v))));
+  D_311.v = vec_fma(vec_mul(vec_mul(vec_mul(vec_set1(3.f), rx_r.v), ry_r.v),
+                            rz_r.v),
+                    Dt_5.v,
+                    vec_mul(vec_mul(vec_mul(rx_r3.v, ry_r.v), rz_r.v), Dt_6.v));
+  D_320.v = vec_fma(vec_mul(vec_set1(3.f), rx_r.v), Dt_4.v,
+                    vec_fma(vec_mul(vec_mul(vec_set1(3.f), rx_r.v), ry_r2.v),
+                            Dt_5.v,
+                            vec_fma(rx_r3.v, Dt_5.v,
+                                    vec_mul(vec_mul(rx_r3.v, ry_r2.v),
+                                            Dt_6.v))));
+  D_401.v = vec_fma(vec_mul(vec_set1(3.f), rz_r.v), Dt_4.v,
+                    vec_fma(vec_mul(vec_mul(vec_set1(6.f), rx_r2.v), rz_r.v),
+                            Dt_5.v, vec_mul(vec_mul(rx_r4.v, rz_r.v), Dt_6.v)));
+  D_410.v = vec_fma(vec_mul(vec_set1(3.f), ry_r.v), Dt_4.v,
+                    vec_fma(vec_mul(vec_mul(vec_set1(6.f), rx_r2.v), ry_r.v),
+                            Dt_5.v, vec_mul(vec_mul(rx_r4.v, ry_r.v), Dt_6.v)));
+  D_500.v = vec_fma(vec_mul(vec_set1(15.f), rx_r.v), Dt_4.v,
+                    vec_fma(vec_mul(vec_set1(10.f), rx_r3.v), Dt_5.v,
+                            vec_mul(rx_r5.v, Dt_6.v)));
+#endif
+
+  /* Gather the multipoles */
+  for (int k = 0; k < VEC_SIZE; k++) {
+
+    const struct multipole *m = b->m[first + k];
+
+    M_000.f[k] = m->M_000;
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 1
+    M_002.f[k] = m->M_002;
+    M_011.f[k] = m->M_011;
+    M_020.f[k] = m->M_020;
+    M_101.f[k] = m->M_101;
+    M_110.f[k] = m->M_110;
+    M_200.f[k] = m->M_200;
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 2
+    M_003.f[k] = m->M_003;
+    M_012.f[k] = m->M_012;
+    M_021.f[k] = m->M_021;
+    M_030.f[k] = m->M_030;
+    M_102.f[k] = m->M_102;
+    M_111.f[k] = m->M_111;
+    M_120.f[k] = m->M_120;
+    M_201.f[k] = m->M_201;
+    M_210.f[k] = m->M_210;
+    M_300.f[k] = m->M_300;
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 3
+    M_004.f[k] = m->M_004;
+    M_013.f[k] = m->M_013;
+    M_022.f[k] = m->M_022;
+    M_031.f[k] = m->M_031;
+    M_040.f[k] = m->M_040;
+    M_103.f[k] = m->M_103;
+    M_112.f[k] = m->M_112;
+    M_121.f[k] = m->M_121;
+    M_130.f[k] = m->M_130;
+    M_202.f[k] = m->M_202;
+    M_211.f[k] = m->M_211;
+    M_220.f[k] = m->M_220;
+    M_301.f[k] = m->M_301;
+    M_310.f[k] = m->M_310;
+    M_400.f[k] = m->M_400;
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 4
+    M_005.f[k] = m->M_005;
+    M_014.f[k] = m->M_014;
+    M_023.f[k] = m->M_023;
+    M_032.f[k] = m->M_032;
+    M_041.f[k] = m->M_041;
+    M_050.f[k] = m->M_050;
+    M_104.f[k] = m->M_104;
+    M_113.f[k] = m->M_113;
+    M_122.f[k] = m->M_122;
+    M_131.f[k] = m->M_131;
+    M_140.f[k] = m->M_140;
+    M_203.f[k] = m->M_203;
+    M_212.f[k] = m->M_212;
+    M_221.f[k] = m->M_221;
+    M_230.f[k] = m->M_230;
+    M_302.f[k] = m->M_302;
+    M_311.f[k] = m->M_311;
+    M_320.f[k] = m->M_320;
+    M_401.f[k] = m->M_401;
+    M_410.f[k] = m->M_410;
+    M_500.f[k] = m->M_500;
+#endif
+  }
+
+  /* Do the M2L tensor multiplication (the dipole terms are zero when
+   * using the CoM) */
+  /* 0th order terms */
+  F_000.v = vec_mul(M_000.v, D_000.v);
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 0
+  /* 1st order terms */
+  F_001.v = vec_mul(M_000.v, D_001.v);
+  F_010.v = vec_mul(M_000.v, D_010.v);
+  F_100.v = vec_mul(M_000.v, D_100.v);
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 1
+  /* 2nd order terms */
+  F_000.v = vec_fma(M_002.v, D_002.v,
+                    vec_fma(M_011.v, D_011.v,
+                            vec_fma(M_020.v, D_020.v, F_000.v)));
+  F_000.v = vec_fma(M_101.v, D_101.v,
+                    vec_fma(M_110.v, D_110.v,
+                            vec_fma(M_200.v, D_200.v, F_000.v)));
+  F_002.v = vec_mul(M_000.v, D_002.v);
+  F_011.v = vec_mul(M_000.v, D_011.v);
+  F_020.v = vec_mul(M_000.v, D_020.v);
+  F_101.v = vec_mul(M_000.v, D_101.v);
+  F_110.v = vec_mul(M_000.v, D_110.v);
+  F_200.v = vec_mul(M_000.v, D_200.v);
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 2
+  /* 3rd order terms */
+  F_000.v = vec_fma(M_003.v, D_003.v,
+                    vec_fma(M_012.v, D_012.v,
+                            vec_fma(M_021.v, D_021.v, F_000.v)));
+  F_000.v = vec_fma(M_030.v, D_030.v,
+                    vec_fma(M_102.v, D_102.v,
+                            vec_fma(M_111.v, D_111.v, F_000.v)));
+  F_000.v = vec_fma(M_120.v, D_120.v,
+                    vec_fma(M_201.v, D_201.v,
+                            vec_fma(M_210.v, D_210.v, F_000.v)));
+  F_000.v = vec_fma(M_300.v, D_300.v, F_000.v);
+  F_001.v = vec_fma(M_002.v, D_003.v,
+                    vec_fma(M_011.v, D_012.v,
+                            vec_fma(M_020.v, D_021.v, F_001.v)));
+  F_001.v = vec_fma(M_101.v, D_102.v,
+                    vec_fma(M_110.v, D_111.v,
+                            vec_fma(M_200.v, D_201.v, F_001.v)));
+  F_010.v = vec_fma(M_002.v, D_012.v,
+                    vec_fma(M_011.v, D_021.v,
+                            vec_fma(M_020.v, D_030.v, F_010.v)));
+  F_010.v = vec_fma(M_101.v, D_111.v,
+                    vec_fma(M_110.v, D_120.v,
+                            vec_fma(M_200.v, D_210.v, F_010.v)));
+  F_100.v = vec_fma(M_002.v, D_102.v,
+                    vec_fma(M_011.v, D_111.v,
+                            vec_fma(M_020.v, D_120.v, F_100.v)));
+  F_100.v = vec_fma(M_101.v, D_201.v,
+                    vec_fma(M_110.v, D_210.v,
+                            vec_fma(M_200.v, D_300.v, F_100.v)));
+  F_003.v = vec_mul(M_000.v, D_003.v);
+  F_012.v = vec_mul(M_000.v, D_012.v);
+  F_021.v = vec_mul(M_000.v, D_021.v);
+  F_030.v = vec_mul(M_000.v, D_030.v);
+  F_102.v = vec_mul(M_000.v, D_102.v);
+  F_111.v = vec_mul(M_000.v, D_111.v);
+  F_120.v = vec_mul(M_000.v, D_120.v);
+  F_201.v = vec_mul(M_000.v, D_201.v);
+  F_210.v = vec_mul(M_000.v, D_210.v);
+  F_300.v = vec_mul(M_000.v, D_300.v);
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 3
+  /* 4th order terms */
+  F_000.v = vec_fma(M_004.v, D_004.v,
+                    vec_fma(M_013.v, D_013.v,
+                            vec_fma(M_022.v, D_022.v, F_000.v)));
+  F_000.v = vec_fma(M_031.v, D_031.v,
+                    vec_fma(M_040.v, D_040.v,
+                            vec_fma(M_103.v, D_103.v, F_000.v)));
+  F_000.v = vec_fma(M_112.v, D_112.v,
+                    vec_fma(M_121.v, D_121.v,
+                            vec_fma(M_130.v, D_130.v, F_000.v)));
+  F_000.v = vec_fma(M_202.v, D_202.v,
+                    vec_fma(M_211.v, D_211.v,
+                            vec_fma(M_220.v, D_220.v, F_000.v)));
+  F_000.v = vec_fma(M_301.v, D_301.v,
+                    vec_fma(M_310.v, D_310.v,
+                            vec_fma(M_400.v, D_400.v, F_000.v)));
+  F_001.v = vec_fma(M_003.v, D_004.v,
+                    vec_fma(M_012.v, D_013.v,
+                            vec_fma(M_021.v, D_022.v, F_001.v)));
+  F_001.v = vec_fma(M_030.v, D_031.v,
+                    vec_fma(M_102.v, D_103.v,
+                            vec_fma(M_111.v, D_112.v, F_001.v)));
+  F_001.v = vec_fma(M_120.v, D_121.v,
+                    vec_fma(M_201.v, D_202.v,
+                            vec_fma(M_210.v, D_211.v, F_001.v)));
+  F_001.v = vec_fma(M_300.v, D_301.v, F_001.v);
+  F_010.v = vec_fma(M_003.v, D_013.v,
+                    vec_fma(M_012.v, D_022.v,
+                            vec_fma(M_021.v, D_031.v, F_010.v)));
+  F_010.v = vec_fma(M_030.v, D_040.v,
+                    vec_fma(M_102.v, D_112.v,
+                            vec_fma(M_111.v, D_121.v, F_010.v)));
+  F_010.v = vec_fma(M_120.v, D_130.v,
+                    vec_fma(M_201.v, D_211.v,
+                            vec_fma(M_210.v, D_220.v, F_010.v)));
+  F_010.v = vec_fma(M_300.v, D_310.v, F_010.v);
+  F_100.v = vec_fma(M_003.v, D_103.v,
+                    vec_fma(M_012.v, D_112.v,
+                            vec_fma(M_021.v, D_121.v, F_100.v)));
+  F_100.v = vec_fma(M_030.v, D_130.v,
+                    vec_fma(M_102.v, D_202.v,
+                            vec_fma(M_111.v, D_211.v, F_100.v)));
+  F_100.v = vec_fma(M_120.v, D_220.v,
+                    vec_fma(M_201.v, D_301.v,
+                            vec_fma(M_210.v, D_310.v, F_100.v)));
+  F_100.v = vec_fma(M_300.v, D_400.v, F_100.v);
+  F_002.v = vec_fma(M_002.v, D_004.v,
+                    vec_fma(M_011.v, D_013.v,
+                            vec_fma(M_020.v, D_022.v, F_002.v)));
+  F_002.v = vec_fma(M_101.v, D_103.v,
+                    vec_fma(M_110.v, D_112.v,
+                            vec_fma(M_200.v, D_202.v, F_002.v)));
+  F_011.v = vec_fma(M_002.v, D_013.v,
+                    vec_fma(M_011.v, D_022.v,
+                            vec_fma(M_020.v, D_031.v, F_011.v)));
+  F_011.v = vec_fma(M_101.v, D_112.v,
+                    vec_fma(M_110.v, D_121.v,
+                            vec_fma(M_200.v, D_211.v, F_011.v)));
+  F_020.v = vec_fma(M_002.v, D_022.v,
+                    vec_fma(M_011.v, D_031.v,
+                            vec_fma(M_020.v, D_040.v, F_020.v)));
+  F_020.v = vec_fma(M_101.v, D_121.v,
+                    vec_fma(M_110.v, D_130.v,
+                            vec_fma(M_200.v, D_220.v, F_020.v)));
+  F_101.v = vec_fma(M_002.v, D_103.v,
+                    vec_fma(M_011.v, D_112.v,
+                            vec_fma(M_020.v, D_121.v, F_101.v)));
+  F_101.v = vec_fma(M_101.v, D_202.v,
+                    vec_fma(M_110.v, D_211.v,
+                            vec_fma(M_200.v, D_301.v, F_101.v)));
+  F_110.v = vec_fma(M_002.v, D_112.v,
+                    vec_fma(M_011.v, D_121.v,
+                            vec_fma(M_020.v, D_130.v, F_110.v)));
+  F_110.v = vec_fma(M_101.v, D_211.v,
+                    vec_fma(M_110.v, D_220.v,
+                            vec_fma(M_200.v, D_310.v, F_110.v)));
+  F_200.v = vec_fma(M_002.v, D_202.v,
+                    vec_fma(M_011.v, D_211.v,
+                            vec_fma(M_020.v, D_220.v, F_200.v)));
+  F_200.v = vec_fma(M_101.v, D_301.v,
+                    vec_fma(M_110.v, D_310.v,
+                            vec_fma(M_200.v, D_400.v, F_200.v)));
+  F_004.v = vec_mul(M_000.v, D_004.v);
+  F_013.v = vec_mul(M_000.v, D_013.v);
+  F_022.v = vec_mul(M_000.v, D_022.v);
+  F_031.v = vec_mul(M_000.v, D_031.v);
+  F_040.v = vec_mul(M_000.v, D_040.v);
+  F_103.v = vec_mul(M_000.v, D_103.v);
+  F_112.v = vec_mul(M_000.v, D_112.v);
+  F_121.v = vec_mul(M_000.v, D_121.v);
+  F_130.v = vec_mul(M_000.v, D_130.v);
+  F_202.v = vec_mul(M_000.v, D_202.v);
+  F_211.v = vec_mul(M_000.v, D_211.v);
+  F_220.v = vec_mul(M_000.v, D_220.v);
+  F_301.v = vec_mul(M_000.v, D_301.v);
+  F_310.v = vec_mul(M_000.v, D_310.v);
+  F_400.v = vec_mul(M_000.v, D_400.v);
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 4
+  /* 5th order terms */
+  F_000.v = vec_fma(M_005.v, D_005.v,
+                    vec_fma(M_014.v, D_014.v,
+                            vec_fma(M_023.v, D_023.v, F_000.v)));
+  F_000.v = vec_fma(M_032.v, D_032.v,
+                    vec_fma(M_041.v, D_041.v,
+                            vec_fma(M_050.v, D_050.v, F_000.v)));
+  F_000.v = vec_fma(M_104.v, D_104.v,
+                    vec_fma(M_113.v, D_113.v,
+                            vec_fma(M_122.v, D_122.v, F_000.v)));
+  F_000.v = vec_fma(M_131.v, D_131.v,
+                    vec_fma(M_140.v, D_140.v,
+                            vec_fma(M_203.v, D_203.v, F_000.v)));
+  F_000.v = vec_fma(M_212.v, D_212.v,
+                    vec_fma(M_221.v, D_221.v,
+                            vec_fma(M_230.v, D_230.v, F_000.v)));
+  F_000.v = vec_fma(M_302.v, D_302.v,
+                    vec_fma(M_311.v, D_311.v,
+                            vec_fma(M_320.v, D_320.v, F_000.v)));
+  F_000.v = vec_fma(M_401.v, D_401.v,
+                    vec_fma(M_410.v, D_410.v,
+                            vec_fma(M_500.v, D_500.v, F_000.v)));
+  F_001.v = vec_fma(M_004.v, D_005.v,
+                    vec_fma(M_013.v, D_014.v,
+                            vec_fma(M_022.v, D_023.v, F_001.v)));
+  F_001.v = vec_fma(M_031.v, D_032.v,
+                    vec_fma(M_040.v, D_041.v,
+                            vec_fma(M_103.v, D_104.v, F_001.v)));
+  F_001.v = vec_fma(M_112.v, D_113.v,
+                    vec_fma(M_121.v, D_122.v,
+                            vec_fma(M_130.v, D_131.v, F_001.v)));
+  F_001.v = vec_fma(M_202.v, D_203.v,
+                    vec_fma(M_211.v, D_212.v,
+                            vec_fma(M_220.v, D_221.v, F_001.v)));
+  F_001.v = vec_fma(M_301.v, D_302.v,
+                    vec_fma(M_310.v, D_311.v,
+                            vec_fma(M_400.v, D_401.v, F_001.v)));
+  F_010.v = vec_fma(M_004.v, D_014.v,
+                    vec_fma(M_013.v, D_023.v,
+                            vec_fma(M_022.v, D_032.v, F_010.v)));
+  F_010.v = vec_fma(M_031.v, D_041.v,
+                    vec_fma(M_040.v, D_050.v,
+                            vec_fma(M_103.v, D_113.v, F_010.v)));
+  F_010.v = vec_fma(M_112.v, D_122.v,
+                    vec_fma(M_121.v, D_131.v,
+                            vec_fma(M_130.v, D_140.v, F_010.v)));
+  F_010.v = vec_fma(M_202.v, D_212.v,
+                    vec_fma(M_211.v, D_221.v,
+                            vec_fma(M_220.v, D_230.v, F_010.v)));
+  F_010.v = vec_fma(M_301.v, D_311.v,
+                    vec_fma(M_310.v, D_320.v,
+                            vec_fma(M_400.v, D_410.v, F_010.v)));
+  F_100.v = vec_fma(M_004.v, D_104.v,
+                    vec_fma(M_013.v, D_113.v,
+                            vec_fma(M_022.v, D_122.v, F_100.v)));
+  F_100.v = vec_fma(M_031.v, D_131.v,
+                    vec_fma(M_040.v, D_140.v,
+                            vec_fma(M_103.v, D_203.v, F_100.v)));
+  F_100.v = vec_fma(M_112.v, D_212.v,
+                    vec_fma(M_121.v, D_221.v,
+                            vec_fma(M_130.v, D_230.v, F_100.v)));
+  F_100.v = vec_fma(M_202.v, D_302.v,
+                    vec_fma(M_211.v, D_311.v,
+                            vec_fma(M_220.v, D_320.v, F_100.v)));
+  F_100.v = vec_fma(M_301.v, D_401.v,
+                    vec_fma(M_310.v, D_410.v,
+                            vec_fma(M_400.v, D_500.v, F_100.v)));
+  F_002.v = vec_fma(M_003.v, D_005.v,
+                    vec_fma(M_012.v, D_014.v,
+                            vec_fma(M_021.v, D_023.v, F_002.v)));
+  F_002.v = vec_fma(M_030.v, D_032.v,
+                    vec_fma(M_102.v, D_104.v,
+                            vec_fma(M_111.v, D_113.v, F_002.v)));
+  F_002.v = vec_fma(M_120.v, D_122.v,
+                    vec_fma(M_201.v, D_203.v,
+                            vec_fma(M_210.v, D_212.v, F_002.v)));
+  F_002.v = vec_fma(M_300.v, D_302.v, F_002.v);
+  F_011.v = vec_fma(M_003.v, D_014.v,
+                    vec_fma(M_012.v, D_023.v,
+                            vec_fma(M_021.v, D_032.v, F_011.v)));
+  F_011.v = vec_fma(M_030.v, D_041.v,
+                    vec_fma(M_102.v, D_113.v,
+                            vec_fma(M_111.v, D_122.v, F_011.v)));
+  F_011.v = vec_fma(M_120.v, D_131.v,
+                    vec_fma(M_201.v, D_212.v,
+                            vec_fma(M_210.v, D_221.v, F_011.v)));
+  F_011.v = vec_fma(M_300.v, D_311.v, F_011.v);
+  F_020.v = vec_fma(M_003.v, D_023.v,
+                    vec_fma(M_012.v, D_032.v,
+                            vec_fma(M_021.v, D_041.v, F_020.v)));
+  F_020.v = vec_fma(M_030.v, D_050.v,
+                    vec_fma(M_102.v, D_122.v,
+                            vec_fma(M_111.v, D_131.v, F_020.v)));
+  F_020.v = vec_fma(M_120.v, D_140.v,
+                    vec_fma(M_201.v, D_221.v,
+                            vec_fma(M_210.v, D_230.v, F_020.v)));
+  F_020.v = vec_fma(M_300.v, D_320.v, F_020.v);
+  F_101.v = vec_fma(M_003.v, D_104.v,
+                    vec_fma(M_012.v, D_113.v,
+                            vec_fma(M_021.v, D_122.v, F_101.v)));
+  F_101.v = vec_fma(M_030.v, D_131.v,
+                    vec_fma(M_102.v, D_203.v,
+                            vec_fma(M_111.v, D_212.v, F_101.v)));
+  F_101.v = vec_fma(M_120.v, D_221.v,
+                    vec_fma(M_201.v, D_302.v,
+                            vec_fma(M_210.v, D_311.v, F_101.v)));
+  F_101.v = vec_fma(M_300.v, D_401.v, F_101.v);
+  F_110.v = vec_fma(M_003.v, D_113.v,
+                    vec_fma(M_012.v, D_122.v,
+                            vec_fma(M_021.v, D_131.v, F_110.v)));
+  F_110.v = vec_fma(M_030.v, D_140.v,
+                    vec_fma(M_102.v, D_212.v,
+                            vec_fma(M_111.v, D_221.v, F_110.v)));
+  F_110.v = vec_fma(M_120.v, D_230.v,
+                    vec_fma(M_201.v, D_311.v,
+                            vec_fma(M_210.v, D_320.v, F_110.v)));
+  F_110.v = vec_fma(M_300.v, D_410.v, F_110.v);
+  F_200.v = vec_fma(M_003.v, D_203.v,
+                    vec_fma(M_012.v, D_212.v,
+                            vec_fma(M_021.v, D_221.v, F_200.v)));
+  F_200.v = vec_fma(M_030.v, D_230.v,
+                    vec_fma(M_102.v, D_302.v,
+                            vec_fma(M_111.v, D_311.v, F_200.v)));
+  F_200.v = vec_fma(M_120.v, D_320.v,
+                    vec_fma(M_201.v, D_401.v,
+                            vec_fma(M_210.v, D_410.v, F_200.v)));
+  F_200.v = vec_fma(M_300.v, D_500.v, F_200.v);
+  F_003.v = vec_fma(M_002.v, D_005.v,
+                    vec_fma(M_011.v, D_014.v,
+                            vec_fma(M_020.v, D_023.v, F_003.v)));
+  F_003.v = vec_fma(M_101.v, D_104.v,
+                    vec_fma(M_110.v, D_113.v,
+                            vec_fma(M_200.v, D_203.v, F_003.v)));
+  F_012.v = vec_fma(M_002.v, D_014.v,
+                    vec_fma(M_011.v, D_023.v,
+                            vec_fma(M_020.v, D_032.v, F_012.v)));
+  F_012.v = vec_fma(M_101.v, D_113.v,
+                    vec_fma(M_110.v, D_122.v,
+                            vec_fma(M_200.v, D_212.v, F_012.v)));
+  F_021.v = vec_fma(M_002.v, D_023.v,
+                    vec_fma(M_011.v, D_032.v,
+                            vec_fma(M_020.v, D_041.v, F_021.v)));
+  F_021.v = vec_fma(M_101.v, D_122.v,
+                    vec_fma(M_110.v, D_131.v,
+                            vec_fma(M_200.v, D_221.v, F_021.v)));
+  F_030.v = vec_fma(M_002.v, D_032.v,
+                    vec_fma(M_011.v, D_041.v,
+                            vec_fma(M_020.v, D_050.v, F_030.v)));
+  F_030.v = vec_fma(M_101.v, D_131.v,
+                    vec_fma(M_110.v, D_140.v,
+                            vec_fma(M_200.v, D_230.v, F_030.v)));
+  F_102.v = vec_fma(M_002.v, D_104.v,
+                    vec_fma(M_011.v, D_113.v,
+                            vec_fma(M_020.v, D_122.v, F_102.v)));
+  F_102.v = vec_fma(M_101.v, D_203.v,
+                    vec_fma(M_110.v, D_212.v,
+                            vec_fma(M_200.v, D_302.v, F_102.v)));
+  F_111.v = vec_fma(M_002.v, D_113.v,
+                    vec_fma(M_011.v, D_122.v,
+                            vec_fma(M_020.v, D_131.v, F_111.v)));
+  F_111.v = vec_fma(M_101.v, D_212.v,
+                    vec_fma(M_110.v, D_221.v,
+                            vec_fma(M_200.v, D_311.v, F_111.v)));
+  F_120.v = vec_fma(M_002.v, D_122.v,
+                    vec_fma(M_011.v, D_131.v,
+                            vec_fma(M_020.v, D_140.v, F_120.v)));
+  F_120.v = vec_fma(M_101.v, D_221.v,
+                    vec_fma(M_110.v, D_230.v,
+                            vec_fma(M_200.v, D_320.v, F_120.v)));
+  F_201.v = vec_fma(M_002.v, D_203.v,
+                    vec_fma(M_011.v, D_212.v,
+                            vec_fma(M_020.v, D_221.v, F_201.v)));
+  F_201.v = vec_fma(M_101.v, D_302.v,
+                    vec_fma(M_110.v, D_311.v,
+                            vec_fma(M_200.v, D_401.v, F_201.v)));
+  F_210.v = vec_fma(M_002.v, D_212.v,
+                    vec_fma(M_011.v, D_221.v,
+                            vec_fma(M_020.v, D_230.v, F_210.v)));
+  F_210.v = vec_fma(M_101.v, D_311.v,
+                    vec_fma(M_110.v, D_320.v,
+                            vec_fma(M_200.v, D_410.v, F_210.v)));
+  F_300.v = vec_fma(M_002.v, D_302.v,
+                    vec_fma(M_011.v, D_311.v,
+                            vec_fma(M_020.v, D_320.v, F_300.v)));
+  F_300.v = vec_fma(M_101.v, D_401.v,
+                    vec_fma(M_110.v, D_410.v,
+                            vec_fma(M_200.v, D_500.v, F_300.v)));
+  F_005.v = vec_mul(M_000.v, D_005.v);
+  F_014.v = vec_mul(M_000.v, D_014.v);
+  F_023.v = vec_mul(M_000.v, D_023.v);
+  F_032.v = vec_mul(M_000.v, D_032.v);
+  F_041.v = vec_mul(M_000.v, D_041.v);
+  F_050.v = vec_mul(M_000.v, D_050.v);
+  F_104.v = vec_mul(M_000.v, D_104.v);
+  F_113.v = vec_mul(M_000.v, D_113.v);
+  F_122.v = vec_mul(M_000.v, D_122.v);
+  F_131.v = vec_mul(M_000.v, D_131.v);
+  F_140.v = vec_mul(M_000.v, D_140.v);
+  F_203.v = vec_mul(M_000.v, D_203.v);
+  F_212.v = vec_mul(M_000.v, D_212.v);
+  F_221.v = vec_mul(M_000.v, D_221.v);
+  F_230.v = vec_mul(M_000.v, D_230.v);
+  F_302.v = vec_mul(M_000.v, D_302.v);
+  F_311.v = vec_mul(M_000.v, D_311.v);
+  F_320.v = vec_mul(M_000.v, D_320.v);
+  F_401.v = vec_mul(M_000.v, D_401.v);
+  F_410.v = vec_mul(M_000.v, D_410.v);
+  F_500.v = vec_mul(M_000.v, D_500.v);
+#endif
+
+  /* Scatter the contributions to the field tensors */
+  for (int k = 0; k < VEC_SIZE; k++) {
+
+    struct grav_tensor *l = b->l[first + k];
+    if (l == NULL) continue;
+
+#if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_GRAVITY_FORCE_CHECKS)
+    const struct multipole *m = b->m[first + k];
+#endif
+
+#ifndef SWIFT_TASKS_WITHOUT_ATOMICS
+    lock_lock(b->lock[first + k]);
+#endif
+
+#ifdef SWIFT_DEBUG_CHECKS
+    /* Count all interactions (see gravity_M2L_apply()) */
+    accumulate_add_ll(&l->num_interacted, m->num_gpart);
+#endif
+
+#ifdef SWIFT_GRAVITY_FORCE_CHECKS
+    /* Count tree interactions (see gravity_M2L_apply()) */
+    accumulate_add_ll(&l->num_interacted_tree, m->num_gpart);
+#endif
+
+    /* Record that this tensor has received contributions */
+    l->interacted = 1;
+
+    l->F_000 += F_000.f[k];
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 0
+    l->F_001 += F_001.f[k];
+    l->F_010 += F_010.f[k];
+    l->F_100 += F_100.f[k];
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 1
+    l->F_002 += F_002.f[k];
+    l->F_011 += F_011.f[k];
+    l->F_020 += F_020.f[k];
+    l->F_101 += F_101.f[k];
+    l->F_110 += F_110.f[k];
+    l->F_200 += F_200.f[k];
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 2
+    l->F_003 += F_003.f[k];
+    l->F_012 += F_012.f[k];
+    l->F_021 += F_021.f[k];
+    l->F_030 += F_030.f[k];
+    l->F_102 += F_102.f[k];
+    l->F_111 += F_111.f[k];
+    l->F_120 += F_120.f[k];
+    l->F_201 += F_201.f[k];
+    l->F_210 += F_210.f[k];
+    l->F_300 += F_300.f[k];
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 3
+    l->F_004 += F_004.f[k];
+    l->F_013 += F_013.f[k];
+    l->F_022 += F_022.f[k];
+    l->F_031 += F_031.f[k];
+    l->F_040 += F_040.f[k];
+    l->F_103 += F_103.f[k];
+    l->F_112 += F_112.f[k];
+    l->F_121 += F_121.f[k];
+    l->F_130 += F_130.f[k];
+    l->F_202 += F_202.f[k];
+    l->F_211 += F_211.f[k];
+    l->F_220 += F_220.f[k];
+    l->F_301 += F_301.f[k];
+    l->F_310 += F_310.f[k];
+    l->F_400 += F_400.f[k];
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 4
+    l->F_005 += F_005.f[k];
+    l->F_014 += F_014.f[k];
+    l->F_023 += F_023.f[k];
+    l->F_032 += F_032.f[k];
+    l->F_041 += F_041.f[k];
+    l->F_050 += F_050.f[k];
+    l->F_104 += F_104.f[k];
+    l->F_113 += F_113.f[k];
+    l->F_122 += F_122.f[k];
+    l->F_131 += F_131.f[k];
+    l->F_140 += F_140.f[k];
+    l->F_203 += F_203.f[k];
+    l->F_212 += F_212.f[k];
+    l->F_221 += F_221.f[k];
+    l->F_230 += F_230.f[k];
+    l->F_302 += F_302.f[k];
+    l->F_311 += F_311.f[k];
+    l->F_320 += F_320.f[k];
+    l->F_401 += F_401.f[k];
+    l->F_410 += F_410.f[k];
+    l->F_500 += F_500.f[k];
+#endif
+
+#ifndef SWIFT_TASKS_WITHOUT_ATOMICS
+    if (lock_unlock(b->lock[first + k]) != 0)
+      error("Failed to unlock multipole");
+#endif
+  }
+}
+
+/**
+ * @brief Evaluates all the kernels of a batch and empties it.
+ *
+ * @param b The #gravity_M2L_batch.
+ * @param periodic Is the calculation periodic ?
+ * @param rs_inv The inverse of the gravity mesh-smoothing scale.
+ */
+INLINE static void gravity_M2L_batch_flush(struct gravity_M2L_batch *b,
+                                           const int periodic,
+                                           const float rs_inv) {
+
+  const int count = b->count;
+  if (count == 0) return;
+
+  /* Pad the last vector with copies of the first kernel updating nothing */
+  const int padded = ((count + VEC_SIZE - 1) / VEC_SIZE) * VEC_SIZE;
+  for (int i = count; i < padded; i++) {
+    b->dx[i] = b->dx[0];
+    b->dy[i] = b->dy[0];
+    b->dz[i] = b->dz[0];
+    b->eps[i] = b->eps[0];
+    b->m[i] = b->m[0];
+    b->l[i] = NULL;
+    b->lock[i] = NULL;
+  }
+
+  for (int i = 0; i < padded; i += VEC_SIZE)
+    gravity_M2L_batch_kernel(b, i, periodic, rs_inv);
+
+  b->count = 0;
+}
+
+/**
+ * @brief Adds a kernel to a batch, evaluating the batch first if it is full.
+ *
+ * @param b The #gravity_M2L_batch.
+ * @param l_b The field tensor to compute.
+ * @param lock_b The lock protecting the field tensor.
+ * @param m_a The multipole creating the field.
+ * @param dx The x-component of the distance vector.
+ * @param dy The y-component of the distance vector.
+ * @param dz The z-component of the distance vector.
+ * @param eps The softening length.
+ * @param periodic Is the calculation periodic ?
+ * @param rs_inv The inverse of the gravity mesh-smoothing scale.
+ */
+__attribute__((always_inline)) INLINE static void gravity_M2L_batch_add(
+    struct gravity_M2L_batch *b, struct grav_tensor *l_b,
+    swift_lock_type *lock_b, const struct multipole *m_a, const float dx,
+    const float dy, const float dz, const float eps, const int periodic,
+    const float rs_inv) {
+
+  if (b->count == gravity_M2L_batch_size)
+    gravity_M2L_batch_flush(b, periodic, rs_inv);
+
+  const int i = b->count++;
+  b->dx[i] = dx;
+  b->dy[i] = dy;
+  b->dz[i] = dz;
+  b->eps[i] = eps;
+  b->m[i] = m_a;
+  b->l[i] = l_b;
+  b->lock[i] = lock_b;
+}
+
+/**
+ * @brief Adds the field tensor due to a multipole to a batch.
+ *
+ * Batched equivalent of gravity_M2L_nonsym().
+ *
+ * @param b The #gravity_M2L_batch.
+ * @param l_b The field tensor to compute.
+ * @param lock_b The lock protecting the field tensor.
+ * @param m_a The multipole.
+ * @param pos_b The position of the field tensor.
+ * @param pos_a The position of the multipole.
+ * @param props The #gravity_props of this calculation.
+ * @param periodic Is the calculation periodic ?
+ * @param dim The size of the simulation box.
+ * @param rs_inv The inverse of the gravity mesh-smoothing scale.
+ */
+__attribute__((always_inline)) INLINE static void gravity_M2L_batch_nonsym(
+    struct gravity_M2L_batch *b, struct grav_tensor *l_b,
+    swift_lock_type *lock_b, const struct multipole *m_a,
+    const double pos_b[3], const double pos_a[3],
+    const struct gravity_props *props, const int periodic, const double dim[3],
+    const float rs_inv) {
+
+  /* Compute distance vector */
+  float dx = (float)(pos_b[0] - pos_a[0]);
+  float dy = (float)(pos_b[1] - pos_a[1]);
+  float dz = (float)(pos_b[2] - pos_a[2]);
+
+  /* Apply BC */
+  if (periodic) {
+    dx = nearest(dx, dim[0]);
+    dy = nearest(dy, dim[1]);
+    dz = nearest(dz, dim[2]);
+  }
+
+  gravity_M2L_batch_add(b, l_b, lock_b, m_a, dx, dy, dz, m_a->max_softening,
+                        periodic, rs_inv);
+}
+
+/**
+ * @brief Adds the field tensor due to a multipole and the symmetric
+ * equivalent to a batch.
+ *
+ * Batched equivalent of gravity_M2L_symmetric().
+ *
+ * @param b The #gravity_M2L_batch.
+ * @param l_a The first field tensor to compute.
+ * @param l_b The second field tensor to compute.
+ * @param lock_a The lock protecting the first field tensor.
+ * @param lock_b The lock protecting the second field tensor.
+ * @param m_a The first multipole.
+ * @param m_b The second multipole.
+ * @param pos_a The position of the first m-pole and field tensor.
+ * @param pos_b The position of the second m-pole and field tensor.
+ * @param props The #gravity_props of this calculation.
+ * @param periodic Is the calculation periodic ?
+ * @param dim The size of the simulation box.
+ * @param rs_inv The inverse of the gravity mesh-smoothing scale.
+ */
+__attribute__((always_inline)) INLINE static void gravity_M2L_batch_symmetric(
+    struct gravity_M2L_batch *b, struct grav_tensor *l_a,
+    struct grav_tensor *l_b, swift_lock_type *lock_a, swift_lock_type *lock_b,
+    const struct multipole *m_a, const struct multipole *m_b,
+    const double pos_a[3], const double pos_b[3],
+    const struct gravity_props *props, const int periodic, const double dim[3],
+    const float rs_inv) {
+
+  /* Recover some constants */
+  const float eps = max(m_a->max_softening, m_b->max_softening);
+
+  /* Compute distance vector */
+  float dx = (float)(pos_b[0] - pos_a[0]);
+  float dy = (float)(pos_b[1] - pos_a[1]);
+  float dz = (float)(pos_b[2] - pos_a[2]);
+
+  /* Apply BC */
+  if (periodic) {
+    dx = nearest(dx, dim[0]);
+    dy = nearest(dy, dim[1]);
+    dz = nearest(dz, dim[2]);
+  }
+
+  gravity_M2L_batch_add(b, l_b, lock_b, m_a, dx, dy, dz, eps, periodic,
+                        rs_inv);
+  gravity_M2L_batch_add(b, l_a, lock_a, m_b, -dx, -dy, -dz, eps, periodic,
+                        rs_inv);
+}
+
+#endif /* SWIFT_BATCHED_M2L */
+
+#endif /* SWIFT_MULTIPOLE_BATCH_H */
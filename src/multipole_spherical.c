@@ -0,0 +1,142 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/* Config parameters. */
+#include <config.h>
+
+#ifdef SWIFT_MULTIPOLE_SPHERICAL
+
+/* This object's header. */
+#include "multipole.h"
+
+/* The tables below have been generated by
+ * theory/Multipoles/generate_multipoles/spherical_tables.py for all the
+ * degrees up to multipole_sph_max_order. */
+
+/*! Rotation matrices d^n_{km}(pi/2) for 0 <= k, m <= n */
+const float multipole_sph_rotation[285] = {
+    1.000000000e+00, 0.000000000e+00, 7.071067812e-01, -7.071067812e-01,
+    5.000000000e-01, -5.000000000e-01, 0.000000000e+00, 6.123724357e-01,
+    0.000000000e+00, -5.000000000e-01, 5.000000000e-01, 6.123724357e-01,
+    -5.000000000e-01, 2.500000000e-01, 0.000000000e+00, -4.330127019e-01,
+    0.000000000e+00, 5.590169944e-01, 4.330127019e-01, -1.250000000e-01,
+    -3.952847075e-01, 4.841229183e-01, 0.000000000e+00, 3.952847075e-01,
+    -5.000000000e-01, 3.061862178e-01, -5.590169944e-01, 4.841229183e-01,
+    -3.061862178e-01, 1.250000000e-01, 3.750000000e-01, 0.000000000e+00,
+    -3.952847075e-01, 0.000000000e+00, 5.229125166e-01, 0.000000000e+00,
+    3.750000000e-01, -1.767766953e-01, -3.307189139e-01, 4.677071733e-01,
+    -3.952847075e-01, 1.767766953e-01, 2.500000000e-01, -4.677071733e-01,
+    3.307189139e-01, 0.000000000e+00, -3.307189139e-01, 4.677071733e-01,
+    -3.750000000e-01, 1.767766953e-01, 5.229125166e-01, -4.677071733e-01,
+    3.307189139e-01, -1.767766953e-01, 6.250000000e-02, 0.000000000e+00,
+    3.423265984e-01, 0.000000000e+00, -3.697549864e-01, 0.000000000e+00,
+    4.960783708e-01, -3.423265984e-01, 6.250000000e-02, 3.307189139e-01,
+    -2.025231468e-01, -2.864109809e-01, 4.528555233e-01, 0.000000000e+00,
+    -3.307189139e-01, 2.500000000e-01, 1.530931089e-01, -4.330127019e-01,
+    3.423265984e-01, 3.697549864e-01, -2.025231468e-01, -1.530931089e-01,
+    4.062500000e-01, -3.977475644e-01, 2.096313729e-01, 0.000000000e+00,
+    2.864109809e-01, -4.330127019e-01, 3.977475644e-01, -2.500000000e-01,
+    9.882117688e-02, -4.960783708e-01, 4.528555233e-01, -3.423265984e-01,
+    2.096313729e-01, -9.882117688e-02, 3.125000000e-02, -3.125000000e-01,
+    0.000000000e+00, 3.202172114e-01, 0.000000000e+00, -3.507803800e-01,
+    0.000000000e+00, 4.749588798e-01, 0.000000000e+00, -3.125000000e-01,
+    9.882117688e-02, 2.964635306e-01, -2.165063509e-01, -2.538762001e-01,
+    4.397264775e-01, 3.202172114e-01, -9.882117688e-02, -2.656250000e-01,
+    2.812500000e-01, 8.558164961e-02, -4.014135181e-01, 3.476343041e-01,
+    0.000000000e+00, 2.964635306e-01, -2.812500000e-01, -3.125000000e-02,
+    3.423265984e-01, -4.014135181e-01, 2.317562027e-01, -3.507803800e-01,
+    2.165063509e-01, 8.558164961e-02, -3.423265984e-01, 4.062500000e-01,
+    -2.931509850e-01, 1.269381001e-01, 0.000000000e+00, -2.538762001e-01,
+    4.014135181e-01, -4.014135181e-01, 2.931509850e-01, -1.562500000e-01,
+    5.412658774e-02, 4.749588798e-01, -4.397264775e-01, 3.476343041e-01,
+    -2.317562027e-01, 1.269381001e-01, -5.412658774e-02, 1.562500000e-02,
+    0.000000000e+00, -2.923169833e-01, 0.000000000e+00, 3.037847202e-01,
+    0.000000000e+00, -3.358466447e-01, 0.000000000e+00, 4.576818286e-01,
+    2.923169833e-01, -3.906250000e-02, -2.870495792e-01, 1.217848224e-01,
+    2.692763741e-01, -2.243969784e-01, -2.288409143e-01, 4.281221487e-01,
+    0.000000000e+00, 2.870495792e-01, -1.562500000e-01, -2.099223257e-01,
+    2.931509850e-01, 3.664387312e-02, -3.736956482e-01, 3.495602706e-01,
+    -3.037847202e-01, 1.217848224e-01, 2.099223257e-01, -3.046875000e-01,
+    5.182226235e-02, 2.850224429e-01, -3.963640904e-01, 2.471764378e-01,
+    0.000000000e+00, -2.692763741e-01, 2.931509850e-01, -5.182226235e-02,
+    -2.500000000e-01, 3.906250000e-01, -3.186887196e-01, 1.490530002e-01,
+    3.358466447e-01, -2.243969784e-01, -3.664387312e-02, 2.850224429e-01,
+    -3.906250000e-01, 3.359375000e-01, -1.991804497e-01, 7.452650011e-02,
+    0.000000000e+00, 2.288409143e-01, -3.736956482e-01, 3.963640904e-01,
+    -3.186887196e-01, 1.991804497e-01, -9.375000000e-02, 2.923169833e-02,
+    -4.576818286e-01, 4.281221487e-01, -3.495602706e-01, 2.471764378e-01,
+    -1.490530002e-01, 7.452650011e-02, -2.923169833e-02, 7.812500000e-03,
+    2.734375000e-01, 0.000000000e+00, -2.773162398e-01, 0.000000000e+00,
+    2.908517261e-01, 0.000000000e+00, -3.236299246e-01, 0.000000000e+00,
+    4.431485250e-01, 0.000000000e+00, 2.734375000e-01, -6.536406457e-02,
+    -2.655100854e-01, 1.371088186e-01, 2.471764378e-01, -2.288409143e-01,
+    -2.089022181e-01, 4.178044362e-01, -2.773162398e-01, 6.536406457e-02,
+    2.500000000e-01, -1.904071501e-01, -1.638763825e-01, 2.954323500e-01,
+    0.000000000e+00, -3.495602706e-01, 3.495602706e-01, 0.000000000e+00,
+    -2.655100854e-01, 1.904071501e-01, 1.328125000e-01, -3.025768239e-01,
+    1.090956253e-01, 2.356734864e-01, -3.872510541e-01, 2.581673694e-01,
+    2.908517261e-01, -1.371088186e-01, -1.638763825e-01, 3.025768239e-01,
+    -1.406250000e-01, -1.690102160e-01, 3.651037952e-01, -3.332926407e-01,
+    1.666463204e-01, 0.000000000e+00, 2.471764378e-01, -2.954323500e-01,
+    1.090956253e-01, 1.690102160e-01, -3.515625000e-01, 3.544155069e-01,
+    -2.310968665e-01, 9.243874661e-02, -3.236299246e-01, 2.288409143e-01,
+    0.000000000e+00, -2.356734864e-01, 3.651037952e-01, -3.544155069e-01,
+    2.500000000e-01, -1.283724744e-01, 4.279082481e-02, 0.000000000e+00,
+    -2.089022181e-01, 3.495602706e-01, -3.872510541e-01, 3.332926407e-01,
+    -2.310968665e-01, 1.283724744e-01, -5.468750000e-02, 1.562500000e-02,
+    4.431485250e-01, -4.178044362e-01, 3.495602706e-01, -2.581673694e-01,
+    1.666463204e-01, -9.243874661e-02, 4.279082481e-02, -1.562500000e-02,
+    3.906250000e-03};
+
+/*! sqrt((n + m)! (n - m)!) for 0 <= m <= n */
+const float multipole_sph_norm[45] = {
+    1.000000000e+00, 1.000000000e+00, 1.414213562e+00, 2.000000000e+00,
+    2.449489743e+00, 4.898979486e+00, 6.000000000e+00, 6.928203230e+00,
+    1.095445115e+01, 2.683281573e+01, 2.400000000e+01, 2.683281573e+01,
+    3.794733192e+01, 7.099295740e+01, 2.007984064e+02, 1.200000000e+02,
+    1.314534138e+02, 1.738965210e+02, 2.839718296e+02, 6.023952191e+02,
+    1.904940944e+03, 7.200000000e+02, 7.776888838e+02, 9.837072735e+02,
+    1.475560910e+03, 2.693993318e+03, 6.317974359e+03, 2.188610518e+04,
+    5.040000000e+03, 5.387986637e+03, 6.598909001e+03, 9.332266606e+03,
+    1.547581339e+04, 3.095162677e+04, 7.891147445e+04, 2.952597013e+05,
+    4.032000000e+04, 4.276581813e+04, 5.111492933e+04, 6.920994148e+04,
+    1.072195803e+05, 1.932928473e+05, 4.175602740e+05, 1.143535906e+06,
+    4.574143623e+06};
+
+/*! 1 / sqrt((n + m)! (n - m)!) for 0 <= m <= n */
+const float multipole_sph_norm_inv[45] = {
+    1.000000000e+00, 1.000000000e+00, 7.071067812e-01, 5.000000000e-01,
+    4.082482905e-01, 2.041241452e-01, 1.666666667e-01, 1.443375673e-01,
+    9.128709292e-02, 3.726779962e-02, 4.166666667e-02, 3.726779962e-02,
+    2.635231383e-02, 1.408590425e-02, 4.980119206e-03, 8.333333333e-03,
+    7.607257743e-03, 5.750546328e-03, 3.521476061e-03, 1.660039735e-03,
+    5.249506570e-04, 1.388888889e-03, 1.285861250e-03, 1.016562576e-03,
+    6.777083840e-04, 3.711961693e-04, 1.582785784e-04, 4.569108993e-05,
+    1.984126984e-04, 1.855980847e-04, 1.515402016e-04, 1.071551041e-04,
+    6.461695906e-05, 3.230847953e-05, 1.267242827e-05, 3.386848919e-06,
+    2.480158730e-05, 2.338316075e-05, 1.956375590e-05, 1.444879129e-05,
+    9.326654676e-06, 5.173497179e-06, 2.394863837e-06, 8.744806305e-07,
+    2.186201576e-07};
+
+/*! n! for 0 <= n <= p */
+const float multipole_sph_factorial[9] = {
+    1.000000000e+00, 1.000000000e+00, 2.000000000e+00, 6.000000000e+00,
+    2.400000000e+01, 1.200000000e+02, 7.200000000e+02, 5.040000000e+03,
+    4.032000000e+04};
+
+#endif /* SWIFT_MULTIPOLE_SPHERICAL */
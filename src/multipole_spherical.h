@@ -0,0 +1,1254 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_MULTIPOLE_SPHERICAL_H
+#define SWIFT_MULTIPOLE_SPHERICAL_H
+
+/*
+ * Solid-harmonic implementation of the multipole operators.
+ *
+ * This file is only included by multipole.h when the code is configured
+ * with --with-multipole-backend=spherical and provides the same API as the
+ * Cartesian tensors.
+ *
+ * We use the regular and irregular solid harmonics
+ *
+ *   R_n^m(r) = r^n P_n^m(cos theta) e^{i m phi} / (n + m)!,
+ *   I_n^m(r) = (n - m)! P_n^m(cos theta) e^{i m phi} / r^{n + 1},
+ *
+ * (P_n^m including the Condon-Shortley phase) such that
+ * 1 / |r - s| = sum_{n,m} conj(R_n^m(s)) I_n^m(r). The moments are
+ * M_n^m = sum_i m_i R_n^m(x_i - CoM) and the field tensors store the
+ * coefficients L_k^l of the potential Phi(x) = sum_{k,l} conj(R_k^l(x -
+ * CoM)) L_k^l (Phi > 0). Only the orders m >= 0 are stored since all these
+ * quantities verify A_n^{-m} = (-1)^m conj(A_n^m).
+ *
+ * The M2L kernel rotates the moments such that the z-axis points along the
+ * line joining the two centres, applies the O(p^3) coaxial translation and
+ * rotates the result back. The rotations around the y-axis are done using
+ * the tabulated Wigner matrices d^n(pi/2) of multipole_spherical.c.
+ */
+
+/**
+ * @brief Maximal order for which the tables of multipole_spherical.c exist.
+ */
+#define multipole_sph_max_order 8
+
+#if SELF_GRAVITY_MULTIPOLE_ORDER > multipole_sph_max_order
+#error "Missing implementation for order >8"
+#endif
+#if SELF_GRAVITY_MULTIPOLE_ORDER < 2
+#error "The solid-harmonic multipoles require an order >= 2"
+#endif
+
+/*! Number of regular harmonics needed for the M2P gradient */
+#define multipole_sph_num_coeffs_M2P                                        \
+  ((SELF_GRAVITY_MULTIPOLE_ORDER + 2) * (SELF_GRAVITY_MULTIPOLE_ORDER + 3) / \
+   2)
+
+extern const float multipole_sph_rotation[];
+extern const float multipole_sph_norm[];
+extern const float multipole_sph_norm_inv[];
+extern const float multipole_sph_factorial[];
+
+/**
+ * @brief Geometry of the frame used by the rotation-based M2L kernel.
+ */
+struct gravity_sph_frame {
+
+  /*! cos(k theta) and sin(k theta) of the polar angle of the separation */
+  float cos_theta[SELF_GRAVITY_MULTIPOLE_ORDER + 1];
+  float sin_theta[SELF_GRAVITY_MULTIPOLE_ORDER + 1];
+
+  /*! cos(m psi) and sin(m psi) with psi = phi + pi/2 */
+  float cos_psi[SELF_GRAVITY_MULTIPOLE_ORDER + 1];
+  float sin_psi[SELF_GRAVITY_MULTIPOLE_ORDER + 1];
+
+  /*! n! / r^(n + 1) */
+  float r_pow[SELF_GRAVITY_MULTIPOLE_ORDER + 1];
+};
+
+/**
+ * @brief Computes the regular solid harmonics R_n^m(x) for 0 <= m <= n <=
+ * order.
+ *
+ * @param x The x-component of the position.
+ * @param y The y-component of the position.
+ * @param z The z-component of the position.
+ * @param order The maximal degree.
+ * @param R_re (return) The real parts.
+ * @param R_im (return) The imaginary parts.
+ */
+__attribute__((nonnull)) INLINE static void gravity_sph_regular(
+    const double x, const double y, const double z, const int order,
+    double *restrict R_re, double *restrict R_im) {
+
+  const double r2 = x * x + y * y + z * z;
+
+  R_re[0] = 1.;
+  R_im[0] = 0.;
+
+  /* Sectoral harmonics R_m^m */
+  for (int m = 1; m <= order; ++m) {
+    const int i = multipole_sph_index(m, m);
+    const int j = multipole_sph_index(m - 1, m - 1);
+    const double f = -1. / (2. * m);
+    R_re[i] = f * (x * R_re[j] - y * R_im[j]);
+    R_im[i] = f * (x * R_im[j] + y * R_re[j]);
+  }
+
+  /* Recursion in degree */
+  for (int m = 0; m < order; ++m) {
+    const int i = multipole_sph_index(m + 1, m);
+    const int j = multipole_sph_index(m, m);
+    R_re[i] = z * R_re[j];
+    R_im[i] = z * R_im[j];
+
+    for (int n = m + 2; n <= order; ++n) {
+      const int i0 = multipole_sph_index(n, m);
+      const int i1 = multipole_sph_index(n - 1, m);
+      const int i2 = multipole_sph_index(n - 2, m);
+      const double f = 1. / ((n - m) * (n + m));
+      const double g = (2 * n - 1) * z;
+      R_re[i0] = f * (g * R_re[i1] - r2 * R_re[i2]);
+      R_im[i0] = f * (g * R_im[i1] - r2 * R_im[i2]);
+    }
+  }
+}
+
+/**
+ * @brief Computes the irregular solid harmonics I_n^m(x) for 0 <= m <= n <=
+ * order.
+ *
+ * @param x The x-component of the position.
+ * @param y The y-component of the position.
+ * @param z The z-component of the position.
+ * @param order The maximal degree.
+ * @param I_re (return) The real parts.
+ * @param I_im (return) The imaginary parts.
+ */
+__attribute__((nonnull)) INLINE static void gravity_sph_irregular(
+    const float x, const float y, const float z, const int order,
+    float *restrict I_re, float *restrict I_im) {
+
+  const float r2_inv = 1.f / (x * x + y * y + z * z);
+
+  I_re[0] = sqrtf(r2_inv);
+  I_im[0] = 0.f;
+
+  /* Sectoral harmonics I_m^m */
+  for (int m = 1; m <= order; ++m) {
+    const int i = multipole_sph_index(m, m);
+    const int j = multipole_sph_index(m - 1, m - 1);
+    const float f = -(2 * m - 1) * r2_inv;
+    I_re[i] = f * (x * I_re[j] - y * I_im[j]);
+    I_im[i] = f * (x * I_im[j] + y * I_re[j]);
+  }
+
+  /* Recursion in degree */
+  for (int m = 0; m < order; ++m) {
+    const int i = multipole_sph_index(m + 1, m);
+    const int j = multipole_sph_index(m, m);
+    const float f = (2 * m + 1) * z * r2_inv;
+    I_re[i] = f * I_re[j];
+    I_im[i] = f * I_im[j];
+
+    for (int n = m + 2; n <= order; ++n) {
+      const int i0 = multipole_sph_index(n, m);
+      const int i1 = multipole_sph_index(n - 1, m);
+      const int i2 = multipole_sph_index(n - 2, m);
+      const float g = (2 * n - 1) * z;
+      const float h = (n + m - 1) * (n - m - 1);
+      I_re[i0] = r2_inv * (g * I_re[i1] - h * I_re[i2]);
+      I_im[i0] = r2_inv * (g * I_im[i1] - h * I_im[i2]);
+    }
+  }
+}
+
+/**
+ * @brief Reads a coefficient of any order m from an array storing the
+ * orders m >= 0 only.
+ *
+ * Uses A_n^{-m} = (-1)^m conj(A_n^m) and returns 0 for |m| > n.
+ *
+ * @param A_re The real parts.
+ * @param A_im The imaginary parts.
+ * @param n The degree.
+ * @param m The order.
+ * @param re (return) The real part of A_n^m.
+ * @param im (return) The imaginary part of A_n^m.
+ */
+__attribute__((nonnull)) INLINE static void gravity_sph_get(
+    const float *restrict A_re, const float *restrict A_im, const int n,
+    const int m, double *re, double *im) {
+
+  if (m > n || -m > n) {
+    *re = 0.;
+    *im = 0.;
+  } else if (m >= 0) {
+    *re = A_re[multipole_sph_index(n, m)];
+    *im = A_im[multipole_sph_index(n, m)];
+  } else {
+    const double sign = (m & 1) ? -1. : 1.;
+    *re = sign * A_re[multipole_sph_index(n, -m)];
+    *im = -sign * A_im[multipole_sph_index(n, -m)];
+  }
+}
+
+/**
+ * @brief Computes the coefficient L_k^l of a local expansion shifted by a
+ * vector d, i.e. sum_{j, h} conj(R_j^h(d)) L_{k+j}^{l+h}.
+ *
+ * @param L_re The real parts of the local expansion.
+ * @param L_im The imaginary parts of the local expansion.
+ * @param R_re The real parts of the regular harmonics R(d).
+ * @param R_im The imaginary parts of the regular harmonics R(d).
+ * @param k The degree of the coefficient.
+ * @param l The order of the coefficient.
+ * @param re (return) The real part of the shifted coefficient.
+ * @param im (return) The imaginary part of the shifted coefficient.
+ */
+__attribute__((nonnull)) INLINE static void gravity_sph_shift_local(
+    const float *restrict L_re, const float *restrict L_im,
+    const double *restrict R_re, const double *restrict R_im, const int k,
+    const int l, double *re, double *im) {
+
+  double acc_re = 0., acc_im = 0.;
+
+  for (int j = 0; j <= SELF_GRAVITY_MULTIPOLE_ORDER - k; ++j) {
+    for (int h = -j; h <= j; ++h) {
+
+      /* conj(R_j^h) */
+      double r_re, r_im;
+      if (h >= 0) {
+        r_re = R_re[multipole_sph_index(j, h)];
+        r_im = -R_im[multipole_sph_index(j, h)];
+      } else {
+        const double sign = (h & 1) ? -1. : 1.;
+        r_re = sign * R_re[multipole_sph_index(j, -h)];
+        r_im = sign * R_im[multipole_sph_index(j, -h)];
+      }
+
+      double a_re, a_im;
+      gravity_sph_get(L_re, L_im, k + j, l + h, &a_re, &a_im);
+
+      acc_re += r_re * a_re - r_im * a_im;
+      acc_im += r_re * a_im + r_im * a_re;
+    }
+  }
+
+  *re = acc_re;
+  *im = acc_im;
+}
+
+/**
+ * @brief Constructs the frame in which the separation vector is aligned
+ * with the z-axis.
+ *
+ * @param dx x-component of the separation vector.
+ * @param dy y-component of the separation vector.
+ * @param dz z-component of the separation vector.
+ * @param f (return) The #gravity_sph_frame.
+ */
+__attribute__((nonnull)) INLINE static void gravity_sph_frame_init(
+    const float dx, const float dy, const float dz,
+    struct gravity_sph_frame *f) {
+
+  const float rxy2 = dx * dx + dy * dy;
+  const float r_inv = 1.f / sqrtf(rxy2 + dz * dz);
+
+  /* Polar angle */
+  const float cos_theta = dz * r_inv;
+  const float sin_theta = sqrtf(rxy2) * r_inv;
+
+  /* Azimuthal angle shifted by pi/2 */
+  float cos_psi = -0.f, sin_psi = 1.f;
+  if (rxy2 > 0.f) {
+    const float rxy_inv = 1.f / sqrtf(rxy2);
+    cos_psi = -dy * rxy_inv;
+    sin_psi = dx * rxy_inv;
+  }
+
+  f->cos_theta[0] = 1.f;
+  f->sin_theta[0] = 0.f;
+  f->cos_psi[0] = 1.f;
+  f->sin_psi[0] = 0.f;
+  f->r_pow[0] = r_inv;
+  for (int k = 1; k <= SELF_GRAVITY_MULTIPOLE_ORDER; ++k) {
+    f->cos_theta[k] =
+        f->cos_theta[k - 1] * cos_theta - f->sin_theta[k - 1] * sin_theta;
+    f->sin_theta[k] =
+        f->sin_theta[k - 1] * cos_theta + f->cos_theta[k - 1] * sin_theta;
+    f->cos_psi[k] = f->cos_psi[k - 1] * cos_psi - f->sin_psi[k - 1] * sin_psi;
+    f->sin_psi[k] = f->sin_psi[k - 1] * cos_psi + f->cos_psi[k - 1] * sin_psi;
+    f->r_pow[k] = f->r_pow[k - 1] * k * r_inv;
+  }
+}
+
+/**
+ * @brief Rotates the (scaled) coefficients of degree n around the y-axis.
+ *
+ * Applies d^n(-pi/2) e^{+-i k theta} d^n(pi/2) using the symmetries of the
+ * Wigner matrices to work on the orders m >= 0 with real arithmetic only.
+ *
+ * @param n The degree.
+ * @param in_re The real parts of the coefficients to rotate.
+ * @param in_im The imaginary parts of the coefficients to rotate.
+ * @param f The #gravity_sph_frame.
+ * @param sign +1 for the forward rotation, -1 for the backward one.
+ * @param out_re (return) The real parts of the rotated coefficients.
+ * @param out_im (return) The imaginary parts of the rotated coefficients.
+ */
+__attribute__((nonnull)) INLINE static void gravity_sph_rotate(
+    const int n, const float *restrict in_re, const float *restrict in_im,
+    const struct gravity_sph_frame *f, const float sign,
+    float *restrict out_re, float *restrict out_im) {
+
+  const float *d = &multipole_sph_rotation[n * (n + 1) * (2 * n + 1) / 6];
+
+  float a_re[SELF_GRAVITY_MULTIPOLE_ORDER + 1];
+  float a_im[SELF_GRAVITY_MULTIPOLE_ORDER + 1];
+
+  for (int k = 0; k <= n; ++k) {
+    float acc_re = 0.f, acc_im = 0.f;
+    for (int m = 0; m <= n; ++m) {
+      const float w = (m == 0) ? d[k * (n + 1) + m] : 2.f * d[k * (n + 1) + m];
+      if ((n + k + m) & 1)
+        acc_im += w * in_im[m];
+      else
+        acc_re += w * in_re[m];
+    }
+
+    /* Rotation around the intermediate z-axis */
+    const float c = f->cos_theta[k];
+    const float s = sign * f->sin_theta[k];
+    a_re[k] = c * acc_re - s * acc_im;
+    a_im[k] = c * acc_im + s * acc_re;
+  }
+
+  for (int m = 0; m <= n; ++m) {
+    float acc_re = 0.f, acc_im = 0.f;
+    for (int k = 0; k <= n; ++k) {
+      const float w = (k == 0) ? d[k * (n + 1) + m] : 2.f * d[k * (n + 1) + m];
+      if ((n + m + k) & 1)
+        acc_im += w * a_im[k];
+      else
+        acc_re += w * a_re[k];
+    }
+    out_re[m] = acc_re;
+    out_im[m] = acc_im;
+  }
+}
+
+/**
+ * @brief Rotates the moments of a #multipole into a #gravity_sph_frame.
+ *
+ * @param m The #multipole.
+ * @param f The #gravity_sph_frame.
+ * @param X_re (return) The real parts of the rotated moments.
+ * @param X_im (return) The imaginary parts of the rotated moments.
+ */
+__attribute__((nonnull)) INLINE static void gravity_sph_rotate_multipole(
+    const struct multipole *restrict m, const struct gravity_sph_frame *f,
+    float *restrict X_re, float *restrict X_im) {
+
+  /* The monopole is invariant and the dipole vanishes */
+  X_re[0] = m->M_000;
+  X_im[0] = 0.f;
+
+  for (int n = 2; n <= SELF_GRAVITY_MULTIPOLE_ORDER; ++n) {
+
+    float w_re[SELF_GRAVITY_MULTIPOLE_ORDER + 1];
+    float w_im[SELF_GRAVITY_MULTIPOLE_ORDER + 1];
+
+    /* Rotation around the z-axis */
+    for (int k = 0; k <= n; ++k) {
+      const int i = multipole_sph_index(n, k);
+      const float M_re = m->M_re[i - 3];
+      const float M_im = m->M_im[i - 3];
+      const float c = f->cos_psi[k];
+      const float s = f->sin_psi[k];
+      w_re[k] = multipole_sph_norm[i] * (c * M_re + s * M_im);
+      w_im[k] = multipole_sph_norm[i] * (c * M_im - s * M_re);
+    }
+
+    /* Rotation around the y-axis */
+    gravity_sph_rotate(n, w_re, w_im, f, 1.f, &X_re[multipole_sph_index(n, 0)],
+                       &X_im[multipole_sph_index(n, 0)]);
+
+    for (int k = 0; k <= n; ++k) {
+      const int i = multipole_sph_index(n, k);
+      X_re[i] *= multipole_sph_norm_inv[i];
+      X_im[i] *= multipole_sph_norm_inv[i];
+    }
+  }
+}
+
+/**
+ * @brief Applies the coaxial translation to rotated moments, rotates the
+ * result back and accumulates it in a field tensor.
+ *
+ * @param l The #grav_tensor to update.
+ * @param X_re The real parts of the rotated moments.
+ * @param X_im The imaginary parts of the rotated moments.
+ * @param f The #gravity_sph_frame.
+ * @param sign +1 if the separation vector points from the multipole to the
+ * field tensor, -1 otherwise.
+ */
+__attribute__((nonnull)) INLINE static void gravity_sph_translate_M2L(
+    struct grav_tensor *restrict l, const float *restrict X_re,
+    const float *restrict X_im, const struct gravity_sph_frame *f,
+    const float sign) {
+
+  for (int k = 0; k <= SELF_GRAVITY_MULTIPOLE_ORDER; ++k) {
+
+    float v_re[SELF_GRAVITY_MULTIPOLE_ORDER + 1];
+    float v_im[SELF_GRAVITY_MULTIPOLE_ORDER + 1];
+
+    /* Coaxial translation */
+    for (int m = 0; m <= k; ++m) {
+      float acc_re = 0.f, acc_im = 0.f;
+      for (int n = m; n <= SELF_GRAVITY_MULTIPOLE_ORDER - k; ++n) {
+        if (n == 1) continue;
+        const int i = multipole_sph_index(n, m);
+        const float g =
+            ((n + k) & 1) ? sign * f->r_pow[n + k] : f->r_pow[n + k];
+        acc_re += g * X_re[i];
+        acc_im += g * X_im[i];
+      }
+      const int i = multipole_sph_index(k, m);
+      const float g = ((k + m) & 1) ? -multipole_sph_norm_inv[i]
+                                    : multipole_sph_norm_inv[i];
+      v_re[m] = g * acc_re;
+      v_im[m] = g * acc_im;
+    }
+
+    /* The local monopole is invariant */
+    if (k == 0) {
+      l->F_re[0] += v_re[0];
+      continue;
+    }
+
+    /* Rotation back around the y-axis */
+    float o_re[SELF_GRAVITY_MULTIPOLE_ORDER + 1];
+    float o_im[SELF_GRAVITY_MULTIPOLE_ORDER + 1];
+    gravity_sph_rotate(k, v_re, v_im, f, -1.f, o_re, o_im);
+
+    /* Rotation back around the z-axis */
+    for (int m = 0; m <= k; ++m) {
+      const int i = multipole_sph_index(k, m);
+      const float c = f->cos_psi[m];
+      const float s = f->sin_psi[m];
+      l->F_re[i] += multipole_sph_norm[i] * (c * o_re[m] - s * o_im[m]);
+      l->F_im[i] += multipole_sph_norm[i] * (c * o_im[m] + s * o_re[m]);
+    }
+  }
+}
+
+/**
+ * @brief Records an M2L interaction in the counters of a field tensor.
+ *
+ * @param l The #grav_tensor.
+ * @param m The #multipole creating the field.
+ */
+__attribute__((nonnull)) INLINE static void gravity_sph_record_M2L(
+    struct grav_tensor *restrict l, const struct multipole *restrict m) {
+
+#ifdef SWIFT_DEBUG_CHECKS
+  /* Count all interactions
+   * Note that despite being in a section of the code protected by locks,
+   * we must use atomics here as the long-range task may update this
+   * counter in a lock-free section of code. */
+  accumulate_add_ll(&l->num_interacted, m->num_gpart);
+#endif
+
+#ifdef SWIFT_GRAVITY_FORCE_CHECKS
+  /* Count tree interactions
+   * Note that despite being in a section of the code protected by locks,
+   * we must use atomics here as the long-range task may update this
+   * counter in a lock-free section of code. */
+  accumulate_add_ll(&l->num_interacted_tree, m->num_gpart);
+#endif
+
+  /* Record that this tensor has received contributions */
+  l->interacted = 1;
+}
+
+/**
+ * @brief Adds a field tensor to another one (i.e. does la += lb).
+ *
+ * @param la The gravity tensors to add to.
+ * @param lb The gravity tensors to add.
+ */
+__attribute__((nonnull)) INLINE static void gravity_field_tensors_add(
+    struct grav_tensor *restrict la, const struct grav_tensor *restrict lb) {
+#ifdef SWIFT_DEBUG_CHECKS
+  if (lb->num_interacted == 0) error("Adding tensors that did not interact");
+
+  la->num_interacted += lb->num_interacted;
+#endif
+#ifdef SWIFT_GRAVITY_FORCE_CHECKS
+  la->num_interacted_tree += lb->num_interacted_tree;
+  la->num_interacted_pm += lb->num_interacted_pm;
+#endif
+
+  la->interacted = 1;
+
+  for (int i = 0; i < multipole_sph_num_coeffs; ++i) {
+    la->F_re[i] += lb->F_re[i];
+    la->F_im[i] += lb->F_im[i];
+  }
+}
+
+/**
+ * @brief Prints the content of a #grav_tensor to stdout.
+ *
+ * Note: Uses directly printf(), not a call to message().
+ *
+ * @param l The #grav_tensor to print.
+ */
+__attribute__((nonnull)) INLINE static void gravity_field_tensors_print(
+    const struct grav_tensor *l) {
+
+  printf("-------------------------\n");
+  printf("Interacted: %d\n", l->interacted);
+  for (int n = 0; n <= SELF_GRAVITY_MULTIPOLE_ORDER; ++n) {
+    printf("-------------------------\n");
+    for (int m = 0; m <= n; ++m) {
+      const int i = multipole_sph_index(n, m);
+      printf("L_%d^%d= (%12.5e, %12.5e)\n", n, m, l->F_re[i], l->F_im[i]);
+    }
+  }
+  printf("-------------------------\n");
+}
+
+/**
+ * @brief Prints the content of a #multipole to stdout.
+ *
+ * Note: Uses directly printf(), not a call to message().
+ *
+ * @param m The #multipole to print.
+ */
+__attribute__((nonnull)) INLINE static void gravity_multipole_print(
+    const struct multipole *m) {
+
+  printf("eps_max = %12.5e\n", m->max_softening);
+  printf("Vel= [%12.5e %12.5e %12.5e]\n", m->vel[0], m->vel[1], m->vel[2]);
+  printf("-------------------------\n");
+  printf("M_000= %12.5e\n", m->M_000);
+  for (int n = 2; n <= SELF_GRAVITY_MULTIPOLE_ORDER; ++n) {
+    printf("-------------------------\n");
+    for (int k = 0; k <= n; ++k) {
+      const int i = multipole_sph_index(n, k) - 3;
+      printf("M_%d^%d= (%12.5e, %12.5e)\n", n, k, m->M_re[i], m->M_im[i]);
+    }
+  }
+  printf("-------------------------\n");
+}
+
+/**
+ * @brief Adds a #multipole to another one (i.e. does ma += mb).
+ *
+ * @param ma The multipole to add to.
+ * @param mb The multipole to add.
+ */
+__attribute__((nonnull)) INLINE static void gravity_multipole_add(
+    struct multipole *restrict ma, const struct multipole *restrict mb) {
+
+  /* Maximum of both softenings */
+  ma->max_softening = max(ma->max_softening, mb->max_softening);
+
+  /* Minimum of both old accelerations */
+  ma->min_old_a_grav_norm =
+      min(ma->min_old_a_grav_norm, mb->min_old_a_grav_norm);
+
+  /* Add 0th order term */
+  ma->M_000 += mb->M_000;
+
+  /* Add the higher-order terms (the dipole is 0 since we expand around CoM) */
+  for (int i = 0; i < multipole_sph_num_coeffs - 3; ++i) {
+    ma->M_re[i] += mb->M_re[i];
+    ma->M_im[i] += mb->M_im[i];
+  }
+
+#if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_GRAVITY_FORCE_CHECKS)
+  ma->num_gpart += mb->num_gpart;
+#endif
+}
+
+/**
+ * @brief Verifies whether two #multipole's are equal or not.
+ *
+ * @param ga The first #multipole.
+ * @param gb The second #multipole.
+ * @param tolerance The maximal allowed relative difference for the fields.
+ * @return 1 if the multipoles are equal, 0 otherwise
+ */
+__attribute__((nonnull)) INLINE static int gravity_multipole_equal(
+    const struct gravity_tensors *ga, const struct gravity_tensors *gb,
+    double tolerance) {
+
+  /* Check CoM */
+  if (fabs(ga->CoM[0] - gb->CoM[0]) / fabs(ga->CoM[0] + gb->CoM[0]) >
+      tolerance) {
+    message("CoM[0] different");
+    return 0;
+  }
+  if (fabs(ga->CoM[1] - gb->CoM[1]) / fabs(ga->CoM[1] + gb->CoM[1]) >
+      tolerance) {
+    message("CoM[1] different");
+    return 0;
+  }
+  if (fabs(ga->CoM[2] - gb->CoM[2]) / fabs(ga->CoM[2] + gb->CoM[2]) >
+      tolerance) {
+    message("CoM[2] different");
+    return 0;
+  }
+
+  /* Helper pointers */
+  const struct multipole *ma = &ga->m_pole;
+  const struct multipole *mb = &gb->m_pole;
+
+  const double v2 = ma->vel[0] * ma->vel[0] + ma->vel[1] * ma->vel[1] +
+                    ma->vel[2] * ma->vel[2];
+
+  /* Check maximal softening */
+  if (fabsf(ma->max_softening - mb->max_softening) /
+          fabsf(ma->max_softening + mb->max_softening) >
+      tolerance) {
+    message("max softening different!");
+    return 0;
+  }
+
+  /* Check minimal old acceleration norm */
+  if (fabsf(ma->min_old_a_grav_norm - mb->min_old_a_grav_norm) /
+          fabsf(ma->min_old_a_grav_norm + mb->min_old_a_grav_norm + FLT_MIN) >
+      tolerance) {
+    message("min old_a_grav_norm different!");
+    return 0;
+  }
+
+  /* Check bulk velocity (if non-zero and component > 1% of norm)*/
+  for (int k = 0; k < 3; ++k) {
+    if (fabsf(ma->vel[k] + mb->vel[k]) > 1e-10 &&
+        (ma->vel[k] * ma->vel[k]) > 0.0001 * v2 &&
+        fabsf(ma->vel[k] - mb->vel[k]) / fabsf(ma->vel[k] + mb->vel[k]) >
+            tolerance) {
+      message("v[%d] different", k);
+      return 0;
+    }
+  }
+
+  /* Manhattan Norm of 0th order terms */
+  const float order0_norm = fabsf(ma->M_000) + fabsf(mb->M_000);
+
+  /* Compare 0th order terms above 1% of norm */
+  if (fabsf(ma->M_000 + mb->M_000) > 0.01f * order0_norm &&
+      fabsf(ma->M_000 - mb->M_000) / fabsf(ma->M_000 + mb->M_000) > tolerance) {
+    message("M_000 term different");
+    return 0;
+  }
+
+  /* The dipole vanishes since we expand around the CoM */
+
+  for (int n = 2; n <= SELF_GRAVITY_MULTIPOLE_ORDER; ++n) {
+
+    /* Manhattan Norm of the terms of degree n */
+    float norm = 0.f;
+    for (int k = 0; k <= n; ++k) {
+      const int i = multipole_sph_index(n, k) - 3;
+      norm += fabsf(ma->M_re[i]) + fabsf(mb->M_re[i]);
+      norm += fabsf(ma->M_im[i]) + fabsf(mb->M_im[i]);
+    }
+
+    /* Compare the terms above 1% of norm */
+    for (int k = 0; k <= n; ++k) {
+      const int i = multipole_sph_index(n, k) - 3;
+      if (fabsf(ma->M_re[i] + mb->M_re[i]) > 0.01f * norm &&
+          fabsf(ma->M_re[i] - mb->M_re[i]) / fabsf(ma->M_re[i] + mb->M_re[i]) >
+              tolerance) {
+        message("Re(M_%d^%d) term different", n, k);
+        return 0;
+      }
+      if (fabsf(ma->M_im[i] + mb->M_im[i]) > 0.01f * norm &&
+          fabsf(ma->M_im[i] - mb->M_im[i]) / fabsf(ma->M_im[i] + mb->M_im[i]) >
+              tolerance) {
+        message("Im(M_%d^%d) term different", n, k);
+        return 0;
+      }
+    }
+  }
+
+  /* Compare the multipole power */
+  for (int i = 0; i < SELF_GRAVITY_MULTIPOLE_ORDER + 1; ++i) {
+
+    /* Ignore the order 1 power to avoid FPE since it's always 0 */
+    if (i == 1 || (ma->power[i] + mb->power[i] == 0.)) continue;
+
+    if (fabsf(ma->power[i] - mb->power[i]) /
+            fabsf(ma->power[i] + mb->power[i]) >
+        tolerance)
+      message("Power of order %d different", i);
+  }
+
+  /* All is good */
+  return 1;
+}
+
+/**
+ * @brief Compute the multipole power of a #multipole.
+ *
+ * The scaled harmonics sqrt((n+m)! (n-m)!) R_n^m have a rotation-invariant
+ * norm such that a point mass m at distance d has power m d^n / n! as for
+ * the Cartesian tensors.
+ *
+ * @param m The #multipole.
+ */
+__attribute__((nonnull)) INLINE static void gravity_multipole_compute_power(
+    struct multipole *m) {
+
+  /* 0th order terms */
+  m->power[0] = m->M_000;
+
+  /* 1st order terms (all 0 since we expand around CoM) */
+  m->power[1] = 0.f;
+
+  for (int n = 2; n <= SELF_GRAVITY_MULTIPOLE_ORDER; ++n) {
+    double power = 0.;
+    for (int k = 0; k <= n; ++k) {
+      const int i = multipole_sph_index(n, k);
+      const double s = multipole_sph_norm[i];
+      const double M2 = m->M_re[i - 3] * m->M_re[i - 3] +
+                        m->M_im[i - 3] * m->M_im[i - 3];
+      power += (k == 0) ? s * s * M2 : 2. * s * s * M2;
+    }
+    m->power[n] = sqrt(power) / multipole_sph_factorial[n];
+  }
+}
+
+/**
+ * @brief Constructs the #multipole of a bunch of particles around their
+ * centre of mass.
+ *
+ * @param multi The #multipole (content will  be overwritten).
+ * @param gparts The #gpart.
+ * @param gcount The number of particles.
+ * @param grav_props The properties of the gravity scheme.
+ */
+__attribute__((nonnull)) INLINE static void gravity_P2M(
+    struct gravity_tensors *multi, const struct gpart *gparts, const int gcount,
+    const struct gravity_props *const grav_props) {
+
+  /* Temporary variables */
+  float epsilon_max = 0.f;
+  float min_old_a_grav_norm = FLT_MAX;
+  double mass = 0.0;
+  double com[3] = {0.0, 0.0, 0.0};
+  double vel[3] = {0.f, 0.f, 0.f};
+
+  /* Collect the particle data for CoM. */
+  for (int k = 0; k < gcount; k++) {
+    const double m = gparts[k].mass;
+    const float epsilon = gravity_get_softening(&gparts[k], grav_props);
+
+#ifdef SWIFT_DEBUG_CHECKS
+    if (gparts[k].time_bin == time_bin_inhibited)
+      error("Inhibited particle in P2M. Should have been removed earlier.");
+
+    if (gparts[k].time_bin == time_bin_not_created) {
+      error("Extra particle in P2M.");
+    }
+#endif
+
+    epsilon_max = max(epsilon_max, epsilon);
+    min_old_a_grav_norm = min(min_old_a_grav_norm, gparts[k].old_a_grav_norm);
+    mass += m;
+    com[0] += gparts[k].x[0] * m;
+    com[1] += gparts[k].x[1] * m;
+    com[2] += gparts[k].x[2] * m;
+    vel[0] += gparts[k].v_full[0] * m;
+    vel[1] += gparts[k].v_full[1] * m;
+    vel[2] += gparts[k].v_full[2] * m;
+  }
+
+  /* Final operation on CoM */
+  const double imass = 1.0 / mass;
+  com[0] *= imass;
+  com[1] *= imass;
+  com[2] *= imass;
+  vel[0] *= imass;
+  vel[1] *= imass;
+  vel[2] *= imass;
+
+  /* Prepare some local counters */
+  double r_max2 = 0.;
+  float max_delta_vel[3] = {0., 0., 0.};
+  float min_delta_vel[3] = {0., 0., 0.};
+  double M_re[multipole_sph_num_coeffs] = {0.};
+  double M_im[multipole_sph_num_coeffs] = {0.};
+
+  /* Construce the higher order terms */
+  for (int k = 0; k < gcount; k++) {
+
+    const double dx[3] = {gparts[k].x[0] - com[0], gparts[k].x[1] - com[1],
+                          gparts[k].x[2] - com[2]};
+
+    /* Maximal distance CoM<->gpart */
+    r_max2 = max(r_max2, dx[0] * dx[0] + dx[1] * dx[1] + dx[2] * dx[2]);
+
+    /* Store the vector of the maximal vel difference */
+    max_delta_vel[0] = max(gparts[k].v_full[0], max_delta_vel[0]);
+    max_delta_vel[1] = max(gparts[k].v_full[1], max_delta_vel[1]);
+    max_delta_vel[2] = max(gparts[k].v_full[2], max_delta_vel[2]);
+
+    /* Store the vector of the minimal vel difference */
+    min_delta_vel[0] = min(gparts[k].v_full[0], min_delta_vel[0]);
+    min_delta_vel[1] = min(gparts[k].v_full[1], min_delta_vel[1]);
+    min_delta_vel[2] = min(gparts[k].v_full[2], min_delta_vel[2]);
+
+    const double m = gparts[k].mass;
+
+    double R_re[multipole_sph_num_coeffs], R_im[multipole_sph_num_coeffs];
+    gravity_sph_regular(dx[0], dx[1], dx[2], SELF_GRAVITY_MULTIPOLE_ORDER,
+                        R_re, R_im);
+
+    for (int i = 3; i < multipole_sph_num_coeffs; ++i) {
+      M_re[i] += m * R_re[i];
+      M_im[i] += m * R_im[i];
+    }
+  }
+
+  /* Store the data on the multipole. */
+  multi->r_max = sqrt(r_max2);
+  multi->CoM[0] = com[0];
+  multi->CoM[1] = com[1];
+  multi->CoM[2] = com[2];
+  multi->m_pole.max_softening = epsilon_max;
+  multi->m_pole.min_old_a_grav_norm = min_old_a_grav_norm;
+  multi->m_pole.vel[0] = vel[0];
+  multi->m_pole.vel[1] = vel[1];
+  multi->m_pole.vel[2] = vel[2];
+  multi->m_pole.max_delta_vel[0] = max_delta_vel[0];
+  multi->m_pole.max_delta_vel[1] = max_delta_vel[1];
+  multi->m_pole.max_delta_vel[2] = max_delta_vel[2];
+  multi->m_pole.min_delta_vel[0] = min_delta_vel[0];
+  multi->m_pole.min_delta_vel[1] = min_delta_vel[1];
+  multi->m_pole.min_delta_vel[2] = min_delta_vel[2];
+  multi->m_pole.M_000 = mass;
+
+  /* Higher order terms (the dipole is 0 since we expand around CoM) */
+  for (int i = 3; i < multipole_sph_num_coeffs; ++i) {
+    multi->m_pole.M_re[i - 3] = M_re[i];
+    multi->m_pole.M_im[i - 3] = M_im[i];
+  }
+
+#if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_GRAVITY_FORCE_CHECKS)
+  multi->m_pole.num_gpart = gcount;
+#endif
+}
+
+/**
+ * @brief Creates a copy of #multipole shifted to a new location.
+ *
+ * @param m_a The #multipole copy (content will  be overwritten).
+ * @param m_b The #multipole to shift.
+ * @param pos_a The position to which m_b will be shifted.
+ * @param pos_b The current postion of the multipole to shift.
+ */
+__attribute__((nonnull)) INLINE static void gravity_M2M(
+    struct multipole *restrict m_a, const struct multipole *restrict m_b,
+    const double pos_a[3], const double pos_b[3]) {
+
+  /* "shift" the softening */
+  m_a->max_softening = m_b->max_softening;
+
+  /* "shift" the minimal acceleration */
+  m_a->min_old_a_grav_norm = m_b->min_old_a_grav_norm;
+
+  /* Shift 0th order term */
+  m_a->M_000 = m_b->M_000;
+
+  /* Gather all the moments of m_b (the dipole is 0 since we expand around
+   * its CoM) */
+  float Mb_re[multipole_sph_num_coeffs] = {0.f};
+  float Mb_im[multipole_sph_num_coeffs] = {0.f};
+  Mb_re[0] = m_b->M_000;
+  for (int i = 3; i < multipole_sph_num_coeffs; ++i) {
+    Mb_re[i] = m_b->M_re[i - 3];
+    Mb_im[i] = m_b->M_im[i - 3];
+  }
+
+  /* Regular harmonics of the shift */
+  double R_re[multipole_sph_num_coeffs], R_im[multipole_sph_num_coeffs];
+  gravity_sph_regular(pos_b[0] - pos_a[0], pos_b[1] - pos_a[1],
+                      pos_b[2] - pos_a[2], SELF_GRAVITY_MULTIPOLE_ORDER, R_re,
+                      R_im);
+
+  /* Shift the higher order terms (the dipole is 0 (after add) since we
+   * expand around CoM) */
+  for (int n = 2; n <= SELF_GRAVITY_MULTIPOLE_ORDER; ++n) {
+    for (int m = 0; m <= n; ++m) {
+      double acc_re = 0., acc_im = 0.;
+      for (int k = 0; k <= n; ++k) {
+        for (int l = -k; l <= k; ++l) {
+
+          /* R_k^l */
+          double r_re, r_im;
+          if (l >= 0) {
+            r_re = R_re[multipole_sph_index(k, l)];
+            r_im = R_im[multipole_sph_index(k, l)];
+          } else {
+            const double sign = (l & 1) ? -1. : 1.;
+            r_re = sign * R_re[multipole_sph_index(k, -l)];
+            r_im = -sign * R_im[multipole_sph_index(k, -l)];
+          }
+
+          double b_re, b_im;
+          gravity_sph_get(Mb_re, Mb_im, n - k, m - l, &b_re, &b_im);
+
+          acc_re += r_re * b_re - r_im * b_im;
+          acc_im += r_re * b_im + r_im * b_re;
+        }
+      }
+      m_a->M_re[multipole_sph_index(n, m) - 3] = acc_re;
+      m_a->M_im[multipole_sph_index(n, m) - 3] = acc_im;
+    }
+  }
+
+#if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_GRAVITY_FORCE_CHECKS)
+  m_a->num_gpart = m_b->num_gpart;
+#endif
+}
+
+/**
+ * @brief Compute the field tensor due to a multipole.
+ *
+ * @param l_b The field tensor to compute.
+ * @param m_a The multipole.
+ * @param pos_b The position of the field tensor.
+ * @param pos_a The position of the multipole.
+ * @param props The #gravity_props of this calculation.
+ * @param periodic Is the calculation periodic ?
+ * @param dim The size of the simulation box.
+ * @param rs_inv The inverse of the gravity mesh-smoothing scale.
+ */
+__attribute__((nonnull)) INLINE static void gravity_M2L_nonsym(
+    struct grav_tensor *l_b, const struct multipole *m_a, const double pos_b[3],
+    const double pos_a[3], const struct gravity_props *props,
+    const int periodic, const double dim[3], const float rs_inv) {
+
+#ifdef SWIFT_DEBUG_CHECKS
+  if (periodic) error("Solid-harmonic multipoles used with periodic gravity");
+#endif
+
+  gravity_sph_record_M2L(l_b, m_a);
+
+  /* Compute distance vector */
+  const float dx = (float)(pos_b[0] - pos_a[0]);
+  const float dy = (float)(pos_b[1] - pos_a[1]);
+  const float dz = (float)(pos_b[2] - pos_a[2]);
+
+  /* Rotate the multipole along the separation */
+  struct gravity_sph_frame f;
+  gravity_sph_frame_init(dx, dy, dz, &f);
+  float X_re[multipole_sph_num_coeffs], X_im[multipole_sph_num_coeffs];
+  gravity_sph_rotate_multipole(m_a, &f, X_re, X_im);
+
+  /* Do the M2L translation */
+  gravity_sph_translate_M2L(l_b, X_re, X_im, &f, 1.f);
+}
+
+/**
+ * @brief Compute the field tensor due to a multipole and the symmetric
+ * equivalent.
+ *
+ * Both interactions share the same rotated frame.
+ *
+ * @param l_a The first field tensor to compute.
+ * @param l_b The second field tensor to compute.
+ * @param m_a The first multipole.
+ * @param m_b The second multipole.
+ * @param pos_a The position of the first m-pole and field tensor.
+ * @param pos_b The position of the second m-pole and field tensor.
+ * @param props The #gravity_props of this calculation.
+ * @param periodic Is the calculation periodic ?
+ * @param dim The size of the simulation box.
+ * @param rs_inv The inverse of the gravity mesh-smoothing scale.
+ */
+__attribute__((nonnull)) INLINE static void gravity_M2L_symmetric(
+    struct grav_tensor *restrict l_a, struct grav_tensor *restrict l_b,
+    const struct multipole *restrict m_a, const struct multipole *restrict m_b,
+    const double pos_a[3], const double pos_b[3],
+    const struct gravity_props *props, const int periodic, const double dim[3],
+    const float rs_inv) {
+
+#ifdef SWIFT_DEBUG_CHECKS
+  if (periodic) error("Solid-harmonic multipoles used with periodic gravity");
+#endif
+
+  gravity_sph_record_M2L(l_b, m_a);
+  gravity_sph_record_M2L(l_a, m_b);
+
+  /* Compute distance vector */
+  const float dx = (float)(pos_b[0] - pos_a[0]);
+  const float dy = (float)(pos_b[1] - pos_a[1]);
+  const float dz = (float)(pos_b[2] - pos_a[2]);
+
+  struct gravity_sph_frame f;
+  gravity_sph_frame_init(dx, dy, dz, &f);
+
+  float X_re[multipole_sph_num_coeffs], X_im[multipole_sph_num_coeffs];
+
+  /* Do the first M2L translation */
+  gravity_sph_rotate_multipole(m_a, &f, X_re, X_im);
+  gravity_sph_translate_M2L(l_b, X_re, X_im, &f, 1.f);
+
+  /* Do the second M2L translation along the reversed separation */
+  gravity_sph_rotate_multipole(m_b, &f, X_re, X_im);
+  gravity_sph_translate_M2L(l_a, X_re, X_im, &f, -1.f);
+}
+
+/**
+ * @brief Compute the field tensor due to a single particle.
+ *
+ * @param l_b The field tensor to compute.
+ * @param ga The #gpart sourcing the field.
+ * @param pos_b The position of field tensor b.
+ * @param props The #gravity_props of this calculation.
+ * @param periodic Is the calculation periodic ?
+ * @param dim The size of the simulation box.
+ * @param rs_inv The inverse of the gravity mesh-smoothing scale.
+ */
+__attribute__((nonnull)) INLINE static void gravity_P2L(
+    struct grav_tensor *l_b, const struct gpart *ga, const double pos_b[3],
+    const struct gravity_props *props, const int periodic, const double dim[3],
+    const float rs_inv) {
+
+#ifdef SWIFT_DEBUG_CHECKS
+  /* Count all interactions
+   * Note that despite being in a section of the code protected by locks,
+   * we must use atomics here as the long-range task may update this
+   * counter in a lock-free section of code. */
+  accumulate_inc_ll(&l_b->num_interacted);
+
+  if (ga->time_bin == time_bin_not_created) {
+    error("Extra particle in P2L.");
+  }
+
+  if (periodic) error("Solid-harmonic multipoles used with periodic gravity");
+#endif
+
+#ifdef SWIFT_GRAVITY_FORCE_CHECKS
+  /* Count tree interactions
+   * Note that despite being in a section of the code protected by locks,
+   * we must use atomics here as the long-range task may update this
+   * counter in a lock-free section of code. */
+  accumulate_inc_ll(&l_b->num_interacted_tree);
+#endif
+
+  /* Record that this tensor has received contributions */
+  l_b->interacted = 1;
+
+  const float mass = ga->mass;
+
+  /* Compute distance vector */
+  const float dx = (float)(pos_b[0] - ga->x[0]);
+  const float dy = (float)(pos_b[1] - ga->x[1]);
+  const float dz = (float)(pos_b[2] - ga->x[2]);
+
+  float I_re[multipole_sph_num_coeffs], I_im[multipole_sph_num_coeffs];
+  gravity_sph_irregular(dx, dy, dz, SELF_GRAVITY_MULTIPOLE_ORDER, I_re, I_im);
+
+  /* L_k^l = (-1)^k m I_k^l */
+  for (int k = 0; k <= SELF_GRAVITY_MULTIPOLE_ORDER; ++k) {
+    const float m = (k & 1) ? -mass : mass;
+    for (int l = 0; l <= k; ++l) {
+      const int i = multipole_sph_index(k, l);
+      l_b->F_re[i] += m * I_re[i];
+      l_b->F_im[i] += m * I_im[i];
+    }
+  }
+}
+
+/**
+ * @brief Compute the reduced field tensor due to a multipole
+ *
+ * @param m The #multipole.
+ * @param r_x x-component of the distance vector to the multipole.
+ * @param r_y y-component of the distance vector to the multipole.
+ * @param r_z z-component of the distance vector to the multipole.
+ * @param r2 Square of the distance vector to the multipole.
+ * @param eps The softening length.
+ * @param periodic Is the calculation periodic ?
+ * @param rs_inv The inverse of the gravity mesh-smoothing scale.
+ * @param l (return) The #reduced_grav_tensor to compute.
+ */
+__attribute__((always_inline, nonnull)) INLINE static void gravity_M2P(
+    const struct multipole *const m, const float r_x, const float r_y,
+    const float r_z, const float r2, const float eps, const int periodic,
+    const float rs_inv, struct reduced_grav_tensor *const l) {
+
+#ifdef SWIFT_DEBUG_CHECKS
+  if (l->F_000 != 0. || l->F_100 != 0. || l->F_010 != 0. || l->F_001 != 0.)
+    error("Working on uninitialised reduced tensor!");
+
+  if (periodic) error("Solid-harmonic multipoles used with periodic gravity");
+#endif
+
+  /* Irregular harmonics at the particle's position relative to the CoM */
+  float I_re[multipole_sph_num_coeffs_M2P], I_im[multipole_sph_num_coeffs_M2P];
+  gravity_sph_irregular(-r_x, -r_y, -r_z, SELF_GRAVITY_MULTIPOLE_ORDER + 1,
+                        I_re, I_im);
+
+  /* 0th order term */
+  float phi = m->M_000 * I_re[0];
+  float L10 = -m->M_000 * I_re[multipole_sph_index(1, 0)];
+  float L11_re = -m->M_000 * I_re[multipole_sph_index(1, 1)];
+  float L11_im = -m->M_000 * I_im[multipole_sph_index(1, 1)];
+
+  /* Higher order terms (the dipole is 0 since we expand around CoM) */
+  for (int n = 2; n <= SELF_GRAVITY_MULTIPOLE_ORDER; ++n) {
+    for (int k = 0; k <= n; ++k) {
+      const float M_re = m->M_re[multipole_sph_index(n, k) - 3];
+      const float M_im = m->M_im[multipole_sph_index(n, k) - 3];
+      const float w = (k == 0) ? 1.f : 2.f;
+
+      /* Potential: sum_m conj(M_n^m) I_n^m */
+      const int i0 = multipole_sph_index(n, k);
+      phi += w * (M_re * I_re[i0] + M_im * I_im[i0]);
+
+      /* L_1^0 = -sum_m conj(M_n^m) I_{n+1}^m */
+      const int i1 = multipole_sph_index(n + 1, k);
+      L10 -= w * (M_re * I_re[i1] + M_im * I_im[i1]);
+
+      /* L_1^1 = -sum_m conj(M_n^m) I_{n+1}^{m+1} */
+      const int i2 = multipole_sph_index(n + 1, k + 1);
+      L11_re -= M_re * I_re[i2] + M_im * I_im[i2];
+      L11_im -= M_re * I_im[i2] - M_im * I_re[i2];
+      if (k > 0) {
+        const int i3 = multipole_sph_index(n + 1, k - 1);
+        L11_re += M_re * I_re[i3] + M_im * I_im[i3];
+        L11_im += M_im * I_re[i3] - M_re * I_im[i3];
+      }
+    }
+  }
+
+  /* Potential and its gradient */
+  l->F_000 -= phi;
+  l->F_100 -= L11_re;
+  l->F_010 -= L11_im;
+  l->F_001 += L10;
+}
+
+/**
+ * @brief Creates a copy of #grav_tensor shifted to a new location.
+ *
+ * @param la The #grav_tensor copy (content will  be overwritten).
+ * @param lb The #grav_tensor to shift.
+ * @param pos_a The position to which m_b will be shifted.
+ * @param pos_b The current postion of the multipole to shift.
+ */
+__attribute__((nonnull)) INLINE static void gravity_L2L(
+    struct grav_tensor *restrict la, const struct grav_tensor *restrict lb,
+    const double pos_a[3], const double pos_b[3]) {
+
+  /* Initialise everything to zero */
+  gravity_field_tensors_init(la, 0);
+
+#ifdef SWIFT_DEBUG_CHECKS
+  if (lb->num_interacted == 0) error("Shifting tensors that did not interact");
+
+  la->num_interacted = lb->num_interacted;
+#endif
+#ifdef SWIFT_GRAVITY_FORCE_CHECKS
+  la->num_interacted_tree = lb->num_interacted_tree;
+  la->num_interacted_pm = lb->num_interacted_pm;
+#endif
+
+  /* Regular harmonics of the shift */
+  double R_re[multipole_sph_num_coeffs], R_im[multipole_sph_num_coeffs];
+  gravity_sph_regular(pos_a[0] - pos_b[0], pos_a[1] - pos_b[1],
+                      pos_a[2] - pos_b[2], SELF_GRAVITY_MULTIPOLE_ORDER, R_re,
+                      R_im);
+
+  for (int k = 0; k <= SELF_GRAVITY_MULTIPOLE_ORDER; ++k) {
+    for (int l = 0; l <= k; ++l) {
+      double re, im;
+      gravity_sph_shift_local(lb->F_re, lb->F_im, R_re, R_im, k, l, &re, &im);
+      la->F_re[multipole_sph_index(k, l)] = re;
+      la->F_im[multipole_sph_index(k, l)] = im;
+    }
+  }
+}
+
+/**
+ * @brief Applies the  #grav_tensor to a  #gpart.
+ *
+ * @param lb The gravity field tensor to apply.
+ * @param loc The position of the gravity field tensor.
+ * @param gp The #gpart to update.
+ */
+__attribute__((nonnull)) INLINE static void gravity_L2P(
+    const struct grav_tensor *lb, const double loc[3], struct gpart *gp) {
+
+#ifdef SWIFT_DEBUG_CHECKS
+  if (gp->time_bin == time_bin_not_created) {
+    error("Extra particle in L2P.");
+  }
+
+  if (lb->num_interacted == 0) error("Interacting with empty field tensor");
+
+  accumulate_add_ll(&gp->num_interacted, lb->num_interacted);
+#endif
+
+#ifdef SWIFT_GRAVITY_FORCE_CHECKS
+  accumulate_add_ll(&gp->num_interacted_m2l, lb->num_interacted_tree);
+  accumulate_add_ll(&gp->num_interacted_pm, lb->num_interacted_pm);
+#endif
+
+  /* Regular harmonics of the distance to the multipole */
+  double R_re[multipole_sph_num_coeffs], R_im[multipole_sph_num_coeffs];
+  gravity_sph_regular(gp->x[0] - loc[0], gp->x[1] - loc[1], gp->x[2] - loc[2],
+                      SELF_GRAVITY_MULTIPOLE_ORDER, R_re, R_im);
+
+  /* Local expansion at the particle's position up to degree 1 */
+  double L00_re, L00_im, L10_re, L10_im, L11_re, L11_im;
+  gravity_sph_shift_local(lb->F_re, lb->F_im, R_re, R_im, 0, 0, &L00_re,
+                          &L00_im);
+  gravity_sph_shift_local(lb->F_re, lb->F_im, R_re, R_im, 1, 0, &L10_re,
+                          &L10_im);
+  gravity_sph_shift_local(lb->F_re, lb->F_im, R_re, R_im, 1, 1, &L11_re,
+                          &L11_im);
+
+  /* Potential and its gradient */
+  const double a_grav[3] = {-L11_re, -L11_im, L10_re};
+  const double pot = -L00_re;
+
+  /* Update the particle */
+  gp->a_grav[0] += a_grav[0];
+  gp->a_grav[1] += a_grav[1];
+  gp->a_grav[2] += a_grav[2];
+  gravity_add_comoving_potential(gp, pot);
+
+#ifdef SWIFT_GRAVITY_FORCE_CHECKS
+  gp->a_grav_m2l[0] += a_grav[0];
+  gp->a_grav_m2l[1] += a_grav[1];
+  gp->a_grav_m2l[2] += a_grav[2];
+#endif
+}
+
+#endif /* SWIFT_MULTIPOLE_SPHERICAL_H */
@@ -30,11 +30,37 @@
  */
 #define multipole_align 128
 
+#ifdef SWIFT_MULTIPOLE_SPHERICAL
+
+/**
+ * @brief Number of complex solid-harmonic coefficients with m >= 0 up to
+ * the multipole order.
+ */
+#define multipole_sph_num_coeffs \
+  ((SELF_GRAVITY_MULTIPOLE_ORDER + 1) * (SELF_GRAVITY_MULTIPOLE_ORDER + 2) / 2)
+
+/**
+ * @brief Index of the coefficient of degree n and order m >= 0.
+ */
+#define multipole_sph_index(n, m) ((n) * ((n) + 1) / 2 + (m))
+
+#endif
+
 /**
  * @brief Field tensor components at the location of the multipole.
  */
 struct grav_tensor {
 
+#ifdef SWIFT_MULTIPOLE_SPHERICAL
+
+  /*! Real part of the local expansion coefficients L_n^m (m >= 0) */
+  float F_re[multipole_sph_num_coeffs];
+
+  /*! Imaginary part of the local expansion coefficients L_n^m (m >= 0) */
+  float F_im[multipole_sph_num_coeffs];
+
+#else
+
   /* 0th order terms */
   float F_000;
 
@@ -83,6 +109,8 @@ struct grav_tensor {
 #error "Missing implementation for order >5"
 #endif
 
+#endif /* SWIFT_MULTIPOLE_SPHERICAL */
+
 #ifdef SWIFT_GRAVITY_FORCE_CHECKS
   /* Number of gparts interacted through the tree. */
   long long num_interacted_tree;
@@ -130,6 +158,19 @@ struct multipole {
   /* 0th order term */
   float M_000;
 
+#ifdef SWIFT_MULTIPOLE_SPHERICAL
+
+  /* Solid-harmonic moments M_n^m of degree n >= 2 and order m >= 0 stored
+   * at multipole_sph_index(n, m) - 3 (the dipole vanishes around the CoM) */
+
+  /*! Real part of the moments */
+  float M_re[multipole_sph_num_coeffs - 3];
+
+  /*! Imaginary part of the moments */
+  float M_im[multipole_sph_num_coeffs - 3];
+
+#else
+
 #if SELF_GRAVITY_MULTIPOLE_ORDER > 0
 
   /* 1st order terms (all 0 since we expand around CoM) */
@@ -177,6 +218,8 @@ struct multipole {
 #error "Missing implementation for order >5"
 #endif
 
+#endif /* SWIFT_MULTIPOLE_SPHERICAL */
+
 #if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_GRAVITY_FORCE_CHECKS)
 
   /* Total number of gpart in this multipole */
@@ -215,6 +258,14 @@ struct gravity_tensors {
 
       /*! Upper limit of the CoM<->gpart distance at the last rebuild */
       double r_max_rebuild;
+
+      /*! Upper limit of the distance any #gpart moved away from the bulk
+       * motion since the multipole was last constructed */
+      double r_drift;
+
+      /*! Last (integer) time the multipole was constructed from its #gpart
+       * or from its progeny */
+      integertime_t ti_make;
     };
   };
 } SWIFT_STRUCT_ALIGN;
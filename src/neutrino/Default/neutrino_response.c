@@ -424,6 +424,48 @@ struct neutrino_response_tp_data {
   const double *pt_density_ratio;
 };
 
+/**
+ * @brief Interpolate the linear neutrino response at a given wavenumber.
+ *
+ * @param data The interpolation properties.
+ * @param k2 The square of the (comoving) wavenumber (must be > 0).
+ * @return The factor by which to multiply the potential.
+ */
+__attribute__((always_inline)) INLINE static double
+neutrino_response_correction(const struct neutrino_response_tp_data *data,
+                             const double k2) {
+
+  const int N_k = wavenumber_length;
+  const hsize_t a_index = data->a_index;
+  const double u_a = data->u_a;
+  const double *pt_density_ratio = data->pt_density_ratio;
+
+  /* Interpolate along the k-axis */
+  const double log_k = 0.5 * log(k2);
+  const double log_k_steps = (log_k - data->log_k_min) * data->inv_delta_log_k;
+  const hsize_t k_index = (hsize_t)log_k_steps;
+  const double u_k = log_k_steps - k_index;
+
+  /* Retrieve the bounding values */
+  const double T11 = pt_density_ratio[N_k * a_index + k_index];
+  const double T21 = pt_density_ratio[N_k * a_index + k_index + 1];
+  const double T12 = pt_density_ratio[N_k * (a_index + 1) + k_index];
+  const double T22 = pt_density_ratio[N_k * (a_index + 1) + k_index + 1];
+
+  /* Bilinear interpolation of the tranfer function ratio */
+  double pt_ratio_interp = (1.0 - u_a) * ((1.0 - u_k) * T11 + u_k * T21) +
+                           u_a * ((1.0 - u_k) * T12 + u_k * T22);
+
+#ifdef SWIFT_DEBUG_CHECKS
+  if (u_k < 0 || u_a < 0 || u_k > 1 || u_a > 1 ||
+      k_index > wavenumber_length || a_index > timestep_length)
+    error("Interpolation out of bounds error: %g %g %g %g %llu %llu\n", u_k,
+          u_a, sqrt(k2), pt_ratio_interp, k_index, a_index);
+#endif
+
+  return 1.0 + pt_ratio_interp * data->bg_density_ratio;
+}
+
 /**
  * @brief Mapper function for the application of the linear neutrino response.
  *
@@ -444,17 +486,6 @@ void neutrino_response_apply_neutrino_response_mapper(void *map_data,
   const int N_half = N / 2;
   const double delta_k = 2.0 * M_PI / data->boxlen;
 
-  /* Unpack the interpolation properties */
-  const hsize_t a_index = data->a_index;
-  const double u_a = data->u_a;
-  const double inv_delta_log_k = data->inv_delta_log_k;
-  const double log_k_min = data->log_k_min;
-  const int N_k = wavenumber_length;
-
-  /* Unpack the density ratios (background & perturbation) */
-  const double bg_density_ratio = data->bg_density_ratio;
-  const double *pt_density_ratio = data->pt_density_ratio;
-
   /* Find what slice of the full mesh is stored on this MPI rank */
   const int slice_offset = data->slice_offset;
 
@@ -476,29 +507,7 @@ void neutrino_response_apply_neutrino_response_mapper(void *map_data,
         /* Skip the DC mode */
         if (k2 == 0.) continue;
 
-        /* Interpolate along the k-axis */
-        const double log_k = 0.5 * log(k2);
-        const double log_k_steps = (log_k - log_k_min) * inv_delta_log_k;
-        const hsize_t k_index = (hsize_t)log_k_steps;
-        const double u_k = log_k_steps - k_index;
-
-        /* Retrieve the bounding values */
-        const double T11 = pt_density_ratio[N_k * a_index + k_index];
-        const double T21 = pt_density_ratio[N_k * a_index + k_index + 1];
-        const double T12 = pt_density_ratio[N_k * (a_index + 1) + k_index];
-        const double T22 = pt_density_ratio[N_k * (a_index + 1) + k_index + 1];
-
-        /* Bilinear interpolation of the tranfer function ratio */
-        double pt_ratio_interp = (1.0 - u_a) * ((1.0 - u_k) * T11 + u_k * T21) +
-                                 u_a * ((1.0 - u_k) * T12 + u_k * T22);
-        double correction = 1.0 + pt_ratio_interp * bg_density_ratio;
-
-#ifdef SWIFT_DEBUG_CHECKS
-        if (u_k < 0 || u_a < 0 || u_k > 1 || u_a > 1 ||
-            k_index > wavenumber_length || a_index > timestep_length)
-          error("Interpolation out of bounds error: %g %g %g %g %llu %llu\n",
-                u_k, u_a, sqrt(k2), pt_ratio_interp, k_index, a_index);
-#endif
+        const double correction = neutrino_response_correction(data, k2);
 
         /* Apply to the mesh */
         const int index =
@@ -511,31 +520,19 @@ void neutrino_response_apply_neutrino_response_mapper(void *map_data,
 }
 
 /**
- * @brief Apply the linear neutrino response to the Fourier transform of the
- * gravitational potential.
+ * @brief Gather the interpolation properties of the response at the current
+ * time.
  *
  * @param s The current #space
  * @param mesh The #pm_mesh used to store the potential
- * @param tp The #threadpool object used for parallelisation
- * @param frho The NxNx(N/2) complex array of the Fourier transform of the
- * density field
- * @param slice_offset The x coordinate of the start of the slice on this MPI
- * rank
- * @param slice_width The width of the local slice on this MPI rank
- * @param verbose Are we talkative?
+ * @param data (return) The interpolation properties.
  */
-void neutrino_response_compute(const struct space *s, struct pm_mesh *mesh,
-                               struct threadpool *tp, fftw_complex *frho,
-                               const int slice_offset, const int slice_width,
-                               int verbose) {
-#ifdef HAVE_FFTW
+static void neutrino_response_prepare(const struct space *s,
+                                      const struct pm_mesh *mesh,
+                                      struct neutrino_response_tp_data *data) {
 
   const struct cosmology *c = s->e->cosmology;
-  struct neutrino_response *numesh = s->e->neutrino_response;
-
-  /* Grid size */
-  const int N = mesh->N;
-  const double boxlen = mesh->dim[0];
+  const struct neutrino_response *numesh = s->e->neutrino_response;
 
   /* Calculate the background neutrino density */
   const double a = numesh->fixed_bg_density ? 1.0 : c->a;
@@ -566,18 +563,41 @@ void neutrino_response_compute(const struct space *s, struct pm_mesh *mesh,
   }
 
   /* Some common factors */
+  bzero(data, sizeof(struct neutrino_response_tp_data));
+  data->N = mesh->N;
+  data->boxlen = mesh->dim[0];
+  data->inv_delta_log_k = inv_delta_log_k;
+  data->log_k_min = log_k_min;
+  data->a_index = a_index;
+  data->u_a = u_a;
+  data->bg_density_ratio = bg_density_ratio;
+  data->pt_density_ratio = numesh->pt_density_ratio;
+}
+
+/**
+ * @brief Apply the linear neutrino response to the Fourier transform of the
+ * gravitational potential.
+ *
+ * @param s The current #space
+ * @param mesh The #pm_mesh used to store the potential
+ * @param tp The #threadpool object used for parallelisation
+ * @param frho The NxNx(N/2) complex array of the Fourier transform of the
+ * density field
+ * @param slice_offset The x coordinate of the start of the slice on this MPI
+ * rank
+ * @param slice_width The width of the local slice on this MPI rank
+ * @param verbose Are we talkative?
+ */
+void neutrino_response_compute(const struct space *s, struct pm_mesh *mesh,
+                               struct threadpool *tp, fftw_complex *frho,
+                               const int slice_offset, const int slice_width,
+                               int verbose) {
+
   struct neutrino_response_tp_data data;
+  neutrino_response_prepare(s, mesh, &data);
   data.frho = frho;
-  data.N = N;
-  data.boxlen = boxlen;
   data.slice_offset = slice_offset;
   data.slice_width = slice_width;
-  data.inv_delta_log_k = inv_delta_log_k;
-  data.log_k_min = log_k_min;
-  data.a_index = a_index;
-  data.u_a = u_a;
-  data.bg_density_ratio = bg_density_ratio;
-  data.pt_density_ratio = numesh->pt_density_ratio;
 
   /* Parallelize the neutrino linear response application using the threadpool
      to split the x-axis loop over the threads. The array is N x N x (N/2).
@@ -591,10 +611,33 @@ void neutrino_response_compute(const struct space *s, struct pm_mesh *mesh,
     frho[0][0] = 0.;
     frho[0][1] = 0.;
   }
+}
 
-#else
-  error("No FFTW library found. Cannot compute periodic long-range forces.");
-#endif
+/**
+ * @brief Multiply a table of factors indexed by the integer |k|^2 of the
+ * modes by the linear neutrino response.
+ *
+ * The response only depends on |k|, so the mesh can apply it in the same
+ * pass as the Green function using this table.
+ *
+ * @param s The current #space
+ * @param mesh The #pm_mesh used to store the potential
+ * @param nr_k2 The number of entries in the table.
+ * @param table (in/out) The factors to multiply, indexed by
+ * kx^2 + ky^2 + kz^2 in units of the fundamental mode.
+ */
+void neutrino_response_multiply_k2_table(const struct space *s,
+                                         const struct pm_mesh *mesh,
+                                         const int nr_k2, double *table) {
+
+  struct neutrino_response_tp_data data;
+  neutrino_response_prepare(s, mesh, &data);
+
+  const double delta_k = 2.0 * M_PI / data.boxlen;
+
+  /* Skip the DC mode */
+  for (int k2 = 1; k2 < nr_k2; ++k2)
+    table[k2] *= neutrino_response_correction(&data, k2 * delta_k * delta_k);
 }
 
 #endif /* HAVE FFTW */
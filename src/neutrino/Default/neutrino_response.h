@@ -76,6 +76,9 @@ void neutrino_response_compute(const struct space *s, struct pm_mesh *mesh,
                                struct threadpool *tp, fftw_complex *frho,
                                const int slice_offset, const int slice_width,
                                int verbose);
+void neutrino_response_multiply_k2_table(const struct space *s,
+                                         const struct pm_mesh *mesh,
+                                         const int nr_k2, double *table);
 #endif /* HAVE_FFTW */
 
 void neutrino_response_struct_dump(const struct neutrino_response *numesh,
@@ -59,7 +59,9 @@
 #include "error.h"
 #include "partition.h"
 #include "restart.h"
+#include "scheduler.h"
 #include "space.h"
+#include "task_cost_model.h"
 #include "threadpool.h"
 #include "tools.h"
 
@@ -1363,6 +1365,8 @@ struct weights_mapper_data {
   int nr_cells;
   int use_ticks;
   struct cell *cells;
+  const struct scheduler *sched;
+  const struct task_cost_model *cost_model;
 };
 
 #ifdef SWIFT_DEBUG_CHECKS
@@ -1394,6 +1398,7 @@ void partition_gather_weights(void *map_data, int num_elements,
   int timebins = mydata->timebins;
   int vweights = mydata->vweights;
   int use_ticks = mydata->use_ticks;
+  const struct task_cost_model *cost_model = mydata->cost_model;
 
   struct cell *cells = mydata->cells;
 
@@ -1410,6 +1415,11 @@ void partition_gather_weights(void *map_data, int num_elements,
     double w = 0.0;
     if (use_ticks) {
       w = (double)t->toc - (double)t->tic;
+    } else if (cost_model != NULL) {
+      w = task_cost_model_fixed_cost(
+          cost_model, t->type, t->subtype,
+          scheduler_task_static_cost(mydata->sched, t),
+          repartition_costs[t->type][t->subtype]);
     } else {
       w = repartition_costs[t->type][t->subtype];
     }
@@ -1589,6 +1599,8 @@ static void repart_edge_metis(int vweights, int eweights, int timebins,
   weights_data.weights_e = weights_e;
   weights_data.weights_v = weights_v;
   weights_data.use_ticks = repartition->use_ticks;
+  weights_data.sched = &s->e->sched;
+  weights_data.cost_model = s->e->task_cost_model;
 
   ticks tic = getticks();
 
@@ -2193,9 +2205,13 @@ void partition_init(struct partition *partition,
       params, "DomainDecomposition:use_fixed_costs", 0);
   if (repartition->type == REPART_NONE) repartition->use_fixed_costs = 0;
 
-  /* Check if this is true or required and initialise them. */
+  /* Check if this is true or required and initialise them. The costs learned
+   * from the task times replace the fixed ones when available. */
   if (repartition->use_fixed_costs || repartition->trigger > 1) {
-    if (!repart_init_fixed_costs()) {
+    const int have_fixed_costs = repart_init_fixed_costs();
+    const int have_cost_model =
+        parser_get_opt_param_int(params, "Scheduler:task_cost_model", 0);
+    if (!have_fixed_costs && !have_cost_model) {
       if (repartition->trigger <= 1) {
         if (engine_rank == 0)
           message(
@@ -2303,6 +2319,7 @@ static void check_weights(struct task *tasks, int nr_tasks,
   int timebins = mydata->timebins;
   int vweights = mydata->vweights;
   int use_ticks = mydata->use_ticks;
+  const struct task_cost_model *cost_model = mydata->cost_model;
 
   struct cell *cells = mydata->cells;
 
@@ -2335,6 +2352,11 @@ static void check_weights(struct task *tasks, int nr_tasks,
     double w = 0.0;
     if (use_ticks) {
       w = (double)t->toc - (double)t->tic;
+    } else if (cost_model != NULL) {
+      w = task_cost_model_fixed_cost(
+          cost_model, t->type, t->subtype,
+          scheduler_task_static_cost(mydata->sched, t),
+          repartition_costs[t->type][t->subtype]);
     } else {
       w = repartition_costs[t->type][t->subtype];
     }
@@ -38,6 +38,8 @@
 /* Local includes. */
 #include "cooling.h"
 #include "engine.h"
+#include "fft_plans.h"
+#include "mesh_window.h"
 #include "minmax.h"
 #include "neutrino.h"
 #include "random.h"
@@ -50,6 +52,8 @@
 #define power_data_default_grid_side_length 256
 #define power_data_default_fold_factor 4
 #define power_data_default_window_order 3
+#define power_data_default_interlacing 0
+#define power_data_default_fftw_planner "measure"
 
 #ifdef HAVE_FFTW
 
@@ -129,6 +133,7 @@ struct grid_mapper_data {
   int N;
   enum power_type type;
   int windoworder;
+  double shift;
   double dim[3];
   double fac;
   const struct engine* e;
@@ -145,6 +150,15 @@ struct conv_mapper_data {
   double invcellmean;
 };
 
+/**
+ * @brief Shared information needed for combining two interlaced Fourier grids.
+ */
+struct interlace_mapper_data {
+  fftw_complex* powgridft;
+  fftw_complex* powgridft_shift;
+  int Ngrid;
+};
+
 /**
  * @brief Shared information needed for calculating power from a Fourier grid.
  */
@@ -530,6 +544,45 @@ INLINE static void gpart_to_grid_CIC(const struct gpart* gp, double* rho,
   CIC_set(rho, N, i, j, k, tx, ty, tz, dx, dy, dz, value);
 }
 
+/**
+ * @brief Assigns a quantity to the grid with a window of any order,
+ * possibly on a grid shifted with respect to the box.
+ *
+ * @param gp The #gpart.
+ * @param rho The (padded) grid.
+ * @param N the size of the grid along one axis.
+ * @param fac Conversion factor of wrapped position to grid.
+ * @param dim The (folded) dimensions of the box.
+ * @param order The order of the window.
+ * @param shift The shift of the positions in units of grid cells.
+ * @param value The quantity to assign.
+ */
+INLINE static void gpart_to_grid_window(const struct gpart* gp, double* rho,
+                                        const int N, const double fac,
+                                        const double dim[3], const int order,
+                                        const double shift,
+                                        const double value) {
+
+  double wx[MESH_WINDOW_MAX_ORDER], wy[MESH_WINDOW_MAX_ORDER],
+      wz[MESH_WINDOW_MAX_ORDER];
+  const int i = mesh_window_weights(
+      order, box_wrap_multiple(gp->x[0], 0., dim[0]) * fac + shift, wx);
+  const int j = mesh_window_weights(
+      order, box_wrap_multiple(gp->x[1], 0., dim[1]) * fac + shift, wy);
+  const int k = mesh_window_weights(
+      order, box_wrap_multiple(gp->x[2], 0., dim[2]) * fac + shift, wz);
+
+  for (int a = 0; a < order; ++a) {
+    for (int b = 0; b < order; ++b) {
+      const double wxy = value * wx[a] * wy[b];
+      for (int c = 0; c < order; ++c)
+        atomic_add_d(&rho[row_major_id_periodic_with_padding(i + a, j + b,
+                                                             k + c, N, 2)],
+                     wxy * wz[c]);
+    }
+  }
+}
+
 INLINE static void gpart_to_grid_NGP(const struct gpart* gp, double* rho,
                                      const int N, const double fac,
                                      const double dim[3], const double value) {
@@ -555,12 +608,14 @@ INLINE static void gpart_to_grid_NGP(const struct gpart* gp, double* rho,
  * @param fac Conversion factor of wrapped position to grid.
  * @param type The #power_type we want to assign to the grid.
  * @param windoworder The window to use for grid assignment.
+ * @param shift The shift of the positions in units of grid cells.
  * @param e The #engine.
  */
 void cell_to_powgrid(const struct cell* c, double* rho, const int N,
                      const double fac, const enum power_type type,
-                     const int windoworder, const double dim[3],
-                     const struct engine* e, struct neutrino_model* nu_model) {
+                     const int windoworder, const double shift,
+                     const double dim[3], const struct engine* e,
+                     struct neutrino_model* nu_model) {
 
   const int gcount = c->grav.count;
   const struct gpart* gparts = c->grav.parts;
@@ -611,6 +666,11 @@ void cell_to_powgrid(const struct cell* c, double* rho, const int N,
     }
 
     /* Assign the quantity to the grid */
+    if (windoworder > 3 || shift != 0.) {
+      gpart_to_grid_window(&gparts[i], rho, N, fac, dim, windoworder, shift,
+                           quantity);
+      continue;
+    }
     switch (windoworder) {
       case 1:
         gpart_to_grid_NGP(&gparts[i], rho, N, fac, dim, quantity);
@@ -647,6 +707,7 @@ void cell_to_powgrid_mapper(void* map_data, int num, void* extra) {
   const int Ngrid = data->N;
   const enum power_type type = data->type;
   const int order = data->windoworder;
+  const double shift = data->shift;
   const double dim[3] = {data->dim[0], data->dim[1], data->dim[2]};
   const double gridfac = data->fac;
   const struct engine* e = data->e;
@@ -661,7 +722,8 @@ void cell_to_powgrid_mapper(void* map_data, int num, void* extra) {
     const struct cell* c = &cells[local_cells[i]];
 
     /* Assign this cell's content to the grid */
-    cell_to_powgrid(c, grid, Ngrid, gridfac, type, order, dim, e, nu_model);
+    cell_to_powgrid(c, grid, Ngrid, gridfac, type, order, shift, dim, e,
+                    nu_model);
   }
 }
 
@@ -696,6 +758,58 @@ void mass_to_contrast_mapper(void* map_data, int num, void* extra) {
   }
 }
 
+/**
+ * @brief Mapper function for combining a Fourier grid with its interlaced
+ * counterpart.
+ *
+ * The shifted grid is brought back to the frame of the first one and the two
+ * are averaged into the first grid, which cancels the odd aliasing images.
+ *
+ * @param map_data The array of the density field Fourier transform.
+ * @param num The number of elements to iterate on (along the x-axis).
+ * @param extra The #interlace_mapper_data.
+ */
+void interlace_grid_mapper(void* map_data, const int num, void* extra) {
+
+  const struct interlace_mapper_data* data =
+      (struct interlace_mapper_data*)extra;
+
+  /* Unpack the data struct */
+  fftw_complex* restrict powgridft = data->powgridft;
+  fftw_complex* restrict powgridft_shift = data->powgridft_shift;
+  const int Ngrid = data->Ngrid;
+  const int Nhalf = Ngrid / 2;
+
+  /* Range handled by this call */
+  const int xi_start = (fftw_complex*)map_data - powgridft;
+  const int xi_end = xi_start + num;
+
+  for (int xi = xi_start; xi < xi_end; ++xi) {
+
+    int kx = xi;
+    if (kx > Nhalf) kx -= Ngrid;
+
+    for (int yi = 0; yi < Ngrid; ++yi) {
+
+      int ky = yi;
+      if (ky > Nhalf) ky -= Ngrid;
+
+      for (int zi = 0; zi < (Nhalf + 1); ++zi) {
+
+        const double phase = mesh_window_interlacing_phase(kx, ky, zi, Ngrid);
+        const double c = cos(phase);
+        const double s = sin(phase);
+
+        const int index = (xi * Ngrid + yi) * (Nhalf + 1) + zi;
+        double* a = powgridft[index];
+        const double* b = powgridft_shift[index];
+        a[0] = 0.5 * (a[0] + c * b[0] - s * b[1]);
+        a[1] = 0.5 * (a[1] + s * b[0] + c * b[1]);
+      }
+    }
+  }
+}
+
 /**
  * @brief Mapper function for calculating the power from a Fourier grid.
  *
@@ -839,6 +953,68 @@ INLINE static void power_init_output_file(FILE* fp, const enum power_type type1,
   fprintf(fp, "# %13s %15s %15s %15s\n", "z", "k", "P(k)", "P_noise");
 }
 
+/**
+ * @brief Assign the particles of the local cells to a power spectrum grid and
+ * gather the full grid on rank 0.
+ *
+ * @param data The information about the field to assign.
+ * @param grid The (padded) grid to fill.
+ * @param shift The shift of the positions in units of grid cells.
+ * @param local_cells The list of local top-level cells.
+ * @param nr_local_cells The number of local top-level cells.
+ * @param nodeID The rank of this node.
+ * @param tp The #threadpool.
+ */
+static void power_assign_grid(struct grid_mapper_data* data, double* grid,
+                              const double shift, const int* local_cells,
+                              const int nr_local_cells, const int nodeID,
+                              struct threadpool* tp) {
+
+  const int Ngrid = data->N;
+  const size_t size = (size_t)Ngrid * Ngrid * (Ngrid + 2);
+
+  bzero(grid, size * sizeof(double));
+
+  data->dens = grid;
+  data->shift = shift;
+  threadpool_map(tp, cell_to_powgrid_mapper, (void*)local_cells,
+                 nr_local_cells, sizeof(int), threadpool_auto_chunk_size,
+                 (void*)data);
+
+#ifdef WITH_MPI
+  /* Merge everybody's share of the grid onto rank 0 */
+  if (nodeID == 0)
+    MPI_Reduce(MPI_IN_PLACE, grid, size, MPI_DOUBLE, MPI_SUM, 0,
+               MPI_COMM_WORLD);
+  else
+    MPI_Reduce(grid, NULL, size, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+#endif
+}
+
+/**
+ * @brief Convert mass to density contrast (or pressure to eV/cm^3) on a grid.
+ *
+ * @param convdata The conversion information (grid size set).
+ * @param grid The (padded) grid to convert.
+ * @param invcellmean The inverse of the mean value per grid cell.
+ * @param tp The #threadpool.
+ */
+static void power_grid_to_contrast(struct conv_mapper_data* convdata,
+                                   double* grid, const double invcellmean,
+                                   struct threadpool* tp) {
+
+  const int Ngrid = convdata->Ngrid;
+
+  convdata->grid = grid;
+  convdata->invcellmean = invcellmean;
+  if (Ngrid < 32) {
+    mass_to_contrast_mapper(grid, Ngrid, convdata);
+  } else {
+    threadpool_map(tp, mass_to_contrast_mapper, grid, Ngrid, sizeof(double),
+                   threadpool_auto_chunk_size, convdata);
+  }
+}
+
 /**
  * @brief Compute the power spectrum between type1 and type2, including
  * foldings and dealiasing. Only the real part of the power is returned.
@@ -905,6 +1081,22 @@ void power_spectrum(const enum power_type type1, const enum power_type type2,
     pow_data->powgridft2 = pow_data->powgridft;
   }
 
+  /* Same for the grids shifted by half a cell when interlacing */
+  double* powgrid_shift = NULL;
+  double* powgrid2_shift = NULL;
+  if (pow_data->interlacing) {
+    powgrid_shift = fftw_alloc_real(Ngrid2 * (Ngrid + 2));
+    memuse_log_allocation("fftw_grid.grid_shift", powgrid_shift, 1,
+                          sizeof(double) * Ngrid2 * (Ngrid + 2));
+    if (type1 != type2) {
+      powgrid2_shift = fftw_alloc_real(Ngrid2 * (Ngrid + 2));
+      memuse_log_allocation("fftw_grid.grid2_shift", powgrid2_shift, 1,
+                            sizeof(double) * Ngrid2 * (Ngrid + 2));
+    } else {
+      powgrid2_shift = powgrid_shift;
+    }
+  }
+
   /* Constants used for the normalization */
   double dim[3] = {s->dim[0], s->dim[1], s->dim[2]};
   const double volume = dim[0] * dim[1] * dim[2]; /* units Mpc^3 */
@@ -944,6 +1136,7 @@ void power_spectrum(const enum power_type type1, const enum power_type type2,
   densdata.N = Ngrid;
   densdata.type = type1;
   densdata.windoworder = pow_data->windoworder;
+  densdata.shift = 0.;
   densdata.e = s->e;
   densdata.nu_model = &nu_model;
   if (type1 != type2) {
@@ -952,6 +1145,7 @@ void power_spectrum(const enum power_type type1, const enum power_type type2,
     densdata2.N = Ngrid;
     densdata2.type = type2;
     densdata2.windoworder = pow_data->windoworder;
+    densdata2.shift = 0.;
     densdata2.e = s->e;
     densdata2.nu_model = &nu_model;
   }
@@ -1058,71 +1252,71 @@ void power_spectrum(const enum power_type type1, const enum power_type type2,
     densdata2.dim[2] = dim[2];
     const double kfac = 2 * M_PI / dim[0];
 
-    /* Empty the grid(s) */
-    bzero(pow_data->powgrid, Ngrid2 * (Ngrid + 2) * sizeof(double));
-    if (type1 != type2)
-      bzero(pow_data->powgrid2, Ngrid2 * (Ngrid + 2) * sizeof(double));
-
-    /* Fill out the folded grid(s) */
-    threadpool_map(tp, cell_to_powgrid_mapper, (void*)local_cells,
-                   nr_local_cells, sizeof(int), threadpool_auto_chunk_size,
-                   (void*)&densdata);
+    /* Fill out the folded grid(s) and gather them on rank 0 */
+    power_assign_grid(&densdata, pow_data->powgrid, 0., local_cells,
+                      nr_local_cells, e->nodeID, tp);
     if (type1 != type2)
-      threadpool_map(tp, cell_to_powgrid_mapper, (void*)local_cells,
-                     nr_local_cells, sizeof(int), threadpool_auto_chunk_size,
-                     (void*)&densdata2);
-#ifdef WITH_MPI
-    /* Merge everybody's share of the grid onto rank 0 */
-    if (e->nodeID == 0)
-      MPI_Reduce(MPI_IN_PLACE, pow_data->powgrid, Ngrid2 * (Ngrid + 2),
-                 MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
-    else
-      MPI_Reduce(pow_data->powgrid, NULL, Ngrid2 * (Ngrid + 2), MPI_DOUBLE,
-                 MPI_SUM, 0, MPI_COMM_WORLD);
-
-    /* Same for the secondary grid */
-    if (type1 != type2) {
+      power_assign_grid(&densdata2, pow_data->powgrid2, 0., local_cells,
+                        nr_local_cells, e->nodeID, tp);
 
-      if (e->nodeID == 0)
-        MPI_Reduce(MPI_IN_PLACE, pow_data->powgrid2, Ngrid2 * (Ngrid + 2),
-                   MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
-      else
-        MPI_Reduce(pow_data->powgrid2, NULL, Ngrid2 * (Ngrid + 2), MPI_DOUBLE,
-                   MPI_SUM, 0, MPI_COMM_WORLD);
+    /* Same for the grid(s) shifted by half a cell */
+    if (pow_data->interlacing) {
+      power_assign_grid(&densdata, powgrid_shift, 0.5, local_cells,
+                        nr_local_cells, e->nodeID, tp);
+      if (type1 != type2)
+        power_assign_grid(&densdata2, powgrid2_shift, 0.5, local_cells,
+                          nr_local_cells, e->nodeID, tp);
     }
-#endif
 
     /* Only rank 0 needs to perform all the remaining work */
     if (e->nodeID == 0) {
 
       /* Convert mass to density contrast or pressure to eV/cm^3 */
-      convdata.grid = pow_data->powgrid;
-      convdata.invcellmean = invcellmean;
-      if (Ngrid < 32) {
-        mass_to_contrast_mapper(pow_data->powgrid, Ngrid, &convdata);
-      } else {
-        threadpool_map(tp, mass_to_contrast_mapper, pow_data->powgrid, Ngrid,
-                       sizeof(double), threadpool_auto_chunk_size, &convdata);
-      }
-
-      if (type1 != type2) {
-        convdata.grid = pow_data->powgrid2;
-        convdata.invcellmean = invcellmean2;
-        if (Ngrid < 32) {
-          mass_to_contrast_mapper(pow_data->powgrid2, Ngrid, &convdata);
-        } else {
-          threadpool_map(tp, mass_to_contrast_mapper, pow_data->powgrid2, Ngrid,
-                         sizeof(double), threadpool_auto_chunk_size, &convdata);
-        }
+      power_grid_to_contrast(&convdata, pow_data->powgrid, invcellmean, tp);
+      if (type1 != type2)
+        power_grid_to_contrast(&convdata, pow_data->powgrid2, invcellmean2,
+                               tp);
+      if (pow_data->interlacing) {
+        power_grid_to_contrast(&convdata, powgrid_shift, invcellmean, tp);
+        if (type1 != type2)
+          power_grid_to_contrast(&convdata, powgrid2_shift, invcellmean2, tp);
       }
 
       /* Perform FFT(s) */
+      const ticks tic_fft = getticks();
       fftw_execute_dft_r2c(pow_data->fftplanpow, pow_data->powgrid,
                            pow_data->powgridft);
       if (type1 != type2)
         fftw_execute_dft_r2c(pow_data->fftplanpow2, pow_data->powgrid2,
                              pow_data->powgridft2);
 
+      /* Average with the shifted grid(s) to cancel the odd aliasing images */
+      if (pow_data->interlacing) {
+        struct interlace_mapper_data ildata;
+        ildata.Ngrid = Ngrid;
+
+        fftw_execute_dft_r2c(pow_data->fftplanpow, powgrid_shift,
+                             (fftw_complex*)powgrid_shift);
+        ildata.powgridft = pow_data->powgridft;
+        ildata.powgridft_shift = (fftw_complex*)powgrid_shift;
+        threadpool_map(tp, interlace_grid_mapper, pow_data->powgridft, Ngrid,
+                       sizeof(fftw_complex), threadpool_auto_chunk_size,
+                       &ildata);
+
+        if (type1 != type2) {
+          fftw_execute_dft_r2c(pow_data->fftplanpow2, powgrid2_shift,
+                               (fftw_complex*)powgrid2_shift);
+          ildata.powgridft = pow_data->powgridft2;
+          ildata.powgridft_shift = (fftw_complex*)powgrid2_shift;
+          threadpool_map(tp, interlace_grid_mapper, pow_data->powgridft2,
+                         Ngrid, sizeof(fftw_complex),
+                         threadpool_auto_chunk_size, &ildata);
+        }
+      }
+      if (verbose)
+        message("Fourier transform(s) of folding num. %d took %.3f %s.", i,
+                clocks_from_ticks(getticks() - tic_fft), clocks_getunit());
+
       powmapdata.powgridft = pow_data->powgridft;
       powmapdata.powgridft2 = pow_data->powgridft2;
 
@@ -1228,6 +1422,14 @@ void power_spectrum(const enum power_type type1, const enum power_type type2,
   }
   pow_data->powgrid2 = NULL;
   pow_data->powgridft2 = NULL;
+  if (pow_data->interlacing) {
+    if (type1 != type2) {
+      memuse_log_allocation("fftw_grid.grid2_shift", powgrid2_shift, 0, 0);
+      fftw_free(powgrid2_shift);
+    }
+    memuse_log_allocation("fftw_grid.grid_shift", powgrid_shift, 0, 0);
+    fftw_free(powgrid_shift);
+  }
   memuse_log_allocation("fftw_grid.grid", pow_data->powgrid, 0, 0);
   fftw_free(pow_data->powgrid);
   pow_data->powgrid = NULL;
@@ -1259,7 +1461,15 @@ void power_init(struct power_spectrum_data* p, struct swift_params* params,
   p->windoworder = parser_get_opt_param_int(
       params, "PowerSpectrum:window_order", power_data_default_window_order);
 
-  if (p->windoworder > 3 || p->windoworder < 1)
+  char planner[32];
+  parser_get_opt_param_string(params, "PowerSpectrum:fftw_planner", planner,
+                              power_data_default_fftw_planner);
+  p->fftw_planner = fft_plans_effort_from_name(planner);
+
+  p->interlacing = parser_get_opt_param_int(params, "PowerSpectrum:interlacing",
+                                            power_data_default_interlacing);
+
+  if (p->windoworder > MESH_WINDOW_MAX_ORDER || p->windoworder < 1)
     error("Power spectrum calculation is not implemented for %dth order!",
           p->windoworder);
   if (p->windoworder == 1)
@@ -1268,10 +1478,11 @@ void power_init(struct power_spectrum_data* p, struct swift_params* params,
     message(
         "WARNING: fold factor is recommended not to exceed 4 for a "
         "mass assignment order of 2 (CIC) or below.");
-  if (p->windoworder == 3 && p->foldfac > 6)
+  if (p->windoworder >= 3 && p->foldfac > 6)
     message(
         "WARNING: fold factor is recommended not to exceed 6 for a "
-        "mass assignment order of 3 (TSC) or below.");
+        "mass assignment order of %d (%s).",
+        p->windoworder, mesh_window_name(p->windoworder));
 
   /* Make sensible choices for the k-cuts */
   const int kcutn = (p->windoworder >= 3) ? 90 : 70;
@@ -1323,10 +1534,16 @@ void power_init(struct power_spectrum_data* p, struct swift_params* params,
     p->types2[i] = power_spectrum_get_type(type2);
   }
 
+  /* Re-use what a previous run learnt while planning */
+  fft_plans_import_wisdom();
+
   /* Initialize the plan only once -- much faster for FFTs run often!
    * Does require us to allocate the grids, but we delete them right away.
    * Plan can only be used for the same FFTW call */
   const int Ngrid = p->Ngrid;
+  const unsigned int flags =
+      fft_plans_flags((enum fft_plans_effort)p->fftw_planner);
+  const ticks tic = getticks();
 
   /* Grid is padded to allow for in-place FFT */
   p->powgrid = fftw_alloc_real(Ngrid * Ngrid * (Ngrid + 2));
@@ -1334,7 +1551,7 @@ void power_init(struct power_spectrum_data* p, struct swift_params* params,
   p->powgridft = (fftw_complex*)p->powgrid;
 
   p->fftplanpow = fftw_plan_dft_r2c_3d(Ngrid, Ngrid, Ngrid, p->powgrid,
-                                       p->powgridft, FFTW_MEASURE);
+                                       p->powgridft, flags);
 
   fftw_free(p->powgrid);
   p->powgrid = NULL;
@@ -1348,12 +1565,17 @@ void power_init(struct power_spectrum_data* p, struct swift_params* params,
   p->powgridft2 = (fftw_complex*)p->powgrid2;
 
   p->fftplanpow2 = fftw_plan_dft_r2c_3d(Ngrid, Ngrid, Ngrid, p->powgrid2,
-                                        p->powgridft2, FFTW_MEASURE);
+                                        p->powgridft2, flags);
 
   fftw_free(p->powgrid2);
   p->powgrid2 = NULL;
   p->powgridft2 = NULL;
 
+  if (engine_rank == 0)
+    message("Planning the power spectrum FFTs (%s) took %.3f %s.",
+            fft_plans_effort_name((enum fft_plans_effort)p->fftw_planner),
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
+
   /* Create directories for power spectra and foldings */
   if (engine_rank == 0) {
     safe_checkdir("power_spectra", /*create=*/1);
@@ -1457,9 +1679,14 @@ void power_spectrum_struct_restore(struct power_spectrum_data* p,
   message("Note that FFTW is not threaded!");
 #endif
 
+  /* Re-use what the run learnt while planning before the restart */
+  fft_plans_import_wisdom();
+
   /* Initialize the plan only once -- much faster for FFTs run often!
      Does require us to allocate the grids, but we delete them right away */
   int Ngrid = p->Ngrid;
+  const unsigned int flags =
+      fft_plans_flags((enum fft_plans_effort)p->fftw_planner);
 
   /* Grid is padded to allow for in-place FFT */
   p->powgrid = fftw_alloc_real(Ngrid * Ngrid * (Ngrid + 2));
@@ -1467,7 +1694,7 @@ void power_spectrum_struct_restore(struct power_spectrum_data* p,
   p->powgridft = (fftw_complex*)p->powgrid;
 
   p->fftplanpow = fftw_plan_dft_r2c_3d(Ngrid, Ngrid, Ngrid, p->powgrid,
-                                       p->powgridft, FFTW_MEASURE);
+                                       p->powgridft, flags);
 
   fftw_free(p->powgrid);
   p->powgrid = NULL;
@@ -1481,7 +1708,7 @@ void power_spectrum_struct_restore(struct power_spectrum_data* p,
   p->powgridft2 = (fftw_complex*)p->powgrid2;
 
   p->fftplanpow2 = fftw_plan_dft_r2c_3d(Ngrid, Ngrid, Ngrid, p->powgrid2,
-                                        p->powgridft2, FFTW_MEASURE);
+                                        p->powgridft2, flags);
 
   fftw_free(p->powgrid2);
   p->powgrid2 = NULL;
@@ -71,6 +71,12 @@ struct power_spectrum_data {
   /*! The order of the mass assignment window */
   int windoworder;
 
+  /*! Do we average with a second grid shifted by half a cell (interlacing)? */
+  int interlacing;
+
+  /*! Effort FFTW spends planning the transforms (#fft_plans_effort) */
+  int fftw_planner;
+
   /*! Array of component types to correlate on the "left" side */
   enum power_type* types1;
 
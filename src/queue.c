@@ -22,6 +22,7 @@
 
 /* Some standard headers. */
 #include <stdio.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -38,6 +39,8 @@
 #include "error.h"
 #include "memswap.h"
 
+#ifndef SWIFT_LOCKFREE_QUEUES
+
 /**
  * @brief Push the task at the given index up the heap until it is either at the
  * top or smaller than its parent.
@@ -222,11 +225,9 @@ void queue_init(struct queue *q, struct task *tasks) {
  * @brief Get a task free of dependencies and conflicts.
  *
  * @param q The task #queue.
- * @param prev The previous #task extracted from this #queue.
  * @param blocking Block until access to the queue is granted.
  */
-struct task *queue_gettask(struct queue *q, const struct task *prev,
-                           int blocking) {
+struct task *queue_gettask(struct queue *q, int blocking) {
 
   swift_lock_type *qlock = &q->lock;
   struct task *res = NULL;
@@ -343,3 +344,189 @@ void queue_dump(int nodeID, int index, FILE *file, struct queue *q) {
   /* Release the task lock. */
   if (lock_unlock(qlock) != 0) error("Unlocking the qlock failed.\n");
 }
+
+#else /* SWIFT_LOCKFREE_QUEUES */
+
+/* Packing of the bucket heads */
+#define queue_head_tid(head) ((int)((head)&0xffffffffULL))
+#define queue_head_tag(head) ((unsigned int)((head) >> 32))
+#define queue_head_make(tag, tid) \
+  (((unsigned long long)(tag) << 32) | (unsigned int)(tid))
+
+/**
+ * @brief Get the priority bucket of a task from its weight.
+ *
+ * @param weight The weight of the #task.
+ *
+ * @return The bucket, higher is more urgent.
+ */
+static int queue_get_bucket(const float weight) {
+
+  if (!(weight > 0.f)) return 0;
+
+  int exponent;
+  frexpf(weight, &exponent);
+  const int bucket = exponent / queue_bucket_exponent_width;
+  if (bucket < 0) return 0;
+  if (bucket >= queue_nr_buckets) return queue_nr_buckets - 1;
+  return bucket;
+}
+
+/**
+ * @brief Push a task on the stack of a bucket.
+ *
+ * @param q The #queue.
+ * @param bucket The priority bucket.
+ * @param tid The offset of the task in the task list.
+ */
+static void queue_bucket_push(struct queue *q, const int bucket,
+                              const int tid) {
+
+  volatile unsigned long long *head = &q->bucket_head[bucket];
+  struct task *t = &q->tasks[tid];
+
+  unsigned long long old_head;
+  do {
+    old_head = *head;
+    t->queue_next = queue_head_tid(old_head);
+  } while (atomic_cas(head, old_head,
+                      queue_head_make(queue_head_tag(old_head) + 1, tid)) !=
+           old_head);
+}
+
+/**
+ * @brief Pop a task from the stack of a bucket.
+ *
+ * @param q The #queue.
+ * @param bucket The priority bucket.
+ *
+ * @return The offset of the task in the task list, -1 if the bucket is empty.
+ */
+static int queue_bucket_pop(struct queue *q, const int bucket) {
+
+  volatile unsigned long long *head = &q->bucket_head[bucket];
+
+  while (1) {
+    const unsigned long long old_head = *head;
+    const int tid = queue_head_tid(old_head);
+    if (tid < 0) return -1;
+
+    /* The tag makes the swap fail if the task was popped (and maybe pushed
+     * back) in the meantime, so a stale next is never installed. */
+    const int next = q->tasks[tid].queue_next;
+    if (atomic_cas(head, old_head,
+                   queue_head_make(queue_head_tag(old_head) + 1, next)) ==
+        old_head)
+      return tid;
+  }
+}
+
+/**
+ * @brief Insert a used tasks into the given queue.
+ *
+ * @param q The #queue.
+ * @param t The #task.
+ */
+void queue_insert(struct queue *q, struct task *t) {
+
+  queue_bucket_push(q, queue_get_bucket(t->weight), t - q->tasks);
+  atomic_inc(&q->count);
+}
+
+/**
+ * @brief Initialize the given queue.
+ *
+ * @param q The #queue.
+ * @param tasks List of tasks to which the queue indices refer to.
+ */
+void queue_init(struct queue *q, struct task *tasks) {
+
+  for (int b = 0; b < queue_nr_buckets; b++)
+    q->bucket_head[b] = queue_head_make(0, -1);
+
+  /* Set the tasks pointer. */
+  q->tasks = tasks;
+
+  /* Init counters. */
+  q->count = 0;
+  q->count_incoming = 0;
+}
+
+/**
+ * @brief Get a task free of dependencies and conflicts.
+ *
+ * The buckets are searched from the most urgent one down. Up to
+ * #queue_search_window tasks that cannot be locked are put aside and then
+ * pushed back on top of the bucket they came from, in reverse order, so that
+ * they keep both their priority and their place in the queue.
+ *
+ * @param q The task #queue.
+ * @param blocking Unused, the queue is never locked.
+ */
+struct task *queue_gettask(struct queue *q, int blocking) {
+
+  /* If there are no tasks, leave immediately. */
+  if (q->count <= 0) return NULL;
+
+  struct task *res = NULL;
+  int failed_tid[queue_search_window], failed_bucket[queue_search_window];
+  int nr_failed = 0;
+
+  for (int b = queue_nr_buckets - 1;
+       b >= 0 && res == NULL && nr_failed < queue_search_window; b--) {
+    while (nr_failed < queue_search_window) {
+
+      const int tid = queue_bucket_pop(q, b);
+      if (tid < 0) break;
+
+      /* Try to lock the task. */
+      if (task_lock(&q->tasks[tid])) {
+        res = &q->tasks[tid];
+        break;
+      }
+
+      failed_tid[nr_failed] = tid;
+      failed_bucket[nr_failed] = b;
+      nr_failed++;
+    }
+  }
+
+  /* Put back the tasks we could not lock where they were */
+  for (int k = nr_failed - 1; k >= 0; k--)
+    queue_bucket_push(q, failed_bucket[k], failed_tid[k]);
+
+  /* Another one bites the dust. */
+  if (res != NULL) atomic_dec(&q->count);
+
+  /* Take the money and run. */
+  return res;
+}
+
+void queue_clean(struct queue *q) {}
+
+/**
+ * @brief Dump a formatted list of tasks in the queue to the given file stream.
+ *
+ * The queue is not locked so this is only reliable when no runner is using
+ * it.
+ *
+ * @param nodeID the node id of this rank.
+ * @param index a number for this queue, added to the output.
+ * @param file the FILE stream, should opened for write.
+ * @param q The task #queue.
+ */
+void queue_dump(int nodeID, int index, FILE *file, struct queue *q) {
+
+  int k = 0;
+  for (int b = queue_nr_buckets - 1; b >= 0; b--) {
+    for (int tid = queue_head_tid(q->bucket_head[b]); tid >= 0;
+         tid = q->tasks[tid].queue_next) {
+      struct task *t = &q->tasks[tid];
+
+      fprintf(file, "%d %d %d %s %s %.2f\n", nodeID, index, k++,
+              taskID_names[t->type], subtaskID_names[t->subtype], t->weight);
+    }
+  }
+}
+
+#endif /* SWIFT_LOCKFREE_QUEUES */
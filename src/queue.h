@@ -32,6 +32,11 @@
 #define queue_incoming_size 10240
 #define queue_struct_align 64
 
+/* Constants of the lock-free queues: number of priority buckets and number
+ * of binary orders of magnitude of task weight spanned by each bucket. */
+#define queue_nr_buckets 16
+#define queue_bucket_exponent_width 2
+
 /* Constants dealing with task de-priorization. */
 #define queue_lock_fail_reweight_factor 0.5
 /* #define queue_lock_fail_reweight_mask \
@@ -56,6 +61,32 @@ struct queue_entry {
   float weight;
 };
 
+#ifdef SWIFT_LOCKFREE_QUEUES
+
+/** The queue struct.
+ *
+ * Lock-free version: the tasks are sorted in coarse priority buckets derived
+ * from their weight. Each bucket is a lock-free stack linked through the
+ * tasks themselves (#task.queue_next) whose head packs the index of the top
+ * task (low 32 bits) with a counter protecting against ABA (high 32 bits). */
+struct queue {
+
+  /* Head of the stack of each priority bucket. */
+  volatile unsigned long long bucket_head[queue_nr_buckets];
+
+  /* Number of tasks in the queue. */
+  volatile int count;
+
+  /* Always zero, there is no incoming DEQ to drain. */
+  volatile unsigned int count_incoming;
+
+  /* The actual tasks to which the indices refer. */
+  struct task *tasks;
+
+} __attribute__((aligned(queue_struct_align)));
+
+#else
+
 /** The queue struct. */
 struct queue {
 
@@ -77,9 +108,10 @@ struct queue {
 
 } __attribute__((aligned(queue_struct_align)));
 
+#endif /* SWIFT_LOCKFREE_QUEUES */
+
 /* Function prototypes. */
-struct task *queue_gettask(struct queue *q, const struct task *prev,
-                           int blocking);
+struct task *queue_gettask(struct queue *q, int blocking);
 void queue_init(struct queue *q, struct task *tasks);
 void queue_insert(struct queue *q, struct task *t);
 void queue_clean(struct queue *q);
@@ -29,6 +29,7 @@
 /* Local headers. */
 #include "cache.h"
 #include "gravity_cache.h"
+#include "multipole_batch.h"
 
 struct cell;
 struct engine;
@@ -75,6 +76,11 @@ struct runner {
   /*! Time this runner was active during the last engine_launch. */
   ticks active_time;
 
+#ifdef SWIFT_BATCHED_M2L
+  /*! The M2L kernels of the current task waiting to be evaluated. */
+  struct gravity_M2L_batch grav_M2L_batch;
+#endif
+
 #ifdef WITH_VECTORIZATION
 
   /*! The particle cache of cell ci. */
@@ -28,6 +28,7 @@
 #include "gravity.h"
 #include "gravity_cache.h"
 #include "gravity_iact.h"
+#include "gravity_long_range.h"
 #include "inline.h"
 #include "part.h"
 #include "space_getsid.h"
@@ -54,6 +55,73 @@ static INLINE void runner_clear_grav_flags(struct cell *c,
                          cell_flag_unskip_pair_grav_processed);
 }
 
+/**
+ * @brief Get the SoA copy of the #gpart of a leaf cell, filling it if this is
+ * the first time it is requested during this engine launch.
+ *
+ * @param e The #engine.
+ * @param c The (leaf-)#cell.
+ *
+ * @return The #gravity_mirror of the cell or NULL if the engine does not use
+ * any.
+ */
+static INLINE struct gravity_mirror *runner_get_grav_mirror(
+    const struct engine *e, struct cell *c) {
+
+  struct gravity_mirror_pool *pool = e->gravity_mirror_pool;
+  if (pool == NULL) return NULL;
+
+#ifdef SWIFT_DEBUG_CHECKS
+  if (c->split) error("Constructing a gravity mirror above leaf level!");
+#endif
+
+  lock_lock(&c->grav.plock);
+  if (c->grav.mirror_epoch != pool->epoch) {
+    struct gravity_mirror *m = gravity_mirror_pool_get(pool, c->grav.count);
+    gravity_mirror_populate(e->max_active_bin, m, c->grav.parts, c->width,
+                            e->gravity_properties);
+    c->grav.mirror = m;
+    c->grav.mirror_epoch = pool->epoch;
+  }
+  if (lock_unlock(&c->grav.plock) != 0) error("Error unlocking cell");
+
+#ifdef SWIFT_DEBUG_CHECKS
+  if (c->grav.mirror->count != c->grav.count)
+    error("Gravity mirror does not match the cell's particles");
+#endif
+
+  return c->grav.mirror;
+}
+
+/**
+ * @brief Write the output of a #gravity_cache back to the particles of a
+ * leaf cell.
+ *
+ * If the cell's SoA copy is in use, the output is accumulated there and
+ * will be written to the #gpart in the end-force stage.
+ *
+ * @param e The #engine.
+ * @param c The (leaf-)#cell.
+ * @param cache The #gravity_cache to read from.
+ */
+static INLINE void runner_grav_write_back(const struct engine *e,
+                                          struct cell *c,
+                                          const struct gravity_cache *cache) {
+
+  const struct gravity_mirror_pool *pool = e->gravity_mirror_pool;
+
+#ifndef SWIFT_TASKS_WITHOUT_ATOMICS
+  lock_lock(&c->grav.plock);
+#endif
+  if (pool != NULL && c->grav.mirror_epoch == pool->epoch)
+    gravity_mirror_accumulate(cache, c->grav.mirror);
+  else
+    gravity_cache_write_back(cache, c->grav.parts, c->grav.count);
+#ifndef SWIFT_TASKS_WITHOUT_ATOMICS
+  if (lock_unlock(&c->grav.plock) != 0) error("Error unlocking cell");
+#endif
+}
+
 /**
  * @brief Recursively propagate the multipoles down the tree by applying the
  * L2L and L2P kernels.
@@ -347,13 +415,7 @@ static INLINE void runner_dopair_grav_pp_full_no_cache(
   }
 
   /* Write back to the particle data */
-#ifndef SWIFT_TASKS_WITHOUT_ATOMICS
-  lock_lock(&ci->grav.plock);
-#endif
-  gravity_cache_write_back(cache_i, ci->grav.parts, gcount_i);
-#ifndef SWIFT_TASKS_WITHOUT_ATOMICS
-  if (lock_unlock(&ci->grav.plock) != 0) error("Error unlocking cell");
-#endif
+  runner_grav_write_back(e, ci, cache_i);
 }
 
 /**
@@ -551,13 +613,7 @@ static INLINE void runner_dopair_grav_pp_truncated_no_cache(
   }
 
   /* Write back to the particle data */
-#ifndef SWIFT_TASKS_WITHOUT_ATOMICS
-  lock_lock(&ci->grav.plock);
-#endif
-  gravity_cache_write_back(cache_i, ci->grav.parts, gcount_i);
-#ifndef SWIFT_TASKS_WITHOUT_ATOMICS
-  if (lock_unlock(&ci->grav.plock) != 0) error("Error unlocking cell");
-#endif
+  runner_grav_write_back(e, ci, cache_i);
 }
 
 /**
@@ -651,7 +707,8 @@ static INLINE void runner_dopair_grav_pp_full(
 #ifdef SWIFT_DEBUG_CHECKS
       /* The gravity_cache are sometimes allocated with more
          place than required => flag with mass=0 */
-      if (gparts_j[pjd].time_bin == time_bin_not_created && mass_j != 0.f) {
+      if (pjd < gcount_j && gparts_j[pjd].time_bin == time_bin_not_created &&
+          mass_j != 0.f) {
         error("Found an extra gpart in the gravity interaction");
       }
       if (gparts_i[pid].time_bin == time_bin_not_created &&
@@ -1236,8 +1293,9 @@ void runner_dopair_grav_pp(struct runner *r, struct cell *ci, struct cell *cj,
 #endif
 
   /* Caches to play with */
-  struct gravity_cache *const ci_cache = &r->ci_gravity_cache;
-  struct gravity_cache *const cj_cache = &r->cj_gravity_cache;
+  struct gravity_cache *ci_cache = &r->ci_gravity_cache;
+  struct gravity_cache *cj_cache = &r->cj_gravity_cache;
+  struct gravity_cache ci_mirror_cache, cj_mirror_cache;
 
   /* Shift to apply to the particles in each cell */
   const double shift_i[3] = {0., 0., 0.};
@@ -1273,15 +1331,37 @@ void runner_dopair_grav_pp(struct runner *r, struct cell *ci, struct cell *cj,
   const int allow_multipole_i = allow_mpole && ci->grav.count > 1;
   const int allow_multipole_j = allow_mpole && cj->grav.count > 1;
 
+  /* Get the SoA copies of the particles (if any) */
+  const struct gravity_mirror *mirror_i = runner_get_grav_mirror(e, ci);
+  const struct gravity_mirror *mirror_j = runner_get_grav_mirror(e, cj);
+
   /* Fill the caches */
-  gravity_cache_populate(e->max_active_bin, allow_multipole_j, periodic, dim,
-                         ci_cache, ci->grav.parts, gcount_i, gcount_padded_i,
-                         shift_i, CoM_j, cj->grav.multipole, ci,
-                         e->gravity_properties);
-  gravity_cache_populate(e->max_active_bin, allow_multipole_i, periodic, dim,
-                         cj_cache, cj->grav.parts, gcount_j, gcount_padded_j,
-                         shift_j, CoM_i, ci->grav.multipole, cj,
-                         e->gravity_properties);
+  if (mirror_i != NULL) {
+    gravity_cache_attach_mirror(&ci_mirror_cache, ci_cache, mirror_i);
+    gravity_cache_populate_mpole(allow_multipole_j, periodic, dim,
+                                 &ci_mirror_cache, ci->grav.parts, gcount_i,
+                                 gcount_padded_i, CoM_j, cj->grav.multipole,
+                                 e->gravity_properties);
+    ci_cache = &ci_mirror_cache;
+  } else {
+    gravity_cache_populate(e->max_active_bin, allow_multipole_j, periodic, dim,
+                           ci_cache, ci->grav.parts, gcount_i, gcount_padded_i,
+                           shift_i, CoM_j, cj->grav.multipole, ci,
+                           e->gravity_properties);
+  }
+  if (mirror_j != NULL) {
+    gravity_cache_attach_mirror(&cj_mirror_cache, cj_cache, mirror_j);
+    gravity_cache_populate_mpole(allow_multipole_i, periodic, dim,
+                                 &cj_mirror_cache, cj->grav.parts, gcount_j,
+                                 gcount_padded_j, CoM_i, ci->grav.multipole,
+                                 e->gravity_properties);
+    cj_cache = &cj_mirror_cache;
+  } else {
+    gravity_cache_populate(e->max_active_bin, allow_multipole_i, periodic, dim,
+                           cj_cache, cj->grav.parts, gcount_j, gcount_padded_j,
+                           shift_j, CoM_i, ci->grav.multipole, cj,
+                           e->gravity_properties);
+  }
 
   /* Can we use the Newtonian version or do we need the truncated one ? */
   if (!periodic) {
@@ -1400,26 +1480,10 @@ void runner_dopair_grav_pp(struct runner *r, struct cell *ci, struct cell *cj,
   }
 
   /* Write back to the particles in ci */
-  if (ci_active) {
-#ifndef SWIFT_TASKS_WITHOUT_ATOMICS
-    lock_lock(&ci->grav.plock);
-#endif
-    gravity_cache_write_back(ci_cache, ci->grav.parts, gcount_i);
-#ifndef SWIFT_TASKS_WITHOUT_ATOMICS
-    if (lock_unlock(&ci->grav.plock) != 0) error("Error unlocking cell");
-#endif
-  }
+  if (ci_active) runner_grav_write_back(e, ci, ci_cache);
 
   /* Write back to the particles in cj */
-  if (cj_active && symmetric) {
-#ifndef SWIFT_TASKS_WITHOUT_ATOMICS
-    lock_lock(&cj->grav.plock);
-#endif
-    gravity_cache_write_back(cj_cache, cj->grav.parts, gcount_j);
-#ifndef SWIFT_TASKS_WITHOUT_ATOMICS
-    if (lock_unlock(&cj->grav.plock) != 0) error("Error unlocking cell");
-#endif
-  }
+  if (cj_active && symmetric) runner_grav_write_back(e, cj, cj_cache);
 
   TIMER_TOC(timer_dopair_grav_pp);
 }
@@ -1859,13 +1923,7 @@ void runner_doself_grav_pp(struct runner *r, struct cell *c) {
   }
 
   /* Write back to the particles */
-#ifndef SWIFT_TASKS_WITHOUT_ATOMICS
-  lock_lock(&c->grav.plock);
-#endif
-  gravity_cache_write_back(ci_cache, c->grav.parts, gcount);
-#ifndef SWIFT_TASKS_WITHOUT_ATOMICS
-  if (lock_unlock(&c->grav.plock) != 0) error("Error unlocking cell");
-#endif
+  runner_grav_write_back(e, c, ci_cache);
 
   TIMER_TOC(timer_doself_grav_pp);
 }
@@ -1928,6 +1986,14 @@ static INLINE void runner_dopair_grav_mm_symmetric(struct runner *r,
         cj->grav.ti_old_multipole, cj->nodeID, ci->nodeID, e->ti_current);
 #endif
 
+#ifdef SWIFT_BATCHED_M2L
+  /* Queue the interaction at this level (the batch takes the locks) */
+  gravity_M2L_batch_symmetric(
+      &r->grav_M2L_batch, &ci->grav.multipole->pot, &cj->grav.multipole->pot,
+      &ci->grav.mlock, &cj->grav.mlock, multi_i, multi_j,
+      ci->grav.multipole->CoM, cj->grav.multipole->CoM, props, periodic, dim,
+      r_s_inv);
+#else
 #ifndef SWIFT_TASKS_WITHOUT_ATOMICS
   /* Lock the multipoles
    * Note we impose a hierarchy to solve the dining philosopher problem */
@@ -1950,6 +2016,7 @@ static INLINE void runner_dopair_grav_mm_symmetric(struct runner *r,
   if (lock_unlock(&ci->grav.mlock) != 0) error("Failed to unlock multipole");
   if (lock_unlock(&cj->grav.mlock) != 0) error("Failed to unlock multipole");
 #endif
+#endif /* SWIFT_BATCHED_M2L */
 
   TIMER_TOC(timer_dopair_grav_mm);
 }
@@ -1997,6 +2064,13 @@ static INLINE void runner_dopair_grav_mm_nonsym(struct runner *r,
         cj->grav.ti_old_multipole, cj->nodeID, ci->nodeID, e->ti_current);
 #endif
 
+#ifdef SWIFT_BATCHED_M2L
+  /* Queue the interaction at this level (the batch takes the lock) */
+  gravity_M2L_batch_nonsym(&r->grav_M2L_batch, &ci->grav.multipole->pot,
+                           &ci->grav.mlock, multi_j, ci->grav.multipole->CoM,
+                           cj->grav.multipole->CoM, props, periodic, dim,
+                           r_s_inv);
+#else
 #ifndef SWIFT_TASKS_WITHOUT_ATOMICS
   /* Lock the multipoles
    * Note we impose a hierarchy to solve the dining philosopher problem */
@@ -2018,6 +2092,7 @@ static INLINE void runner_dopair_grav_mm_nonsym(struct runner *r,
   if (lock_unlock(&ci->grav.mlock) != 0) error("Failed to unlock multipole");
   if (lock_unlock(&cj->grav.mlock) != 0) error("Failed to unlock multipole");
 #endif
+#endif /* SWIFT_BATCHED_M2L */
 
   TIMER_TOC(timer_dopair_grav_mm);
 }
@@ -2137,7 +2212,8 @@ void runner_dopair_recursive_grav_pm(struct runner *r, struct cell *ci,
     /* Start by constructing particle caches */
 
     /* Cache to play with */
-    struct gravity_cache *const ci_cache = &r->ci_gravity_cache;
+    struct gravity_cache *ci_cache = &r->ci_gravity_cache;
+    struct gravity_cache ci_mirror_cache;
 
     /* Computed the padded counts */
     const int gcount_i = ci->grav.count;
@@ -2160,10 +2236,20 @@ void runner_dopair_recursive_grav_pm(struct runner *r, struct cell *ci,
       error("Constructing cache for M2P interaction with multipole of size 0!");
 #endif
 
-    /* Fill the cache */
-    gravity_cache_populate_all_mpole(
-        e->max_active_bin, periodic, dim, ci_cache, ci->grav.parts, gcount_i,
-        gcount_padded_i, ci, CoM_j, cj->grav.multipole, e->gravity_properties);
+    /* Fill the cache, reading the particles from their SoA copy if any */
+    const struct gravity_mirror *mirror_i = runner_get_grav_mirror(e, ci);
+    if (mirror_i != NULL) {
+      gravity_cache_attach_mirror(&ci_mirror_cache, ci_cache, mirror_i);
+      gravity_cache_populate_all_mpole_flags(
+          periodic, dim, &ci_mirror_cache, ci->grav.parts, gcount_i,
+          gcount_padded_i, CoM_j, cj->grav.multipole, e->gravity_properties);
+      ci_cache = &ci_mirror_cache;
+    } else {
+      gravity_cache_populate_all_mpole(
+          e->max_active_bin, periodic, dim, ci_cache, ci->grav.parts, gcount_i,
+          gcount_padded_i, ci, CoM_j, cj->grav.multipole,
+          e->gravity_properties);
+    }
 
     /* Can we use the Newtonian version or do we need the truncated one ? */
     if (!periodic) {
@@ -2180,13 +2266,7 @@ void runner_dopair_recursive_grav_pm(struct runner *r, struct cell *ci,
     }
 
     /* Write back to the particles */
-#ifndef SWIFT_TASKS_WITHOUT_ATOMICS
-    lock_lock(&ci->grav.plock);
-#endif
-    gravity_cache_write_back(ci_cache, ci->grav.parts, gcount_i);
-#ifndef SWIFT_TASKS_WITHOUT_ATOMICS
-    if (lock_unlock(&ci->grav.plock) != 0) error("Error unlocking cell");
-#endif
+    runner_grav_write_back(e, ci, ci_cache);
   }
 }
 
@@ -2431,8 +2511,303 @@ void runner_doself_recursive_grav(struct runner *r, struct cell *c,
 }
 
 /**
- * @brief Performs all M-M interactions between a given top-level cell and all
- * the other top-levels that are far enough.
+ * @brief Performs the M2L interaction between the field tensor of a cell and
+ * the multipole of a group of top-level cells.
+ *
+ * @param r The #runner.
+ * @param ci The #cell with field tensor to interact.
+ * @param multi_g The multipole of the group.
+ */
+static INLINE void runner_dopair_grav_mm_group(
+    struct runner *r, struct cell *restrict ci,
+    const struct gravity_tensors *restrict multi_g) {
+
+  /* Some constants */
+  const struct engine *e = r->e;
+  const struct gravity_props *props = e->gravity_properties;
+  const int periodic = e->mesh->periodic;
+  const double dim[3] = {e->mesh->dim[0], e->mesh->dim[1], e->mesh->dim[2]};
+  const float r_s_inv = e->mesh->r_s_inv;
+
+  TIMER_TIC;
+
+  /* Anything to do here? */
+  if (!cell_is_active_gravity_mm(ci, e) || ci->nodeID != engine_rank) return;
+
+#ifdef SWIFT_DEBUG_CHECKS
+  if (multi_g->m_pole.num_gpart == 0)
+    error("Multipole does not seem to have been set.");
+
+  if (ci->grav.multipole->pot.ti_init != e->ti_current)
+    error("ci->grav tensor not initialised.");
+#endif
+
+#ifdef SWIFT_BATCHED_M2L
+  /* Queue the interaction at this level (the batch takes the lock) */
+  gravity_M2L_batch_nonsym(&r->grav_M2L_batch, &ci->grav.multipole->pot,
+                           &ci->grav.mlock, &multi_g->m_pole,
+                           ci->grav.multipole->CoM, multi_g->CoM, props,
+                           periodic, dim, r_s_inv);
+#else
+#ifndef SWIFT_TASKS_WITHOUT_ATOMICS
+  /* Lock the multipole (the group's one is only read) */
+  lock_lock(&ci->grav.mlock);
+#endif
+
+  /* Let's interact at this level */
+  gravity_M2L_nonsym(&ci->grav.multipole->pot, &multi_g->m_pole,
+                     ci->grav.multipole->CoM, multi_g->CoM, props, periodic,
+                     dim, r_s_inv);
+
+#ifndef SWIFT_TASKS_WITHOUT_ATOMICS
+  /* Unlock the multipole */
+  if (lock_unlock(&ci->grav.mlock) != 0) error("Failed to unlock multipole");
+#endif
+#endif /* SWIFT_BATCHED_M2L */
+
+  TIMER_TOC(timer_dopair_grav_mm);
+}
+
+/**
+ * @brief Records in a field tensor the contribution of particles that are
+ * beyond the distance where the truncated forces are 0.
+ *
+ * @param multi_i The #gravity_tensors receiving the (null) contribution.
+ * @param num_gpart The number of #gpart beyond that distance.
+ */
+static INLINE void runner_do_grav_long_range_far(
+    struct gravity_tensors *multi_i, const long long num_gpart) {
+
+#ifdef SWIFT_DEBUG_CHECKS
+  /* Need to account for the interactions we missed */
+  accumulate_add_ll(&multi_i->pot.num_interacted, num_gpart);
+#endif
+
+#ifdef SWIFT_GRAVITY_FORCE_CHECKS
+  /* Need to account for the interactions we missed */
+  accumulate_add_ll(&multi_i->pot.num_interacted_pm, num_gpart);
+#endif
+
+  /* Record that this multipole received a contribution */
+  multi_i->pot.interacted = 1;
+}
+
+/**
+ * @brief Performs the long-range interaction between a cell and a top-level
+ * cell.
+ *
+ * @param r The #runner.
+ * @param ci The #cell with field tensor to interact.
+ * @param top The top-level (great-)parent of ci.
+ * @param cj The other top-level #cell.
+ * @param listed Is this an entry of the interaction list (1) or a cell
+ * reached by opening a group or a void cell (0)?
+ */
+static void runner_do_grav_long_range_cell(struct runner *r, struct cell *ci,
+                                           const struct cell *top,
+                                           struct cell *cj, const int listed) {
+
+  /* Some constants */
+  const struct engine *e = r->e;
+  const struct space *s = e->s;
+  const int periodic = e->mesh->periodic;
+  const double dim[3] = {e->mesh->dim[0], e->mesh->dim[1], e->mesh->dim[2]};
+  const double max_distance2 = e->mesh->r_cut_max * e->mesh->r_cut_max;
+  struct gravity_tensors *const multi_i = ci->grav.multipole;
+  struct gravity_tensors *const multi_j = cj->grav.multipole;
+
+  /* Avoid self contributions */
+  if (top == cj) return;
+
+  /* Skip empty cells */
+  if (multi_j->m_pole.M_000 == 0.f) return;
+
+  /* Are we beyond the distance where the truncated forces are 0 ?*/
+  if (!listed && periodic &&
+      cell_min_dist2(top, cj, periodic, dim) > max_distance2) {
+#if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_GRAVITY_FORCE_CHECKS)
+    runner_do_grav_long_range_far(multi_i, multi_j->m_pole.num_gpart);
+#else
+    runner_do_grav_long_range_far(multi_i, 0);
+#endif
+    return;
+  }
+
+  if (cell_can_use_pair_mm(top, cj, e, s, /*use_rebuild_data=*/1,
+                           /*is_tree_walk=*/0)) {
+
+    /* Call the PM interaction fucntion on the active sub-cells of ci */
+    runner_dopair_grav_mm_nonsym(r, ci, cj);
+
+    /* Record that this multipole received a contribution */
+    multi_i->pot.interacted = 1;
+  }
+}
+
+/**
+ * @brief Performs the long-range interactions between a cell and a void
+ * cell of the zoom region reached by opening a group.
+ *
+ * The void cell is opened into its fine cells if it cannot be used as a
+ * whole (as when constructing the lists).
+ *
+ * @param r The #runner.
+ * @param ci The #cell with field tensor to interact.
+ * @param top The top-level (great-)parent of ci.
+ * @param vid The index of the void cell.
+ */
+static void runner_do_grav_long_range_void(struct runner *r, struct cell *ci,
+                                           const struct cell *top,
+                                           const int vid) {
+
+  /* Some constants */
+  const struct engine *e = r->e;
+  const struct space *s = e->s;
+  const struct zoom_region *zoom = &s->zoom;
+  const int periodic = e->mesh->periodic;
+  const double dim[3] = {e->mesh->dim[0], e->mesh->dim[1], e->mesh->dim[2]};
+  const double max_distance2 = e->mesh->r_cut_max * e->mesh->r_cut_max;
+  struct gravity_tensors *const multi_i = ci->grav.multipole;
+  struct cell *v = &s->cells_top[vid];
+  const int n = zoom->refinement;
+
+  /* Skip empty voids */
+  if (v->grav.multipole->m_pole.M_000 == 0.f) return;
+
+  /* Is the whole void beyond the distance where the truncated forces are
+   * 0? */
+  if (periodic && cell_min_dist2(top, v, periodic, dim) > max_distance2) {
+#if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_GRAVITY_FORCE_CHECKS)
+    runner_do_grav_long_range_far(multi_i, v->grav.multipole->m_pole.num_gpart);
+#else
+    runner_do_grav_long_range_far(multi_i, 0);
+#endif
+    return;
+  }
+
+  /* Can we use the void's multipole? */
+  if (gravity_long_range_void_usable(e, top, v) &&
+      cell_can_use_pair_mm(top, v, e, s, /*use_rebuild_data=*/1,
+                           /*is_tree_walk=*/0)) {
+    runner_do_grav_long_range_cell(r, ci, top, v, /*listed=*/1);
+    return;
+  }
+
+  /* Otherwise, go through the fine cells */
+  int first[3];
+  zoom_region_void_first(zoom, s->cdim, vid, first);
+
+  int f[3];
+  for (f[0] = first[0]; f[0] < first[0] + n; ++f[0])
+    for (f[1] = first[1]; f[1] < first[1] + n; ++f[1])
+      for (f[2] = first[2]; f[2] < first[2] + n; ++f[2])
+        runner_do_grav_long_range_cell(
+            r, ci, top,
+            &s->cells_top[zoom_region_cell_id(zoom, f[0], f[1], f[2])],
+            /*listed=*/0);
+}
+
+/**
+ * @brief Performs the long-range interactions between a cell and a
+ * top-level cell or a group of top-level cells of its interaction list.
+ *
+ * Groups that do not pass the multipole acceptance criterion any more are
+ * opened.
+ *
+ * @param r The #runner.
+ * @param ci The #cell with field tensor to interact.
+ * @param top The top-level (great-)parent of ci.
+ * @param top_coords The integer coordinates of top.
+ * @param level The level of the group (0 for a top-level cell).
+ * @param g The integer coordinates of the group or top-level cell.
+ * @param listed Is this an entry of the interaction list (1) or a cell or
+ * group reached by opening one (0)?
+ */
+static void runner_do_grav_long_range_entry(struct runner *r, struct cell *ci,
+                                            const struct cell *top,
+                                            const int top_coords[3],
+                                            const int level, const int g[3],
+                                            const int listed) {
+
+  /* Some constants */
+  const struct engine *e = r->e;
+  const struct space *s = e->s;
+  const struct gravity_long_range_lists *lists = s->grav_long_range;
+  const int periodic = e->mesh->periodic;
+  const double dim[3] = {e->mesh->dim[0], e->mesh->dim[1], e->mesh->dim[2]};
+  const double max_distance2 = e->mesh->r_cut_max * e->mesh->r_cut_max;
+  struct gravity_tensors *const multi_i = ci->grav.multipole;
+
+  if (level == 0) {
+
+    const int cjd = cell_getid(s->cdim, g[0], g[1], g[2]);
+
+    /* Void cells of the zoom region may need to be opened */
+    if (zoom_region_is_void(&s->zoom, s->cdim, cjd))
+      runner_do_grav_long_range_void(r, ci, top, cjd);
+    else
+      runner_do_grav_long_range_cell(r, ci, top, &s->cells_top[cjd], listed);
+    return;
+  }
+
+  const struct gravity_tensors *multi_g =
+      &lists->groups[gravity_long_range_group_id(lists, level, g)];
+
+  /* Skip empty groups */
+  if (multi_g->m_pole.M_000 == 0.f) return;
+
+  /* Is the whole group beyond the distance where the truncated forces are
+   * 0? */
+  if (!listed && periodic) {
+    double dist2_min, dist2_max;
+    gravity_long_range_group_dist2(lists, top_coords, level, g, s->width,
+                                   periodic, &dist2_min, &dist2_max);
+    if (dist2_min > max_distance2) {
+#if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_GRAVITY_FORCE_CHECKS)
+      runner_do_grav_long_range_far(multi_i, multi_g->m_pole.num_gpart);
+#else
+      runner_do_grav_long_range_far(multi_i, 0);
+#endif
+      return;
+    }
+  }
+
+  /* Groups taken from the list only need their multipole to still be
+   * accepted, the ones we opened our way to need all the checks */
+  const int usable =
+      listed
+          ? gravity_long_range_group_accept(lists, e->gravity_properties,
+                                            top->grav.multipole, top_coords,
+                                            level, g, periodic, dim)
+          : gravity_long_range_group_usable(lists, e, top, top_coords, level,
+                                            g);
+
+  if (usable) {
+
+    /* Interact with the whole group at once */
+    runner_dopair_grav_mm_group(r, ci, multi_g);
+
+    /* Record that this multipole received a contribution */
+    multi_i->pot.interacted = 1;
+    return;
+  }
+
+  /* Open the group */
+  const int *cdim_below = lists->cdim[level - 1];
+  int c[3];
+  for (c[0] = 2 * g[0]; c[0] < min(2 * g[0] + 2, cdim_below[0]); ++c[0])
+    for (c[1] = 2 * g[1]; c[1] < min(2 * g[1] + 2, cdim_below[1]); ++c[1])
+      for (c[2] = 2 * g[2]; c[2] < min(2 * g[2] + 2, cdim_below[2]); ++c[2])
+        runner_do_grav_long_range_entry(r, ci, top, top_coords, level - 1, c,
+                                        /*listed=*/0);
+}
+
+/**
+ * @brief Performs all M-M interactions between a given top-level cell and
+ * all the other top-levels that are far enough.
+ *
+ * The cells and groups of cells to interact with are taken from the
+ * interaction list of the top-level cell constructed at the last rebuild.
  *
  * @param r The thread #runner.
  * @param ci The #cell of interest.
@@ -2443,17 +2818,11 @@ void runner_do_grav_long_range(struct runner *r, struct cell *ci,
 
   /* Some constants */
   const struct engine *e = r->e;
-  const int periodic = e->mesh->periodic;
-  const double dim[3] = {e->mesh->dim[0], e->mesh->dim[1], e->mesh->dim[2]};
-  const double max_distance2 = e->mesh->r_cut_max * e->mesh->r_cut_max;
+  const struct space *s = e->s;
+  const struct gravity_long_range_lists *lists = s->grav_long_range;
 
   TIMER_TIC;
 
-  /* Recover the list of top-level cells */
-  struct cell *cells = e->s->cells_top;
-  int *cells_with_particles = e->s->cells_with_particles_top;
-  const int nr_cells_with_particles = e->s->nr_cells_with_particles;
-
   /* Anything to do here? */
   if (!cell_is_active_gravity(ci, e)) return;
 
@@ -2470,62 +2839,127 @@ void runner_do_grav_long_range(struct runner *r, struct cell *ci,
   struct cell *top = ci;
   while (top->parent != NULL) top = top->parent;
 
-  /* Loop over all the top-level cells and go for a M-M interaction if
-   * well-separated */
-  for (int n = 0; n < nr_cells_with_particles; ++n) {
+  /* Recover the position of the top-level cell (of its void cell for the
+   * fine cells of a zoom region) */
+  const int top_id = top - s->cells_top;
+  int top_coords[3];
+  zoom_region_coarse_coords(&s->zoom, s->cdim, top_id, top_coords);
+
+#ifdef SWIFT_DEBUG_CHECKS
+  if (lists == NULL || lists->nr_cells != s->nr_cells)
+    error("Long-range interaction lists not constructed!");
+#endif
+
+  /* Account for the cells beyond the distance where the truncated forces
+   * are 0 */
+  if (lists->nr_far[top_id] > 0) {
+#if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_GRAVITY_FORCE_CHECKS)
+    runner_do_grav_long_range_far(multi_i, lists->num_gpart_far[top_id]);
+#else
+    runner_do_grav_long_range_far(multi_i, 0);
+#endif
+  }
+
+  /* Loop over the interaction list and go for M-M interactions */
+  for (int n = lists->offsets[top_id]; n < lists->offsets[top_id + 1]; ++n) {
 
-    /* Handle on the top-level cell and it's gravity business*/
-    struct cell *cj = &cells[cells_with_particles[n]];
-    struct gravity_tensors *const multi_j = cj->grav.multipole;
+    const int entry = lists->entries[n];
 
-    /* Avoid self contributions */
-    if (top == cj) continue;
+    if (entry < lists->nr_cells) {
 
-    /* Skip empty cells */
-    if (multi_j->m_pole.M_000 == 0.f) continue;
+      /* A single top-level cell */
+      runner_do_grav_long_range_cell(r, ci, top, &s->cells_top[entry],
+                                     /*listed=*/1);
 
-    /* Can we escape early in the periodic BC case? */
-    if (periodic) {
+    } else {
 
-      /* Minimal distance between any pair of particles */
-      const double min_radius2 =
-          cell_min_dist2_same_size(top, cj, periodic, dim);
+      /* A group: find its level and coordinates */
+      const int gid = entry - lists->nr_cells;
+      int level = lists->nr_levels - 1;
+      while (lists->level_offset[level] > gid) --level;
+      const int *cdim = lists->cdim[level];
+      const int id = gid - lists->level_offset[level];
+      const int g[3] = {id / (cdim[1] * cdim[2]), (id / cdim[2]) % cdim[1],
+                        id % cdim[2]};
+      runner_do_grav_long_range_entry(r, ci, top, top_coords, level, g,
+                                      /*listed=*/1);
+    }
+  }
 
-      /* Are we beyond the distance where the truncated forces are 0 ?*/
-      if (min_radius2 > max_distance2) {
+  if (timer) TIMER_TOC(timer_dograv_long_range);
+}
+
+/**
+ * @brief Assigns the #gpart of a super-cell to the long-range mesh.
+ *
+ * @param r The #runner.
+ * @param c The (super-)#cell.
+ * @param timer Are we timing this ?
+ */
+void runner_do_grav_mesh_assign(struct runner *r, struct cell *c, int timer) {
+
+  const struct engine *e = r->e;
+
+  TIMER_TIC;
 
 #ifdef SWIFT_DEBUG_CHECKS
-        /* Need to account for the interactions we missed */
-        accumulate_add_ll(&multi_i->pot.num_interacted,
-                          multi_j->m_pole.num_gpart);
+  if (c->grav.count > 0 && c->grav.ti_old_part != e->ti_current)
+    error("Assigning un-drifted particles to the mesh.");
 #endif
 
-#ifdef SWIFT_GRAVITY_FORCE_CHECKS
-        /* Need to account for the interactions we missed */
-        accumulate_add_ll(&multi_i->pot.num_interacted_pm,
-                          multi_j->m_pole.num_gpart);
-#endif
+  pm_mesh_tasks_cell_assign(e->mesh, e->s, c);
 
-        /* Record that this multipole received a contribution */
-        multi_i->pot.interacted = 1;
+  if (timer) TIMER_TOC(timer_dograv_mesh);
+}
 
-        /* We are done here. */
-        continue;
-      }
-    }
+/**
+ * @brief Does one step of the transform of the mesh density into the
+ * potential on a block of planes of the mesh.
+ *
+ * @param r The #runner.
+ * @param t The mesh task (r2c, green or c2r), whose flags are the block.
+ * @param timer Are we timing this ?
+ */
+void runner_do_grav_mesh_fft(struct runner *r, const struct task *t,
+                             int timer) {
 
-    if (cell_can_use_pair_mm(top, cj, e, e->s, /*use_rebuild_data=*/1,
-                             /*is_tree_walk=*/0)) {
+  const struct engine *e = r->e;
+  const int block = t->flags;
 
-      /* Call the PM interaction fucntion on the active sub-cells of ci */
-      runner_dopair_grav_mm_nonsym(r, ci, cj);
-      // runner_dopair_recursive_grav_pm(r, ci, cj);
+  TIMER_TIC;
 
-      /* Record that this multipole received a contribution */
-      multi_i->pot.interacted = 1;
+  switch (t->type) {
+    case task_type_grav_mesh_r2c:
+      pm_mesh_tasks_r2c(e->mesh, block);
+      break;
+    case task_type_grav_mesh_green:
+      pm_mesh_tasks_green(e->mesh, block);
+      break;
+    case task_type_grav_mesh_c2r:
+      pm_mesh_tasks_c2r(e->mesh, block);
+      break;
+    default:
+      error("Invalid mesh task type %s.", taskID_names[t->type]);
+  }
 
-    } /* We are in charge of this pair */
-  }   /* Loop over top-level cells */
+  if (timer) TIMER_TOC(timer_dograv_mesh);
+}
 
-  if (timer) TIMER_TOC(timer_dograv_long_range);
+/**
+ * @brief Interpolates the long-range mesh forces onto the #gpart of a
+ * super-cell.
+ *
+ * @param r The #runner.
+ * @param c The (super-)#cell.
+ * @param timer Are we timing this ?
+ */
+void runner_do_grav_mesh_interp(struct runner *r, struct cell *c, int timer) {
+
+  const struct engine *e = r->e;
+
+  TIMER_TIC;
+
+  pm_mesh_tasks_cell_interpolate(e->mesh, e->s, c);
+
+  if (timer) TIMER_TOC(timer_dograv_mesh);
 }
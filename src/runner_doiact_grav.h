@@ -24,6 +24,7 @@
 
 struct runner;
 struct cell;
+struct task;
 
 void runner_do_grav_down(struct runner *r, struct cell *c, int timer);
 
@@ -42,6 +43,13 @@ void runner_dopair_grav_mm_progenies(struct runner *r, const long long flags,
 
 void runner_do_grav_long_range(struct runner *r, struct cell *ci, int timer);
 
+void runner_do_grav_mesh_assign(struct runner *r, struct cell *c, int timer);
+
+void runner_do_grav_mesh_fft(struct runner *r, const struct task *t,
+                             int timer);
+
+void runner_do_grav_mesh_interp(struct runner *r, struct cell *c, int timer);
+
 /* Internal functions (for unit tests and debugging) */
 
 void runner_doself_grav_pp(struct runner *r, struct cell *c);
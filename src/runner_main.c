@@ -557,6 +557,20 @@ void *runner_main(void *data) {
         case task_type_grav_mm:
           runner_dopair_grav_mm_progenies(r, t->flags, t->ci, t->cj);
           break;
+        case task_type_grav_mesh_assign:
+          runner_do_grav_mesh_assign(r, ci, 1);
+          break;
+        case task_type_grav_mesh_reduce:
+          /* The reduction has completed by the time the task runs */
+          break;
+        case task_type_grav_mesh_r2c:
+        case task_type_grav_mesh_green:
+        case task_type_grav_mesh_c2r:
+          runner_do_grav_mesh_fft(r, t, 1);
+          break;
+        case task_type_grav_mesh_interp:
+          runner_do_grav_mesh_interp(r, ci, 1);
+          break;
         case task_type_cooling:
           runner_do_cooling(r, t->ci, 1);
           break;
@@ -596,6 +610,13 @@ void *runner_main(void *data) {
         default:
           error("Unknown/invalid task type (%d).", t->type);
       }
+
+#ifdef SWIFT_BATCHED_M2L
+      /* Evaluate the M2L kernels this task left in the batch */
+      gravity_M2L_batch_flush(&r->grav_M2L_batch, e->mesh->periodic,
+                              e->mesh->r_s_inv);
+#endif
+
       r->active_time += (getticks() - task_beg);
 
 /* Mark that we have run this task on these cells */
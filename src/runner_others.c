@@ -729,6 +729,11 @@ void runner_do_end_grav_force(struct runner *r, struct cell *c, int timer) {
     const int gcount = c->grav.count;
     struct gpart *restrict gparts = c->grav.parts;
 
+    /* Collect the P-P and M-P forces accumulated in the SoA copy */
+    const struct gravity_mirror_pool *pool = e->gravity_mirror_pool;
+    if (pool != NULL && c->grav.mirror_epoch == pool->epoch)
+      gravity_mirror_write_back(c->grav.mirror, gparts);
+
     /* Loop over the g-particles in this cell. */
     for (int k = 0; k < gcount; k++) {
 
@@ -28,9 +28,15 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <dirent.h>
 #include <string.h>
 #include <sys/stat.h>
 
+/* NUMA headers. */
+#ifdef HAVE_LIBNUMA
+#include <numa.h>
+#endif
+
 /* MPI headers. */
 #ifdef WITH_MPI
 #include <mpi.h>
@@ -53,6 +59,7 @@
 #include "space.h"
 #include "space_getsid.h"
 #include "task.h"
+#include "task_cost_model.h"
 #include "threadpool.h"
 #include "timers.h"
 #include "version.h"
@@ -1941,395 +1948,435 @@ void scheduler_reset(struct scheduler *s, int size) {
 }
 
 /**
- * @brief Compute the task weights
+ * @brief Estimates the cost of a task from the particle counts of its cells.
+ *
+ * These are the static weights, in arbitrary units, used to prioritise the
+ * tasks along the critical path of the graph.
  *
  * @param s The #scheduler.
- * @param verbose Are we talkative?
+ * @param t The #task.
+ *
+ * @return The cost of the task.
  */
-void scheduler_reweight(struct scheduler *s, int verbose) {
-  const int nr_tasks = s->nr_tasks;
-  int *tid = s->tasks_ind;
-  struct task *tasks = s->tasks;
+float scheduler_task_static_cost(const struct scheduler *s,
+                                 const struct task *t) {
   const int nodeID = s->nodeID;
   const float wscale = 0.001f;
-  const ticks tic = getticks();
-
-  /* Run through the tasks backwards and set their weights. */
-  for (int k = nr_tasks - 1; k >= 0; k--) {
-    struct task *t = &tasks[tid[k]];
-    float cost = 0.f;
-    t->weight = 0.f;
-
-    for (int j = 0; j < t->nr_unlock_tasks; j++)
-      t->weight += t->unlock_tasks[j]->weight;
+  float cost = 0.f;
+
+  const float count_i = (t->ci != NULL) ? t->ci->hydro.count : 0.f;
+  const float count_j = (t->cj != NULL) ? t->cj->hydro.count : 0.f;
+  const float gcount_i = (t->ci != NULL) ? t->ci->grav.count : 0.f;
+  const float gcount_j = (t->cj != NULL) ? t->cj->grav.count : 0.f;
+  const float scount_i = (t->ci != NULL) ? t->ci->stars.count : 0.f;
+  const float scount_j = (t->cj != NULL) ? t->cj->stars.count : 0.f;
+  const float sink_count_i = (t->ci != NULL) ? t->ci->sinks.count : 0.f;
+  const float sink_count_j = (t->cj != NULL) ? t->cj->sinks.count : 0.f;
+  const float bcount_i = (t->ci != NULL) ? t->ci->black_holes.count : 0.f;
+  const float bcount_j = (t->cj != NULL) ? t->cj->black_holes.count : 0.f;
+
+  switch (t->type) {
+    case task_type_sort:
+    case task_type_rt_sort:
+      cost = wscale * intrinsics_popcount(t->flags) * count_i *
+             (sizeof(int) * 8 - (count_i ? intrinsics_clz(count_i) : 0));
+      break;
 
-    const float count_i = (t->ci != NULL) ? t->ci->hydro.count : 0.f;
-    const float count_j = (t->cj != NULL) ? t->cj->hydro.count : 0.f;
-    const float gcount_i = (t->ci != NULL) ? t->ci->grav.count : 0.f;
-    const float gcount_j = (t->cj != NULL) ? t->cj->grav.count : 0.f;
-    const float scount_i = (t->ci != NULL) ? t->ci->stars.count : 0.f;
-    const float scount_j = (t->cj != NULL) ? t->cj->stars.count : 0.f;
-    const float sink_count_i = (t->ci != NULL) ? t->ci->sinks.count : 0.f;
-    const float sink_count_j = (t->cj != NULL) ? t->cj->sinks.count : 0.f;
-    const float bcount_i = (t->ci != NULL) ? t->ci->black_holes.count : 0.f;
-    const float bcount_j = (t->cj != NULL) ? t->cj->black_holes.count : 0.f;
+    case task_type_stars_sort:
+      cost = wscale * intrinsics_popcount(t->flags) * scount_i *
+             (sizeof(int) * 8 - (scount_i ? intrinsics_clz(scount_i) : 0));
+      break;
 
-    switch (t->type) {
-      case task_type_sort:
-      case task_type_rt_sort:
-        cost = wscale * intrinsics_popcount(t->flags) * count_i *
-               (sizeof(int) * 8 - (count_i ? intrinsics_clz(count_i) : 0));
-        break;
+    case task_type_stars_resort:
+      cost = wscale * intrinsics_popcount(t->flags) * scount_i *
+             (sizeof(int) * 8 - (scount_i ? intrinsics_clz(scount_i) : 0));
+      break;
 
-      case task_type_stars_sort:
-        cost = wscale * intrinsics_popcount(t->flags) * scount_i *
-               (sizeof(int) * 8 - (scount_i ? intrinsics_clz(scount_i) : 0));
-        break;
+    case task_type_self:
+      if (t->subtype == task_subtype_grav) {
+        cost = 1.f * (wscale * gcount_i) * gcount_i;
+      } else if (t->subtype == task_subtype_external_grav)
+        cost = 1.f * wscale * gcount_i;
+      else if (t->subtype == task_subtype_stars_density ||
+               t->subtype == task_subtype_stars_prep1 ||
+               t->subtype == task_subtype_stars_prep2 ||
+               t->subtype == task_subtype_stars_feedback)
+        cost = 1.f * wscale * scount_i * count_i;
+      else if (t->subtype == task_subtype_sink_swallow ||
+               t->subtype == task_subtype_sink_do_gas_swallow)
+        cost = 1.f * wscale * count_i * sink_count_i;
+      else if (t->subtype == task_subtype_sink_do_sink_swallow)
+        cost = 1.f * wscale * sink_count_i * sink_count_i;
+      else if (t->subtype == task_subtype_bh_density ||
+               t->subtype == task_subtype_bh_swallow ||
+               t->subtype == task_subtype_bh_feedback)
+        cost = 1.f * wscale * bcount_i * count_i;
+      else if (t->subtype == task_subtype_do_gas_swallow)
+        cost = 1.f * wscale * count_i;
+      else if (t->subtype == task_subtype_do_bh_swallow)
+        cost = 1.f * wscale * bcount_i;
+      else if (t->subtype == task_subtype_density ||
+               t->subtype == task_subtype_gradient ||
+               t->subtype == task_subtype_force ||
+               t->subtype == task_subtype_limiter)
+        cost = 1.f * (wscale * count_i) * count_i;
+      else if (t->subtype == task_subtype_rt_gradient)
+        cost = 1.f * wscale * count_i * count_i;
+      else if (t->subtype == task_subtype_rt_transport)
+        cost = 1.f * wscale * count_i * count_i;
+      else
+        error("Untreated sub-type for selfs: %s",
+              subtaskID_names[t->subtype]);
+      break;
 
-      case task_type_stars_resort:
-        cost = wscale * intrinsics_popcount(t->flags) * scount_i *
-               (sizeof(int) * 8 - (scount_i ? intrinsics_clz(scount_i) : 0));
-        break;
+    case task_type_pair:
+      if (t->subtype == task_subtype_grav) {
+        if (t->ci->nodeID != nodeID || t->cj->nodeID != nodeID)
+          cost = 3.f * (wscale * gcount_i) * gcount_j;
+        else
+          cost = 2.f * (wscale * gcount_i) * gcount_j;
 
-      case task_type_self:
-        if (t->subtype == task_subtype_grav) {
-          cost = 1.f * (wscale * gcount_i) * gcount_i;
-        } else if (t->subtype == task_subtype_external_grav)
-          cost = 1.f * wscale * gcount_i;
-        else if (t->subtype == task_subtype_stars_density ||
+      } else if (t->subtype == task_subtype_stars_density ||
                  t->subtype == task_subtype_stars_prep1 ||
                  t->subtype == task_subtype_stars_prep2 ||
-                 t->subtype == task_subtype_stars_feedback)
-          cost = 1.f * wscale * scount_i * count_i;
-        else if (t->subtype == task_subtype_sink_swallow ||
-                 t->subtype == task_subtype_sink_do_gas_swallow)
-          cost = 1.f * wscale * count_i * sink_count_i;
-        else if (t->subtype == task_subtype_sink_do_sink_swallow)
-          cost = 1.f * wscale * sink_count_i * sink_count_i;
-        else if (t->subtype == task_subtype_bh_density ||
+                 t->subtype == task_subtype_stars_feedback) {
+        if (t->ci->nodeID != nodeID)
+          cost = 3.f * wscale * count_i * scount_j * sid_scale[t->flags];
+        else if (t->cj->nodeID != nodeID)
+          cost = 3.f * wscale * scount_i * count_j * sid_scale[t->flags];
+        else
+          cost = 2.f * wscale * (scount_i * count_j + scount_j * count_i) *
+                 sid_scale[t->flags];
+
+      } else if (t->subtype == task_subtype_sink_swallow ||
+                 t->subtype == task_subtype_sink_do_gas_swallow) {
+        if (t->ci->nodeID != nodeID)
+          cost = 3.f * wscale * count_i * sink_count_j * sid_scale[t->flags];
+        else if (t->cj->nodeID != nodeID)
+          cost = 3.f * wscale * sink_count_i * count_j * sid_scale[t->flags];
+        else
+          cost = 2.f * wscale *
+                 (sink_count_i * count_j + sink_count_j * count_i) *
+                 sid_scale[t->flags];
+
+      } else if (t->subtype == task_subtype_sink_do_sink_swallow) {
+        if (t->ci->nodeID != nodeID)
+          cost = 3.f * wscale * sink_count_i * sink_count_j *
+                 sid_scale[t->flags];
+        else if (t->cj->nodeID != nodeID)
+          cost = 3.f * wscale * sink_count_i * sink_count_j *
+                 sid_scale[t->flags];
+        else
+          cost = 2.f * wscale *
+                 (sink_count_i * sink_count_j + sink_count_j * sink_count_i) *
+                 sid_scale[t->flags];
+
+      } else if (t->subtype == task_subtype_bh_density ||
                  t->subtype == task_subtype_bh_swallow ||
-                 t->subtype == task_subtype_bh_feedback)
-          cost = 1.f * wscale * bcount_i * count_i;
-        else if (t->subtype == task_subtype_do_gas_swallow)
-          cost = 1.f * wscale * count_i;
-        else if (t->subtype == task_subtype_do_bh_swallow)
-          cost = 1.f * wscale * bcount_i;
-        else if (t->subtype == task_subtype_density ||
+                 t->subtype == task_subtype_bh_feedback) {
+        if (t->ci->nodeID != nodeID)
+          cost = 3.f * wscale * count_i * bcount_j * sid_scale[t->flags];
+        else if (t->cj->nodeID != nodeID)
+          cost = 3.f * wscale * bcount_i * count_j * sid_scale[t->flags];
+        else
+          cost = 2.f * wscale * (bcount_i * count_j + bcount_j * count_i) *
+                 sid_scale[t->flags];
+
+      } else if (t->subtype == task_subtype_do_gas_swallow) {
+        cost = 1.f * wscale * (count_i + count_j);
+
+      } else if (t->subtype == task_subtype_do_bh_swallow) {
+        cost = 1.f * wscale * (bcount_i + bcount_j);
+
+      } else if (t->subtype == task_subtype_density ||
                  t->subtype == task_subtype_gradient ||
                  t->subtype == task_subtype_force ||
-                 t->subtype == task_subtype_limiter)
-          cost = 1.f * (wscale * count_i) * count_i;
-        else if (t->subtype == task_subtype_rt_gradient)
-          cost = 1.f * wscale * count_i * count_i;
-        else if (t->subtype == task_subtype_rt_transport)
-          cost = 1.f * wscale * count_i * count_i;
+                 t->subtype == task_subtype_limiter) {
+        if (t->ci->nodeID != nodeID || t->cj->nodeID != nodeID)
+          cost = 3.f * (wscale * count_i) * count_j * sid_scale[t->flags];
         else
-          error("Untreated sub-type for selfs: %s",
-                subtaskID_names[t->subtype]);
-        break;
-
-      case task_type_pair:
-        if (t->subtype == task_subtype_grav) {
-          if (t->ci->nodeID != nodeID || t->cj->nodeID != nodeID)
-            cost = 3.f * (wscale * gcount_i) * gcount_j;
-          else
-            cost = 2.f * (wscale * gcount_i) * gcount_j;
-
-        } else if (t->subtype == task_subtype_stars_density ||
-                   t->subtype == task_subtype_stars_prep1 ||
-                   t->subtype == task_subtype_stars_prep2 ||
-                   t->subtype == task_subtype_stars_feedback) {
-          if (t->ci->nodeID != nodeID)
-            cost = 3.f * wscale * count_i * scount_j * sid_scale[t->flags];
-          else if (t->cj->nodeID != nodeID)
-            cost = 3.f * wscale * scount_i * count_j * sid_scale[t->flags];
-          else
-            cost = 2.f * wscale * (scount_i * count_j + scount_j * count_i) *
-                   sid_scale[t->flags];
-
-        } else if (t->subtype == task_subtype_sink_swallow ||
-                   t->subtype == task_subtype_sink_do_gas_swallow) {
-          if (t->ci->nodeID != nodeID)
-            cost = 3.f * wscale * count_i * sink_count_j * sid_scale[t->flags];
-          else if (t->cj->nodeID != nodeID)
-            cost = 3.f * wscale * sink_count_i * count_j * sid_scale[t->flags];
-          else
-            cost = 2.f * wscale *
-                   (sink_count_i * count_j + sink_count_j * count_i) *
-                   sid_scale[t->flags];
-
-        } else if (t->subtype == task_subtype_sink_do_sink_swallow) {
-          if (t->ci->nodeID != nodeID)
-            cost = 3.f * wscale * sink_count_i * sink_count_j *
-                   sid_scale[t->flags];
-          else if (t->cj->nodeID != nodeID)
-            cost = 3.f * wscale * sink_count_i * sink_count_j *
-                   sid_scale[t->flags];
-          else
-            cost = 2.f * wscale *
-                   (sink_count_i * sink_count_j + sink_count_j * sink_count_i) *
-                   sid_scale[t->flags];
-
-        } else if (t->subtype == task_subtype_bh_density ||
-                   t->subtype == task_subtype_bh_swallow ||
-                   t->subtype == task_subtype_bh_feedback) {
-          if (t->ci->nodeID != nodeID)
-            cost = 3.f * wscale * count_i * bcount_j * sid_scale[t->flags];
-          else if (t->cj->nodeID != nodeID)
-            cost = 3.f * wscale * bcount_i * count_j * sid_scale[t->flags];
-          else
-            cost = 2.f * wscale * (bcount_i * count_j + bcount_j * count_i) *
-                   sid_scale[t->flags];
-
-        } else if (t->subtype == task_subtype_do_gas_swallow) {
-          cost = 1.f * wscale * (count_i + count_j);
-
-        } else if (t->subtype == task_subtype_do_bh_swallow) {
-          cost = 1.f * wscale * (bcount_i + bcount_j);
-
-        } else if (t->subtype == task_subtype_density ||
-                   t->subtype == task_subtype_gradient ||
-                   t->subtype == task_subtype_force ||
-                   t->subtype == task_subtype_limiter) {
-          if (t->ci->nodeID != nodeID || t->cj->nodeID != nodeID)
-            cost = 3.f * (wscale * count_i) * count_j * sid_scale[t->flags];
-          else
-            cost = 2.f * (wscale * count_i) * count_j * sid_scale[t->flags];
-
-        } else if (t->subtype == task_subtype_rt_gradient) {
-          cost = 1.f * wscale * count_i * count_j;
-        } else if (t->subtype == task_subtype_rt_transport) {
-          cost = 1.f * wscale * count_i * count_j;
-        } else {
-          error("Untreated sub-type for pairs: %s",
-                subtaskID_names[t->subtype]);
-        }
-        break;
+          cost = 2.f * (wscale * count_i) * count_j * sid_scale[t->flags];
+
+      } else if (t->subtype == task_subtype_rt_gradient) {
+        cost = 1.f * wscale * count_i * count_j;
+      } else if (t->subtype == task_subtype_rt_transport) {
+        cost = 1.f * wscale * count_i * count_j;
+      } else {
+        error("Untreated sub-type for pairs: %s",
+              subtaskID_names[t->subtype]);
+      }
+      break;
 
-      case task_type_sub_pair:
+    case task_type_sub_pair:
 #ifdef SWIFT_DEBUG_CHECKS
-        if (t->flags < 0) error("Negative flag value!");
+      if (t->flags < 0) error("Negative flag value!");
 #endif
-        if (t->subtype == task_subtype_stars_density ||
-            t->subtype == task_subtype_stars_prep1 ||
-            t->subtype == task_subtype_stars_prep2 ||
-            t->subtype == task_subtype_stars_feedback) {
-          if (t->ci->nodeID != nodeID) {
-            cost = 3.f * (wscale * count_i) * scount_j * sid_scale[t->flags];
-          } else if (t->cj->nodeID != nodeID) {
-            cost = 3.f * (wscale * scount_i) * count_j * sid_scale[t->flags];
-          } else {
-            cost = 2.f * wscale * (scount_i * count_j + scount_j * count_i) *
-                   sid_scale[t->flags];
-          }
+      if (t->subtype == task_subtype_stars_density ||
+          t->subtype == task_subtype_stars_prep1 ||
+          t->subtype == task_subtype_stars_prep2 ||
+          t->subtype == task_subtype_stars_feedback) {
+        if (t->ci->nodeID != nodeID) {
+          cost = 3.f * (wscale * count_i) * scount_j * sid_scale[t->flags];
+        } else if (t->cj->nodeID != nodeID) {
+          cost = 3.f * (wscale * scount_i) * count_j * sid_scale[t->flags];
+        } else {
+          cost = 2.f * wscale * (scount_i * count_j + scount_j * count_i) *
+                 sid_scale[t->flags];
+        }
 
-        } else if (t->subtype == task_subtype_sink_swallow ||
-                   t->subtype == task_subtype_sink_do_gas_swallow) {
-          if (t->ci->nodeID != nodeID) {
-            cost =
-                3.f * (wscale * count_i) * sink_count_j * sid_scale[t->flags];
-          } else if (t->cj->nodeID != nodeID) {
-            cost =
-                3.f * (wscale * sink_count_i) * count_j * sid_scale[t->flags];
-          } else {
-            cost = 2.f * wscale *
-                   (sink_count_i * count_j + sink_count_j * count_i) *
-                   sid_scale[t->flags];
-          }
+      } else if (t->subtype == task_subtype_sink_swallow ||
+                 t->subtype == task_subtype_sink_do_gas_swallow) {
+        if (t->ci->nodeID != nodeID) {
+          cost =
+              3.f * (wscale * count_i) * sink_count_j * sid_scale[t->flags];
+        } else if (t->cj->nodeID != nodeID) {
+          cost =
+              3.f * (wscale * sink_count_i) * count_j * sid_scale[t->flags];
+        } else {
+          cost = 2.f * wscale *
+                 (sink_count_i * count_j + sink_count_j * count_i) *
+                 sid_scale[t->flags];
+        }
 
-        } else if (t->subtype == task_subtype_sink_do_sink_swallow) {
-          if (t->ci->nodeID != nodeID) {
-            cost = 3.f * (wscale * sink_count_i) * sink_count_j *
-                   sid_scale[t->flags];
-          } else if (t->cj->nodeID != nodeID) {
-            cost = 3.f * (wscale * sink_count_i) * sink_count_j *
-                   sid_scale[t->flags];
-          } else {
-            cost = 2.f * wscale *
-                   (sink_count_i * sink_count_j + sink_count_j * sink_count_i) *
-                   sid_scale[t->flags];
-          }
-        } else if (t->subtype == task_subtype_bh_density ||
-                   t->subtype == task_subtype_bh_swallow ||
-                   t->subtype == task_subtype_bh_feedback) {
-          if (t->ci->nodeID != nodeID) {
-            cost = 3.f * (wscale * count_i) * bcount_j * sid_scale[t->flags];
-          } else if (t->cj->nodeID != nodeID) {
-            cost = 3.f * (wscale * bcount_i) * count_j * sid_scale[t->flags];
-          } else {
-            cost = 2.f * wscale * (bcount_i * count_j + bcount_j * count_i) *
-                   sid_scale[t->flags];
-          }
+      } else if (t->subtype == task_subtype_sink_do_sink_swallow) {
+        if (t->ci->nodeID != nodeID) {
+          cost = 3.f * (wscale * sink_count_i) * sink_count_j *
+                 sid_scale[t->flags];
+        } else if (t->cj->nodeID != nodeID) {
+          cost = 3.f * (wscale * sink_count_i) * sink_count_j *
+                 sid_scale[t->flags];
+        } else {
+          cost = 2.f * wscale *
+                 (sink_count_i * sink_count_j + sink_count_j * sink_count_i) *
+                 sid_scale[t->flags];
+        }
+      } else if (t->subtype == task_subtype_bh_density ||
+                 t->subtype == task_subtype_bh_swallow ||
+                 t->subtype == task_subtype_bh_feedback) {
+        if (t->ci->nodeID != nodeID) {
+          cost = 3.f * (wscale * count_i) * bcount_j * sid_scale[t->flags];
+        } else if (t->cj->nodeID != nodeID) {
+          cost = 3.f * (wscale * bcount_i) * count_j * sid_scale[t->flags];
+        } else {
+          cost = 2.f * wscale * (bcount_i * count_j + bcount_j * count_i) *
+                 sid_scale[t->flags];
+        }
 
-        } else if (t->subtype == task_subtype_do_gas_swallow) {
-          cost = 1.f * wscale * (count_i + count_j);
+      } else if (t->subtype == task_subtype_do_gas_swallow) {
+        cost = 1.f * wscale * (count_i + count_j);
 
-        } else if (t->subtype == task_subtype_do_bh_swallow) {
-          cost = 1.f * wscale * (bcount_i + bcount_j);
+      } else if (t->subtype == task_subtype_do_bh_swallow) {
+        cost = 1.f * wscale * (bcount_i + bcount_j);
 
-        } else if (t->subtype == task_subtype_density ||
-                   t->subtype == task_subtype_gradient ||
-                   t->subtype == task_subtype_force ||
-                   t->subtype == task_subtype_limiter) {
-          if (t->ci->nodeID != nodeID || t->cj->nodeID != nodeID) {
-            cost = 3.f * (wscale * count_i) * count_j * sid_scale[t->flags];
-          } else {
-            cost = 2.f * (wscale * count_i) * count_j * sid_scale[t->flags];
-          }
-        } else if (t->subtype == task_subtype_rt_gradient) {
-          cost = 1.f * wscale * count_i * count_j;
-        } else if (t->subtype == task_subtype_rt_transport) {
-          cost = 1.f * wscale * count_i * count_j;
+      } else if (t->subtype == task_subtype_density ||
+                 t->subtype == task_subtype_gradient ||
+                 t->subtype == task_subtype_force ||
+                 t->subtype == task_subtype_limiter) {
+        if (t->ci->nodeID != nodeID || t->cj->nodeID != nodeID) {
+          cost = 3.f * (wscale * count_i) * count_j * sid_scale[t->flags];
         } else {
-          error("Untreated sub-type for sub-pairs: %s",
-                subtaskID_names[t->subtype]);
+          cost = 2.f * (wscale * count_i) * count_j * sid_scale[t->flags];
         }
-        break;
+      } else if (t->subtype == task_subtype_rt_gradient) {
+        cost = 1.f * wscale * count_i * count_j;
+      } else if (t->subtype == task_subtype_rt_transport) {
+        cost = 1.f * wscale * count_i * count_j;
+      } else {
+        error("Untreated sub-type for sub-pairs: %s",
+              subtaskID_names[t->subtype]);
+      }
+      break;
 
-      case task_type_sub_self:
-        if (t->subtype == task_subtype_stars_density ||
-            t->subtype == task_subtype_stars_prep1 ||
-            t->subtype == task_subtype_stars_prep2 ||
-            t->subtype == task_subtype_stars_feedback) {
-          cost = 1.f * (wscale * scount_i) * count_i;
-        } else if (t->subtype == task_subtype_sink_swallow ||
-                   t->subtype == task_subtype_sink_do_gas_swallow) {
-          cost = 1.f * (wscale * sink_count_i) * count_i;
-        } else if (t->subtype == task_subtype_sink_do_sink_swallow) {
-          cost = 1.f * (wscale * sink_count_i) * sink_count_i;
-        } else if (t->subtype == task_subtype_bh_density ||
-                   t->subtype == task_subtype_bh_swallow ||
-                   t->subtype == task_subtype_bh_feedback) {
-          cost = 1.f * (wscale * bcount_i) * count_i;
-        } else if (t->subtype == task_subtype_do_gas_swallow) {
-          cost = 1.f * wscale * count_i;
-        } else if (t->subtype == task_subtype_do_bh_swallow) {
-          cost = 1.f * wscale * bcount_i;
-        } else if (t->subtype == task_subtype_density ||
-                   t->subtype == task_subtype_gradient ||
-                   t->subtype == task_subtype_force ||
-                   t->subtype == task_subtype_limiter) {
-          cost = 1.f * (wscale * count_i) * count_i;
-        } else if (t->subtype == task_subtype_rt_gradient) {
-          cost = 1.f * wscale * scount_i * count_i;
-        } else if (t->subtype == task_subtype_rt_transport) {
-          cost = 1.f * wscale * scount_i * count_i;
-        } else {
-          error("Untreated sub-type for sub-selfs: %s",
-                subtaskID_names[t->subtype]);
-        }
-        break;
-      case task_type_ghost:
-        if (t->ci == t->ci->hydro.super) cost = wscale * count_i;
-        break;
-      case task_type_extra_ghost:
-        if (t->ci == t->ci->hydro.super) cost = wscale * count_i;
-        break;
-      case task_type_stars_ghost:
-        if (t->ci == t->ci->hydro.super) cost = wscale * scount_i;
-        break;
-      case task_type_bh_density_ghost:
-        if (t->ci == t->ci->hydro.super) cost = wscale * bcount_i;
-        break;
-      case task_type_bh_swallow_ghost2:
-        if (t->ci == t->ci->hydro.super) cost = wscale * bcount_i;
-        break;
-      case task_type_drift_part:
-        cost = wscale * count_i;
-        break;
-      case task_type_drift_gpart:
-        cost = wscale * gcount_i;
-        break;
-      case task_type_drift_spart:
-        cost = wscale * scount_i;
-        break;
-      case task_type_drift_sink:
-        cost = wscale * sink_count_i;
-        break;
-      case task_type_drift_bpart:
-        cost = wscale * bcount_i;
-        break;
-      case task_type_init_grav:
-        cost = wscale * gcount_i;
-        break;
-      case task_type_grav_down:
-        cost = wscale * gcount_i;
-        break;
-      case task_type_grav_long_range:
-        cost = wscale * gcount_i;
-        break;
-      case task_type_grav_mm:
-        cost = wscale * (gcount_i + gcount_j);
-        break;
-      case task_type_end_hydro_force:
-        cost = wscale * count_i;
-        break;
-      case task_type_end_grav_force:
-        cost = wscale * gcount_i;
-        break;
-      case task_type_cooling:
-        cost = wscale * count_i;
-        break;
-      case task_type_star_formation:
-        cost = wscale * (count_i + scount_i);
-        break;
-      case task_type_star_formation_sink:
-        cost = wscale * (sink_count_i + scount_i);
-        break;
-      case task_type_sink_formation:
-        cost = wscale * (count_i + sink_count_i);
-        break;
-      case task_type_rt_ghost1:
-        cost = wscale * count_i;
-        break;
-      case task_type_rt_ghost2:
-        cost = wscale * count_i;
-        break;
-      case task_type_rt_tchem:
-        cost = wscale * count_i;
-        break;
-      case task_type_rt_advance_cell_time:
-      case task_type_rt_collect_times:
-        cost = wscale;
-        break;
-      case task_type_csds:
-        cost =
-            wscale * (count_i + gcount_i + scount_i + sink_count_i + bcount_i);
-        break;
-      case task_type_kick1:
-        cost =
-            wscale * (count_i + gcount_i + scount_i + sink_count_i + bcount_i);
-        break;
-      case task_type_kick2:
-        cost =
-            wscale * (count_i + gcount_i + scount_i + sink_count_i + bcount_i);
-        break;
-      case task_type_timestep:
-        cost =
-            wscale * (count_i + gcount_i + scount_i + sink_count_i + bcount_i);
-        break;
-      case task_type_timestep_limiter:
-        cost = wscale * count_i;
-        break;
-      case task_type_timestep_sync:
-        cost = wscale * count_i;
-        break;
-      case task_type_send:
-        if (count_i < 1e5)
-          cost = 10.f * (wscale * count_i) * count_i;
-        else
-          cost = 2e9;
-        break;
-      case task_type_recv:
-        if (count_i < 1e5)
-          cost = 5.f * (wscale * count_i) * count_i;
-        else
-          cost = 1e9;
-        break;
-      default:
-        cost = 0;
-        break;
-    }
+    case task_type_sub_self:
+      if (t->subtype == task_subtype_stars_density ||
+          t->subtype == task_subtype_stars_prep1 ||
+          t->subtype == task_subtype_stars_prep2 ||
+          t->subtype == task_subtype_stars_feedback) {
+        cost = 1.f * (wscale * scount_i) * count_i;
+      } else if (t->subtype == task_subtype_sink_swallow ||
+                 t->subtype == task_subtype_sink_do_gas_swallow) {
+        cost = 1.f * (wscale * sink_count_i) * count_i;
+      } else if (t->subtype == task_subtype_sink_do_sink_swallow) {
+        cost = 1.f * (wscale * sink_count_i) * sink_count_i;
+      } else if (t->subtype == task_subtype_bh_density ||
+                 t->subtype == task_subtype_bh_swallow ||
+                 t->subtype == task_subtype_bh_feedback) {
+        cost = 1.f * (wscale * bcount_i) * count_i;
+      } else if (t->subtype == task_subtype_do_gas_swallow) {
+        cost = 1.f * wscale * count_i;
+      } else if (t->subtype == task_subtype_do_bh_swallow) {
+        cost = 1.f * wscale * bcount_i;
+      } else if (t->subtype == task_subtype_density ||
+                 t->subtype == task_subtype_gradient ||
+                 t->subtype == task_subtype_force ||
+                 t->subtype == task_subtype_limiter) {
+        cost = 1.f * (wscale * count_i) * count_i;
+      } else if (t->subtype == task_subtype_rt_gradient) {
+        cost = 1.f * wscale * scount_i * count_i;
+      } else if (t->subtype == task_subtype_rt_transport) {
+        cost = 1.f * wscale * scount_i * count_i;
+      } else {
+        error("Untreated sub-type for sub-selfs: %s",
+              subtaskID_names[t->subtype]);
+      }
+      break;
+    case task_type_ghost:
+      if (t->ci == t->ci->hydro.super) cost = wscale * count_i;
+      break;
+    case task_type_extra_ghost:
+      if (t->ci == t->ci->hydro.super) cost = wscale * count_i;
+      break;
+    case task_type_stars_ghost:
+      if (t->ci == t->ci->hydro.super) cost = wscale * scount_i;
+      break;
+    case task_type_bh_density_ghost:
+      if (t->ci == t->ci->hydro.super) cost = wscale * bcount_i;
+      break;
+    case task_type_bh_swallow_ghost2:
+      if (t->ci == t->ci->hydro.super) cost = wscale * bcount_i;
+      break;
+    case task_type_drift_part:
+      cost = wscale * count_i;
+      break;
+    case task_type_drift_gpart:
+      cost = wscale * gcount_i;
+      break;
+    case task_type_drift_spart:
+      cost = wscale * scount_i;
+      break;
+    case task_type_drift_sink:
+      cost = wscale * sink_count_i;
+      break;
+    case task_type_drift_bpart:
+      cost = wscale * bcount_i;
+      break;
+    case task_type_init_grav:
+      cost = wscale * gcount_i;
+      break;
+    case task_type_grav_down:
+      cost = wscale * gcount_i;
+      break;
+    case task_type_grav_long_range:
+      cost = wscale * gcount_i;
+      break;
+    case task_type_grav_mm:
+      cost = wscale * (gcount_i + gcount_j);
+      break;
+    case task_type_end_hydro_force:
+      cost = wscale * count_i;
+      break;
+    case task_type_end_grav_force:
+      cost = wscale * gcount_i;
+      break;
+    case task_type_grav_mesh_assign:
+      cost = wscale * gcount_i;
+      break;
+    case task_type_grav_mesh_reduce: {
+      const float N = s->space->e->mesh->N;
+      cost = wscale * N * N * N;
+    } break;
+    case task_type_grav_mesh_r2c:
+    case task_type_grav_mesh_green:
+    case task_type_grav_mesh_c2r: {
+      const struct pm_mesh *mesh = s->space->e->mesh;
+      const float N = mesh->N;
+      cost = wscale * N * N * N / mesh->nr_task_blocks;
+    } break;
+    case task_type_grav_mesh_interp:
+      cost = wscale * gcount_i;
+      break;
+    case task_type_cooling:
+      cost = wscale * count_i;
+      break;
+    case task_type_star_formation:
+      cost = wscale * (count_i + scount_i);
+      break;
+    case task_type_star_formation_sink:
+      cost = wscale * (sink_count_i + scount_i);
+      break;
+    case task_type_sink_formation:
+      cost = wscale * (count_i + sink_count_i);
+      break;
+    case task_type_rt_ghost1:
+      cost = wscale * count_i;
+      break;
+    case task_type_rt_ghost2:
+      cost = wscale * count_i;
+      break;
+    case task_type_rt_tchem:
+      cost = wscale * count_i;
+      break;
+    case task_type_rt_advance_cell_time:
+    case task_type_rt_collect_times:
+      cost = wscale;
+      break;
+    case task_type_csds:
+      cost =
+          wscale * (count_i + gcount_i + scount_i + sink_count_i + bcount_i);
+      break;
+    case task_type_kick1:
+      cost =
+          wscale * (count_i + gcount_i + scount_i + sink_count_i + bcount_i);
+      break;
+    case task_type_kick2:
+      cost =
+          wscale * (count_i + gcount_i + scount_i + sink_count_i + bcount_i);
+      break;
+    case task_type_timestep:
+      cost =
+          wscale * (count_i + gcount_i + scount_i + sink_count_i + bcount_i);
+      break;
+    case task_type_timestep_limiter:
+      cost = wscale * count_i;
+      break;
+    case task_type_timestep_sync:
+      cost = wscale * count_i;
+      break;
+    case task_type_send:
+      if (count_i < 1e5)
+        cost = 10.f * (wscale * count_i) * count_i;
+      else
+        cost = 2e9;
+      break;
+    case task_type_recv:
+      if (count_i < 1e5)
+        cost = 5.f * (wscale * count_i) * count_i;
+      else
+        cost = 1e9;
+      break;
+    default:
+      cost = 0;
+      break;
+  }
+
+  return cost;
+}
+
+/**
+ * @brief Compute the task weights
+ *
+ * @param s The #scheduler.
+ * @param verbose Are we talkative?
+ */
+void scheduler_reweight(struct scheduler *s, int verbose) {
+  const int nr_tasks = s->nr_tasks;
+  int *tid = s->tasks_ind;
+  struct task *tasks = s->tasks;
+  const struct task_cost_model *cost_model = s->space->e->task_cost_model;
+  const ticks tic = getticks();
+
+  /* Run through the tasks backwards and set their weights. */
+  for (int k = nr_tasks - 1; k >= 0; k--) {
+    struct task *t = &tasks[tid[k]];
+    t->weight = 0.f;
+
+    for (int j = 0; j < t->nr_unlock_tasks; j++)
+      t->weight += t->unlock_tasks[j]->weight;
+
+    /* Static cost, or the one learned from the measured task times */
+    float cost = scheduler_task_static_cost(s, t);
+    if (cost_model != NULL)
+      cost = task_cost_model_predict(cost_model, t->type, t->subtype, cost);
     t->weight += cost;
   }
 
@@ -2724,6 +2771,14 @@ void scheduler_enqueue(struct scheduler *s, struct task *t) {
         error("SWIFT was not compiled with MPI support.");
 #endif
       break;
+      case task_type_grav_mesh_reduce:
+#ifdef WITH_MPI
+        /* Start summing the mesh over the ranks. The task is only run once
+         * the reduction has completed (see task_lock()). */
+        pm_mesh_tasks_reduce_start(s->space->e->mesh, t->flags, &t->req);
+#endif
+        qid = -1;
+        break;
       default:
         qid = -1;
     }
@@ -2854,27 +2909,40 @@ struct task *scheduler_gettask(struct scheduler *s, int qid,
       /* Try to get a task from the suggested queue. */
       if (s->queues[qid].count > 0 || s->queues[qid].count_incoming > 0) {
         TIMER_TIC
-        res = queue_gettask(&s->queues[qid], prev, 0);
+        res = queue_gettask(&s->queues[qid], 0);
         TIMER_TOC(timer_qget);
         if (res != NULL) break;
       }
 
-      /* If unsuccessful, try stealing from the other queues. */
+      /* If unsuccessful, try stealing from the other queues, starting with
+       * the ones closest to us in the hardware topology. */
       if (s->flags & scheduler_flag_steal) {
-        int count = 0, qids[nr_queues];
-        for (int k = 0; k < nr_queues; k++)
-          if (s->queues[k].count > 0 || s->queues[k].count_incoming > 0) {
-            qids[count++] = k;
+        const int *order = &s->steal_order[qid * nr_queues];
+        const int *group_end =
+            &s->steal_group_end[qid * scheduler_steal_distance_count];
+        int nr_steals = 0, group_start = 0, qids[nr_queues];
+        for (int d = 0; d < scheduler_steal_distance_count && res == NULL &&
+                        nr_steals < scheduler_maxsteal;
+             d++) {
+          int count = 0;
+          for (int k = group_start; k < group_end[d]; k++) {
+            const int q = order[k];
+            if (s->queues[q].count > 0 || s->queues[q].count_incoming > 0) {
+              qids[count++] = q;
+            }
+          }
+          group_start = group_end[d];
+          for (; nr_steals < scheduler_maxsteal && count > 0; nr_steals++) {
+            const int ind = rand_r(&seed) % count;
+            TIMER_TIC
+            res = queue_gettask(&s->queues[qids[ind]], 0);
+            TIMER_TOC(timer_qsteal);
+            if (res != NULL) {
+              atomic_inc(&s->steals.count[d]);
+              break;
+            } else
+              qids[ind] = qids[--count];
           }
-        for (int k = 0; k < scheduler_maxsteal && count > 0; k++) {
-          const int ind = rand_r(&seed) % count;
-          TIMER_TIC
-          res = queue_gettask(&s->queues[qids[ind]], prev, 0);
-          TIMER_TOC(timer_qsteal);
-          if (res != NULL)
-            break;
-          else
-            qids[ind] = qids[--count];
         }
         if (res != NULL) break;
       }
@@ -2888,7 +2956,7 @@ struct task *scheduler_gettask(struct scheduler *s, int qid,
 #endif
     {
       pthread_mutex_lock(&s->sleep_mutex);
-      res = queue_gettask(&s->queues[qid], prev, 1);
+      res = queue_gettask(&s->queues[qid], 1);
       if (res == NULL && s->waiting > 0) {
         pthread_cond_wait(&s->sleep_cond, &s->sleep_mutex);
       }
@@ -2908,6 +2976,158 @@ struct task *scheduler_gettask(struct scheduler *s, int qid,
   return res;
 }
 
+/**
+ * @brief Reads the first integer of a sysfs file.
+ *
+ * @param fileName The name of the file.
+ *
+ * @return The integer or -1 if the file cannot be read.
+ */
+static int scheduler_read_sysfs_int(const char *fileName) {
+
+  FILE *file = fopen(fileName, "r");
+  if (file == NULL) return -1;
+
+  int value = -1;
+  if (fscanf(file, "%d", &value) != 1) value = -1;
+  fclose(file);
+  return value;
+}
+
+/**
+ * @brief Finds where a CPU sits in the hardware topology.
+ *
+ * The last-level cache is identified by the lowest CPU sharing it. Anything
+ * that cannot be found (e.g. no sysfs) is set to -1.
+ *
+ * @param cpu The CPU ID.
+ * @param cache (return) The last-level cache domain of the CPU.
+ * @param numa (return) The NUMA node of the CPU.
+ * @param socket (return) The socket of the CPU.
+ */
+static void scheduler_cpu_topology(const int cpu, int *cache, int *numa,
+                                   int *socket) {
+
+  char fileName[200];
+  *cache = -1;
+  *numa = -1;
+  *socket = -1;
+  if (cpu < 0) return;
+
+  /* Socket */
+  sprintf(fileName,
+          "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+  *socket = scheduler_read_sysfs_int(fileName);
+
+  /* Last-level cache: the one with the highest level */
+  int max_level = 0;
+  for (int index = 0; index < 10; index++) {
+    sprintf(fileName, "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu,
+            index);
+    const int level = scheduler_read_sysfs_int(fileName);
+    if (level <= max_level) continue;
+    sprintf(fileName,
+            "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu,
+            index);
+    const int first_cpu = scheduler_read_sysfs_int(fileName);
+    if (first_cpu < 0) continue;
+    max_level = level;
+    *cache = first_cpu;
+  }
+
+  /* NUMA node */
+#ifdef HAVE_LIBNUMA
+  if (numa_available() >= 0) *numa = numa_node_of_cpu(cpu);
+#endif
+  if (*numa < 0) {
+    sprintf(fileName, "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = opendir(fileName);
+    if (dir != NULL) {
+      struct dirent *entry;
+      while ((entry = readdir(dir)) != NULL)
+        if (sscanf(entry->d_name, "node%d", numa) == 1) break;
+      closedir(dir);
+    }
+  }
+}
+
+/**
+ * @brief Sorts the queues each queue steals from by topological distance.
+ *
+ * A queue first tries to steal from the queues sharing its last-level cache,
+ * then from the ones on its NUMA node, then on its socket and only then from
+ * the rest. Queues whose CPU is unknown are all considered remote, so without
+ * any topology the stealing is the same as a uniformly random pick.
+ *
+ * @param s The #scheduler.
+ * @param queue_cpus The CPU the runners of each queue are pinned to (-1 if
+ * unknown). NULL if no runner is pinned.
+ * @param verbose Are we talkative?
+ */
+void scheduler_set_queue_topology(struct scheduler *s, const int *queue_cpus,
+                                  const int verbose) {
+
+  const int nr_queues = s->nr_queues;
+
+  /* Where are the queues? */
+  int *cache = (int *)malloc(3 * nr_queues * sizeof(int));
+  if (cache == NULL) error("Failed to allocate the queue topology.");
+  int *numa = cache + nr_queues;
+  int *socket = numa + nr_queues;
+  for (int q = 0; q < nr_queues; q++)
+    scheduler_cpu_topology(queue_cpus != NULL ? queue_cpus[q] : -1, &cache[q],
+                           &numa[q], &socket[q]);
+
+  for (int q = 0; q < nr_queues; q++) {
+
+    int *order = &s->steal_order[q * nr_queues];
+    int *group_end = &s->steal_group_end[q * scheduler_steal_distance_count];
+
+    /* Collect the other queues one distance after the other */
+    int count = 0;
+    for (int d = 0; d < scheduler_steal_distance_count; d++) {
+      for (int k = 0; k < nr_queues; k++) {
+        if (k == q) continue;
+
+        enum scheduler_steal_distance dist = scheduler_steal_remote;
+        if (cache[q] >= 0 && cache[k] == cache[q])
+          dist = scheduler_steal_cache;
+        else if (numa[q] >= 0 && numa[k] == numa[q])
+          dist = scheduler_steal_numa;
+        else if (socket[q] >= 0 && socket[k] == socket[q])
+          dist = scheduler_steal_socket;
+
+        if ((int)dist == d) order[count++] = k;
+      }
+      group_end[d] = count;
+    }
+  }
+
+  if (verbose && queue_cpus != NULL) {
+    int group_size[scheduler_steal_distance_count];
+    for (int d = 0; d < scheduler_steal_distance_count; d++)
+      group_size[d] =
+          s->steal_group_end[d] - (d > 0 ? s->steal_group_end[d - 1] : 0);
+    message(
+        "Queue 0 steals from %d queue(s) sharing its cache, %d on its NUMA "
+        "node, %d on its socket and %d elsewhere.",
+        group_size[scheduler_steal_cache], group_size[scheduler_steal_numa],
+        group_size[scheduler_steal_socket], group_size[scheduler_steal_remote]);
+  }
+
+  free(cache);
+}
+
+/**
+ * @brief Resets the counters of stolen tasks.
+ *
+ * @param s The #scheduler.
+ */
+void scheduler_reset_steals(struct scheduler *s) {
+  for (int d = 0; d < scheduler_steal_distance_count; d++)
+    s->steals.count[d] = 0;
+}
+
 /**
  * @brief Initialize the #scheduler.
  *
@@ -2955,6 +3175,16 @@ void scheduler_init(struct scheduler *s, struct space *space, int nr_tasks,
   s->nodeID = nodeID;
   s->threadpool = tp;
 
+  /* Until we know better, all the queues are equally far apart */
+  if ((s->steal_order = (int *)swift_malloc(
+           "steal_order", sizeof(int) * nr_queues * nr_queues)) == NULL ||
+      (s->steal_group_end = (int *)swift_malloc(
+           "steal_group_end",
+           sizeof(int) * nr_queues * scheduler_steal_distance_count)) == NULL)
+    error("Failed to allocate the queue stealing order.");
+  scheduler_set_queue_topology(s, /*queue_cpus=*/NULL, /*verbose=*/0);
+  scheduler_reset_steals(s);
+
   /* Init the tasks array. */
   s->size = 0;
   s->tasks = NULL;
@@ -2996,6 +3226,8 @@ void scheduler_clean(struct scheduler *s) {
   swift_free("unlock_ind", s->unlock_ind);
   for (int i = 0; i < s->nr_queues; ++i) queue_clean(&s->queues[i]);
   swift_free("queues", s->queues);
+  swift_free("steal_order", s->steal_order);
+  swift_free("steal_group_end", s->steal_group_end);
 }
 
 /**
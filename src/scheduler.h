@@ -54,6 +54,16 @@
 #define scheduler_flag_none 0
 #define scheduler_flag_steal (1 << 1)
 
+/* Topological distances between queues, in the order in which they are
+ * searched for a task to steal. */
+enum scheduler_steal_distance {
+  scheduler_steal_cache = 0, /* Same last-level cache */
+  scheduler_steal_numa,      /* Same NUMA node */
+  scheduler_steal_socket,    /* Same socket */
+  scheduler_steal_remote,    /* Anywhere else (or unknown) */
+  scheduler_steal_distance_count
+};
+
 /* Data of a scheduler. */
 struct scheduler {
   /* Scheduler flags. */
@@ -117,6 +127,18 @@ struct scheduler {
     ticks active_ticks;
   } deadtime;
 
+  /* Number of tasks stolen at each #scheduler_steal_distance. */
+  struct {
+    long long count[scheduler_steal_distance_count];
+  } steals;
+
+  /* For each queue, the other queues sorted by topological distance. */
+  int *steal_order;
+
+  /* For each queue, the end in steal_order of the queues at each
+   * #scheduler_steal_distance. */
+  int *steal_group_end;
+
   /* Frequency of the dependency graph dumping. */
   int frequency_dependency;
 
@@ -270,6 +292,8 @@ void scheduler_enqueue(struct scheduler *s, struct task *t);
 void scheduler_start(struct scheduler *s);
 void scheduler_reset(struct scheduler *s, int nr_tasks);
 void scheduler_ranktasks(struct scheduler *s);
+float scheduler_task_static_cost(const struct scheduler *s,
+                                 const struct task *t);
 void scheduler_reweight(struct scheduler *s, int verbose);
 struct task *scheduler_addtask(struct scheduler *s, enum task_types type,
                                enum task_subtypes subtype, long long flags,
@@ -282,6 +306,9 @@ void scheduler_addunlock(struct scheduler *s, struct task *ta, struct task *tb);
 void scheduler_set_unlocks(struct scheduler *s);
 void scheduler_dump_queue(struct scheduler *s);
 void scheduler_print_tasks(const struct scheduler *s, const char *fileName);
+void scheduler_set_queue_topology(struct scheduler *s, const int *queue_cpus,
+                                  int verbose);
+void scheduler_reset_steals(struct scheduler *s);
 void scheduler_clean(struct scheduler *s);
 void scheduler_free_tasks(struct scheduler *s);
 void scheduler_write_dependencies(struct scheduler *s, int verbose, int step);
@@ -47,6 +47,7 @@
 #include "cooling.h"
 #include "engine.h"
 #include "error.h"
+#include "gravity_long_range.h"
 #include "kernel_hydro.h"
 #include "lock.h"
 #include "mhd.h"
@@ -1409,6 +1410,9 @@ void space_init(struct space *s, struct swift_params *params,
         "Increase 'Scheduler:cell_extra_sinks'.");
   }
 
+  /* Are we running a zoom simulation? */
+  zoom_region_init(&s->zoom, params, s, nr_nodes);
+
   /* Build the cells recursively. */
   if (!dry_run) space_regrid(s, verbose);
 
@@ -2368,6 +2372,7 @@ void space_clean(struct space *s) {
   swift_free("cells_with_particles_top", s->cells_with_particles_top);
   swift_free("local_cells_with_particles_top",
              s->local_cells_with_particles_top);
+  gravity_long_range_lists_free(s);
   swift_free("parts", s->parts);
   swift_free("xparts", s->xparts);
   swift_free("gparts", s->gparts);
@@ -2537,6 +2542,7 @@ void space_struct_restore(struct space *s, FILE *stream) {
   s->local_cells_with_tasks_top = NULL;
   s->cells_with_particles_top = NULL;
   s->local_cells_with_particles_top = NULL;
+  s->grav_long_range = NULL;
   s->nr_local_cells_with_tasks = 0;
   s->nr_cells_with_particles = 0;
 #ifdef WITH_MPI
@@ -36,11 +36,13 @@
 #include "part.h"
 #include "space_unique_id.h"
 #include "velociraptor_struct.h"
+#include "zoom_region.h"
 
 /* Avoid cyclic inclusions */
 struct cell;
 struct cosmology;
 struct gravity_props;
+struct gravity_long_range_lists;
 struct star_formation;
 struct hydro_props;
 
@@ -179,6 +181,12 @@ struct space {
   /*! The indices of the top-level cells that have >0 particles (of any kind) */
   int *local_cells_with_particles_top;
 
+  /*! The interaction lists of the long-range gravity tasks */
+  struct gravity_long_range_lists *grav_long_range;
+
+  /*! The nested top-level grid of zoom simulations */
+  struct zoom_region zoom;
+
   /*! The total number of #part in the space. */
   size_t nr_parts;
 
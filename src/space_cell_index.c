@@ -202,9 +202,7 @@ void space_gparts_get_cell_index_mapper(void *map_data, int nr_gparts,
   const double dim_y = s->dim[1];
   const double dim_z = s->dim[2];
   const int cdim[3] = {s->cdim[0], s->cdim[1], s->cdim[2]};
-  const double ih_x = s->iwidth[0];
-  const double ih_y = s->iwidth[1];
-  const double ih_z = s->iwidth[2];
+  const double ih[3] = {s->iwidth[0], s->iwidth[1], s->iwidth[2]};
 
   /* Init the local count buffer. */
   int *cell_counts = (int *)calloc(sizeof(int), s->nr_cells);
@@ -249,12 +247,12 @@ void space_gparts_get_cell_index_mapper(void *map_data, int nr_gparts,
     if (pos_y == dim_y) pos_y = 0.0;
     if (pos_z == dim_z) pos_z = 0.0;
 
-    /* Get its cell index */
+    /* Get its cell index (possibly in the zoom region) */
     const int index =
-        cell_getid(cdim, pos_x * ih_x, pos_y * ih_y, pos_z * ih_z);
+        zoom_region_get_cell_index(&s->zoom, cdim, ih, pos_x, pos_y, pos_z);
 
 #ifdef SWIFT_DEBUG_CHECKS
-    if (index < 0 || index >= cdim[0] * cdim[1] * cdim[2])
+    if (index < 0 || index >= s->nr_cells)
       error("Invalid index=%d cdim=[%d %d %d] p->x=[%e %e %e]", index, cdim[0],
             cdim[1], cdim[2], pos_x, pos_y, pos_z);
 
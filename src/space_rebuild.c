@@ -849,9 +849,8 @@ void space_rebuild(struct space *s, int repartitioned, int verbose) {
       error("Inhibited particle sorted into a cell!");
 
     /* New cell index */
-    const int new_gind =
-        cell_getid(s->cdim, gp->x[0] * s->iwidth[0], gp->x[1] * s->iwidth[1],
-                   gp->x[2] * s->iwidth[2]);
+    const int new_gind = zoom_region_get_cell_index(
+        &s->zoom, s->cdim, s->iwidth, gp->x[0], gp->x[1], gp->x[2]);
 
     /* New cell of this gpart */
     const struct cell *c = &s->cells_top[new_gind];
@@ -976,6 +975,10 @@ void space_rebuild(struct space *s, int repartitioned, int verbose) {
      cell to get the full AMR grid. */
   space_split(s, verbose);
 
+  /* The void cells covering the zoom region get the content of the fine
+   * cells */
+  zoom_region_make_void_multipoles(s, /*rebuild=*/1);
+
 #ifdef SWIFT_DEBUG_CHECKS
   /* Check that the multipole construction went OK */
   if (s->with_self_gravity)
@@ -98,6 +98,8 @@ void space_rebuild_recycle_mapper(void *map_data, int num_elements,
     c->hydro.limiter = NULL;
     c->grav.grav = NULL;
     c->grav.mm = NULL;
+    c->grav.mirror = NULL;
+    c->grav.mirror_epoch = 0;
     c->hydro.dx_max_part = 0.0f;
     c->hydro.dx_max_sort = 0.0f;
     c->sinks.dx_max_part = 0.f;
@@ -182,6 +184,10 @@ void space_rebuild_recycle_mapper(void *map_data, int num_elements,
     c->grav.down = NULL;
     c->grav.end_force = NULL;
     c->grav.neutrino_weight = NULL;
+    c->grav.mesh_assign = NULL;
+    c->grav.mesh_interp = NULL;
+    c->grav.mirror = NULL;
+    c->grav.mirror_epoch = 0;
     c->top = c;
     c->super = c;
     c->hydro.super = c;
@@ -30,6 +30,56 @@
 #include "engine.h"
 #include "scheduler.h"
 
+/**
+ * @brief Set the geometry and the initial state of a new top-level cell.
+ *
+ * @param s The #space.
+ * @param cid The index of the cell.
+ * @param loc The location of the cell's bottom-left corner.
+ * @param width The width of the cell.
+ * @param dmin The minimal width of the cell.
+ * @param ti_current The current integer time.
+ */
+static void space_init_top_level_cell(struct space *s, const int cid,
+                                      const double loc[3],
+                                      const double width[3], const float dmin,
+                                      const integertime_t ti_current) {
+
+  struct cell *restrict c = &s->cells_top[cid];
+  c->loc[0] = loc[0];
+  c->loc[1] = loc[1];
+  c->loc[2] = loc[2];
+  c->width[0] = width[0];
+  c->width[1] = width[1];
+  c->width[2] = width[2];
+  c->dmin = dmin;
+  c->depth = 0;
+  c->split = 0;
+  c->hydro.count = 0;
+  c->grav.count = 0;
+  c->stars.count = 0;
+  c->sinks.count = 0;
+  c->top = c;
+  c->super = c;
+  c->hydro.super = c;
+  c->grav.super = c;
+  c->hydro.ti_old_part = ti_current;
+  c->grav.ti_old_part = ti_current;
+  c->stars.ti_old_part = ti_current;
+  c->sinks.ti_old_part = ti_current;
+  c->black_holes.ti_old_part = ti_current;
+  c->grav.ti_old_multipole = ti_current;
+#ifdef WITH_MPI
+  c->mpi.tag = -1;
+  c->mpi.recv = NULL;
+  c->mpi.send = NULL;
+#endif  // WITH_MPI
+  if (s->with_self_gravity) c->grav.multipole = &s->multipoles_top[cid];
+#if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_CELL_GRAPH)
+  cell_assign_top_level_cell_index(c, s->cdim, s->dim, s->iwidth);
+#endif
+}
+
 /**
  * @brief Re-build the top-level cell grid.
  *
@@ -222,8 +272,12 @@ void space_regrid(struct space *s, int verbose) {
     }
     const float dmin = min3(s->width[0], s->width[1], s->width[2]);
 
+    /* Place the zoom region (if any) on the new grid */
+    zoom_region_construct(&s->zoom, s, cdim, verbose);
+
     /* Allocate the highest level of cells. */
-    s->tot_cells = s->nr_cells = cdim[0] * cdim[1] * cdim[2];
+    s->tot_cells = s->nr_cells =
+        cdim[0] * cdim[1] * cdim[2] + s->zoom.nr_zoom_cells;
 
     if (swift_memalign("cells_top", (void **)&s->cells_top, cell_align,
                        s->nr_cells * sizeof(struct cell)) != 0)
@@ -294,42 +348,29 @@ void space_regrid(struct space *s, int verbose) {
     for (int i = 0; i < cdim[0]; i++)
       for (int j = 0; j < cdim[1]; j++)
         for (int k = 0; k < cdim[2]; k++) {
-          const size_t cid = cell_getid(cdim, i, j, k);
-          struct cell *restrict c = &s->cells_top[cid];
-          c->loc[0] = i * s->width[0];
-          c->loc[1] = j * s->width[1];
-          c->loc[2] = k * s->width[2];
-          c->width[0] = s->width[0];
-          c->width[1] = s->width[1];
-          c->width[2] = s->width[2];
-          c->dmin = dmin;
-          c->depth = 0;
-          c->split = 0;
-          c->hydro.count = 0;
-          c->grav.count = 0;
-          c->stars.count = 0;
-          c->sinks.count = 0;
-          c->top = c;
-          c->super = c;
-          c->hydro.super = c;
-          c->grav.super = c;
-          c->hydro.ti_old_part = ti_current;
-          c->grav.ti_old_part = ti_current;
-          c->stars.ti_old_part = ti_current;
-          c->sinks.ti_old_part = ti_current;
-          c->black_holes.ti_old_part = ti_current;
-          c->grav.ti_old_multipole = ti_current;
-#ifdef WITH_MPI
-          c->mpi.tag = -1;
-          c->mpi.recv = NULL;
-          c->mpi.send = NULL;
-#endif  // WITH_MPI
-          if (s->with_self_gravity) c->grav.multipole = &s->multipoles_top[cid];
-#if defined(SWIFT_DEBUG_CHECKS) || defined(SWIFT_CELL_GRAPH)
-          cell_assign_top_level_cell_index(c, s->cdim, s->dim, s->iwidth);
-#endif
+          const int cid = cell_getid(cdim, i, j, k);
+          const double loc[3] = {i * s->width[0], j * s->width[1],
+                                 k * s->width[2]};
+          space_init_top_level_cell(s, cid, loc, s->width, dmin, ti_current);
         }
 
+    /* Same for the fine cells of the zoom region */
+    if (s->zoom.enabled) {
+      const struct zoom_region *zoom = &s->zoom;
+      const float zoom_dmin = min3(zoom->width[0], zoom->width[1],
+                                   zoom->width[2]);
+      for (int i = 0; i < zoom->cdim[0]; i++)
+        for (int j = 0; j < zoom->cdim[1]; j++)
+          for (int k = 0; k < zoom->cdim[2]; k++) {
+            const int cid = zoom_region_cell_id(zoom, i, j, k);
+            const double loc[3] = {zoom->loc[0] + i * zoom->width[0],
+                                   zoom->loc[1] + j * zoom->width[1],
+                                   zoom->loc[2] + k * zoom->width[2]};
+            space_init_top_level_cell(s, cid, loc, zoom->width, zoom_dmin,
+                                      ti_current);
+          }
+    }
+
     /* Be verbose about the change. */
     if (verbose)
       message("set cell dimensions to [ %i %i %i ].", cdim[0], cdim[1],
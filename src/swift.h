@@ -44,10 +44,13 @@
 #include "error.h"
 #include "extra_io.h"
 #include "feedback.h"
+#include "fft_plans.h"
 #include "feedback_properties.h"
 #include "fof.h"
 #include "gravity.h"
+#ifndef SWIFT_MULTIPOLE_SPHERICAL
 #include "gravity_derivatives.h"
+#endif
 #include "gravity_properties.h"
 #include "hashmap.h"
 #include "hydro.h"
@@ -59,6 +62,7 @@
 #include "map.h"
 #include "memuse.h"
 #include "mesh_gravity.h"
+#include "mg_table.h"
 #include "minmax.h"
 #include "mpiuse.h"
 #include "multipole.h"
@@ -92,7 +96,9 @@
 #include "star_formation_logger.h"
 #include "stars.h"
 #include "stars_io.h"
+#include "table_cache.h"
 #include "task.h"
+#include "task_cost_model.h"
 #include "threadpool.h"
 #include "timeline.h"
 #include "timers.h"
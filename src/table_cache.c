@@ -0,0 +1,239 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/**
+ *  @file table_cache.c
+ *  @brief Versioned binary files caching expensive-to-build tables.
+ *
+ * A cache file contains a header with a key describing the inputs the
+ * tables were built from, followed by the raw arrays. Files are read through
+ * mmap() and are only accepted if their key matches exactly the one
+ * requested, so stale files are simply ignored and rebuilt.
+ */
+
+/* Config parameters. */
+#include <config.h>
+
+/* Some standard headers. */
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* MPI headers. */
+#ifdef WITH_MPI
+#include <mpi.h>
+#endif
+
+/* This object's header. */
+#include "table_cache.h"
+
+/* Local headers. */
+#include "error.h"
+
+/**
+ * @brief Is this the rank responsible for building and caching tables?
+ *
+ * That is rank 0 in MPI runs and any process otherwise (including MPI-enabled
+ * programs that never initialised MPI).
+ */
+int table_cache_is_root_rank(void) {
+
+#ifdef WITH_MPI
+  int initialised = 0;
+  MPI_Initialized(&initialised);
+  if (initialised) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    return rank == 0;
+  }
+#endif
+  return 1;
+}
+
+/**
+ * @brief Compute a 64-bit FNV-1a hash of a key, used to build file names.
+ *
+ * @param key The values of the key.
+ * @param nr_keys The number of values in the key.
+ */
+unsigned long long table_cache_hash(const double *key, const int nr_keys) {
+
+  const unsigned char *bytes = (const unsigned char *)key;
+  unsigned long long hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < nr_keys * sizeof(double); i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/**
+ * @brief Map a table cache file and check that it matches a key.
+ *
+ * @param f (return) The mapped file.
+ * @param filename The name of the file.
+ * @param key The expected key.
+ * @param nr_keys The number of values in the key.
+ * @param nr_arrays The expected number of arrays.
+ * @return 1 if the file exists and is valid, 0 otherwise.
+ */
+int table_cache_open(struct table_cache_file *f, const char *filename,
+                     const double *key, const int nr_keys,
+                     const int nr_arrays) {
+
+  f->map = NULL;
+  f->map_size = 0;
+  f->header = NULL;
+
+  if (nr_keys > TABLE_CACHE_MAX_KEYS || nr_arrays > TABLE_CACHE_MAX_ARRAYS)
+    error("Too many keys or arrays for a table cache file");
+
+  const int fd = open(filename, O_RDONLY);
+  if (fd < 0) return 0;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      (size_t)st.st_size < sizeof(struct table_cache_header)) {
+    close(fd);
+    return 0;
+  }
+
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return 0;
+
+  const struct table_cache_header *h = (const struct table_cache_header *)map;
+
+  /* Check the header against what we are looking for */
+  int valid = memcmp(h->magic, TABLE_CACHE_MAGIC, 8) == 0 &&
+              h->version == TABLE_CACHE_VERSION &&
+              h->sizeof_double == (int)sizeof(double) &&
+              h->nr_keys == nr_keys && h->nr_arrays == nr_arrays &&
+              memcmp(h->key, key, nr_keys * sizeof(double)) == 0;
+
+  /* Check that the file is complete */
+  if (valid) {
+    size_t expected = sizeof(struct table_cache_header);
+    for (int i = 0; i < nr_arrays; i++) {
+      if (h->lengths[i] < 0) valid = 0;
+      expected += h->lengths[i] * sizeof(double);
+    }
+    if (expected != (size_t)st.st_size) valid = 0;
+  }
+
+  if (!valid) {
+    munmap(map, st.st_size);
+    return 0;
+  }
+
+  f->map = map;
+  f->map_size = st.st_size;
+  f->header = h;
+  return 1;
+}
+
+/**
+ * @brief Return a pointer to one of the arrays of a mapped cache file.
+ *
+ * @param f The mapped file.
+ * @param i The index of the array.
+ * @param length (return) The number of elements in the array.
+ */
+const double *table_cache_get_array(const struct table_cache_file *f,
+                                    const int i, size_t *length) {
+
+  if (i >= f->header->nr_arrays) error("Invalid table cache array index");
+
+  const char *ptr = (const char *)f->map + sizeof(struct table_cache_header);
+  for (int j = 0; j < i; j++) ptr += f->header->lengths[j] * sizeof(double);
+
+  *length = f->header->lengths[i];
+  return (const double *)ptr;
+}
+
+/**
+ * @brief Unmap a table cache file.
+ *
+ * @param f The mapped file.
+ */
+void table_cache_close(struct table_cache_file *f) {
+
+  if (f->map != NULL) munmap(f->map, f->map_size);
+  f->map = NULL;
+  f->map_size = 0;
+  f->header = NULL;
+}
+
+/**
+ * @brief Write a table cache file.
+ *
+ * The file is written under a temporary name and then renamed such that
+ * concurrent readers never see a partial file. Failures are not fatal, we
+ * just report them and carry on without a cache.
+ *
+ * @param filename The name of the file.
+ * @param key The key identifying the inputs of the tables.
+ * @param nr_keys The number of values in the key.
+ * @param nr_arrays The number of arrays to write.
+ * @param lengths The number of elements of each array.
+ * @param arrays The arrays to write.
+ * @return 1 on success, 0 otherwise.
+ */
+int table_cache_write(const char *filename, const double *key,
+                      const int nr_keys, const int nr_arrays,
+                      const size_t *lengths, const double *const *arrays) {
+
+  if (nr_keys > TABLE_CACHE_MAX_KEYS || nr_arrays > TABLE_CACHE_MAX_ARRAYS)
+    error("Too many keys or arrays for a table cache file");
+
+  struct table_cache_header h;
+  bzero(&h, sizeof(struct table_cache_header));
+  memcpy(h.magic, TABLE_CACHE_MAGIC, 8);
+  h.version = TABLE_CACHE_VERSION;
+  h.nr_keys = nr_keys;
+  h.nr_arrays = nr_arrays;
+  h.sizeof_double = sizeof(double);
+  memcpy(h.key, key, nr_keys * sizeof(double));
+  for (int i = 0; i < nr_arrays; i++) h.lengths[i] = lengths[i];
+
+  char tmp_filename[PATH_MAX];
+  snprintf(tmp_filename, PATH_MAX, "%s.tmp.%d", filename, (int)getpid());
+
+  FILE *file = fopen(tmp_filename, "wb");
+  if (file == NULL) {
+    message("WARNING: Could not create table cache file '%s'", filename);
+    return 0;
+  }
+
+  int ok = fwrite(&h, sizeof(struct table_cache_header), 1, file) == 1;
+  for (int i = 0; i < nr_arrays && ok; i++)
+    ok = fwrite(arrays[i], sizeof(double), lengths[i], file) == lengths[i];
+  ok = (fclose(file) == 0) && ok;
+
+  if (!ok || rename(tmp_filename, filename) != 0) {
+    message("WARNING: Could not write table cache file '%s'", filename);
+    unlink(tmp_filename);
+    return 0;
+  }
+
+  return 1;
+}
@@ -0,0 +1,94 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_TABLE_CACHE_H
+#define SWIFT_TABLE_CACHE_H
+
+/* Config parameters. */
+#include <config.h>
+
+/* Some standard headers. */
+#include <stddef.h>
+
+/*! Magic string at the start of every table cache file */
+#define TABLE_CACHE_MAGIC "SWIFTTAB"
+
+/*! Version of the file layout. Bump whenever the layout changes. */
+#define TABLE_CACHE_VERSION 1
+
+/*! Maximal number of values in the key identifying a cache file */
+#define TABLE_CACHE_MAX_KEYS 32
+
+/*! Maximal number of arrays stored in a cache file */
+#define TABLE_CACHE_MAX_ARRAYS 16
+
+/**
+ * @brief Header of a binary table cache file.
+ *
+ * The header is followed by the arrays of doubles stored one after the other.
+ */
+struct table_cache_header {
+
+  /*! Magic string identifying the file type */
+  char magic[8];
+
+  /*! Version of the layout */
+  int version;
+
+  /*! Number of values in the key */
+  int nr_keys;
+
+  /*! Number of arrays stored in the file */
+  int nr_arrays;
+
+  /*! Size of a double on the machine that wrote the file (sanity check) */
+  int sizeof_double;
+
+  /*! Values identifying the inputs the arrays were computed from */
+  double key[TABLE_CACHE_MAX_KEYS];
+
+  /*! Number of elements in each array */
+  long long lengths[TABLE_CACHE_MAX_ARRAYS];
+};
+
+/**
+ * @brief A table cache file memory-mapped for reading.
+ */
+struct table_cache_file {
+
+  /*! Start of the mapped region */
+  void *map;
+
+  /*! Size of the mapped region in bytes */
+  size_t map_size;
+
+  /*! The header at the start of the file */
+  const struct table_cache_header *header;
+};
+
+int table_cache_is_root_rank(void);
+unsigned long long table_cache_hash(const double *key, const int nr_keys);
+int table_cache_open(struct table_cache_file *f, const char *filename,
+                     const double *key, const int nr_keys, const int nr_arrays);
+const double *table_cache_get_array(const struct table_cache_file *f,
+                                    const int i, size_t *length);
+void table_cache_close(struct table_cache_file *f);
+int table_cache_write(const char *filename, const double *key,
+                      const int nr_keys, const int nr_arrays,
+                      const size_t *lengths, const double *const *arrays);
+
+#endif /* SWIFT_TABLE_CACHE_H */
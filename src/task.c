@@ -84,6 +84,13 @@ const char *taskID_names[task_type_count] = {
     "grav_down_in",
     "grav_down",
     "grav_end_force",
+    "grav_mesh_assign",
+    "grav_mesh_ghost",
+    "grav_mesh_reduce",
+    "grav_mesh_r2c",
+    "grav_mesh_green",
+    "grav_mesh_c2r",
+    "grav_mesh_interp",
     "cooling",
     "cooling_in",
     "cooling_out",
@@ -222,6 +229,11 @@ __attribute__((always_inline)) INLINE static enum task_actions task_acts_on(
   switch (t->type) {
 
     case task_type_none:
+    case task_type_grav_mesh_ghost:
+    case task_type_grav_mesh_reduce:
+    case task_type_grav_mesh_r2c:
+    case task_type_grav_mesh_green:
+    case task_type_grav_mesh_c2r:
       return task_action_none;
       break;
 
@@ -349,6 +361,8 @@ __attribute__((always_inline)) INLINE static enum task_actions task_acts_on(
     case task_type_drift_gpart:
     case task_type_grav_down:
     case task_type_end_grav_force:
+    case task_type_grav_mesh_assign:
+    case task_type_grav_mesh_interp:
       return task_action_gpart;
       break;
 
@@ -747,6 +761,20 @@ int task_lock(struct task *t) {
 #endif
       break;
 
+    /* Reduction of the mesh over the ranks? */
+    case task_type_grav_mesh_reduce:
+#ifdef WITH_MPI
+      /* Has the non-blocking reduction completed? */
+      if ((err = MPI_Test(&t->req, &res, MPI_STATUS_IGNORE)) != MPI_SUCCESS)
+        mpi_error(err, "Failed to test the request of the mesh reduction.");
+
+      return res;
+#else
+      /* Nothing to wait for without MPI */
+      return 1;
+#endif
+      break;
+
     case task_type_kick1:
     case task_type_kick2:
     case task_type_csds:
@@ -1774,6 +1802,13 @@ enum task_categories task_get_category(const struct task *t) {
     case task_type_grav_mm:
     case task_type_grav_down:
     case task_type_end_grav_force:
+    case task_type_grav_mesh_assign:
+    case task_type_grav_mesh_ghost:
+    case task_type_grav_mesh_reduce:
+    case task_type_grav_mesh_r2c:
+    case task_type_grav_mesh_green:
+    case task_type_grav_mesh_c2r:
+    case task_type_grav_mesh_interp:
       return task_category_gravity;
 
     case task_type_fof_self:
@@ -77,6 +77,13 @@ enum task_types {
   task_type_grav_down_in, /* Implicit */
   task_type_grav_down,
   task_type_end_grav_force,
+  task_type_grav_mesh_assign,
+  task_type_grav_mesh_ghost, /* Implicit */
+  task_type_grav_mesh_reduce,
+  task_type_grav_mesh_r2c,
+  task_type_grav_mesh_green,
+  task_type_grav_mesh_c2r,
+  task_type_grav_mesh_interp,
   task_type_cooling,
   task_type_cooling_in,  /* Implicit */
   task_type_cooling_out, /* Implicit */
@@ -257,6 +264,11 @@ struct task {
   /*! Weight of the task */
   float weight;
 
+#ifdef SWIFT_LOCKFREE_QUEUES
+  /*! Next task in the same bucket of a lock-free #queue */
+  int queue_next;
+#endif
+
   /*! Number of tasks unlocked by this one */
   int nr_unlock_tasks;
 
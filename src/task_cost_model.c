@@ -0,0 +1,354 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/* Config parameters. */
+#include <config.h>
+
+/* System includes. */
+#include <stdlib.h>
+#include <string.h>
+
+/* MPI headers. */
+#ifdef WITH_MPI
+#include <mpi.h>
+#endif
+
+/* This object's header. */
+#include "task_cost_model.h"
+
+/* Local includes. */
+#include "clocks.h"
+#include "error.h"
+#include "minmax.h"
+#include "parser.h"
+#include "restart.h"
+#include "scheduler.h"
+
+/*! Number of doubles in a #task_cost_sums */
+#define task_cost_sums_size (sizeof(struct task_cost_sums) / sizeof(double))
+
+/*! Relative variance of the features below which only a mean is fitted */
+#define task_cost_model_min_variance 1e-6
+
+/**
+ * @brief Initialises the #task_cost_model from the parameter file.
+ *
+ * @param m The #task_cost_model.
+ * @param params The parsed parameter file.
+ */
+void task_cost_model_init(struct task_cost_model *m,
+                          struct swift_params *params) {
+
+  bzero(m, sizeof(struct task_cost_model));
+
+  m->decay = parser_get_opt_param_double(
+      params, "Scheduler:task_cost_model_decay", 0.9);
+  m->min_samples = parser_get_opt_param_double(
+      params, "Scheduler:task_cost_model_min_samples", 32.);
+
+  if (m->decay < 0. || m->decay > 1.)
+    error("Scheduler:task_cost_model_decay must be in [0, 1] (got %f).",
+          m->decay);
+  if (m->min_samples < 2.)
+    error("Scheduler:task_cost_model_min_samples must be at least 2 (got %f).",
+          m->min_samples);
+}
+
+/**
+ * @brief Adds a measured task time to the samples of the next fit.
+ *
+ * @param m The #task_cost_model.
+ * @param type The type of the task.
+ * @param subtype The subtype of the task.
+ * @param x The static cost estimate of the task.
+ * @param measured The time the task took, in ticks.
+ */
+void task_cost_model_add_sample(struct task_cost_model *m,
+                                enum task_types type,
+                                enum task_subtypes subtype, double x,
+                                double measured) {
+
+  struct task_cost_sums *step = &m->fits[type][subtype].step;
+  step->n += 1.;
+  step->x += x;
+  step->xx += x * x;
+  step->y += measured;
+  step->xy += x * measured;
+
+  if (x > 0.) {
+    m->step_static += x;
+    m->step_ticks += measured;
+  }
+}
+
+/**
+ * @brief Fits the cost of a pair from its sums.
+ *
+ * The least-squares line is used when the features vary enough and it gives
+ * positive costs. Otherwise, the cost is taken as proportional to the
+ * feature or, failing that, as the mean of the samples.
+ *
+ * @param fit The #task_cost_fit.
+ * @param min_samples The number of samples needed to trust the fit.
+ */
+static void task_cost_model_fit_pair(struct task_cost_fit *fit,
+                                     const double min_samples) {
+
+  const struct task_cost_sums *sums = &fit->sums;
+  fit->fitted = 0;
+  if (sums->n < min_samples) return;
+
+  const double var = sums->n * sums->xx - sums->x * sums->x;
+  if (var > task_cost_model_min_variance * sums->n * sums->xx) {
+
+    /* Least-squares line */
+    fit->slope = (sums->n * sums->xy - sums->x * sums->y) / var;
+    fit->intercept = (sums->y - fit->slope * sums->x) / sums->n;
+
+    /* Line through the origin if the other one predicts negative costs */
+    if (fit->slope < 0. || fit->intercept < 0.) {
+      fit->slope = sums->xy / sums->xx;
+      fit->intercept = 0.;
+    }
+  } else {
+
+    /* The features are (nearly) all the same: use the mean */
+    fit->slope = 0.;
+    fit->intercept = sums->y / sums->n;
+  }
+
+  fit->fitted = 1;
+}
+
+/**
+ * @brief Folds the samples gathered since the last update into the model and
+ * fits it again.
+ *
+ * The samples of all the ranks are combined, so this must be called by all
+ * of them. Only the pairs that got samples on at least one rank are
+ * exchanged.
+ *
+ * @param m The #task_cost_model.
+ */
+void task_cost_model_fit(struct task_cost_model *m) {
+
+  const int nr_pairs = task_type_count * task_subtype_count;
+  struct task_cost_fit *fits = &m->fits[0][0];
+
+#ifdef WITH_MPI
+  /* Find the pairs that got samples on any rank... */
+  unsigned char *has_samples =
+      (unsigned char *)malloc(nr_pairs * sizeof(unsigned char));
+  if (has_samples == NULL) error("Failed to allocate the task cost flags.");
+  for (int k = 0; k < nr_pairs; k++) has_samples[k] = (fits[k].step.n > 0.);
+  int err = MPI_Allreduce(MPI_IN_PLACE, has_samples, nr_pairs,
+                          MPI_UNSIGNED_CHAR, MPI_MAX, MPI_COMM_WORLD);
+  if (err != MPI_SUCCESS)
+    mpi_error(err, "Failed to all-reduce the task cost flags.");
+  int nr_sampled = 0;
+  for (int k = 0; k < nr_pairs; k++) nr_sampled += has_samples[k];
+
+  /* ... and combine their samples */
+  const size_t buff_size = nr_sampled * task_cost_sums_size + 2;
+  double *buff = (double *)malloc(buff_size * sizeof(double));
+  if (buff == NULL) error("Failed to allocate the task cost samples buffer.");
+  for (int k = 0, ind = 0; k < nr_pairs; k++)
+    if (has_samples[k])
+      memcpy(&buff[task_cost_sums_size * ind++], &fits[k].step,
+             sizeof(struct task_cost_sums));
+  buff[buff_size - 2] = m->step_static;
+  buff[buff_size - 1] = m->step_ticks;
+  err = MPI_Allreduce(MPI_IN_PLACE, buff, buff_size, MPI_DOUBLE, MPI_SUM,
+                      MPI_COMM_WORLD);
+  if (err != MPI_SUCCESS)
+    mpi_error(err, "Failed to all-reduce the task cost samples.");
+  for (int k = 0, ind = 0; k < nr_pairs; k++)
+    if (has_samples[k])
+      memcpy(&fits[k].step, &buff[task_cost_sums_size * ind++],
+             sizeof(struct task_cost_sums));
+  m->step_static = buff[buff_size - 2];
+  m->step_ticks = buff[buff_size - 1];
+  free(buff);
+  free(has_samples);
+#endif
+
+  const double decay = m->decay;
+  for (int k = 0; k < nr_pairs; k++) {
+    struct task_cost_fit *fit = &fits[k];
+
+    /* Only forget the old samples when there are new ones */
+    if (fit->step.n > 0.) {
+      fit->sums.n = decay * fit->sums.n + fit->step.n;
+      fit->sums.x = decay * fit->sums.x + fit->step.x;
+      fit->sums.xx = decay * fit->sums.xx + fit->step.xx;
+      fit->sums.y = decay * fit->sums.y + fit->step.y;
+      fit->sums.xy = decay * fit->sums.xy + fit->step.xy;
+      bzero(&fit->step, sizeof(struct task_cost_sums));
+      task_cost_model_fit_pair(fit, m->min_samples);
+    }
+  }
+
+  /* Conversion between the static costs and the ticks */
+  if (m->step_static > 0.) {
+    m->sum_static = decay * m->sum_static + m->step_static;
+    m->sum_ticks = decay * m->sum_ticks + m->step_ticks;
+    m->ticks_per_unit = m->sum_ticks / m->sum_static;
+  }
+  m->step_static = 0.;
+  m->step_ticks = 0.;
+
+  m->num_updates++;
+}
+
+/**
+ * @brief Updates the model with the times of the tasks run since a given
+ * time.
+ *
+ * The list of active tasks is emptied by scheduler_start() and the tasks are
+ * marked as skipped once done, so the tasks of the last launch are the ones
+ * that started after it.
+ *
+ * @param m The #task_cost_model.
+ * @param s The #scheduler whose tasks have just been run.
+ * @param since The start of the launch of the tasks.
+ * @param verbose Are we talkative?
+ */
+void task_cost_model_update(struct task_cost_model *m,
+                            const struct scheduler *s, const ticks since,
+                            int verbose) {
+
+  const ticks tic = getticks();
+
+  for (int k = 0; k < s->nr_tasks; k++) {
+    const struct task *t = &s->tasks[k];
+
+    /* Skip the tasks that did not run, do no work or wait on someone else */
+    if (t->implicit || t->tic < since || t->toc <= t->tic) continue;
+    if (t->type == task_type_send || t->type == task_type_recv) continue;
+
+    task_cost_model_add_sample(m, t->type, t->subtype,
+                               scheduler_task_static_cost(s, t),
+                               (double)(t->toc - t->tic));
+  }
+
+  task_cost_model_fit(m);
+
+  if (verbose) {
+    int nr_fitted = 0;
+    for (int i = 0; i < task_type_count; i++)
+      for (int j = 0; j < task_subtype_count; j++)
+        nr_fitted += m->fits[i][j].fitted;
+    message("%d task types fitted, %.3e ticks per unit of static cost.",
+            nr_fitted, m->ticks_per_unit);
+    message("took %.3f %s.", clocks_from_ticks(getticks() - tic),
+            clocks_getunit());
+  }
+}
+
+/**
+ * @brief The predicted time of a task, in ticks.
+ *
+ * @param m The #task_cost_model.
+ * @param type The type of the task.
+ * @param subtype The subtype of the task.
+ * @param static_cost The static cost estimate of the task.
+ *
+ * @return The predicted ticks or -1 if the model cannot tell.
+ */
+double task_cost_model_ticks(const struct task_cost_model *m,
+                             enum task_types type, enum task_subtypes subtype,
+                             double static_cost) {
+
+  const struct task_cost_fit *fit = &m->fits[type][subtype];
+  if (fit->fitted)
+    return max(fit->slope * static_cost + fit->intercept, 0.);
+  else if (m->ticks_per_unit > 0.)
+    return static_cost * m->ticks_per_unit;
+  else
+    return -1.;
+}
+
+/**
+ * @brief The cost of a task in the units of the static costs.
+ *
+ * Used to weight the tasks in the scheduler. The types that have not been
+ * fitted yet keep their static cost.
+ *
+ * @param m The #task_cost_model.
+ * @param type The type of the task.
+ * @param subtype The subtype of the task.
+ * @param static_cost The static cost estimate of the task.
+ */
+float task_cost_model_predict(const struct task_cost_model *m,
+                              enum task_types type,
+                              enum task_subtypes subtype, float static_cost) {
+
+  if (!m->fits[type][subtype].fitted || m->ticks_per_unit <= 0.)
+    return static_cost;
+
+  return task_cost_model_ticks(m, type, subtype, static_cost) /
+         m->ticks_per_unit;
+}
+
+/**
+ * @brief The cost of a task in the units of the repartitioning fixed costs.
+ *
+ * These are the units of the costs written by #task_dump_stats to
+ * partition_fixed_costs.h.
+ *
+ * @param m The #task_cost_model.
+ * @param type The type of the task.
+ * @param subtype The subtype of the task.
+ * @param static_cost The static cost estimate of the task.
+ * @param default_cost The cost to use if the model cannot tell.
+ */
+double task_cost_model_fixed_cost(const struct task_cost_model *m,
+                                  enum task_types type,
+                                  enum task_subtypes subtype,
+                                  double static_cost, double default_cost) {
+
+  const double pred = task_cost_model_ticks(m, type, subtype, static_cost);
+  if (pred < 0.) return default_cost;
+
+  return clocks_from_ticks(pred) * 10000.;
+}
+
+/**
+ * @brief Write a #task_cost_model struct to the given FILE as a stream of
+ * bytes.
+ *
+ * @param m The #task_cost_model.
+ * @param stream The file stream.
+ */
+void task_cost_model_struct_dump(const struct task_cost_model *m,
+                                 FILE *stream) {
+  restart_write_blocks((void *)m, sizeof(struct task_cost_model), 1, stream,
+                       "task_cost_model", "task cost model");
+}
+
+/**
+ * @brief Restore a #task_cost_model struct from the given FILE as a stream
+ * of bytes.
+ *
+ * @param m The #task_cost_model.
+ * @param stream The file stream.
+ */
+void task_cost_model_struct_restore(struct task_cost_model *m, FILE *stream) {
+  restart_read_blocks((void *)m, sizeof(struct task_cost_model), 1, stream,
+                      NULL, "task cost model");
+}
@@ -0,0 +1,125 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_TASK_COST_MODEL_H
+#define SWIFT_TASK_COST_MODEL_H
+
+/* Config parameters. */
+#include <config.h>
+
+/* System includes. */
+#include <stdio.h>
+
+/* Local includes. */
+#include "task.h"
+
+/* Forward declarations */
+struct scheduler;
+struct swift_params;
+
+/**
+ * @brief Sums of the samples of a linear regression.
+ */
+struct task_cost_sums {
+
+  /*! Number of samples */
+  double n;
+
+  /*! Sum of the features and of their squares */
+  double x, xx;
+
+  /*! Sum of the measured ticks and of their product with the features */
+  double y, xy;
+};
+
+/**
+ * @brief The fitted cost of one (type, subtype) pair of tasks.
+ */
+struct task_cost_fit {
+
+  /*! Sums of the samples, decayed at every update */
+  struct task_cost_sums sums;
+
+  /*! Sums of the samples gathered since the last update */
+  struct task_cost_sums step;
+
+  /*! Cost in ticks is slope * x + intercept */
+  double slope, intercept;
+
+  /*! Have we seen enough samples to trust the fit? */
+  int fitted;
+};
+
+/**
+ * @brief Model of the task costs learned from the measured task times.
+ *
+ * For every (type, subtype) pair, the time a task takes is fitted as a
+ * linear function of its static cost estimate, i.e. of the particle counts of
+ * its cells combined the way #scheduler_task_static_cost does. The sums of
+ * the regressions are decayed at every update so that the model follows the
+ * evolution of the run. The samples are combined over all the ranks, so the
+ * model is the same everywhere.
+ */
+struct task_cost_model {
+
+  /*! The fits of all the (type, subtype) pairs */
+  struct task_cost_fit fits[task_type_count][task_subtype_count];
+
+  /*! Factor by which the old samples are down-weighted at every update */
+  double decay;
+
+  /*! Number of (decayed) samples needed before a fit is used */
+  double min_samples;
+
+  /*! Decayed sums of the static costs and ticks of all the samples */
+  double sum_static, sum_ticks;
+
+  /*! Same, gathered since the last update */
+  double step_static, step_ticks;
+
+  /*! Average number of ticks per unit of static cost */
+  double ticks_per_unit;
+
+  /*! Number of updates so far */
+  long long num_updates;
+};
+
+void task_cost_model_init(struct task_cost_model *m,
+                          struct swift_params *params);
+void task_cost_model_add_sample(struct task_cost_model *m,
+                                enum task_types type,
+                                enum task_subtypes subtype, double x,
+                                double measured);
+void task_cost_model_fit(struct task_cost_model *m);
+void task_cost_model_update(struct task_cost_model *m,
+                            const struct scheduler *s, const ticks since,
+                            int verbose);
+float task_cost_model_predict(const struct task_cost_model *m,
+                              enum task_types type,
+                              enum task_subtypes subtype, float static_cost);
+double task_cost_model_ticks(const struct task_cost_model *m,
+                             enum task_types type, enum task_subtypes subtype,
+                             double static_cost);
+double task_cost_model_fixed_cost(const struct task_cost_model *m,
+                                  enum task_types type,
+                                  enum task_subtypes subtype,
+                                  double static_cost, double default_cost);
+void task_cost_model_struct_dump(const struct task_cost_model *m,
+                                 FILE *stream);
+void task_cost_model_struct_restore(struct task_cost_model *m, FILE *stream);
+
+#endif /* SWIFT_TASK_COST_MODEL_H */
@@ -0,0 +1,345 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/* Config parameters. */
+#include <config.h>
+
+/* System includes. */
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+/* This object's header. */
+#include "zoom_region.h"
+
+/* Local includes. */
+#include "cell.h"
+#include "engine.h"
+#include "error.h"
+#include "multipole.h"
+#include "parser.h"
+#include "space.h"
+
+/**
+ * @brief Read the parameters of the zoom region and check that the run is
+ * one we can deal with.
+ *
+ * @param zoom The #zoom_region to initialise.
+ * @param params The parsed parameter file.
+ * @param s The #space (with its particle counts set).
+ * @param nr_nodes The number of MPI ranks.
+ */
+void zoom_region_init(struct zoom_region *zoom, struct swift_params *params,
+                      const struct space *s, const int nr_nodes) {
+
+  bzero(zoom, sizeof(struct zoom_region));
+
+  zoom->enabled = parser_get_opt_param_int(params, "Zoom:enable", 0);
+  if (!zoom->enabled) return;
+
+  zoom->pad_factor = parser_get_opt_param_float(
+      params, "Zoom:region_pad_factor", zoom_region_pad_factor_default);
+  zoom->refinement_param =
+      parser_get_opt_param_int(params, "Zoom:refinement", 0);
+
+  if (zoom->pad_factor < 1.f)
+    error("Zoom:region_pad_factor must be >= 1 (got %f).", zoom->pad_factor);
+  if (zoom->refinement_param < 0)
+    error("Zoom:refinement must be >= 0 (got %d).", zoom->refinement_param);
+
+  /* What the nested grid is not (yet) able to deal with */
+  if (!s->with_self_gravity)
+    error("Zoom simulations require self-gravity to be switched on.");
+  if (!s->with_DM_background)
+    error(
+        "Zoom simulations require background DM particles to tell the "
+        "low-resolution volume apart from the zoom region.");
+  if (s->with_hydro || s->nr_parts > 0 || s->with_star_formation ||
+      s->with_sink || s->nr_sparts > 0 || s->nr_bparts > 0 || s->nr_sinks > 0)
+    error("Zoom simulations are only possible with gravity-only runs.");
+  if (nr_nodes > 1) error("Zoom simulations cannot be run over MPI.");
+}
+
+/**
+ * @brief Place the zoom region on a new top-level grid.
+ *
+ * The region is the bounding box of all the #gpart that are not background
+ * DM, padded by the chosen factor and extended to the nearest boundaries of
+ * the coarse cells. It is then covered by refinement^3 fine cells per coarse
+ * cell. Unless imposed, the refinement is chosen such that the fine cells
+ * contain as many particles on average as the coarse cells would without
+ * zoom region.
+ *
+ * @param zoom The #zoom_region.
+ * @param s The #space.
+ * @param cdim The number of coarse top-level cells along each axis.
+ * @param verbose Are we talkative?
+ */
+void zoom_region_construct(struct zoom_region *zoom, const struct space *s,
+                           const int cdim[3], const int verbose) {
+
+  if (!zoom->enabled) return;
+
+  /* Bounding box of the high-resolution particles */
+  double x_min[3] = {DBL_MAX, DBL_MAX, DBL_MAX};
+  double x_max[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+  long long nr_high_res = 0, nr_total = 0;
+  for (size_t k = 0; k < s->nr_gparts; ++k) {
+    const struct gpart *gp = &s->gparts[k];
+    if (gp->time_bin == time_bin_inhibited ||
+        gp->time_bin == time_bin_not_created)
+      continue;
+
+    nr_total++;
+    if (gp->type == swift_type_dark_matter_background) continue;
+
+    nr_high_res++;
+    for (int i = 0; i < 3; ++i) {
+      x_min[i] = min(x_min[i], gp->x[i]);
+      x_max[i] = max(x_max[i], gp->x[i]);
+    }
+  }
+  if (nr_high_res == 0)
+    error("No high-resolution particles to construct the zoom region around!");
+
+  /* Pad the box and snap it to the coarse grid */
+  for (int k = 0; k < 3; ++k) {
+
+    const double width = s->dim[k] / cdim[k];
+    const double centre = 0.5 * (x_min[k] + x_max[k]);
+    const double half_size = 0.5 * (x_max[k] - x_min[k]) * zoom->pad_factor;
+
+    if (s->periodic && 2. * half_size > 0.5 * s->dim[k])
+      error(
+          "The zoom region spans more than half of the box along axis %d. "
+          "Is the high-resolution region straddling the periodic boundary?",
+          k);
+
+    int lo = (int)floor((centre - half_size) / width);
+    int hi = (int)ceil((centre + half_size) / width);
+    if (hi == lo) hi = lo + 1;
+
+    if (s->periodic && (lo < 0 || hi > cdim[k]))
+      error(
+          "The zoom region crosses the periodic boundary along axis %d. The "
+          "initial conditions need to be re-centred on the high-resolution "
+          "region.",
+          k);
+
+    zoom->lo[k] = max(lo, 0);
+    zoom->hi[k] = min(hi, cdim[k]);
+  }
+
+  zoom->nr_coarse_cells = cdim[0] * cdim[1] * cdim[2];
+  zoom->nr_void_cells = (zoom->hi[0] - zoom->lo[0]) *
+                        (zoom->hi[1] - zoom->lo[1]) *
+                        (zoom->hi[2] - zoom->lo[2]);
+  if (zoom->nr_void_cells == zoom->nr_coarse_cells)
+    error("The zoom region covers the whole volume.");
+
+  /* Number of fine cells per coarse cell along each axis */
+  if (zoom->refinement_param > 0) {
+    zoom->refinement = zoom->refinement_param;
+  } else {
+    const double ratio = (double)nr_high_res * zoom->nr_coarse_cells /
+                         ((double)zoom->nr_void_cells * nr_total);
+    zoom->refinement = max((int)lround(cbrt(ratio)), 1);
+  }
+
+  zoom->nr_zoom_cells = 1;
+  for (int k = 0; k < 3; ++k) {
+    const double width = s->dim[k] / cdim[k];
+    zoom->cdim[k] = (zoom->hi[k] - zoom->lo[k]) * zoom->refinement;
+    zoom->loc[k] = zoom->lo[k] * width;
+    zoom->width[k] = width / zoom->refinement;
+    zoom->iwidth[k] = 1. / zoom->width[k];
+    zoom->nr_zoom_cells *= zoom->cdim[k];
+  }
+
+  message(
+      "Zoom region of [%d %d %d] coarse cells starting at [%d %d %d] covered "
+      "by [%d %d %d] cells (refinement %d, %lld high-res gparts).",
+      zoom->hi[0] - zoom->lo[0], zoom->hi[1] - zoom->lo[1],
+      zoom->hi[2] - zoom->lo[2], zoom->lo[0], zoom->lo[1], zoom->lo[2],
+      zoom->cdim[0], zoom->cdim[1], zoom->cdim[2], zoom->refinement,
+      nr_high_res);
+  if (verbose)
+    message("Zoom region spans [%e %e %e] -> [%e %e %e].", zoom->loc[0],
+            zoom->loc[1], zoom->loc[2],
+            zoom->loc[0] + zoom->cdim[0] * zoom->width[0],
+            zoom->loc[1] + zoom->cdim[1] * zoom->width[1],
+            zoom->loc[2] + zoom->cdim[2] * zoom->width[2]);
+}
+
+/**
+ * @brief Construct the multipole of a void cell from the ones of the fine
+ * cells it contains.
+ *
+ * @param s The #space.
+ * @param v The void #cell.
+ * @param first The fine grid coordinates of its first fine cell.
+ * @param ti_current The current integer time.
+ * @param rebuild Are we also setting the values at rebuild time?
+ */
+static void zoom_region_make_void_multipole(const struct space *s,
+                                            struct cell *v, const int first[3],
+                                            const integertime_t ti_current,
+                                            const int rebuild) {
+
+  const struct zoom_region *zoom = &s->zoom;
+  const int r = zoom->refinement;
+  struct gravity_tensors *multi = v->grav.multipole;
+
+  /* Keep the values at the last rebuild */
+  const double CoM_rebuild[3] = {multi->CoM_rebuild[0], multi->CoM_rebuild[1],
+                                 multi->CoM_rebuild[2]};
+  const double r_max_rebuild = multi->r_max_rebuild;
+
+  /* Reset everything */
+  gravity_reset(multi);
+
+  /* Compute CoM and bulk velocity of all the non-empty fine cells */
+  double CoM[3] = {0., 0., 0.};
+  double vel[3] = {0., 0., 0.};
+  float max_delta_vel[3] = {0.f, 0.f, 0.f};
+  float min_delta_vel[3] = {0.f, 0.f, 0.f};
+  double mass = 0.;
+
+  int f[3];
+  for (f[0] = first[0]; f[0] < first[0] + r; ++f[0]) {
+    for (f[1] = first[1]; f[1] < first[1] + r; ++f[1]) {
+      for (f[2] = first[2]; f[2] < first[2] + r; ++f[2]) {
+        const struct gravity_tensors *m =
+            s->cells_top[zoom_region_cell_id(zoom, f[0], f[1], f[2])]
+                .grav.multipole;
+        if (m->m_pole.M_000 == 0.f) continue;
+
+        mass += m->m_pole.M_000;
+        for (int k = 0; k < 3; ++k) {
+          CoM[k] += m->CoM[k] * m->m_pole.M_000;
+          vel[k] += m->m_pole.vel[k] * m->m_pole.M_000;
+          max_delta_vel[k] = max(m->m_pole.max_delta_vel[k], max_delta_vel[k]);
+          min_delta_vel[k] = min(m->m_pole.min_delta_vel[k], min_delta_vel[k]);
+        }
+      }
+    }
+  }
+
+  if (mass == 0.) {
+
+    /* Nothing in there, set the values to something sensible */
+    gravity_multipole_init(&multi->m_pole);
+    for (int k = 0; k < 3; ++k) multi->CoM[k] = v->loc[k] + 0.5 * v->width[k];
+    multi->r_max = 0.;
+
+  } else {
+
+    /* Final operation on the CoM and bulk velocity */
+    const double mass_inv = 1. / mass;
+    for (int k = 0; k < 3; ++k) {
+      multi->CoM[k] = CoM[k] * mass_inv;
+      multi->m_pole.vel[k] = vel[k] * mass_inv;
+      multi->m_pole.max_delta_vel[k] = max_delta_vel[k];
+      multi->m_pole.min_delta_vel[k] = min_delta_vel[k];
+    }
+
+    /* Now shift the fine cells' multipoles and add them up */
+    struct multipole temp;
+    double r_max = 0.;
+    for (f[0] = first[0]; f[0] < first[0] + r; ++f[0]) {
+      for (f[1] = first[1]; f[1] < first[1] + r; ++f[1]) {
+        for (f[2] = first[2]; f[2] < first[2] + r; ++f[2]) {
+          const struct gravity_tensors *m =
+              s->cells_top[zoom_region_cell_id(zoom, f[0], f[1], f[2])]
+                  .grav.multipole;
+          if (m->m_pole.M_000 == 0.f) continue;
+
+          /* Contribution to multipole */
+          gravity_M2M(&temp, &m->m_pole, multi->CoM, m->CoM);
+          gravity_multipole_add(&multi->m_pole, &temp);
+
+          /* Upper limit of max CoM<->gpart distance */
+          const double dx = multi->CoM[0] - m->CoM[0];
+          const double dy = multi->CoM[1] - m->CoM[1];
+          const double dz = multi->CoM[2] - m->CoM[2];
+          const double r2 = dx * dx + dy * dy + dz * dz;
+          r_max = max(r_max, m->r_max + sqrt(r2));
+        }
+      }
+    }
+
+    /* Alternative upper limit from the geometry of the void cell */
+    double d[3];
+    for (int k = 0; k < 3; ++k)
+      d[k] = multi->CoM[k] > v->loc[k] + v->width[k] * 0.5
+                 ? multi->CoM[k] - v->loc[k]
+                 : v->loc[k] + v->width[k] - multi->CoM[k];
+    multi->r_max = min(r_max, sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]));
+
+    /* Compute the multipole power */
+    gravity_multipole_compute_power(&multi->m_pole);
+  }
+
+  /* Update or restore the values at rebuild time */
+  if (rebuild) {
+    multi->r_max_rebuild = multi->r_max;
+    multi->CoM_rebuild[0] = multi->CoM[0];
+    multi->CoM_rebuild[1] = multi->CoM[1];
+    multi->CoM_rebuild[2] = multi->CoM[2];
+  } else {
+    multi->r_max_rebuild = r_max_rebuild;
+    multi->CoM_rebuild[0] = CoM_rebuild[0];
+    multi->CoM_rebuild[1] = CoM_rebuild[1];
+    multi->CoM_rebuild[2] = CoM_rebuild[2];
+  }
+  multi->ti_make = ti_current;
+
+  v->grav.ti_old_multipole = ti_current;
+}
+
+/**
+ * @brief Construct the multipoles of all the void cells from the ones of
+ * the fine cells of the zoom region.
+ *
+ * This has to be called whenever the multipoles of the top-level cells are
+ * constructed from scratch (i.e. after a rebuild or a reconstruction). In
+ * between, the void cells get drifted like any other top-level cell.
+ *
+ * @param s The #space.
+ * @param rebuild Are we also setting the values at rebuild time?
+ */
+void zoom_region_make_void_multipoles(struct space *s, const int rebuild) {
+
+  const struct zoom_region *zoom = &s->zoom;
+  if (!zoom->enabled || !s->with_self_gravity) return;
+
+  const integertime_t ti_current = (s->e != NULL) ? s->e->ti_current : 0;
+
+  int c[3];
+  for (c[0] = zoom->lo[0]; c[0] < zoom->hi[0]; ++c[0]) {
+    for (c[1] = zoom->lo[1]; c[1] < zoom->hi[1]; ++c[1]) {
+      for (c[2] = zoom->lo[2]; c[2] < zoom->hi[2]; ++c[2]) {
+        const int cid = cell_getid(s->cdim, c[0], c[1], c[2]);
+        int first[3];
+        zoom_region_void_first(zoom, s->cdim, cid, first);
+        zoom_region_make_void_multipole(s, &s->cells_top[cid], first,
+                                        ti_current, rebuild);
+      }
+    }
+  }
+}
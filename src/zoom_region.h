@@ -0,0 +1,225 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_ZOOM_REGION_H
+#define SWIFT_ZOOM_REGION_H
+
+/* Config parameters. */
+#include <config.h>
+
+/* Local headers. */
+#include "inline.h"
+#include "minmax.h"
+
+/* Forward declarations */
+struct space;
+struct swift_params;
+
+/*! Default padding of the high-resolution region */
+#define zoom_region_pad_factor_default 1.2f
+
+/**
+ * @brief The nested top-level grid of a zoom simulation.
+ *
+ * The high-resolution region (the bounding box of all the #gpart that are
+ * not background DM, padded and snapped to the regular top-level grid) is
+ * covered by a finer grid of top-level cells. The cells of the regular
+ * (coarse) grid that overlap with the region are "void" cells: they never
+ * contain any particle and never get any task. Their multipole is the
+ * combination of the ones of the fine cells they contain, such that the rest
+ * of the volume can interact with the region in one go.
+ *
+ * The top-level cells array contains the coarse cells first (indexed as
+ * usual with the space's cdim), followed by the fine cells.
+ */
+struct zoom_region {
+
+  /*! Are we running with a zoom region? */
+  int enabled;
+
+  /*! Padding factor applied to the bounding box of the high-res particles */
+  float pad_factor;
+
+  /*! Requested number of fine cells per coarse cell along each axis (0 for
+   * automatic) */
+  int refinement_param;
+
+  /*! Number of fine cells per coarse cell along each axis */
+  int refinement;
+
+  /*! Range of coarse cell coordinates covered by the region [lo, hi[ */
+  int lo[3], hi[3];
+
+  /*! Number of fine cells along each axis */
+  int cdim[3];
+
+  /*! Bottom-left corner of the region */
+  double loc[3];
+
+  /*! Width of the fine cells */
+  double width[3];
+
+  /*! Inverse of the width of the fine cells */
+  double iwidth[3];
+
+  /*! Number of coarse cells (i.e. index of the first fine cell) */
+  int nr_coarse_cells;
+
+  /*! Number of void coarse cells */
+  int nr_void_cells;
+
+  /*! Number of fine cells */
+  int nr_zoom_cells;
+};
+
+void zoom_region_init(struct zoom_region *zoom, struct swift_params *params,
+                      const struct space *s, const int nr_nodes);
+void zoom_region_construct(struct zoom_region *zoom, const struct space *s,
+                           const int cdim[3], const int verbose);
+void zoom_region_make_void_multipoles(struct space *s, const int rebuild);
+
+/**
+ * @brief Is a top-level cell one of the fine cells of the zoom region?
+ *
+ * @param zoom The #zoom_region.
+ * @param cid The index of the top-level cell.
+ */
+__attribute__((always_inline)) INLINE static int zoom_region_is_zoom_cell(
+    const struct zoom_region *zoom, const int cid) {
+
+  return zoom->enabled && cid >= zoom->nr_coarse_cells;
+}
+
+/**
+ * @brief Returns the coarse grid coordinates of a top-level cell.
+ *
+ * The fine cells get the coordinates of the void cell they are in.
+ *
+ * @param zoom The #zoom_region.
+ * @param cdim The number of coarse top-level cells along each axis.
+ * @param cid The index of the top-level cell.
+ * @param c (return) The coordinates.
+ */
+__attribute__((always_inline)) INLINE static void zoom_region_coarse_coords(
+    const struct zoom_region *zoom, const int cdim[3], const int cid,
+    int c[3]) {
+
+  if (zoom_region_is_zoom_cell(zoom, cid)) {
+    const int id = cid - zoom->nr_coarse_cells;
+    const int r = zoom->refinement;
+    c[0] = zoom->lo[0] + id / (zoom->cdim[1] * zoom->cdim[2]) / r;
+    c[1] = zoom->lo[1] + (id / zoom->cdim[2]) % zoom->cdim[1] / r;
+    c[2] = zoom->lo[2] + id % zoom->cdim[2] / r;
+  } else {
+    c[0] = cid / (cdim[1] * cdim[2]);
+    c[1] = (cid / cdim[2]) % cdim[1];
+    c[2] = cid % cdim[2];
+  }
+}
+
+/**
+ * @brief Is a top-level cell one of the void cells covering the zoom region?
+ *
+ * @param zoom The #zoom_region.
+ * @param cdim The number of coarse top-level cells along each axis.
+ * @param cid The index of the top-level cell.
+ */
+__attribute__((always_inline)) INLINE static int zoom_region_is_void(
+    const struct zoom_region *zoom, const int cdim[3], const int cid) {
+
+  if (!zoom->enabled || cid >= zoom->nr_coarse_cells) return 0;
+
+  int c[3];
+  zoom_region_coarse_coords(zoom, cdim, cid, c);
+  return c[0] >= zoom->lo[0] && c[0] < zoom->hi[0] && c[1] >= zoom->lo[1] &&
+         c[1] < zoom->hi[1] && c[2] >= zoom->lo[2] && c[2] < zoom->hi[2];
+}
+
+/**
+ * @brief Returns the index of a fine cell from its coordinates in the fine
+ * grid.
+ *
+ * @param zoom The #zoom_region.
+ * @param i, j, k The coordinates of the fine cell.
+ */
+__attribute__((always_inline)) INLINE static int zoom_region_cell_id(
+    const struct zoom_region *zoom, const int i, const int j, const int k) {
+
+  return zoom->nr_coarse_cells + k + zoom->cdim[2] * (j + zoom->cdim[1] * i);
+}
+
+/**
+ * @brief Returns the coordinates in the fine grid of the first fine cell of
+ * a void cell.
+ *
+ * The void cell contains the refinement^3 fine cells starting there.
+ *
+ * @param zoom The #zoom_region.
+ * @param cdim The number of coarse top-level cells along each axis.
+ * @param cid The index of the void cell.
+ * @param first (return) The coordinates of the first fine cell.
+ */
+__attribute__((always_inline)) INLINE static void zoom_region_void_first(
+    const struct zoom_region *zoom, const int cdim[3], const int cid,
+    int first[3]) {
+
+  int c[3];
+  zoom_region_coarse_coords(zoom, cdim, cid, c);
+  for (int k = 0; k < 3; ++k)
+    first[k] = (c[k] - zoom->lo[k]) * zoom->refinement;
+}
+
+/**
+ * @brief Returns the index of the top-level cell containing a position.
+ *
+ * Without zoom region, this is the usual index in the regular grid.
+ *
+ * @param zoom The #zoom_region.
+ * @param cdim The number of coarse top-level cells along each axis.
+ * @param iwidth The inverse of the width of the coarse top-level cells.
+ * @param pos_x, pos_y, pos_z The position (within the box).
+ */
+__attribute__((always_inline)) INLINE static int zoom_region_get_cell_index(
+    const struct zoom_region *zoom, const int cdim[3], const double iwidth[3],
+    const double pos_x, const double pos_y, const double pos_z) {
+
+  const int i = (int)(pos_x * iwidth[0]);
+  const int j = (int)(pos_y * iwidth[1]);
+  const int k = (int)(pos_z * iwidth[2]);
+
+  if (zoom->enabled && i >= zoom->lo[0] && i < zoom->hi[0] &&
+      j >= zoom->lo[1] && j < zoom->hi[1] && k >= zoom->lo[2] &&
+      k < zoom->hi[2]) {
+
+    /* Position in the fine grid (guarding against round-off at the edges) */
+    int fi = (int)((pos_x - zoom->loc[0]) * zoom->iwidth[0]);
+    int fj = (int)((pos_y - zoom->loc[1]) * zoom->iwidth[1]);
+    int fk = (int)((pos_z - zoom->loc[2]) * zoom->iwidth[2]);
+    fi = max(fi, 0);
+    fj = max(fj, 0);
+    fk = max(fk, 0);
+    fi = min(fi, zoom->cdim[0] - 1);
+    fj = min(fj, zoom->cdim[1] - 1);
+    fk = min(fk, zoom->cdim[2] - 1);
+
+    return zoom_region_cell_id(zoom, fi, fj, fk);
+  }
+
+  return k + cdim[2] * (j + cdim[1] * i);
+}
+
+#endif /* SWIFT_ZOOM_REGION_H */
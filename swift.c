@@ -872,6 +872,9 @@ int main(int argc, char *argv[]) {
   parser_get_opt_param_string(params, "Restarts:subdir", restart_dir,
                               "restart");
 
+  /* The FFTW wisdom is stored along with the restart files */
+  fft_plans_set_wisdom_file(restart_dir);
+
   /* The directory must exist. */
   if (myrank == 0) {
     if (access(restart_dir, W_OK | X_OK) != 0) {
@@ -1551,7 +1554,13 @@ int main(int argc, char *argv[]) {
 
 /* Initialise the table of Ewald corrections for the gravity checks */
 #ifdef SWIFT_GRAVITY_FORCE_CHECKS
-  if (s.periodic) gravity_exact_force_ewald_init(e.s->dim[0]);
+  if (s.periodic) {
+    char ewald_file_name[PARSER_MAX_LINE_SIZE];
+    parser_get_opt_param_string(params, "ForceChecks:ewald_table_file",
+                                ewald_file_name, "Ewald.hdf5");
+    gravity_exact_force_ewald_init(e.s->dim[0], ewald_file_name,
+                                   &e.threadpool);
+  }
 #endif
 
   if (!restart) {
@@ -0,0 +1,767 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#include <config.h>
+
+/* Some standard headers. */
+#include <fenv.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Local headers. */
+#include "runner_doiact_grav.h"
+#include "swift.h"
+
+/*
+ * Benchmark of the individual gravity kernels.
+ *
+ * Two neighbouring leaf cells are filled with particles drawn from one of a
+ * few standard configurations and every kernel (P-P pair and self, M2P, M2L,
+ * P2M, M2M and L2P) is timed separately. Each kernel is repeated, doubling
+ * the number of repetitions, until it has run for at least the requested
+ * time. The results are written as interactions per second in a JSON file
+ * so that they can be compared across commits, compilers and architectures.
+ *
+ * Usage: benchmarkGravityKernels [-n particles per cell] [-t min. time (s)]
+ *                                [-s seed] [-c configuration] [-o file.json]
+ */
+
+/*! Time stamp on the time-line at which everything is active */
+#define BENCH_TI_CURRENT 8
+
+/*! Number of distinct multipoles cycled through by the M2L/M2M kernels */
+#define BENCH_NUM_TENSORS 1024
+
+/*! Maximal number of results we can record */
+#define BENCH_MAX_RESULTS 64
+
+/**
+ * @brief The particle configurations we can benchmark.
+ */
+enum bench_config {
+  bench_config_uniform = 0,
+  bench_config_nfw,
+  bench_config_zoom,
+  bench_config_count
+};
+
+static const char *bench_config_names[bench_config_count] = {"uniform", "nfw",
+                                                             "zoom"};
+
+/**
+ * @brief Everything a kernel needs to run.
+ */
+struct bench_data {
+
+  /*! The runner (and through it the engine) */
+  struct runner *r;
+
+  /*! The two cells */
+  struct cell *ci, *cj;
+
+  /*! The gravity properties */
+  const struct gravity_props *props;
+
+  /*! Perturbed copies of the two cells' multipoles */
+  struct gravity_tensors *tensors_i, *tensors_j;
+
+  /*! Output of the M2M kernel */
+  struct multipole *m_out;
+
+  /*! Box size used for the periodic kernels */
+  double dim[3];
+
+  /*! Inverse of the mesh smoothing scale */
+  float r_s_inv;
+
+  /*! Run the periodic version of the kernel? */
+  int periodic;
+
+  /*! Sink for the results to prevent the compiler optimising them away */
+  double sink;
+};
+
+/**
+ * @brief A kernel to benchmark.
+ *
+ * Runs the kernel runs times and returns the number of interactions done.
+ */
+typedef long long (*bench_kernel_func)(struct bench_data *d, const int runs);
+
+/**
+ * @brief The timing of one kernel on one configuration.
+ */
+struct bench_result {
+  const char *kernel;
+  const char *config;
+  int periodic;
+  int runs;
+  long long interactions;
+  double time;
+};
+
+/**
+ * @brief Draws the radius (in units of the scale radius) of a particle in an
+ * NFW halo of concentration c truncated at the virial radius.
+ */
+static double sample_nfw_radius(const double c) {
+
+  const double m_c = log(1. + c) - c / (1. + c);
+  const double target = m_c * (rand() / ((double)RAND_MAX));
+
+  /* Invert the enclosed mass profile by bisection */
+  double x_min = 0., x_max = c;
+  for (int k = 0; k < 50; ++k) {
+    const double x = 0.5 * (x_min + x_max);
+    const double m = log(1. + x) - x / (1. + x);
+    if (m < target)
+      x_min = x;
+    else
+      x_max = x;
+  }
+  return 0.5 * (x_min + x_max);
+}
+
+/**
+ * @brief Draws a random isotropic direction.
+ */
+static void sample_direction(double dir[3]) {
+
+  const double cos_theta = 2. * rand() / ((double)RAND_MAX) - 1.;
+  const double sin_theta = sqrt(1. - cos_theta * cos_theta);
+  const double phi = 2. * M_PI * rand() / ((double)RAND_MAX);
+  dir[0] = sin_theta * cos(phi);
+  dir[1] = sin_theta * sin(phi);
+  dir[2] = cos_theta;
+}
+
+/**
+ * @brief Constructs a leaf cell filled with particles.
+ *
+ * - uniform: N particles of equal mass uniformly distributed in the cell.
+ * - nfw: an NFW halo of concentration 10 with its virial radius touching the
+ *   cell faces.
+ * - zoom: 7/8 of the particles in a high-resolution region 1/64 of the cell
+ *   wide at its centre, embedded in a uniform low-resolution background whose
+ *   particles are 512 times more massive and 8 times more softened.
+ *
+ * @param c The #cell to construct.
+ * @param N The number of particles.
+ * @param loc The bottom-left corner of the cell.
+ * @param width The cell width.
+ * @param config The particle configuration to use.
+ * @param id_base The ID of the first particle.
+ * @param props The #gravity_props.
+ */
+static void make_cell(struct cell *c, const int N, const double loc[3],
+                      const double width, const enum bench_config config,
+                      const int id_base, const struct gravity_props *props) {
+
+  bzero(c, sizeof(struct cell));
+
+  /* Start by setting the basics */
+  c->nodeID = 0;
+  for (int k = 0; k < 3; ++k) {
+    c->loc[k] = loc[k];
+    c->width[k] = width;
+  }
+
+  /* Initialise the locks */
+  lock_init(&c->grav.plock);
+  lock_init(&c->grav.mlock);
+
+  /* Set the time bins: everything is active and drifted */
+  c->grav.ti_end_min = BENCH_TI_CURRENT;
+  c->grav.ti_beg_max = BENCH_TI_CURRENT;
+  c->grav.ti_old_part = BENCH_TI_CURRENT;
+  c->grav.ti_old_multipole = BENCH_TI_CURRENT;
+
+  /* Create the particles */
+  c->grav.count = N;
+  c->grav.count_total = N;
+  if (posix_memalign((void **)&c->grav.parts, gpart_align,
+                     N * sizeof(struct gpart)) != 0)
+    error("couldn't allocate particles, no. of particles: %d", N);
+  bzero(c->grav.parts, N * sizeof(struct gpart));
+
+  const double centre[3] = {loc[0] + 0.5 * width, loc[1] + 0.5 * width,
+                            loc[2] + 0.5 * width};
+  const float eps = props->epsilon_DM_cur;
+
+  for (int i = 0; i < N; ++i) {
+
+    struct gpart *gp = &c->grav.parts[i];
+    double x[3];
+    float mass = 1.f, epsilon = eps;
+
+    switch (config) {
+      case bench_config_uniform:
+        for (int k = 0; k < 3; ++k)
+          x[k] = loc[k] + width * rand() / ((double)RAND_MAX);
+        break;
+
+      case bench_config_nfw: {
+        const double conc = 10.;
+        const double r = sample_nfw_radius(conc) * 0.5 * width / conc;
+        double dir[3];
+        sample_direction(dir);
+        for (int k = 0; k < 3; ++k) x[k] = centre[k] + r * dir[k];
+      } break;
+
+      case bench_config_zoom: {
+        const int high_res = (i % 8) != 0;
+        const double w = high_res ? width / 64. : width;
+        for (int k = 0; k < 3; ++k)
+          x[k] = centre[k] + w * (rand() / ((double)RAND_MAX) - 0.5);
+        if (!high_res) {
+          mass = 512.f;
+          epsilon = 8.f * eps;
+        }
+      } break;
+
+      default:
+        error("Invalid configuration");
+    }
+
+    gp->id_or_neg_offset = id_base + i;
+    gp->x[0] = x[0];
+    gp->x[1] = x[1];
+    gp->x[2] = x[2];
+    gp->mass = mass;
+    gp->type = swift_type_dark_matter;
+    gp->time_bin = 1;
+#ifdef MULTI_SOFTENING_GRAVITY
+    gp->epsilon = epsilon;
+#else
+    (void)epsilon;
+#endif
+#ifdef SWIFT_DEBUG_CHECKS
+    gp->ti_drift = BENCH_TI_CURRENT;
+    gp->initialised = 1;
+#endif
+  }
+
+  /* Create the multipole */
+  c->grav.multipole =
+      (struct gravity_tensors *)malloc(sizeof(struct gravity_tensors));
+  if (c->grav.multipole == NULL) error("Error allocating multipole");
+  gravity_reset(c->grav.multipole);
+  gravity_P2M(c->grav.multipole, c->grav.parts, N, props);
+  gravity_multipole_compute_power(&c->grav.multipole->m_pole);
+}
+
+/**
+ * @brief Frees the memory allocated by make_cell().
+ */
+static void clean_cell(struct cell *c) {
+
+  free(c->grav.parts);
+  free(c->grav.multipole);
+}
+
+/**
+ * @brief P-P interactions between the two cells (both directions).
+ */
+static long long bench_pair_pp(struct bench_data *d, const int runs) {
+
+  for (int n = 0; n < runs; ++n)
+    runner_dopair_grav_pp(d->r, d->ci, d->cj, /*symmetric=*/1,
+                          /*allow_mpole=*/0);
+
+  return 2ll * runs * d->ci->grav.count * d->cj->grav.count;
+}
+
+/**
+ * @brief P-P interactions within one cell.
+ */
+static long long bench_self_pp(struct bench_data *d, const int runs) {
+
+  for (int n = 0; n < runs; ++n) runner_doself_grav_pp(d->r, d->ci);
+
+  const long long count = d->ci->grav.count;
+  return runs * count * (count - 1);
+}
+
+/**
+ * @brief M2P interactions of the particles of one cell with the multipoles.
+ */
+static long long bench_m2p(struct bench_data *d, const int runs) {
+
+  const struct cell *ci = d->ci;
+  const int gcount = ci->grav.count;
+
+  for (int n = 0; n < runs; ++n) {
+
+    const struct gravity_tensors *m = &d->tensors_j[n % BENCH_NUM_TENSORS];
+
+    for (int i = 0; i < gcount; ++i) {
+
+      struct gpart *gp = &ci->grav.parts[i];
+
+      const float r_x = m->CoM[0] - gp->x[0];
+      const float r_y = m->CoM[1] - gp->x[1];
+      const float r_z = m->CoM[2] - gp->x[2];
+      const float r2 = r_x * r_x + r_y * r_y + r_z * r_z;
+      const float eps = gravity_get_softening(gp, d->props);
+
+      struct reduced_grav_tensor l = {0.f, 0.f, 0.f, 0.f};
+      gravity_M2P(&m->m_pole, r_x, r_y, r_z, r2, eps, d->periodic, d->r_s_inv,
+                  &l);
+
+      gp->a_grav[0] += l.F_100;
+      gp->a_grav[1] += l.F_010;
+      gp->a_grav[2] += l.F_001;
+    }
+  }
+
+  return (long long)runs * gcount;
+}
+
+/**
+ * @brief M2L interactions between pairs of multipoles.
+ */
+static long long bench_m2l(struct bench_data *d, const int runs) {
+
+  for (int n = 0; n < runs; ++n) {
+    for (int k = 0; k < BENCH_NUM_TENSORS; ++k) {
+
+      struct gravity_tensors *ti = &d->tensors_i[k];
+      const struct gravity_tensors *tj = &d->tensors_j[k];
+
+      gravity_M2L_nonsym(&ti->pot, &tj->m_pole, ti->CoM, tj->CoM, d->props,
+                         d->periodic, d->dim, d->r_s_inv);
+    }
+  }
+
+  return (long long)runs * BENCH_NUM_TENSORS;
+}
+
+/**
+ * @brief Construction of a multipole from the particles of one cell.
+ */
+static long long bench_p2m(struct bench_data *d, const int runs) {
+
+  const struct cell *ci = d->ci;
+  struct gravity_tensors m;
+
+  for (int n = 0; n < runs; ++n) {
+    gravity_reset(&m);
+    gravity_P2M(&m, ci->grav.parts, ci->grav.count, d->props);
+    d->sink += m.m_pole.M_000 + m.CoM[0];
+  }
+
+  return (long long)runs * ci->grav.count;
+}
+
+/**
+ * @brief Shifts of multipoles to a parent's centre of mass.
+ */
+static long long bench_m2m(struct bench_data *d, const int runs) {
+
+  for (int n = 0; n < runs; ++n) {
+    for (int k = 0; k < BENCH_NUM_TENSORS; ++k) {
+
+      const struct gravity_tensors *child = &d->tensors_j[k];
+      const struct gravity_tensors *parent = &d->tensors_i[k];
+
+      gravity_M2M(&d->m_out[k], &child->m_pole, parent->CoM, child->CoM);
+    }
+  }
+
+  return (long long)runs * BENCH_NUM_TENSORS;
+}
+
+/**
+ * @brief Evaluation of a field tensor at the particles of one cell.
+ */
+static long long bench_l2p(struct bench_data *d, const int runs) {
+
+  const struct cell *ci = d->ci;
+  const int gcount = ci->grav.count;
+
+  for (int n = 0; n < runs; ++n) {
+
+    const struct gravity_tensors *t = &d->tensors_i[n % BENCH_NUM_TENSORS];
+
+    for (int i = 0; i < gcount; ++i)
+      gravity_L2P(&t->pot, t->CoM, &ci->grav.parts[i]);
+  }
+
+  return (long long)runs * gcount;
+}
+
+/**
+ * @brief Times a kernel, doubling the number of repetitions until it ran for
+ * at least min_time seconds.
+ *
+ * @param func The kernel to time.
+ * @param d The #bench_data to run it on.
+ * @param min_time The minimal time (in seconds) to run for.
+ * @param res (return) The timing.
+ */
+static void bench_time_kernel(bench_kernel_func func, struct bench_data *d,
+                              const double min_time,
+                              struct bench_result *res) {
+
+  /* Warm the caches up */
+  func(d, 1);
+
+  int runs = 1;
+  while (1) {
+
+    const ticks tic = getticks();
+    const long long interactions = func(d, runs);
+    const ticks toc = getticks();
+    const double time = clocks_diff_ticks(toc, tic) / 1000.;
+
+    if (time >= min_time || runs >= (1 << 28)) {
+      res->runs = runs;
+      res->interactions = interactions;
+      res->time = time;
+      return;
+    }
+
+    /* Aim straight for the target if we are far from it */
+    if (time > 0. && time < 0.1 * min_time)
+      runs = (int)min(2. * runs * min_time / time, (double)(1 << 28));
+    else
+      runs *= 2;
+  }
+}
+
+/**
+ * @brief Writes a string to a JSON file, escaping what needs to be.
+ */
+static void json_write_string(FILE *file, const char *str) {
+
+  fputc('"', file);
+  for (const char *c = str; *c != '\0'; ++c) {
+    if (*c == '"' || *c == '\\')
+      fprintf(file, "\\%c", *c);
+    else if ((unsigned char)*c < 0x20)
+      fprintf(file, "\\u%04x", (unsigned char)*c);
+    else
+      fputc(*c, file);
+  }
+  fputc('"', file);
+}
+
+/**
+ * @brief Writes the results and the build information to a JSON file.
+ */
+static void json_write(const char *file_name, const struct bench_result *res,
+                       const int num_results, const int N, const int seed,
+                       const double min_time) {
+
+  FILE *file = fopen(file_name, "w");
+  if (file == NULL) error("Could not open file '%s'.", file_name);
+
+  fprintf(file, "{\n");
+  fprintf(file, "  \"benchmark\": \"gravity_kernels\",\n");
+  fprintf(file, "  \"git_revision\": ");
+  json_write_string(file, git_revision());
+  fprintf(file, ",\n  \"git_branch\": ");
+  json_write_string(file, git_branch());
+  fprintf(file, ",\n  \"compiler\": ");
+  json_write_string(file, compiler_name());
+  fprintf(file, ",\n  \"compiler_version\": ");
+  json_write_string(file, compiler_version());
+  fprintf(file, ",\n  \"cflags\": ");
+  json_write_string(file, compilation_cflags());
+  fprintf(file, ",\n  \"configuration_options\": ");
+  json_write_string(file, configuration_options());
+  fprintf(file, ",\n  \"hostname\": ");
+  json_write_string(file, hostname());
+  fprintf(file, ",\n  \"multipole_order\": %d,\n",
+          SELF_GRAVITY_MULTIPOLE_ORDER);
+#ifdef SWIFT_MULTIPOLE_SPHERICAL
+  fprintf(file, "  \"multipole_basis\": \"spherical\",\n");
+#else
+  fprintf(file, "  \"multipole_basis\": \"cartesian\",\n");
+#endif
+#ifdef WITH_VECTORIZATION
+  fprintf(file, "  \"vectorization\": true,\n");
+#else
+  fprintf(file, "  \"vectorization\": false,\n");
+#endif
+  fprintf(file, "  \"vec_size\": %d,\n", VEC_SIZE);
+  fprintf(file, "  \"particles_per_cell\": %d,\n", N);
+  fprintf(file, "  \"seed\": %d,\n", seed);
+  fprintf(file, "  \"min_time_s\": %g,\n", min_time);
+  fprintf(file, "  \"results\": [\n");
+
+  for (int k = 0; k < num_results; ++k) {
+    const struct bench_result *r = &res[k];
+    fprintf(file,
+            "    {\"configuration\": \"%s\", \"kernel\": \"%s\", "
+            "\"periodic\": %s, \"runs\": %d, \"interactions\": %lld, "
+            "\"time_s\": %.6e, \"interactions_per_second\": %.6e}%s\n",
+            r->config, r->kernel, r->periodic ? "true" : "false", r->runs,
+            r->interactions, r->time, r->interactions / r->time,
+            k < num_results - 1 ? "," : "");
+  }
+
+  fprintf(file, "  ]\n}\n");
+  fclose(file);
+}
+
+int main(int argc, char *argv[]) {
+
+  /* Initialize CPU frequency, this also starts time. */
+  unsigned long long cpufreq = 0;
+  clocks_set_cpufreq(cpufreq);
+
+  /* Choke on FPEs */
+#ifdef HAVE_FE_ENABLE_EXCEPT
+  feenableexcept(FE_DIVBYZERO | FE_INVALID | FE_OVERFLOW);
+#endif
+
+  /* Default parameters */
+  int N = 512;
+  double min_time = 0.2;
+  int seed = 42;
+  int only_config = -1;
+  char file_name[200] = "benchmark_gravity_kernels.json";
+
+  /* Get the command line options */
+  int c;
+  while ((c = getopt(argc, argv, "n:t:s:c:o:h")) != -1) {
+    switch (c) {
+      case 'n':
+        N = atoi(optarg);
+        break;
+      case 't':
+        min_time = atof(optarg);
+        break;
+      case 's':
+        seed = atoi(optarg);
+        break;
+      case 'c':
+        only_config = -2;
+        for (int k = 0; k < bench_config_count; ++k)
+          if (strcmp(optarg, bench_config_names[k]) == 0) only_config = k;
+        if (only_config == -2) error("Unknown configuration '%s'", optarg);
+        break;
+      case 'o':
+        if (strlen(optarg) >= sizeof(file_name))
+          error("Output file name too long");
+        strcpy(file_name, optarg);
+        break;
+      case 'h':
+      case '?':
+        printf(
+            "Usage: %s [-n particles per cell] [-t min. time per kernel (s)]"
+            " [-s seed] [-c uniform|nfw|zoom] [-o output.json]\n",
+            argv[0]);
+        return c == 'h' ? 0 : 1;
+      default:
+        abort();
+    }
+  }
+  if (N < 2) error("Need at least 2 particles per cell");
+  if (min_time <= 0.) error("The minimal time must be positive");
+
+  message("Benchmarking the gravity kernels at order %d with %d particles "
+          "per cell.",
+          SELF_GRAVITY_MULTIPOLE_ORDER, N);
+  srand(seed);
+
+  /* Construct gravity properties */
+  struct gravity_props grav_props;
+  bzero(&grav_props, sizeof(struct gravity_props));
+  grav_props.use_advanced_MAC = 1;
+  grav_props.use_adaptive_tolerance = 1;
+  grav_props.adaptive_tolerance = 1e-4;
+  grav_props.theta_crit = 0.5;
+  grav_props.G_Newton = 1.;
+  grav_props.mesh_size = 64;
+  grav_props.a_smooth = 1.25;
+  grav_props.epsilon_DM_cur = 1e-3;
+  grav_props.epsilon_baryon_cur = 1e-3;
+
+  /* Space properties: the cells are well inside the box */
+  const double dim[3] = {100., 100., 100.};
+  const double r_s = grav_props.a_smooth * dim[0] / grav_props.mesh_size;
+
+  /* The non-periodic mesh structure used by the P-P kernels */
+  struct pm_mesh mesh;
+  bzero(&mesh, sizeof(struct pm_mesh));
+  mesh.periodic = 0;
+  mesh.dim[0] = dim[0];
+  mesh.dim[1] = dim[1];
+  mesh.dim[2] = dim[2];
+  mesh.r_s = FLT_MAX;
+  mesh.r_s_inv = 0.;
+  mesh.r_cut_min = 0.;
+  mesh.r_cut_max = FLT_MAX;
+
+  struct space s;
+  bzero(&s, sizeof(struct space));
+  s.periodic = 0;
+  s.dim[0] = dim[0];
+  s.dim[1] = dim[1];
+  s.dim[2] = dim[2];
+
+  /* Construct an engine */
+  struct engine e;
+  bzero(&e, sizeof(struct engine));
+  e.s = &s;
+  e.mesh = &mesh;
+  e.nodeID = 0;
+  e.max_active_bin = num_time_bins;
+  e.time = 0.1f;
+  e.ti_current = BENCH_TI_CURRENT;
+  e.time_base = 1e-10;
+  e.gravity_properties = &grav_props;
+  e.gravity_mirror_pool = NULL;
+
+  /* Construct a runner */
+  struct runner r;
+  bzero(&r, sizeof(struct runner));
+  r.e = &e;
+
+  /* Init the cache for gravity interaction */
+  gravity_cache_init(&r.ci_gravity_cache, N);
+  gravity_cache_init(&r.cj_gravity_cache, N);
+
+  /* Arrays of perturbed multipoles to prevent too much optimization */
+  struct gravity_tensors *tensors_i = NULL, *tensors_j = NULL;
+  if (posix_memalign((void **)&tensors_i, SWIFT_CACHE_ALIGNMENT,
+                     BENCH_NUM_TENSORS * sizeof(struct gravity_tensors)) != 0)
+    error("Error allocating memory for multipoles array.");
+  if (posix_memalign((void **)&tensors_j, SWIFT_CACHE_ALIGNMENT,
+                     BENCH_NUM_TENSORS * sizeof(struct gravity_tensors)) != 0)
+    error("Error allocating memory for multipoles array.");
+  struct multipole *m_out = NULL;
+  if (posix_memalign((void **)&m_out, SWIFT_CACHE_ALIGNMENT,
+                     BENCH_NUM_TENSORS * sizeof(struct multipole)) != 0)
+    error("Error allocating memory for multipoles array.");
+
+  struct bench_result results[BENCH_MAX_RESULTS];
+  int num_results = 0;
+  double sink = 0.;
+
+  /* The kernels to run */
+  struct {
+    const char *name;
+    bench_kernel_func func;
+    int periodic;
+  } kernels[] = {
+    {"pair_pp", bench_pair_pp, 0},
+    {"self_pp", bench_self_pp, 0},
+    {"M2P", bench_m2p, 0},
+#ifndef SWIFT_MULTIPOLE_SPHERICAL
+    {"M2P", bench_m2p, 1},
+#endif
+    {"M2L", bench_m2l, 0},
+#ifndef SWIFT_MULTIPOLE_SPHERICAL
+    {"M2L", bench_m2l, 1},
+#endif
+    {"P2M", bench_p2m, 0},
+    {"M2M", bench_m2m, 0},
+    {"L2P", bench_l2p, 0},
+  };
+  const int num_kernels = sizeof(kernels) / sizeof(kernels[0]);
+
+  for (int config = 0; config < bench_config_count; ++config) {
+
+    if (only_config >= 0 && config != only_config) continue;
+
+    /* Construct two neighbouring cells */
+    struct cell ci, cj;
+    const double width = 1.;
+    const double loc_i[3] = {10., 10., 10.};
+    const double loc_j[3] = {11., 10., 10.};
+    make_cell(&ci, N, loc_i, width, (enum bench_config)config, 0,
+              &grav_props);
+    make_cell(&cj, N, loc_j, width, (enum bench_config)config, N,
+              &grav_props);
+
+    /* Perturbed copies of their multipoles, with the field tensors of
+     * ci's copies populated by one M2L so that L2P has something to do */
+    for (int n = 0; n < BENCH_NUM_TENSORS; ++n) {
+
+      memcpy(&tensors_i[n], ci.grav.multipole, sizeof(struct gravity_tensors));
+      memcpy(&tensors_j[n], cj.grav.multipole, sizeof(struct gravity_tensors));
+
+      for (int k = 0; k < 3; ++k) {
+        tensors_i[n].CoM[k] += 0.1 * (rand() / ((double)RAND_MAX) - 0.5);
+        tensors_j[n].CoM[k] += 0.1 * (rand() / ((double)RAND_MAX) - 0.5);
+      }
+      tensors_i[n].m_pole.M_000 *= 1. + 0.01 * rand() / ((double)RAND_MAX);
+      tensors_j[n].m_pole.M_000 *= 1. + 0.01 * rand() / ((double)RAND_MAX);
+
+      gravity_field_tensors_init(&tensors_i[n].pot, e.ti_current);
+      gravity_M2L_nonsym(&tensors_i[n].pot, &tensors_j[n].m_pole,
+                         tensors_i[n].CoM, tensors_j[n].CoM, &grav_props,
+                         /*periodic=*/0, dim, 1. / r_s);
+    }
+
+    struct bench_data d;
+    bzero(&d, sizeof(struct bench_data));
+    d.r = &r;
+    d.ci = &ci;
+    d.cj = &cj;
+    d.props = &grav_props;
+    d.tensors_i = tensors_i;
+    d.tensors_j = tensors_j;
+    d.m_out = m_out;
+    d.dim[0] = dim[0];
+    d.dim[1] = dim[1];
+    d.dim[2] = dim[2];
+    d.r_s_inv = 1. / r_s;
+
+    for (int k = 0; k < num_kernels; ++k) {
+
+      if (num_results == BENCH_MAX_RESULTS) error("Too many results");
+      struct bench_result *res = &results[num_results++];
+
+      d.periodic = kernels[k].periodic;
+      res->kernel = kernels[k].name;
+      res->config = bench_config_names[config];
+      res->periodic = kernels[k].periodic;
+      bench_time_kernel(kernels[k].func, &d, min_time, res);
+
+      message("%8s %-8s %-10s: %.3e interactions/s (%d runs)", res->config,
+              res->kernel, res->periodic ? "(periodic)" : "",
+              res->interactions / res->time, res->runs);
+    }
+
+    /* Keep the results alive */
+    sink += d.sink;
+    for (int i = 0; i < N; ++i) sink += ci.grav.parts[i].a_grav[0];
+    for (int n = 0; n < BENCH_NUM_TENSORS; ++n) sink += m_out[n].M_000;
+
+    clean_cell(&ci);
+    clean_cell(&cj);
+  }
+
+  json_write(file_name, results, num_results, N, seed, min_time);
+  message("Results written to '%s' (checksum %e).", file_name, sink);
+
+  /* Be clean... */
+  gravity_cache_clean(&r.ci_gravity_cache);
+  gravity_cache_clean(&r.cj_gravity_cache);
+  free(tensors_i);
+  free(tensors_j);
+  free(m_out);
+
+  return 0;
+}
@@ -20,12 +20,23 @@
 /* Some standard headers. */
 #include <config.h>
 
+/* Some standard headers. */
+#include <unistd.h>
+
 /* Includes. */
 #include "swift.h"
 
 #define N_CHECK 20
 #define TOLERANCE 1e-7
 
+/* Modified-gravity table checks */
+#define MG_TABLE_ROWS 5000
+#define MG_TABLE_NUM_CHECK 100000
+#define MG_TABLE_NUM_BENCH_SCAN 10000
+#define MG_TABLE_NUM_BENCH 10000000
+#define MG_TABLE_TOLERANCE_LINEAR 1e-5
+#define MG_TABLE_TOLERANCE_CUBIC 1e-8
+
 void test_params_init(struct swift_params *params) {
   parser_init("", params);
   parser_set_param(params, "Cosmology:Omega_cdm:0.2589");
@@ -34,10 +45,235 @@ void test_params_init(struct swift_params *params) {
   parser_set_param(params, "Cosmology:h:0.6774");
   parser_set_param(params, "Cosmology:a_begin:0.1");
   parser_set_param(params, "Cosmology:a_end:1.0");
+  parser_set_param(params, "Cosmology:cosmology_type:fR");
+  parser_set_param(params,
+                   "Cosmology:cosmology_tables_dir:../cosmology_tables/");
+  parser_set_param(params, "Cosmology:MG_tables_cache:0");
+}
+
+/**
+ * @brief Analytic E(a) used to generate the test table.
+ */
+double test_E(const double a) { return sqrt(0.3 / (a * a * a) + 0.7); }
+
+/**
+ * @brief Reference look-up doing a linear search through the raw rows.
+ */
+double test_E_scan(const double a, const double *xs, const double *ys,
+                   const int count) {
+
+  if (a < xs[0]) return ys[0];
+  if (a > xs[count - 1]) return ys[count - 1];
+
+  int i;
+  for (i = 0; i < count - 1; i++)
+    if (xs[i + 1] > a) break;
+
+  return ys[i] + (a - xs[i]) * (ys[i + 1] - ys[i]) / (xs[i + 1] - xs[i]);
+}
+
+/**
+ * @brief Check the accuracy of the #mg_table look-ups and time them against
+ * a linear search through the raw table.
+ */
+void test_mg_table(void) {
+
+  const double a_min = 1e-3;
+  const double a_max = 1.1;
+  const double log_a_range = log(a_max / a_min);
+
+  double *xs = (double *)malloc(MG_TABLE_ROWS * sizeof(double));
+  double *ys = (double *)malloc(MG_TABLE_ROWS * sizeof(double));
+
+  /* Write a raw table with fewer rows than the production ones */
+  const char *filename = "testCosmology_mg_table.txt";
+  FILE *file = fopen(filename, "w");
+  if (file == NULL) error("Could not create '%s'", filename);
+  fprintf(file, "# a E(a)\n");
+  for (int i = 0; i < MG_TABLE_ROWS; i++) {
+    xs[i] = a_min * exp(log_a_range * i / (MG_TABLE_ROWS - 1.));
+    ys[i] = test_E(xs[i]);
+    fprintf(file, "%.17e %.17e\n", xs[i], ys[i]);
+  }
+  fclose(file);
+
+  struct mg_table table_linear, table_cubic;
+  mg_table_init_from_file(&table_linear, filename, 0,
+                          mg_table_interpolation_linear);
+  mg_table_init_from_file(&table_cubic, filename, 0,
+                          mg_table_interpolation_cubic);
+  unlink(filename);
+
+  /* Only the rows actually present must have been used */
+  assert(table_linear.nr_rows == MG_TABLE_ROWS);
+  assert(table_linear.size == MG_TABLE_ROWS);
+
+  /* Values outside the range are clamped */
+  assert(mg_table_interp(&table_linear, 0.5 * a_min) == ys[0]);
+  assert(mg_table_interp(&table_cubic, 2. * a_max) == ys[MG_TABLE_ROWS - 1]);
+
+  double max_err_linear = 0., max_err_cubic = 0., max_diff_scan = 0.;
+  for (int i = 0; i < MG_TABLE_NUM_CHECK; i++) {
+    const double a = a_min * exp(log_a_range * (i + 0.5) / MG_TABLE_NUM_CHECK);
+    const double E_true = test_E(a);
+
+    const double err_linear =
+        fabs(mg_table_interp(&table_linear, a) / E_true - 1.);
+    const double err_cubic =
+        fabs(mg_table_interp(&table_cubic, a) / E_true - 1.);
+    max_err_linear = max(max_err_linear, err_linear);
+    max_err_cubic = max(max_err_cubic, err_cubic);
+
+    if (i % 100 == 0) {
+      const double diff_scan =
+          fabs(mg_table_interp(&table_linear, a) /
+                   test_E_scan(a, xs, ys, MG_TABLE_ROWS) -
+               1.);
+      max_diff_scan = max(max_diff_scan, diff_scan);
+    }
+  }
+
+  message("Max relative error of linear table look-up: %e", max_err_linear);
+  message("Max relative error of cubic table look-up: %e", max_err_cubic);
+  message("Max relative difference with raw table search: %e", max_diff_scan);
+  assert(max_err_linear < MG_TABLE_TOLERANCE_LINEAR);
+  assert(max_err_cubic < MG_TABLE_TOLERANCE_CUBIC);
+  assert(max_diff_scan < MG_TABLE_TOLERANCE_LINEAR);
+
+  /* Micro-benchmark of the different look-ups */
+  double sum = 0.;
+  ticks tic = getticks();
+  for (int i = 0; i < MG_TABLE_NUM_BENCH_SCAN; i++) {
+    const double a = a_min * exp(log_a_range * i / MG_TABLE_NUM_BENCH_SCAN);
+    sum += test_E_scan(a, xs, ys, MG_TABLE_ROWS);
+  }
+  const double time_scan =
+      clocks_from_ticks(getticks() - tic) / MG_TABLE_NUM_BENCH_SCAN;
+
+  tic = getticks();
+  for (int i = 0; i < MG_TABLE_NUM_BENCH; i++) {
+    const double a = a_min * exp(log_a_range * i / MG_TABLE_NUM_BENCH);
+    sum += mg_table_interp(&table_linear, a);
+  }
+  const double time_linear =
+      clocks_from_ticks(getticks() - tic) / MG_TABLE_NUM_BENCH;
+
+  tic = getticks();
+  for (int i = 0; i < MG_TABLE_NUM_BENCH; i++) {
+    const double a = a_min * exp(log_a_range * i / MG_TABLE_NUM_BENCH);
+    sum += mg_table_interp(&table_cubic, a);
+  }
+  const double time_cubic =
+      clocks_from_ticks(getticks() - tic) / MG_TABLE_NUM_BENCH;
+
+  message("Raw table search: %.3f ns per look-up (%d rows)", 1e6 * time_scan,
+          MG_TABLE_ROWS);
+  message("Linear table look-up: %.3f ns per look-up", 1e6 * time_linear);
+  message("Cubic table look-up: %.3f ns per look-up", 1e6 * time_cubic);
+  message("(checksum: %e)", sum);
+
+  /* Round-trip through a binary cache file */
+  const char *cache_name = "testCosmology_mg_table.bin";
+  double key[3] = {1., 2., 3.};
+  const double *arrays[2] = {table_cubic.y, table_cubic.d2y};
+  const size_t lengths[2] = {(size_t)table_cubic.size,
+                             (size_t)table_cubic.size};
+  assert(table_cache_write(cache_name, key, 3, 2, lengths, arrays));
+
+  struct table_cache_file f;
+  assert(table_cache_open(&f, cache_name, key, 3, 2));
+  for (int i = 0; i < 2; i++) {
+    size_t length;
+    const double *data = table_cache_get_array(&f, i, &length);
+    assert(length == lengths[i]);
+    assert(memcmp(data, arrays[i], length * sizeof(double)) == 0);
+  }
+  table_cache_close(&f);
+
+  /* A different key must not match */
+  key[2] = 4.;
+  assert(!table_cache_open(&f, cache_name, key, 3, 2));
+  unlink(cache_name);
+
+  mg_table_clean(&table_linear);
+  mg_table_clean(&table_cubic);
+  free(xs);
+  free(ys);
+}
+
+/**
+ * @brief Function bilinear in log(k) and log(a) used to check the 2D tables.
+ */
+double test_geff_k(const double k, const double a) {
+  return 1. + 0.1 * log(k) + 0.2 * log(a) + 0.05 * log(k) * log(a);
+}
+
+/**
+ * @brief Check the bilinear look-ups of a #mg_table_2d.
+ */
+void test_mg_table_2d(void) {
+
+  /* Irregularly spaced grid */
+  const int size_k = 7, size_a = 5;
+  const double k[7] = {0.01, 0.02, 0.1, 0.3, 1., 5., 10.};
+  const double a[5] = {0.02, 0.1, 0.25, 0.6, 1.};
+  const double k_fac = 2.;
+
+  const char *filename = "testCosmology_mg_table_2d.txt";
+  FILE *file = fopen(filename, "w");
+  if (file == NULL) error("Could not create '%s'", filename);
+  fprintf(file, "# a k Geff(k,a)/G\n");
+  for (int i = 0; i < size_a; i++)
+    for (int j = 0; j < size_k; j++)
+      fprintf(file, "%.17e %.17e %.17e\n", a[i], k[j],
+              test_geff_k(k_fac * k[j], a[i]));
+  fclose(file);
+
+  struct mg_table_2d table;
+  mg_table_2d_init_from_file(&table, filename, k_fac);
+  unlink(filename);
+
+  assert(table.size_k == size_k);
+  assert(table.size_a == size_a);
+
+  /* Bilinear interpolation is exact inside the table */
+  double slice[7];
+  for (int n = 0; n < MG_TABLE_NUM_CHECK / 100; n++) {
+    const double u = rand() / (RAND_MAX + 1.);
+    const double v = rand() / (RAND_MAX + 1.);
+    const double kk = k_fac * k[0] * pow(k[size_k - 1] / k[0], u);
+    const double aa = a[0] * pow(a[size_a - 1] / a[0], v);
+
+    const double val = mg_table_2d_interp(&table, kk, aa);
+    if (fabs(val - test_geff_k(kk, aa)) > 1e-12)
+      error("Wrong Geff(k=%e, a=%e): %e vs %e", kk, aa, val,
+            test_geff_k(kk, aa));
+
+    mg_table_2d_get_slice(&table, aa, slice);
+    for (int j = 0; j < size_k; j++)
+      if (fabs(slice[j] - test_geff_k(k_fac * k[j], aa)) > 1e-12)
+        error("Wrong Geff slice at a=%e", aa);
+  }
+
+  /* Values outside the table are clamped */
+  assert(fabs(mg_table_2d_interp(&table, 1e-5, 1e-4) -
+              test_geff_k(k_fac * k[0], a[0])) < 1e-12);
+  assert(fabs(mg_table_2d_interp(&table, 1e5, 2.) -
+              test_geff_k(k_fac * k[size_k - 1], a[size_a - 1])) < 1e-12);
+
+  mg_table_2d_clean(&table);
 }
 
 int main(int argc, char *argv[]) {
 
+  /* Initialize CPU frequency, this also starts time. */
+  unsigned long long cpufreq = 0;
+  clocks_set_cpufreq(cpufreq);
+
+  message("Checking the modified-gravity tables...");
+  test_mg_table();
+  test_mg_table_2d();
+
   message("Initialization...");
 
   /* pseudo initialization of params */
@@ -110,7 +110,7 @@ int main(int argc, char *argv[]) {
 
 /* Initialise the Ewald correction table */
 #ifdef SWIFT_GRAVITY_FORCE_CHECKS
-  gravity_exact_force_ewald_init(dim[0]);
+  gravity_exact_force_ewald_init(dim[0], "Ewald.hdf5", &engine.threadpool);
 #endif
 
   /* Run the FFT task */
@@ -927,6 +927,10 @@ int main(int argc, char* argv[]) {
   unsigned long long cpufreq = 0;
   clocks_set_cpufreq(cpufreq);
 
+#ifdef SWIFT_MULTIPOLE_SPHERICAL
+  message("The solid-harmonic multipoles do not use the derivatives.");
+#else
+
   /* Relative tolerance */
   double tol = 1e-4;
 
@@ -1173,6 +1177,7 @@ int main(int argc, char* argv[]) {
 #endif
     message("All good!");
   }
+#endif /* SWIFT_MULTIPOLE_SPHERICAL */
 
   /* All happy */
   return 0;
@@ -132,6 +132,7 @@ int main(int argc, char *argv[]) {
   e.time = 0.1f;
   e.ti_current = 1;
   e.gravity_properties = &grav_props;
+  e.gravity_mirror_pool = NULL;
 
   /* Construct a runner */
   struct runner r;
@@ -179,7 +180,12 @@ int main(int argc, char *argv[]) {
     tensors_i[n].m_pole.M_000 += rand() / ((double)RAND_MAX);
     tensors_j[n].m_pole.M_000 += rand() / ((double)RAND_MAX);
 
-#if SELF_GRAVITY_MULTIPOLE_ORDER > 1
+#ifdef SWIFT_MULTIPOLE_SPHERICAL
+    for (int k = 0; k < 3; ++k) {
+      tensors_i[n].m_pole.M_re[k] += rand() / ((double)RAND_MAX);
+      tensors_j[n].m_pole.M_re[k] += rand() / ((double)RAND_MAX);
+    }
+#elif SELF_GRAVITY_MULTIPOLE_ORDER > 1
     tensors_i[n].m_pole.M_200 += rand() / ((double)RAND_MAX);
     tensors_i[n].m_pole.M_020 += rand() / ((double)RAND_MAX);
     tensors_i[n].m_pole.M_002 += rand() / ((double)RAND_MAX);
@@ -211,6 +217,7 @@ int main(int argc, char *argv[]) {
           SELF_GRAVITY_MULTIPOLE_ORDER,
           (int)(1e6 * clocks_from_ticks(toc - tic) / num_M2L_runs), "ns");
 
+#ifndef SWIFT_MULTIPOLE_SPHERICAL
   /********
    * Symmetric periodic M2L
    ********/
@@ -229,6 +236,7 @@ int main(int argc, char *argv[]) {
   message("%30s at order %d took %4d %s.", "Symmetric periodic M2L",
           SELF_GRAVITY_MULTIPOLE_ORDER,
           (int)(1e6 * clocks_from_ticks(toc - tic) / num_M2L_runs), "ns");
+#endif
 
   /********
    * Non-symmetric non-periodic M2L
@@ -247,6 +255,7 @@ int main(int argc, char *argv[]) {
           SELF_GRAVITY_MULTIPOLE_ORDER,
           (int)(1e6 * clocks_from_ticks(toc - tic) / num_M2L_runs), "ns");
 
+#ifndef SWIFT_MULTIPOLE_SPHERICAL
   /********
    * Non-symmetric periodic M2L
    ********/
@@ -263,6 +272,7 @@ int main(int argc, char *argv[]) {
   message("%30s at order %d took %4d %s.", "Non-symmetric periodic M2L",
           SELF_GRAVITY_MULTIPOLE_ORDER,
           (int)(1e6 * clocks_from_ticks(toc - tic) / num_M2L_runs), "ns");
+#endif
 
   /* Now run a series of M2L kernels */
 
@@ -293,6 +303,7 @@ int main(int argc, char *argv[]) {
           SELF_GRAVITY_MULTIPOLE_ORDER,
           (int)(1e6 * clocks_from_ticks(toc - tic) / num_M2P_runs), "ns");
 
+#ifndef SWIFT_MULTIPOLE_SPHERICAL
   /********
    * Periodic M2P
    ********/
@@ -319,6 +330,7 @@ int main(int argc, char *argv[]) {
   message("%30s at order %d took %4d %s.", "Periodic M2P",
           SELF_GRAVITY_MULTIPOLE_ORDER,
           (int)(1e6 * clocks_from_ticks(toc - tic) / num_M2P_runs), "ns");
+#endif
 
   /* Print out to avoid optimization */
   // gravity_field_tensors_print(&ci.grav.multipole->pot);
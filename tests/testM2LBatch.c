@@ -0,0 +1,341 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#include <config.h>
+
+/* Some standard headers. */
+#include <fenv.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Local headers. */
+#include "swift.h"
+
+/*
+ * Checks the batched M2L kernels against the scalar ones and compares their
+ * speed. The multipole order is fixed at build time; configure with
+ * --with-multipole-order=<1..5> (and --enable-batched-m2l) to benchmark the
+ * other orders.
+ */
+
+#ifdef SWIFT_BATCHED_M2L
+
+/* Number of multipole pairs and of timing repetitions */
+const int num_pairs = 1 << 14;
+const int num_repeats = 16;
+
+/* Number of particles in each multipole */
+const int num_gparts = 8;
+
+/* Softening length of the particles */
+const float softening = 0.5f;
+
+/**
+ * @brief Constructs the multipole of a few random particles.
+ *
+ * @param t The #gravity_tensors to construct.
+ * @param loc The position of the particles' cube.
+ * @param width The width of the cube.
+ * @param grav_props The #gravity_props.
+ */
+void make_multipole(struct gravity_tensors *t, const double loc[3],
+                    const double width,
+                    const struct gravity_props *grav_props) {
+
+  struct gpart gparts[num_gparts];
+  bzero(gparts, num_gparts * sizeof(struct gpart));
+
+  for (int i = 0; i < num_gparts; ++i) {
+    for (int k = 0; k < 3; ++k)
+      gparts[i].x[k] = loc[k] + width * rand() / ((double)RAND_MAX);
+    gparts[i].mass = 0.5 + rand() / ((double)RAND_MAX);
+    gparts[i].type = swift_type_dark_matter;
+    gparts[i].epsilon = softening;
+    gparts[i].time_bin = 1;
+  }
+
+  gravity_reset(t);
+  gravity_P2M(t, gparts, num_gparts, grav_props);
+  gravity_field_tensors_init(&t->pot, 1);
+}
+
+/**
+ * @brief Checks that two field tensors give the same accelerations and
+ * potentials around their centre.
+ *
+ * The differences are measured relative to the leading terms of the field
+ * tensor as the expansion can cancel out close to the sources.
+ *
+ * @param la The reference #grav_tensor.
+ * @param lb The #grav_tensor to check.
+ * @param loc The centre of the field tensors.
+ * @param tolerance The maximal relative difference allowed.
+ * @return The maximal relative difference found.
+ */
+double compare_field_tensors(const struct grav_tensor *la,
+                             const struct grav_tensor *lb, const double loc[3],
+                             const double tolerance) {
+
+  double max_diff = 0.;
+  for (int n = 0; n < 4; ++n) {
+
+    struct gpart ga, gb;
+    bzero(&ga, sizeof(struct gpart));
+    for (int k = 0; k < 3; ++k)
+      ga.x[k] = loc[k] + 0.5 * (rand() / ((double)RAND_MAX) - 0.5);
+    ga.time_bin = 1;
+    memcpy(&gb, &ga, sizeof(struct gpart));
+
+    gravity_L2P(la, loc, &ga);
+    gravity_L2P(lb, loc, &gb);
+
+    double diff = 0.;
+
+#if SELF_GRAVITY_MULTIPOLE_ORDER > 0
+    const double F_1 = sqrt(la->F_100 * la->F_100 + la->F_010 * la->F_010 +
+                            la->F_001 * la->F_001);
+    double diff2 = 0.;
+    for (int k = 0; k < 3; ++k)
+      diff2 += (ga.a_grav[k] - gb.a_grav[k]) * (ga.a_grav[k] - gb.a_grav[k]);
+    diff = sqrt(diff2) / F_1;
+#endif
+
+#ifndef SWIFT_GRAVITY_NO_POTENTIAL
+    diff = max(diff, fabs(ga.potential - gb.potential) / fabs(la->F_000));
+#endif
+
+    if (diff > tolerance)
+      error("Batched M2L differs from scalar one: rel. diff. %e", diff);
+    max_diff = max(max_diff, diff);
+  }
+  return max_diff;
+}
+
+int main(int argc, char *argv[]) {
+
+  /* Initialize CPU frequency, this also starts time. */
+  unsigned long long cpufreq = 0;
+  clocks_set_cpufreq(cpufreq);
+
+  /* Choke on FPEs */
+#ifdef HAVE_FE_ENABLE_EXCEPT
+  feenableexcept(FE_DIVBYZERO | FE_INVALID | FE_OVERFLOW);
+#endif
+
+  /* Get some randomness going */
+  const int seed = time(NULL);
+  message("Seed = %d", seed);
+  srand(seed);
+
+  /* Construct gravity properties */
+  struct gravity_props grav_props;
+  bzero(&grav_props, sizeof(struct gravity_props));
+  grav_props.theta_crit = 0.5;
+  grav_props.G_Newton = 1.;
+  grav_props.mesh_size = 64;
+  grav_props.a_smooth = 1.25;
+  grav_props.epsilon_DM_cur = softening;
+
+  /* Space properites */
+  const double dim[3] = {100., 100., 100.};
+  const double r_s = grav_props.a_smooth * dim[0] / grav_props.mesh_size;
+  const float r_s_inv = 1. / r_s;
+
+  /* The batch */
+  struct gravity_M2L_batch *batch = NULL;
+  if (posix_memalign((void **)&batch, SWIFT_CACHE_ALIGNMENT,
+                     sizeof(struct gravity_M2L_batch)) != 0)
+    error("Error allocating memory for the batch.");
+  batch->count = 0;
+
+  /* Pairs of multipoles at distances from below the softening length to
+   * beyond the truncation radius */
+  struct gravity_tensors *tensors_i = NULL, *tensors_j = NULL;
+  if (posix_memalign((void **)&tensors_i, SWIFT_CACHE_ALIGNMENT,
+                     num_pairs * sizeof(struct gravity_tensors)) != 0 ||
+      posix_memalign((void **)&tensors_j, SWIFT_CACHE_ALIGNMENT,
+                     num_pairs * sizeof(struct gravity_tensors)) != 0)
+    error("Error allocating memory for multipoles array.");
+  swift_lock_type *locks = NULL;
+  if (posix_memalign((void **)&locks, SWIFT_CACHE_ALIGNMENT,
+                     2 * num_pairs * sizeof(swift_lock_type)) != 0)
+    error("Error allocating memory for the locks.");
+  for (int n = 0; n < 2 * num_pairs; ++n) lock_init(&locks[n]);
+
+  for (int n = 0; n < num_pairs; ++n) {
+
+    const double loc_i[3] = {50., 50., 50.};
+    const double r = 0.2 + 8. * rand() / ((double)RAND_MAX);
+    const double phi = 2. * M_PI * rand() / ((double)RAND_MAX);
+    const double cos_theta = 2. * rand() / ((double)RAND_MAX) - 1.;
+    const double sin_theta = sqrt(1. - cos_theta * cos_theta);
+    const double loc_j[3] = {loc_i[0] + r * sin_theta * cos(phi),
+                             loc_i[1] + r * sin_theta * sin(phi),
+                             loc_i[2] + r * cos_theta};
+    make_multipole(&tensors_i[n], loc_i, 0.25, &grav_props);
+    make_multipole(&tensors_j[n], loc_j, 0.25, &grav_props);
+  }
+
+  struct grav_tensor *pot_i = NULL, *pot_j = NULL;
+  if (posix_memalign((void **)&pot_i, SWIFT_CACHE_ALIGNMENT,
+                     num_pairs * sizeof(struct grav_tensor)) != 0 ||
+      posix_memalign((void **)&pot_j, SWIFT_CACHE_ALIGNMENT,
+                     num_pairs * sizeof(struct grav_tensor)) != 0)
+    error("Error allocating memory for field tensors array.");
+
+  for (int periodic = 0; periodic < 2; ++periodic) {
+
+    /* Check the non-symmetric kernels */
+    for (int n = 0; n < num_pairs; ++n) {
+      gravity_field_tensors_init(&pot_i[n], 1);
+      gravity_M2L_nonsym(&pot_i[n], &tensors_j[n].m_pole, tensors_i[n].CoM,
+                         tensors_j[n].CoM, &grav_props, periodic, dim,
+                         r_s_inv);
+      gravity_M2L_batch_nonsym(batch, &tensors_i[n].pot, &locks[n],
+                               &tensors_j[n].m_pole, tensors_i[n].CoM,
+                               tensors_j[n].CoM, &grav_props, periodic, dim,
+                               r_s_inv);
+    }
+    gravity_M2L_batch_flush(batch, periodic, r_s_inv);
+
+    double max_diff = 0.;
+    for (int n = 0; n < num_pairs; ++n) {
+      max_diff = max(max_diff,
+                     compare_field_tensors(&pot_i[n], &tensors_i[n].pot,
+                                           tensors_i[n].CoM, 5e-4));
+      gravity_field_tensors_init(&tensors_i[n].pot, 1);
+    }
+    message("Non-symmetric %12s M2L: max. rel. diff. %e",
+            periodic ? "periodic" : "non-periodic", max_diff);
+
+    /* Check the symmetric kernels */
+    for (int n = 0; n < num_pairs; ++n) {
+      gravity_field_tensors_init(&pot_i[n], 1);
+      gravity_field_tensors_init(&pot_j[n], 1);
+      gravity_M2L_symmetric(&pot_i[n], &pot_j[n], &tensors_i[n].m_pole,
+                            &tensors_j[n].m_pole, tensors_i[n].CoM,
+                            tensors_j[n].CoM, &grav_props, periodic, dim,
+                            r_s_inv);
+      gravity_M2L_batch_symmetric(
+          batch, &tensors_i[n].pot, &tensors_j[n].pot, &locks[n],
+          &locks[num_pairs + n], &tensors_i[n].m_pole, &tensors_j[n].m_pole,
+          tensors_i[n].CoM, tensors_j[n].CoM, &grav_props, periodic, dim,
+          r_s_inv);
+    }
+    gravity_M2L_batch_flush(batch, periodic, r_s_inv);
+
+    max_diff = 0.;
+    for (int n = 0; n < num_pairs; ++n) {
+      max_diff = max(max_diff,
+                     compare_field_tensors(&pot_i[n], &tensors_i[n].pot,
+                                           tensors_i[n].CoM, 5e-4));
+      max_diff = max(max_diff,
+                     compare_field_tensors(&pot_j[n], &tensors_j[n].pot,
+                                           tensors_j[n].CoM, 5e-4));
+      gravity_field_tensors_init(&tensors_i[n].pot, 1);
+      gravity_field_tensors_init(&tensors_j[n].pot, 1);
+    }
+    message("Symmetric %16s M2L: max. rel. diff. %e",
+            periodic ? "periodic" : "non-periodic", max_diff);
+  }
+
+  /* Now time the two versions */
+  const int num_runs = num_pairs * num_repeats;
+  message("Number of runs: %d", num_runs);
+
+  for (int periodic = 0; periodic < 2; ++periodic) {
+
+    const char *name = periodic ? "periodic" : "non-periodic";
+
+    ticks tic = getticks();
+    for (int k = 0; k < num_repeats; ++k)
+      for (int n = 0; n < num_pairs; ++n)
+        gravity_M2L_nonsym(&tensors_i[n].pot, &tensors_j[n].m_pole,
+                           tensors_i[n].CoM, tensors_j[n].CoM, &grav_props,
+                           periodic, dim, r_s_inv);
+    ticks toc = getticks();
+    const double time_scalar = clocks_from_ticks(toc - tic);
+
+    tic = getticks();
+    for (int k = 0; k < num_repeats; ++k)
+      for (int n = 0; n < num_pairs; ++n)
+        gravity_M2L_batch_nonsym(batch, &tensors_i[n].pot, &locks[n],
+                                 &tensors_j[n].m_pole, tensors_i[n].CoM,
+                                 tensors_j[n].CoM, &grav_props, periodic, dim,
+                                 r_s_inv);
+    gravity_M2L_batch_flush(batch, periodic, r_s_inv);
+    toc = getticks();
+    const double time_batch = clocks_from_ticks(toc - tic);
+
+    message("Non-symmetric %12s M2L at order %d: scalar %4d %s, "
+            "batched %4d %s (x%.2f)",
+            name, SELF_GRAVITY_MULTIPOLE_ORDER,
+            (int)(1e6 * time_scalar / num_runs), "ns",
+            (int)(1e6 * time_batch / num_runs), "ns", time_scalar / time_batch);
+
+    tic = getticks();
+    for (int k = 0; k < num_repeats; ++k)
+      for (int n = 0; n < num_pairs; ++n)
+        gravity_M2L_symmetric(&tensors_i[n].pot, &tensors_j[n].pot,
+                              &tensors_i[n].m_pole, &tensors_j[n].m_pole,
+                              tensors_i[n].CoM, tensors_j[n].CoM, &grav_props,
+                              periodic, dim, r_s_inv);
+    toc = getticks();
+    const double time_scalar_sym = clocks_from_ticks(toc - tic);
+
+    tic = getticks();
+    for (int k = 0; k < num_repeats; ++k)
+      for (int n = 0; n < num_pairs; ++n)
+        gravity_M2L_batch_symmetric(
+            batch, &tensors_i[n].pot, &tensors_j[n].pot, &locks[n],
+            &locks[num_pairs + n], &tensors_i[n].m_pole, &tensors_j[n].m_pole,
+            tensors_i[n].CoM, tensors_j[n].CoM, &grav_props, periodic, dim,
+            r_s_inv);
+    gravity_M2L_batch_flush(batch, periodic, r_s_inv);
+    toc = getticks();
+    const double time_batch_sym = clocks_from_ticks(toc - tic);
+
+    message("Symmetric %16s M2L at order %d: scalar %4d %s, "
+            "batched %4d %s (x%.2f)",
+            name, SELF_GRAVITY_MULTIPOLE_ORDER,
+            (int)(1e6 * time_scalar_sym / num_runs), "ns",
+            (int)(1e6 * time_batch_sym / num_runs), "ns",
+            time_scalar_sym / time_batch_sym);
+  }
+
+  /* Clean up */
+  free(batch);
+  free(tensors_i);
+  free(tensors_j);
+  free(pot_i);
+  free(pot_j);
+  free((void *)locks);
+  return 0;
+}
+
+#else
+
+int main(int argc, char *argv[]) {
+
+  message("SWIFT was not configured with --enable-batched-m2l.");
+  return 0;
+}
+
+#endif /* SWIFT_BATCHED_M2L */
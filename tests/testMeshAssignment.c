@@ -0,0 +1,253 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#include <config.h>
+
+/* Some standard headers. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Local headers. */
+#include "mesh_window.h"
+#include "row_major_id.h"
+#include "swift.h"
+
+/* Number of top-level cells along each axis */
+#define TEST_CDIM 8
+
+/* Number of repetitions of each timing */
+#define TEST_REPEAT 3
+
+/**
+ * @brief Centred B-spline of a given order (the assignment window).
+ */
+double window(const int order, const double s) {
+
+  const double r = fabs(s);
+  switch (order) {
+    case 2:
+      return r < 1. ? 1. - r : 0.;
+    case 3:
+      if (r < 0.5) return 0.75 - r * r;
+      if (r < 1.5) return 0.5 * (1.5 - r) * (1.5 - r);
+      return 0.;
+    case 4:
+      if (r < 1.) return (4. - 6. * r * r + 3. * r * r * r) / 6.;
+      if (r < 2.) return (2. - r) * (2. - r) * (2. - r) / 6.;
+      return 0.;
+    default:
+      error("Unknown window order %d", order);
+      return 0.;
+  }
+}
+
+/**
+ * @brief Reference serial assignment of a set of particles.
+ */
+void reference_assignment(const struct gpart *gparts, const size_t nr_gparts,
+                          double *rho, const int N, const double dim[3],
+                          const int order, const double shift) {
+
+  const double fac = N / dim[0];
+  for (size_t n = 0; n < nr_gparts; ++n) {
+
+    double pos[3];
+    int base[3];
+    for (int a = 0; a < 3; ++a) {
+      pos[a] = fac * box_wrap(gparts[n].x[a], 0., dim[a]) + shift;
+      base[a] = (int)floor(pos[a]);
+    }
+
+    /* Brute-force over all the mesh points that could be touched */
+    for (int ii = base[0] - 2; ii <= base[0] + 3; ++ii) {
+      const double wx = window(order, pos[0] - ii);
+      if (wx == 0.) continue;
+      for (int jj = base[1] - 2; jj <= base[1] + 3; ++jj) {
+        const double wy = window(order, pos[1] - jj);
+        if (wy == 0.) continue;
+        for (int kk = base[2] - 2; kk <= base[2] + 3; ++kk) {
+          const double wz = window(order, pos[2] - kk);
+          if (wz == 0.) continue;
+          rho[row_major_id_periodic(ii, jj, kk, N)] +=
+              wx * wy * wz * gparts[n].mass;
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Create a particle distribution made of a uniform background and a
+ * few dense clumps, sorted into top-level cells.
+ */
+struct gpart *make_particles(const size_t nr_gparts, const double dim[3],
+                             struct cell *cells) {
+
+  struct gpart *gparts =
+      (struct gpart *)malloc(nr_gparts * sizeof(struct gpart));
+  struct gpart *sorted =
+      (struct gpart *)malloc(nr_gparts * sizeof(struct gpart));
+  int *cell_id = (int *)malloc(nr_gparts * sizeof(int));
+  int counts[TEST_CDIM * TEST_CDIM * TEST_CDIM] = {0};
+  bzero(gparts, nr_gparts * sizeof(struct gpart));
+
+  const double clumps[3][3] = {
+      {0.3, 0.3, 0.3}, {0.71, 0.52, 0.1}, {0.999, 0.001, 0.5}};
+
+  for (size_t n = 0; n < nr_gparts; ++n) {
+    struct gpart *gp = &gparts[n];
+
+    /* Half of the particles sit in tight clumps (one across the periodic
+     * boundary) to stress the concurrent writes */
+    if (n % 2 == 0) {
+      for (int a = 0; a < 3; ++a) gp->x[a] = random_uniform(0., dim[a]);
+    } else {
+      const double *c = clumps[n % 3];
+      for (int a = 0; a < 3; ++a)
+        gp->x[a] = box_wrap(
+            c[a] * dim[a] + random_uniform(-0.01, 0.01) * dim[a], 0., dim[a]);
+    }
+    gp->mass = random_uniform(0.5, 1.5);
+    gp->type = swift_type_dark_matter;
+    gp->time_bin = 1;
+
+    const int ci = (int)(gp->x[0] / dim[0] * TEST_CDIM);
+    const int cj = (int)(gp->x[1] / dim[1] * TEST_CDIM);
+    const int ck = (int)(gp->x[2] / dim[2] * TEST_CDIM);
+    cell_id[n] = (ci * TEST_CDIM + cj) * TEST_CDIM + ck;
+    counts[cell_id[n]]++;
+  }
+
+  /* Sort the particles by cell and link them to the cells */
+  const int nr_cells = TEST_CDIM * TEST_CDIM * TEST_CDIM;
+  size_t offset = 0;
+  for (int c = 0; c < nr_cells; ++c) {
+    struct cell *cell = &cells[c];
+    bzero(cell, sizeof(struct cell));
+    const int ci = c / (TEST_CDIM * TEST_CDIM);
+    const int cj = (c / TEST_CDIM) % TEST_CDIM;
+    const int ck = c % TEST_CDIM;
+    const int cijk[3] = {ci, cj, ck};
+    for (int a = 0; a < 3; ++a) {
+      cell->width[a] = dim[a] / TEST_CDIM;
+      cell->loc[a] = cijk[a] * cell->width[a];
+    }
+    cell->grav.parts = &sorted[offset];
+    cell->grav.count = 0;
+    offset += counts[c];
+  }
+  for (size_t n = 0; n < nr_gparts; ++n) {
+    struct cell *cell = &cells[cell_id[n]];
+    cell->grav.parts[cell->grav.count++] = gparts[n];
+  }
+
+  free(cell_id);
+  free(gparts);
+  return sorted;
+}
+
+int main(int argc, char *argv[]) {
+
+  /* Initialize CPU frequency, this also starts time. */
+  unsigned long long cpufreq = 0;
+  clocks_set_cpufreq(cpufreq);
+
+  /* Optional mesh size, number of particles and threads for benchmarking */
+  const int N = (argc > 1) ? atoi(argv[1]) : 64;
+  const size_t nr_gparts = (argc > 2) ? atoll(argv[2]) : 200000;
+  const int nr_threads = (argc > 3) ? atoi(argv[3]) : 4;
+  if (N < TEST_CDIM || nr_threads < 1)
+    error("Usage: testMeshAssignment [N] [nr_gparts] [threads]");
+
+  srand(1234);
+
+  struct threadpool tp;
+  threadpool_init(&tp, nr_threads);
+
+  const double dim[3] = {100., 100., 100.};
+  const int nr_cells = TEST_CDIM * TEST_CDIM * TEST_CDIM;
+  struct cell *cells = (struct cell *)malloc(nr_cells * sizeof(struct cell));
+  struct gpart *gparts = make_particles(nr_gparts, dim, cells);
+
+  int *local_cells = (int *)malloc(nr_cells * sizeof(int));
+  for (int c = 0; c < nr_cells; ++c) local_cells[c] = c;
+
+  struct neutrino_model nu_model;
+  bzero(&nu_model, sizeof(struct neutrino_model));
+
+  const size_t mesh_size = (size_t)N * N * N;
+  double *rho_ref = (double *)malloc(mesh_size * sizeof(double));
+  double *rho = (double *)malloc(mesh_size * sizeof(double));
+
+  message("Mesh: %d^3 cells, %zd particles, %d threads", N, nr_gparts,
+          nr_threads);
+
+  const char *names[3] = {"atomic", "patches", "tiles"};
+  for (int order = 2; order <= 4; ++order) {
+    for (int interlaced = 0; interlaced < 2; ++interlaced) {
+
+      const double shift = interlaced ? 0.5 : 0.;
+
+      bzero(rho_ref, mesh_size * sizeof(double));
+      reference_assignment(gparts, nr_gparts, rho_ref, N, dim, order, shift);
+
+      double max_ref = 0.;
+      for (size_t i = 0; i < mesh_size; ++i)
+        max_ref = max(max_ref, fabs(rho_ref[i]));
+
+      for (int mode = mesh_assignment_atomic; mode <= mesh_assignment_tiles;
+           ++mode) {
+
+        double best_time = FLT_MAX;
+        for (int r = 0; r < TEST_REPEAT; ++r) {
+          bzero(rho, mesh_size * sizeof(double));
+          const ticks tic = getticks();
+          cells_gpart_to_mesh(&tp, rho, N, N / dim[0], dim, cells,
+                              local_cells, nr_cells,
+                              (enum mesh_assignment_mode)mode, order, shift,
+                              &nu_model);
+          best_time = min(best_time, clocks_from_ticks(getticks() - tic));
+        }
+
+        /* Compare to the serial reference */
+        double max_diff = 0.;
+        for (size_t i = 0; i < mesh_size; ++i)
+          max_diff = max(max_diff, fabs(rho[i] - rho_ref[i]));
+
+        message(
+            "%s%s %-8s: %8.3f %s (%.2f ns per particle), max rel. diff "
+            "%.2e",
+            mesh_window_name(order), interlaced ? " (shifted)" : "",
+            names[mode], best_time, clocks_getunit(),
+            1e6 * best_time / nr_gparts, max_diff / max_ref);
+
+        if (max_diff > 1e-10 * max_ref)
+          error("The '%s' %s assignment does not match the reference",
+                names[mode], mesh_window_name(order));
+      }
+    }
+  }
+
+  free(rho);
+  free(rho_ref);
+  free(local_cells);
+  free(gparts);
+  free(cells);
+  threadpool_clean(&tp);
+  return 0;
+}
@@ -0,0 +1,226 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#include <config.h>
+
+#if !defined(HAVE_FFTW) || !defined(HAVE_FFTWF)
+
+int main(int argc, char *argv[]) { return 0; }
+
+#else
+
+/* Some standard headers. */
+#include <fenv.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Local headers. */
+#include "swift.h"
+
+/* Number of top-level cells along each axis */
+#define TEST_CDIM 4
+
+/**
+ * @brief Create a particle distribution made of a uniform background and a
+ * few dense clumps, sorted into top-level cells.
+ */
+struct gpart *make_particles(const size_t nr_gparts, const double dim[3],
+                             struct cell *cells) {
+
+  struct gpart *gparts =
+      (struct gpart *)malloc(nr_gparts * sizeof(struct gpart));
+  struct gpart *sorted =
+      (struct gpart *)malloc(nr_gparts * sizeof(struct gpart));
+  int *cell_id = (int *)malloc(nr_gparts * sizeof(int));
+  int counts[TEST_CDIM * TEST_CDIM * TEST_CDIM] = {0};
+  bzero(gparts, nr_gparts * sizeof(struct gpart));
+
+  const double clumps[3][3] = {
+      {0.3, 0.3, 0.3}, {0.71, 0.52, 0.1}, {0.999, 0.001, 0.5}};
+
+  for (size_t n = 0; n < nr_gparts; ++n) {
+    struct gpart *gp = &gparts[n];
+
+    if (n % 2 == 0) {
+      for (int a = 0; a < 3; ++a) gp->x[a] = random_uniform(0., dim[a]);
+    } else {
+      const double *c = clumps[n % 3];
+      for (int a = 0; a < 3; ++a)
+        gp->x[a] = box_wrap(
+            c[a] * dim[a] + random_uniform(-0.05, 0.05) * dim[a], 0., dim[a]);
+    }
+    gp->mass = random_uniform(0.5, 1.5);
+    gp->type = swift_type_dark_matter;
+    gp->time_bin = 1;
+
+    const int ci = (int)(gp->x[0] / dim[0] * TEST_CDIM);
+    const int cj = (int)(gp->x[1] / dim[1] * TEST_CDIM);
+    const int ck = (int)(gp->x[2] / dim[2] * TEST_CDIM);
+    cell_id[n] = (ci * TEST_CDIM + cj) * TEST_CDIM + ck;
+    counts[cell_id[n]]++;
+  }
+
+  /* Sort the particles by cell and link them to the cells */
+  const int nr_cells = TEST_CDIM * TEST_CDIM * TEST_CDIM;
+  size_t offset = 0;
+  for (int c = 0; c < nr_cells; ++c) {
+    struct cell *cell = &cells[c];
+    bzero(cell, sizeof(struct cell));
+    const int ci = c / (TEST_CDIM * TEST_CDIM);
+    const int cj = (c / TEST_CDIM) % TEST_CDIM;
+    const int ck = c % TEST_CDIM;
+    const int cijk[3] = {ci, cj, ck};
+    for (int a = 0; a < 3; ++a) {
+      cell->width[a] = dim[a] / TEST_CDIM;
+      cell->loc[a] = cijk[a] * cell->width[a];
+    }
+    cell->grav.parts = &sorted[offset];
+    cell->grav.count = 0;
+    offset += counts[c];
+  }
+  for (size_t n = 0; n < nr_gparts; ++n) {
+    struct cell *cell = &cells[cell_id[n]];
+    cell->grav.parts[cell->grav.count++] = gparts[n];
+  }
+
+  free(cell_id);
+  free(gparts);
+  return sorted;
+}
+
+/**
+ * @brief Computes the mesh forces of all the particles with a given
+ * precision of the mesh and returns them.
+ */
+void mesh_forces(struct gravity_props *props, struct space *s,
+                 struct threadpool *tp, const int single_precision,
+                 double *acc) {
+
+  props->mesh_single_precision = single_precision;
+
+  struct pm_mesh mesh;
+  pm_mesh_init(&mesh, props, s->dim, tp->num_threads);
+  pm_mesh_compute_potential(&mesh, s, tp, /*verbose=*/0);
+  pm_mesh_clean(&mesh);
+
+  for (size_t n = 0; n < s->nr_gparts; ++n)
+    for (int a = 0; a < 3; ++a) acc[3 * n + a] = s->gparts[n].a_grav_mesh[a];
+}
+
+int main(int argc, char *argv[]) {
+
+  /* Initialize CPU frequency, this also starts time. */
+  unsigned long long cpufreq = 0;
+  clocks_set_cpufreq(cpufreq);
+
+  /* Choke on FPEs */
+#ifdef HAVE_FE_ENABLE_EXCEPT
+  feenableexcept(FE_DIVBYZERO | FE_INVALID | FE_OVERFLOW);
+#endif
+
+  srand(1234);
+
+  const int N = 32;
+  const size_t nr_gparts = 20000;
+
+  struct threadpool tp;
+  threadpool_init(&tp, 4);
+
+  const double dim[3] = {100., 100., 100.};
+  const int nr_cells = TEST_CDIM * TEST_CDIM * TEST_CDIM;
+  struct cell *cells = (struct cell *)malloc(nr_cells * sizeof(struct cell));
+  struct gpart *gparts = make_particles(nr_gparts, dim, cells);
+
+  int *local_cells = (int *)malloc(nr_cells * sizeof(int));
+  for (int c = 0; c < nr_cells; ++c) local_cells[c] = c;
+
+  /* The minimal engine and space the mesh needs */
+  struct phys_const phys_const;
+  bzero(&phys_const, sizeof(struct phys_const));
+  phys_const.const_newton_G = 1.;
+
+  struct neutrino_props neutrino_props;
+  bzero(&neutrino_props, sizeof(struct neutrino_props));
+
+  struct engine e;
+  bzero(&e, sizeof(struct engine));
+  e.physical_constants = &phys_const;
+  e.neutrino_properties = &neutrino_props;
+
+  struct space s;
+  bzero(&s, sizeof(struct space));
+  s.dim[0] = dim[0];
+  s.dim[1] = dim[1];
+  s.dim[2] = dim[2];
+  s.cells_top = cells;
+  s.local_cells_top = local_cells;
+  s.gparts = gparts;
+  s.nr_gparts = nr_gparts;
+  s.e = &e;
+
+  struct gravity_props props;
+  bzero(&props, sizeof(struct gravity_props));
+  props.mesh_size = N;
+  props.a_smooth = 1.25;
+  props.r_cut_max_ratio = 4.5;
+  props.r_cut_min_ratio = 0.1;
+  props.mesh_assignment = mesh_assignment_patches;
+  props.mesh_fftw_planner = fft_plans_estimate;
+
+  double *acc_double = (double *)malloc(3 * nr_gparts * sizeof(double));
+  double *acc_single = (double *)malloc(3 * nr_gparts * sizeof(double));
+
+  for (int order = 2; order <= 3; ++order) {
+
+    /* Once with the cells and once directly with the particles */
+    for (int use_cells = 1; use_cells >= 0; --use_cells) {
+
+      props.mesh_window_order = order;
+      s.nr_local_cells = use_cells ? nr_cells : 0;
+
+      mesh_forces(&props, &s, &tp, /*single_precision=*/0, acc_double);
+      mesh_forces(&props, &s, &tp, /*single_precision=*/1, acc_single);
+
+      /* Compare the forces to the RMS of the double-precision ones */
+      double rms = 0., max_diff = 0.;
+      for (size_t i = 0; i < 3 * nr_gparts; ++i) {
+        rms += acc_double[i] * acc_double[i];
+        max_diff = max(max_diff, fabs(acc_single[i] - acc_double[i]));
+      }
+      rms = sqrt(rms / (3 * nr_gparts));
+
+      message("%s, %s: max force difference %.2e of the RMS force",
+              order == 2 ? "CIC" : "TSC", use_cells ? "cells" : "particles",
+              max_diff / rms);
+
+      if (rms == 0.) error("The mesh forces are all zero");
+      if (max_diff > 1e-4 * rms)
+        error("The single-precision mesh forces do not match the double ones");
+    }
+  }
+
+  free(acc_single);
+  free(acc_double);
+  free(local_cells);
+  free(gparts);
+  free(cells);
+  threadpool_clean(&tp);
+  return 0;
+}
+
+#endif
@@ -0,0 +1,320 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#include <config.h>
+
+#if !defined(HAVE_FFTW)
+
+int main(int argc, char *argv[]) { return 0; }
+
+#else
+
+/* Some standard headers. */
+#include <fenv.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Local headers. */
+#include "swift.h"
+
+/* Number of top-level cells along each axis */
+#define TEST_CDIM 4
+
+/**
+ * @brief Create a particle distribution made of a uniform background and a
+ * few dense clumps, sorted into top-level cells.
+ */
+struct gpart *make_particles(const size_t nr_gparts, const double dim[3],
+                             struct cell *cells) {
+
+  struct gpart *gparts =
+      (struct gpart *)malloc(nr_gparts * sizeof(struct gpart));
+  struct gpart *sorted =
+      (struct gpart *)malloc(nr_gparts * sizeof(struct gpart));
+  int *cell_id = (int *)malloc(nr_gparts * sizeof(int));
+  int counts[TEST_CDIM * TEST_CDIM * TEST_CDIM] = {0};
+  bzero(gparts, nr_gparts * sizeof(struct gpart));
+
+  const double clumps[3][3] = {
+      {0.3, 0.3, 0.3}, {0.71, 0.52, 0.1}, {0.999, 0.001, 0.5}};
+
+  for (size_t n = 0; n < nr_gparts; ++n) {
+    struct gpart *gp = &gparts[n];
+
+    if (n % 2 == 0) {
+      for (int a = 0; a < 3; ++a) gp->x[a] = random_uniform(0., dim[a]);
+    } else {
+      const double *c = clumps[n % 3];
+      for (int a = 0; a < 3; ++a)
+        gp->x[a] = box_wrap(
+            c[a] * dim[a] + random_uniform(-0.05, 0.05) * dim[a], 0., dim[a]);
+    }
+    gp->mass = random_uniform(0.5, 1.5);
+    gp->type = swift_type_dark_matter;
+    gp->time_bin = 1;
+
+    const int ci = (int)(gp->x[0] / dim[0] * TEST_CDIM);
+    const int cj = (int)(gp->x[1] / dim[1] * TEST_CDIM);
+    const int ck = (int)(gp->x[2] / dim[2] * TEST_CDIM);
+    cell_id[n] = (ci * TEST_CDIM + cj) * TEST_CDIM + ck;
+    counts[cell_id[n]]++;
+  }
+
+  /* Sort the particles by cell and link them to the cells */
+  const int nr_cells = TEST_CDIM * TEST_CDIM * TEST_CDIM;
+  size_t offset = 0;
+  for (int c = 0; c < nr_cells; ++c) {
+    struct cell *cell = &cells[c];
+    bzero(cell, sizeof(struct cell));
+    const int ci = c / (TEST_CDIM * TEST_CDIM);
+    const int cj = (c / TEST_CDIM) % TEST_CDIM;
+    const int ck = c % TEST_CDIM;
+    const int cijk[3] = {ci, cj, ck};
+    for (int a = 0; a < 3; ++a) {
+      cell->width[a] = dim[a] / TEST_CDIM;
+      cell->loc[a] = cijk[a] * cell->width[a];
+    }
+    cell->grav.parts = &sorted[offset];
+    cell->grav.count = 0;
+    offset += counts[c];
+  }
+  for (size_t n = 0; n < nr_gparts; ++n) {
+    struct cell *cell = &cells[cell_id[n]];
+    cell->grav.parts[cell->grav.count++] = gparts[n];
+  }
+
+  free(cell_id);
+  free(gparts);
+  return sorted;
+}
+
+/**
+ * @brief Computes the mesh forces of all the particles at once, as done
+ * before the step when the mesh tasks are not used.
+ */
+void mesh_forces_reference(struct pm_mesh *mesh, struct space *s,
+                           struct threadpool *tp, double *acc) {
+
+  pm_mesh_compute_potential(mesh, s, tp, /*verbose=*/0);
+
+  for (size_t n = 0; n < s->nr_gparts; ++n)
+    for (int a = 0; a < 3; ++a) acc[3 * n + a] = s->gparts[n].a_grav_mesh[a];
+}
+
+/**
+ * @brief Runs one round of mesh tasks on all the blocks of planes, either
+ * one after the other or spread over the threadpool.
+ */
+struct mesh_round_data {
+  const struct pm_mesh *mesh;
+  void (*fn)(const struct pm_mesh *, int);
+};
+
+void mesh_round_mapper(void *map_data, int num, void *extra) {
+  const struct mesh_round_data *data = (const struct mesh_round_data *)extra;
+  const int *blocks = (const int *)map_data;
+  for (int i = 0; i < num; ++i) data->fn(data->mesh, blocks[i]);
+}
+
+void mesh_round(struct threadpool *tp, const struct pm_mesh *mesh,
+                void (*fn)(const struct pm_mesh *, int), int *blocks) {
+
+  struct mesh_round_data data = {mesh, fn};
+  if (tp == NULL)
+    mesh_round_mapper(blocks, mesh->nr_task_blocks, &data);
+  else
+    threadpool_map(tp, mesh_round_mapper, blocks, mesh->nr_task_blocks,
+                   sizeof(int), /*chunk=*/1, &data);
+}
+
+/**
+ * @brief Computes the mesh forces of all the particles with the work of the
+ * mesh tasks: assignment of each cell, the three rounds of transforms of the
+ * blocks of planes and the interpolation onto each cell.
+ *
+ * @return The time spent in the transforms.
+ */
+double mesh_forces_tasks(struct pm_mesh *mesh, struct space *s,
+                         struct threadpool *tp, struct threadpool *fft_tp,
+                         double *acc) {
+
+  pm_mesh_tasks_prepare(mesh, s, tp, /*verbose=*/0);
+
+  for (int c = 0; c < s->nr_cells; ++c)
+    pm_mesh_tasks_cell_assign(mesh, s, &s->cells_top[c]);
+
+  int *blocks = (int *)malloc(mesh->nr_task_blocks * sizeof(int));
+  for (int b = 0; b < mesh->nr_task_blocks; ++b) blocks[b] = b;
+
+  const ticks tic = getticks();
+  mesh_round(fft_tp, mesh, pm_mesh_tasks_r2c, blocks);
+  mesh_round(fft_tp, mesh, pm_mesh_tasks_green, blocks);
+  mesh_round(fft_tp, mesh, pm_mesh_tasks_c2r, blocks);
+  const ticks toc = getticks();
+  free(blocks);
+
+  for (int c = 0; c < s->nr_cells; ++c)
+    pm_mesh_tasks_cell_interpolate(mesh, s, &s->cells_top[c]);
+
+  pm_mesh_tasks_clean(mesh);
+
+  for (size_t n = 0; n < s->nr_gparts; ++n)
+    for (int a = 0; a < 3; ++a) acc[3 * n + a] = s->gparts[n].a_grav_mesh[a];
+
+  return clocks_from_ticks(toc - tic);
+}
+
+/**
+ * @brief Maximal difference between two sets of forces relative to the RMS
+ * of the first one.
+ */
+double max_relative_difference(const double *acc_ref, const double *acc,
+                               const size_t nr_gparts) {
+
+  double rms = 0., max_diff = 0.;
+  for (size_t i = 0; i < 3 * nr_gparts; ++i) {
+    rms += acc_ref[i] * acc_ref[i];
+    max_diff = max(max_diff, fabs(acc[i] - acc_ref[i]));
+  }
+  rms = sqrt(rms / (3 * nr_gparts));
+
+  if (rms == 0.) error("The mesh forces are all zero");
+  return max_diff / rms;
+}
+
+int main(int argc, char *argv[]) {
+
+  /* Initialize CPU frequency, this also starts time. */
+  unsigned long long cpufreq = 0;
+  clocks_set_cpufreq(cpufreq);
+
+  /* Choke on FPEs */
+#ifdef HAVE_FE_ENABLE_EXCEPT
+  feenableexcept(FE_DIVBYZERO | FE_INVALID | FE_OVERFLOW);
+#endif
+
+  srand(1234);
+
+  const int N = 64;
+  const int nr_threads = 4;
+  const size_t nr_gparts = 20000;
+
+  struct threadpool tp;
+  threadpool_init(&tp, nr_threads);
+
+  const double dim[3] = {100., 100., 100.};
+  const int nr_cells = TEST_CDIM * TEST_CDIM * TEST_CDIM;
+  struct cell *cells = (struct cell *)malloc(nr_cells * sizeof(struct cell));
+  struct gpart *gparts = make_particles(nr_gparts, dim, cells);
+
+  int *local_cells = (int *)malloc(nr_cells * sizeof(int));
+  for (int c = 0; c < nr_cells; ++c) local_cells[c] = c;
+
+  /* The minimal engine and space the mesh needs */
+  struct phys_const phys_const;
+  bzero(&phys_const, sizeof(struct phys_const));
+  phys_const.const_newton_G = 1.;
+
+  struct neutrino_props neutrino_props;
+  bzero(&neutrino_props, sizeof(struct neutrino_props));
+
+  struct engine e;
+  bzero(&e, sizeof(struct engine));
+  e.physical_constants = &phys_const;
+  e.neutrino_properties = &neutrino_props;
+
+  struct space s;
+  bzero(&s, sizeof(struct space));
+  s.dim[0] = dim[0];
+  s.dim[1] = dim[1];
+  s.dim[2] = dim[2];
+  s.cells_top = cells;
+  s.nr_cells = nr_cells;
+  s.local_cells_top = local_cells;
+  s.nr_local_cells = nr_cells;
+  s.gparts = gparts;
+  s.nr_gparts = nr_gparts;
+  s.e = &e;
+
+  struct gravity_props props;
+  bzero(&props, sizeof(struct gravity_props));
+  props.mesh_size = N;
+  props.a_smooth = 1.25;
+  props.r_cut_max_ratio = 4.5;
+  props.r_cut_min_ratio = 0.1;
+  props.mesh_assignment = mesh_assignment_patches;
+  props.mesh_fftw_planner = fft_plans_estimate;
+  props.mesh_tasks = 1;
+
+  double *acc_ref = (double *)malloc(3 * nr_gparts * sizeof(double));
+  double *acc_tasks = (double *)malloc(3 * nr_gparts * sizeof(double));
+
+  for (int order = 2; order <= 3; ++order) {
+    for (int interlacing = 0; interlacing <= 1; ++interlacing) {
+
+      props.mesh_window_order = order;
+      props.mesh_interlacing = interlacing;
+
+      struct pm_mesh mesh;
+      pm_mesh_init(&mesh, &props, s.dim, nr_threads);
+
+      mesh_forces_reference(&mesh, &s, &tp, acc_ref);
+
+      /* All the transforms in one block on one thread, as a single solve
+       * task would do them */
+      const int nr_blocks = mesh.nr_task_blocks;
+      mesh.nr_task_blocks = 1;
+      const double time_serial =
+          mesh_forces_tasks(&mesh, &s, &tp, /*fft_tp=*/NULL, acc_tasks);
+      const double diff_serial =
+          max_relative_difference(acc_ref, acc_tasks, nr_gparts);
+
+      /* The blocks of planes spread over the threads */
+      mesh.nr_task_blocks = nr_blocks;
+      const double time_blocks =
+          mesh_forces_tasks(&mesh, &s, &tp, &tp, acc_tasks);
+      const double diff_blocks =
+          max_relative_difference(acc_ref, acc_tasks, nr_gparts);
+
+      pm_mesh_clean(&mesh);
+
+      message(
+          "%s, interlacing=%d: max force difference %.2e (1 block) and %.2e "
+          "(%d blocks) of the RMS force",
+          order == 2 ? "CIC" : "TSC", interlacing, diff_serial, diff_blocks,
+          nr_blocks);
+      message("Transforms: %.3f %s in 1 block on 1 thread, %.3f %s in %d "
+              "blocks on %d threads.",
+              time_serial, clocks_getunit(), time_blocks, clocks_getunit(),
+              nr_blocks, nr_threads);
+
+      if (diff_serial > 1e-6 || diff_blocks > 1e-6)
+        error("The mesh forces of the tasks do not match the reference ones");
+    }
+  }
+
+  free(acc_tasks);
+  free(acc_ref);
+  free(local_cells);
+  free(gparts);
+  free(cells);
+  threadpool_clean(&tp);
+  return 0;
+}
+
+#endif
@@ -0,0 +1,271 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#include <config.h>
+
+/* Some standard headers. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Local headers. */
+#include "swift.h"
+
+/* Units: Mpc, km/s */
+#define TEST_BOX_SIZE 256.
+#define TEST_H0 67.74
+#define TEST_C 299792.458
+#define TEST_OMEGA_M 0.3
+#define TEST_OMEGA_LAMBDA 0.7
+
+/**
+ * @brief Set the few cosmological quantities used by the solver.
+ */
+void make_cosmology(struct cosmology *cosmo, struct phys_const *phys_const,
+                    const double a) {
+
+  bzero(cosmo, sizeof(struct cosmology));
+  cosmo->a = a;
+  cosmo->H0 = TEST_H0;
+  cosmo->Omega_cdm = TEST_OMEGA_M;
+  cosmo->Omega_b = 0.;
+  cosmo->Omega_lambda = TEST_OMEGA_LAMBDA;
+
+  bzero(phys_const, sizeof(struct phys_const));
+  phys_const->const_speed_light_c = TEST_C;
+  phys_const->const_newton_G = 4.30091e-9;
+}
+
+/**
+ * @brief Initialise a solver with the given parameters.
+ */
+void make_solver(struct pm_multigrid *mg, const int N, const double fR0,
+                 const double tolerance, const int max_vcycles) {
+
+  struct gravity_props props;
+  bzero(&props, sizeof(struct gravity_props));
+  props.mesh_fR_solver = 1;
+  props.mesh_fR0 = fR0;
+  props.mesh_multigrid_tolerance = tolerance;
+  props.mesh_multigrid_max_vcycles = max_vcycles;
+  props.mesh_multigrid_smoothing_steps = 2;
+  props.mesh_multigrid_max_levels = PM_MULTIGRID_MAX_LEVELS;
+
+  pm_multigrid_init(mg, &props);
+  pm_multigrid_allocate(mg, N, 0, N, TEST_BOX_SIZE, /*use_mpi=*/0);
+}
+
+/**
+ * @brief Check the solver against the linear solution for a plane wave.
+ */
+void test_linear(struct threadpool *tp) {
+
+  const int N = 32;
+  const int n_wave = 2;
+  const double epsilon = 1e-3;
+  const double fR0 = 1e-5;
+  const double a = 1.;
+
+  struct cosmology cosmo;
+  struct phys_const phys_const;
+  make_cosmology(&cosmo, &phys_const, a);
+
+  struct pm_multigrid mg;
+  make_solver(&mg, N, fR0, 1e-10, 50);
+
+  double *rho = (double *)malloc(N * N * N * sizeof(double));
+  for (int i = 0; i < N; ++i)
+    for (int j = 0; j < N; ++j)
+      for (int k = 0; k < N; ++k)
+        rho[(i * N + j) * N + k] =
+            1. + epsilon * cos(2. * M_PI * n_wave * (i + 0.5) / N);
+
+  pm_multigrid_solve_fR(&mg, rho, N, &cosmo, &phys_const, tp, 1);
+  if (mg.residual_last > 1e-10) error("Linear test did not converge");
+
+  /* Amplitude of the response */
+  double mean = 0., amp = 0.;
+  for (int i = 0; i < N; ++i)
+    for (int j = 0; j < N; ++j)
+      for (int k = 0; k < N; ++k) mean += pm_multigrid_get_fR(&mg, i, j, k);
+  mean /= (double)N * N * N;
+  for (int i = 0; i < N; ++i)
+    for (int j = 0; j < N; ++j)
+      for (int k = 0; k < N; ++k)
+        amp += (pm_multigrid_get_fR(&mg, i, j, k) - mean) *
+               cos(2. * M_PI * n_wave * (i + 0.5) / N);
+  amp *= 2. / ((double)N * N * N);
+
+  /* Linear prediction with the discrete Laplacian */
+  const double h = TEST_BOX_SIZE / N;
+  const double k2 = (2. - 2. * cos(2. * M_PI * n_wave / N)) / (h * h);
+  const double H0_c = TEST_H0 / TEST_C;
+  const double R0 =
+      3. * H0_c * H0_c * (TEST_OMEGA_M + 4. * TEST_OMEGA_LAMBDA);
+  const double m2 = a * a * R0 / (6. * fR0);
+  const double expected =
+      H0_c * H0_c * TEST_OMEGA_M * epsilon / a / (k2 + m2);
+
+  message("Plane wave: delta f_R amplitude %e, linear theory %e", amp,
+          expected);
+  if (fabs(amp / expected - 1.) > 1e-3)
+    error("Wrong linear response of the f(R) field");
+
+  pm_multigrid_clean(&mg);
+  free(rho);
+}
+
+/**
+ * @brief Fill a density field with a few Gaussian haloes.
+ */
+void make_haloes(double *rho, const int N, const double shift) {
+
+  const double centres[4][3] = {
+      {0.25, 0.3, 0.4}, {0.7, 0.6, 0.2}, {0.5, 0.8, 0.75}, {0.15, 0.7, 0.6}};
+  const double radii[4] = {0.02, 0.03, 0.015, 0.04};
+  const double peaks[4] = {500., 200., 800., 100.};
+
+  for (int i = 0; i < N; ++i) {
+    for (int j = 0; j < N; ++j) {
+      for (int k = 0; k < N; ++k) {
+        const double x[3] = {(i + 0.5) / N, (j + 0.5) / N, (k + 0.5) / N};
+        double val = 1.;
+        for (int n = 0; n < 4; ++n) {
+          double r2 = 0.;
+          for (int d = 0; d < 3; ++d) {
+            double dx = x[d] - centres[n][d] - shift;
+            dx -= round(dx);
+            r2 += dx * dx;
+          }
+          val += peaks[n] * exp(-0.5 * r2 / (radii[n] * radii[n]));
+        }
+        rho[(i * N + j) * N + k] = val;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Check that dense haloes are screened and time the solver over a
+ * sequence of slowly evolving steps.
+ */
+void test_screening_and_speed(struct threadpool *tp, const int N,
+                              const int nr_steps) {
+
+  const double fR0 = 1e-6;
+  const double tolerance = 1e-6;
+  const double a_begin = 0.5, a_end = 0.6;
+
+  struct pm_multigrid mg;
+  make_solver(&mg, N, fR0, tolerance, 50);
+
+  double *rho = (double *)malloc((size_t)N * N * N * sizeof(double));
+  const double nr_cells = (double)N * N * N;
+
+  int total_vcycles = 0;
+  double total_time = 0.;
+  for (int step = 0; step < nr_steps; ++step) {
+
+    const double a = a_begin + (a_end - a_begin) * step / (nr_steps - 1.);
+    struct cosmology cosmo;
+    struct phys_const phys_const;
+    make_cosmology(&cosmo, &phys_const, a);
+
+    /* Haloes moving by a fraction of a cell per step */
+    make_haloes(rho, N, 0.2 * step / N);
+
+    const ticks tic = getticks();
+    pm_multigrid_solve_fR(&mg, rho, N, &cosmo, &phys_const, tp, 0);
+    const double time = clocks_from_ticks(getticks() - tic);
+
+    if (mg.residual_last > tolerance)
+      error("Step %d did not converge (residual %e)", step, mg.residual_last);
+
+    message("Step %2d: a=%.3f %2d V-cycles, %.3f %s (%.2f ns per cell)", step,
+            a, mg.nr_vcycles_last, time, clocks_getunit(),
+            1e6 * time / nr_cells);
+
+    /* The first step is a cold start */
+    if (step > 0) {
+      total_vcycles += mg.nr_vcycles_last;
+      total_time += time;
+    }
+  }
+
+  /* The centre of the densest halo must be screened */
+  const int ic = (int)((0.5 + 0.2 * (nr_steps - 1) / N) * N) % N;
+  const int jc = (int)((0.8 + 0.2 * (nr_steps - 1) / N) * N) % N;
+  const int kc = (int)((0.75 + 0.2 * (nr_steps - 1) / N) * N) % N;
+  const double fR_centre = pm_multigrid_get_fR(&mg, ic, jc, kc);
+  const double fR_bg = -mg.u_bg_last * mg.u_bg_last;
+  message("f_R at the centre of the densest halo: %e (background %e)",
+          fR_centre, fR_bg);
+  if (!(fR_centre < 0.) || fabs(fR_centre) > 0.1 * fabs(fR_bg))
+    error("Dense halo is not screened");
+
+  /* Compare with a cold start of the last step */
+  const int warm_vcycles = mg.nr_vcycles_last;
+  struct cosmology cosmo;
+  struct phys_const phys_const;
+  make_cosmology(&cosmo, &phys_const, a_end);
+  mg.u_bg_last = 0.;
+  const ticks tic = getticks();
+  pm_multigrid_solve_fR(&mg, rho, N, &cosmo, &phys_const, tp, 0);
+  const double cold_time = clocks_from_ticks(getticks() - tic);
+
+  message("Mesh: %d^3 cells, %d levels", N, mg.nr_levels);
+  message("Warm start: %.2f V-cycles per step, %.2f ns per cell per step",
+          (double)total_vcycles / (nr_steps - 1),
+          1e6 * total_time / (nr_steps - 1) / nr_cells);
+  message("Cold start: %d V-cycles, %.2f ns per cell",
+          mg.nr_vcycles_last, 1e6 * cold_time / nr_cells);
+  if (total_vcycles > 0)
+    message("Time per cell per V-cycle: %.2f ns",
+            1e6 * total_time / total_vcycles / nr_cells);
+
+  if (warm_vcycles > mg.nr_vcycles_last)
+    error("Warm start needed more V-cycles than a cold start");
+
+  pm_multigrid_clean(&mg);
+  free(rho);
+}
+
+int main(int argc, char *argv[]) {
+
+  /* Initialize CPU frequency, this also starts time. */
+  unsigned long long cpufreq = 0;
+  clocks_set_cpufreq(cpufreq);
+
+  /* Optional mesh size, number of steps and threads for benchmarking */
+  const int N = (argc > 1) ? atoi(argv[1]) : 32;
+  const int nr_steps = (argc > 2) ? atoi(argv[2]) : 6;
+  const int nr_threads = (argc > 3) ? atoi(argv[3]) : 2;
+  if (N < 8 || N % 8 != 0 || nr_steps < 2 || nr_threads < 1)
+    error("Usage: testMultigrid [N (multiple of 8)] [steps] [threads]");
+
+  struct threadpool tp;
+  threadpool_init(&tp, nr_threads);
+
+  message("Checking the linear response...");
+  test_linear(&tp);
+
+  message("Checking screening and timing %d steps...", nr_steps);
+  test_screening_and_speed(&tp, N, nr_steps);
+
+  threadpool_clean(&tp);
+  return 0;
+}
@@ -0,0 +1,344 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#include <config.h>
+
+/* Some standard headers. */
+#include <fenv.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Local headers. */
+#include "swift.h"
+
+/*
+ * Checks the whole chain of multipole operators (P2M, M2M, M2L, L2L, L2P,
+ * P2L and M2P) against direct summation for well-separated groups of
+ * particles. This test does not depend on the representation of the
+ * multipoles and runs with both the Cartesian and the solid-harmonic ones.
+ */
+
+/* Number of groups of particles to test */
+const int num_tests = 100;
+
+/* Number of particles in each group */
+#define num_gparts 16
+
+/* Radius of the groups of particles */
+const double radius = 0.1;
+
+/* Softening length of the particles (well below all the distances) */
+const float softening = 1e-3f;
+
+/**
+ * @brief Returns a random number in [0, 1].
+ */
+double rand_unit(void) { return rand() / ((double)RAND_MAX); }
+
+/**
+ * @brief Places particles randomly in a sphere.
+ *
+ * @param gparts The #gpart to create.
+ * @param count The number of particles.
+ * @param centre The centre of the sphere.
+ * @param r The radius of the sphere.
+ */
+void make_gparts(struct gpart *gparts, const int count,
+                 const double centre[3], const double r) {
+
+  bzero(gparts, count * sizeof(struct gpart));
+  for (int i = 0; i < count; ++i) {
+    double dx[3], r2;
+    do {
+      for (int k = 0; k < 3; ++k) dx[k] = 2. * rand_unit() - 1.;
+      r2 = dx[0] * dx[0] + dx[1] * dx[1] + dx[2] * dx[2];
+    } while (r2 > 1.);
+
+    for (int k = 0; k < 3; ++k) gparts[i].x[k] = centre[k] + r * dx[k];
+    gparts[i].mass = 0.5 + rand_unit();
+    gparts[i].type = swift_type_dark_matter;
+    gparts[i].epsilon = softening;
+    gparts[i].time_bin = 1;
+  }
+}
+
+/**
+ * @brief Computes the acceleration and potential of a particle via direct
+ * summation over a set of sources.
+ *
+ * @param gp The #gpart feeling the field.
+ * @param sources The #gpart sourcing the field.
+ * @param count The number of sources.
+ * @param a (return) The acceleration.
+ * @param pot (return) The potential.
+ */
+void direct_summation(const struct gpart *gp, const struct gpart *sources,
+                      const int count, double a[3], double *pot) {
+
+  a[0] = a[1] = a[2] = 0.;
+  *pot = 0.;
+  for (int j = 0; j < count; ++j) {
+    const double dx[3] = {sources[j].x[0] - gp->x[0],
+                          sources[j].x[1] - gp->x[1],
+                          sources[j].x[2] - gp->x[2]};
+    const double r = sqrt(dx[0] * dx[0] + dx[1] * dx[1] + dx[2] * dx[2]);
+    const double r_inv3 = 1. / (r * r * r);
+    for (int k = 0; k < 3; ++k) a[k] += sources[j].mass * dx[k] * r_inv3;
+    *pot -= sources[j].mass / r;
+  }
+}
+
+/**
+ * @brief Compares an acceleration and potential to the direct summation.
+ *
+ * @param name The name of the check.
+ * @param a The acceleration to check.
+ * @param pot The potential to check.
+ * @param gp The #gpart feeling the field.
+ * @param sources The #gpart sourcing the field.
+ * @param count The number of sources.
+ * @param tolerance The maximal relative difference allowed.
+ * @return The relative difference.
+ */
+double check_field(const char *name, const double a[3], const double pot,
+                   const struct gpart *gp, const struct gpart *sources,
+                   const int count, const double tolerance) {
+
+  double a_exact[3], pot_exact;
+  direct_summation(gp, sources, count, a_exact, &pot_exact);
+
+  double diff2 = 0., norm2 = 0.;
+  for (int k = 0; k < 3; ++k) {
+    diff2 += (a[k] - a_exact[k]) * (a[k] - a_exact[k]);
+    norm2 += a_exact[k] * a_exact[k];
+  }
+  double diff = sqrt(diff2 / norm2);
+
+#ifndef SWIFT_GRAVITY_NO_POTENTIAL
+  diff = max(diff, fabs(pot - pot_exact) / fabs(pot_exact));
+#endif
+
+  if (diff > tolerance)
+    error("%s differs from the direct summation: rel. diff. %e", name, diff);
+
+  return diff;
+}
+
+/**
+ * @brief Applies a field tensor to a set of particles and compares the
+ * result to the direct summation.
+ *
+ * @param name The name of the check.
+ * @param l The #grav_tensor.
+ * @param loc The position of the field tensor.
+ * @param sinks The #gpart feeling the field.
+ * @param num_sinks The number of #gpart feeling the field.
+ * @param sources The #gpart sourcing the field.
+ * @param num_sources The number of #gpart sourcing the field.
+ * @param tolerance The maximal relative difference allowed.
+ * @return The maximal relative difference.
+ */
+double check_L2P(const char *name, const struct grav_tensor *l,
+                 const double loc[3], const struct gpart *sinks,
+                 const int num_sinks, const struct gpart *sources,
+                 const int num_sources, const double tolerance) {
+
+  double max_diff = 0.;
+  for (int i = 0; i < num_sinks; ++i) {
+
+    struct gpart gp = sinks[i];
+    gp.a_grav[0] = gp.a_grav[1] = gp.a_grav[2] = 0.f;
+#ifndef SWIFT_GRAVITY_NO_POTENTIAL
+    gp.potential = 0.f;
+#endif
+#ifdef SWIFT_DEBUG_CHECKS
+    gp.num_interacted = 0;
+#endif
+
+    gravity_L2P(l, loc, &gp);
+
+    const double a[3] = {gp.a_grav[0], gp.a_grav[1], gp.a_grav[2]};
+#ifndef SWIFT_GRAVITY_NO_POTENTIAL
+    const double pot = gp.potential;
+#else
+    const double pot = 0.;
+#endif
+    max_diff = max(max_diff, check_field(name, a, pot, &gp, sources,
+                                         num_sources, tolerance));
+  }
+  return max_diff;
+}
+
+int main(int argc, char *argv[]) {
+
+  /* Initialize CPU frequency, this also starts time. */
+  unsigned long long cpufreq = 0;
+  clocks_set_cpufreq(cpufreq);
+
+  /* Choke on FPEs */
+#ifdef HAVE_FE_ENABLE_EXCEPT
+  feenableexcept(FE_DIVBYZERO | FE_INVALID | FE_OVERFLOW);
+#endif
+
+  /* Get some randomness going */
+  const int seed = time(NULL);
+  message("Seed = %d", seed);
+  srand(seed);
+
+  /* Construct gravity properties */
+  struct gravity_props grav_props;
+  bzero(&grav_props, sizeof(struct gravity_props));
+  grav_props.theta_crit = 0.5;
+  grav_props.G_Newton = 1.;
+  grav_props.epsilon_DM_cur = softening;
+
+  const double dim[3] = {0., 0., 0.};
+
+  /* Expected truncation error of the expansions: the sources and the sinks
+   * live in spheres of radius 0.1 and 0.15 (after the L2L shift) separated by
+   * at least 1.5 */
+  const double tolerance =
+      10. * pow(0.17, SELF_GRAVITY_MULTIPOLE_ORDER + 1) + 1e-4;
+
+  double max_diff_M2L = 0., max_diff_sym = 0., max_diff_P2L = 0.;
+  double max_diff_M2P = 0.;
+
+  for (int n = 0; n < num_tests; ++n) {
+
+    /* Random separation between the sources and the sinks */
+    const double r = 1.5 + 1.5 * rand_unit();
+    const double phi = 2. * M_PI * rand_unit();
+    const double cos_theta = 2. * rand_unit() - 1.;
+    const double sin_theta = sqrt(1. - cos_theta * cos_theta);
+    const double loc_a[3] = {10., 10., 10.};
+    const double loc_b[3] = {loc_a[0] + r * sin_theta * cos(phi),
+                             loc_a[1] + r * sin_theta * sin(phi),
+                             loc_a[2] + r * cos_theta};
+
+    /* The sources in two children and the sinks */
+    struct gpart sources[2 * num_gparts], sinks[num_gparts];
+    const double loc_a1[3] = {loc_a[0] - 0.05, loc_a[1], loc_a[2] + 0.03};
+    const double loc_a2[3] = {loc_a[0] + 0.05, loc_a[1] - 0.02, loc_a[2]};
+    make_gparts(sources, num_gparts, loc_a1, radius - 0.05);
+    make_gparts(sources + num_gparts, num_gparts, loc_a2, radius - 0.05);
+    make_gparts(sinks, num_gparts, loc_b, radius);
+
+    /* P2M of the children and of the parent */
+    struct gravity_tensors child_1, child_2, parent, parent_exact, sink_multi;
+    gravity_reset(&child_1);
+    gravity_reset(&child_2);
+    gravity_reset(&parent_exact);
+    gravity_reset(&sink_multi);
+    gravity_P2M(&child_1, sources, num_gparts, &grav_props);
+    gravity_P2M(&child_2, sources + num_gparts, num_gparts, &grav_props);
+    gravity_P2M(&parent_exact, sources, 2 * num_gparts, &grav_props);
+    gravity_P2M(&sink_multi, sinks, num_gparts, &grav_props);
+
+    /* M2M of the children into the parent */
+    gravity_reset(&parent);
+    parent.CoM[0] = parent_exact.CoM[0];
+    parent.CoM[1] = parent_exact.CoM[1];
+    parent.CoM[2] = parent_exact.CoM[2];
+    struct multipole temp;
+    gravity_M2M(&temp, &child_1.m_pole, parent.CoM, child_1.CoM);
+    gravity_multipole_add(&parent.m_pole, &temp);
+    gravity_M2M(&temp, &child_2.m_pole, parent.CoM, child_2.CoM);
+    gravity_multipole_add(&parent.m_pole, &temp);
+    gravity_multipole_compute_power(&parent.m_pole);
+    gravity_multipole_compute_power(&parent_exact.m_pole);
+    parent.m_pole.vel[0] = parent_exact.m_pole.vel[0];
+    parent.m_pole.vel[1] = parent_exact.m_pole.vel[1];
+    parent.m_pole.vel[2] = parent_exact.m_pole.vel[2];
+    if (!gravity_multipole_equal(&parent, &parent_exact, 1e-3)) {
+      gravity_multipole_print(&parent.m_pole);
+      gravity_multipole_print(&parent_exact.m_pole);
+      error("M2M differs from the direct P2M");
+    }
+
+    /* M2L at the sinks' CoM, L2L to a nearby point and L2P */
+    struct grav_tensor l_b, l_shifted;
+    gravity_field_tensors_init(&l_b, 0);
+    gravity_M2L_nonsym(&l_b, &parent.m_pole, sink_multi.CoM, parent.CoM,
+                       &grav_props, /*periodic=*/0, dim, /*rs_inv=*/0.f);
+    const double loc_l[3] = {sink_multi.CoM[0] + 0.03,
+                             sink_multi.CoM[1] - 0.04, sink_multi.CoM[2]};
+    gravity_L2L(&l_shifted, &l_b, loc_l, sink_multi.CoM);
+    max_diff_M2L =
+        max(max_diff_M2L, check_L2P("M2L + L2L", &l_shifted, loc_l, sinks,
+                                    num_gparts, sources, 2 * num_gparts,
+                                    tolerance));
+
+    /* Symmetric M2L: the sources feel the sinks as well */
+    struct grav_tensor l_sym_a, l_sym_b;
+    gravity_field_tensors_init(&l_sym_a, 0);
+    gravity_field_tensors_init(&l_sym_b, 0);
+    gravity_M2L_symmetric(&l_sym_a, &l_sym_b, &parent.m_pole,
+                          &sink_multi.m_pole, parent.CoM, sink_multi.CoM,
+                          &grav_props, /*periodic=*/0, dim, /*rs_inv=*/0.f);
+    max_diff_sym =
+        max(max_diff_sym, check_L2P("Symmetric M2L", &l_sym_b, sink_multi.CoM,
+                                    sinks, num_gparts, sources,
+                                    2 * num_gparts, tolerance));
+    max_diff_sym =
+        max(max_diff_sym, check_L2P("Symmetric M2L", &l_sym_a, parent.CoM,
+                                    sources, 2 * num_gparts, sinks,
+                                    num_gparts, tolerance));
+
+    /* P2L of all the sources */
+    struct grav_tensor l_P2L;
+    gravity_field_tensors_init(&l_P2L, 0);
+    for (int i = 0; i < 2 * num_gparts; ++i)
+      gravity_P2L(&l_P2L, &sources[i], sink_multi.CoM, &grav_props,
+                  /*periodic=*/0, dim, /*rs_inv=*/0.f);
+    max_diff_P2L =
+        max(max_diff_P2L, check_L2P("P2L", &l_P2L, sink_multi.CoM, sinks,
+                                    num_gparts, sources, 2 * num_gparts,
+                                    tolerance));
+
+    /* M2P on each sink */
+    for (int i = 0; i < num_gparts; ++i) {
+      const float r_x = parent.CoM[0] - sinks[i].x[0];
+      const float r_y = parent.CoM[1] - sinks[i].x[1];
+      const float r_z = parent.CoM[2] - sinks[i].x[2];
+      const float r2 = r_x * r_x + r_y * r_y + r_z * r_z;
+
+      struct reduced_grav_tensor l;
+      l.F_000 = 0.f;
+      l.F_100 = 0.f;
+      l.F_010 = 0.f;
+      l.F_001 = 0.f;
+      gravity_M2P(&parent.m_pole, r_x, r_y, r_z, r2, softening,
+                  /*periodic=*/0, /*rs_inv=*/0.f, &l);
+
+      const double a[3] = {l.F_100, l.F_010, l.F_001};
+      max_diff_M2P =
+          max(max_diff_M2P, check_field("M2P", a, l.F_000, &sinks[i], sources,
+                                        2 * num_gparts, tolerance));
+    }
+  }
+
+  message("Tolerance at order %d: %e", SELF_GRAVITY_MULTIPOLE_ORDER,
+          tolerance);
+  message("M2L + L2L     : max. rel. diff. %e", max_diff_M2L);
+  message("Symmetric M2L : max. rel. diff. %e", max_diff_sym);
+  message("P2L           : max. rel. diff. %e", max_diff_P2L);
+  message("M2P           : max. rel. diff. %e", max_diff_M2P);
+
+  return 0;
+}
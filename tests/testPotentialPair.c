@@ -128,6 +128,7 @@ int main(int argc, char *argv[]) {
   props.epsilon_DM_cur = eps;
   props.epsilon_baryon_cur = eps;
   e.gravity_properties = &props;
+  e.gravity_mirror_pool = NULL;
 
   struct runner r;
   bzero(&r, sizeof(struct runner));
@@ -260,6 +261,51 @@ int main(int argc, char *argv[]) {
   /* Reset the accelerations */
   for (int n = 0; n < num_tests; ++n) gravity_init_gpart(&cj.grav.parts[n]);
 
+  /******************************************************/
+  /* Same thing through the SoA copies of the particles */
+  /******************************************************/
+
+  struct gravity_mirror_pool pool;
+  gravity_mirror_pool_init(&pool);
+  gravity_mirror_pool_reset(&pool);
+  e.gravity_mirror_pool = &pool;
+
+  /* Now compute the forces */
+  runner_dopair_grav_pp(&r, &ci, &cj, 1, 1);
+
+  /* Nothing should reach the particles before the end-force stage */
+  for (int n = 0; n < num_tests; ++n)
+    if (cj.grav.parts[n].a_grav[0] != 0.f)
+      error("Particle updated before the end-force stage");
+
+  /* Collect the forces */
+  gravity_mirror_write_back(cj.grav.mirror, cj.grav.parts);
+
+  /* Verify everything */
+  for (int n = 0; n < num_tests; ++n) {
+    const struct gpart *gp = &cj.grav.parts[n];
+    const struct gpart *gp2 = &ci.grav.parts[0];
+    const double epsilon = gravity_get_softening(gp, &props);
+
+#if defined(POTENTIAL_GRAVITY)
+    double pot_true =
+        potential(ci.grav.parts[0].mass, gp->x[0] - gp2->x[0], epsilon, rlr);
+    check_value(gp->potential, pot_true, "potential");
+#endif
+
+    double acc_true =
+        acceleration(ci.grav.parts[0].mass, gp->x[0] - gp2->x[0], epsilon, rlr);
+    check_value(gp->a_grav[0], acc_true, "acceleration");
+  }
+
+  message("\n\t\t P-P interactions via the SoA copies all good\n");
+
+  e.gravity_mirror_pool = NULL;
+  gravity_mirror_pool_clean(&pool);
+
+  /* Reset the accelerations */
+  for (int n = 0; n < num_tests; ++n) gravity_init_gpart(&cj.grav.parts[n]);
+
   /**********************************/
   /* Test the basic PM interactions */
   /**********************************/
@@ -118,6 +118,7 @@ int main(int argc, char *argv[]) {
   props.epsilon_DM_cur = eps;
   props.epsilon_baryon_cur = eps;
   e.gravity_properties = &props;
+  e.gravity_mirror_pool = NULL;
 
   struct runner r;
   bzero(&r, sizeof(struct runner));
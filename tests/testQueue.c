@@ -0,0 +1,204 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#include <config.h>
+
+/* Some standard headers. */
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Local headers. */
+#include "swift.h"
+
+/*
+ * Stress test of the task queues: threads insert tasks into the queues and
+ * take them out again (stealing from each other) concurrently. Checks that
+ * every task comes out exactly once and reports the throughput. The queue
+ * implementation is the one chosen at configure time
+ * (--enable-lockfree-queues).
+ */
+
+/* Number of tasks and of queues */
+const int num_tasks = 1 << 17;
+const int num_queues = 4;
+
+/* Time without any task coming out after which a task is deemed lost (ms) */
+const double stall_timeout = 10000.;
+
+/* Shared data of the stress test threads */
+struct stress_data {
+  struct queue *queues;
+  struct task *tasks;
+  int *times_taken;
+  int num_threads;
+  volatile int total_taken;
+};
+
+/* Per-thread argument */
+struct stress_arg {
+  struct stress_data *data;
+  int thread_id;
+};
+
+/**
+ * @brief The priority order the queues are expected to respect.
+ *
+ * The heaps return the tasks by decreasing weight, the lock-free queues by
+ * decreasing bucket.
+ */
+int queue_priority(const float weight) {
+#ifdef SWIFT_LOCKFREE_QUEUES
+  int exponent;
+  frexpf(weight, &exponent);
+  return min(exponent / queue_bucket_exponent_width, queue_nr_buckets - 1);
+#else
+  return (int)weight;
+#endif
+}
+
+/**
+ * @brief Takes one task out of the queues, starting with our own.
+ *
+ * @return 1 if a task was taken.
+ */
+int take_one(struct stress_data *data, const int qid) {
+
+  for (int k = 0; k < num_queues; k++) {
+    struct queue *q = &data->queues[(qid + k) % num_queues];
+    struct task *t = queue_gettask(q, /*blocking=*/0);
+    if (t != NULL) {
+      atomic_inc(&data->times_taken[t - data->tasks]);
+      atomic_inc(&data->total_taken);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Body of the stress test threads.
+ */
+void *stress_thread(void *arg) {
+
+  struct stress_arg *a = (struct stress_arg *)arg;
+  struct stress_data *data = a->data;
+  const int qid = a->thread_id % num_queues;
+
+  /* Insert our share of the tasks, taking some out on the way */
+  for (int i = a->thread_id; i < num_tasks; i += data->num_threads) {
+    queue_insert(&data->queues[i % num_queues], &data->tasks[i]);
+    if (i % 3 == 0) take_one(data, qid);
+  }
+
+  /* Empty the queues, failing if the tasks stop coming out */
+  const ticks timeout = clocks_to_ticks(stall_timeout);
+  int last_total = data->total_taken;
+  ticks last_progress = getticks();
+  while (data->total_taken < num_tasks) {
+    if (take_one(data, qid) || data->total_taken != last_total) {
+      last_total = data->total_taken;
+      last_progress = getticks();
+    } else if (getticks() - last_progress > timeout) {
+      error("Only %d of %d tasks came out with %d threads.", last_total,
+            num_tasks, data->num_threads);
+    }
+  }
+
+  return NULL;
+}
+
+int main(int argc, char *argv[]) {
+
+  /* Initialize CPU frequency, this also starts time. */
+  unsigned long long cpufreq = 0;
+  clocks_set_cpufreq(cpufreq);
+
+  srand(1234);
+
+  struct task *tasks = (struct task *)calloc(num_tasks, sizeof(struct task));
+  int *times_taken = (int *)calloc(num_tasks, sizeof(int));
+  struct queue *queues = NULL;
+  if (tasks == NULL || times_taken == NULL ||
+      posix_memalign((void **)&queues, queue_struct_align,
+                     num_queues * sizeof(struct queue)) != 0)
+    error("Failed to allocate the test data.");
+
+  for (int i = 0; i < num_tasks; i++) {
+    tasks[i].type = task_type_none;
+    tasks[i].weight = 1.f + (float)rand() / RAND_MAX * 1e6f;
+  }
+
+  /* Single-threaded: are the tasks coming out in priority order? */
+  queue_init(&queues[0], tasks);
+  for (int i = 0; i < num_tasks; i++) queue_insert(&queues[0], &tasks[i]);
+  int last_priority = INT_MAX;
+  for (int i = 0; i < num_tasks; i++) {
+    struct task *t = queue_gettask(&queues[0], /*blocking=*/1);
+    if (t == NULL) error("Queue emptied after %d tasks.", i);
+    const int priority = queue_priority(t->weight);
+    if (priority > last_priority)
+      error("Task %d came out of order (%d > %d).", i, priority,
+            last_priority);
+    last_priority = priority;
+  }
+  if (queue_gettask(&queues[0], /*blocking=*/1) != NULL)
+    error("Queue not empty.");
+  queue_clean(&queues[0]);
+  message("Tasks came out in priority order.");
+
+  /* Multi-threaded: concurrent insertions and stealing */
+  for (int num_threads = 1; num_threads <= 16; num_threads *= 4) {
+
+    for (int k = 0; k < num_queues; k++) queue_init(&queues[k], tasks);
+    bzero(times_taken, num_tasks * sizeof(int));
+
+    struct stress_data data = {queues, tasks, times_taken, num_threads, 0};
+    pthread_t threads[num_threads];
+    struct stress_arg args[num_threads];
+
+    const ticks tic = getticks();
+    for (int k = 0; k < num_threads; k++) {
+      args[k].data = &data;
+      args[k].thread_id = k;
+      if (pthread_create(&threads[k], NULL, stress_thread, &args[k]) != 0)
+        error("Failed to create thread.");
+    }
+    for (int k = 0; k < num_threads; k++) pthread_join(threads[k], NULL);
+    const ticks toc = getticks();
+
+    for (int i = 0; i < num_tasks; i++)
+      if (times_taken[i] != 1)
+        error("Task %d taken %d times with %d threads.", i, times_taken[i],
+              num_threads);
+
+    const double time = clocks_from_ticks(toc - tic);
+    message("%2d threads: %d tasks in %.3f %s (%.1f tasks/%s).", num_threads,
+            num_tasks, time, clocks_getunit(), num_tasks / time,
+            clocks_getunit());
+
+    for (int k = 0; k < num_queues; k++) queue_clean(&queues[k]);
+  }
+
+  free(tasks);
+  free(times_taken);
+  free(queues);
+  return 0;
+}
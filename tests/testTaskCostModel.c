@@ -0,0 +1,209 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#include <config.h>
+
+/* Some standard headers. */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Local headers. */
+#include "swift.h"
+
+/*
+ * Checks that the task cost model recovers known linear costs from noisy
+ * samples, falls back to the mean when the features do not vary, follows a
+ * change of the costs thanks to the decay and keeps the types it has not
+ * seen at their static cost. Finally runs the tasks of a real scheduler and
+ * checks that the model collects their times.
+ */
+
+/* Number of samples per step */
+const int num_samples = 1000;
+
+/* Number of tasks run through the scheduler */
+const int num_sched_tasks = 200;
+
+/**
+ * @brief Returns a random number uniform in [-1, 1].
+ */
+double rand_sym(void) { return 2. * rand() / RAND_MAX - 1.; }
+
+/**
+ * @brief Feeds a step of samples following ticks = slope * x + intercept with
+ * 10% noise.
+ */
+void add_step(struct task_cost_model *m, const enum task_types type,
+              const enum task_subtypes subtype, const double slope,
+              const double intercept, const double x_min,
+              const double x_max) {
+
+  for (int i = 0; i < num_samples; i++) {
+    const double x = x_min + (x_max - x_min) * rand() / RAND_MAX;
+    const double measured = (slope * x + intercept) * (1. + 0.1 * rand_sym());
+    task_cost_model_add_sample(m, type, subtype, x, measured);
+  }
+}
+
+/**
+ * @brief Checks that a value is within a relative tolerance of the expected.
+ */
+void check(const char *name, const double value, const double expected,
+           const double tolerance) {
+  if (fabs(value - expected) > tolerance * fabs(expected))
+    error("%s is %e, expected %e.", name, value, expected);
+}
+
+int main(int argc, char *argv[]) {
+
+  /* Initialize CPU frequency, this also starts time. */
+  unsigned long long cpufreq = 0;
+  clocks_set_cpufreq(cpufreq);
+
+  srand(1234);
+
+  /* Default parameters */
+  struct task_cost_model *m =
+      (struct task_cost_model *)malloc(sizeof(struct task_cost_model));
+  if (m == NULL) error("Failed to allocate the model.");
+  bzero(m, sizeof(struct task_cost_model));
+  m->decay = 0.9;
+  m->min_samples = 32.;
+
+  /* Not enough samples: nothing is fitted */
+  for (int i = 0; i < 10; i++)
+    task_cost_model_add_sample(m, task_type_self, task_subtype_density, 100.,
+                               1000.);
+  task_cost_model_fit(m);
+  if (m->fits[task_type_self][task_subtype_density].fitted)
+    error("Fitted with too few samples.");
+
+  /* A line with an offset */
+  for (int step = 0; step < 20; step++) {
+    add_step(m, task_type_self, task_subtype_density, 3., 2000., 100., 10000.);
+    task_cost_model_fit(m);
+  }
+  const struct task_cost_fit *fit =
+      &m->fits[task_type_self][task_subtype_density];
+  if (!fit->fitted) error("Line not fitted.");
+  check("slope", fit->slope, 3., 0.02);
+  check("intercept", fit->intercept, 2000., 0.2);
+  message("Line fitted: slope=%.3f intercept=%.1f.", fit->slope,
+          fit->intercept);
+
+  /* Tasks whose static cost is always the same */
+  for (int step = 0; step < 20; step++) {
+    add_step(m, task_type_kick2, task_subtype_none, 0., 500., 0., 0.);
+    task_cost_model_fit(m);
+  }
+  fit = &m->fits[task_type_kick2][task_subtype_none];
+  if (!fit->fitted) error("Constant not fitted.");
+  check("constant",
+        task_cost_model_ticks(m, task_type_kick2, task_subtype_none, 0.), 500.,
+        0.02);
+  message("Constant fitted: %.1f.", fit->intercept);
+
+  /* The costs change: the decay lets the model follow */
+  for (int step = 0; step < 100; step++) {
+    add_step(m, task_type_self, task_subtype_density, 6., 0., 100., 10000.);
+    task_cost_model_fit(m);
+  }
+  fit = &m->fits[task_type_self][task_subtype_density];
+  check("new slope", fit->slope, 6., 0.02);
+  message("Change followed: slope=%.3f intercept=%.1f.", fit->slope,
+          fit->intercept);
+
+  /* The scheduler weights keep the scale of the static costs */
+  if (m->ticks_per_unit <= 0.) error("No conversion to ticks.");
+  check("predicted weight",
+        task_cost_model_predict(m, task_type_self, task_subtype_density,
+                                5000.f),
+        6. * 5000. / m->ticks_per_unit, 0.02);
+  if (task_cost_model_predict(m, task_type_sort, task_subtype_none, 42.f) !=
+      42.f)
+    error("Unseen task type not at its static cost.");
+
+  /* The repartition costs of the unseen types use the average conversion */
+  check("fixed cost",
+        task_cost_model_fixed_cost(m, task_type_sort, task_subtype_none, 42.,
+                                   1.),
+        clocks_from_ticks(42. * m->ticks_per_unit) * 10000., 1e-6);
+
+  /* A real scheduler: self-gravity tasks on cells of various sizes... */
+  struct cell *cells =
+      (struct cell *)calloc(num_sched_tasks, sizeof(struct cell));
+  if (cells == NULL) error("Failed to allocate the cells.");
+  struct scheduler s;
+  bzero(&s, sizeof(struct scheduler));
+  scheduler_init(&s, /*space=*/NULL, num_sched_tasks, /*nr_queues=*/1,
+                 /*flags=*/0, /*nodeID=*/0, /*tp=*/NULL);
+  for (int i = 0; i < num_sched_tasks; i++) {
+    struct cell *c = &cells[i];
+    c->grav.count = 10 + rand() % 1000;
+    c->grav.super = c;
+    c->super = c;
+    lock_init(&c->grav.plock);
+    lock_init(&c->grav.mlock);
+    scheduler_addtask(&s, task_type_self, task_subtype_grav, 0, 0, c, NULL);
+  }
+
+  /* ... activated and run like engine_launch() does */
+  bzero(m, sizeof(struct task_cost_model));
+  m->decay = 0.9;
+  m->min_samples = 32.;
+  for (int i = 0; i < s.nr_tasks; i++) scheduler_activate(&s, &s.tasks[i]);
+  const ticks launch_tic = getticks();
+  scheduler_start(&s);
+  int num_run = 0;
+  struct task *t;
+  while ((t = scheduler_gettask(&s, 0, NULL)) != NULL) {
+
+    /* Work in proportion to the static cost */
+    volatile double sum = 0.;
+    for (int k = 0; k < t->ci->grav.count * t->ci->grav.count; k++)
+      sum += sqrt((double)k);
+
+    scheduler_done(&s, t);
+    num_run++;
+  }
+  if (num_run != num_sched_tasks)
+    error("Ran %d of the %d tasks.", num_run, num_sched_tasks);
+  if (s.active_count != 0) error("Active tasks left after the launch.");
+
+  /* Were the times of all the tasks collected? */
+  task_cost_model_update(m, &s, launch_tic, /*verbose=*/0);
+  fit = &m->fits[task_type_self][task_subtype_grav];
+  if (fit->sums.n != num_sched_tasks)
+    error("Collected %.0f samples of the %d tasks.", fit->sums.n,
+          num_sched_tasks);
+  if (!fit->fitted) error("Scheduler tasks not fitted.");
+  if (m->ticks_per_unit <= 0.) error("No conversion to ticks.");
+  message("Scheduler tasks fitted: slope=%.3e intercept=%.3e.", fit->slope,
+          fit->intercept);
+
+  /* The tasks of an older launch are not collected again */
+  task_cost_model_update(m, &s, getticks(), /*verbose=*/0);
+  if (fit->sums.n != num_sched_tasks)
+    error("Collected the tasks of an older launch.");
+
+  scheduler_clean(&s);
+  free(cells);
+  free(m);
+  return 0;
+}
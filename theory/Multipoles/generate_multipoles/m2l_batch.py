@@ -0,0 +1,215 @@
+import sys
+
+SUFFIXES = {1: "st", 2: "nd", 3: "rd"}
+
+
+def ordinal(num):
+    suffix = SUFFIXES.get(num % 10, "th")
+    return str(num) + suffix
+
+
+def factorial(x):
+    if x == 0:
+        return 1
+    else:
+        return x * factorial(x - 1)
+
+
+def terms(order):
+    """All the (i, j, k) with i + j + k == order"""
+    t = []
+    for i in range(order + 1):
+        for j in range(order + 1):
+            for k in range(order + 1):
+                if i + j + k == order:
+                    t.append((i, j, k))
+    return t
+
+
+def name(prefix, ijk):
+    return "%s_%d%d%d" % (prefix, ijk[0], ijk[1], ijk[2])
+
+
+def power(axis, p):
+    if p == 1:
+        return "r%s_r.v" % axis
+    return "r%s_r%d.v" % (axis, p)
+
+
+def product(factors):
+    expr = factors[0]
+    for f in factors[1:]:
+        expr = "vec_mul(%s, %s)" % (expr, f)
+    return expr
+
+
+def open_block(order):
+    if order > 0:
+        print("#if SELF_GRAVITY_MULTIPOLE_ORDER > %d" % (order - 1))
+
+
+def close_block(order):
+    if order > 0:
+        print("#endif")
+
+
+# Get the order
+order = int(sys.argv[1])
+
+print("-------------------------------------------------")
+print("Generating batched M2L code for order", order, "(only).")
+print("-------------------------------------------------\n")
+
+print("-------------------------------------------------")
+print("gravity_M2L_batch_kernel() declarations:")
+print("-------------------------------------------------\n")
+
+open_block(order)
+print("/* %s order terms */" % ordinal(order))
+if order > 0:
+    p = str(order) if order > 1 else ""
+    print("vector rx_r%s, ry_r%s, rz_r%s;" % (p, p, p))
+print("vector Dt_%d;" % (order + 1))
+for ijk in terms(order):
+    print("vector %s;" % name("D", ijk))
+if order != 1:
+    for ijk in terms(order):
+        print("vector %s;" % name("M", ijk))
+for ijk in terms(order):
+    print("vector %s;" % name("F", ijk))
+close_block(order)
+
+print("")
+print("-------------------------------------------------")
+print("gravity_M2L_batch_kernel() radial terms:")
+print("-------------------------------------------------\n")
+
+open_block(order)
+print("Dt_%d.v = vec_load(Dt[%d]);" % (order + 1, order))
+close_block(order)
+
+print("")
+print("-------------------------------------------------")
+print("gravity_M2L_batch_kernel() powers:")
+print("-------------------------------------------------\n")
+
+if order > 0:
+    open_block(order)
+    for axis in ["x", "y", "z"]:
+        if order == 1:
+            print("r%s_r.v = vec_mul(d%s.v, r_inv.v);" % (axis, axis))
+        else:
+            print(
+                "%s = vec_mul(%s, r%s_r.v);"
+                % (power(axis, order), power(axis, order - 1), axis)
+            )
+    close_block(order)
+
+print("")
+print("-------------------------------------------------")
+print("gravity_M2L_batch_kernel() derivatives:")
+print("-------------------------------------------------\n")
+
+open_block(order)
+print("/* %s order derivatives */" % ordinal(order))
+
+# Bring the radial terms to the right power of r
+for k in range((order + 1) // 2 + 1, order + 1):
+    print("Dt_%d.v = vec_mul(Dt_%d.v, r_inv.v);" % (k, k))
+
+for ijk in terms(order):
+
+    expr = None
+    for a in range(ijk[0] // 2 + 1):
+        for b in range(ijk[1] // 2 + 1):
+            for c in range(ijk[2] // 2 + 1):
+
+                # Number of pairs of indices contracted
+                t = a + b + c
+                dt = "Dt_%d.v" % (order - t + 1)
+
+                # Combinatorial factor
+                coeff = 1
+                for n, p in zip(ijk, (a, b, c)):
+                    coeff *= factorial(n) // (
+                        2 ** p * factorial(p) * factorial(n - 2 * p)
+                    )
+
+                # Remaining powers of the unit vector
+                factors = []
+                if coeff != 1:
+                    factors.append("vec_set1(%d.f)" % coeff)
+                for axis, n, p in zip(["x", "y", "z"], ijk, (a, b, c)):
+                    if n - 2 * p > 0:
+                        factors.append(power(axis, n - 2 * p))
+
+                if expr is None:
+                    if len(factors) == 0:
+                        expr = dt
+                    else:
+                        expr = "vec_mul(%s, %s)" % (product(factors), dt)
+                else:
+                    if len(factors) == 0:
+                        expr = "vec_add(%s, %s)" % (expr, dt)
+                    else:
+                        expr = "vec_fma(%s, %s, %s)" % (product(factors), dt, expr)
+
+    print("%s.v = %s;" % (name("D", ijk), expr))
+close_block(order)
+
+print("")
+print("-------------------------------------------------")
+print("gravity_M2L_batch_kernel() gather:")
+print("-------------------------------------------------\n")
+
+if order != 1:
+    open_block(order)
+    for ijk in terms(order):
+        print("%s.f[k] = m->%s;" % (name("M", ijk), name("M", ijk)))
+    close_block(order)
+
+print("")
+print("-------------------------------------------------")
+print("gravity_M2L_batch_kernel() tensor multiplication:")
+print("-------------------------------------------------\n")
+
+open_block(order)
+print("/* %s order terms */" % ordinal(order))
+for rank_f in range(order + 1):
+
+    # Rank of the multipole terms contributing at this order
+    rank_m = order - rank_f
+
+    # The dipole term is zero when using the CoM
+    if rank_m == 1:
+        continue
+
+    for f in terms(rank_f):
+        pairs = []
+        for m in terms(rank_m):
+            d = (f[0] + m[0], f[1] + m[1], f[2] + m[2])
+            pairs.append((name("M", m) + ".v", name("D", d) + ".v"))
+
+        if rank_m == 0:
+            print(
+                "%s.v = vec_mul(%s, %s);" % (name("F", f), pairs[0][0], pairs[0][1])
+            )
+            continue
+
+        # Accumulate three terms per statement
+        for start in range(0, len(pairs), 3):
+            expr = name("F", f) + ".v"
+            for pair in reversed(pairs[start : start + 3]):
+                expr = "vec_fma(%s, %s, %s)" % (pair[0], pair[1], expr)
+            print("%s.v = %s;" % (name("F", f), expr))
+close_block(order)
+
+print("")
+print("-------------------------------------------------")
+print("gravity_M2L_batch_kernel() scatter:")
+print("-------------------------------------------------\n")
+
+open_block(order)
+for ijk in terms(order):
+    print("l->%s += %s.f[k];" % (name("F", ijk), name("F", ijk)))
+close_block(order)
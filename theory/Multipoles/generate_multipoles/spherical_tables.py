@@ -0,0 +1,80 @@
+import math
+import sys
+
+# Generates the constant tables used by the solid-harmonic multipoles
+# (src/multipole_spherical.c) for all the degrees up to the given order.
+
+
+def wigner_d(j, mp, m, beta):
+    """Wigner's small d-matrix d^j_{m'm}(beta)"""
+    total = 0.0
+    for s in range(max(0, m - mp), min(j + m, j - mp) + 1):
+        num = (-1) ** (mp - m + s) * math.sqrt(
+            math.factorial(j + mp)
+            * math.factorial(j - mp)
+            * math.factorial(j + m)
+            * math.factorial(j - m)
+        )
+        den = (
+            math.factorial(j + m - s)
+            * math.factorial(s)
+            * math.factorial(mp - m + s)
+            * math.factorial(j - mp - s)
+        )
+        total += (
+            num
+            / den
+            * math.cos(beta / 2) ** (2 * j + m - mp - 2 * s)
+            * math.sin(beta / 2) ** (mp - m + 2 * s)
+        )
+    return total
+
+
+def print_table(name, comment, values):
+    print("/*! %s */" % comment)
+    print("const float %s[%d] = {" % (name, len(values)))
+    line = "   "
+    for v in values:
+        item = " %.9e," % v
+        if len(line) + len(item) > 79:
+            print(line)
+            line = "   "
+        line += item
+    print(line[:-1] + "};\n")
+
+
+# Get the order
+order = int(sys.argv[1])
+
+print("-------------------------------------------------")
+print("Generating solid-harmonic tables up to order", order)
+print("-------------------------------------------------\n")
+
+rotation = []
+for n in range(order + 1):
+    for k in range(n + 1):
+        for m in range(n + 1):
+            d = wigner_d(n, k, m, math.pi / 2)
+            rotation.append(d if abs(d) > 1e-12 else 0.0)
+
+norm = []
+for n in range(order + 1):
+    for m in range(n + 1):
+        norm.append(math.sqrt(math.factorial(n + m) * math.factorial(n - m)))
+
+print_table(
+    "multipole_sph_rotation",
+    "Rotation matrices d^n_{km}(pi/2) for 0 <= k, m <= n",
+    rotation,
+)
+print_table("multipole_sph_norm", "sqrt((n + m)! (n - m)!) for 0 <= m <= n", norm)
+print_table(
+    "multipole_sph_norm_inv",
+    "1 / sqrt((n + m)! (n - m)!) for 0 <= m <= n",
+    [1.0 / x for x in norm],
+)
+print_table(
+    "multipole_sph_factorial",
+    "n! for 0 <= n <= p",
+    [float(math.factorial(n)) for n in range(order + 1)],
+)
@@ -44,6 +44,13 @@ TASKTYPES = [
     "grav_down_in",
     "grav_down",
     "grav_end_force",
+    "grav_mesh_assign",
+    "grav_mesh_ghost",
+    "grav_mesh_reduce",
+    "grav_mesh_r2c",
+    "grav_mesh_green",
+    "grav_mesh_c2r",
+    "grav_mesh_interp",
     "cooling",
     "cooling_in",
     "cooling_out",